@@ -142,6 +142,26 @@ VLC_API void block_Init( block_t *, void *, size_t );
  */
 VLC_API block_t *block_Alloc(size_t size) VLC_USED VLC_MALLOC;
 
+/**
+ * Block allocator statistics.
+ */
+typedef struct block_stats_t
+{
+    uint64_t live_blocks; /**< Blocks allocated and not yet released */
+    uint64_t live_bytes; /**< Memory used by those blocks */
+    uint64_t cached_bytes; /**< Memory kept in the block pool free lists */
+    uint64_t hits; /**< Allocations served by the block pool */
+    uint64_t misses; /**< Allocations served by the system allocator */
+} block_stats_t;
+
+/**
+ * Gets the block allocator statistics.
+ *
+ * This covers blocks allocated with block_Alloc() (and block_Realloc()) by
+ * all threads of the process.
+ */
+VLC_API void block_GetStats(block_stats_t *);
+
 VLC_API block_t *block_TryRealloc(block_t *, ssize_t pre, size_t body) VLC_USED;
 
 /**
@@ -621,6 +641,132 @@ static inline void vlc_fifo_Cleanup(void *fifo)
 
 /** @} */
 
+/**
+ * \defgroup spsc Lock-free block FIFO
+ * Single producer, single consumer block queue functions
+ *
+ * This is a variant of the block FIFO for exactly one producer thread and
+ * one consumer thread at any given time. Queuing and dequeuing never take a
+ * lock, and only the consumer ever sleeps.
+ * @{
+ */
+
+typedef struct vlc_spsc vlc_spsc_t;
+
+/**
+ * Creates a lock-free single producer, single consumer block queue.
+ *
+ * @return the queue or NULL on memory error
+ */
+VLC_API vlc_spsc_t *vlc_spsc_New(void) VLC_USED VLC_MALLOC;
+
+/**
+ * Destroys a queue created by vlc_spsc_New().
+ *
+ * @note Any queued blocks are also destroyed.
+ * @warning No other threads may be using the queue when this function is
+ * called.
+ */
+VLC_API void vlc_spsc_Delete(vlc_spsc_t *);
+
+/**
+ * Queues a linked-list of blocks at the end of a queue.
+ *
+ * The blocks are published to the consumer at once.
+ *
+ * @warning Only the producer thread may call this function.
+ *
+ * @param block head of a block list to queue (may be NULL)
+ * @return true if the consumer was waiting (see vlc_spsc_BeginWait()),
+ * false otherwise
+ */
+VLC_API bool vlc_spsc_Queue(vlc_spsc_t *, block_t *block);
+
+/**
+ * Discards all blocks queued so far.
+ *
+ * The blocks are not counted anymore, and the consumer will never dequeue
+ * them. They are released by vlc_spsc_Dequeue() or vlc_spsc_Purge().
+ *
+ * @warning Only the producer thread may call this function.
+ */
+VLC_API void vlc_spsc_Flush(vlc_spsc_t *);
+
+/**
+ * Dequeues the first block from a queue.
+ *
+ * @note This function never waits and is not a cancellation point.
+ * @warning Only the consumer thread may call this function.
+ *
+ * @return the first block in the queue or NULL if the queue is empty
+ */
+VLC_API block_t *vlc_spsc_Dequeue(vlc_spsc_t *) VLC_USED;
+
+/**
+ * Releases the blocks discarded by vlc_spsc_Flush().
+ *
+ * @warning Only the consumer thread may call this function.
+ */
+VLC_API void vlc_spsc_Purge(vlc_spsc_t *);
+
+/**
+ * Counts blocks in a queue.
+ *
+ * @note From a thread other than the producer and the consumer, the result
+ * is only a snapshot.
+ */
+VLC_API size_t vlc_spsc_GetCount(const vlc_spsc_t *) VLC_USED;
+
+/**
+ * Counts bytes in a queue.
+ *
+ * @note From a thread other than the producer and the consumer, the result
+ * is only a snapshot.
+ */
+VLC_API size_t vlc_spsc_GetBytes(const vlc_spsc_t *) VLC_USED;
+
+/**
+ * Announces that the consumer is about to wait for blocks.
+ *
+ * This lets the consumer sleep with its own synchronization primitives:
+ * if this function returns true, the next call to vlc_spsc_Queue() returns
+ * true, and the producer must wake the consumer up.
+ * In any case, vlc_spsc_EndWait() must be called after waiting.
+ *
+ * @warning Only the consumer thread may call this function.
+ *
+ * @return true if the queue is empty, false if the consumer should not wait
+ */
+VLC_API bool vlc_spsc_BeginWait(vlc_spsc_t *);
+
+/**
+ * Announces that the consumer is not waiting for blocks anymore.
+ */
+VLC_API void vlc_spsc_EndWait(vlc_spsc_t *);
+
+/**
+ * Waits for a block to be queued.
+ *
+ * The function returns once the queue is not empty, or after a call to
+ * vlc_spsc_Wake(), or spuriously.
+ *
+ * @note This function is not a cancellation point.
+ * @warning Only the consumer thread may call this function.
+ */
+VLC_API void vlc_spsc_Wait(vlc_spsc_t *);
+
+/**
+ * Wakes the consumer up from vlc_spsc_Wait().
+ */
+VLC_API void vlc_spsc_Wake(vlc_spsc_t *);
+
+VLC_USED static inline bool vlc_spsc_IsEmpty(const vlc_spsc_t *q)
+{
+    return vlc_spsc_GetCount(q) == 0;
+}
+
+/** @} */
+
 /** @} */
 
 #endif /* VLC_BLOCK_H */
@@ -143,6 +143,12 @@ VLC_API void httpd_StreamDelete( httpd_stream_t * );
 VLC_API int httpd_StreamHeader( httpd_stream_t *, uint8_t *p_data, int i_data );
 VLC_API int httpd_StreamSend( httpd_stream_t *, const block_t *p_block );
 VLC_API int httpd_StreamSetHTTPHeaders(httpd_stream_t *, const httpd_header *, size_t);
+/**
+ * Gets the slow clients statistics of a stream: how many times the data of a
+ * client was overwritten in the stream buffer before being sent (overruns),
+ * and how many clients were dropped after too many consecutive overruns.
+ */
+VLC_API void httpd_StreamGetStats(httpd_stream_t *, uint64_t *overruns, uint64_t *dropped);
 
 /* Msg functions facilities */
 VLC_API void httpd_MsgAdd( httpd_message_t *, const char *psz_name, const char *psz_value, ... ) VLC_FORMAT( 3, 4 );
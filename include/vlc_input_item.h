@@ -395,6 +395,8 @@ struct input_stats_t
     /* Decoders */
     int64_t i_decoded_audio;
     int64_t i_decoded_video;
+    int64_t i_decoder_blocked; /**< Time the input waited for decoders */
+    int64_t i_decoder_dropped; /**< Blocks discarded as decoders lagged */
 
     /* Vout */
     int64_t i_displayed_pictures;
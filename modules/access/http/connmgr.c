@@ -23,10 +23,12 @@
 #endif
 
 #include <assert.h>
+#include <errno.h>
 #include <vlc_common.h>
 #include <vlc_network.h>
 #include <vlc_tls.h>
 #include <vlc_url.h>
+#include <vlc_strings.h>
 #include "transport.h"
 #include "conn.h"
 #include "connmgr.h"
@@ -92,87 +94,207 @@ static char *vlc_http_proxy_find(const char *hostname, unsigned port,
 }
 
 
+/** Maximum number of connections kept in the pool of a manager */
+#define VLC_HTTP_MGR_MAX_CONNS 8
+
+struct vlc_http_mgr_conn
+{
+    struct vlc_http_mgr_conn *next;
+    struct vlc_http_conn *conn; /**< NULL while connecting */
+    bool secure;
+    unsigned port;
+    char host[]; /**< Server of the connection */
+};
+
 struct vlc_http_mgr
 {
     vlc_object_t *obj;
     vlc_tls_creds_t *creds;
     struct vlc_http_cookie_jar_t *jar;
-    struct vlc_http_conn *conn;
+    struct vlc_http_mgr_conn *conns; /**< Pool, most recently used first */
+    vlc_mutex_t lock; /**< Protects the pool and the credentials */
+    vlc_cond_t wait; /**< Signaled when a connection attempt completes */
 };
 
-static struct vlc_http_conn *vlc_http_mgr_find(struct vlc_http_mgr *mgr,
-                                               const char *host, unsigned port)
+static bool vlc_http_mgr_match(const struct vlc_http_mgr_conn *c, bool secure,
+                               const char *host, unsigned port)
 {
-    (void) host; (void) port;
-    return mgr->conn;
+    return c->secure == secure && c->port == port
+        && !vlc_ascii_strcasecmp(c->host, host);
 }
 
-static void vlc_http_mgr_release(struct vlc_http_mgr *mgr,
-                                 struct vlc_http_conn *conn)
+static void vlc_http_mgr_release(struct vlc_http_mgr_conn **pp)
 {
-    assert(mgr->conn == conn);
-    mgr->conn = NULL;
+    struct vlc_http_mgr_conn *c = *pp;
 
-    vlc_http_conn_release(conn);
+    *pp = c->next;
+    if (c->conn != NULL)
+        vlc_http_conn_release(c->conn);
+    free(c);
 }
 
-static
-struct vlc_http_msg *vlc_http_mgr_reuse(struct vlc_http_mgr *mgr,
-                                        const char *host, unsigned port,
-                                        const struct vlc_http_msg *req)
+/** Removes a given connection from the pool, unless another request already
+ * did. The lock must be held. */
+static void vlc_http_mgr_drop(struct vlc_http_mgr *mgr,
+                              const struct vlc_http_conn *conn)
+{
+    for (struct vlc_http_mgr_conn **pp = &mgr->conns; *pp != NULL;
+         pp = &(*pp)->next)
+        if ((*pp)->conn == conn)
+        {
+            vlc_http_mgr_release(pp);
+            break;
+        }
+}
+
+/** Adds a connection, or a pending one if conn is NULL, to the pool. The
+ * lock must be held. */
+static struct vlc_http_mgr_conn *vlc_http_mgr_attach(struct vlc_http_mgr *mgr,
+                                                     struct vlc_http_conn *conn,
+                                                     bool secure,
+                                                     const char *host,
+                                                     unsigned port)
 {
-    struct vlc_http_conn *conn = vlc_http_mgr_find(mgr, host, port);
-    if (conn == NULL)
+    size_t len = strlen(host) + 1;
+    struct vlc_http_mgr_conn *c = malloc(sizeof (*c) + len);
+    if (unlikely(c == NULL))
         return NULL;
 
-    struct vlc_http_stream *stream = vlc_http_stream_open(conn, req);
-    if (stream != NULL)
+    c->conn = conn;
+    c->secure = secure;
+    c->port = port;
+    memcpy(c->host, host, len);
+    c->next = mgr->conns;
+    mgr->conns = c;
+
+    /* Drop the least recently used connection beyond the limit. It lingers
+     * until its remaining streams are closed. Pending connections belong to
+     * their requesting thread and are not dropped. */
+    struct vlc_http_mgr_conn **pp, **lru = NULL;
+    unsigned n = 0;
+
+    for (pp = &mgr->conns; *pp != NULL; pp = &(*pp)->next)
+    {
+        n++;
+        if ((*pp)->conn != NULL && *pp != c)
+            lru = pp;
+    }
+    if (n > VLC_HTTP_MGR_MAX_CONNS && lru != NULL)
+        vlc_http_mgr_release(lru);
+    return c;
+}
+
+/**
+ * Opens a stream on a pooled connection to a server.
+ *
+ * Multiplexed (HTTP/2) connections are shared by all requests. An HTTP/1.1
+ * connection serves one request at a time: busy ones are skipped, and dead
+ * ones are removed from the pool. The lock must be held.
+ */
+static struct vlc_http_stream *vlc_http_mgr_open(struct vlc_http_mgr *mgr,
+                                                 bool secure, const char *host,
+                                                 unsigned port,
+                                                 const struct vlc_http_msg *req,
+                                                 struct vlc_http_conn **connp)
+{
+    struct vlc_http_mgr_conn **pp = &mgr->conns, *c;
+
+    while ((c = *pp) != NULL)
     {
-        struct vlc_http_msg *m = vlc_http_msg_get_initial(stream);
-        if (m != NULL)
-            return m;
-
-        /* NOTE: If the request were not idempotent, we would not know if it
-         * was processed by the other end. Thus POST is not used/supported so
-         * far, and CONNECT is treated as if it were idempotent (which works
-         * fine here). */
+        if (c->conn == NULL || !vlc_http_mgr_match(c, secure, host, port))
+        {
+            pp = &c->next;
+            continue;
+        }
+
+        errno = 0;
+        struct vlc_http_stream *stream = vlc_http_stream_open(c->conn, req);
+        if (stream != NULL)
+        {   /* Move the connection to the front of the pool */
+            *pp = c->next;
+            c->next = mgr->conns;
+            mgr->conns = c;
+            *connp = c->conn;
+            return stream;
+        }
+
+        if (errno == EBUSY)
+            pp = &c->next;
+        else /* closing or reset connection */
+            vlc_http_mgr_release(pp);
     }
-    /* Get rid of closing or reset connection */
-    vlc_http_mgr_release(mgr, conn);
     return NULL;
 }
 
-static struct vlc_http_msg *vlc_https_request(struct vlc_http_mgr *mgr,
-                                              const char *host, unsigned port,
-                                              const struct vlc_http_msg *req)
+static bool vlc_http_mgr_connecting(const struct vlc_http_mgr *mgr,
+                                    bool secure, const char *host,
+                                    unsigned port)
 {
-    vlc_tls_t *tls;
-    bool http2 = true;
+    for (const struct vlc_http_mgr_conn *c = mgr->conns; c != NULL;
+         c = c->next)
+        if (c->conn == NULL && vlc_http_mgr_match(c, secure, host, port))
+            return true;
+    return false;
+}
 
-    if (mgr->creds == NULL && mgr->conn != NULL)
-        return NULL; /* switch from HTTP to HTTPS not implemented */
+/** Waits for the initial response to a request on a pooled connection */
+static struct vlc_http_msg *vlc_http_mgr_wait(struct vlc_http_mgr *mgr,
+                                              struct vlc_http_stream *stream,
+                                              struct vlc_http_conn *conn)
+{
+    struct vlc_http_msg *m = vlc_http_msg_get_initial(stream);
+    if (m != NULL)
+        return m;
+
+    /* NOTE: If the request were not idempotent, we would not know if it
+     * was processed by the other end. Thus POST is not used/supported so
+     * far, and CONNECT is treated as if it were idempotent (which works
+     * fine here). */
+
+    /* Get rid of closing or reset connection, unless another request
+     * already did. */
+    vlc_mutex_lock(&mgr->lock);
+    vlc_http_mgr_drop(mgr, conn);
+    vlc_mutex_unlock(&mgr->lock);
+    return NULL;
+}
 
-    if (mgr->creds == NULL)
-    {   /* First TLS connection: load x509 credentials */
-        mgr->creds = vlc_tls_ClientCreate(mgr->obj);
-        if (mgr->creds == NULL)
-            return NULL;
-    }
+static
+struct vlc_http_msg *vlc_http_mgr_reuse(struct vlc_http_mgr *mgr, bool secure,
+                                        const char *host, unsigned port,
+                                        const struct vlc_http_msg *req)
+{
+    struct vlc_http_conn *conn;
 
-    /* TODO? non-idempotent request support */
-    struct vlc_http_msg *resp = vlc_http_mgr_reuse(mgr, host, port, req);
-    if (resp != NULL)
-        return resp; /* existing connection reused */
+    /* Only the stream creation is serialized: the response is waited for
+     * without the lock, so that other requests can proceed meanwhile. */
+    vlc_mutex_lock(&mgr->lock);
+    struct vlc_http_stream *stream = vlc_http_mgr_open(mgr, secure, host,
+                                                      port, req, &conn);
+    vlc_mutex_unlock(&mgr->lock);
+
+    if (stream == NULL)
+        return NULL;
+    return vlc_http_mgr_wait(mgr, stream, conn);
+}
+
+static struct vlc_http_conn *vlc_https_conn_create(vlc_object_t *obj,
+                                                   vlc_tls_creds_t *creds,
+                                                   const char *host,
+                                                   unsigned port)
+{
+    vlc_tls_t *tls;
+    bool http2 = true;
 
     char *proxy = vlc_http_proxy_find(host, port, true);
     if (proxy != NULL)
     {
-        tls = vlc_https_connect_proxy(mgr->creds, mgr->creds,
-                                      host, port, &http2, proxy);
+        tls = vlc_https_connect_proxy(creds, creds, host, port, &http2,
+                                      proxy);
         free(proxy);
     }
     else
-        tls = vlc_https_connect(mgr->creds, host, port, &http2);
+        tls = vlc_https_connect(creds, host, port, &http2);
 
     if (tls == NULL)
         return NULL;
@@ -187,29 +309,84 @@ static struct vlc_http_msg *vlc_https_request(struct vlc_http_mgr *mgr,
      * NOTE: We do not enforce TLS version 1.2 for HTTP 2.0 explicitly.
      */
     if (http2)
-        conn = vlc_h2_conn_create(mgr->obj, tls);
+        conn = vlc_h2_conn_create(obj, tls);
     else
-        conn = vlc_h1_conn_create(mgr->obj, tls, false);
+        conn = vlc_h1_conn_create(obj, tls, false);
 
     if (unlikely(conn == NULL))
-    {
         vlc_tls_Close(tls);
-        return NULL;
+    return conn;
+}
+
+static struct vlc_http_msg *vlc_https_request(struct vlc_http_mgr *mgr,
+                                              const char *host, unsigned port,
+                                              const struct vlc_http_msg *req)
+{
+    struct vlc_http_mgr_conn *c, **pp;
+    struct vlc_http_conn *conn;
+    struct vlc_http_stream *stream;
+
+    /* TODO? non-idempotent request support */
+    vlc_mutex_lock(&mgr->lock);
+    for (;;)
+    {
+        stream = vlc_http_mgr_open(mgr, true, host, port, req, &conn);
+        if (stream != NULL)
+        {   /* existing connection reused */
+            vlc_mutex_unlock(&mgr->lock);
+            return vlc_http_mgr_wait(mgr, stream, conn);
+        }
+
+        /* Wait for a pending connection to the same server, so that
+         * concurrent requests share it if it turns out multiplexed. */
+        if (!vlc_http_mgr_connecting(mgr, true, host, port))
+            break;
+        vlc_cond_wait(&mgr->wait, &mgr->lock);
     }
 
-    mgr->conn = conn;
+    if (mgr->creds == NULL)
+    {   /* First TLS connection: load x509 credentials */
+        mgr->creds = vlc_tls_ClientCreate(mgr->obj);
+        if (mgr->creds == NULL)
+        {
+            vlc_mutex_unlock(&mgr->lock);
+            return NULL;
+        }
+    }
+
+    vlc_tls_creds_t *creds = mgr->creds;
+
+    c = vlc_http_mgr_attach(mgr, NULL, true, host, port);
+    vlc_mutex_unlock(&mgr->lock);
+    if (unlikely(c == NULL))
+        return NULL;
+
+    /* Connect without the lock, so that requests to other servers are not
+     * held up by the TLS handshake. */
+    conn = vlc_https_conn_create(mgr->obj, creds, host, port);
 
-    return vlc_http_mgr_reuse(mgr, host, port, req);
+    vlc_mutex_lock(&mgr->lock);
+    c->conn = conn;
+    stream = (conn != NULL) ? vlc_http_stream_open(conn, req) : NULL;
+    if (stream == NULL)
+    {   /* The pending entry was not dropped by anybody else */
+        for (pp = &mgr->conns; *pp != c; pp = &(*pp)->next);
+        vlc_http_mgr_release(pp);
+    }
+    vlc_cond_broadcast(&mgr->wait);
+    vlc_mutex_unlock(&mgr->lock);
+
+    if (stream == NULL)
+        return NULL;
+    return vlc_http_mgr_wait(mgr, stream, conn);
 }
 
 static struct vlc_http_msg *vlc_http_request(struct vlc_http_mgr *mgr,
                                              const char *host, unsigned port,
                                              const struct vlc_http_msg *req)
 {
-    if (mgr->creds != NULL && mgr->conn != NULL)
-        return NULL; /* switch from HTTPS to HTTP not implemented */
-
-    struct vlc_http_msg *resp = vlc_http_mgr_reuse(mgr, host, port, req);
+    struct vlc_http_msg *resp = vlc_http_mgr_reuse(mgr, false, host, port,
+                                                   req);
     if (resp != NULL)
         return resp;
 
@@ -247,7 +424,15 @@ static struct vlc_http_msg *vlc_http_request(struct vlc_http_mgr *mgr,
         return NULL;
     }
 
-    mgr->conn = conn;
+    vlc_mutex_lock(&mgr->lock);
+    if (vlc_http_mgr_attach(mgr, conn, false, host, port) == NULL)
+    {
+        vlc_mutex_unlock(&mgr->lock);
+        vlc_http_conn_release(conn);
+        vlc_http_msg_destroy(resp);
+        return NULL;
+    }
+    vlc_mutex_unlock(&mgr->lock);
     return resp;
 }
 
@@ -273,15 +458,19 @@ struct vlc_http_mgr *vlc_http_mgr_create(vlc_object_t *obj,
     mgr->obj = obj;
     mgr->creds = NULL;
     mgr->jar = jar;
-    mgr->conn = NULL;
+    mgr->conns = NULL;
+    vlc_mutex_init(&mgr->lock);
+    vlc_cond_init(&mgr->wait);
     return mgr;
 }
 
 void vlc_http_mgr_destroy(struct vlc_http_mgr *mgr)
 {
-    if (mgr->conn != NULL)
-        vlc_http_mgr_release(mgr, mgr->conn);
+    while (mgr->conns != NULL)
+        vlc_http_mgr_release(&mgr->conns);
     if (mgr->creds != NULL)
         vlc_tls_Delete(mgr->creds);
+    vlc_cond_destroy(&mgr->wait);
+    vlc_mutex_destroy(&mgr->lock);
     free(mgr);
 }
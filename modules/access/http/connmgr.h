@@ -39,6 +39,10 @@ struct vlc_http_cookie_jar_t;
  * establishing a new one. If succesful, the initial HTTP response header is
  * returned.
  *
+ * Connections are kept per server, scheme and port. This function can be
+ * called from several threads at once: concurrent requests share HTTP/2
+ * connections, whereas an HTTP/1.1 connection serves one request at a time.
+ *
  * @param mgr HTTP connection manager
  * @param https whether to use HTTPS (true) or unencrypted HTTP (false)
  * @param host name of authoritative HTTP server to send the request to
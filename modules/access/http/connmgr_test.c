@@ -0,0 +1,307 @@
+/*****************************************************************************
+ * connmgr_test.c: HTTP connections manager tests
+ *****************************************************************************
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#undef NDEBUG
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+#include <vlc_network.h>
+#include <vlc_tls.h>
+#include "h2frame.h"
+#include "conn.h"
+#include "connmgr.h"
+#include "message.h"
+
+/* HTTP/2 servers, one per connection. They accept all requests and answer
+ * with headers right away; the test sends the payloads. Servers whose name
+ * starts with "old." only speak HTTP/1.1, and send the payloads themselves. */
+static struct server
+{
+    vlc_tls_t *tls;
+    char *host;
+    vlc_thread_t thread;
+    uint_fast32_t streams[4]; /**< IDs of the received requests, in order */
+    unsigned count;
+} servers[5];
+
+static unsigned connections = 0;
+static vlc_mutex_t lock = VLC_STATIC_MUTEX;
+static vlc_tls_creds_t *const fake_creds = (vlc_tls_creds_t *)&connections;
+
+static void server_send(struct server *srv, struct vlc_h2_frame *f)
+{
+    assert(f != NULL);
+
+    size_t len = vlc_h2_frame_size(f);
+    vlc_mutex_lock(&lock);
+    ssize_t val = vlc_tls_Write(srv->tls, f->data, len);
+    vlc_mutex_unlock(&lock);
+    assert((size_t)val == len);
+    free(f);
+}
+
+static void *server_thread(void *data)
+{
+    struct server *srv = data;
+    char hello[24];
+    uint8_t hdr[9];
+
+    server_send(srv, vlc_h2_frame_settings());
+
+    if (vlc_tls_Read(srv->tls, hello, 24, true) != 24)
+        return NULL;
+    assert(!memcmp(hello, "PRI * HTTP/2.0\r\n", 16));
+
+    /* Run until the client closes the connection */
+    while (vlc_tls_Read(srv->tls, hdr, 9, true) == 9)
+    {
+        size_t len = (hdr[0] << 16) | (hdr[1] << 8) | hdr[2];
+        uint_fast32_t id = ((hdr[5] & 0x7f) << 24) | (hdr[6] << 16)
+                         | (hdr[7] << 8) | hdr[8];
+
+        if (len > 0)
+        {
+            char buf[len];
+
+            if (vlc_tls_Read(srv->tls, buf, len, true) != (ssize_t)len)
+                break;
+        }
+
+        if (hdr[3] != 0x1 /* HEADERS */)
+            continue;
+
+        vlc_mutex_lock(&lock);
+        assert(srv->count < ARRAY_SIZE(srv->streams));
+        srv->streams[srv->count++] = id;
+        vlc_mutex_unlock(&lock);
+
+        struct vlc_http_msg *m = vlc_http_resp_create(200);
+        assert(m != NULL);
+        server_send(srv, vlc_http_msg_h2_frame(m, id, false));
+        vlc_http_msg_destroy(m);
+    }
+    return NULL;
+}
+
+static void *server_h1_thread(void *data)
+{
+    struct server *srv = data;
+    static const char resp[] = "HTTP/1.1 200 OK\r\n"
+                               "Content-Length: 10\r\n\r\n"
+                               "h1 payload";
+    char buf[4];
+    unsigned ends = 0;
+
+    /* Answer each request once its headers are received */
+    while (vlc_tls_Read(srv->tls, buf, 1, true) == 1)
+    {
+        if (buf[0] == (ends & 1 ? '\n' : '\r'))
+            ends++;
+        else
+            ends = buf[0] == '\r';
+
+        if (ends == 4)
+        {
+            vlc_mutex_lock(&lock);
+            srv->count++;
+            vlc_mutex_unlock(&lock);
+            assert(vlc_tls_Write(srv->tls, resp, strlen(resp))
+                   == (ssize_t)strlen(resp));
+            ends = 0;
+        }
+    }
+    return NULL;
+}
+
+static void server_data(struct server *srv, unsigned i, const char *str)
+{
+    server_send(srv, vlc_h2_frame_data(srv->streams[i], str, strlen(str),
+                                       true));
+}
+
+static void server_join(struct server *srv)
+{
+    vlc_join(srv->thread, NULL);
+    vlc_tls_SessionDelete(srv->tls);
+    free(srv->host);
+}
+
+/* Connects to the fake servers, and negotiates HTTP/2 */
+vlc_tls_t *vlc_tls_SocketOpenTLS(vlc_tls_creds_t *creds, const char *name,
+                                 unsigned port, const char *service,
+                                 const char *const *alpn, char **alp)
+{
+    vlc_tls_t *tlsv[2];
+
+    assert(creds == fake_creds);
+    assert(port == 443);
+    assert(!strcmp(service, "https"));
+    assert(alpn != NULL && !strcmp(alpn[0], "h2"));
+
+    bool h1 = !strncmp(name, "old.", 4);
+
+    if (vlc_tls_SocketPair(PF_LOCAL, 0, tlsv))
+        assert(!"socketpair");
+
+    assert(connections < ARRAY_SIZE(servers));
+    struct server *srv = &servers[connections++];
+    srv->tls = tlsv[0];
+    srv->host = strdup(name);
+    srv->count = 0;
+    assert(srv->host != NULL);
+
+    if (vlc_clone(&srv->thread, h1 ? server_h1_thread : server_thread, srv,
+                  VLC_THREAD_PRIORITY_LOW))
+        assert(!"vlc_clone");
+
+    *alp = strdup(h1 ? "http/1.1" : "h2");
+    return tlsv[1];
+}
+
+vlc_tls_creds_t *vlc_tls_ClientCreate(vlc_object_t *obj)
+{
+    (void) obj;
+    return fake_creds;
+}
+
+void vlc_tls_Delete(vlc_tls_creds_t *creds)
+{
+    assert(creds == fake_creds);
+}
+
+char *vlc_getProxyUrl(const char *url)
+{
+    (void) url;
+    return NULL;
+}
+
+static struct vlc_http_msg *request(struct vlc_http_mgr *mgr,
+                                    const char *host, const char *path)
+{
+    struct vlc_http_msg *req = vlc_http_req_create("GET", "https", host,
+                                                   path);
+    assert(req != NULL);
+
+    struct vlc_http_msg *resp = vlc_http_mgr_request(mgr, true, host, 0, req);
+    vlc_http_msg_destroy(req);
+    assert(resp != NULL);
+    assert(vlc_http_msg_get_status(resp) == 200);
+    return resp;
+}
+
+static void expect_data(struct vlc_http_msg *m, const char *str)
+{
+    block_t *b = vlc_http_msg_read(m);
+
+    assert(b != NULL);
+    assert(b->i_buffer == strlen(str));
+    assert(!memcmp(b->p_buffer, str, b->i_buffer));
+    block_Release(b);
+    assert(vlc_http_msg_read(m) == NULL);
+}
+
+int main(void)
+{
+    struct vlc_http_mgr *mgr = vlc_http_mgr_create(NULL, NULL);
+    struct vlc_http_msg *m1, *m2, *m3;
+
+    assert(mgr != NULL);
+
+    /* Requests to the same server share one connection */
+    m1 = request(mgr, "www.example.com", "/first");
+    m2 = request(mgr, "www.example.com", "/second");
+    assert(connections == 1);
+    assert(servers[0].count == 2);
+    assert(servers[0].streams[0] != servers[0].streams[1]);
+
+    /* The second response does not wait for the first one */
+    server_data(&servers[0], 1, "second payload");
+    expect_data(m2, "second payload");
+
+    m3 = request(mgr, "www.example.com", "/third");
+    assert(connections == 1);
+    assert(servers[0].count == 3);
+    server_data(&servers[0], 2, "third payload");
+    server_data(&servers[0], 0, "first payload");
+    expect_data(m3, "third payload");
+    expect_data(m1, "first payload");
+    vlc_http_msg_destroy(m3);
+    vlc_http_msg_destroy(m2);
+    vlc_http_msg_destroy(m1);
+
+    /* Another server gets its own connection */
+    m1 = request(mgr, "cdn.example.com", "/fourth");
+    assert(connections == 2);
+    assert(!strcmp(servers[1].host, "cdn.example.com"));
+    server_data(&servers[1], 0, "fourth payload");
+    expect_data(m1, "fourth payload");
+    vlc_http_msg_destroy(m1);
+
+    /* The connection to the first server is still kept */
+    m1 = request(mgr, "www.example.com", "/fifth");
+    assert(connections == 2);
+    assert(servers[0].count == 4);
+    server_data(&servers[0], 3, "fifth payload");
+    expect_data(m1, "fifth payload");
+    vlc_http_msg_destroy(m1);
+
+    /* Host names are case-insensitive */
+    m1 = request(mgr, "CDN.example.com", "/sixth");
+    assert(connections == 2);
+    vlc_http_msg_destroy(m1);
+
+    /* A busy HTTP/1.1 connection is not shared, nor dropped */
+    m1 = request(mgr, "old.example.com", "/seventh");
+    assert(connections == 3);
+    m2 = request(mgr, "old.example.com", "/eighth");
+    assert(connections == 4);
+    expect_data(m1, "h1 payload");
+    expect_data(m2, "h1 payload");
+    vlc_http_msg_destroy(m2);
+    vlc_http_msg_destroy(m1);
+
+    /* Both HTTP/1.1 connections are kept alive */
+    m1 = request(mgr, "old.example.com", "/ninth");
+    m2 = request(mgr, "old.example.com", "/tenth");
+    assert(connections == 4);
+    expect_data(m1, "h1 payload");
+    expect_data(m2, "h1 payload");
+    vlc_http_msg_destroy(m2);
+    vlc_http_msg_destroy(m1);
+    vlc_mutex_lock(&lock);
+    assert(servers[2].count == 2 && servers[3].count == 2);
+    vlc_mutex_unlock(&lock);
+
+    vlc_http_mgr_destroy(mgr);
+    for (unsigned i = 0; i < connections; i++)
+        server_join(&servers[i]);
+    return 0;
+}
@@ -100,24 +100,122 @@ static int rtp_timeout (mtime_t deadline)
     return t;
 }
 
+#ifdef HAVE_RECVMMSG
+/* Number of datagrams received per system call */
+# define RTP_BATCH 16
+#else
+# define RTP_BATCH 1
+#endif
+
 /**
- * RTP/RTCP session thread for datagram sockets
+ * Receives a batch of datagrams from the RTP socket.
+ * @param blocks pre-allocated blocks (empty slots are refilled)
+ * @return the number of received datagrams, or -1 on error
  */
-void *rtp_dgram_thread (void *opaque)
+static int rtp_recv_batch (demux_t *demux, int fd, block_t **blocks,
+                           size_t *mru)
 {
-    demux_t *demux = opaque;
-    demux_sys_t *sys = demux->p_sys;
-    mtime_t deadline = VLC_TS_INVALID;
-    int rtp_fd = sys->fd;
-    struct iovec iov =
+    struct iovec iov[RTP_BATCH];
+#ifdef HAVE_RECVMMSG
+    struct mmsghdr msgs[RTP_BATCH];
+#endif
+    unsigned n;
+
+    for (n = 0; n < RTP_BATCH; n++)
     {
-        .iov_len = DEFAULT_MRU,
-    };
+        if (blocks[n] != NULL && blocks[n]->i_buffer < *mru)
+        {   /* The MRU has grown since the allocation */
+            block_Release (blocks[n]);
+            blocks[n] = NULL;
+        }
+        if (blocks[n] == NULL)
+        {
+            blocks[n] = block_Alloc (*mru);
+            if (unlikely(blocks[n] == NULL))
+                break;
+        }
+
+        iov[n].iov_base = blocks[n]->p_buffer;
+        iov[n].iov_len = *mru;
+#ifdef HAVE_RECVMMSG
+        memset (&msgs[n], 0, sizeof (msgs[n]));
+        msgs[n].msg_hdr.msg_iov = &iov[n];
+        msgs[n].msg_hdr.msg_iovlen = 1;
+#endif
+    }
+
+    if (unlikely(n == 0))
+    {
+        if (*mru == DEFAULT_MRU)
+            return -1; /* we are totallly screwed */
+        *mru = DEFAULT_MRU;
+        return 0; /* retry with shrunk MRU */
+    }
+
+#ifdef HAVE_RECVMMSG
+    int val = recvmmsg (fd, msgs, n, MSG_DONTWAIT | MSG_TRUNC, NULL);
+#else
     struct msghdr msg =
     {
-        .msg_iov = &iov,
+        .msg_iov = iov,
         .msg_iovlen = 1,
     };
+    ssize_t len = recvmsg (fd, &msg, 0);
+    int val = (len != -1) ? 1 : -1;
+#endif
+    if (val == -1)
+    {
+        if (errno != EAGAIN)
+            msg_Warn (demux, "RTP network error: %s", vlc_strerror_c(errno));
+        return 0;
+    }
+
+    for (int i = 0; i < val; i++)
+    {
+        block_t *block = blocks[i];
+#ifdef HAVE_RECVMMSG
+        size_t len = msgs[i].msg_len;
+        int flags = msgs[i].msg_hdr.msg_flags;
+#else
+        int flags = msg.msg_flags;
+#endif
+
+        blocks[i] = NULL;
+#ifdef MSG_TRUNC
+        if (flags & MSG_TRUNC)
+        {
+            msg_Err(demux, "%zu bytes packet truncated (MRU was %zu)",
+                    (size_t)len, *mru);
+            block->i_flags |= BLOCK_FLAG_CORRUPTED;
+            if ((size_t)len > *mru)
+                *mru = len;
+        }
+        else
+#endif
+            block->i_buffer = len;
+#ifndef MSG_TRUNC
+        VLC_UNUSED(flags);
+#endif
+        rtp_process (demux, block);
+    }
+    return val;
+}
+
+static void rtp_batch_cleanup (void *data)
+{
+    block_t **blocks = data;
+
+    for (unsigned i = 0; i < RTP_BATCH; i++)
+        if (blocks[i] != NULL)
+            block_Release (blocks[i]);
+}
+
+static void rtp_dgram_loop (demux_t *demux, block_t **blocks)
+{
+    demux_sys_t *sys = demux->p_sys;
+    mtime_t deadline = VLC_TS_INVALID;
+    int rtp_fd = sys->fd;
+    size_t mru = DEFAULT_MRU;
 
     struct pollfd ufd[1];
     ufd[0].fd = rtp_fd;
@@ -137,46 +235,15 @@ void *rtp_dgram_thread (void *opaque)
         {
             n--;
             if (unlikely(ufd[0].revents & POLLHUP))
-                break; /* RTP socket dead (DCCP only) */
-
-            block_t *block = block_Alloc (iov.iov_len);
-            if (unlikely(block == NULL))
             {
-                if (iov.iov_len == DEFAULT_MRU)
-                    break; /* we are totallly screwed */
-                iov.iov_len = DEFAULT_MRU;
-                continue; /* retry with shrunk MRU */
+                vlc_restorecancel (canc);
+                break; /* RTP socket dead (DCCP only) */
             }
 
-            iov.iov_base = block->p_buffer;
-#ifdef __linux__
-            msg.msg_flags = MSG_TRUNC;
-#else
-            msg.msg_flags = 0;
-#endif
-
-            ssize_t len = recvmsg (rtp_fd, &msg, 0);
-            if (len != -1)
+            if (rtp_recv_batch (demux, rtp_fd, blocks, &mru) < 0)
             {
-#ifdef MSG_TRUNC
-                if (msg.msg_flags & MSG_TRUNC)
-                {
-                    msg_Err(demux, "%zd bytes packet truncated (MRU was %zu)",
-                            len, iov.iov_len);
-                    block->i_flags |= BLOCK_FLAG_CORRUPTED;
-                    iov.iov_len = len;
-                }
-                else
-#endif
-                    block->i_buffer = len;
-
-                rtp_process (demux, block);
-            }
-            else
-            {
-                msg_Warn (demux, "RTP network error: %s",
-                          vlc_strerror_c(errno));
-                block_Release (block);
+                vlc_restorecancel (canc);
+                break;
             }
         }
 
@@ -185,6 +252,22 @@ void *rtp_dgram_thread (void *opaque)
             deadline = VLC_TS_INVALID;
         vlc_restorecancel (canc);
     }
+}
+
+/**
+ * RTP/RTCP session thread for datagram sockets
+ */
+void *rtp_dgram_thread (void *opaque)
+{
+    demux_t *demux = opaque;
+    block_t *blocks[RTP_BATCH] = { NULL };
+
+    /* The receive buffers are kept across polls: free them on cancellation */
+    vlc_cleanup_push (rtp_batch_cleanup, blocks);
+    rtp_dgram_loop (demux, blocks);
+    vlc_cleanup_pop ();
+
+    rtp_batch_cleanup (blocks);
     return NULL;
 }
 
@@ -0,0 +1,175 @@
+/*
+ * Secure RTP with libgcrypt: loopback benchmark
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stddef.h>
+#include "srtp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#undef NDEBUG
+#include <assert.h>
+
+#define PACKETS  20000
+#define TAG_LEN  10
+#define PAYLOAD  (7 * 188)
+
+static uint64_t now_ns (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * UINT64_C(1000000000) + ts.tv_nsec;
+}
+
+static void set_key (srtp_session_t *s)
+{
+    static const char key[] =
+        "123456789ABCDEF0" "123456789ABCDEF0";
+    static const char salt[] =
+        "1234567890" "1234567890" "12345678";
+
+    int val = srtp_setkeystring (s, key, salt);
+    assert (val == 0);
+}
+
+static void make_packet (uint8_t *buf, uint16_t seq)
+{
+    buf[0] = 0x80;
+    buf[1] = 33;
+    buf[2] = seq >> 8;
+    buf[3] = seq;
+    memset (buf + 4, 0, 8);
+    for (unsigned i = 0; i < PAYLOAD; i++)
+        buf[12 + i] = i + seq;
+}
+
+/* Encrypts and decrypts RTP packets, either in place, or after copying each
+ * packet into a bigger buffer (as done when the tail room is missing). */
+static uint64_t bench_rtp (bool copy)
+{
+    srtp_session_t *se = srtp_create (SRTP_ENCR_AES_CM, SRTP_AUTH_HMAC_SHA1,
+                                      TAG_LEN, SRTP_PRF_AES_CM, 0);
+    srtp_session_t *sd = srtp_create (SRTP_ENCR_AES_CM, SRTP_AUTH_HMAC_SHA1,
+                                      TAG_LEN, SRTP_PRF_AES_CM, 0);
+    assert (se != NULL && sd != NULL);
+    set_key (se);
+    set_key (sd);
+
+    uint8_t *in = malloc (12 + PAYLOAD + TAG_LEN);
+    assert (in != NULL);
+
+    uint64_t total = 0;
+
+    for (unsigned i = 0; i < PACKETS; i++)
+    {
+        uint8_t *buf = in;
+        size_t len = 12 + PAYLOAD;
+
+        make_packet (in, i);
+
+        uint64_t start = now_ns ();
+        if (copy)
+        {
+            buf = malloc (len + TAG_LEN);
+            assert (buf != NULL);
+            memcpy (buf, in, len);
+        }
+        int val = srtp_send (se, buf, &len, 12 + PAYLOAD + TAG_LEN);
+        total += now_ns () - start;
+        assert (val == 0);
+        assert (len == 12 + PAYLOAD + TAG_LEN);
+
+        val = srtp_recv (sd, buf, &len);
+        assert (val == 0);
+        assert (len == 12 + PAYLOAD);
+        for (unsigned j = 0; j < PAYLOAD; j++)
+            assert (buf[12 + j] == (uint8_t)(j + i));
+
+        if (copy)
+            free (buf);
+    }
+
+    free (in);
+    srtp_destroy (sd);
+    srtp_destroy (se);
+    return total / PACKETS;
+}
+
+static uint64_t bench_rtcp (void)
+{
+    srtp_session_t *se = srtp_create (SRTP_ENCR_AES_CM, SRTP_AUTH_HMAC_SHA1,
+                                      TAG_LEN, SRTP_PRF_AES_CM, 0);
+    srtp_session_t *sd = srtp_create (SRTP_ENCR_AES_CM, SRTP_AUTH_HMAC_SHA1,
+                                      TAG_LEN, SRTP_PRF_AES_CM, 0);
+    assert (se != NULL && sd != NULL);
+    set_key (se);
+    set_key (sd);
+
+    uint8_t buf[64 + 4 + TAG_LEN];
+    uint64_t total = 0;
+
+    for (unsigned i = 0; i < PACKETS; i++)
+    {
+        size_t len = 64;
+
+        /* Sender Report with padding bytes */
+        memset (buf, i, len);
+        buf[0] = 0x80;
+        buf[1] = 200;
+        buf[2] = 0;
+        buf[3] = 15;
+
+        uint64_t start = now_ns ();
+        int val = srtcp_send (se, buf, &len, sizeof (buf));
+        total += now_ns () - start;
+        assert (val == 0);
+        assert (len == 64 + 4 + TAG_LEN);
+
+        val = srtcp_recv (sd, buf, &len);
+        assert (val == 0);
+        assert (len == 64);
+        assert (buf[1] == 200 && buf[63] == (uint8_t)i);
+    }
+
+    srtp_destroy (sd);
+    srtp_destroy (se);
+    return total / PACKETS;
+}
+
+int main (void)
+{
+    uint64_t inplace = bench_rtp (false);
+    uint64_t copy = bench_rtp (true);
+    uint64_t rtcp = bench_rtcp ();
+
+    printf ("SRTP protect (%u bytes): %"PRIu64" ns in place, "
+            "%"PRIu64" ns with copy\n", 12 + PAYLOAD, inplace, copy);
+    printf ("SRTCP protect: %"PRIu64" ns\n", rtcp);
+    return 0;
+}
@@ -757,7 +757,7 @@ static int srtcp_crypt (srtp_session_t *s, uint8_t *buf, size_t len)
     uint32_t ssrc;
     memcpy (&ssrc, buf + 4, 4);
 
-    if (rtcp_crypt (s->rtcp.cipher, ssrc, index, s->rtp.salt,
+    if (rtcp_crypt (s->rtcp.cipher, ssrc, index, s->rtcp.salt,
                     buf + 8, len - 8))
         return EINVAL;
     return 0;
@@ -832,6 +832,6 @@ srtcp_recv (srtp_session_t *s, uint8_t *buf, size_t *lenp)
 
     len -= 4; /* Remove SRTCP index before decryption */
     *lenp = len;
-    return srtp_crypt (s, buf, len);
+    return srtcp_crypt (s, buf, len);
 }
 
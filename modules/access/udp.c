@@ -37,6 +37,7 @@
 #endif
 
 #include <errno.h>
+#include <time.h>
 #include <vlc_common.h>
 #include <vlc_plugin.h>
 #include <vlc_access.h>
@@ -59,6 +60,10 @@ static void Close( vlc_object_t * );
 #define BUFFER_TEXT N_("Receive buffer")
 #define BUFFER_LONGTEXT N_("UDP receive buffer size (bytes)" )
 #define TIMEOUT_TEXT N_("UDP Source timeout (sec)")
+#define TIMESTAMPS_TEXT N_("Kernel receive timestamps")
+#define TIMESTAMPS_LONGTEXT N_( \
+    "Timestamp received packets in the kernel (if supported), and set " \
+    "the timestamps of the data blocks accordingly." )
 
 vlc_module_begin ()
     set_shortname( N_("UDP" ) )
@@ -69,6 +74,8 @@ vlc_module_begin ()
     add_obsolete_integer( "server-port" ) /* since 2.0.0 */
     add_obsolete_integer( "udp-buffer" ) /* since 3.0.0 */
     add_integer( "udp-timeout", -1, TIMEOUT_TEXT, NULL, true )
+    add_bool( "udp-timestamps", false, TIMESTAMPS_TEXT, TIMESTAMPS_LONGTEXT,
+              true )
 
     set_capability( "access", 0 )
     add_shortcut( "udp", "udpstream", "udp4", "udp6" )
@@ -76,11 +83,54 @@ vlc_module_begin ()
     set_callbacks( Open, Close )
 vlc_module_end ()
 
+#ifdef HAVE_RECVMMSG
+/* Number of datagrams received per system call */
+# define UDP_BATCH 32
+typedef struct mmsghdr udp_msg_t;
+#else
+# define UDP_BATCH 1
+typedef struct
+{
+    struct msghdr msg_hdr;
+    unsigned int msg_len;
+} udp_msg_t;
+#endif
+
+#if defined (SO_TIMESTAMPNS) || defined (SO_RXQ_OVFL)
+# define UDP_CMSG 1
+#endif
+
 struct access_sys_t
 {
     int fd;
     int timeout;
     size_t mtu;
+    bool timestamps;
+
+    /* Pre-allocated packets, and received ones from head to count */
+    unsigned head;
+    unsigned count;
+    block_t *pkts[UDP_BATCH];
+    udp_msg_t msgs[UDP_BATCH];
+    struct iovec iovs[UDP_BATCH];
+#ifdef UDP_CMSG
+    union
+    {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(sizeof (struct timespec))
+               + CMSG_SPACE(sizeof (uint32_t))];
+    } cmsgs[UDP_BATCH];
+#endif
+
+    /* Statistics */
+    uint64_t received; /**< Received datagrams */
+    uint64_t calls; /**< Receive system calls */
+    uint64_t overruns; /**< Receive calls filling the whole batch */
+    uint64_t truncated; /**< Datagrams larger than the MTU */
+    uint32_t kernel_drops; /**< Datagrams dropped by the socket */
+    mtime_t last_arrival;
+    mtime_t last_interval;
+    mtime_t jitter; /**< Mean deviation of the inter-arrival time */
 };
 
 /*****************************************************************************
@@ -100,7 +150,7 @@ static int Open( vlc_object_t *p_this )
     if( p_access->b_preparsing )
         return VLC_EGENERIC;
 
-    sys = vlc_malloc( p_this, sizeof( *sys ) );
+    sys = vlc_calloc( p_this, 1, sizeof( *sys ) );
     if( unlikely( sys == NULL ) )
         return VLC_ENOMEM;
 
@@ -174,6 +224,29 @@ static int Open( vlc_object_t *p_this )
     if( sys->timeout > 0)
         sys->timeout *= 1000;
 
+    sys->timestamps = false;
+#ifdef SO_TIMESTAMPNS
+    if( var_InheritBool( p_access, "udp-timestamps" ) )
+        sys->timestamps = setsockopt( sys->fd, SOL_SOCKET, SO_TIMESTAMPNS,
+                                      &(int){ 1 }, sizeof (int) ) == 0;
+#endif
+#ifdef SO_RXQ_OVFL
+    setsockopt( sys->fd, SOL_SOCKET, SO_RXQ_OVFL, &(int){ 1 }, sizeof (int) );
+#endif
+
+    /* Allocate the packets for the first batch now */
+    for( unsigned i = 0; i < UDP_BATCH; i++ )
+    {
+        sys->pkts[i] = block_Alloc( sys->mtu );
+        if( unlikely(sys->pkts[i] == NULL) )
+        {
+            Close( p_this );
+            return VLC_ENOMEM;
+        }
+    }
+    sys->head = sys->count = 0;
+    sys->last_arrival = VLC_TS_INVALID;
+
     return VLC_SUCCESS;
 }
 
@@ -185,6 +258,16 @@ static void Close( vlc_object_t *p_this )
     stream_t     *p_access = (stream_t*)p_this;
     access_sys_t *sys = p_access->p_sys;
 
+    if( sys->calls > 0 )
+        msg_Dbg( p_access, "received %"PRIu64" datagrams in %"PRIu64" calls "
+                 "(%"PRIu64" full batches), %"PRIu64" truncated, %"PRIu32
+                 " dropped, jitter %"PRId64" us", sys->received, sys->calls,
+                 sys->overruns, sys->truncated, sys->kernel_drops,
+                 sys->jitter );
+
+    for( unsigned i = 0; i < UDP_BATCH; i++ )
+        if( sys->pkts[i] != NULL )
+            block_Release( sys->pkts[i] );
     net_Close( sys->fd );
 }
 
@@ -219,62 +302,213 @@ static int Control( stream_t *p_access, int i_query, va_list args )
 }
 
 /*****************************************************************************
- * BlockUDP:
+ * Receive: receive a batch of datagrams
  *****************************************************************************/
-static block_t *BlockUDP(stream_t *access, bool *restrict eof)
+static int Receive(stream_t *access)
 {
     access_sys_t *sys = access->p_sys;
+    unsigned n;
 
-    block_t *pkt = block_Alloc(sys->mtu);
-    if (unlikely(pkt == NULL))
+    /* Replace the packets returned by the previous batch */
+    for (n = 0; n < UDP_BATCH; n++)
+    {
+        block_t *pkt = sys->pkts[n];
+
+        if (pkt != NULL && pkt->i_buffer < sys->mtu)
+        {   /* The MTU has grown since the allocation */
+            block_Release(pkt);
+            pkt = NULL;
+        }
+        if (pkt == NULL)
+        {
+            pkt = block_Alloc(sys->mtu);
+            sys->pkts[n] = pkt;
+            if (unlikely(pkt == NULL))
+                break;
+        }
+
+        udp_msg_t *msg = &sys->msgs[n];
+
+        sys->iovs[n].iov_base = pkt->p_buffer;
+        sys->iovs[n].iov_len = sys->mtu;
+        memset(msg, 0, sizeof (*msg));
+        msg->msg_hdr.msg_iov = &sys->iovs[n];
+        msg->msg_hdr.msg_iovlen = 1;
+#ifdef UDP_CMSG
+        msg->msg_hdr.msg_control = sys->cmsgs[n].buf;
+        msg->msg_hdr.msg_controllen = sizeof (sys->cmsgs[n].buf);
+#endif
+    }
+
+    if (unlikely(n == 0))
     {   /* OOM - dequeue and discard one packet */
         char dummy;
         recv(sys->fd, &dummy, 1, 0);
-        return NULL;
+        return -1;
     }
 
-    struct iovec iov = {
-        .iov_base = pkt->p_buffer,
-        .iov_len = sys->mtu,
-    };
-    struct msghdr msg = {
-        .msg_iov = &iov,
-        .msg_iovlen = 1,
-#ifdef __linux__
-        .msg_flags = MSG_TRUNC,
+#ifdef HAVE_RECVMMSG
+    int val = recvmmsg(sys->fd, sys->msgs, n, MSG_DONTWAIT | MSG_TRUNC,
+                       NULL);
+    if (val <= 0)
+        return -1;
+#else
+    ssize_t len = recvmsg(sys->fd, &sys->msgs[0].msg_hdr, 0);
+    if (len < 0)
+        return -1;
+    sys->msgs[0].msg_len = len;
+
+    int val = 1;
 #endif
-    };
+    sys->calls++;
+    sys->received += val;
+    if ((unsigned)val == UDP_BATCH && UDP_BATCH > 1)
+        sys->overruns++;
+    return val;
+}
 
-    struct pollfd ufd[1];
+/**
+ * Processes the ancillary data of a received datagram.
+ *
+ * @return the reception time, or VLC_TS_INVALID if unknown.
+ */
+static mtime_t ParseControl(stream_t *access, struct msghdr *msg,
+                            mtime_t offset)
+{
+    access_sys_t *sys = access->p_sys;
+    mtime_t date = VLC_TS_INVALID;
 
-    ufd[0].fd = sys->fd;
-    ufd[0].events = POLLIN;
+#ifdef UDP_CMSG
+    if (msg->msg_controllen == 0)
+        return VLC_TS_INVALID;
 
-    switch (vlc_poll_i11e(ufd, 1, sys->timeout))
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg);
+         cmsg != NULL;
+         cmsg = CMSG_NXTHDR(msg, cmsg))
     {
-        case 0:
-            msg_Err(access, "receive time-out");
-            *eof = true;
-            /* fall through */
-        case -1:
-            goto skip;
-     }
-
-    ssize_t len = recvmsg(sys->fd, &msg, 0);
-    if (len < 0)
+        if (cmsg->cmsg_level != SOL_SOCKET)
+            continue;
+
+# ifdef SO_TIMESTAMPNS
+        if (cmsg->cmsg_type == SCM_TIMESTAMPNS)
+        {
+            struct timespec ts;
+
+            memcpy(&ts, CMSG_DATA(cmsg), sizeof (ts));
+            date = (ts.tv_sec * CLOCK_FREQ)
+                 + (ts.tv_nsec / (1000000000 / CLOCK_FREQ)) + offset;
+        }
+# endif
+# ifdef SO_RXQ_OVFL
+        if (cmsg->cmsg_type == SO_RXQ_OVFL)
+        {
+            uint32_t drops;
+
+            memcpy(&drops, CMSG_DATA(cmsg), sizeof (drops));
+            if (drops != sys->kernel_drops)
+            {
+                msg_Warn(access, "%"PRIu32" datagrams dropped (receive "
+                         "buffer overrun)", drops - sys->kernel_drops);
+                sys->kernel_drops = drops;
+            }
+        }
+# endif
+    }
+#else
+    VLC_UNUSED(access); VLC_UNUSED(msg); VLC_UNUSED(offset);
+#endif
+    return date;
+}
+
+/**
+ * Updates the inter-arrival jitter estimate (RFC 3550 smoothing).
+ */
+static void UpdateJitter(access_sys_t *sys, mtime_t date)
+{
+    if (sys->last_arrival != VLC_TS_INVALID)
     {
-skip:
-        block_Release(pkt);
-        return NULL;
+        mtime_t interval = date - sys->last_arrival;
+        mtime_t deviation = interval - sys->last_interval;
+
+        if (deviation < 0)
+            deviation = -deviation;
+        sys->jitter += (deviation - sys->jitter) / 16;
+        sys->last_interval = interval;
+    }
+    sys->last_arrival = date;
+}
+
+/*****************************************************************************
+ * BlockUDP:
+ *****************************************************************************/
+static block_t *BlockUDP(stream_t *access, bool *restrict eof)
+{
+    access_sys_t *sys = access->p_sys;
+
+    if (sys->head >= sys->count)
+    {   /* All received packets were returned: receive a new batch */
+        struct pollfd ufd[1];
+
+        ufd[0].fd = sys->fd;
+        ufd[0].events = POLLIN;
+
+        switch (vlc_poll_i11e(ufd, 1, sys->timeout))
+        {
+            case 0:
+                msg_Err(access, "receive time-out");
+                *eof = true;
+                /* fall through */
+            case -1:
+                return NULL;
+        }
+
+        int val = Receive(access);
+        if (val <= 0)
+            return NULL;
+
+        sys->head = 0;
+        sys->count = val;
+
+        /* Offset from the real-time clock to the monotonic clock */
+        mtime_t now = mdate(), offset = 0;
+        if (sys->timestamps)
+        {
+            struct timespec ts;
+
+            clock_gettime(CLOCK_REALTIME, &ts);
+            offset = now - ((ts.tv_sec * CLOCK_FREQ)
+                          + (ts.tv_nsec / (1000000000 / CLOCK_FREQ)));
+        }
+
+        for (int i = 0; i < val; i++)
+        {
+            mtime_t date = ParseControl(access, &sys->msgs[i].msg_hdr,
+                                        offset);
+            block_t *pkt = sys->pkts[i];
+
+            if (date != VLC_TS_INVALID)
+                pkt->i_pts = pkt->i_dts = date;
+            else
+                date = now;
+            UpdateJitter(sys, date);
+        }
     }
 
+    block_t *pkt = sys->pkts[sys->head];
+    udp_msg_t *msg = &sys->msgs[sys->head];
+    size_t len = msg->msg_len;
+
+    sys->pkts[sys->head++] = NULL;
+
 #ifdef MSG_TRUNC
-    if (msg.msg_flags & MSG_TRUNC)
+    if (msg->msg_hdr.msg_flags & MSG_TRUNC)
     {
-        msg_Err(access, "%zd bytes packet truncated (MTU was %zu)",
+        msg_Err(access, "%zu bytes packet truncated (MTU was %zu)",
                 len, sys->mtu);
         pkt->i_flags |= BLOCK_FLAG_CORRUPTED;
-        sys->mtu = len;
+        sys->truncated++;
+        if (len > sys->mtu)
+            sys->mtu = len;
     }
     else
 #endif
@@ -306,6 +306,13 @@ static void Close( vlc_object_t * p_this )
 {
     sout_access_out_t       *p_access = (sout_access_out_t*)p_this;
     sout_access_out_sys_t   *p_sys = p_access->p_sys;
+    uint64_t i_overruns, i_dropped;
+
+    httpd_StreamGetStats( p_sys->p_httpd_stream, &i_overruns, &i_dropped );
+    if( i_overruns > 0 )
+        msg_Warn( p_access, "%"PRIu64" client buffer overruns, "
+                  "%"PRIu64" clients dropped after repeated overruns",
+                  i_overruns, i_dropped );
 
     httpd_StreamDelete( p_sys->p_httpd_stream );
     httpd_HostDelete( p_sys->p_httpd_host );
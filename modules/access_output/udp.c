@@ -46,11 +46,24 @@
 #else
 #   include <sys/socket.h>
 #endif
+#ifdef __linux__
+#   include <netinet/udp.h>
+#   ifndef UDP_SEGMENT
+#       define UDP_SEGMENT 103
+#   endif
+#endif
 
 #include <vlc_network.h>
 
 #define MAX_EMPTY_BLOCKS 200
 
+/* Maximum number of packets sent with a single system call */
+#ifdef HAVE_SENDMMSG
+#   define UDP_BATCH 64
+#else
+#   define UDP_BATCH 1
+#endif
+
 /*****************************************************************************
  * Module descriptor
  *****************************************************************************/
@@ -71,6 +84,11 @@ static void Close( vlc_object_t * );
                           "helps reducing the scheduling load on " \
                           "heavily-loaded systems." )
 
+#define QUANTUM_TEXT N_("Pacing quantum (ms)")
+#define QUANTUM_LONGTEXT N_( \
+    "Packets due within this delay are sent together, in as few system " \
+    "calls as possible. 0 only groups late packets." )
+
 vlc_module_begin ()
     set_description( N_("UDP stream output") )
     set_shortname( "UDP" )
@@ -79,6 +97,9 @@ vlc_module_begin ()
     add_integer( SOUT_CFG_PREFIX "caching", DEFAULT_PTS_DELAY / 1000, CACHING_TEXT, CACHING_LONGTEXT, true )
     add_integer( SOUT_CFG_PREFIX "group", 1, GROUP_TEXT, GROUP_LONGTEXT,
                                  true )
+    add_integer( SOUT_CFG_PREFIX "quantum", 1, QUANTUM_TEXT,
+                 QUANTUM_LONGTEXT, true )
+        change_integer_range( 0, 100 )
 
     set_capability( "sout access", 0 )
     add_shortcut( "udp" )
@@ -92,6 +113,7 @@ vlc_module_end ()
 static const char *const ppsz_sout_options[] = {
     "caching",
     "group",
+    "quantum",
     NULL
 };
 
@@ -112,8 +134,10 @@ static block_t *NewUDPPacket( sout_access_out_t *, mtime_t );
 struct sout_access_out_sys_t
 {
     mtime_t       i_caching;
+    mtime_t       i_quantum;
     int           i_handle;
     bool          b_mtu_warning;
+    bool          b_gso;
     size_t        i_mtu;
 
     block_fifo_t *p_fifo;
@@ -121,6 +145,12 @@ struct sout_access_out_sys_t
     block_t      *p_buffer;
 
     vlc_thread_t  thread;
+
+    /* Statistics (written by the thread only) */
+    uint64_t      i_packets;
+    uint64_t      i_bytes;
+    uint64_t      i_calls;
+    uint64_t      i_errors;
 };
 
 #define DEFAULT_PORT 1234
@@ -206,9 +236,14 @@ static int Open( vlc_object_t *p_this )
 
     p_sys->i_caching = UINT64_C(1000)
                      * var_GetInteger( p_access, SOUT_CFG_PREFIX "caching");
+    p_sys->i_quantum = UINT64_C(1000)
+                     * var_GetInteger( p_access, SOUT_CFG_PREFIX "quantum");
     p_sys->i_handle = i_handle;
     p_sys->i_mtu = var_CreateGetInteger( p_this, "mtu" );
     p_sys->b_mtu_warning = false;
+    p_sys->b_gso = true;
+    p_sys->i_packets = p_sys->i_bytes = 0;
+    p_sys->i_calls = p_sys->i_errors = 0;
     p_sys->p_fifo = block_FifoNew();
     p_sys->p_empty_blocks = block_FifoNew();
     p_sys->p_buffer = NULL;
@@ -240,6 +275,9 @@ static void Close( vlc_object_t * p_this )
 
     vlc_cancel( p_sys->thread );
     vlc_join( p_sys->thread, NULL );
+    msg_Dbg( p_access, "sent %"PRIu64" packets, %"PRIu64" bytes in %"PRIu64
+             " calls, %"PRIu64" errors", p_sys->i_packets, p_sys->i_bytes,
+             p_sys->i_calls, p_sys->i_errors );
     block_FifoRelease( p_sys->p_fifo );
     block_FifoRelease( p_sys->p_empty_blocks );
 
@@ -381,11 +419,106 @@ static block_t *NewUDPPacket( sout_access_out_t *p_access, mtime_t i_dts)
 }
 
 /*****************************************************************************
- * ThreadWrite: Write a packet on the network at the good time.
+ * SendPackets: send packets in as few system calls as possible.
+ *****************************************************************************
+ * Returns the number of packets sent, or -1 on error.
  *****************************************************************************/
-static void* ThreadWrite( void *data )
+static int SendPackets( sout_access_out_sys_t *p_sys, block_t *const *pp_pk,
+                        unsigned i_count )
+{
+    int fd = p_sys->i_handle;
+
+#if defined (UDP_SEGMENT) && defined (HAVE_SENDMMSG)
+    if( p_sys->b_gso && i_count > 1 )
+    {   /* Equal size packets (but the last one) are segmented by the kernel
+         * or the network device. */
+        size_t i_size = pp_pk[0]->i_buffer;
+        unsigned i_max = __MIN( i_count, 64 );
+        unsigned k = 1;
+
+        if( i_size > 0 && i_max > 65000 / i_size )
+            i_max = 65000 / i_size;
+        while( k < i_max && pp_pk[k]->i_buffer == i_size )
+            k++;
+        if( k < i_max && pp_pk[k]->i_buffer < i_size )
+            k++;
+
+        if( k > 1 )
+        {
+            struct iovec iov[k];
+            union
+            {
+                struct cmsghdr hdr;
+                char buf[CMSG_SPACE(sizeof (uint16_t))];
+            } cmsg;
+            struct msghdr msg = {
+                .msg_iov = iov,
+                .msg_iovlen = k,
+                .msg_control = cmsg.buf,
+                .msg_controllen = sizeof (cmsg.buf),
+            };
+            struct cmsghdr *c = CMSG_FIRSTHDR( &msg );
+            uint16_t i_segment = i_size;
+
+            for( unsigned i = 0; i < k; i++ )
+            {
+                iov[i].iov_base = pp_pk[i]->p_buffer;
+                iov[i].iov_len = pp_pk[i]->i_buffer;
+            }
+            c->cmsg_level = IPPROTO_UDP;
+            c->cmsg_type = UDP_SEGMENT;
+            c->cmsg_len = CMSG_LEN(sizeof (i_segment));
+            memcpy( CMSG_DATA(c), &i_segment, sizeof (i_segment) );
+
+            if( sendmsg( fd, &msg, 0 ) >= 0 )
+                return k;
+            if( errno != EIO && errno != EINVAL && errno != ENOPROTOOPT
+             && errno != EOPNOTSUPP )
+                return -1;
+            /* Not supported by the kernel or the device: do not retry */
+            p_sys->b_gso = false;
+        }
+    }
+#endif
+#ifdef HAVE_SENDMMSG
+    struct mmsghdr msgs[i_count];
+    struct iovec iov[i_count];
+
+    for( unsigned i = 0; i < i_count; i++ )
+    {
+        iov[i].iov_base = pp_pk[i]->p_buffer;
+        iov[i].iov_len = pp_pk[i]->i_buffer;
+        memset( &msgs[i], 0, sizeof (msgs[i]) );
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    return sendmmsg( fd, msgs, i_count, 0 );
+#else
+    VLC_UNUSED(i_count);
+    return (send( fd, pp_pk[0]->p_buffer, pp_pk[0]->i_buffer, 0 ) == -1)
+           ? -1 : 1;
+#endif
+}
+
+typedef struct
+{
+    unsigned i_count;
+    block_t *pp_pk[UDP_BATCH];
+    block_t *p_pending; /* dequeued, but not due yet */
+} udp_batch_t;
+
+static void BatchCleanup( void *data )
+{
+    udp_batch_t *p_batch = data;
+
+    for( unsigned i = 0; i < p_batch->i_count; i++ )
+        block_Release( p_batch->pp_pk[i] );
+    if( p_batch->p_pending != NULL )
+        block_Release( p_batch->p_pending );
+}
+
+static void ThreadLoop( sout_access_out_t *p_access, udp_batch_t *p_batch )
 {
-    sout_access_out_t *p_access = data;
     sout_access_out_sys_t *p_sys = p_access->p_sys;
     mtime_t i_date_last = -1;
     const unsigned i_group = var_GetInteger( p_access,
@@ -395,9 +528,13 @@ static void* ThreadWrite( void *data )
 
     for (;;)
     {
-        block_t *p_pk = block_FifoGet( p_sys->p_fifo );
+        block_t *p_pk = p_batch->p_pending;
         mtime_t       i_date, i_sent;
 
+        p_batch->p_pending = NULL;
+        if( p_pk == NULL )
+            p_pk = block_FifoGet( p_sys->p_fifo );
+
         i_date = p_sys->i_caching + p_pk->i_dts;
         if( i_date_last > 0 )
         {
@@ -421,16 +558,68 @@ static void* ThreadWrite( void *data )
             }
         }
 
-        block_cleanup_push( p_pk );
+        p_batch->pp_pk[0] = p_pk;
+        p_batch->i_count = 1;
         i_to_send--;
         if( !i_to_send || (p_pk->i_flags & BLOCK_FLAG_CLOCK) )
         {
             mwait( i_date );
             i_to_send = i_group;
         }
-        if ( send( p_sys->i_handle, p_pk->p_buffer, p_pk->i_buffer, 0 ) == -1 )
-            msg_Warn( p_access, "send error: %s", vlc_strerror_c(errno) );
-        vlc_cleanup_pop();
+        i_date_last = i_date;
+
+        /* Gather the following packets due within the pacing quantum.
+         * Packets which should have been waited for (PCR, group boundary)
+         * are sent at once only if they are due already. */
+        const mtime_t i_deadline = mdate() + p_sys->i_quantum;
+
+        while( p_batch->i_count < UDP_BATCH )
+        {
+            vlc_fifo_Lock( p_sys->p_fifo );
+            p_pk = vlc_fifo_DequeueUnlocked( p_sys->p_fifo );
+            vlc_fifo_Unlock( p_sys->p_fifo );
+            if( p_pk == NULL )
+                break;
+
+            i_date = p_sys->i_caching + p_pk->i_dts;
+
+            const bool b_wait = i_to_send == 1
+                             || (p_pk->i_flags & BLOCK_FLAG_CLOCK);
+            if( i_date > i_deadline || i_date - i_date_last > 2000000
+             || (b_wait && i_date > mdate()) )
+            {
+                p_batch->p_pending = p_pk;
+                break;
+            }
+
+            p_batch->pp_pk[p_batch->i_count++] = p_pk;
+            if( !--i_to_send )
+                i_to_send = i_group;
+            i_date_last = i_date;
+        }
+
+        int canc = vlc_savecancel();
+        for( unsigned i = 0; i < p_batch->i_count; )
+        {
+            int val = SendPackets( p_sys, p_batch->pp_pk + i,
+                                   p_batch->i_count - i );
+
+            p_sys->i_calls++;
+            if( val < 0 )
+            {
+                msg_Warn( p_access, "send error: %s", vlc_strerror_c(errno) );
+                p_sys->i_errors++;
+                val = 1; /* skip the packet */
+            }
+            else
+            {
+                for( int j = 0; j < val; j++ )
+                    p_sys->i_bytes += p_batch->pp_pk[i + j]->i_buffer;
+                p_sys->i_packets += val;
+            }
+            i += val;
+        }
+        vlc_restorecancel( canc );
 
         if( i_dropped_packets )
         {
@@ -440,16 +629,28 @@ static void* ThreadWrite( void *data )
 
 #if 1
         i_sent = mdate();
-        if ( i_sent > i_date + 20000 )
+        if ( i_sent > i_date_last + 20000 )
         {
             msg_Dbg( p_access, "packet has been sent too late (%"PRId64 ")",
-                     i_sent - i_date );
+                     i_sent - i_date_last );
         }
 #endif
 
-        block_FifoPut( p_sys->p_empty_blocks, p_pk );
-
-        i_date_last = i_date;
+        for( unsigned i = 0; i < p_batch->i_count; i++ )
+            block_FifoPut( p_sys->p_empty_blocks, p_batch->pp_pk[i] );
+        p_batch->i_count = 0;
     }
+}
+
+/*****************************************************************************
+ * ThreadWrite: Write a packet on the network at the good time.
+ *****************************************************************************/
+static void* ThreadWrite( void *data )
+{
+    udp_batch_t batch = { .i_count = 0, .p_pending = NULL };
+
+    vlc_cleanup_push( BatchCleanup, &batch );
+    ThreadLoop( data, &batch );
+    vlc_cleanup_pop();
     return NULL;
 }
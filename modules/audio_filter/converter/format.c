@@ -39,26 +39,61 @@
 #include <vlc_aout.h>
 #include <vlc_block.h>
 #include <vlc_filter.h>
+#include <vlc_cpu.h>
+#include <vlc_rand.h>
+
+#ifdef HAVE_SSE2_INTRINSICS
+# include <emmintrin.h>
+#endif
 
 /*****************************************************************************
  * Module descriptor
  *****************************************************************************/
 static int  Open(vlc_object_t *);
+static void Close(vlc_object_t *);
+
+#define DITHER_TEXT N_("Dithering")
+#define DITHER_LONGTEXT N_( \
+    "Noise added to floating point samples before they are quantized to " \
+    "8 or 16 bits, trading a low level of hiss for the removal of the " \
+    "quantization distortion.")
+
+static const int dither_values[] = { 0, 1 };
+static const char *const dither_texts[] = {
+    N_("None"), N_("Triangular (TPDF)"),
+};
 
 vlc_module_begin()
     set_description(N_("Audio filter for PCM format conversion"))
     set_category(CAT_AUDIO)
     set_subcategory(SUBCAT_AUDIO_MISC)
     set_capability("audio converter", 1)
-    set_callbacks(Open, NULL)
+    add_integer("audio-format-dither", 0, DITHER_TEXT, DITHER_LONGTEXT, true)
+        change_integer_list(dither_values, dither_texts)
+    set_callbacks(Open, Close)
 vlc_module_end()
 
 /*****************************************************************************
  * Local prototypes
  *****************************************************************************/
 
-typedef block_t *(*cvt_t)(filter_t *, block_t *);
+typedef struct filter_sys_t filter_sys_t;
+
+/* Converts n samples. dst may be equal to src: conversions to larger samples
+ * run backward and the other ones forward, so that they work in place. */
+typedef void (*cvt_t)(void *dst, const void *src, size_t n, filter_sys_t *);
+
+struct filter_sys_t
+{
+    cvt_t    convert;
+    unsigned src_size;
+    unsigned dst_size;
+    bool     dither;
+    uint32_t seed[4]; /* Noise generator state, one per SIMD lane */
+};
+
 static cvt_t FindConversion(vlc_fourcc_t src, vlc_fourcc_t dst);
+static block_t *Convert(filter_t *, block_t *);
 
 static int Open(vlc_object_t *object)
 {
@@ -72,370 +107,572 @@ static int Open(vlc_object_t *object)
     if (src->i_codec == dst->i_codec)
         return VLC_EGENERIC;
 
-    filter->pf_audio_filter = FindConversion(src->i_codec, dst->i_codec);
-    if (filter->pf_audio_filter == NULL)
+    cvt_t convert = FindConversion(src->i_codec, dst->i_codec);
+    if (convert == NULL)
         return VLC_EGENERIC;
 
-    msg_Dbg(filter, "%4.4s->%4.4s, bits per sample: %i->%i",
+    filter_sys_t *sys = malloc(sizeof(*sys));
+    if (unlikely(sys == NULL))
+        return VLC_ENOMEM;
+
+    sys->convert = convert;
+    sys->src_size = aout_BitsPerSample(src->i_codec) / 8;
+    sys->dst_size = aout_BitsPerSample(dst->i_codec) / 8;
+    sys->dither = var_InheritInteger(filter, "audio-format-dither") != 0;
+    vlc_rand_bytes(sys->seed, sizeof(sys->seed));
+    for (unsigned i = 0; i < ARRAY_SIZE(sys->seed); i++)
+        sys->seed[i] |= 1; /* xorshift is stuck at zero */
+
+    filter->p_sys = sys;
+    filter->pf_audio_filter = Convert;
+
+    msg_Dbg(filter, "%4.4s->%4.4s, bits per sample: %i->%i%s",
             (char *)&src->i_codec, (char *)&dst->i_codec,
-            src->audio.i_bitspersample, dst->audio.i_bitspersample);
+            src->audio.i_bitspersample, dst->audio.i_bitspersample,
+            sys->dither ? ", dithered" : "");
     return VLC_SUCCESS;
 }
 
+static void Close(vlc_object_t *object)
+{
+    filter_t *filter = (filter_t *)object;
 
-/*** from U8 ***/
-static block_t *U8toS16(filter_t *filter, block_t *bsrc)
-{
-    block_t *bdst = block_Alloc(bsrc->i_buffer * 2);
-    if (unlikely(bdst == NULL))
-        goto out;
-
-    block_CopyProperties(bdst, bsrc);
-    uint8_t *src = (uint8_t *)bsrc->p_buffer;
-    int16_t *dst = (int16_t *)bdst->p_buffer;
-    for (size_t i = bsrc->i_buffer; i--;)
-        *dst++ = ((*src++) << 8) - 0x8000;
-out:
-    block_Release(bsrc);
-    VLC_UNUSED(filter);
-    return bdst;
+    free(filter->p_sys);
 }
 
-static block_t *U8toFl32(filter_t *filter, block_t *bsrc)
+static block_t *Convert(filter_t *filter, block_t *bsrc)
 {
-    block_t *bdst = block_Alloc(bsrc->i_buffer * 4);
-    if (unlikely(bdst == NULL))
-        goto out;
+    filter_sys_t *sys = filter->p_sys;
+    const size_t n = bsrc->i_buffer / sys->src_size;
+    const size_t size = n * sys->dst_size;
+    block_t *bdst = bsrc;
+
+    /* Convert in place, unless the larger samples do not fit in the buffer */
+    if ((size_t)(bsrc->p_start + bsrc->i_size - bsrc->p_buffer) < size)
+    {
+        bdst = block_Alloc(size);
+        if (unlikely(bdst == NULL))
+        {
+            block_Release(bsrc);
+            return NULL;
+        }
+        block_CopyProperties(bdst, bsrc);
+    }
 
-    block_CopyProperties(bdst, bsrc);
-    uint8_t *src = (uint8_t *)bsrc->p_buffer;
-    float   *dst = (float *)bdst->p_buffer;
-    for (size_t i = bsrc->i_buffer; i--;)
-        *dst++ = ((float)((*src++) - 128)) / 128.f;
-out:
-    block_Release(bsrc);
-    VLC_UNUSED(filter);
+    sys->convert(bdst->p_buffer, bsrc->p_buffer, n, sys);
+    bdst->i_buffer = size;
+
+    if (bdst != bsrc)
+        block_Release(bsrc);
     return bdst;
 }
 
-static block_t *U8toS32(filter_t *filter, block_t *bsrc)
+/*** Dithering ***/
+
+/* Triangular noise, between -1 and 1 LSB */
+static inline uint32_t Rand(uint32_t *seed)
 {
-    block_t *bdst = block_Alloc(bsrc->i_buffer * 4);
-    if (unlikely(bdst == NULL))
-        goto out;
+    uint32_t x = *seed; /* xorshift32 */
 
-    block_CopyProperties(bdst, bsrc);
-    uint8_t *src = (uint8_t *)bsrc->p_buffer;
-    int32_t *dst = (int32_t *)bdst->p_buffer;
-    for (size_t i = bsrc->i_buffer; i--;)
-        *dst++ = ((*src++) << 24) - 0x80000000;
-out:
-    block_Release(bsrc);
-    VLC_UNUSED(filter);
-    return bdst;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *seed = x;
 }
 
-static block_t *U8toFl64(filter_t *filter, block_t *bsrc)
+static inline float Tpdf(uint32_t *seed)
 {
-    block_t *bdst = block_Alloc(bsrc->i_buffer * 8);
-    if (unlikely(bdst == NULL))
-        goto out;
+    int32_t a = Rand(seed) >> 8;
+    int32_t b = Rand(seed) >> 8;
 
-    block_CopyProperties(bdst, bsrc);
-    uint8_t *src = (uint8_t *)bsrc->p_buffer;
-    double  *dst = (double *)bdst->p_buffer;
-    for (size_t i = bsrc->i_buffer; i--;)
-        *dst++ = ((double)((*src++) - 128)) / 128.;
-out:
-    block_Release(bsrc);
-    VLC_UNUSED(filter);
-    return bdst;
+    return (a - b) * (1.f / 16777216.f);
 }
 
+#ifdef HAVE_SSE2_INTRINSICS
+VLC_SSE2
+static inline __m128i SSE2_Rand(__m128i *seed)
+{
+    __m128i x = *seed;
 
-/*** from S16N ***/
-static block_t *S16toU8(filter_t *filter, block_t *b)
-{
-    VLC_UNUSED(filter);
-    int16_t *src = (int16_t *)b->p_buffer;
-    uint8_t *dst = (uint8_t *)src;
-    for (size_t i = b->i_buffer / 2; i--;)
-        *dst++ = ((*src++) + 32768) >> 8;
-
-    b->i_buffer /= 2;
-    return b;
-}
-
-static block_t *S16toFl32(filter_t *filter, block_t *bsrc)
-{
-    block_t *bdst = block_Alloc(bsrc->i_buffer * 2);
-    if (unlikely(bdst == NULL))
-        goto out;
-
-    block_CopyProperties(bdst, bsrc);
-    int16_t *src = (int16_t *)bsrc->p_buffer;
-    float   *dst = (float *)bdst->p_buffer;
-    for (size_t i = bsrc->i_buffer / 2; i--;)
-#if 0
-        /* Slow version */
-        *dst++ = (float)*src++ / 32768.f;
-#else
-    {   /* This is Walken's trick based on IEEE float format. On my PIII
-         * this takes 16 seconds to perform one billion conversions, instead
-         * of 19 seconds for the above division. */
-        union { float f; int32_t i; } u;
-        u.i = *src++ + 0x43c00000;
-        *dst++ = u.f - 384.f;
+    x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+    x = _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+    return *seed = x;
+}
+
+VLC_SSE2
+static inline __m128 SSE2_Tpdf(__m128i *seed)
+{
+    __m128i a = _mm_srli_epi32(SSE2_Rand(seed), 8);
+    __m128i b = _mm_srli_epi32(SSE2_Rand(seed), 8);
+
+    return _mm_mul_ps(_mm_cvtepi32_ps(_mm_sub_epi32(a, b)),
+                      _mm_set1_ps(1.f / 16777216.f));
+}
+
+/*** SSE2 kernels ***/
+/* They process multiples of 4, 8 or 16 samples, and follow the same
+ * direction as the scalar code, so that they also work in place. */
+
+VLC_SSE2
+static void SSE2_U8toFl32(float *dst, const uint8_t *src, size_t n)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias = _mm_set1_epi32(128);
+    const __m128 scale = _mm_set1_ps(1.f / 128.f);
+
+    for (size_t i = n; i > 0;)
+    {
+        i -= 16;
+
+        __m128i v = _mm_loadu_si128((const __m128i *)&src[i]);
+        __m128i lo = _mm_unpacklo_epi8(v, zero);
+        __m128i hi = _mm_unpackhi_epi8(v, zero);
+        __m128i v0 = _mm_sub_epi32(_mm_unpacklo_epi16(lo, zero), bias);
+        __m128i v1 = _mm_sub_epi32(_mm_unpackhi_epi16(lo, zero), bias);
+        __m128i v2 = _mm_sub_epi32(_mm_unpacklo_epi16(hi, zero), bias);
+        __m128i v3 = _mm_sub_epi32(_mm_unpackhi_epi16(hi, zero), bias);
+
+        _mm_storeu_ps(&dst[i +  0], _mm_mul_ps(_mm_cvtepi32_ps(v0), scale));
+        _mm_storeu_ps(&dst[i +  4], _mm_mul_ps(_mm_cvtepi32_ps(v1), scale));
+        _mm_storeu_ps(&dst[i +  8], _mm_mul_ps(_mm_cvtepi32_ps(v2), scale));
+        _mm_storeu_ps(&dst[i + 12], _mm_mul_ps(_mm_cvtepi32_ps(v3), scale));
+    }
+}
+
+VLC_SSE2
+static void SSE2_S16toFl32(float *dst, const int16_t *src, size_t n)
+{
+    const __m128 scale = _mm_set1_ps(1.f / 32768.f);
+
+    for (size_t i = n; i > 0;)
+    {
+        i -= 8;
+
+        __m128i v = _mm_loadu_si128((const __m128i *)&src[i]);
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+
+        _mm_storeu_ps(&dst[i + 0], _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(&dst[i + 4], _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+}
+
+VLC_SSE2
+static void SSE2_S32toFl32(float *dst, const int32_t *src, size_t n)
+{
+    const __m128 scale = _mm_set1_ps(1.f / 2147483648.f);
+
+    for (size_t i = 0; i < n; i += 4)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)&src[i]);
+
+        _mm_storeu_ps(&dst[i], _mm_mul_ps(_mm_cvtepi32_ps(v), scale));
+    }
+}
+
+/* The conversions to integers round to nearest even, as lrintf() does */
+VLC_SSE2
+static void SSE2_Fl32toU8(uint8_t *dst, const float *src, size_t n,
+                          uint32_t *seed)
+{
+    const __m128 scale = _mm_set1_ps(128.f);
+    const __m128 min = _mm_set1_ps(-128.f), max = _mm_set1_ps(127.f);
+    const __m128i bias = _mm_set1_epi32(128);
+    __m128i noise = seed ? _mm_loadu_si128((__m128i *)seed)
+                         : _mm_setzero_si128();
+
+    for (size_t i = 0; i < n; i += 16)
+    {
+        __m128i v[4];
+
+        for (unsigned j = 0; j < 4; j++)
+        {
+            __m128 s = _mm_mul_ps(_mm_loadu_ps(&src[i + 4 * j]), scale);
+
+            if (seed != NULL)
+                s = _mm_add_ps(s, SSE2_Tpdf(&noise));
+            s = _mm_min_ps(_mm_max_ps(s, min), max);
+            v[j] = _mm_add_epi32(_mm_cvtps_epi32(s), bias);
+        }
+
+        __m128i lo = _mm_packs_epi32(v[0], v[1]);
+        __m128i hi = _mm_packs_epi32(v[2], v[3]);
+        _mm_storeu_si128((__m128i *)&dst[i], _mm_packus_epi16(lo, hi));
+    }
+
+    if (seed != NULL)
+        _mm_storeu_si128((__m128i *)seed, noise);
+}
+
+VLC_SSE2
+static void SSE2_Fl32toS16(int16_t *dst, const float *src, size_t n,
+                           uint32_t *seed)
+{
+    const __m128 scale = _mm_set1_ps(32768.f);
+    const __m128 min = _mm_set1_ps(-32768.f), max = _mm_set1_ps(32767.f);
+    __m128i noise = seed ? _mm_loadu_si128((__m128i *)seed)
+                         : _mm_setzero_si128();
+
+    for (size_t i = 0; i < n; i += 8)
+    {
+        __m128 lo = _mm_mul_ps(_mm_loadu_ps(&src[i + 0]), scale);
+        __m128 hi = _mm_mul_ps(_mm_loadu_ps(&src[i + 4]), scale);
+
+        if (seed != NULL)
+        {
+            lo = _mm_add_ps(lo, SSE2_Tpdf(&noise));
+            hi = _mm_add_ps(hi, SSE2_Tpdf(&noise));
+        }
+        lo = _mm_min_ps(_mm_max_ps(lo, min), max);
+        hi = _mm_min_ps(_mm_max_ps(hi, min), max);
+
+        _mm_storeu_si128((__m128i *)&dst[i],
+                         _mm_packs_epi32(_mm_cvtps_epi32(lo),
+                                         _mm_cvtps_epi32(hi)));
+    }
+
+    if (seed != NULL)
+        _mm_storeu_si128((__m128i *)seed, noise);
+}
+
+VLC_SSE2
+static void SSE2_Fl32toS32(int32_t *dst, const float *src, size_t n)
+{
+    const __m128 scale = _mm_set1_ps(2147483648.f);
+
+    for (size_t i = 0; i < n; i += 4)
+    {
+        __m128 s = _mm_mul_ps(_mm_loadu_ps(&src[i]), scale);
+        /* Out of range values convert to INT32_MIN: flip the positive ones
+         * to INT32_MAX */
+        __m128i over = _mm_castps_si128(_mm_cmpge_ps(s, scale));
+
+        _mm_storeu_si128((__m128i *)&dst[i],
+                         _mm_xor_si128(_mm_cvtps_epi32(s), over));
     }
+}
 #endif
-out:
-    block_Release(bsrc);
-    VLC_UNUSED(filter);
-    return bdst;
+
+/*** from U8 ***/
+static void U8toS16(void *dst, const void *src, size_t n, filter_sys_t *sys)
+{
+    const uint8_t *in = src;
+    int16_t *out = dst;
+
+    for (size_t i = n; i--;)
+        out[i] = (in[i] << 8) - 0x8000;
+    VLC_UNUSED(sys);
 }
 
-static block_t *S16toS32(filter_t *filter, block_t *bsrc)
+static void U8toFl32(void *dst, const void *src, size_t n, filter_sys_t *sys)
 {
-    block_t *bdst = block_Alloc(bsrc->i_buffer * 2);
-    if (unlikely(bdst == NULL))
-        goto out;
+    const uint8_t *in = src;
+    float *out = dst;
+    size_t simd = 0;
 
-    block_CopyProperties(bdst, bsrc);
-    int16_t *src = (int16_t *)bsrc->p_buffer;
-    int32_t *dst = (int32_t *)bdst->p_buffer;
-    for (int i = bsrc->i_buffer / 2; i--;)
-        *dst++ = *src++ << 16;
-out:
-    block_Release(bsrc);
-    VLC_UNUSED(filter);
-    return bdst;
+#ifdef HAVE_SSE2_INTRINSICS
+    if (vlc_CPU_SSE2())
+        simd = n & ~15;
+#endif
+    for (size_t i = n; i-- > simd;)
+        out[i] = (in[i] - 128) / 128.f;
+#ifdef HAVE_SSE2_INTRINSICS
+    if (simd > 0)
+        SSE2_U8toFl32(out, in, simd);
+#endif
+    VLC_UNUSED(sys);
 }
 
-static block_t *S16toFl64(filter_t *filter, block_t *bsrc)
+static void U8toS32(void *dst, const void *src, size_t n, filter_sys_t *sys)
 {
-    block_t *bdst = block_Alloc(bsrc->i_buffer * 4);
-    if (unlikely(bdst == NULL))
-        goto out;
+    const uint8_t *in = src;
+    int32_t *out = dst;
 
-    block_CopyProperties(bdst, bsrc);
-    int16_t *src = (int16_t *)bsrc->p_buffer;
-    float   *dst = (float *)bdst->p_buffer;
-    for (size_t i = bsrc->i_buffer / 2; i--;)
-        *dst++ = (double)*src++ / 32768.;
-out:
-    block_Release(bsrc);
-    VLC_UNUSED(filter);
-    return bdst;
+    for (size_t i = n; i--;)
+        out[i] = ((uint32_t)in[i] << 24) - 0x80000000;
+    VLC_UNUSED(sys);
+}
+
+static void U8toFl64(void *dst, const void *src, size_t n, filter_sys_t *sys)
+{
+    const uint8_t *in = src;
+    double *out = dst;
+
+    for (size_t i = n; i--;)
+        out[i] = (in[i] - 128) / 128.;
+    VLC_UNUSED(sys);
+}
+
+
+/*** from S16N ***/
+static void S16toU8(void *dst, const void *src, size_t n, filter_sys_t *sys)
+{
+    const int16_t *in = src;
+    uint8_t *out = dst;
+
+    for (size_t i = 0; i < n; i++)
+        out[i] = (in[i] + 32768) >> 8;
+    VLC_UNUSED(sys);
+}
+
+static void S16toFl32(void *dst, const void *src, size_t n, filter_sys_t *sys)
+{
+    const int16_t *in = src;
+    float *out = dst;
+    size_t simd = 0;
+
+#ifdef HAVE_SSE2_INTRINSICS
+    if (vlc_CPU_SSE2())
+        simd = n & ~7;
+#endif
+    for (size_t i = n; i-- > simd;)
+        out[i] = in[i] / 32768.f;
+#ifdef HAVE_SSE2_INTRINSICS
+    if (simd > 0)
+        SSE2_S16toFl32(out, in, simd);
+#endif
+    VLC_UNUSED(sys);
+}
+
+static void S16toS32(void *dst, const void *src, size_t n, filter_sys_t *sys)
+{
+    const int16_t *in = src;
+    int32_t *out = dst;
+
+    for (size_t i = n; i--;)
+        out[i] = in[i] * 65536;
+    VLC_UNUSED(sys);
+}
+
+static void S16toFl64(void *dst, const void *src, size_t n, filter_sys_t *sys)
+{
+    const int16_t *in = src;
+    double *out = dst;
+
+    for (size_t i = n; i--;)
+        out[i] = in[i] / 32768.;
+    VLC_UNUSED(sys);
 }
 
 
 /*** from FL32 ***/
-static block_t *Fl32toU8(filter_t *filter, block_t *b)
+static void Fl32toU8(void *dst, const void *src, size_t n, filter_sys_t *sys)
 {
-    float   *src = (float *)b->p_buffer;
-    uint8_t *dst = (uint8_t *)src;
-    for (size_t i = b->i_buffer / 4; i--;)
+    const float *in = src;
+    uint8_t *out = dst;
+    size_t i = 0;
+
+#ifdef HAVE_SSE2_INTRINSICS
+    if (vlc_CPU_SSE2())
+    {
+        i = n & ~15;
+        SSE2_Fl32toU8(out, in, i, sys->dither ? sys->seed : NULL);
+    }
+#endif
+    for (; i < n; i++)
     {
-        float s = *(src++) * 128.f;
+        float s = in[i] * 128.f;
+        if (sys->dither)
+            s += Tpdf(sys->seed);
+
         if (s >= 127.f)
-            *(dst++) = 255;
+            out[i] = 255;
         else
         if (s <= -128.f)
-            *(dst++) = 0;
+            out[i] = 0;
         else
-            *(dst++) = lroundf(s) + 128;
+            out[i] = lrintf(s) + 128;
+    }
+}
+
+static void Fl32toS16(void *dst, const void *src, size_t n, filter_sys_t *sys)
+{
+    const float *in = src;
+    int16_t *out = dst;
+    size_t i = 0;
+
+#ifdef HAVE_SSE2_INTRINSICS
+    if (vlc_CPU_SSE2())
+    {
+        i = n & ~7;
+        SSE2_Fl32toS16(out, in, i, sys->dither ? sys->seed : NULL);
     }
-    b->i_buffer /= 4;
-    VLC_UNUSED(filter);
-    return b;
-}
-
-static block_t *Fl32toS16(filter_t *filter, block_t *b)
-{
-    VLC_UNUSED(filter);
-    float   *src = (float *)b->p_buffer;
-    int16_t *dst = (int16_t *)src;
-    for (int i = b->i_buffer / 4; i--;) {
-#if 0
-        /* Slow version. */
-        if (*src >= 1.0) *dst = 32767;
-        else if (*src < -1.0) *dst = -32768;
-        else *dst = lroundf(*src * 32768.f);
-        src++; dst++;
-#else
-        /* This is Walken's trick based on IEEE float format. */
-        union { float f; int32_t i; } u;
-        u.f = *src++ + 384.f;
-        if (u.i > 0x43c07fff)
-            *dst++ = 32767;
-        else if (u.i < 0x43bf8000)
-            *dst++ = -32768;
-        else
-            *dst++ = u.i - 0x43c00000;
 #endif
+    for (; i < n; i++)
+    {
+        float s = in[i] * 32768.f;
+        if (sys->dither)
+            s += Tpdf(sys->seed);
+
+        if (s >= 32767.f)
+            out[i] = 32767;
+        else
+        if (s <= -32768.f)
+            out[i] = -32768;
+        else
+            out[i] = lrintf(s);
     }
-    b->i_buffer /= 2;
-    return b;
 }
 
-static block_t *Fl32toS32(filter_t *filter, block_t *b)
+static void Fl32toS32(void *dst, const void *src, size_t n, filter_sys_t *sys)
 {
-    float   *src = (float *)b->p_buffer;
-    int32_t *dst = (int32_t *)src;
-    for (size_t i = b->i_buffer / 4; i--;)
+    const float *in = src;
+    int32_t *out = dst;
+    size_t i = 0;
+
+#ifdef HAVE_SSE2_INTRINSICS
+    if (vlc_CPU_SSE2())
     {
-        float s = *(src++) * 2147483648.f;
+        i = n & ~3;
+        SSE2_Fl32toS32(out, in, i);
+    }
+#endif
+    for (; i < n; i++)
+    {
+        float s = in[i] * 2147483648.f;
         if (s >= 2147483647.f)
-            *(dst++) = 2147483647;
+            out[i] = 2147483647;
         else
         if (s <= -2147483648.f)
-            *(dst++) = -2147483648;
+            out[i] = -2147483648;
         else
-            *(dst++) = lroundf(s);
+            out[i] = lrintf(s);
     }
-    VLC_UNUSED(filter);
-    return b;
+    VLC_UNUSED(sys);
 }
 
-static block_t *Fl32toFl64(filter_t *filter, block_t *bsrc)
+static void Fl32toFl64(void *dst, const void *src, size_t n, filter_sys_t *sys)
 {
-    block_t *bdst = block_Alloc(bsrc->i_buffer * 2);
-    if (unlikely(bdst == NULL))
-        goto out;
+    const float *in = src;
+    double *out = dst;
 
-    block_CopyProperties(bdst, bsrc);
-    float  *src = (float *)bsrc->p_buffer;
-    double *dst = (double *)bdst->p_buffer;
-    for (size_t i = bsrc->i_buffer / 4; i--;)
-        *(dst++) = *(src++);
-out:
-    block_Release(bsrc);
-    VLC_UNUSED(filter);
-    return bdst;
+    for (size_t i = n; i--;)
+        out[i] = in[i];
+    VLC_UNUSED(sys);
 }
 
 
 /*** from S32N ***/
-static block_t *S32toU8(filter_t *filter, block_t *b)
+static void S32toU8(void *dst, const void *src, size_t n, filter_sys_t *sys)
 {
-    VLC_UNUSED(filter);
-    int32_t *src = (int32_t *)b->p_buffer;
-    uint8_t *dst = (uint8_t *)src;
-    for (size_t i = b->i_buffer / 4; i--;)
-        *dst++ = ((*src++) >> 24) + 128;
+    const int32_t *in = src;
+    uint8_t *out = dst;
 
-    b->i_buffer /= 4;
-    return b;
+    for (size_t i = 0; i < n; i++)
+        out[i] = (in[i] >> 24) + 128;
+    VLC_UNUSED(sys);
 }
 
-static block_t *S32toS16(filter_t *filter, block_t *b)
+static void S32toS16(void *dst, const void *src, size_t n, filter_sys_t *sys)
 {
-    VLC_UNUSED(filter);
-    int32_t *src = (int32_t *)b->p_buffer;
-    int16_t *dst = (int16_t *)src;
-    for (size_t i = b->i_buffer / 4; i--;)
-        *dst++ = (*src++) >> 16;
+    const int32_t *in = src;
+    int16_t *out = dst;
 
-    b->i_buffer /= 2;
-    return b;
+    for (size_t i = 0; i < n; i++)
+        out[i] = in[i] >> 16;
+    VLC_UNUSED(sys);
 }
 
-static block_t *S32toFl32(filter_t *filter, block_t *b)
+static void S32toFl32(void *dst, const void *src, size_t n, filter_sys_t *sys)
 {
-    VLC_UNUSED(filter);
-    int32_t *src = (int32_t*)b->p_buffer;
-    float   *dst = (float *)src;
-    for (int i = b->i_buffer / 4; i--;)
-        *dst++ = (float)(*src++) / 2147483648.f;
-    return b;
+    const int32_t *in = src;
+    float *out = dst;
+    size_t i = 0;
+
+#ifdef HAVE_SSE2_INTRINSICS
+    if (vlc_CPU_SSE2())
+    {
+        i = n & ~3;
+        SSE2_S32toFl32(out, in, i);
+    }
+#endif
+    for (; i < n; i++)
+        out[i] = (float)in[i] / 2147483648.f;
+    VLC_UNUSED(sys);
 }
 
-static block_t *S32toFl64(filter_t *filter, block_t *bsrc)
+static void S32toFl64(void *dst, const void *src, size_t n, filter_sys_t *sys)
 {
-    block_t *bdst = block_Alloc(bsrc->i_buffer * 2);
-    if (unlikely(bdst == NULL))
-        goto out;
+    const int32_t *in = src;
+    double *out = dst;
 
-    block_CopyProperties(bdst, bsrc);
-    int32_t *src = (int32_t*)bsrc->p_buffer;
-    double  *dst = (double *)bdst->p_buffer;
-    for (size_t i = bsrc->i_buffer / 4; i--;)
-        *dst++ = (double)(*src++) / 2147483648.;
-out:
-    VLC_UNUSED(filter);
-    block_Release(bsrc);
-    return bdst;
+    for (size_t i = n; i--;)
+        out[i] = (double)in[i] / 2147483648.;
+    VLC_UNUSED(sys);
 }
 
 
 /*** from FL64 ***/
-static block_t *Fl64toU8(filter_t *filter, block_t *b)
+static void Fl64toU8(void *dst, const void *src, size_t n, filter_sys_t *sys)
 {
-    double  *src = (double *)b->p_buffer;
-    uint8_t *dst = (uint8_t *)src;
-    for (size_t i = b->i_buffer / 8; i--;)
+    const double *in = src;
+    uint8_t *out = dst;
+
+    for (size_t i = 0; i < n; i++)
     {
-        float s = *(src++) * 128.;
-        if (s >= 127.f)
-            *(dst++) = 255;
+        double s = in[i] * 128.;
+        if (sys->dither)
+            s += Tpdf(sys->seed);
+
+        if (s >= 127.)
+            out[i] = 255;
         else
-        if (s <= -128.f)
-            *(dst++) = 0;
+        if (s <= -128.)
+            out[i] = 0;
         else
-            *(dst++) = lround(s) + 128;
+            out[i] = lrint(s) + 128;
     }
-    b->i_buffer /= 8;
-    VLC_UNUSED(filter);
-    return b;
-}
-
-static block_t *Fl64toS16(filter_t *filter, block_t *b)
-{
-    VLC_UNUSED(filter);
-    double  *src = (double *)b->p_buffer;
-    int16_t *dst = (int16_t *)src;
-    for (size_t i = b->i_buffer / 8; i--;) {
-        const double v = *src++ * 32768.;
-        /* Slow version. */
-        if (v >= 32767.)
-            *dst++ = 32767;
-        else if (v < -32768.)
-            *dst++ = -32768;
+}
+
+static void Fl64toS16(void *dst, const void *src, size_t n, filter_sys_t *sys)
+{
+    const double *in = src;
+    int16_t *out = dst;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        double s = in[i] * 32768.;
+        if (sys->dither)
+            s += Tpdf(sys->seed);
+
+        if (s >= 32767.)
+            out[i] = 32767;
         else
-            *dst++ = lround(v);
+        if (s <= -32768.)
+            out[i] = -32768;
+        else
+            out[i] = lrint(s);
     }
-    b->i_buffer /= 4;
-    return b;
 }
 
-static block_t *Fl64toFl32(filter_t *filter, block_t *b)
+static void Fl64toFl32(void *dst, const void *src, size_t n, filter_sys_t *sys)
 {
-    double *src = (double *)b->p_buffer;
-    float  *dst = (float *)src;
-    for (size_t i = b->i_buffer / 8; i--;)
-        *(dst++) = *(src++);
+    const double *in = src;
+    float *out = dst;
 
-    VLC_UNUSED(filter);
-    return b;
+    for (size_t i = 0; i < n; i++)
+        out[i] = in[i];
+    VLC_UNUSED(sys);
 }
 
-static block_t *Fl64toS32(filter_t *filter, block_t *b)
+static void Fl64toS32(void *dst, const void *src, size_t n, filter_sys_t *sys)
 {
-    double  *src = (double *)b->p_buffer;
-    int32_t *dst = (int32_t *)src;
-    for (size_t i = b->i_buffer / 8; i--;)
+    const double *in = src;
+    int32_t *out = dst;
+
+    for (size_t i = 0; i < n; i++)
     {
-        float s = *(src++) * 2147483648.;
-        if (s >= 2147483647.f)
-            *(dst++) = 2147483647;
+        double s = in[i] * 2147483648.;
+        if (s >= 2147483647.)
+            out[i] = 2147483647;
         else
-        if (s <= -2147483648.f)
-            *(dst++) = -2147483648;
+        if (s <= -2147483648.)
+            out[i] = -2147483648;
         else
-            *(dst++) = lround(s);
+            out[i] = lrint(s);
     }
-    VLC_UNUSED(filter);
-    return b;
+    VLC_UNUSED(sys);
 }
 
 
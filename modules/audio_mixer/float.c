@@ -34,6 +34,11 @@
 #include <vlc_plugin.h>
 #include <vlc_aout.h>
 #include <vlc_aout_volume.h>
+#include <vlc_cpu.h>
+
+#ifdef HAVE_SSE2_INTRINSICS
+# include <emmintrin.h>
+#endif
 
 /*****************************************************************************
  * Local prototypes
@@ -81,6 +86,57 @@ static void FilterFL64( audio_volume_t *p_volume, block_t *p_buffer,
     (void) p_volume;
 }
 
+#ifdef HAVE_SSE2_INTRINSICS
+VLC_SSE2
+static void SSE2_FilterFL32( audio_volume_t *p_volume, block_t *p_buffer,
+                             float f_multiplier )
+{
+    if( f_multiplier == 1.f )
+        return; /* nothing to do */
+
+    float *p = (float *)p_buffer->p_buffer;
+    size_t i_count = p_buffer->i_buffer / sizeof(*p), i = 0;
+    const __m128 mult = _mm_set1_ps( f_multiplier );
+
+    for( ; i + 8 <= i_count; i += 8 )
+    {
+        __m128 lo = _mm_loadu_ps( &p[i] );
+        __m128 hi = _mm_loadu_ps( &p[i + 4] );
+        _mm_storeu_ps( &p[i], _mm_mul_ps( lo, mult ) );
+        _mm_storeu_ps( &p[i + 4], _mm_mul_ps( hi, mult ) );
+    }
+    for( ; i < i_count; i++ )
+        p[i] *= f_multiplier;
+
+    (void) p_volume;
+}
+
+VLC_SSE2
+static void SSE2_FilterFL64( audio_volume_t *p_volume, block_t *p_buffer,
+                             float f_multiplier )
+{
+    double *p = (double *)p_buffer->p_buffer;
+    double mult = f_multiplier;
+    if( mult == 1. )
+        return; /* nothing to do */
+
+    size_t i_count = p_buffer->i_buffer / sizeof(*p), i = 0;
+    const __m128d multv = _mm_set1_pd( mult );
+
+    for( ; i + 4 <= i_count; i += 4 )
+    {
+        __m128d lo = _mm_loadu_pd( &p[i] );
+        __m128d hi = _mm_loadu_pd( &p[i + 2] );
+        _mm_storeu_pd( &p[i], _mm_mul_pd( lo, multv ) );
+        _mm_storeu_pd( &p[i + 2], _mm_mul_pd( hi, multv ) );
+    }
+    for( ; i < i_count; i++ )
+        p[i] *= mult;
+
+    (void) p_volume;
+}
+#endif
+
 /**
  * Initializes the mixer
  */
@@ -92,9 +148,17 @@ static int Create( vlc_object_t *p_this )
     {
         case VLC_CODEC_FL32:
             p_volume->amplify = FilterFL32;
+#ifdef HAVE_SSE2_INTRINSICS
+            if( vlc_CPU_SSE2() )
+                p_volume->amplify = SSE2_FilterFL32;
+#endif
             break;
         case VLC_CODEC_FL64:
             p_volume->amplify = FilterFL64;
+#ifdef HAVE_SSE2_INTRINSICS
+            if( vlc_CPU_SSE2() )
+                p_volume->amplify = SSE2_FilterFL64;
+#endif
             break;
         default:
             return -1;
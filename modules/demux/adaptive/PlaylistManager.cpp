@@ -36,6 +36,7 @@
 #include "logic/AlwaysLowestAdaptationLogic.hpp"
 #include "logic/PredictiveAdaptationLogic.hpp"
 #include "logic/NearOptimalAdaptationLogic.hpp"
+#include "logic/LowLatencyAdaptationLogic.hpp"
 #include "tools/Debug.hpp"
 #include <vlc_stream.h>
 #include <vlc_demux.h>
@@ -110,6 +111,7 @@ bool PlaylistManager::setupPeriod()
     if(!logic && !(logic = createLogic(logicType, conManager)))
         return false;
 
+    const unsigned prefetch = var_InheritInteger(p_demux, "adaptive-prefetch");
     std::vector<BaseAdaptationSet*> sets = currentPeriod->getAdaptationSets();
     std::vector<BaseAdaptationSet*>::iterator it;
     for(it=sets.begin();it!=sets.end();++it)
@@ -117,9 +119,10 @@ bool PlaylistManager::setupPeriod()
         BaseAdaptationSet *set = *it;
         if(set && streamFactory)
         {
-            SegmentTracker *tracker = new (std::nothrow) SegmentTracker(logic, set);
+            SegmentTracker *tracker = new (std::nothrow) SegmentTracker(logic, set, prefetch);
             if(!tracker)
                 continue;
+            tracker->registerListener(conManager);
 
             AbstractStream *st = streamFactory->create(p_demux, set->getStreamFormat(),
                                                        tracker, conManager);
@@ -766,6 +769,16 @@ AbstractAdaptationLogic *PlaylistManager::createLogic(AbstractAdaptationLogic::L
             if(predictivelogic)
                 conn->setDownloadRateObserver(predictivelogic);
             logic = predictivelogic;
+            break;
+        }
+        case AbstractAdaptationLogic::LowLatency:
+        {
+            AbstractAdaptationLogic *lowlatencylogic =
+                    new (std::nothrow) LowLatencyAdaptationLogic(VLC_OBJECT(p_demux));
+            if(lowlatencylogic)
+                conn->setDownloadRateObserver(lowlatencylogic);
+            logic = lowlatencylogic;
+            break;
         }
 
         default:
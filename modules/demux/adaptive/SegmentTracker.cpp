@@ -76,7 +76,8 @@ SegmentTrackerEvent::SegmentTrackerEvent(const ID &id, mtime_t duration)
     u.segment.id = &id;
 }
 
-SegmentTracker::SegmentTracker(AbstractAdaptationLogic *logic_, BaseAdaptationSet *adaptSet)
+SegmentTracker::SegmentTracker(AbstractAdaptationLogic *logic_, BaseAdaptationSet *adaptSet,
+                               unsigned prefetchDepth_)
 {
     first = true;
     curNumber = next = 0;
@@ -87,6 +88,7 @@ SegmentTracker::SegmentTracker(AbstractAdaptationLogic *logic_, BaseAdaptationSe
     setAdaptationLogic(logic_);
     adaptationSet = adaptSet;
     format = StreamFormat::UNSUPPORTED;
+    prefetchDepth = prefetchDepth_;
 }
 
 SegmentTracker::~SegmentTracker()
@@ -127,6 +129,7 @@ bool SegmentTracker::segmentsListReady() const
 
 void SegmentTracker::reset()
 {
+    resetPrefetch();
     notify(SegmentTrackerEvent(curRepresentation, NULL));
     curRepresentation = NULL;
     init_sent = false;
@@ -165,6 +168,7 @@ SegmentChunk * SegmentTracker::getNextChunk(bool switch_allowed,
 
     if(rep != curRepresentation)
     {
+        resetPrefetch();
         notify(SegmentTrackerEvent(curRepresentation, rep));
         prevRep = curRepresentation;
         curRepresentation = rep;
@@ -246,7 +250,9 @@ SegmentChunk * SegmentTracker::getNextChunk(bool switch_allowed,
         initializing = false;
     }
 
-    SegmentChunk *chunk = segment->toChunk(next, rep, connManager);
+    SegmentChunk *chunk = getPrefetchedChunk(rep, next);
+    if(!chunk)
+        chunk = segment->toChunk(next, rep, connManager);
 
     /* Notify new segment length for stats / logic */
     if(chunk)
@@ -273,11 +279,66 @@ SegmentChunk * SegmentTracker::getNextChunk(bool switch_allowed,
     {
         curNumber = next;
         next++;
+        prefetch(rep, connManager);
     }
 
     return chunk;
 }
 
+SegmentChunk * SegmentTracker::getPrefetchedChunk(BaseRepresentation *rep,
+                                                  uint64_t number)
+{
+    if(!prefetched.empty() &&
+       prefetched.front().rep == rep && prefetched.front().number == number)
+    {
+        SegmentChunk *chunk = prefetched.front().chunk;
+        prefetched.pop_front();
+        return chunk;
+    }
+
+    /* Representation switch or seek, the downloads ahead are useless */
+    resetPrefetch();
+    return NULL;
+}
+
+void SegmentTracker::prefetch(BaseRepresentation *rep,
+                              AbstractConnectionManager *connManager)
+{
+    /* Live segments might not be available yet */
+    if(rep->getPlaylist()->isLive())
+        return;
+
+    uint64_t number = prefetched.empty() ? next : prefetched.back().number + 1;
+
+    while(prefetched.size() < prefetchDepth)
+    {
+        bool b_gap;
+        ISegment *segment = rep->getNextSegment(BaseRepresentation::INFOTYPE_MEDIA,
+                                                number, &number, &b_gap);
+        if(!segment)
+            break;
+
+        PrefetchedChunk entry;
+        entry.rep = rep;
+        entry.number = number;
+        entry.chunk = segment->toChunk(number, rep, connManager);
+        if(!entry.chunk)
+            break;
+
+        prefetched.push_back(entry);
+        number++;
+    }
+}
+
+void SegmentTracker::resetPrefetch()
+{
+    while(!prefetched.empty())
+    {
+        delete prefetched.front().chunk;
+        prefetched.pop_front();
+    }
+}
+
 bool SegmentTracker::setPositionByTime(mtime_t time, bool restarted, bool tryonly)
 {
     uint64_t segnumber;
@@ -297,6 +358,7 @@ bool SegmentTracker::setPositionByTime(mtime_t time, bool restarted, bool tryonl
 
 void SegmentTracker::setPositionByNumber(uint64_t segnumber, bool restarted)
 {
+    resetPrefetch();
     if(restarted)
     {
         initializing = true;
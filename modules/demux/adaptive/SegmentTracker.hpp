@@ -43,6 +43,7 @@ namespace adaptive
     {
         class BaseAdaptationSet;
         class BaseRepresentation;
+        class ISegment;
         class SegmentChunk;
     }
 
@@ -112,7 +113,8 @@ namespace adaptive
     class SegmentTracker
     {
         public:
-            SegmentTracker(AbstractAdaptationLogic *, BaseAdaptationSet *);
+            SegmentTracker(AbstractAdaptationLogic *, BaseAdaptationSet *,
+                           unsigned = 0);
             ~SegmentTracker();
 
             StreamFormat getCurrentFormat() const;
@@ -131,6 +133,9 @@ namespace adaptive
         private:
             void setAdaptationLogic(AbstractAdaptationLogic *);
             void notify(const SegmentTrackerEvent &) const;
+            SegmentChunk * getPrefetchedChunk(BaseRepresentation *, uint64_t);
+            void prefetch(BaseRepresentation *, AbstractConnectionManager *);
+            void resetPrefetch();
             bool first;
             bool initializing;
             bool index_sent;
@@ -142,6 +147,17 @@ namespace adaptive
             BaseAdaptationSet *adaptationSet;
             BaseRepresentation *curRepresentation;
             std::list<SegmentTrackerListenerInterface *> listeners;
+
+            /* Media segments downloaded ahead of the current one */
+            class PrefetchedChunk
+            {
+                public:
+                    BaseRepresentation *rep;
+                    uint64_t number;
+                    SegmentChunk *chunk;
+            };
+            unsigned prefetchDepth;
+            std::list<PrefetchedChunk> prefetched;
     };
 }
 
@@ -24,6 +24,11 @@
 #include "AuthStorage.hpp"
 #include "ConnectionParams.hpp"
 
+extern "C"
+{
+    #include "../../../access/http/connmgr.h"
+}
+
 using namespace adaptive::http;
 
 AuthStorage::AuthStorage( vlc_object_t *p_obj )
@@ -33,10 +38,13 @@ AuthStorage::AuthStorage( vlc_object_t *p_obj )
                 (var_InheritAddress( p_obj, "http-cookies" ));
     else
         p_cookies_jar = NULL;
+    p_http_mgr = vlc_http_mgr_create( p_obj, p_cookies_jar );
 }
 
 AuthStorage::~AuthStorage()
 {
+    if( p_http_mgr )
+        vlc_http_mgr_destroy( p_http_mgr );
 }
 
 void AuthStorage::addCookie( const std::string &cookie, const ConnectionParams &params )
@@ -62,3 +70,8 @@ std::string AuthStorage::getCookie( const ConnectionParams &params, bool secure
     }
     return ret;
 }
+
+vlc_http_mgr * AuthStorage::getHTTPManager() const
+{
+    return p_http_mgr;
+}
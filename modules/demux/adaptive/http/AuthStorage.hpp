@@ -25,6 +25,8 @@
 
 #include <string>
 
+struct vlc_http_mgr;
+
 namespace adaptive
 {
     namespace http
@@ -38,9 +40,13 @@ namespace adaptive
                 ~AuthStorage();
                 void addCookie( const std::string &cookie, const ConnectionParams & );
                 std::string getCookie( const ConnectionParams &, bool secure );
+                /* HTTP/2 capable manager, shared by all the requests of the
+                 * session */
+                vlc_http_mgr * getHTTPManager() const;
 
             private:
                 vlc_http_cookie_jar_t *p_cookies_jar;
+                vlc_http_mgr *p_http_mgr;
         };
     }
 }
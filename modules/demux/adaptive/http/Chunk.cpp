@@ -133,7 +133,7 @@ HTTPChunkSource::HTTPChunkSource(const std::string& url, AbstractConnectionManag
 HTTPChunkSource::~HTTPChunkSource()
 {
     if(connection)
-        connection->setUsed(false);
+        connManager->releaseConnection(connection);
 }
 
 bool HTTPChunkSource::init(const std::string &url)
@@ -149,6 +149,11 @@ bool HTTPChunkSource::init(const std::string &url)
     return true;
 }
 
+const ConnectionParams & HTTPChunkSource::getConnectionParams() const
+{
+    return params;
+}
+
 bool HTTPChunkSource::hasMoreData() const
 {
     if(eof)
@@ -198,6 +203,7 @@ block_t * HTTPChunkSource::read(size_t readsize)
         if((size_t)ret < readsize)
             eof = true;
         connManager->updateDownloadRate(sourceid, p_block->i_buffer, time);
+        connManager->updateActiveDownloadRate(sourceid, p_block->i_buffer, time, 0);
     }
 
     return p_block;
@@ -250,7 +256,9 @@ HTTPChunkBufferedSource::HTTPChunkBufferedSource(const std::string& url, Abstrac
     done = false;
     eof = false;
     held = false;
+    opened = false;
     downloadstart = 0;
+    latency = 0;
 }
 
 HTTPChunkBufferedSource::~HTTPChunkBufferedSource()
@@ -318,7 +326,10 @@ void HTTPChunkBufferedSource::bufferize(size_t readsize)
     block_t *p_block = block_Alloc(readsize);
     if(!p_block)
     {
+        vlc_mutex_locker locker( &lock );
+        done = true;
         eof = true;
+        vlc_cond_signal(&avail);
         return;
     }
 
@@ -326,9 +337,11 @@ void HTTPChunkBufferedSource::bufferize(size_t readsize)
     {
         size_t size;
         mtime_t time;
-    } rate = {0,0};
+    } rate = {0,0}, active = {0,0};
 
+    mtime_t time = mdate();
     ssize_t ret = connection->read(p_block->p_buffer, readsize);
+    time = mdate() - time;
     if(ret <= 0)
     {
         block_Release(p_block);
@@ -337,6 +350,7 @@ void HTTPChunkBufferedSource::bufferize(size_t readsize)
         done = true;
         rate.size = buffered + consumed;
         rate.time = mdate() - downloadstart;
+        getTransferRate(&active.size, &active.time);
         downloadstart = 0;
     }
     else
@@ -345,18 +359,26 @@ void HTTPChunkBufferedSource::bufferize(size_t readsize)
         vlc_mutex_locker locker( &lock );
         buffered += p_block->i_buffer;
         block_ChainLastAppend(&pp_tail, p_block);
+        reads.push_back(std::make_pair((size_t) ret, time));
         if((size_t) ret < readsize)
         {
             done = true;
             rate.size = buffered + consumed;
             rate.time = mdate() - downloadstart;
+            getTransferRate(&active.size, &active.time);
             downloadstart = 0;
         }
     }
 
     if(rate.size)
     {
+        /* Wall clock time, request included, for the rate based logics */
         connManager->updateDownloadRate(sourceid, rate.size, rate.time);
+        connManager->updateActiveDownloadRate(sourceid, active.size, active.time, latency);
+        /* Fully buffered: hand the connection back to the pool, instead of
+         * keeping it until the chunk gets read */
+        connManager->releaseConnection(connection);
+        connection = NULL;
     }
 
     vlc_cond_signal(&avail);
@@ -367,11 +389,42 @@ bool HTTPChunkBufferedSource::prepare()
     if(!prepared)
     {
         downloadstart = mdate();
-        return HTTPChunkSource::prepare();
+        if(!HTTPChunkSource::prepare())
+            return false;
+        latency = mdate() - downloadstart;
     }
     return true;
 }
 
+/* Only accounts for the periods with bytes flowing: neither the wait for the
+ * reply, nor the time between reads, nor the reads much slower than the
+ * typical one of the download, which waited for the server to produce data
+ * (chunked transfer of live segments). */
+void HTTPChunkBufferedSource::getTransferRate(size_t *size, mtime_t *time) const
+{
+    std::vector<uint64_t> rates;
+    std::vector<std::pair<size_t, mtime_t> >::const_iterator it;
+
+    *size = 0;
+    *time = 0;
+    if(reads.empty())
+        return;
+
+    for(it = reads.begin(); it != reads.end(); ++it)
+        rates.push_back(CLOCK_FREQ * (*it).first / std::max((*it).second, (mtime_t) 1));
+    std::nth_element(rates.begin(), rates.begin() + rates.size() / 2, rates.end());
+    const uint64_t median = rates[rates.size() / 2];
+
+    for(it = reads.begin(); it != reads.end(); ++it)
+    {
+        if(CLOCK_FREQ * (*it).first / std::max((*it).second, (mtime_t) 1) * 4 < median)
+            continue;
+        *size += (*it).first;
+        *time += (*it).second;
+    }
+    *time = std::max(*time, (mtime_t) 1);
+}
+
 bool HTTPChunkBufferedSource::hasMoreData() const
 {
     vlc_mutex_locker locker( &lock );
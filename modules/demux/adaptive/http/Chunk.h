@@ -90,6 +90,7 @@ namespace adaptive
                 virtual block_t *   readBlock       (); /* impl */
                 virtual block_t *   read            (size_t); /* impl */
                 virtual bool        hasMoreData     () const; /* impl */
+                const ConnectionParams & getConnectionParams() const;
 
                 static const size_t CHUNK_SIZE = 32768;
 
@@ -127,15 +128,19 @@ namespace adaptive
                 bool               isDone() const;
 
             private:
+                void               getTransferRate(size_t *, mtime_t *) const;
                 block_t            *p_head; /* read cache buffer */
                 block_t           **pp_tail;
                 size_t              buffered; /* read cache size */
                 bool                done;
                 bool                eof;
                 mtime_t             downloadstart;
+                mtime_t             latency; /* until the reply */
+                std::vector<std::pair<size_t, mtime_t> > reads; /* size, duration */
                 mutable vlc_mutex_t lock;
                 vlc_cond_t          avail;
                 bool                held;
+                bool                opened; /* by a worker, under the Downloader lock */
         };
 
         class HTTPChunk : public AbstractChunk
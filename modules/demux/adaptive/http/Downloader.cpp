@@ -22,41 +22,47 @@
 #endif
 
 #include "Downloader.hpp"
+#include "ConnectionParams.hpp"
 
 #include <vlc_threads.h>
 #include <vlc_atomic.h>
 
+#include <algorithm>
+
 using namespace adaptive::http;
 
-Downloader::Downloader()
+Downloader::Downloader(unsigned workers, unsigned perhost)
 {
     vlc_mutex_init(&lock);
     vlc_cond_init(&waitcond);
     killed = false;
-    thread_handle_valid = false;
+    maxWorkers = std::max(workers, 1U);
+    maxPerHost = std::max(perhost, 1U);
 }
 
 bool Downloader::start()
 {
-    if(!thread_handle_valid &&
-       vlc_clone(&thread_handle, downloaderThread,
-                 static_cast<void *>(this), VLC_THREAD_PRIORITY_INPUT))
+    while(threads.size() < maxWorkers)
     {
-        return false;
+        vlc_thread_t thread;
+        if(vlc_clone(&thread, downloaderThread,
+                     static_cast<void *>(this), VLC_THREAD_PRIORITY_INPUT))
+            break;
+        threads.push_back(thread);
     }
-    thread_handle_valid = true;
-    return true;
+    return !threads.empty();
 }
 
 Downloader::~Downloader()
 {
     vlc_mutex_lock( &lock );
     killed = true;
-    vlc_cond_signal(&waitcond);
+    vlc_cond_broadcast(&waitcond);
     vlc_mutex_unlock( &lock );
 
-    if(thread_handle_valid)
-        vlc_join(thread_handle, NULL);
+    std::vector<vlc_thread_t>::iterator it;
+    for(it = threads.begin(); it != threads.end(); ++it)
+        vlc_join(*it, NULL);
     vlc_mutex_destroy(&lock);
     vlc_cond_destroy(&waitcond);
 }
@@ -65,15 +71,35 @@ void Downloader::schedule(HTTPChunkBufferedSource *source)
     vlc_mutex_lock(&lock);
     source->hold();
     chunks.push_back(source);
-    vlc_cond_signal(&waitcond);
+    vlc_cond_broadcast(&waitcond);
     vlc_mutex_unlock(&lock);
 }
 
 void Downloader::cancel(HTTPChunkBufferedSource *source)
 {
     vlc_mutex_lock(&lock);
-    source->release();
-    chunks.remove(source);
+    /* wait for the worker currently downloading it, if any */
+    while(isBusy(source))
+        vlc_cond_wait(&waitcond, &lock);
+    if(std::find(chunks.begin(), chunks.end(), source) != chunks.end())
+    {
+        chunks.remove(source);
+        source->release();
+    }
+    vlc_mutex_unlock(&lock);
+}
+
+void Downloader::setBufferingLevel(const ID &id, mtime_t level)
+{
+    vlc_mutex_lock(&lock);
+    levels[id] = level;
+    vlc_mutex_unlock(&lock);
+}
+
+void Downloader::clearBufferingLevel(const ID &id)
+{
+    vlc_mutex_lock(&lock);
+    levels.erase(id);
     vlc_mutex_unlock(&lock);
 }
 
@@ -92,27 +118,92 @@ void Downloader::DownloadSource(HTTPChunkBufferedSource *source)
         source->bufferize(HTTPChunkSource::CHUNK_SIZE);
 }
 
+bool Downloader::isBusy(const HTTPChunkBufferedSource *source) const
+{
+    return std::find(busy.begin(), busy.end(), source) != busy.end();
+}
+
+/* Sources holding, or about to open, a connection to the same server */
+unsigned Downloader::getActiveCount(const ConnectionParams &params) const
+{
+    unsigned count = 0;
+    std::list<HTTPChunkBufferedSource *>::const_iterator it;
+    for(it = chunks.begin(); it != chunks.end(); ++it)
+    {
+        HTTPChunkBufferedSource *source = *it;
+        if(!isBusy(source) && !source->opened)
+            continue;
+        const ConnectionParams &other = source->getConnectionParams();
+        if(other.getHostname() == params.getHostname() &&
+           other.getPort() == params.getPort() &&
+           other.getScheme() == params.getScheme())
+            count++;
+    }
+    return count;
+}
+
+mtime_t Downloader::getBufferingLevel(const ID &id) const
+{
+    std::map<ID, mtime_t>::const_iterator it = levels.find(id);
+    /* Unknown streams are starting, and have nothing buffered */
+    return (it != levels.end()) ? it->second : 0;
+}
+
+/* Picks the source of the stream with the lowest buffering level,
+ * in scheduling order for a given stream */
+HTTPChunkBufferedSource * Downloader::getNextSource() const
+{
+    HTTPChunkBufferedSource *next = NULL;
+    mtime_t nextlevel = 0;
+
+    std::list<HTTPChunkBufferedSource *>::const_iterator it;
+    for(it = chunks.begin(); it != chunks.end(); ++it)
+    {
+        HTTPChunkBufferedSource *source = *it;
+        if(isBusy(source))
+            continue;
+        if(!source->opened &&
+           getActiveCount(source->getConnectionParams()) >= maxPerHost)
+            continue;
+
+        const mtime_t level = getBufferingLevel(source->sourceid);
+        if(!next || level < nextlevel)
+        {
+            next = source;
+            nextlevel = level;
+        }
+    }
+    return next;
+}
+
 void Downloader::Run()
 {
     vlc_mutex_lock(&lock);
     while(1)
     {
-        while(chunks.empty() && !killed)
+        HTTPChunkBufferedSource *source = NULL;
+
+        while(!killed && (source = getNextSource()) == NULL)
             vlc_cond_wait(&waitcond, &lock);
 
         if(killed)
             break;
 
-        if(!chunks.empty())
+        busy.push_back(source);
+        vlc_mutex_unlock(&lock);
+
+        DownloadSource(source);
+
+        vlc_mutex_lock(&lock);
+        busy.remove(source);
+        source->opened = true;
+        if(source->isDone())
         {
-            HTTPChunkBufferedSource *source = chunks.front();
-            DownloadSource(source);
-            if(source->isDone())
-            {
-                chunks.pop_front();
-                source->release();
-            }
+            chunks.remove(source);
+            source->release();
         }
+        /* Wake up cancellers, and workers waiting for a connection slot */
+        vlc_cond_broadcast(&waitcond);
     }
     vlc_mutex_unlock(&lock);
 }
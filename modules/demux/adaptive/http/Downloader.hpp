@@ -21,9 +21,12 @@
 #define DOWNLOADER_HPP
 
 #include "Chunk.h"
+#include "../ID.hpp"
 
 #include <vlc_common.h>
 #include <list>
+#include <map>
+#include <vector>
 
 namespace adaptive
 {
@@ -34,22 +37,33 @@ namespace adaptive
         class Downloader
         {
             public:
-                Downloader();
+                Downloader(unsigned = 1, unsigned = 1);
                 ~Downloader();
                 bool start();
                 void schedule(HTTPChunkBufferedSource *);
                 void cancel(HTTPChunkBufferedSource *);
+                void setBufferingLevel(const ID &, mtime_t);
+                void clearBufferingLevel(const ID &);
 
             private:
                 static void * downloaderThread(void *);
                 void Run();
                 void DownloadSource(HTTPChunkBufferedSource *);
-                vlc_thread_t thread_handle;
+                HTTPChunkBufferedSource * getNextSource() const;
+                bool isBusy(const HTTPChunkBufferedSource *) const;
+                unsigned getActiveCount(const ConnectionParams &) const;
+                mtime_t getBufferingLevel(const ID &) const;
+                std::vector<vlc_thread_t> threads;
+                unsigned     maxWorkers;
+                unsigned     maxPerHost;
                 vlc_mutex_t  lock;
                 vlc_cond_t   waitcond;
-                bool         thread_handle_valid;
                 bool         killed;
+                /* Scheduled sources, in scheduling order */
                 std::list<HTTPChunkBufferedSource *> chunks;
+                /* Sources being downloaded by a worker */
+                std::list<HTTPChunkBufferedSource *> busy;
+                std::map<ID, mtime_t> levels;
         };
 
     }
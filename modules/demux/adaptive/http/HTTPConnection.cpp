@@ -28,8 +28,17 @@
 #include "../adaptive/tools/Helper.h"
 
 #include <cstdio>
+#include <cstring>
 #include <sstream>
+#include <algorithm>
 #include <vlc_stream.h>
+#include <vlc_block.h>
+
+extern "C"
+{
+    #include "../../../access/http/resource.h"
+    #include "../../../access/http/message.h"
+}
 
 using namespace adaptive::http;
 
@@ -514,6 +523,200 @@ void StreamUrlConnection::setUsed( bool b )
        reset();
 }
 
+/* Followed in memory by its opaque pointer, as the resource code expects */
+struct LibVLCHTTPConnection::restuple
+{
+    struct vlc_http_resource resource;
+    LibVLCHTTPConnection *conn;
+};
+
+LibVLCHTTPConnection::LibVLCHTTPConnection(vlc_object_t *p_object_, AuthStorage *auth)
+    : AbstractConnection( p_object_ )
+{
+    authStorage = auth;
+    psz_useragent = var_InheritString(p_object_, "http-user-agent");
+    res = NULL;
+    p_block = NULL;
+    bytesRead = 0;
+    contentLength = 0;
+}
+
+LibVLCHTTPConnection::~LibVLCHTTPConnection()
+{
+    reset();
+    free(psz_useragent);
+}
+
+int LibVLCHTTPConnection::formatRequest(const struct vlc_http_resource *,
+                                        struct vlc_http_msg *req, void *opaque)
+{
+    const LibVLCHTTPConnection *me = *static_cast<LibVLCHTTPConnection **>(opaque);
+    const BytesRange &range = me->bytesRange;
+
+    if(range.isValid())
+    {
+        if(range.getEndByte())
+            return vlc_http_msg_add_header(req, "Range", "bytes=%zu-%zu",
+                                           range.getStartByte(), range.getEndByte());
+        return vlc_http_msg_add_header(req, "Range", "bytes=%zu-",
+                                       range.getStartByte());
+    }
+    return 0;
+}
+
+int LibVLCHTTPConnection::validateResponse(const struct vlc_http_resource *,
+                                           const struct vlc_http_msg *resp, void *)
+{
+    const int status = vlc_http_msg_get_status(resp);
+    /* redirections are handled by the caller */
+    return (status == 200 || status == 206 || status / 100 == 3) ? 0 : -1;
+}
+
+void LibVLCHTTPConnection::reset()
+{
+    if(p_block)
+    {
+        block_Release(p_block);
+        p_block = NULL;
+    }
+    if(res)
+    {
+        vlc_http_res_destroy(&res->resource);
+        res = NULL;
+    }
+    bytesRead = 0;
+    contentLength = 0;
+    bytesRange = BytesRange();
+}
+
+bool LibVLCHTTPConnection::canReuse(const ConnectionParams &params_) const
+{
+    return ( available &&
+             params.getHostname() == params_.getHostname() &&
+             params.getScheme() == params_.getScheme() &&
+             params.getPort() == params_.getPort() );
+}
+
+int LibVLCHTTPConnection::request(const std::string &path, const BytesRange &range)
+{
+    static const struct vlc_http_resource_cbs callbacks =
+    {
+        formatRequest,
+        validateResponse,
+    };
+
+    reset();
+
+    /* Set new path for this query */
+    params.setPath(path);
+
+    msg_Dbg(p_object, "Retrieving %s @%zu", params.getUrl().c_str(),
+                      range.isValid() ? range.getStartByte() : 0);
+
+    if(!authStorage->getHTTPManager())
+        return VLC_EGENERIC;
+
+    res = static_cast<restuple *>(malloc(sizeof(*res)));
+    if(!res)
+        return VLC_ENOMEM;
+    res->conn = this;
+
+    if(vlc_http_res_init(&res->resource, &callbacks, authStorage->getHTTPManager(),
+                         params.getUrl().c_str(), psz_useragent, NULL))
+    {
+        free(res);
+        res = NULL;
+        return VLC_EGENERIC;
+    }
+
+    bytesRange = range;
+
+    res->resource.response = vlc_http_res_open(&res->resource, &res->conn);
+
+    if(!res->resource.response)
+    {
+        res->resource.failure = true;
+        return VLC_EGENERIC;
+    }
+
+    char *psz_redirect = vlc_http_res_get_redirect(&res->resource);
+    if(psz_redirect)
+    {
+        ConnectionParams loc(psz_redirect);
+        free(psz_redirect);
+        msg_Info(p_object, "redirection to %s", loc.getUrl().c_str());
+        reset();
+        params = loc;
+        return VLC_ETIMEOUT;
+    }
+    else if(vlc_http_msg_get_status(res->resource.response) / 100 != 2)
+    {
+        reset();
+        return VLC_ENOOBJ;
+    }
+
+    const uintmax_t size = vlc_http_msg_get_size(res->resource.response);
+    if(size != (uintmax_t) -1)
+        contentLength = size;
+    else if(range.isValid() && range.getEndByte() > 0)
+        contentLength = range.getEndByte() - range.getStartByte() + 1;
+
+    return VLC_SUCCESS;
+}
+
+ssize_t LibVLCHTTPConnection::read(void *p_buffer, size_t len)
+{
+    if(!res)
+        return VLC_EGENERIC;
+
+    if(len == 0)
+        return VLC_SUCCESS;
+
+    const size_t toRead = (contentLength) ? contentLength - bytesRead : len;
+    if (toRead == 0)
+        return VLC_SUCCESS;
+
+    if(len > toRead)
+        len = toRead;
+
+    size_t copied = 0;
+    while(copied < len)
+    {
+        if(!p_block)
+        {
+            block_t *p_data = vlc_http_res_read(&res->resource);
+            if(p_data == NULL || p_data == vlc_http_error)
+                break;
+            p_block = p_data;
+        }
+
+        const size_t tocopy = std::min(len - copied, p_block->i_buffer);
+        memcpy(&static_cast<uint8_t *>(p_buffer)[copied], p_block->p_buffer, tocopy);
+        p_block->p_buffer += tocopy;
+        p_block->i_buffer -= tocopy;
+        copied += tocopy;
+
+        if(p_block->i_buffer == 0)
+        {
+            block_Release(p_block);
+            p_block = NULL;
+        }
+    }
+    bytesRead += copied;
+
+    if(copied < len || contentLength == bytesRead) /* set EOF */
+        reset();
+
+    return copied;
+}
+
+void LibVLCHTTPConnection::setUsed( bool b )
+{
+    available = !b;
+    if(available && contentLength == bytesRead)
+        reset();
+}
+
 ConnectionFactory::ConnectionFactory( AuthStorage *auth )
 {
     authStorage = auth;
@@ -529,6 +732,9 @@ AbstractConnection * ConnectionFactory::createConnection(vlc_object_t *p_object,
     if((params.getScheme() != "http" && params.getScheme() != "https") || params.getHostname().empty())
         return NULL;
 
+    if(params.getScheme() == "https" && var_InheritBool(p_object, "adaptive-http2"))
+        return new (std::nothrow) LibVLCHTTPConnection(p_object, authStorage);
+
     const int sockettype = (params.getScheme() == "https") ? TLSSocket::TLS : Socket::REGULAR;
     Socket *socket = (sockettype == TLSSocket::TLS) ? new (std::nothrow) TLSSocket()
                                                     : new (std::nothrow) Socket();
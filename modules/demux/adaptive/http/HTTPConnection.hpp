@@ -30,6 +30,9 @@
 #include <vlc_common.h>
 #include <string>
 
+struct vlc_http_resource;
+struct vlc_http_msg;
+
 namespace adaptive
 {
     namespace http
@@ -122,6 +125,34 @@ namespace adaptive
                 stream_t *p_streamurl;
        };
 
+       /* Requests sent through the shared HTTP stack of the session, which
+        * multiplexes them over a single HTTP/2 connection when possible */
+       class LibVLCHTTPConnection : public AbstractConnection
+       {
+            public:
+                LibVLCHTTPConnection(vlc_object_t *, AuthStorage *);
+                virtual ~LibVLCHTTPConnection();
+
+                virtual bool    canReuse     (const ConnectionParams &) const;
+
+                virtual int     request     (const std::string& path, const BytesRange & = BytesRange());
+                virtual ssize_t read        (void *p_buffer, size_t len);
+
+                virtual void    setUsed( bool );
+
+            private:
+                struct restuple;
+                static int formatRequest(const struct vlc_http_resource *,
+                                         struct vlc_http_msg *, void *);
+                static int validateResponse(const struct vlc_http_resource *,
+                                            const struct vlc_http_msg *, void *);
+                void reset();
+                AuthStorage *authStorage;
+                char *psz_useragent;
+                restuple *res;
+                block_t *p_block; /* partially read */
+       };
+
        class ConnectionFactory
        {
            public:
@@ -33,6 +33,8 @@
 #include <vlc_url.h>
 #include <vlc_http.h>
 
+#include <algorithm>
+
 using namespace adaptive::http;
 
 AbstractConnectionManager::AbstractConnectionManager(vlc_object_t *p_object_)
@@ -53,6 +55,13 @@ void AbstractConnectionManager::updateDownloadRate(const adaptive::ID &sourceid,
         rateObserver->updateDownloadRate(sourceid, size, time);
 }
 
+void AbstractConnectionManager::updateActiveDownloadRate(const adaptive::ID &sourceid, size_t size,
+                                                         mtime_t time, mtime_t latency)
+{
+    if(rateObserver)
+        rateObserver->updateActiveDownloadRate(sourceid, size, time, latency);
+}
+
 void AbstractConnectionManager::setDownloadRateObserver(IDownloadRateObserver *obs)
 {
     rateObserver = obs;
@@ -62,8 +71,7 @@ HTTPConnectionManager::HTTPConnectionManager    (vlc_object_t *p_object_, Connec
     : AbstractConnectionManager( p_object_ )
 {
     vlc_mutex_init(&lock);
-    downloader = new (std::nothrow) Downloader();
-    downloader->start();
+    downloader = createDownloader();
     factory = factory_;
 }
 
@@ -71,14 +79,27 @@ HTTPConnectionManager::HTTPConnectionManager    (vlc_object_t *p_object_, AuthSt
     : AbstractConnectionManager( p_object_ )
 {
     vlc_mutex_init(&lock);
-    downloader = new (std::nothrow) Downloader();
-    downloader->start();
+    downloader = createDownloader();
     if(var_InheritBool(p_object, "adaptive-use-access"))
         factory = new (std::nothrow) StreamUrlConnectionFactory();
     else
         factory = new (std::nothrow) ConnectionFactory( storage );
 }
 
+Downloader * HTTPConnectionManager::createDownloader() const
+{
+    const int workers = var_InheritInteger(p_object, "adaptive-downloads");
+    const int perhost = var_InheritInteger(p_object, "adaptive-host-connections");
+    Downloader *dl = new (std::nothrow) Downloader(std::max(workers, 1),
+                                                   std::max(perhost, 1));
+    if(dl && !dl->start())
+    {
+        delete dl;
+        dl = NULL;
+    }
+    return dl;
+}
+
 HTTPConnectionManager::~HTTPConnectionManager   ()
 {
     delete downloader;
@@ -144,16 +165,46 @@ AbstractConnection * HTTPConnectionManager::getConnection(ConnectionParams &para
     return conn;
 }
 
+void HTTPConnectionManager::releaseConnection(AbstractConnection *conn)
+{
+    vlc_mutex_lock(&lock);
+    conn->setUsed(false);
+    vlc_mutex_unlock(&lock);
+}
+
 void HTTPConnectionManager::start(AbstractChunkSource *source)
 {
     HTTPChunkBufferedSource *src = dynamic_cast<HTTPChunkBufferedSource *>(source);
-    if(src)
+    if(src && downloader)
         downloader->schedule(src);
 }
 
 void HTTPConnectionManager::cancel(AbstractChunkSource *source)
 {
     HTTPChunkBufferedSource *src = dynamic_cast<HTTPChunkBufferedSource *>(source);
-    if(src)
+    if(src && downloader)
         downloader->cancel(src);
 }
+
+void HTTPConnectionManager::setBufferingLevel(const adaptive::ID &id, mtime_t level)
+{
+    if(downloader)
+        downloader->setBufferingLevel(id, level);
+}
+
+void HTTPConnectionManager::trackerEvent(const SegmentTrackerEvent &event)
+{
+    switch(event.type)
+    {
+        case SegmentTrackerEvent::BUFFERING_LEVEL_CHANGE:
+            setBufferingLevel(*event.u.buffering_level.id,
+                              event.u.buffering_level.current);
+            break;
+        case SegmentTrackerEvent::BUFFERING_STATE:
+            if(!event.u.buffering.enabled && downloader)
+                downloader->clearBufferingLevel(*event.u.buffering.id);
+            break;
+        default:
+            break;
+    }
+}
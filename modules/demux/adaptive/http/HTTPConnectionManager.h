@@ -26,6 +26,7 @@
 #define HTTPCONNECTIONMANAGER_H_
 
 #include "../logic/IDownloadRateObserver.h"
+#include "../SegmentTracker.hpp"
 
 #include <vlc_common.h>
 
@@ -43,17 +44,20 @@ namespace adaptive
         class Downloader;
         class AbstractChunkSource;
 
-        class AbstractConnectionManager : public IDownloadRateObserver
+        class AbstractConnectionManager : public IDownloadRateObserver,
+                                          public SegmentTrackerListenerInterface
         {
             public:
                 AbstractConnectionManager(vlc_object_t *);
                 ~AbstractConnectionManager();
                 virtual void    closeAllConnections () = 0;
                 virtual AbstractConnection * getConnection(ConnectionParams &) = 0;
+                virtual void    releaseConnection(AbstractConnection *) = 0;
                 virtual void start(AbstractChunkSource *) = 0;
                 virtual void cancel(AbstractChunkSource *) = 0;
 
                 virtual void updateDownloadRate(const ID &, size_t, mtime_t); /* impl */
+                virtual void updateActiveDownloadRate(const ID &, size_t, mtime_t, mtime_t); /* impl */
                 void setDownloadRateObserver(IDownloadRateObserver *);
 
             protected:
@@ -72,12 +76,16 @@ namespace adaptive
 
                 virtual void    closeAllConnections () /* impl */;
                 virtual AbstractConnection * getConnection(ConnectionParams &) /* impl */;
+                virtual void    releaseConnection(AbstractConnection *) /* impl */;
 
                 virtual void start(AbstractChunkSource *) /* impl */;
                 virtual void cancel(AbstractChunkSource *) /* impl */;
+                virtual void trackerEvent(const SegmentTrackerEvent &) /* impl */;
+                void setBufferingLevel(const ID &, mtime_t);
 
             private:
                 void    releaseAllConnections ();
+                Downloader * createDownloader() const;
                 Downloader                                         *downloader;
                 vlc_mutex_t                                         lock;
                 std::vector<AbstractConnection *>                   connectionPool;
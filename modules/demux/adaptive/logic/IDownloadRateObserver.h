@@ -35,6 +35,9 @@ namespace adaptive
     {
         public:
             virtual void updateDownloadRate(const ID &, size_t, mtime_t) = 0;
+            /* Same download, only counting the reads with bytes flowing,
+             * and the time spent waiting for the reply */
+            virtual void updateActiveDownloadRate(const ID &, size_t, mtime_t, mtime_t) {}
             virtual ~IDownloadRateObserver(){}
     };
 }
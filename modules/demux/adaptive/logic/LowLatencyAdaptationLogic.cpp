@@ -0,0 +1,247 @@
+/*
+ * LowLatencyAdaptationLogic.cpp
+ *****************************************************************************
+ * Copyright (C) 2018 - VideoLAN Authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "LowLatencyAdaptationLogic.hpp"
+
+#include "../playlist/AbstractPlaylist.hpp"
+#include "../playlist/BaseAdaptationSet.h"
+#include "../playlist/BaseRepresentation.h"
+#include "../tools/Debug.hpp"
+
+#include <algorithm>
+
+using namespace adaptive::logic;
+using namespace adaptive;
+
+/*
+ * Hybrid throughput and buffer based logic, for the small buffers of low
+ * latency live streams.
+ *
+ * The throughput estimate only covers the periods with bytes flowing, which
+ * still underestimates the link when the server sends live segments as they
+ * get produced: such downloads only raise the estimate. The buffer occupancy
+ * model of each stream predicts the level left once the next segment is
+ * downloaded, and allows raising the quality beyond the estimate while that
+ * level stays comfortable.
+ */
+
+/* Share of the estimated throughput a representation may use */
+#define THROUGHPUT_USAGE 0.9
+
+LowLatencyContext::LowLatencyContext()
+    : buffering_level( 0 )
+    , segment_duration( 0 )
+    , live( false )
+{ }
+
+LowLatencyAdaptationLogic::LowLatencyAdaptationLogic( vlc_object_t *p_obj )
+    : AbstractAdaptationLogic()
+    , usedBps( 0 )
+    , p_obj( p_obj )
+{
+    vlc_mutex_init(&lock);
+}
+
+LowLatencyAdaptationLogic::~LowLatencyAdaptationLogic()
+{
+    vlc_mutex_destroy(&lock);
+}
+
+/* Buffered amount once the segment of the representation is downloaded */
+mtime_t LowLatencyAdaptationLogic::getBufferingAfter(const LowLatencyContext &ctx,
+                                                     const BaseRepresentation *rep,
+                                                     unsigned bps, mtime_t latency)
+{
+    const mtime_t dltime = latency + (mtime_t) rep->getBandwidth() * ctx.segment_duration / bps;
+    return ctx.buffering_level - dltime + ctx.segment_duration;
+}
+
+BaseRepresentation *
+LowLatencyAdaptationLogic::getNextQuality(BaseAdaptationSet *adaptSet, RepresentationSelector &selector,
+                                          BaseRepresentation *prevRep, const LowLatencyContext &ctx,
+                                          unsigned bps, mtime_t latency) const
+{
+    /* Never runs below that level while downloading */
+    const mtime_t reserve = ctx.segment_duration / 2;
+    const mtime_t safe = ctx.segment_duration + reserve;
+    const mtime_t comfortable = safe + ctx.segment_duration;
+
+    /* Highest representation sustained by the throughput, and safe */
+    BaseRepresentation *ret = selector.lowest(adaptSet);
+    BaseRepresentation *prev = NULL;
+    for(BaseRepresentation *rep = ret; rep && rep != prev; rep = selector.higher(adaptSet, rep))
+    {
+        if(rep->getBandwidth() <= bps * THROUGHPUT_USAGE &&
+           getBufferingAfter(ctx, rep, bps, latency) >= safe)
+            ret = rep;
+        prev = rep;
+    }
+
+    if(prevRep == NULL)
+        return ret;
+
+    if(ret->getBandwidth() > prevRep->getBandwidth())
+    {
+        /* One step at a time */
+        ret = selector.higher(adaptSet, prevRep);
+    }
+    else if(getBufferingAfter(ctx, prevRep, bps, latency) >= comfortable)
+    {
+        /* Enough data buffered to go beyond the measured throughput */
+        BaseRepresentation *up = selector.higher(adaptSet, prevRep);
+        ret = (getBufferingAfter(ctx, up, bps, latency) >= comfortable) ? up : prevRep;
+    }
+
+    return ret;
+}
+
+BaseRepresentation *LowLatencyAdaptationLogic::getNextRepresentation(BaseAdaptationSet *adaptSet, BaseRepresentation *prevRep)
+{
+    RepresentationSelector selector(maxwidth, maxheight);
+
+    vlc_mutex_lock(&lock);
+
+    std::map<ID, LowLatencyContext>::iterator it = streams.find(adaptSet->getID());
+    if(it != streams.end())
+        (*it).second.live = adaptSet->getPlaylist()->isLive();
+    const unsigned bps = getAvailableBw(estimator.getThroughput(), prevRep);
+    const mtime_t latency = estimator.getLatency();
+    if(it == streams.end() || (*it).second.segment_duration == 0 || bps == 0)
+    {
+        /* Starting: the lowest quality gets the shortest startup */
+        vlc_mutex_unlock(&lock);
+        return prevRep ? prevRep : selector.lowest(adaptSet);
+    }
+    LowLatencyContext ctxcopy = (*it).second;
+
+    vlc_mutex_unlock(&lock);
+
+    BaseRepresentation *rep = getNextQuality(adaptSet, selector, prevRep, ctxcopy, bps, latency);
+
+    BwDebug( msg_Info(p_obj, "Stream %s buffering level %" PRId64 " ms, latency %" PRId64 " ms, "
+                      "available %u kBps, rep %" PRIu64 " kBps", adaptSet->getID().str().c_str(),
+                      ctxcopy.buffering_level / 1000, latency / 1000, bps / 8000,
+                      rep->getBandwidth() / 8000); );
+
+    return rep;
+}
+
+/* A live segment downloaded in about its duration, but not faster than the
+ * estimate, was likely limited by the server producing it in real time */
+bool LowLatencyAdaptationLogic::isPaced(const LowLatencyContext &ctx, size_t size,
+                                        mtime_t time, mtime_t latency) const
+{
+    if(!ctx.live || time <= 0)
+        return false;
+    if(time + latency < ctx.segment_duration * 3 / 4 ||
+       time + latency > ctx.segment_duration * 21 / 20)
+        return false;
+    return CLOCK_FREQ * size * 8 / time <= estimator.getThroughput();
+}
+
+void LowLatencyAdaptationLogic::updateActiveDownloadRate(const ID &id, size_t size,
+                                                         mtime_t time, mtime_t latency)
+{
+    vlc_mutex_lock(&lock);
+    std::map<ID, LowLatencyContext>::const_iterator it = streams.find(id);
+    if(it != streams.end() && isPaced((*it).second, size, time, latency))
+        estimator.push(0, 0, latency);
+    else
+        estimator.push(size, time, latency);
+    BwDebug(msg_Info(p_obj, "Estimated throughput %u kBps, latency %" PRId64 " ms",
+                     estimator.getThroughput() / 8000, estimator.getLatency() / 1000));
+    vlc_mutex_unlock(&lock);
+}
+
+unsigned LowLatencyAdaptationLogic::getAvailableBw(unsigned i_bw, const BaseRepresentation *curRep) const
+{
+    uint64_t i_used = usedBps;
+    if(curRep)
+        i_used -= std::min(i_used, curRep->getBandwidth());
+    return (i_bw > i_used) ? i_bw - i_used : 0;
+}
+
+void LowLatencyAdaptationLogic::trackerEvent(const SegmentTrackerEvent &event)
+{
+    switch(event.type)
+    {
+    case SegmentTrackerEvent::SWITCHING:
+        {
+            vlc_mutex_lock(&lock);
+            if(event.u.switching.prev)
+                usedBps -= event.u.switching.prev->getBandwidth();
+            if(event.u.switching.next)
+                usedBps += event.u.switching.next->getBandwidth();
+            BwDebug(msg_Info(p_obj, "New total bandwidth usage %u kBps", (usedBps / 8000)));
+            vlc_mutex_unlock(&lock);
+        }
+        break;
+
+    case SegmentTrackerEvent::BUFFERING_STATE:
+        {
+            const ID &id = *event.u.buffering.id;
+            vlc_mutex_lock(&lock);
+            if(event.u.buffering.enabled)
+            {
+                if(streams.find(id) == streams.end())
+                {
+                    LowLatencyContext ctx;
+                    streams.insert(std::pair<ID, LowLatencyContext>(id, ctx));
+                }
+            }
+            else
+            {
+                std::map<ID, LowLatencyContext>::iterator it = streams.find(id);
+                if(it != streams.end())
+                    streams.erase(it);
+            }
+            vlc_mutex_unlock(&lock);
+            BwDebug(msg_Info(p_obj, "Stream %s is now known %sactive", id.str().c_str(),
+                         (event.u.buffering.enabled) ? "" : "in"));
+        }
+        break;
+
+    case SegmentTrackerEvent::BUFFERING_LEVEL_CHANGE:
+        {
+            const ID &id = *event.u.buffering_level.id;
+            vlc_mutex_lock(&lock);
+            LowLatencyContext &ctx = streams[id];
+            ctx.buffering_level = event.u.buffering_level.current;
+            vlc_mutex_unlock(&lock);
+        }
+        break;
+
+    case SegmentTrackerEvent::SEGMENT_CHANGE:
+        {
+            const ID &id = *event.u.segment.id;
+            vlc_mutex_lock(&lock);
+            LowLatencyContext &ctx = streams[id];
+            ctx.segment_duration = event.u.segment.duration;
+            vlc_mutex_unlock(&lock);
+        }
+        break;
+
+    default:
+            break;
+    }
+}
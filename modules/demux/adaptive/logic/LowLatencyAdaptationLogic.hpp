@@ -0,0 +1,74 @@
+/*
+ * LowLatencyAdaptationLogic.hpp
+ *****************************************************************************
+ * Copyright (C) 2018 - VideoLAN Authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef LOWLATENCYADAPTATIONLOGIC_HPP
+#define LOWLATENCYADAPTATIONLOGIC_HPP
+
+#include "AbstractAdaptationLogic.h"
+#include "Representationselectors.hpp"
+#include "ThroughputEstimator.hpp"
+#include <map>
+
+namespace adaptive
+{
+    namespace logic
+    {
+        /* Buffer occupancy model of a stream */
+        class LowLatencyContext
+        {
+            friend class LowLatencyAdaptationLogic;
+
+            public:
+                LowLatencyContext();
+
+            private:
+                mtime_t buffering_level;
+                mtime_t segment_duration;
+                bool    live;
+        };
+
+        class LowLatencyAdaptationLogic : public AbstractAdaptationLogic
+        {
+            public:
+                LowLatencyAdaptationLogic(vlc_object_t *);
+                virtual ~LowLatencyAdaptationLogic();
+
+                virtual BaseRepresentation* getNextRepresentation(BaseAdaptationSet *, BaseRepresentation *);
+                virtual void                updateActiveDownloadRate(const ID &, size_t, mtime_t, mtime_t); /* reimpl */
+                virtual void                trackerEvent           (const SegmentTrackerEvent &); /* reimpl */
+
+            private:
+                BaseRepresentation *        getNextQuality(BaseAdaptationSet *, RepresentationSelector &,
+                                                           BaseRepresentation *, const LowLatencyContext &,
+                                                           unsigned, mtime_t) const;
+                bool                        isPaced(const LowLatencyContext &, size_t,
+                                                    mtime_t, mtime_t) const;
+                static mtime_t              getBufferingAfter(const LowLatencyContext &, const BaseRepresentation *,
+                                                              unsigned, mtime_t);
+                unsigned                    getAvailableBw(unsigned, const BaseRepresentation *) const;
+                std::map<adaptive::ID, LowLatencyContext> streams;
+                ThroughputEstimator         estimator;
+                unsigned                    usedBps;
+                vlc_object_t *              p_obj;
+                vlc_mutex_t                 lock;
+        };
+    }
+}
+
+#endif // LOWLATENCYADAPTATIONLOGIC_HPP
@@ -0,0 +1,108 @@
+/*
+ * ThroughputEstimator.cpp
+ *****************************************************************************
+ * Copyright (C) 2018 - VideoLAN Authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "ThroughputEstimator.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+using namespace adaptive::logic;
+
+/* Smaller transfers are mostly latency, and get merged with the next ones */
+#define MIN_SAMPLE_SIZE 16384
+
+/* Half-lives, in seconds of transfer */
+#define FAST_HALFLIFE 2.0
+#define SLOW_HALFLIFE 5.0
+/* in number of requests */
+#define LATENCY_HALFLIFE 4.0
+
+WeightedAverage::WeightedAverage(double halflife)
+{
+    alpha = std::exp(std::log(0.5) / halflife);
+    estimate = 0.0;
+    total = 0.0;
+}
+
+void WeightedAverage::push(double value, double weight)
+{
+    const double a = std::pow(alpha, weight);
+    estimate = value * (1.0 - a) + estimate * a;
+    total += weight;
+}
+
+double WeightedAverage::get() const
+{
+    if(empty())
+        return 0.0;
+    return estimate / (1.0 - std::pow(alpha, total));
+}
+
+bool WeightedAverage::empty() const
+{
+    return total <= 0.0;
+}
+
+/*
+ * Transfers are weighted by their duration, so that a slow download, which
+ * lasts longer, weighs more than fast ones, and the estimate drops quickly.
+ */
+ThroughputEstimator::ThroughputEstimator()
+    : fast( FAST_HALFLIFE )
+    , slow( SLOW_HALFLIFE )
+    , latency( LATENCY_HALFLIFE )
+    , pending_size( 0 )
+    , pending_time( 0 )
+{ }
+
+void ThroughputEstimator::push(size_t size, mtime_t time, mtime_t delay)
+{
+    if(delay > 0)
+        latency.push(delay, 1.0);
+
+    pending_size += size;
+    pending_time += time;
+    if(pending_size < MIN_SAMPLE_SIZE || pending_time <= 0)
+        return;
+
+    const double bps = 8.0 * CLOCK_FREQ * pending_size / pending_time;
+    const double weight = (double) pending_time / CLOCK_FREQ;
+    fast.push(bps, weight);
+    slow.push(bps, weight);
+    pending_size = 0;
+    pending_time = 0;
+}
+
+unsigned ThroughputEstimator::getThroughput() const
+{
+    if(fast.empty())
+        return 0;
+    const double bps = std::min(fast.get(), slow.get());
+    return std::min(bps, (double) UINT_MAX);
+}
+
+mtime_t ThroughputEstimator::getLatency() const
+{
+    return latency.get();
+}
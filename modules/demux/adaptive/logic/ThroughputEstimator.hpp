@@ -0,0 +1,63 @@
+/*
+ * ThroughputEstimator.hpp
+ *****************************************************************************
+ * Copyright (C) 2018 - VideoLAN Authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef THROUGHPUTESTIMATOR_HPP
+#define THROUGHPUTESTIMATOR_HPP
+
+#include <vlc_common.h>
+
+namespace adaptive
+{
+    namespace logic
+    {
+        /* Exponentially weighted average, corrected for its zero start */
+        class WeightedAverage
+        {
+            public:
+                WeightedAverage(double);
+                void push(double, double);
+                double get() const;
+                bool empty() const;
+
+            private:
+                double alpha;
+                double estimate;
+                double total;
+        };
+
+        class ThroughputEstimator
+        {
+            public:
+                ThroughputEstimator();
+                void     push(size_t, mtime_t, mtime_t);
+                unsigned getThroughput() const; /* bps, 0 while unknown */
+                mtime_t  getLatency() const;
+
+            private:
+                /* Reacts fast to drops, and slowly to increases */
+                WeightedAverage fast;
+                WeightedAverage slow;
+                WeightedAverage latency;
+                size_t  pending_size;
+                mtime_t pending_time;
+        };
+    }
+}
+
+#endif // THROUGHPUTESTIMATOR_HPP
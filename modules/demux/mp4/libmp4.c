@@ -1407,6 +1407,30 @@ static int MP4_ReadBox_LtdContainer( stream_t *p_stream, MP4_Box_t *p_box )
     MP4_READBOX_EXIT( 1 );
 }
 
+/* Sample tables larger than this are left in the file, when allowed */
+#define MP4_LAZY_TABLE_MIN_SIZE (256 * 1024)
+
+/* Only for the tables read from the file itself through MP4_BoxGetRoot(),
+ * not for those of a decompressed moov */
+static bool MP4_IsLazyTable( MP4_Box_t *p_box, uint64_t i_fixed )
+{
+    const MP4_Box_t *p_root = p_box;
+    while( p_root->p_father )
+        p_root = p_root->p_father;
+
+    return p_root->i_type == ATOM_root &&
+           ( p_root->e_flags & BOX_FLAG_LAZY_TABLES ) &&
+           p_box->i_size >= mp4_box_headersize( p_box ) + i_fixed
+                            + MP4_LAZY_TABLE_MIN_SIZE;
+}
+
+/* Reads only the fields before the entries of a lazy table */
+#define MP4_TABLE_READ_SIZE( b_lazy, i_fixed ) \
+    ( (b_lazy) ? mp4_box_headersize( p_box ) + (i_fixed) : p_box->i_size )
+
+#define MP4_TABLE_ENTRIES_POS( i_fixed ) \
+    ( p_box->i_pos + mp4_box_headersize( p_box ) + (i_fixed) )
+
 static void MP4_FreeBox_stts( MP4_Box_t *p_box )
 {
     FREENULL( p_box->data.p_stts->pi_sample_count );
@@ -1415,11 +1439,19 @@ static void MP4_FreeBox_stts( MP4_Box_t *p_box )
 
 static int MP4_ReadBox_stts( stream_t *p_stream, MP4_Box_t *p_box )
 {
-    MP4_READBOX_ENTER( MP4_Box_data_stts_t, MP4_FreeBox_stts );
+    const bool b_lazy = MP4_IsLazyTable( p_box, 8 );
+    MP4_READBOX_ENTER_PARTIAL( MP4_Box_data_stts_t, MP4_TABLE_READ_SIZE( b_lazy, 8 ),
+                               MP4_FreeBox_stts );
 
     MP4_GETVERSIONFLAGS( p_box->data.p_stts );
     MP4_GET4BYTES( p_box->data.p_stts->i_entry_count );
 
+    if( b_lazy )
+    {
+        p_box->data.p_stts->i_entries_pos = MP4_TABLE_ENTRIES_POS( 8 );
+        MP4_READBOX_EXIT( 1 );
+    }
+
     p_box->data.p_stts->pi_sample_count =
         calloc( p_box->data.p_stts->i_entry_count, sizeof(uint32_t) );
     p_box->data.p_stts->pi_sample_delta =
@@ -1457,12 +1489,20 @@ static void MP4_FreeBox_ctts( MP4_Box_t *p_box )
 
 static int MP4_ReadBox_ctts( stream_t *p_stream, MP4_Box_t *p_box )
 {
-    MP4_READBOX_ENTER( MP4_Box_data_ctts_t, MP4_FreeBox_ctts );
+    const bool b_lazy = MP4_IsLazyTable( p_box, 8 );
+    MP4_READBOX_ENTER_PARTIAL( MP4_Box_data_ctts_t, MP4_TABLE_READ_SIZE( b_lazy, 8 ),
+                               MP4_FreeBox_ctts );
 
     MP4_GETVERSIONFLAGS( p_box->data.p_ctts );
 
     MP4_GET4BYTES( p_box->data.p_ctts->i_entry_count );
 
+    if( b_lazy )
+    {
+        p_box->data.p_ctts->i_entries_pos = MP4_TABLE_ENTRIES_POS( 8 );
+        MP4_READBOX_EXIT( 1 );
+    }
+
     p_box->data.p_ctts->pi_sample_count =
         calloc( p_box->data.p_ctts->i_entry_count, sizeof(uint32_t) );
     p_box->data.p_ctts->pi_sample_offset =
@@ -2699,14 +2739,21 @@ static void MP4_FreeBox_stsz( MP4_Box_t *p_box )
 
 static int MP4_ReadBox_stsz( stream_t *p_stream, MP4_Box_t *p_box )
 {
-    MP4_READBOX_ENTER( MP4_Box_data_stsz_t, MP4_FreeBox_stsz );
+    const bool b_lazy = MP4_IsLazyTable( p_box, 12 );
+    MP4_READBOX_ENTER_PARTIAL( MP4_Box_data_stsz_t, MP4_TABLE_READ_SIZE( b_lazy, 12 ),
+                               MP4_FreeBox_stsz );
 
     MP4_GETVERSIONFLAGS( p_box->data.p_stsz );
 
     MP4_GET4BYTES( p_box->data.p_stsz->i_sample_size );
     MP4_GET4BYTES( p_box->data.p_stsz->i_sample_count );
 
-    if( p_box->data.p_stsz->i_sample_size == 0 )
+    if( p_box->data.p_stsz->i_sample_size == 0 && b_lazy )
+    {
+        p_box->data.p_stsz->i_entry_size = NULL;
+        p_box->data.p_stsz->i_entries_pos = MP4_TABLE_ENTRIES_POS( 12 );
+    }
+    else if( p_box->data.p_stsz->i_sample_size == 0 )
     {
         p_box->data.p_stsz->i_entry_size =
             calloc( p_box->data.p_stsz->i_sample_count, sizeof(uint32_t) );
@@ -2883,12 +2930,20 @@ static void MP4_FreeBox_stss( MP4_Box_t *p_box )
 
 static int MP4_ReadBox_stss( stream_t *p_stream, MP4_Box_t *p_box )
 {
-    MP4_READBOX_ENTER( MP4_Box_data_stss_t, MP4_FreeBox_stss );
+    const bool b_lazy = MP4_IsLazyTable( p_box, 8 );
+    MP4_READBOX_ENTER_PARTIAL( MP4_Box_data_stss_t, MP4_TABLE_READ_SIZE( b_lazy, 8 ),
+                               MP4_FreeBox_stss );
 
     MP4_GETVERSIONFLAGS( p_box->data.p_stss );
 
     MP4_GET4BYTES( p_box->data.p_stss->i_entry_count );
 
+    if( b_lazy )
+    {
+        p_box->data.p_stss->i_entries_pos = MP4_TABLE_ENTRIES_POS( 8 );
+        MP4_READBOX_EXIT( 1 );
+    }
+
     p_box->data.p_stss->i_sample_number =
         calloc( p_box->data.p_stss->i_entry_count, sizeof(uint32_t) );
     if( unlikely( p_box->data.p_stss->i_sample_number == NULL ) )
@@ -4748,7 +4803,7 @@ MP4_Box_t *MP4_BoxGetNextChunk( stream_t *s )
  *  The first box is a virtual box "root" and is the father for all first
  *  level boxes for the file, a sort of virtual contener
  *****************************************************************************/
-MP4_Box_t *MP4_BoxGetRoot( stream_t *p_stream )
+MP4_Box_t *MP4_BoxGetRoot( stream_t *p_stream, bool b_lazy_tables )
 {
     int i_result;
 
@@ -4757,6 +4812,13 @@ MP4_Box_t *MP4_BoxGetRoot( stream_t *p_stream )
         return NULL;
 
     p_vroot->i_shortsize = 1;
+
+    /* The demuxer reads the tables left in the file by pages */
+    bool b_fastseekable;
+    if( b_lazy_tables &&
+        vlc_stream_Control( p_stream, STREAM_CAN_FASTSEEK, &b_fastseekable ) == VLC_SUCCESS &&
+        b_fastseekable )
+        p_vroot->e_flags |= BOX_FLAG_LAZY_TABLES;
     int64_t i_size = stream_Size( p_stream );
     if( i_size > 0 )
         p_vroot->i_size = i_size;
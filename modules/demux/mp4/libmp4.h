@@ -603,6 +603,8 @@ typedef struct MP4_Box_data_stts_s
     uint32_t *pi_sample_count; /* these are array */
     int32_t  *pi_sample_delta;
 
+    uint64_t i_entries_pos; /* in the file, when the arrays are not loaded */
+
 } MP4_Box_data_stts_t;
 
 typedef struct MP4_Box_data_ctts_s
@@ -615,6 +617,8 @@ typedef struct MP4_Box_data_ctts_s
     uint32_t *pi_sample_count; /* these are array */
     int32_t *pi_sample_offset;
 
+    uint64_t i_entries_pos; /* in the file, when the arrays are not loaded */
+
 } MP4_Box_data_ctts_t;
 
 typedef struct MP4_Box_data_cslg_s
@@ -855,6 +859,8 @@ typedef struct MP4_Box_data_stsz_s
 
     uint32_t *i_entry_size; /* array , empty if i_sample_size != 0 */
 
+    uint64_t i_entries_pos; /* in the file, when the array is not loaded */
+
 } MP4_Box_data_stsz_t;
 
 typedef struct MP4_Box_data_stz2_s
@@ -905,6 +911,8 @@ typedef struct MP4_Box_data_stss_s
 
     uint32_t *i_sample_number;
 
+    uint64_t i_entries_pos; /* in the file, when the array is not loaded */
+
 } MP4_Box_data_stss_t;
 
 typedef struct MP4_Box_data_stsh_s
@@ -1765,6 +1773,7 @@ struct MP4_Box_s
     {
         BOX_FLAG_NONE = 0,
         BOX_FLAG_INCOMPLETE,
+        BOX_FLAG_LAZY_TABLES, /* root: large sample tables stay in the file */
     }            e_flags;
 
     UUID_t       i_uuid;  /* Set if i_type == "uuid" */
@@ -1924,9 +1933,12 @@ MP4_Box_t *MP4_BoxGetNextChunk( stream_t * );
  * MP4_BoxGetRoot : Parse the entire file, and create all boxes in memory
  *****************************************************************************
  *  The first box is a virtual box "root" and is the father for all first
- *  level boxes
+ *  level boxes.
+ *  With b_lazy_tables, on fast seekable streams, the entries of the large
+ *  stsz, stts, ctts and stss tables are not loaded, but left in the file at
+ *  i_entries_pos.
  *****************************************************************************/
-MP4_Box_t *MP4_BoxGetRoot( stream_t * );
+MP4_Box_t *MP4_BoxGetRoot( stream_t *, bool b_lazy_tables );
 
 /*****************************************************************************
  * MP4_BoxNew : Allocates a new MP4 Box with its atom type
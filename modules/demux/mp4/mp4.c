@@ -49,6 +49,11 @@ static void Close( vlc_object_t * );
 #define MP4_M4A_TEXT     "M4A audio only"
 #define MP4_M4A_LONGTEXT "Ignore non audio tracks from iTunes audio files"
 
+#define MP4_PAGED_TEXT     N_("Paged sample tables")
+#define MP4_PAGED_LONGTEXT N_("Read the large sample tables of local files " \
+    "on demand, instead of loading them all when opening. This saves " \
+    "time and memory with long recordings.")
+
 vlc_module_begin ()
     set_category( CAT_INPUT )
     set_subcategory( SUBCAT_INPUT_DEMUX )
@@ -57,6 +62,8 @@ vlc_module_begin ()
     set_capability( "demux", 240 )
     set_callbacks( Open, Close )
 
+    add_bool( CFG_PREFIX"paged-index", true, MP4_PAGED_TEXT, MP4_PAGED_LONGTEXT, true )
+
     add_category_hint("Hacks", NULL, true)
     add_bool( CFG_PREFIX"m4a-audioonly", false, MP4_M4A_TEXT, MP4_M4A_LONGTEXT, true )
 vlc_module_end ()
@@ -69,6 +76,11 @@ static int   DemuxRef( demux_t *p_demux ){ (void)p_demux; return 0;}
 static int   DemuxFrag( demux_t * );
 static int   Control ( demux_t *, int, va_list );
 
+/* Coalesced reads, when seeking is slow */
+#define MP4_READAHEAD_SIZE    (2 * 1024 * 1024) /* at most, in one read */
+#define MP4_READAHEAD_GAP     (64 * 1024) /* unused data read through */
+#define MP4_READAHEAD_EXTENTS 4           /* reads kept */
+
 struct demux_sys_t
 {
     MP4_Box_t    *p_root;      /* container for the whole file */
@@ -121,6 +133,25 @@ struct demux_sys_t
     } hacks;
 
     mp4_fragments_index_t *p_fragsindex;
+
+    /* Data of the selected tracks read together, served to the tracks
+     * afterwards, in any order */
+    struct
+    {
+        bool         b_enabled;
+        uint64_t     i_next_pos;    /* after the last samples served */
+        unsigned     i_clock;
+        struct
+        {
+            uint64_t i_pos;
+            block_t *p_data;        /* NULL if unused */
+            unsigned i_used;        /* clock of the last access */
+        } extents[MP4_READAHEAD_EXTENTS];
+
+        unsigned     i_reads;
+        unsigned     i_seeks;
+        unsigned     i_seeks_avoided;
+    } readahead;
 };
 
 #define DEMUX_INCREMENT (CLOCK_FREQ / 4) /* How far the pcr will go, each round */
@@ -150,7 +181,9 @@ static void MP4_TrackSelect  ( demux_t *, mp4_track_t *, bool );
 static int  MP4_TrackSeek   ( demux_t *, mp4_track_t *, mtime_t );
 
 static uint64_t MP4_TrackGetPos    ( mp4_track_t * );
+static uint64_t MP4_ChunkGetSampleOffset( mp4_track_t *, uint32_t, uint32_t );
 static uint32_t MP4_TrackGetReadSize( mp4_track_t *, uint32_t * );
+static bool     MP4_TrackTablesFailed( mp4_track_t * );
 static int      MP4_TrackNextSample( demux_t *, mp4_track_t *, uint32_t );
 static void     MP4_TrackSetELST( demux_t *, mp4_track_t *, int64_t );
 
@@ -298,22 +331,25 @@ static inline int64_t MP4_TrackGetDTS( demux_t *p_demux, mp4_track_t *p_track )
     demux_sys_t *p_sys = p_demux->p_sys;
     const mp4_chunk_t *p_chunk = &p_track->chunk[p_track->i_chunk];
 
-    unsigned int i_index = 0;
-    unsigned int i_sample = p_track->i_sample - p_chunk->i_sample_first;
+    uint32_t i_index = p_chunk->i_dts_entry;
+    uint32_t i_skip = p_chunk->i_dts_skip;
+    uint32_t i_sample = p_track->i_sample - p_chunk->i_sample_first;
     int64_t i_dts = p_chunk->i_first_dts;
 
-    while( i_sample > 0 && i_index < p_chunk->i_entries_dts )
+    while( i_sample > 0 && i_index < p_track->stts.i_count )
     {
-        if( i_sample > p_chunk->p_sample_count_dts[i_index] )
+        uint32_t i_count = MP4_Table_Get( &p_track->stts, i_index, 0 ) - i_skip;
+        uint32_t i_delta = MP4_Table_Get( &p_track->stts, i_index, 1 );
+        if( i_sample > i_count )
         {
-            i_dts += p_chunk->p_sample_count_dts[i_index] *
-                p_chunk->p_sample_delta_dts[i_index];
-            i_sample -= p_chunk->p_sample_count_dts[i_index];
+            i_dts += (int64_t) i_count * i_delta;
+            i_sample -= i_count;
             i_index++;
+            i_skip = 0;
         }
         else
         {
-            i_dts += i_sample * p_chunk->p_sample_delta_dts[i_index];
+            i_dts += (int64_t) i_sample * i_delta;
             break;
         }
     }
@@ -344,24 +380,24 @@ static inline bool MP4_TrackGetPTSDelta( demux_t *p_demux, mp4_track_t *p_track,
                                          int64_t *pi_delta )
 {
     VLC_UNUSED( p_demux );
-    mp4_chunk_t *ck = &p_track->chunk[p_track->i_chunk];
+    const mp4_chunk_t *ck = &p_track->chunk[p_track->i_chunk];
 
-    unsigned int i_index = 0;
-    unsigned int i_sample = p_track->i_sample - ck->i_sample_first;
+    uint32_t i_skip = ck->i_pts_skip;
+    uint32_t i_sample = p_track->i_sample - ck->i_sample_first;
 
-    if( ck->p_sample_count_pts == NULL || ck->p_sample_offset_pts == NULL )
-        return false;
-
-    for( i_index = 0; i_index < ck->i_entries_pts ; i_index++ )
+    for( uint32_t i_index = ck->i_pts_entry; i_index < p_track->ctts.i_count; i_index++ )
     {
-        if( i_sample < ck->p_sample_count_pts[i_index] )
+        uint32_t i_count = MP4_Table_Get( &p_track->ctts, i_index, 0 ) - i_skip;
+        if( i_sample < i_count )
         {
-            *pi_delta = MP4_rescale( ck->p_sample_offset_pts[i_index],
+            int32_t i_offset = MP4_Table_Get( &p_track->ctts, i_index, 1 );
+            *pi_delta = MP4_rescale( i_offset + p_track->i_cts_shift,
                                      p_track->i_timescale, CLOCK_FREQ );
             return true;
         }
 
-        i_sample -= ck->p_sample_count_pts[i_index];
+        i_sample -= i_count;
+        i_skip = 0;
     }
     return false;
 }
@@ -378,7 +414,8 @@ static int LoadInitFrag( demux_t *p_demux )
     demux_sys_t *p_sys = p_demux->p_sys;
 
     /* Load all boxes ( except raw data ) */
-    if( ( p_sys->p_root = MP4_BoxGetRoot( p_demux->s ) ) == NULL )
+    const bool b_paged = var_InheritBool( p_demux, CFG_PREFIX"paged-index" );
+    if( ( p_sys->p_root = MP4_BoxGetRoot( p_demux->s, b_paged ) ) == NULL )
     {
         goto LoadInitFragError;
     }
@@ -1002,6 +1039,11 @@ static int Open( vlc_object_t * p_this )
             msg_Warn( p_demux, "that media doesn't look interleaved, will need to seek");
         else if( i_max_continuity > DEMUX_TRACK_MAX_PRELOAD )
             msg_Warn( p_demux, "that media doesn't look properly interleaved, will need to seek");
+
+        /* Even interleaved tracks can be far apart in time */
+        p_sys->readahead.b_enabled = p_sys->b_seekable;
+        if( p_sys->readahead.b_enabled )
+            var_Create( p_demux, "mp4-seeks-avoided", VLC_VAR_INTEGER );
     }
 
     /* */
@@ -1161,6 +1203,193 @@ static block_t * MP4_RTPHint_Convert( demux_t *p_demux, block_t *p_block, vlc_fo
     return p_converted;
 }
 
+/*****************************************************************************
+ * Read-ahead: on slowly seekable streams, the data of the next chunks of all
+ * selected tracks is read at once, when it is close enough, so that
+ * badly interleaved tracks do not need a seek for each chunk.
+ *****************************************************************************/
+typedef struct
+{
+    uint64_t i_start;
+    uint64_t i_end;
+} mp4_range_t;
+
+static int RangeCmp( const void *a, const void *b )
+{
+    const mp4_range_t *ra = a, *rb = b;
+    return ( ra->i_start > rb->i_start ) - ( ra->i_start < rb->i_start );
+}
+
+/* Returns where a read starting with the samples at [i_pos, i_end) should
+ * end, to also get the next chunks of the selected tracks */
+static uint64_t ReadAheadPlan( demux_t *p_demux, uint64_t i_pos, uint64_t i_end )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    const uint64_t i_max = i_pos + MP4_READAHEAD_SIZE;
+    mp4_range_t *p_ranges = NULL;
+    size_t i_ranges = 0, i_alloc = 0;
+
+    for( unsigned i = 0; i < p_sys->i_tracks; i++ )
+    {
+        mp4_track_t *tk = &p_sys->track[i];
+        if( !tk->b_ok || !tk->b_selected || tk->b_chapters_source ||
+            tk->i_sample >= tk->i_sample_count )
+            continue;
+
+        /* Chunks that will be demuxed soon */
+        const uint64_t i_horizon = tk->chunk[tk->i_chunk].i_first_dts +
+            MP4_rescale( DEMUX_TRACK_MAX_PRELOAD, CLOCK_FREQ, tk->i_timescale );
+
+        for( uint32_t j = tk->i_chunk; j < tk->i_chunk_count; j++ )
+        {
+            const mp4_chunk_t *ck = &tk->chunk[j];
+            if( ck->i_first_dts > i_horizon || ck->i_offset >= i_max )
+                break;
+            if( ck->i_sample_count == 0 )
+                continue;
+
+            mp4_range_t range;
+            range.i_start = ( j == tk->i_chunk ) ? MP4_TrackGetPos( tk ) : ck->i_offset;
+            range.i_end = ck->i_offset + MP4_ChunkGetSampleOffset( tk, j,
+                                ck->i_sample_first + ck->i_sample_count );
+            if( range.i_end <= i_pos )
+                continue;
+
+            if( i_ranges == i_alloc )
+            {
+                size_t i_new = i_alloc ? i_alloc * 2 : 64;
+                mp4_range_t *p_new = realloc( p_ranges, i_new * sizeof(*p_new) );
+                if( unlikely(p_new == NULL) )
+                    break;
+                p_ranges = p_new;
+                i_alloc = i_new;
+            }
+            p_ranges[i_ranges++] = range;
+        }
+    }
+
+    if( i_ranges > 1 )
+        qsort( p_ranges, i_ranges, sizeof(*p_ranges), RangeCmp );
+
+    /* Grow the read over the ranges starting close to its end */
+    for( size_t i = 0; i < i_ranges && i_end < i_max; i++ )
+    {
+        const mp4_range_t *range = &p_ranges[i];
+        if( range->i_start < i_pos || range->i_end <= i_end )
+            continue;
+        if( range->i_start > i_end + MP4_READAHEAD_GAP )
+            break;
+        i_end = __MIN( range->i_end, i_max );
+    }
+
+    free( p_ranges );
+    return i_end;
+}
+
+static block_t *ReadAheadBlock( demux_t *p_demux, uint64_t i_pos, size_t i_size )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    if( vlc_stream_Tell( p_demux->s ) != i_pos )
+    {
+        if( MP4_Seek( p_demux->s, i_pos ) != VLC_SUCCESS )
+        {
+            msg_Warn( p_demux, "Failed to seek to %"PRIu64, i_pos );
+            return NULL;
+        }
+        p_sys->readahead.i_seeks++;
+    }
+    p_sys->readahead.i_reads++;
+    return vlc_stream_Block( p_demux->s, i_size );
+}
+
+/* Reads the samples at [i_pos, i_pos + i_size) */
+static block_t *MP4_ReadSamples( demux_t *p_demux, uint64_t i_pos, uint32_t i_size )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    block_t *p_block = NULL;
+
+    if( !p_sys->readahead.b_enabled )
+        return ReadAheadBlock( p_demux, i_pos, i_size );
+
+    /* From a previous read, or from a new one */
+    unsigned i_extent = 0;
+    for( unsigned i = 0; i < MP4_READAHEAD_EXTENTS; i++ )
+    {
+        const block_t *p_data = p_sys->readahead.extents[i].p_data;
+        const uint64_t i_start = p_sys->readahead.extents[i].i_pos;
+        if( p_data && i_pos >= i_start &&
+            i_pos + i_size <= i_start + p_data->i_buffer )
+        {
+            p_block = block_Alloc( i_size );
+            if( unlikely(p_block == NULL) )
+                return NULL;
+            memcpy( p_block->p_buffer, &p_data->p_buffer[i_pos - i_start], i_size );
+            p_sys->readahead.extents[i].i_used = ++p_sys->readahead.i_clock;
+            if( i_pos != p_sys->readahead.i_next_pos )
+                var_SetInteger( p_demux, "mp4-seeks-avoided",
+                                ++p_sys->readahead.i_seeks_avoided );
+            break;
+        }
+        /* Least recently used one otherwise */
+        if( p_sys->readahead.extents[i].i_used <
+            p_sys->readahead.extents[i_extent].i_used )
+            i_extent = i;
+    }
+
+    if( p_block == NULL )
+    {
+        const uint64_t i_end = ReadAheadPlan( p_demux, i_pos, i_pos + i_size );
+        if( i_end == i_pos + i_size )
+        {
+            p_block = ReadAheadBlock( p_demux, i_pos, i_size );
+        }
+        else
+        {
+            block_t *p_data = ReadAheadBlock( p_demux, i_pos, i_end - i_pos );
+            if( p_data == NULL )
+                return NULL;
+            if( p_data->i_buffer < i_size )
+            {
+                block_Release( p_data );
+                return NULL;
+            }
+
+            if( p_sys->readahead.extents[i_extent].p_data )
+                block_Release( p_sys->readahead.extents[i_extent].p_data );
+            p_sys->readahead.extents[i_extent].i_pos = i_pos;
+            p_sys->readahead.extents[i_extent].p_data = p_data;
+            p_sys->readahead.extents[i_extent].i_used = ++p_sys->readahead.i_clock;
+
+            p_block = block_Alloc( i_size );
+            if( unlikely(p_block == NULL) )
+                return NULL;
+            memcpy( p_block->p_buffer, p_data->p_buffer, i_size );
+        }
+    }
+
+    if( p_block )
+        p_sys->readahead.i_next_pos = i_pos + i_size;
+    return p_block;
+}
+
+static void MP4_ReadAheadClean( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    if( p_sys->readahead.b_enabled )
+    {
+        msg_Dbg( p_demux, "read-ahead: %u reads, %u seeks, %u seeks avoided",
+                 p_sys->readahead.i_reads, p_sys->readahead.i_seeks,
+                 p_sys->readahead.i_seeks_avoided );
+        var_Destroy( p_demux, "mp4-seeks-avoided" );
+    }
+
+    for( unsigned i = 0; i < MP4_READAHEAD_EXTENTS; i++ )
+        if( p_sys->readahead.extents[i].p_data )
+            block_Release( p_sys->readahead.extents[i].p_data );
+}
+
 /*****************************************************************************
  * Demux: read packet and send them to decoders
  *****************************************************************************
@@ -1196,25 +1425,20 @@ static int DemuxTrack( demux_t *p_demux, mp4_track_t *tk, uint64_t i_readpos,
 #endif
 
         i_samplessize = MP4_TrackGetReadSize( tk, &i_nb_samples );
+        if( MP4_TrackTablesFailed( tk ) )
+        {
+            msg_Warn( p_demux, "track[0x%x] will be disabled: failed to "
+                      "read its sample tables", tk->i_track_ID );
+            MP4_TrackSelect( p_demux, tk, false );
+            goto end;
+        }
         if( i_samplessize > 0 )
         {
             block_t *p_block;
             int64_t i_delta;
 
-            if( vlc_stream_Tell( p_demux->s ) != i_readpos )
-            {
-                if( MP4_Seek( p_demux->s, i_readpos ) != VLC_SUCCESS )
-                {
-                    msg_Warn( p_demux, "track[0x%x] will be disabled (eof?)"
-                                       ": Failed to seek to %"PRIu64,
-                              tk->i_track_ID, i_readpos );
-                    MP4_TrackSelect( p_demux, tk, false );
-                    goto end;
-                }
-            }
-
             /* now read pes */
-            if( !(p_block = vlc_stream_Block( p_demux->s, i_samplessize )) )
+            if( !(p_block = MP4_ReadSamples( p_demux, i_readpos, i_samplessize )) )
             {
                 msg_Warn( p_demux, "track[0x%x] will be disabled (eof?)"
                                    ": Failed to read %d bytes sample at %"PRIu64,
@@ -2122,6 +2346,8 @@ static void Close ( vlc_object_t * p_this )
         MP4_TrackClean( p_demux->out, &p_sys->track[i_track] );
     free( p_sys->track );
 
+    MP4_ReadAheadClean( p_demux );
+
     free( p_sys );
 }
 
@@ -2312,12 +2538,6 @@ static int TrackCreateChunksIndex( demux_t *p_demux,
         ck->i_offset = BOXDATA(p_co64)->i_chunk_offset[i_chunk];
 
         ck->i_first_dts = 0;
-        ck->i_entries_dts = 0;
-        ck->p_sample_count_dts = NULL;
-        ck->p_sample_delta_dts = NULL;
-        ck->i_entries_pts = 0;
-        ck->p_sample_count_pts = NULL;
-        ck->p_sample_offset_pts = NULL;
     }
 
     /* now we read index for SampleEntry( soun vide mp4a mp4v ...)
@@ -2379,52 +2599,69 @@ static int TrackCreateChunksIndex( demux_t *p_demux,
     return VLC_SUCCESS;
 }
 
-static int xTTS_CountEntries( demux_t *p_demux, uint32_t *pi_entry /* out */,
-                              const uint32_t i_index,
-                              uint32_t i_index_samples_left,
-                              uint32_t i_sample_count,
-                              const uint32_t *pi_index_sample_count,
-                              const uint32_t i_table_count )
+/* Locates the first sample of each chunk in the stts or ctts table, and
+ * sets the dts of the chunks from the stts one */
+static void TrackIndexTTS( demux_t *p_demux, mp4_track_t *p_demux_track,
+                           mp4_table_t *p_table, bool b_dts )
 {
-    uint32_t i_array_offset;
-    while( i_sample_count > 0 )
+    uint32_t i_index = 0;
+    uint32_t i_skip = 0; /* samples of the entry in previous chunks */
+    uint64_t i_next_dts = 0;
+    bool b_short = false;
+
+    for( uint32_t i_chunk = 0; i_chunk < p_demux_track->i_chunk_count; i_chunk++ )
     {
-        if ( likely((UINT32_MAX - i_index) >= *pi_entry) )
-            i_array_offset = i_index + *pi_entry;
-        else
-            return VLC_EGENERIC;
+        mp4_chunk_t *ck = &p_demux_track->chunk[i_chunk];
+        uint32_t i_sample_count = ck->i_sample_count;
 
-        if ( i_array_offset >= i_table_count )
+        if( b_dts )
         {
-            msg_Err( p_demux, "invalid index counting total samples %u %u", i_array_offset,  i_table_count );
-            return VLC_ENOVAR;
+            ck->i_first_dts = i_next_dts;
+            ck->i_dts_entry = i_index;
+            ck->i_dts_skip = i_skip;
+        }
+        else
+        {
+            ck->i_pts_entry = i_index;
+            ck->i_pts_skip = i_skip;
         }
 
-        if ( i_index_samples_left )
+        while( i_sample_count > 0 )
         {
-            if ( i_index_samples_left > i_sample_count )
+            if( i_index >= p_table->i_count )
             {
-                i_index_samples_left -= i_sample_count;
-                i_sample_count = 0;
-                *pi_entry +=1; /* No samples left, go copy */
+                b_short = true;
                 break;
             }
-            else
+
+            const uint32_t i_left = MP4_Table_Get( p_table, i_index, 0 ) - i_skip;
+            const uint32_t i_used = __MIN( i_left, i_sample_count );
+
+            if( b_dts )
+                i_next_dts += (uint64_t) i_used * MP4_Table_Get( p_table, i_index, 1 );
+            i_sample_count -= i_used;
+
+            if( i_used == i_left )
             {
-                i_sample_count -= i_index_samples_left;
-                i_index_samples_left = 0;
-                *pi_entry += 1;
-                continue;
+                i_index++;
+                i_skip = 0;
             }
+            else
+                i_skip += i_used;
         }
-        else
-        {
-            i_sample_count -= __MIN( i_sample_count, pi_index_sample_count[i_array_offset] );
-            *pi_entry += 1;
-        }
+
+        if( b_dts )
+            ck->i_duration = i_next_dts - ck->i_first_dts;
     }
 
-    return VLC_SUCCESS;
+    if( b_short )
+        msg_Warn( p_demux, "track[Id 0x%x] %s table is too small",
+                  p_demux_track->i_track_ID, b_dts ? "stts" : "ctts" );
+
+    if( b_dts )
+        msg_Dbg( p_demux, "track[Id 0x%x] read %"PRIu32" samples length:%"PRId64"s",
+                 p_demux_track->i_track_ID, p_demux_track->i_sample_count,
+                 i_next_dts / p_demux_track->i_timescale );
 }
 
 static int TrackCreateSamplesIndex( demux_t *p_demux,
@@ -2432,7 +2669,6 @@ static int TrackCreateSamplesIndex( demux_t *p_demux,
 {
     MP4_Box_t *p_box;
     MP4_Box_data_stsz_t *stsz;
-    /* TODO use also stss and stsh table for seeking */
     /* FIXME use edit table */
 
     /* Find stsz
@@ -2456,27 +2692,10 @@ static int TrackCreateSamplesIndex( demux_t *p_demux,
         p_demux_track->i_sample_count = __MIN(p_demux_track->i_sample_count, stsz->i_sample_count);
     }
 
-    if( stsz->i_sample_size )
-    {
-        /* 1: all sample have the same size, so no need to construct a table */
-        p_demux_track->i_sample_size = stsz->i_sample_size;
-        p_demux_track->p_sample_size = NULL;
-    }
-    else
-    {
-        /* 2: each sample can have a different size */
-        p_demux_track->i_sample_size = 0;
-        p_demux_track->p_sample_size =
-            calloc( p_demux_track->i_sample_count, sizeof( uint32_t ) );
-        if( p_demux_track->p_sample_size == NULL )
-            return VLC_ENOMEM;
-
-        for( uint32_t i_sample = 0; i_sample < p_demux_track->i_sample_count; i_sample++ )
-        {
-            p_demux_track->p_sample_size[i_sample] =
-                    stsz->i_entry_size[i_sample];
-        }
-    }
+    /* all sample have the same size, or each sample can have a different
+     * size, read from the table */
+    p_demux_track->i_sample_size = stsz->i_sample_size;
+    MP4_Table_Init( &p_demux_track->stsz, p_demux->s, p_box );
 
     if ( p_demux_track->i_chunk_count && p_demux_track->i_sample_size == 0 )
     {
@@ -2488,16 +2707,6 @@ static int TrackCreateSamplesIndex( demux_t *p_demux,
         }
     }
 
-    /* Use stts table to create a sample number -> dts table.
-     * XXX: if we don't want to waste too much memory, we can't expand
-     *  the box! so each chunk will contain an "extract" of this table
-     *  for fast research (problem with raw stream where a sample is sometime
-     *  just channels*bits_per_sample/8 */
-
-     /* FIXME: refactor STTS & CTTS, STTS having now only few extra lines and
-      *        differing in 2/2 fields and 1 signedness */
-
-    mtime_t i_next_dts = 0;
     /* Find stts
      *  Gives mapping between sample and decoding time
      */
@@ -2507,105 +2716,9 @@ static int TrackCreateSamplesIndex( demux_t *p_demux,
         msg_Warn( p_demux, "cannot find STTS box" );
         return VLC_EGENERIC;
     }
-    else
-    {
-        MP4_Box_data_stts_t *stts = p_box->data.p_stts;
-
-        msg_Warn( p_demux, "STTS table of %"PRIu32" entries", stts->i_entry_count );
-
-        /* Create sample -> dts table per chunk */
-        uint32_t i_index = 0;
-        uint32_t i_current_index_samples_left = 0;
-
-        for( uint32_t i_chunk = 0; i_chunk < p_demux_track->i_chunk_count; i_chunk++ )
-        {
-            mp4_chunk_t *ck = &p_demux_track->chunk[i_chunk];
-            uint32_t i_sample_count;
-
-            /* save first dts */
-            ck->i_first_dts = i_next_dts;
-
-            /* count how many entries are needed for this chunk
-             * for p_sample_delta_dts and p_sample_count_dts */
-            ck->i_entries_dts = 0;
-
-            int i_ret = xTTS_CountEntries( p_demux, &ck->i_entries_dts, i_index,
-                                           i_current_index_samples_left,
-                                           ck->i_sample_count,
-                                           stts->pi_sample_count,
-                                           stts->i_entry_count );
-            if ( i_ret == VLC_EGENERIC )
-                return i_ret;
-
-            /* allocate them */
-            ck->p_sample_count_dts = calloc( ck->i_entries_dts, sizeof( uint32_t ) );
-            ck->p_sample_delta_dts = calloc( ck->i_entries_dts, sizeof( uint32_t ) );
-            if( !ck->p_sample_count_dts || !ck->p_sample_delta_dts )
-            {
-                free( ck->p_sample_count_dts );
-                free( ck->p_sample_delta_dts );
-                msg_Err( p_demux, "can't allocate memory for i_entry=%"PRIu32, ck->i_entries_dts );
-                ck->i_entries_dts = 0;
-                return VLC_ENOMEM;
-            }
-
-            /* now copy */
-            i_sample_count = ck->i_sample_count;
-
-            for( uint32_t i = 0; i < ck->i_entries_dts; i++ )
-            {
-                if ( i_current_index_samples_left )
-                {
-                    if ( i_current_index_samples_left > i_sample_count )
-                    {
-                        ck->p_sample_count_dts[i] = i_sample_count;
-                        ck->p_sample_delta_dts[i] = stts->pi_sample_delta[i_index];
-                        i_next_dts += ck->p_sample_count_dts[i] * stts->pi_sample_delta[i_index];
-                        if ( i_sample_count ) ck->i_duration = i_next_dts - ck->i_first_dts;
-                        i_current_index_samples_left -= i_sample_count;
-                        i_sample_count = 0;
-                        assert( i == ck->i_entries_dts - 1 );
-                        break;
-                    }
-                    else
-                    {
-                        ck->p_sample_count_dts[i] = i_current_index_samples_left;
-                        ck->p_sample_delta_dts[i] = stts->pi_sample_delta[i_index];
-                        i_next_dts += ck->p_sample_count_dts[i] * stts->pi_sample_delta[i_index];
-                        if ( i_current_index_samples_left ) ck->i_duration = i_next_dts - ck->i_first_dts;
-                        i_sample_count -= i_current_index_samples_left;
-                        i_current_index_samples_left = 0;
-                        i_index++;
-                    }
-                }
-                else
-                {
-                    if ( stts->pi_sample_count[i_index] > i_sample_count )
-                    {
-                        ck->p_sample_count_dts[i] = i_sample_count;
-                        ck->p_sample_delta_dts[i] = stts->pi_sample_delta[i_index];
-                        i_next_dts += ck->p_sample_count_dts[i] * stts->pi_sample_delta[i_index];
-                        if ( i_sample_count ) ck->i_duration = i_next_dts - ck->i_first_dts;
-                        i_current_index_samples_left = stts->pi_sample_count[i_index] - i_sample_count;
-                        i_sample_count = 0;
-                        assert( i == ck->i_entries_dts - 1 );
-                        // keep building from same index
-                    }
-                    else
-                    {
-                        ck->p_sample_count_dts[i] = stts->pi_sample_count[i_index];
-                        ck->p_sample_delta_dts[i] = stts->pi_sample_delta[i_index];
-                        i_next_dts += ck->p_sample_count_dts[i] * stts->pi_sample_delta[i_index];
-                        if ( stts->pi_sample_count[i_index] ) ck->i_duration = i_next_dts - ck->i_first_dts;
-                        i_sample_count -= stts->pi_sample_count[i_index];
-                        i_index++;
-                    }
-                }
-
-            }
-        }
-    }
-
+    MP4_Table_Init( &p_demux_track->stts, p_demux->s, p_box );
+    msg_Warn( p_demux, "STTS table of %"PRIu32" entries", p_demux_track->stts.i_count );
+    TrackIndexTTS( p_demux, p_demux_track, &p_demux_track->stts, true );
 
     /* Find ctts
      *  Gives the delta between decoding time (dts) and composition table (pts)
@@ -2613,100 +2726,25 @@ static int TrackCreateSamplesIndex( demux_t *p_demux,
     p_box = MP4_BoxGet( p_demux_track->p_stbl, "ctts" );
     if( p_box && p_box->data.p_ctts )
     {
-        MP4_Box_data_ctts_t *ctts = p_box->data.p_ctts;
-
-        msg_Warn( p_demux, "CTTS table of %"PRIu32" entries", ctts->i_entry_count );
+        MP4_Table_Init( &p_demux_track->ctts, p_demux->s, p_box );
+        msg_Warn( p_demux, "CTTS table of %"PRIu32" entries", p_demux_track->ctts.i_count );
 
-        int64_t i_cts_shift = 0;
         const MP4_Box_t *p_cslg = MP4_BoxGet( p_demux_track->p_stbl, "cslg" );
         if( p_cslg && BOXDATA(p_cslg) )
-            i_cts_shift = BOXDATA(p_cslg)->ct_to_dts_shift;
-
-        /* Create pts-dts table per chunk */
-        uint32_t i_index = 0;
-        uint32_t i_current_index_samples_left = 0;
-
-        for( uint32_t i_chunk = 0; i_chunk < p_demux_track->i_chunk_count; i_chunk++ )
-        {
-            mp4_chunk_t *ck = &p_demux_track->chunk[i_chunk];
-            uint32_t i_sample_count;
-
-            /* count how many entries are needed for this chunk
-             * for p_sample_offset_pts and p_sample_count_pts */
-            ck->i_entries_pts = 0;
-            int i_ret = xTTS_CountEntries( p_demux, &ck->i_entries_pts, i_index,
-                                           i_current_index_samples_left,
-                                           ck->i_sample_count,
-                                           ctts->pi_sample_count,
-                                           ctts->i_entry_count );
-            if ( i_ret == VLC_EGENERIC )
-                return i_ret;
-
-            /* allocate them */
-            ck->p_sample_count_pts = calloc( ck->i_entries_pts, sizeof( uint32_t ) );
-            ck->p_sample_offset_pts = calloc( ck->i_entries_pts, sizeof( int32_t ) );
-            if( !ck->p_sample_count_pts || !ck->p_sample_offset_pts )
-            {
-                free( ck->p_sample_count_pts );
-                free( ck->p_sample_offset_pts );
-                msg_Err( p_demux, "can't allocate memory for i_entry=%"PRIu32, ck->i_entries_pts );
-                ck->i_entries_pts = 0;
-                return VLC_ENOMEM;
-            }
+            p_demux_track->i_cts_shift = BOXDATA(p_cslg)->ct_to_dts_shift;
 
-            /* now copy */
-            i_sample_count = ck->i_sample_count;
-
-            for( uint32_t i = 0; i < ck->i_entries_pts; i++ )
-            {
-                if ( i_current_index_samples_left )
-                {
-                    if ( i_current_index_samples_left > i_sample_count )
-                    {
-                        ck->p_sample_count_pts[i] = i_sample_count;
-                        ck->p_sample_offset_pts[i] = ctts->pi_sample_offset[i_index] + i_cts_shift;
-                        i_current_index_samples_left -= i_sample_count;
-                        i_sample_count = 0;
-                        assert( i == ck->i_entries_pts - 1 );
-                        break;
-                    }
-                    else
-                    {
-                        ck->p_sample_count_pts[i] = i_current_index_samples_left;
-                        ck->p_sample_offset_pts[i] = ctts->pi_sample_offset[i_index] + i_cts_shift;
-                        i_sample_count -= i_current_index_samples_left;
-                        i_current_index_samples_left = 0;
-                        i_index++;
-                    }
-                }
-                else
-                {
-                    if ( ctts->pi_sample_count[i_index] > i_sample_count )
-                    {
-                        ck->p_sample_count_pts[i] = i_sample_count;
-                        ck->p_sample_offset_pts[i] = ctts->pi_sample_offset[i_index] + i_cts_shift;
-                        i_current_index_samples_left = ctts->pi_sample_count[i_index] - i_sample_count;
-                        i_sample_count = 0;
-                        assert( i == ck->i_entries_pts - 1 );
-                        // keep building from same index
-                    }
-                    else
-                    {
-                        ck->p_sample_count_pts[i] = ctts->pi_sample_count[i_index];
-                        ck->p_sample_offset_pts[i] = ctts->pi_sample_offset[i_index] + i_cts_shift;
-                        i_sample_count -= ctts->pi_sample_count[i_index];
-                        i_index++;
-                    }
-                }
-
-
-            }
-        }
+        TrackIndexTTS( p_demux, p_demux_track, &p_demux_track->ctts, false );
     }
 
-    msg_Dbg( p_demux, "track[Id 0x%x] read %"PRIu32" samples length:%"PRId64"s",
-             p_demux_track->i_track_ID, p_demux_track->i_sample_count,
-             i_next_dts / p_demux_track->i_timescale );
+    /* Find stss
+     *  Gives the sync samples, for seeking
+     */
+    p_box = MP4_BoxGet( p_demux_track->p_stbl, "stss" );
+    if( p_box && p_box->data.p_stss )
+    {
+        MP4_Table_Init( &p_demux_track->stss, p_demux->s, p_box );
+        p_demux_track->b_stss = true;
+    }
 
     return VLC_SUCCESS;
 }
@@ -2876,24 +2914,25 @@ static int TrackGetNearestSeekPoint( demux_t *p_demux, mp4_track_t *p_track,
     int i_ret = VLC_EGENERIC;
     *pi_sync_sample = 0;
 
-    const MP4_Box_t *p_stss;
-    if( ( p_stss = MP4_BoxGet( p_track->p_stbl, "stss" ) ) )
+    if( p_track->b_stss && p_track->stss.i_count > 0 )
     {
-        const MP4_Box_data_stss_t *p_stss_data = BOXDATA(p_stss);
         msg_Dbg( p_demux, "track[Id 0x%x] using Sync Sample Box (stss)",
                  p_track->i_track_ID );
-        for( unsigned i_index = 0; i_index < p_stss_data->i_entry_count; i_index++ )
+
+        /* Last sync sample up to the sample, or the first one */
+        uint32_t i_low = 0, i_high = p_track->stss.i_count;
+        while( i_high - i_low > 1 )
         {
-            if( i_index >= p_stss_data->i_entry_count - 1 ||
-                i_sample < p_stss_data->i_sample_number[i_index+1] )
-            {
-                *pi_sync_sample = p_stss_data->i_sample_number[i_index];
-                msg_Dbg( p_demux, "stss gives %d --> %" PRIu32 " (sample number)",
-                         i_sample, *pi_sync_sample );
-                i_ret = VLC_SUCCESS;
-                break;
-            }
+            uint32_t i_mid = i_low + ( i_high - i_low ) / 2;
+            if( MP4_Table_Get( &p_track->stss, i_mid, 0 ) <= i_sample )
+                i_low = i_mid;
+            else
+                i_high = i_mid;
         }
+        *pi_sync_sample = MP4_Table_Get( &p_track->stss, i_low, 0 );
+        msg_Dbg( p_demux, "stss gives %d --> %" PRIu32 " (sample number)",
+                 i_sample, *pi_sync_sample );
+        i_ret = VLC_SUCCESS;
     }
 
     /* try rap samples groups */
@@ -2939,6 +2978,21 @@ static int TrackGetNearestSeekPoint( demux_t *p_demux, mp4_track_t *p_track,
     return i_ret;
 }
 
+/* Last chunk starting up to the sample, skipping the empty ones */
+static uint32_t TrackGetChunkBySample( const mp4_track_t *p_track, uint32_t i_sample )
+{
+    uint32_t i_low = 0, i_high = p_track->i_chunk_count;
+    while( i_high - i_low > 1 )
+    {
+        uint32_t i_mid = i_low + ( i_high - i_low ) / 2;
+        if( p_track->chunk[i_mid].i_sample_first <= i_sample )
+            i_low = i_mid;
+        else
+            i_high = i_mid;
+    }
+    return i_low;
+}
+
 /* given a time it return sample/chunk
  * it also update elst field of the track
  */
@@ -2948,9 +3002,8 @@ static int TrackTimeToSampleChunk( demux_t *p_demux, mp4_track_t *p_track,
 {
     demux_sys_t *p_sys = p_demux->p_sys;
     uint64_t     i_dts;
-    unsigned int i_sample;
-    unsigned int i_chunk;
-    int          i_index;
+    uint32_t     i_sample;
+    uint32_t     i_chunk;
 
     /* FIXME see if it's needed to check p_track->i_chunk_count */
     if( p_track->i_chunk_count == 0 )
@@ -2994,49 +3047,47 @@ static int TrackTimeToSampleChunk( demux_t *p_demux, mp4_track_t *p_track,
         i_start = MP4_rescale( i_start, CLOCK_FREQ, p_track->i_timescale );
     }
 
-    /* we start from sample 0/chunk 0, hope it won't take too much time */
-    /* *** find good chunk *** */
-    for( i_chunk = 0; ; i_chunk++ )
+    /* *** find good chunk: the last one starting before i_start *** */
+    uint32_t i_low = 0, i_high = p_track->i_chunk_count;
+    while( i_high - i_low > 1 )
     {
-        if( i_chunk + 1 >= p_track->i_chunk_count )
-        {
-            /* at the end and can't check if i_start in this chunk,
-               it will be check while searching i_sample */
-            i_chunk = p_track->i_chunk_count - 1;
-            break;
-        }
-
-        if( (uint64_t)i_start >= p_track->chunk[i_chunk].i_first_dts &&
-            (uint64_t)i_start <  p_track->chunk[i_chunk + 1].i_first_dts )
-        {
-            break;
-        }
+        uint32_t i_mid = i_low + ( i_high - i_low ) / 2;
+        if( p_track->chunk[i_mid].i_first_dts <= (uint64_t)i_start )
+            i_low = i_mid;
+        else
+            i_high = i_mid;
     }
+    i_chunk = i_low;
 
     /* *** find sample in the chunk *** */
-    i_sample = p_track->chunk[i_chunk].i_sample_first;
-    i_dts    = p_track->chunk[i_chunk].i_first_dts;
-    for( i_index = 0; i_sample < p_track->chunk[i_chunk].i_sample_count; )
-    {
-        if( i_dts +
-            p_track->chunk[i_chunk].p_sample_count_dts[i_index] *
-            p_track->chunk[i_chunk].p_sample_delta_dts[i_index] < (uint64_t)i_start )
-        {
-            i_dts    +=
-                p_track->chunk[i_chunk].p_sample_count_dts[i_index] *
-                p_track->chunk[i_chunk].p_sample_delta_dts[i_index];
-
-            i_sample += p_track->chunk[i_chunk].p_sample_count_dts[i_index];
+    const mp4_chunk_t *ck = &p_track->chunk[i_chunk];
+    uint32_t i_index = ck->i_dts_entry;
+    uint32_t i_skip = ck->i_dts_skip;
+    uint32_t i_left = ck->i_sample_count;
+    i_sample = ck->i_sample_first;
+    i_dts    = ck->i_first_dts;
+    while( i_left > 0 && i_index < p_track->stts.i_count )
+    {
+        uint32_t i_count = MP4_Table_Get( &p_track->stts, i_index, 0 ) - i_skip;
+        uint32_t i_delta = MP4_Table_Get( &p_track->stts, i_index, 1 );
+        if( i_count > i_left )
+            i_count = i_left;
+
+        if( i_dts + (uint64_t) i_count * i_delta < (uint64_t)i_start )
+        {
+            i_dts    += (uint64_t) i_count * i_delta;
+            i_sample += i_count;
+            i_left   -= i_count;
             i_index++;
+            i_skip = 0;
         }
         else
         {
-            if( p_track->chunk[i_chunk].p_sample_delta_dts[i_index] <= 0 )
-            {
-                break;
-            }
-            i_sample += ( i_start - i_dts ) /
-                p_track->chunk[i_chunk].p_sample_delta_dts[i_index];
+            if( i_delta > 0 )
+                i_sample += ( i_start - i_dts ) / i_delta;
+            /* The very end of the track is still within its last sample */
+            if( i_sample == p_track->i_sample_count )
+                i_sample--;
             break;
         }
     }
@@ -3054,23 +3105,10 @@ static int TrackTimeToSampleChunk( demux_t *p_demux, mp4_track_t *p_track,
     uint32_t i_sync_sample;
     if( VLC_SUCCESS ==
         TrackGetNearestSeekPoint( p_demux, p_track, i_sample, &i_sync_sample ) )
-    {
-        /* Go to chunk */
-        if( i_sync_sample <= i_sample )
-        {
-            while( i_chunk > 0 &&
-                   i_sync_sample < p_track->chunk[i_chunk].i_sample_first )
-                i_chunk--;
-        }
-        else
-        {
-            while( i_chunk < p_track->i_chunk_count - 1 &&
-                   i_sync_sample >= p_track->chunk[i_chunk].i_sample_first +
-                                    p_track->chunk[i_chunk].i_sample_count )
-                i_chunk++;
-        }
         i_sample = i_sync_sample;
-    }
+
+    /* Go to chunk */
+    i_chunk = TrackGetChunkBySample( p_track, i_sample );
 
     *pi_chunk  = i_chunk;
     *pi_sample = i_sample;
@@ -3466,15 +3504,6 @@ static void MP4_TrackSetup( demux_t *p_demux, mp4_track_t *p_track,
     p_track->b_ok = true;
 }
 
-static void DestroyChunk( mp4_chunk_t *ck )
-{
-    free( ck->p_sample_count_dts );
-    free( ck->p_sample_delta_dts );
-    free( ck->p_sample_count_pts );
-    free( ck->p_sample_offset_pts );
-    free( ck->p_sample_size );
-}
-
 /****************************************************************************
  * MP4_TrackClean:
  ****************************************************************************
@@ -3487,15 +3516,12 @@ static void MP4_TrackClean( es_out_t *out, mp4_track_t *p_track )
     if( p_track->p_es )
         es_out_Del( out, p_track->p_es );
 
-    if( p_track->chunk )
-    {
-        for( unsigned int i_chunk = 0; i_chunk < p_track->i_chunk_count; i_chunk++ )
-            DestroyChunk( &p_track->chunk[i_chunk] );
-    }
     free( p_track->chunk );
 
-    if( !p_track->i_sample_size )
-        free( p_track->p_sample_size );
+    MP4_Table_Clean( &p_track->stsz );
+    MP4_Table_Clean( &p_track->stts );
+    MP4_Table_Clean( &p_track->ctts );
+    MP4_Table_Clean( &p_track->stss );
 
     if ( p_track->asfinfo.p_frame )
         block_ChainRelease( p_track->asfinfo.p_frame );
@@ -3539,7 +3565,8 @@ static int MP4_TrackSeek( demux_t *p_demux, mp4_track_t *p_track,
     p_track->b_selected = false;
 
     if( TrackTimeToSampleChunk( p_demux, p_track, i_start,
-                                &i_chunk, &i_sample ) )
+                                &i_chunk, &i_sample ) ||
+        MP4_TrackTablesFailed( p_track ) )
     {
         msg_Warn( p_demux, "cannot select track[Id 0x%x]",
                   p_track->i_track_ID );
@@ -3603,6 +3630,18 @@ static inline uint32_t MP4_GetFixedSampleSize( const mp4_track_t *p_track,
     return i_size;
 }
 
+/* Sample tables left in the file may fail to be read, their entries then
+ * read as 0. Clears the errors of all the tables. */
+static bool MP4_TrackTablesFailed( mp4_track_t *p_track )
+{
+    bool b_failed = MP4_Table_Failed( &p_track->stsz );
+
+    b_failed |= MP4_Table_Failed( &p_track->stts );
+    b_failed |= MP4_Table_Failed( &p_track->ctts );
+    b_failed |= MP4_Table_Failed( &p_track->stss );
+    return b_failed;
+}
+
 static uint32_t MP4_TrackGetReadSize( mp4_track_t *p_track, uint32_t *pi_nb_samples )
 {
     uint32_t i_size = 0;
@@ -3616,7 +3655,7 @@ static uint32_t MP4_TrackGetReadSize( mp4_track_t *p_track, uint32_t *pi_nb_samp
         *pi_nb_samples = 1;
 
         if( p_track->i_sample_size == 0 ) /* all sizes are different */
-            return p_track->p_sample_size[p_track->i_sample];
+            return MP4_Table_Get( &p_track->stsz, p_track->i_sample, 0 );
         else
             return p_track->i_sample_size;
     }
@@ -3649,7 +3688,7 @@ static uint32_t MP4_TrackGetReadSize( mp4_track_t *p_track, uint32_t *pi_nb_samp
         if( p_track->i_sample_size == 0 )
         {
             *pi_nb_samples = 1;
-            return p_track->p_sample_size[p_track->i_sample];
+            return MP4_Table_Get( &p_track->stsz, p_track->i_sample, 0 );
         }
 
         if( p_soun->i_qt_version == 1 )
@@ -3660,7 +3699,7 @@ static uint32_t MP4_TrackGetReadSize( mp4_track_t *p_track, uint32_t *pi_nb_samp
                 if ( p_track->i_sample_size )
                     return p_track->i_sample_size;
                 else
-                    return p_track->p_sample_size[p_track->i_sample];
+                    return MP4_Table_Get( &p_track->stsz, p_track->i_sample, 0 );
             }
             else if ( p_soun->i_compressionid != 0 || p_soun->i_bytes_per_sample > 1 ) /* compressed */
             {
@@ -3736,7 +3775,7 @@ static uint32_t MP4_TrackGetReadSize( mp4_track_t *p_track, uint32_t *pi_nb_samp
         {
             (*pi_nb_samples)++;
             if ( p_track->i_sample_size == 0 )
-                i_size += p_track->p_sample_size[i];
+                i_size += MP4_Table_Get( &p_track->stsz, i, 0 );
             else
                 i_size += MP4_GetFixedSampleSize( p_track, p_soun );
 
@@ -3756,12 +3795,12 @@ static uint32_t MP4_TrackGetReadSize( mp4_track_t *p_track, uint32_t *pi_nb_samp
     return i_size;
 }
 
-static uint64_t MP4_TrackGetPos( mp4_track_t *p_track )
+/* Position of a sample in its chunk, or of the end of the chunk */
+static uint64_t MP4_ChunkGetSampleOffset( mp4_track_t *p_track, uint32_t i_chunk,
+                                          uint32_t i_sample )
 {
-    unsigned int i_sample;
-    uint64_t i_pos;
-
-    i_pos = p_track->chunk[p_track->i_chunk].i_offset;
+    const mp4_chunk_t *p_chunk = &p_track->chunk[i_chunk];
+    uint64_t i_pos = 0;
 
     if( p_track->i_sample_size )
     {
@@ -3775,8 +3814,7 @@ static uint64_t MP4_TrackGetPos( mp4_track_t *p_track )
             switch( p_track->fmt.i_codec )
             {
             case VLC_CODEC_GSM: /* # Samples > data size */
-                i_pos += ( p_track->i_sample -
-                           p_track->chunk[p_track->i_chunk].i_sample_first ) / 160 * 33;
+                i_pos += ( i_sample - p_chunk->i_sample_first ) / 160 * 33;
                 return i_pos;
             default:
                 break;
@@ -3787,29 +3825,31 @@ static uint64_t MP4_TrackGetPos( mp4_track_t *p_track )
             p_track->fmt.audio.i_blockalign <= 1 ||
             p_soun->i_sample_per_packet * p_soun->i_bytes_per_frame == 0 )
         {
-            i_pos += ( p_track->i_sample -
-                       p_track->chunk[p_track->i_chunk].i_sample_first ) *
+            i_pos += ( i_sample - p_chunk->i_sample_first ) *
                      MP4_GetFixedSampleSize( p_track, p_soun );
         }
         else
         {
             /* we read chunk by chunk unless a blockalign is requested */
-            i_pos += ( p_track->i_sample - p_track->chunk[p_track->i_chunk].i_sample_first ) /
+            i_pos += ( i_sample - p_chunk->i_sample_first ) /
                         p_soun->i_sample_per_packet * p_soun->i_bytes_per_frame;
         }
     }
     else
     {
-        for( i_sample = p_track->chunk[p_track->i_chunk].i_sample_first;
-             i_sample < p_track->i_sample; i_sample++ )
-        {
-            i_pos += p_track->p_sample_size[i_sample];
-        }
+        for( uint32_t i = p_chunk->i_sample_first; i < i_sample; i++ )
+            i_pos += MP4_Table_Get( &p_track->stsz, i, 0 );
     }
 
     return i_pos;
 }
 
+static uint64_t MP4_TrackGetPos( mp4_track_t *p_track )
+{
+    return p_track->chunk[p_track->i_chunk].i_offset +
+           MP4_ChunkGetSampleOffset( p_track, p_track->i_chunk, p_track->i_sample );
+}
+
 static int MP4_TrackNextSample( demux_t *p_demux, mp4_track_t *p_track, uint32_t i_samples )
 {
     if ( UINT32_MAX - p_track->i_sample < i_samples )
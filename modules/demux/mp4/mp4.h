@@ -28,6 +28,7 @@
 #include <vlc_common.h>
 #include "libmp4.h"
 #include "fragments.h"
+#include "stbl.h"
 #include "../asf/asfpacket.h"
 
 /* Contain all information about a chunk */
@@ -40,24 +41,15 @@ typedef struct
     uint32_t     i_sample; /* index of the next sample to read in this chunk */
     uint32_t     i_virtual_run_number; /* chunks interleaving sequence */
 
-    /* now provide way to calculate pts, dts, and offset without too
-        much memory and with fast access */
-
-    /* with this we can calculate dts/pts without waste memory */
     uint64_t     i_first_dts;   /* DTS of the first sample */
     uint64_t     i_duration;    /* total duration of all samples */
 
-    uint32_t     i_entries_dts;
-    uint32_t     *p_sample_count_dts;
-    uint32_t     *p_sample_delta_dts;   /* dts delta */
-
-    uint32_t     i_entries_pts;
-    uint32_t     *p_sample_count_pts;
-    int32_t      *p_sample_offset_pts;  /* pts-dts */
-
-    uint32_t     *p_sample_size;
-    /* TODO if needed add pts
-        but quickly *add* support for edts and seeking */
+    /* where the first sample is in the stts and ctts tables, so that dts
+     * and pts are computed from the tables without expanding them */
+    uint32_t     i_dts_entry;
+    uint32_t     i_dts_skip;    /* samples of the entry in previous chunks */
+    uint32_t     i_pts_entry;
+    uint32_t     i_pts_skip;
 
 } mp4_chunk_t;
 
@@ -117,11 +109,17 @@ typedef struct
 
     mp4_chunk_t    *chunk; /* always defined  for each chunk */
 
-    /* sample size, p_sample_size defined only if i_sample_size == 0
+    /* sample size, stsz used only if i_sample_size == 0
         else i_sample_size is size for all sample */
     uint32_t         i_sample_size;
-    uint32_t         *p_sample_size; /* XXX perhaps add file offset if take
-//                                    too much time to do sumations each time*/
+
+    /* sample tables */
+    mp4_table_t      stsz;
+    mp4_table_t      stts;
+    mp4_table_t      ctts;
+    mp4_table_t      stss;
+    bool             b_stss;        /* sync samples are listed */
+    int64_t          i_cts_shift;   /* cslg */
 
     uint32_t     i_sample_first; /* i_sample_first value
                                                    of the next chunk */
@@ -0,0 +1,201 @@
+/*****************************************************************************
+ * stbl.c : MP4 sample tables
+ *****************************************************************************
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "stbl.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static void InitPaged( mp4_table_t *p_table, stream_t *s, const MP4_Box_t *p_box,
+                       uint64_t i_pos, unsigned i_fields )
+{
+    /* The declared count may exceed the box */
+    const uint64_t i_end = p_box->i_pos + p_box->i_size;
+    const uint64_t i_max = i_end > i_pos ? ( i_end - i_pos ) / ( 4 * i_fields ) : 0;
+
+    p_table->s = s;
+    p_table->i_pos = i_pos;
+    p_table->i_fields = i_fields;
+    if( p_table->i_count > i_max )
+        p_table->i_count = i_max;
+    for( unsigned i = 0; i < MP4_TABLE_PAGES; i++ )
+        p_table->pages[i].i_first = UINT32_MAX;
+}
+
+void MP4_Table_Init( mp4_table_t *p_table, stream_t *s, const MP4_Box_t *p_box )
+{
+    memset( p_table, 0, sizeof(*p_table) );
+    p_table->i_fields = 1;
+
+    if( p_box == NULL || p_box->data.p_payload == NULL )
+        return;
+
+    switch( p_box->i_type )
+    {
+        case ATOM_stsz:
+        {
+            const MP4_Box_data_stsz_t *p_stsz = p_box->data.p_stsz;
+            if( p_stsz->i_sample_size != 0 )
+                break;
+            p_table->i_count = p_stsz->i_sample_count;
+            if( p_stsz->i_entry_size )
+                p_table->p_array[0] = p_stsz->i_entry_size;
+            else
+                InitPaged( p_table, s, p_box, p_stsz->i_entries_pos, 1 );
+            break;
+        }
+        case ATOM_stts:
+        {
+            const MP4_Box_data_stts_t *p_stts = p_box->data.p_stts;
+            p_table->i_count = p_stts->i_entry_count;
+            p_table->i_fields = 2;
+            if( p_stts->pi_sample_count )
+            {
+                p_table->p_array[0] = p_stts->pi_sample_count;
+                p_table->p_array[1] = (const uint32_t *) p_stts->pi_sample_delta;
+            }
+            else
+                InitPaged( p_table, s, p_box, p_stts->i_entries_pos, 2 );
+            break;
+        }
+        case ATOM_ctts:
+        {
+            const MP4_Box_data_ctts_t *p_ctts = p_box->data.p_ctts;
+            p_table->i_count = p_ctts->i_entry_count;
+            p_table->i_fields = 2;
+            if( p_ctts->pi_sample_count )
+            {
+                p_table->p_array[0] = p_ctts->pi_sample_count;
+                p_table->p_array[1] = (const uint32_t *) p_ctts->pi_sample_offset;
+            }
+            else
+                InitPaged( p_table, s, p_box, p_ctts->i_entries_pos, 2 );
+            break;
+        }
+        case ATOM_stss:
+        {
+            const MP4_Box_data_stss_t *p_stss = p_box->data.p_stss;
+            p_table->i_count = p_stss->i_entry_count;
+            if( p_stss->i_sample_number )
+                p_table->p_array[0] = p_stss->i_sample_number;
+            else
+            {
+                /* libmp4 numbers the samples from 0 */
+                InitPaged( p_table, s, p_box, p_stss->i_entries_pos, 1 );
+                p_table->i_bias = -1;
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void MP4_Table_Clean( mp4_table_t *p_table )
+{
+    for( unsigned i = 0; i < MP4_TABLE_PAGES; i++ )
+        free( p_table->pages[i].p_values );
+}
+
+static int LoadPage( mp4_table_t *p_table, struct mp4_table_page_s *p_page,
+                     uint32_t i_first )
+{
+    const size_t i_entry_size = 4 * p_table->i_fields;
+    const uint32_t i_entries = __MIN( MP4_TABLE_PAGE_ENTRIES,
+                                      p_table->i_count - i_first );
+
+    if( p_page->p_values == NULL )
+    {
+        p_page->p_values = malloc( MP4_TABLE_PAGE_ENTRIES * i_entry_size );
+        if( p_page->p_values == NULL )
+            return VLC_ENOMEM;
+    }
+
+    /* The demuxer seeks back before reading samples, but other readers
+     * may not expect the position to change */
+    const uint64_t i_back = vlc_stream_Tell( p_table->s );
+    const size_t i_size = i_entries * i_entry_size;
+    int i_ret = VLC_SUCCESS;
+
+    /* The page is overwritten: it is only valid again once read */
+    p_page->i_first = UINT32_MAX;
+    p_page->i_entries = 0;
+
+    if( vlc_stream_Seek( p_table->s, p_table->i_pos + (uint64_t) i_first * i_entry_size ) ||
+        vlc_stream_Read( p_table->s, p_page->p_values, i_size ) != (ssize_t) i_size )
+    {
+        msg_Warn( p_table->s, "cannot read sample table entries %"PRIu32
+                  " to %"PRIu32, i_first, i_first + i_entries - 1 );
+        i_ret = VLC_EGENERIC;
+    }
+    else
+    {
+        for( size_t i = 0; i < i_entries * p_table->i_fields; i++ )
+            p_page->p_values[i] = GetDWBE( &p_page->p_values[i] );
+        if( p_table->i_bias )
+            for( size_t i = 0; i < i_entries; i++ )
+                p_page->p_values[i * p_table->i_fields] += p_table->i_bias;
+        p_page->i_first = i_first;
+        p_page->i_entries = i_entries;
+    }
+    if( vlc_stream_Seek( p_table->s, i_back ) )
+    {
+        msg_Err( p_table->s, "cannot seek back to %"PRIu64" after reading "
+                 "sample table entries", i_back );
+        i_ret = VLC_EGENERIC;
+    }
+    return i_ret;
+}
+
+uint32_t MP4_Table_GetPaged( mp4_table_t *p_table, uint32_t i_entry, unsigned i_field )
+{
+    const uint32_t i_first = i_entry - i_entry % MP4_TABLE_PAGE_ENTRIES;
+    struct mp4_table_page_s *p_page = NULL;
+
+    for( unsigned i = 0; i < MP4_TABLE_PAGES; i++ )
+    {
+        struct mp4_table_page_s *p_cur = &p_table->pages[i];
+        if( p_cur->i_first == i_first )
+        {
+            p_page = p_cur;
+            break;
+        }
+        /* Least recently used one otherwise */
+        if( p_page == NULL || p_cur->i_used < p_page->i_used )
+            p_page = p_cur;
+    }
+
+    if( p_page->i_first != i_first )
+    {
+        /* Until the demuxer handles the error, do not read again for each
+         * entry */
+        if( p_table->b_error || LoadPage( p_table, p_page, i_first ) )
+            p_table->b_error = true;
+        if( p_page->i_first != i_first )
+            return 0;
+    }
+
+    p_page->i_used = ++p_table->i_clock;
+    p_table->p_last = p_page;
+    return p_page->p_values[(i_entry - i_first) * p_table->i_fields + i_field];
+}
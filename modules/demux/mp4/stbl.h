@@ -0,0 +1,88 @@
+/*****************************************************************************
+ * stbl.h : MP4 sample tables
+ *****************************************************************************
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifndef VLC_MP4_STBL_H_
+#define VLC_MP4_STBL_H_
+
+#include <vlc_common.h>
+#include <vlc_stream.h>
+#include "libmp4.h"
+
+#define MP4_TABLE_PAGE_ENTRIES 1024
+#define MP4_TABLE_PAGES        4
+
+/* Entries of a stsz, stts, ctts or stss table, with one or two 32 bits
+ * fields. They come from the arrays loaded by libmp4, or, for the tables
+ * it left in the file, are read on demand by pages, a few of them being
+ * kept in memory. */
+typedef struct
+{
+    uint32_t        i_count;    /* of entries */
+    unsigned        i_fields;
+    const uint32_t *p_array[2]; /* loaded ones */
+
+    /* Tables left in the file */
+    stream_t       *s;
+    uint64_t        i_pos;      /* of the first entry */
+    int32_t         i_bias;     /* on the first field, as libmp4 does */
+    bool            b_error;    /* a page could not be read */
+    unsigned        i_clock;
+    struct mp4_table_page_s
+    {
+        uint32_t  i_first;      /* entry, UINT32_MAX if unused */
+        uint32_t  i_entries;
+        unsigned  i_used;       /* clock of the last access */
+        uint32_t *p_values;     /* fields of each entry, in a row */
+    } pages[MP4_TABLE_PAGES], *p_last;
+} mp4_table_t;
+
+/* Sets the table up from a stsz, stts, ctts or stss box, s being the stream
+ * the box was read from. An empty table is set up for other boxes. */
+void MP4_Table_Init( mp4_table_t *, stream_t *s, const MP4_Box_t * );
+void MP4_Table_Clean( mp4_table_t * );
+
+uint32_t MP4_Table_GetPaged( mp4_table_t *, uint32_t i_entry, unsigned i_field );
+
+/* Tells if entries could not be read since the last call, and were returned
+ * as 0. They are read again by the next calls to MP4_Table_Get(). */
+static inline bool MP4_Table_Failed( mp4_table_t *p_table )
+{
+    const bool b_error = p_table->b_error;
+
+    p_table->b_error = false;
+    return b_error;
+}
+
+/* Field of an entry, 0 past the end of the table */
+static inline uint32_t MP4_Table_Get( mp4_table_t *p_table, uint32_t i_entry,
+                                      unsigned i_field )
+{
+    if( i_entry >= p_table->i_count )
+        return 0;
+    if( p_table->p_array[i_field] )
+        return p_table->p_array[i_field][i_entry];
+
+    const struct mp4_table_page_s *p_page = p_table->p_last;
+    if( p_page && i_entry - p_page->i_first < p_page->i_entries )
+        return p_page->p_values[(i_entry - p_page->i_first) * p_table->i_fields
+                                + i_field];
+    return MP4_Table_GetPaged( p_table, i_entry, i_field );
+}
+
+#endif
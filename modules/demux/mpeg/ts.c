@@ -35,6 +35,7 @@
 #include <vlc_access.h>    /* DVB-specific things */
 #include <vlc_demux.h>
 #include <vlc_input.h>
+#include <vlc_atomic.h>
 
 #include "ts_pid.h"
 #include "ts_streams.h"
@@ -181,6 +182,11 @@ static bool GatherSectionsData( demux_t *p_demux, ts_pid_t *, block_t *, size_t
 static void ProgramSetPCR( demux_t *p_demux, ts_pmt_t *p_prg, mtime_t i_pcr );
 
 static block_t* ReadTSPacket( demux_t *p_demux );
+static block_t* KeepTSPacket( demux_t *p_demux, block_t * );
+static void FlushTSBatch( demux_sys_t * );
+static void ReleaseTSBatch( demux_sys_t * );
+static uint64_t TSStreamTell( demux_sys_t * );
+static int TSStreamSeek( demux_sys_t *, uint64_t );
 static int SeekToTime( demux_t *p_demux, const ts_pmt_t *, int64_t time );
 static void ReadyQueuesPostSeek( demux_t *p_demux );
 static void PCRHandle( demux_t *p_demux, ts_pid_t *, mtime_t );
@@ -192,6 +198,9 @@ static void PCRFixHandle( demux_t *, ts_pmt_t *, block_t * );
 #define TS_PACKET_SIZE_MAX 204
 #define TS_HEADER_SIZE 4
 
+/* Packets read from the stream at once, as 16 datagrams of 7 packets */
+#define TS_READ_BATCH (7 * 16)
+
 static int DetectPacketSize( demux_t *p_demux, unsigned *pi_header_size, int i_offset )
 {
     const uint8_t *p_peek;
@@ -386,6 +395,8 @@ static int Open( vlc_object_t *p_this )
     p_sys->i_packet_size = i_packet_size;
     p_sys->i_packet_header_size = i_packet_header_size;
     p_sys->i_ts_read = 50;
+    p_sys->batch.p_chunk = NULL;
+    p_sys->batch.i_offset = 0;
     p_sys->csa = NULL;
     p_sys->b_start_record = false;
 
@@ -565,6 +576,8 @@ static void Close( vlc_object_t *p_this )
 
     vlc_mutex_destroy( &p_sys->csa_lock );
 
+    ReleaseTSBatch( p_sys );
+
     /* Release all non default pids */
     ts_pid_list_Release( p_demux, &p_sys->pids );
 
@@ -711,7 +724,10 @@ static int Demux( demux_t *p_demux )
 
             if( p_pid->u.p_stream->transport == TS_TRANSPORT_PES )
             {
-                b_frame = GatherPESData( p_demux, p_pid, p_pkt, i_header );
+                /* Payload will be retained, reference its chunk */
+                p_pkt = KeepTSPacket( p_demux, p_pkt );
+                if( likely(p_pkt) )
+                    b_frame = GatherPESData( p_demux, p_pid, p_pkt, i_header );
             }
             else if( p_pid->u.p_stream->transport == TS_TRANSPORT_SECTIONS )
             {
@@ -925,7 +941,7 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
 
         if( (i64 = stream_Size( p_sys->stream) ) > 0 )
         {
-            uint64_t offset = vlc_stream_Tell( p_sys->stream );
+            uint64_t offset = TSStreamTell( p_sys );
             *pf = (double)offset / (double)i64;
             return VLC_SUCCESS;
         }
@@ -972,7 +988,7 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
 
         i64 = stream_Size( p_sys->stream );
         if( i64 > 0 &&
-            vlc_stream_Seek( p_sys->stream, (int64_t)(i64 * f) ) == VLC_SUCCESS )
+            TSStreamSeek( p_sys, (int64_t)(i64 * f) ) == VLC_SUCCESS )
         {
             ReadyQueuesPostSeek( p_demux );
             return VLC_SUCCESS;
@@ -1104,11 +1120,16 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
     }
 
     case DEMUX_SET_TITLE:
-        return vlc_stream_vaControl( p_sys->stream, STREAM_SET_TITLE, args );
+        if( vlc_stream_vaControl( p_sys->stream, STREAM_SET_TITLE, args ) )
+            return VLC_EGENERIC;
+        FlushTSBatch( p_sys );
+        return VLC_SUCCESS;
 
     case DEMUX_SET_SEEKPOINT:
-        return vlc_stream_vaControl( p_sys->stream, STREAM_SET_SEEKPOINT,
-                                     args );
+        if( vlc_stream_vaControl( p_sys->stream, STREAM_SET_SEEKPOINT, args ) )
+            return VLC_EGENERIC;
+        FlushTSBatch( p_sys );
+        return VLC_SUCCESS;
 
     case DEMUX_GET_META:
         return vlc_stream_vaControl( p_sys->stream, STREAM_GET_META, args );
@@ -1684,14 +1705,221 @@ static bool PushPESBlock( demux_t *p_demux, ts_pid_t *pid, block_t *p_pkt, bool
     return b_ret;
 }
 
+/*****************************************************************************
+ * Batched packets reading:
+ *  Packets are read from the stream by chunks of many packets, then walked
+ *  in place. The packet returned by ReadTSPacket() is only borrowed and
+ *  valid until next read, unless turned into a refcounted view of its chunk
+ *  by KeepTSPacket().
+ *****************************************************************************/
+struct ts_chunk_t
+{
+    atomic_uint refs;
+    size_t      i_size;
+    size_t      i_data;
+    uint8_t     p_data[];
+};
+
+typedef struct
+{
+    block_t     self;
+    ts_chunk_t *p_chunk;
+} ts_packet_view_t;
+
+static ts_chunk_t *ts_chunk_New( size_t i_size )
+{
+    ts_chunk_t *p_chunk = malloc( sizeof(*p_chunk) + i_size );
+    if( likely(p_chunk) )
+    {
+        atomic_init( &p_chunk->refs, 1 );
+        p_chunk->i_size = i_size;
+        p_chunk->i_data = 0;
+    }
+    return p_chunk;
+}
+
+static void ts_chunk_Release( ts_chunk_t *p_chunk )
+{
+    if( atomic_fetch_sub( &p_chunk->refs, 1 ) == 1 )
+        free( p_chunk );
+}
+
+static void BorrowedTSPacketRelease( block_t *p_pkt )
+{
+    /* Owned by the chunk, nothing to do */
+    VLC_UNUSED(p_pkt);
+}
+
+static void TSPacketViewRelease( block_t *p_pkt )
+{
+    ts_packet_view_t *p_view = container_of( p_pkt, ts_packet_view_t, self );
+    ts_chunk_Release( p_view->p_chunk );
+    free( p_view );
+}
+
+static block_t* KeepTSPacket( demux_t *p_demux, block_t *p_pkt )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    assert( p_pkt == &p_sys->batch.packet );
+
+    ts_packet_view_t *p_view = malloc( sizeof(*p_view) );
+    if( unlikely(!p_view) )
+        return NULL;
+
+    p_view->self = *p_pkt;
+    p_view->self.pf_release = TSPacketViewRelease;
+    p_view->p_chunk = p_sys->batch.p_chunk;
+    atomic_fetch_add( &p_view->p_chunk->refs, 1 );
+
+    return &p_view->self;
+}
+
+static inline size_t PendingTSBytes( const demux_sys_t *p_sys )
+{
+    const ts_chunk_t *p_chunk = p_sys->batch.p_chunk;
+    return p_chunk ? p_chunk->i_data - p_sys->batch.i_offset : 0;
+}
+
+static void FlushTSBatch( demux_sys_t *p_sys )
+{
+    if( p_sys->batch.p_chunk )
+        p_sys->batch.i_offset = p_sys->batch.p_chunk->i_data;
+}
+
+static void ReleaseTSBatch( demux_sys_t *p_sys )
+{
+    if( p_sys->batch.p_chunk )
+        ts_chunk_Release( p_sys->batch.p_chunk );
+    p_sys->batch.p_chunk = NULL;
+    p_sys->batch.i_offset = 0;
+}
+
+/* Stream position of the next packet, accounting for read-ahead */
+static uint64_t TSStreamTell( demux_sys_t *p_sys )
+{
+    return vlc_stream_Tell( p_sys->stream ) - PendingTSBytes( p_sys );
+}
+
+static int TSStreamSeek( demux_sys_t *p_sys, uint64_t i_pos )
+{
+    FlushTSBatch( p_sys );
+    return vlc_stream_Seek( p_sys->stream, i_pos );
+}
+
+/* Reads the next packets through another stream over the same source.
+ * The bytes already batched are read again through it if possible. */
+void TsSwitchStream( demux_t *p_demux, stream_t *s )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    const size_t i_pending = PendingTSBytes( p_sys );
+    const uint64_t i_pos = TSStreamTell( p_sys );
+
+    FlushTSBatch( p_sys );
+    p_sys->stream = s;
+    if( i_pending > 0 && vlc_stream_Seek( s, i_pos ) != VLC_SUCCESS )
+        msg_Warn( p_demux, "dropping %zu bytes read before the stream switch",
+                  i_pending );
+}
+
+/* Moves pending bytes to a (possibly recycled) chunk and reads until at
+ * least i_min bytes are pending, or EOF. Returns the pending bytes count. */
+static size_t FillTSBatch( demux_t *p_demux, size_t i_min )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    ts_chunk_t *p_old = p_sys->batch.p_chunk;
+    const size_t i_pending = PendingTSBytes( p_sys );
+    const size_t i_size = p_sys->i_packet_size * TS_READ_BATCH;
+    ts_chunk_t *p_chunk;
+
+    assert( i_min <= i_size );
+
+    /* No view is referencing the current chunk, recycle it */
+    if( p_old && p_old->i_size == i_size &&
+        atomic_load( &p_old->refs ) == 1 )
+    {
+        p_chunk = p_old;
+        memmove( p_chunk->p_data, &p_chunk->p_data[p_sys->batch.i_offset],
+                 i_pending );
+    }
+    else
+    {
+        p_chunk = ts_chunk_New( i_size );
+        if( unlikely(!p_chunk) )
+            return 0;
+        if( i_pending )
+            memcpy( p_chunk->p_data, &p_old->p_data[p_sys->batch.i_offset],
+                    i_pending );
+        if( p_old )
+            ts_chunk_Release( p_old );
+    }
+
+    p_chunk->i_data = i_pending;
+    p_sys->batch.p_chunk = p_chunk;
+    p_sys->batch.i_offset = 0;
+
+    while( p_chunk->i_data < i_min )
+    {
+        ssize_t i_read = vlc_stream_ReadPartial( p_sys->stream,
+                                                 &p_chunk->p_data[p_chunk->i_data],
+                                                 i_size - p_chunk->i_data );
+        if( i_read <= 0 )
+            break;
+        p_chunk->i_data += i_read;
+    }
+
+    return p_chunk->i_data;
+}
+
+static bool ResyncTSBatch( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    const size_t i_sync = p_sys->i_packet_header_size;
+    const size_t i_min = p_sys->i_packet_header_size + p_sys->i_packet_size + 1;
+
+    for( ;; )
+    {
+        size_t i_pending = PendingTSBytes( p_sys );
+        if( i_pending < i_min )
+            i_pending = FillTSBatch( p_demux, i_min );
+        if( i_pending < i_min )
+        {
+            msg_Dbg( p_demux, "eof ?" );
+            return false;
+        }
+
+        const uint8_t *p_peek = &p_sys->batch.p_chunk->p_data[p_sys->batch.i_offset];
+        size_t i_skip = 0;
+        bool b_found = false;
+
+        while( i_skip + i_min <= i_pending )
+        {
+            if( p_peek[i_skip + i_sync] == 0x47 &&
+                p_peek[i_skip + i_sync + p_sys->i_packet_size] == 0x47 )
+            {
+                b_found = true;
+                break;
+            }
+            i_skip++;
+        }
+        msg_Dbg( p_demux, "skipping %zu bytes of garbage", i_skip );
+        p_sys->batch.i_offset += i_skip;
+
+        if( b_found )
+            return true;
+    }
+}
+
 static block_t* ReadTSPacket( demux_t *p_demux )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
 
-    block_t     *p_pkt;
+    size_t i_pending = PendingTSBytes( p_sys );
+    if( i_pending < p_sys->i_packet_size )
+        i_pending = FillTSBatch( p_demux, p_sys->i_packet_size );
 
     /* Get a new TS packet */
-    if( !( p_pkt = vlc_stream_Block( p_sys->stream, p_sys->i_packet_size ) ) )
+    if( i_pending == 0 )
     {
         int64_t size = stream_Size( p_sys->stream );
         if( size >= 0 && (uint64_t)size == vlc_stream_Tell( p_sys->stream ) )
@@ -1701,12 +1929,30 @@ static block_t* ReadTSPacket( demux_t *p_demux )
         return NULL;
     }
 
-    if( p_pkt->i_buffer < TS_HEADER_SIZE + p_sys->i_packet_header_size )
-    {
-        block_Release( p_pkt );
+    size_t i_pkt = __MIN( i_pending, p_sys->i_packet_size );
+    uint8_t *p_data = &p_sys->batch.p_chunk->p_data[p_sys->batch.i_offset];
+    p_sys->batch.i_offset += i_pkt;
+
+    if( i_pkt < TS_HEADER_SIZE + p_sys->i_packet_header_size )
         return NULL;
+
+    /* Check sync byte and re-sync if needed */
+    if( p_data[p_sys->i_packet_header_size] != 0x47 )
+    {
+        msg_Warn( p_demux, "lost synchro" );
+        if( !ResyncTSBatch( p_demux ) )
+            return NULL;
+
+        /* Resync always leaves at least one full packet pending */
+        i_pkt = p_sys->i_packet_size;
+        p_data = &p_sys->batch.p_chunk->p_data[p_sys->batch.i_offset];
+        p_sys->batch.i_offset += i_pkt;
     }
 
+    block_t *p_pkt = &p_sys->batch.packet;
+    block_Init( p_pkt, p_data, i_pkt );
+    p_pkt->pf_release = BorrowedTSPacketRelease;
+
     /* Skip header (BluRay streams).
      * re-sync logic would do this (by adjusting packet start), but this would result in losing first and last ts packets.
      * First packet is usually PAT, and losing it means losing whole first GOP. This is fatal with still-image based menus.
@@ -1714,49 +1960,6 @@ static block_t* ReadTSPacket( demux_t *p_demux )
     p_pkt->p_buffer += p_sys->i_packet_header_size;
     p_pkt->i_buffer -= p_sys->i_packet_header_size;
 
-    /* Check sync byte and re-sync if needed */
-    if( p_pkt->p_buffer[0] != 0x47 )
-    {
-        msg_Warn( p_demux, "lost synchro" );
-        block_Release( p_pkt );
-        for( ;; )
-        {
-            const uint8_t *p_peek;
-            int i_peek = 0;
-            unsigned i_skip = 0;
-
-            i_peek = vlc_stream_Peek( p_sys->stream, &p_peek,
-                    p_sys->i_packet_size * 10 );
-            if( i_peek < 0 || (unsigned)i_peek < p_sys->i_packet_size + 1 )
-            {
-                msg_Dbg( p_demux, "eof ?" );
-                return NULL;
-            }
-
-            while( i_skip < i_peek - p_sys->i_packet_size )
-            {
-                if( p_peek[i_skip + p_sys->i_packet_header_size] == 0x47 &&
-                        p_peek[i_skip + p_sys->i_packet_header_size + p_sys->i_packet_size] == 0x47 )
-                {
-                    break;
-                }
-                i_skip++;
-            }
-            msg_Dbg( p_demux, "skipping %d bytes of garbage", i_skip );
-            if (vlc_stream_Read( p_sys->stream, NULL, i_skip ) != i_skip)
-                return NULL;
-
-            if( i_skip < i_peek - p_sys->i_packet_size )
-            {
-                break;
-            }
-        }
-        if( !( p_pkt = vlc_stream_Block( p_sys->stream, p_sys->i_packet_size ) ) )
-        {
-            msg_Dbg( p_demux, "eof ?" );
-            return NULL;
-        }
-    }
     return p_pkt;
 }
 
@@ -1866,13 +2069,13 @@ static int SeekToTime( demux_t *p_demux, const ts_pmt_t *p_pmt, int64_t i_scaled
 
     /* Deal with common but worst binary search case */
     if( p_pmt->pcr.i_first == i_scaledtime && p_sys->b_canseek )
-        return vlc_stream_Seek( p_sys->stream, 0 );
+        return TSStreamSeek( p_sys, 0 );
 
     const int64_t i_stream_size = stream_Size( p_sys->stream );
     if( !p_sys->b_canfastseek || i_stream_size < p_sys->i_packet_size )
         return VLC_EGENERIC;
 
-    const uint64_t i_initial_pos = vlc_stream_Tell( p_sys->stream );
+    const uint64_t i_initial_pos = TSStreamTell( p_sys );
 
     /* Find the time position by using binary search algorithm. */
     uint64_t i_head_pos = 0;
@@ -1888,7 +2091,7 @@ static int SeekToTime( demux_t *p_demux, const ts_pmt_t *p_pmt, int64_t i_scaled
         uint64_t i_div = i_splitpos % p_sys->i_packet_size;
         i_splitpos -= i_div;
 
-        if ( vlc_stream_Seek( p_sys->stream, i_splitpos ) != VLC_SUCCESS )
+        if ( TSStreamSeek( p_sys, i_splitpos ) != VLC_SUCCESS )
             break;
 
         uint64_t i_pos = i_splitpos;
@@ -1902,7 +2105,7 @@ static int SeekToTime( demux_t *p_demux, const ts_pmt_t *p_pmt, int64_t i_scaled
                 break;
             }
             else
-                i_pos = vlc_stream_Tell( p_sys->stream );
+                i_pos = TSStreamTell( p_sys );
 
             int i_pid = PIDGet( p_pkt );
             ts_pid_t *p_pid = GetPID(p_sys, i_pid);
@@ -1957,7 +2160,7 @@ static int SeekToTime( demux_t *p_demux, const ts_pmt_t *p_pmt, int64_t i_scaled
     if( !b_found )
     {
         msg_Dbg( p_demux, "Seek():cannot find a time position." );
-        vlc_stream_Seek( p_sys->stream, i_initial_pos );
+        TSStreamSeek( p_sys, i_initial_pos );
         return VLC_EGENERIC;
     }
     return VLC_SUCCESS;
@@ -2040,7 +2243,7 @@ static int ProbeChunk( demux_t *p_demux, int i_program, bool b_end, int64_t *pi_
                         if( b_end )
                         {
                             p_pmt->i_last_dts = *pi_pcr;
-                            p_pmt->i_last_dts_byte = vlc_stream_Tell( p_sys->stream );
+                            p_pmt->i_last_dts_byte = TSStreamTell( p_sys );
                         }
                         /* Start, only keep first */
                         else if( b_pcrresult && p_pmt->pcr.i_first == -1 )
@@ -2068,7 +2271,7 @@ static int ProbeChunk( demux_t *p_demux, int i_program, bool b_end, int64_t *pi_
 int ProbeStart( demux_t *p_demux, int i_program )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
-    const uint64_t i_initial_pos = vlc_stream_Tell( p_sys->stream );
+    const uint64_t i_initial_pos = TSStreamTell( p_sys );
     int64_t i_stream_size = stream_Size( p_sys->stream );
 
     int i_probe_count = 0;
@@ -2081,7 +2284,7 @@ int ProbeStart( demux_t *p_demux, int i_program )
         i_pos = p_sys->i_packet_size * i_probe_count;
         i_pos = __MIN( i_pos, i_stream_size );
 
-        if( vlc_stream_Seek( p_sys->stream, i_pos ) )
+        if( TSStreamSeek( p_sys, i_pos ) )
             return VLC_EGENERIC;
 
         ProbeChunk( p_demux, i_program, false, &i_pcr, &b_found );
@@ -2090,7 +2293,7 @@ int ProbeStart( demux_t *p_demux, int i_program )
         i_probe_count += PROBE_CHUNK_COUNT;
     } while( i_pos > 0 && (i_pcr == -1 || !b_found) && i_probe_count < (2 * PROBE_CHUNK_COUNT) );
 
-    if( vlc_stream_Seek( p_sys->stream, i_initial_pos ) )
+    if( TSStreamSeek( p_sys, i_initial_pos ) )
         return VLC_EGENERIC;
 
     return (b_found) ? VLC_SUCCESS : VLC_EGENERIC;
@@ -2099,7 +2302,7 @@ int ProbeStart( demux_t *p_demux, int i_program )
 int ProbeEnd( demux_t *p_demux, int i_program )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
-    const uint64_t i_initial_pos = vlc_stream_Tell( p_sys->stream );
+    const uint64_t i_initial_pos = TSStreamTell( p_sys );
     int64_t i_stream_size = stream_Size( p_sys->stream );
 
     int i_probe_count = PROBE_CHUNK_COUNT;
@@ -2112,7 +2315,7 @@ int ProbeEnd( demux_t *p_demux, int i_program )
         i_pos = i_stream_size - (p_sys->i_packet_size * i_probe_count);
         i_pos = __MAX( i_pos, 0 );
 
-        if( vlc_stream_Seek( p_sys->stream, i_pos ) )
+        if( TSStreamSeek( p_sys, i_pos ) )
             return VLC_EGENERIC;
 
         ProbeChunk( p_demux, i_program, true, &i_pcr, &b_found );
@@ -2121,7 +2324,7 @@ int ProbeEnd( demux_t *p_demux, int i_program )
         i_probe_count += PROBE_CHUNK_COUNT;
     } while( i_pos > 0 && (i_pcr == -1 || !b_found) && i_probe_count < (6 * PROBE_CHUNK_COUNT) );
 
-    if( vlc_stream_Seek( p_sys->stream, i_initial_pos ) )
+    if( TSStreamSeek( p_sys, i_initial_pos ) )
         return VLC_EGENERIC;
 
     return (b_found) ? VLC_SUCCESS : VLC_EGENERIC;
@@ -2172,10 +2375,10 @@ static void ProgramSetPCR( demux_t *p_demux, ts_pmt_t *p_pmt, mtime_t i_pcr )
         es_out_Control( p_demux->out, ES_OUT_SET_GROUP_PCR, p_pmt->i_number, FROM_SCALE(i_pcr) );
         /* growing files/named fifo handling */
         if( p_sys->b_access_control == false &&
-            vlc_stream_Tell( p_sys->stream ) > p_pmt->i_last_dts_byte )
+            TSStreamTell( p_sys ) > p_pmt->i_last_dts_byte )
         {
             p_pmt->i_last_dts = i_pcr;
-            p_pmt->i_last_dts_byte = vlc_stream_Tell( p_sys->stream );
+            p_pmt->i_last_dts_byte = TSStreamTell( p_sys );
         }
     }
 }
@@ -24,6 +24,7 @@
     typedef struct arib_instance_t arib_instance_t;
 #endif
 typedef struct csa_t csa_t;
+typedef struct ts_chunk_t ts_chunk_t;
 
 #define TS_USER_PMT_NUMBER (0)
 
@@ -60,6 +61,14 @@ struct demux_sys_t
     /* how many TS packet we read at once */
     unsigned    i_ts_read;
 
+    /* Batched reads: packets are walked in place inside the current chunk */
+    struct
+    {
+        ts_chunk_t *p_chunk;
+        size_t      i_offset; /* start of next packet inside chunk */
+        block_t     packet;   /* borrowed view on the last read packet */
+    } batch;
+
     bool        b_ignore_time_for_positions;
 
     ts_standards_e standard;
@@ -129,6 +138,8 @@ struct demux_sys_t
 
 void TsChangeStandard( demux_sys_t *, ts_standards_e );
 
+void TsSwitchStream( demux_t *, stream_t * );
+
 bool ProgramIsSelected( demux_sys_t *, uint16_t i_pgrm );
 
 void UpdatePESFilters( demux_t *p_demux, bool b_all );
@@ -41,8 +41,8 @@ void ts_pid_list_Init( ts_pid_list_t *p_list )
     p_list->pp_all = NULL;
     p_list->i_all = 0;
     p_list->i_all_alloc = 0;
-    p_list->i_last_pid = 0;
-    p_list->p_last = NULL;
+    for( int i = 0; i < TS_PID_PAGES; i++ )
+        p_list->pp_pages[i] = NULL;
 }
 
 void ts_pid_list_Release( demux_t *p_demux, ts_pid_list_t *p_list )
@@ -57,6 +57,8 @@ void ts_pid_list_Release( demux_t *p_demux, ts_pid_list_t *p_list )
         free( pid );
     }
     free( p_list->pp_all );
+    for( int i = 0; i < TS_PID_PAGES; i++ )
+        free( p_list->pp_pages[i] );
 }
 
 struct searchkey
@@ -84,11 +86,26 @@ ts_pid_t * ts_pid_Get( ts_pid_list_t *p_list, uint16_t i_pid )
         case 0x1FFF:
             return &p_list->dummy;
         default:
-            if( p_list->i_last_pid == i_pid )
-                return p_list->p_last;
         break;
     }
 
+    assert( i_pid < 8192 );
+    ts_pid_t ***pp_page = &p_list->pp_pages[i_pid >> TS_PID_PAGE_BITS];
+    const unsigned i_page_index = i_pid & (TS_PID_PAGE_SIZE - 1);
+
+    if( likely(*pp_page && (*pp_page)[i_page_index]) )
+        return (*pp_page)[i_page_index];
+
+    if( *pp_page == NULL )
+    {
+        *pp_page = calloc( TS_PID_PAGE_SIZE, sizeof(ts_pid_t *) );
+        if( !*pp_page )
+        {
+            abort();
+            //return NULL;
+        }
+    }
+
     size_t i_index = 0;
     ts_pid_t *p_pid = NULL;
 
@@ -147,8 +164,7 @@ ts_pid_t * ts_pid_Get( ts_pid_list_t *p_list, uint16_t i_pid )
 
     }
 
-    p_list->p_last = p_pid;
-    p_list->i_last_pid = i_pid;
+    (*pp_page)[i_page_index] = p_pid;
 
     return p_pid;
 }
@@ -79,19 +79,22 @@ struct ts_pid_t
 
 };
 
+#define TS_PID_PAGE_BITS 7
+#define TS_PID_PAGE_SIZE (1 << TS_PID_PAGE_BITS)
+#define TS_PID_PAGES     (8192 / TS_PID_PAGE_SIZE)
+
 struct ts_pid_list_t
 {
     ts_pid_t   pat;
     ts_pid_t   dummy;
     ts_pid_t   base_si;
-    /* all non commons ones, dynamically allocated */
+    /* all non commons ones, dynamically allocated, sorted by pid */
     ts_pid_t **pp_all;
     int        i_all;
     int        i_all_alloc;
-    /* last recently used */
-    uint16_t   i_last_pid;
-    ts_pid_t  *p_last;
-
+    /* direct lookup, 13 bits pid split as page / index in page.
+     * pages are only allocated for used pid ranges */
+    ts_pid_t **pp_pages[TS_PID_PAGES];
 };
 
 /* opacified pid list */
@@ -210,6 +210,8 @@ static int vlclua_input_item_stats( lua_State *L )
         STATS_INT( demux_discontinuity )
         STATS_INT( decoded_audio )
         STATS_INT( decoded_video )
+        STATS_INT( decoder_blocked )
+        STATS_INT( decoder_dropped )
         STATS_INT( displayed_pictures )
         STATS_INT( lost_pictures )
         STATS_INT( sent_packets )
@@ -60,6 +60,7 @@ struct rtcp_sender_t
     size_t   length;  /* RTCP packet length */
     uint8_t  payload[28 + 8 + (2 * 257) + 8];
     int      handle;  /* RTCP socket handler */
+    sout_stream_id_sys_t *id; /* for SRTCP */
 
     uint32_t packets; /* RTP packets sent */
     uint32_t bytes;   /* RTP bytes sent */
@@ -67,8 +68,8 @@ struct rtcp_sender_t
 };
 
 
-rtcp_sender_t *OpenRTCP (vlc_object_t *obj, int rtp_fd, int proto,
-                         bool mux)
+rtcp_sender_t *OpenRTCP (vlc_object_t *obj, sout_stream_id_sys_t *id,
+                         int rtp_fd, int proto, bool mux)
 {
     rtcp_sender_t *rtcp;
     uint8_t *ptr;
@@ -129,6 +130,7 @@ rtcp_sender_t *OpenRTCP (vlc_object_t *obj, int rtp_fd, int proto,
     }
 
     rtcp->handle = fd;
+    rtcp->id = id;
     rtcp->bytes = rtcp->packets = rtcp->counter = 0;
 
     ptr = (uint8_t *)strchr (src, '%');
@@ -175,6 +177,22 @@ rtcp_sender_t *OpenRTCP (vlc_object_t *obj, int rtp_fd, int proto,
 }
 
 
+/**
+ * Sends the current compound RTCP packet, protected with SRTCP if needed.
+ */
+static bool rtcp_send (rtcp_sender_t *rtcp)
+{
+    /* SRTCP adds the index and the authentication tag, in place */
+    uint8_t buf[sizeof (rtcp->payload) + 4 + SRTP_TAG_LEN];
+    size_t len = rtcp->length;
+
+    memcpy (buf, rtcp->payload, len);
+    if (rtp_srtcp_protect (rtcp->id, buf, &len, sizeof (buf)))
+        return false;
+    return send (rtcp->handle, buf, len, 0) == (ssize_t)len;
+}
+
+
 void CloseRTCP (rtcp_sender_t *rtcp)
 {
     if (rtcp == NULL)
@@ -194,7 +212,7 @@ void CloseRTCP (rtcp_sender_t *rtcp)
 
     /* We are THE sender, so we are more important than anybody else, so
      * we can afford not to check bandwidth constraints here. */
-    send (rtcp->handle, rtcp->payload, rtcp->length, 0);
+    rtcp_send (rtcp);
     net_Close (rtcp->handle);
     free (rtcp);
 }
@@ -228,6 +246,6 @@ void SendRTCP (rtcp_sender_t *restrict rtcp, const block_t *rtp)
     SetDWBE (ptr + 24, rtcp->bytes);
     memcpy (ptr + 28 + 4, rtp->p_buffer + 8, 4); /* SDES SSRC */
 
-    if (send (rtcp->handle, ptr, rtcp->length, 0) == (ssize_t)rtcp->length)
+    if (rtcp_send (rtcp))
         rtcp->counter = 0;
 }
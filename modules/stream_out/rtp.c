@@ -65,9 +65,17 @@
 # define IPPROTO_UDPLITE 136
 #endif
 
+#ifdef __linux__
+#   include <netinet/udp.h>
+#   ifndef UDP_SEGMENT
+#       define UDP_SEGMENT 103
+#   endif
+#endif
+
 #include <ctype.h>
 #include <errno.h>
 #include <assert.h>
+#include <vlc_atomic.h>
 
 /*****************************************************************************
  * Module descriptor
@@ -137,6 +145,11 @@
     "Default caching value for outbound RTP streams. This " \
     "value should be set in milliseconds." )
 
+#define QUANTUM_TEXT N_("Pacing quantum (ms)")
+#define QUANTUM_LONGTEXT N_( \
+    "Packets due within this delay are sent together, in as few system " \
+    "calls as possible. 0 only groups late packets." )
+
 #define PROTO_TEXT N_("Transport protocol")
 #define PROTO_LONGTEXT N_( \
     "This selects which transport protocol to use for RTP." )
@@ -227,6 +240,9 @@ vlc_module_begin ()
               RTCP_MUX_TEXT, RTCP_MUX_LONGTEXT, false )
     add_integer( SOUT_CFG_PREFIX "caching", DEFAULT_PTS_DELAY / 1000,
                  CACHING_TEXT, CACHING_LONGTEXT, true )
+    add_integer( SOUT_CFG_PREFIX "quantum", 1, QUANTUM_TEXT,
+                 QUANTUM_LONGTEXT, true )
+        change_integer_range( 0, 100 )
 
 #ifdef HAVE_SRTP
     add_string( SOUT_CFG_PREFIX "key", "",
@@ -263,7 +279,7 @@ vlc_module_end ()
 static const char *const ppsz_sout_options[] = {
     "dst", "name", "cat", "port", "port-audio", "port-video", "*sdp", "ttl",
     "mux", "sap", "description", "url", "email",
-    "proto", "rtcp-mux", "caching",
+    "proto", "rtcp-mux", "caching", "quantum",
 #ifdef HAVE_SRTP
     "key", "salt",
 #endif
@@ -344,10 +360,26 @@ struct sout_stream_sys_t
 
 typedef struct rtp_sink_t
 {
+    atomic_uint refs;
     int rtp_fd;
     rtcp_sender_t *rtcp;
+    bool gso; /* UDP segmentation offload may be tried */
+
+    /* Statistics (only written by the send thread) */
+    uint64_t packets;
+    uint64_t bytes;
+    uint64_t calls;
+    uint64_t errors;
 } rtp_sink_t;
 
+/* Immutable snapshot of the sinks of an ES */
+typedef struct rtp_sink_set_t
+{
+    atomic_uint refs;
+    int count;
+    rtp_sink_t *sinks[];
+} rtp_sink_set_t;
+
 struct sout_stream_id_sys_t
 {
     sout_stream_t *p_stream;
@@ -368,15 +400,16 @@ struct sout_stream_id_sys_t
 
     /* Packetizer specific fields */
     int                 i_mtu;
+    size_t              i_tailroom; /* reserved for the SRTP trailer */
 #ifdef HAVE_SRTP
     srtp_session_t     *srtp;
+    vlc_mutex_t         lock_srtcp;
 #endif
 
     /* Packets sinks */
     vlc_thread_t      thread;
     vlc_mutex_t       lock_sink;
-    int               sinkc;
-    rtp_sink_t       *sinkv;
+    rtp_sink_set_t   *sinks; /* NULL if none */
     rtsp_stream_id_t *rtsp_id;
     struct {
         int          *fd;
@@ -385,6 +418,7 @@ struct sout_stream_id_sys_t
 
     block_fifo_t     *p_fifo;
     int64_t           i_caching;
+    int64_t           i_quantum;
 };
 
 /*****************************************************************************
@@ -811,7 +845,7 @@ char *SDPGenerate( sout_stream_t *p_stream, const char *rtsp_url )
             getsockname( p_sys->es[0]->listen.fd[0],
                          (struct sockaddr *)&dst, &dstlen );
         else
-            getpeername( p_sys->es[0]->sinkv[0].rtp_fd,
+            getpeername( p_sys->es[0]->sinks->sinks[0]->rtp_fd,
                          (struct sockaddr *)&dst, &dstlen );
     }
     else
@@ -969,12 +1003,13 @@ static sout_stream_id_sys_t *Add( sout_stream_t *p_stream,
         id->i_mtu = 576 - 20 - 8; /* pessimistic */
     msg_Dbg( p_stream, "maximum RTP packet size: %d bytes", id->i_mtu );
 
+    id->i_tailroom = 0;
 #ifdef HAVE_SRTP
     id->srtp = NULL;
+    vlc_mutex_init( &id->lock_srtcp );
 #endif
     vlc_mutex_init( &id->lock_sink );
-    id->sinkc = 0;
-    id->sinkv = NULL;
+    id->sinks = NULL;
     id->rtsp_id = NULL;
     id->p_fifo = NULL;
     id->listen.fd = NULL;
@@ -982,6 +1017,8 @@ static sout_stream_id_sys_t *Add( sout_stream_t *p_stream,
     id->b_first_packet = true;
     id->i_caching =
         (int64_t)1000 * var_GetInteger( p_stream, SOUT_CFG_PREFIX "caching");
+    id->i_quantum =
+        (int64_t)1000 * var_GetInteger( p_stream, SOUT_CFG_PREFIX "quantum");
 
     vlc_rand_bytes (&id->i_sequence, sizeof (id->i_sequence));
     vlc_rand_bytes (id->ssrc, sizeof (id->ssrc));
@@ -1026,8 +1063,8 @@ static sout_stream_id_sys_t *Add( sout_stream_t *p_stream,
     if (key)
     {
         vlc_gcrypt_init ();
-        id->srtp = srtp_create (SRTP_ENCR_AES_CM, SRTP_AUTH_HMAC_SHA1, 10,
-                                   SRTP_PRF_AES_CM, SRTP_RCC_MODE1);
+        id->srtp = srtp_create (SRTP_ENCR_AES_CM, SRTP_AUTH_HMAC_SHA1,
+                                SRTP_TAG_LEN, SRTP_PRF_AES_CM, SRTP_RCC_MODE1);
         if (id->srtp == NULL)
         {
             free (key);
@@ -1045,6 +1082,7 @@ static sout_stream_id_sys_t *Add( sout_stream_t *p_stream,
             goto error;
         }
         id->i_sequence = 0; /* FIXME: awful hack for libvlc_srtp */
+        id->i_tailroom = SRTP_TAG_LEN;
     }
 #endif
 
@@ -1167,8 +1205,8 @@ static sout_stream_id_sys_t *Add( sout_stream_t *p_stream,
     int cscov = -1;
     if( cscov != -1 )
         cscov += 8 /* UDP */ + 12 /* RTP */;
-    if( id->sinkc > 0 )
-        net_SetCSCov( id->sinkv[0].rtp_fd, cscov, -1 );
+    if( id->sinks != NULL )
+        net_SetCSCov( id->sinks->sinks[0]->rtp_fd, cscov, -1 );
 #endif
 
     vlc_mutex_lock( &p_sys->lock_ts );
@@ -1246,11 +1284,12 @@ static void Del( sout_stream_t *p_stream, sout_stream_id_sys_t *id )
     }
     /* Delete remaining sinks (incoming connections or explicit
      * outgoing dst=) */
-    while( id->sinkc > 0 )
-        rtp_del_sink( id, id->sinkv[0].rtp_fd );
+    while( id->sinks != NULL )
+        rtp_del_sink( id, id->sinks->sinks[0]->rtp_fd );
 #ifdef HAVE_SRTP
     if( id->srtp != NULL )
         srtp_destroy( id->srtp );
+    vlc_mutex_destroy( &id->lock_srtcp );
 #endif
 
     vlc_mutex_destroy( &id->lock_sink );
@@ -1392,91 +1431,360 @@ static int  HttpCallback( httpd_file_sys_t *p_args,
 /****************************************************************************
  * RTP send
  ****************************************************************************/
-static void* ThreadSend( void *data )
+/* Maximum number of packets sent together */
+#define RTP_BATCH 64
+
+static rtp_sink_set_t *rtp_sinks_hold( sout_stream_id_sys_t *id )
+{
+    vlc_mutex_lock( &id->lock_sink );
+    rtp_sink_set_t *set = id->sinks;
+    if( set != NULL )
+        atomic_fetch_add( &set->refs, 1 );
+    vlc_mutex_unlock( &id->lock_sink );
+    return set;
+}
+
+static void rtp_sink_release( sout_stream_id_sys_t *id, rtp_sink_t *sink )
+{
+    if( atomic_fetch_sub( &sink->refs, 1 ) != 1 )
+        return;
+
+    msg_Dbg( id->p_stream, "socket %d: sent %"PRIu64" packets, %"PRIu64
+             " bytes in %"PRIu64" calls, %"PRIu64" errors", sink->rtp_fd,
+             sink->packets, sink->bytes, sink->calls, sink->errors );
+    CloseRTCP( sink->rtcp );
+    net_Close( sink->rtp_fd );
+    free( sink );
+}
+
+static void rtp_sinks_release( sout_stream_id_sys_t *id,
+                               rtp_sink_set_t *set )
+{
+    if( set == NULL || atomic_fetch_sub( &set->refs, 1 ) != 1 )
+        return;
+
+    for( int i = 0; i < set->count; i++ )
+        rtp_sink_release( id, set->sinks[i] );
+    free( set );
+}
+
+/**
+ * Creates a copy of a set of sinks, with one more or one less sink.
+ */
+static rtp_sink_set_t *rtp_sinks_copy( const rtp_sink_set_t *old,
+                                       rtp_sink_t *add, int fd )
 {
+    int count = (old != NULL) ? old->count : 0;
+    rtp_sink_set_t *set = malloc( sizeof( *set )
+                                  + (count + 1) * sizeof( set->sinks[0] ) );
+    if( unlikely(set == NULL) )
+        return NULL;
+
+    atomic_init( &set->refs, 1 );
+    set->count = 0;
+    for( int i = 0; i < count; i++ )
+    {
+        rtp_sink_t *sink = old->sinks[i];
+
+        if( sink->rtp_fd == fd )
+            continue;
+        atomic_fetch_add( &sink->refs, 1 );
+        set->sinks[set->count++] = sink;
+    }
+    if( add != NULL )
+        set->sinks[set->count++] = add;
+    return set;
+}
+
+/**
+ * Sends packets in as few system calls as possible.
+ * @return the number of packets sent, or -1 on error
+ */
+static int rtp_send_many( int fd, block_t *const *pkts, unsigned n, bool *gso )
+{
+#if defined (UDP_SEGMENT) && defined (HAVE_SENDMMSG)
+    if( *gso && n > 1 )
+    {   /* Equal size packets (but the last one) can be sent as one */
+        size_t size = pkts[0]->i_buffer;
+        unsigned max = __MIN( n, 64 );
+        unsigned k = 1;
+
+        if( size > 0 && max > 65000 / size )
+            max = 65000 / size;
+        while( k < max && pkts[k]->i_buffer == size )
+            k++;
+        if( k < max && pkts[k]->i_buffer < size )
+            k++;
+
+        if( k > 1 )
+        {
+            struct iovec iov[k];
+            union
+            {
+                struct cmsghdr hdr;
+                char buf[CMSG_SPACE(sizeof (uint16_t))];
+            } cmsg;
+            struct msghdr msg = {
+                .msg_iov = iov,
+                .msg_iovlen = k,
+                .msg_control = cmsg.buf,
+                .msg_controllen = sizeof (cmsg.buf),
+            };
+            struct cmsghdr *c = CMSG_FIRSTHDR( &msg );
+            uint16_t segment = size;
+
+            for( unsigned i = 0; i < k; i++ )
+            {
+                iov[i].iov_base = pkts[i]->p_buffer;
+                iov[i].iov_len = pkts[i]->i_buffer;
+            }
+            c->cmsg_level = IPPROTO_UDP;
+            c->cmsg_type = UDP_SEGMENT;
+            c->cmsg_len = CMSG_LEN(sizeof (segment));
+            memcpy( CMSG_DATA(c), &segment, sizeof (segment) );
+
+            if( sendmsg( fd, &msg, 0 ) >= 0 )
+                return k;
+            if( errno != EIO && errno != EINVAL && errno != ENOPROTOOPT
+             && errno != EOPNOTSUPP )
+                return -1;
+            *gso = false; /* not supported by the kernel or the device */
+        }
+    }
+#else
+    VLC_UNUSED(gso);
+#endif
+#ifdef HAVE_SENDMMSG
+    struct mmsghdr msgs[n];
+    struct iovec iov[n];
+
+    for( unsigned i = 0; i < n; i++ )
+    {
+        iov[i].iov_base = pkts[i]->p_buffer;
+        iov[i].iov_len = pkts[i]->i_buffer;
+        memset( &msgs[i], 0, sizeof (msgs[i]) );
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    return sendmmsg( fd, msgs, n, 0 );
+#else
+    VLC_UNUSED(n);
+    return (send( fd, pkts[0]->p_buffer, pkts[0]->i_buffer, 0 ) == -1) ? -1 : 1;
+#endif
+}
+
 #ifdef _WIN32
 # define ENOBUFS      WSAENOBUFS
 # define EAGAIN       WSAEWOULDBLOCK
 # define EWOULDBLOCK  WSAEWOULDBLOCK
 #endif
-    sout_stream_id_sys_t *id = data;
-    unsigned i_caching = id->i_caching;
 
-    for (;;)
+/** Whether a send error only means that the buffers are full */
+static bool rtp_send_busy( int err )
+{
+#if (EAGAIN != EWOULDBLOCK)
+    if( err == EWOULDBLOCK )
+        return true;
+#endif
+    return err == EAGAIN || err == ENOBUFS || err == ENOMEM;
+}
+
+/**
+ * Sends a batch of packets to a sink.
+ *
+ * A packet which cannot be sent for lack of buffers is skipped. Any other
+ * error is either an ICMP soft error, reported once, in which case the
+ * packet is sent again, or a persistent one such as an unreachable network,
+ * in which case the rest of the batch would fail alike and is dropped.
+ * @return false if the connection is broken
+ */
+static bool rtp_sink_send( rtp_sink_t *sink, block_t *const *pkts,
+                           unsigned n )
+{
+    unsigned i = 0;
+
+    while( i < n )
     {
-        block_t *out = block_FifoGet( id->p_fifo );
-        block_cleanup_push (out);
+        int val = rtp_send_many( sink->rtp_fd, pkts + i, n - i, &sink->gso );
 
-#ifdef HAVE_SRTP
-        if( id->srtp )
-        {   /* FIXME: this is awfully inefficient */
-            size_t len = out->i_buffer;
-            out = block_Realloc( out, 0, len + 10 );
-            out->i_buffer = len;
-
-            int canc = vlc_savecancel ();
-            int val = srtp_send( id->srtp, out->p_buffer, &len, len + 10 );
-            vlc_restorecancel (canc);
-            if( val )
+        sink->calls++;
+        if( val > 0 )
+        {
+            for( int j = 0; j < val; j++ )
+                sink->bytes += pkts[i + j]->i_buffer;
+            sink->packets += val;
+            i += val;
+            continue;
+        }
+
+        if( !rtp_send_busy( net_errno ) )
+        {
+            int type;
+            getsockopt( sink->rtp_fd, SOL_SOCKET, SO_TYPE,
+                        &type, &(socklen_t){ sizeof(type) });
+            if( type != SOCK_DGRAM )
+                return false; /* Broken connection */
+
+            /* ICMP soft error: ignore and retry */
+            sink->calls++;
+            if( send( sink->rtp_fd, pkts[i]->p_buffer, pkts[i]->i_buffer,
+                      0 ) >= 0 )
             {
-                msg_Dbg( id->p_stream, "SRTP sending error: %s",
-                         vlc_strerror_c(val) );
-                block_Release( out );
-                out = NULL;
+                sink->bytes += pkts[i]->i_buffer;
+                sink->packets++;
+                i++;
+                continue;
+            }
+            if( !rtp_send_busy( net_errno ) )
+            {   /* Persistent error: drop the rest of the batch */
+                sink->errors += n - i;
+                break;
             }
-            else
-                out->i_buffer = len;
         }
-        if (out)
-            mwait (out->i_dts + i_caching);
-        vlc_cleanup_pop ();
-        if (out == NULL)
-            continue;
+
+        /* Skip the packet which could not be sent */
+        sink->errors++;
+        i++;
+    }
+    return true;
+}
+
+typedef struct
+{
+    unsigned count;
+    block_t *pkts[RTP_BATCH];
+    block_t *pending; /* dequeued, but not due yet */
+} rtp_batch_t;
+
+/* Releases the packets of a sent batch, but not the pending one */
+static void rtp_batch_release( rtp_batch_t *batch )
+{
+    for( unsigned i = 0; i < batch->count; i++ )
+        block_Release( batch->pkts[i] );
+    batch->count = 0;
+}
+
+static void rtp_batch_cleanup( void *data )
+{
+    rtp_batch_t *batch = data;
+
+    rtp_batch_release( batch );
+    if( batch->pending != NULL )
+        block_Release( batch->pending );
+}
+
+#ifdef HAVE_SRTP
+static block_t *rtp_protect( sout_stream_id_sys_t *id, block_t *out )
+{
+    if( id->srtp == NULL )
+        return out;
+
+    size_t len = out->i_buffer;
+    size_t size = out->p_start + out->i_size - out->p_buffer;
+
+    if( size < len + SRTP_TAG_LEN )
+    {   /* Packets from rtp_packetize_new() are encrypted in place. This is
+         * only needed for packets reusing the input block. */
+        out = block_Realloc( out, 0, len + SRTP_TAG_LEN );
+        if( unlikely(out == NULL) )
+            return NULL;
+        out->i_buffer = len;
+        size = len + SRTP_TAG_LEN;
+    }
+
+    int canc = vlc_savecancel ();
+    int val = srtp_send( id->srtp, out->p_buffer, &len, size );
+    vlc_restorecancel (canc);
+    if( val )
+    {
+        msg_Dbg( id->p_stream, "SRTP sending error: %s",
+                 vlc_strerror_c(val) );
+        block_Release( out );
+        return NULL;
+    }
+    out->i_buffer = len;
+    return out;
+}
 #else
-        mwait (out->i_dts + i_caching);
-        vlc_cleanup_pop ();
+# define rtp_protect( id, out ) (out)
 #endif
 
-        ssize_t len = out->i_buffer;
-        int canc = vlc_savecancel ();
+static void* ThreadSend( void *data )
+{
+    sout_stream_id_sys_t *id = data;
+    unsigned i_caching = id->i_caching;
+    rtp_batch_t batch = { .count = 0, .pending = NULL };
 
-        vlc_mutex_lock( &id->lock_sink );
-        unsigned deadc = 0; /* How many dead sockets? */
-        int deadv[id->sinkc ? id->sinkc : 1]; /* Dead sockets list */
+    vlc_cleanup_push( rtp_batch_cleanup, &batch );
+    for (;;)
+    {
+        block_t *out = batch.pending;
+
+        batch.pending = NULL;
+        if( out == NULL )
+            out = block_FifoGet( id->p_fifo );
+        out = rtp_protect( id, out );
+        if( out == NULL )
+            continue;
 
-        for( int i = 0; i < id->sinkc; i++ )
+        batch.pkts[0] = out;
+        batch.count = 1;
+        mwait (out->i_dts + i_caching);
+
+        /* Gather the following packets due within the pacing quantum */
+        mtime_t deadline = mdate() + id->i_quantum;
+
+        while( batch.count < RTP_BATCH )
         {
-#ifdef HAVE_SRTP
-            if( !id->srtp ) /* FIXME: SRTCP support */
-#endif
-                SendRTCP( id->sinkv[i].rtcp, out );
+            vlc_fifo_Lock( id->p_fifo );
+            out = vlc_fifo_DequeueUnlocked( id->p_fifo );
+            vlc_fifo_Unlock( id->p_fifo );
 
-            if( send( id->sinkv[i].rtp_fd, out->p_buffer, len, 0 ) == -1
-             && net_errno != EAGAIN && net_errno != EWOULDBLOCK
-             && net_errno != ENOBUFS && net_errno != ENOMEM )
+            if( out == NULL )
+                break;
+            if( out->i_dts + i_caching > deadline )
             {
-                int type;
-                getsockopt( id->sinkv[i].rtp_fd, SOL_SOCKET, SO_TYPE,
-                            &type, &(socklen_t){ sizeof(type) });
-                if( type == SOCK_DGRAM )
-                    /* ICMP soft error: ignore and retry */
-                    send( id->sinkv[i].rtp_fd, out->p_buffer, len, 0 );
-                else
-                    /* Broken connection */
-                    deadv[deadc++] = id->sinkv[i].rtp_fd;
+                batch.pending = out;
+                break;
             }
+
+            out = rtp_protect( id, out );
+            if( out != NULL )
+                batch.pkts[batch.count++] = out;
         }
+
+        int canc = vlc_savecancel ();
+        rtp_sink_set_t *set = rtp_sinks_hold( id );
+        unsigned deadc = 0; /* How many dead sockets? */
+        int deadv[(set != NULL) ? set->count : 1]; /* Dead sockets list */
+
+        for( int i = 0; set != NULL && i < set->count; i++ )
+        {
+            rtp_sink_t *sink = set->sinks[i];
+
+            for( unsigned j = 0; j < batch.count; j++ )
+                SendRTCP( sink->rtcp, batch.pkts[j] );
+
+            if( !rtp_sink_send( sink, batch.pkts, batch.count ) )
+                deadv[deadc++] = sink->rtp_fd;
+        }
+
+        out = batch.pkts[batch.count - 1];
+        vlc_mutex_lock( &id->lock_sink );
         id->i_seq_sent_next = ntohs(((uint16_t *) out->p_buffer)[1]) + 1;
         vlc_mutex_unlock( &id->lock_sink );
-        block_Release( out );
+
+        rtp_batch_release( &batch );
 
         for( unsigned i = 0; i < deadc; i++ )
         {
             msg_Dbg( id->p_stream, "removing socket %d", deadv[i] );
             rtp_del_sink( id, deadv[i] );
         }
+        rtp_sinks_release( id, set );
         vlc_restorecancel (canc);
     }
+    vlc_cleanup_pop();
     return NULL;
 }
 
@@ -1504,39 +1812,97 @@ static void *rtp_listen_thread( void *data )
 
 int rtp_add_sink( sout_stream_id_sys_t *id, int fd, bool rtcp_mux, uint16_t *seq )
 {
-    rtp_sink_t sink = { fd, NULL };
-    sink.rtcp = OpenRTCP( VLC_OBJECT( id->p_stream ), fd, IPPROTO_UDP,
-                          rtcp_mux );
-    if( sink.rtcp == NULL )
+    rtp_sink_t *sink = calloc( 1, sizeof( *sink ) );
+    if( unlikely(sink == NULL) )
+    {
+        net_Close( fd );
+        return VLC_ENOMEM;
+    }
+
+    atomic_init( &sink->refs, 1 );
+    sink->rtp_fd = fd;
+    sink->rtcp = OpenRTCP( VLC_OBJECT( id->p_stream ), id, fd, IPPROTO_UDP,
+                           rtcp_mux );
+    if( sink->rtcp == NULL )
         msg_Err( id->p_stream, "RTCP failed!" );
 
+    sink->gso = false;
+#if defined (UDP_SEGMENT) && defined (SO_PROTOCOL)
+    int proto;
+    if( getsockopt( fd, SOL_SOCKET, SO_PROTOCOL, &proto,
+                    &(socklen_t){ sizeof (proto) } ) == 0 )
+        sink->gso = proto == IPPROTO_UDP;
+#endif
+
     vlc_mutex_lock( &id->lock_sink );
-    TAB_APPEND(id->sinkc, id->sinkv, sink);
+    rtp_sink_set_t *old = id->sinks;
+    rtp_sink_set_t *set = rtp_sinks_copy( old, sink, -1 );
+    if( likely(set != NULL) )
+        id->sinks = set;
     if( seq != NULL )
         *seq = id->i_seq_sent_next;
     vlc_mutex_unlock( &id->lock_sink );
+
+    if( unlikely(set == NULL) )
+    {
+        rtp_sink_release( id, sink );
+        return VLC_ENOMEM;
+    }
+    /* The sinks of the old set are referenced by the new one */
+    rtp_sinks_release( id, old );
     return VLC_SUCCESS;
 }
 
 void rtp_del_sink( sout_stream_id_sys_t *id, int fd )
 {
-    rtp_sink_t sink = { fd, NULL };
+    rtp_sink_set_t *old, *set = NULL;
+    bool found = false;
 
     /* NOTE: must be safe to use if fd is not included */
     vlc_mutex_lock( &id->lock_sink );
-    for( int i = 0; i < id->sinkc; i++ )
+    old = id->sinks;
+    for( int i = 0; old != NULL && i < old->count; i++ )
+        if( old->sinks[i]->rtp_fd == fd )
+            found = true;
+
+    if( found )
     {
-        if (id->sinkv[i].rtp_fd == fd)
+        if( old->count > 1 )
         {
-            sink = id->sinkv[i];
-            TAB_ERASE(id->sinkc, id->sinkv, i);
-            break;
+            set = rtp_sinks_copy( old, NULL, fd );
+            if( unlikely(set == NULL) )
+            {
+                msg_Err( id->p_stream, "cannot remove socket %d", fd );
+                found = false;
+            }
         }
+        if( found )
+            id->sinks = set;
     }
     vlc_mutex_unlock( &id->lock_sink );
 
-    CloseRTCP( sink.rtcp );
-    net_Close( sink.rtp_fd );
+    if( found )
+        /* The socket is closed when no longer used by the send thread */
+        rtp_sinks_release( id, old );
+    else
+        net_Close( fd );
+}
+
+int rtp_srtcp_protect( sout_stream_id_sys_t *id, uint8_t *buf, size_t *lenp,
+                       size_t size )
+{
+#ifdef HAVE_SRTP
+    if( id->srtp != NULL )
+    {   /* Sinks may send SRTCP from different threads */
+        vlc_mutex_lock( &id->lock_srtcp );
+        int val = srtcp_send( id->srtp, buf, lenp, size );
+        vlc_mutex_unlock( &id->lock_srtcp );
+        return val;
+    }
+#else
+    VLC_UNUSED(id); VLC_UNUSED(buf); VLC_UNUSED(lenp); VLC_UNUSED(size);
+#endif
+    return 0;
 }
 
 uint16_t rtp_get_seq( sout_stream_id_sys_t *id )
@@ -1611,6 +1977,15 @@ int64_t rtp_get_ts( const sout_stream_t *p_stream, const sout_stream_id_sys_t *i
     return p_sys->i_pts_zero + npt;
 }
 
+block_t *rtp_packetize_new( sout_stream_id_sys_t *id, size_t size )
+{
+    /* Reserve room for the SRTP trailer, so that it is added in place */
+    block_t *out = block_Alloc( size + id->i_tailroom );
+    if( likely(out != NULL) )
+        out->i_buffer = size;
+    return out;
+}
+
 void rtp_packetize_common( sout_stream_id_sys_t *id, block_t *out,
                            bool b_m_bit, int64_t i_pts )
 {
@@ -1668,7 +2043,7 @@ void rtp_packetize_send( sout_stream_id_sys_t *id, block_t *out )
  */
 size_t rtp_mtu (const sout_stream_id_sys_t *id)
 {
-    return id->i_mtu - 12;
+    return id->i_mtu - 12 - id->i_tailroom;
 }
 
 /*****************************************************************************
@@ -1724,7 +2099,7 @@ static ssize_t AccessOutGrabberWriteBuffer( sout_stream_t *p_stream,
 
     uint8_t         *p_data = p_buffer->p_buffer;
     size_t          i_data  = p_buffer->i_buffer;
-    size_t          i_max   = id->i_mtu - 12;
+    size_t          i_max   = rtp_mtu( id );
     bool            b_dis   = (p_buffer->i_flags & BLOCK_FLAG_DISCONTINUITY);
 
     size_t i_packet = ( p_buffer->i_buffer + i_max - 1 ) / i_max;
@@ -1744,7 +2119,7 @@ static ssize_t AccessOutGrabberWriteBuffer( sout_stream_t *p_stream,
         if( p_sys->packet == NULL )
         {
             /* allocate a new packet */
-            p_sys->packet = block_Alloc( id->i_mtu );
+            p_sys->packet = rtp_packetize_new( id, 12 + i_max );
             /* m-bit is discontinuity for MPEG1/2 PS and TS, RFC2250 2.1 */
             rtp_packetize_common( id, p_sys->packet, b_dis, i_dts );
             p_sys->packet->i_buffer = 12;
@@ -1754,8 +2129,7 @@ static ssize_t AccessOutGrabberWriteBuffer( sout_stream_t *p_stream,
             b_dis = false;
         }
 
-        i_size = __MIN( i_data,
-                        (unsigned)(id->i_mtu - p_sys->packet->i_buffer) );
+        i_size = __MIN( i_data, 12 + i_max - p_sys->packet->i_buffer );
 
         memcpy( &p_sys->packet->p_buffer[p_sys->packet->i_buffer],
                 p_data, i_size );
@@ -54,6 +54,7 @@ int64_t rtp_get_ts( const sout_stream_t *p_stream, const sout_stream_id_sys_t *i
                     int64_t *p_npt );
 
 /* RTP packetization */
+block_t *rtp_packetize_new (sout_stream_id_sys_t *id, size_t size);
 void rtp_packetize_common (sout_stream_id_sys_t *id, block_t *out,
                            bool b_m_bit, int64_t i_pts);
 void rtp_packetize_send (sout_stream_id_sys_t *id, block_t *out);
@@ -62,10 +63,15 @@ size_t rtp_mtu (const sout_stream_id_sys_t *id);
 int rtp_packetize_xiph_config( sout_stream_id_sys_t *id, const char *fmtp,
                                int64_t i_pts );
 
+/* SRTP */
+#define SRTP_TAG_LEN 10 /* authentication tag length (bytes) */
+int rtp_srtcp_protect (sout_stream_id_sys_t *id, uint8_t *buf, size_t *lenp,
+                       size_t size);
+
 /* RTCP */
 typedef struct rtcp_sender_t rtcp_sender_t;
-rtcp_sender_t *OpenRTCP (vlc_object_t *obj, int rtp_fd, int proto,
-                         bool mux);
+rtcp_sender_t *OpenRTCP (vlc_object_t *obj, sout_stream_id_sys_t *id,
+                         int rtp_fd, int proto, bool mux);
 void CloseRTCP (rtcp_sender_t *rtcp);
 void SendRTCP (rtcp_sender_t *restrict rtcp, const block_t *rtp);
 
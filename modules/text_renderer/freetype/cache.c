@@ -0,0 +1,204 @@
+/*****************************************************************************
+ * cache.c : Bounded LRU cache for the FreeType text renderer
+ *****************************************************************************
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <vlc_common.h>
+
+#include "cache.h"
+
+#define CACHE_MIN_BUCKETS 256
+
+static uint32_t HashKey( const void *p_key, size_t i_key )
+{
+    const uint8_t *p = p_key;
+    uint32_t i_hash = 2166136261u; /* FNV-1a */
+
+    for( size_t i = 0; i < i_key; i++ )
+        i_hash = ( i_hash ^ p[i] ) * 16777619u;
+    return i_hash;
+}
+
+static void LruUnlink( text_cache_t *p_cache, text_cache_entry_t *p_entry )
+{
+    if( p_entry->p_lru_prev )
+        p_entry->p_lru_prev->p_lru_next = p_entry->p_lru_next;
+    else
+        p_cache->p_lru_first = p_entry->p_lru_next;
+
+    if( p_entry->p_lru_next )
+        p_entry->p_lru_next->p_lru_prev = p_entry->p_lru_prev;
+    else
+        p_cache->p_lru_last = p_entry->p_lru_prev;
+}
+
+static void LruPushFront( text_cache_t *p_cache, text_cache_entry_t *p_entry )
+{
+    p_entry->p_lru_prev = NULL;
+    p_entry->p_lru_next = p_cache->p_lru_first;
+    if( p_cache->p_lru_first )
+        p_cache->p_lru_first->p_lru_prev = p_entry;
+    else
+        p_cache->p_lru_last = p_entry;
+    p_cache->p_lru_first = p_entry;
+}
+
+/* Doubles the number of buckets. Failure is harmless: chains get longer. */
+static void Rehash( text_cache_t *p_cache )
+{
+    size_t i_buckets = p_cache->i_buckets ? 2 * p_cache->i_buckets
+                                          : CACHE_MIN_BUCKETS;
+    text_cache_entry_t **pp_buckets = calloc( i_buckets, sizeof( *pp_buckets ) );
+    if( unlikely( !pp_buckets ) )
+        return;
+
+    for( text_cache_entry_t *p = p_cache->p_lru_first; p; p = p->p_lru_next )
+    {
+        text_cache_entry_t **pp = &pp_buckets[p->i_hash & ( i_buckets - 1 )];
+        p->p_hash_next = *pp;
+        *pp = p;
+    }
+
+    free( p_cache->pp_buckets );
+    p_cache->pp_buckets = pp_buckets;
+    p_cache->i_buckets = i_buckets;
+}
+
+void TextCacheInit( text_cache_t *p_cache, size_t i_max_bytes,
+                    void (*pf_release)( text_cache_entry_t * ) )
+{
+    memset( p_cache, 0, sizeof( *p_cache ) );
+    p_cache->i_max_bytes = i_max_bytes;
+    p_cache->pf_release = pf_release;
+}
+
+void TextCacheClean( text_cache_t *p_cache )
+{
+    for( text_cache_entry_t *p = p_cache->p_lru_first; p; )
+    {
+        text_cache_entry_t *p_next = p->p_lru_next;
+        p_cache->pf_release( p );
+        p = p_next;
+    }
+
+    free( p_cache->pp_buckets );
+    p_cache->pp_buckets = NULL;
+    p_cache->i_buckets = 0;
+    p_cache->i_count = 0;
+    p_cache->p_lru_first = p_cache->p_lru_last = NULL;
+    p_cache->i_bytes = 0;
+}
+
+text_cache_entry_t *TextCacheGet( text_cache_t *p_cache,
+                                  const void *p_key, size_t i_key )
+{
+    if( p_cache->i_buckets == 0 )
+    {
+        p_cache->i_misses++;
+        return NULL;
+    }
+
+    uint32_t i_hash = HashKey( p_key, i_key );
+
+    for( text_cache_entry_t *p = p_cache->pp_buckets[i_hash & ( p_cache->i_buckets - 1 )];
+         p; p = p->p_hash_next )
+    {
+        if( p->i_hash == i_hash && p->i_key == i_key
+         && !memcmp( p->p_key, p_key, i_key ) )
+        {
+            if( p != p_cache->p_lru_first )
+            {
+                LruUnlink( p_cache, p );
+                LruPushFront( p_cache, p );
+            }
+            p_cache->i_hits++;
+            return p;
+        }
+    }
+
+    p_cache->i_misses++;
+    return NULL;
+}
+
+void TextCacheAdd( text_cache_t *p_cache, text_cache_entry_t *p_entry,
+                   const void *p_key, size_t i_key, size_t i_bytes )
+{
+    if( p_cache->i_count >= p_cache->i_buckets )
+        Rehash( p_cache );
+
+    p_entry->p_key = p_key;
+    p_entry->i_key = i_key;
+    p_entry->i_hash = HashKey( p_key, i_key );
+    p_entry->i_bytes = i_bytes;
+
+    LruPushFront( p_cache, p_entry );
+    p_cache->i_count++;
+    p_cache->i_bytes += i_bytes;
+
+    if( likely( p_cache->i_buckets > 0 ) )
+    {
+        text_cache_entry_t **pp =
+            &p_cache->pp_buckets[p_entry->i_hash & ( p_cache->i_buckets - 1 )];
+        p_entry->p_hash_next = *pp;
+        *pp = p_entry;
+    }
+    else
+    {
+        /* Not reachable through lookups, it will be evicted first */
+        p_entry->p_hash_next = NULL;
+        LruUnlink( p_cache, p_entry );
+        p_entry->p_lru_prev = p_cache->p_lru_last;
+        p_entry->p_lru_next = NULL;
+        if( p_cache->p_lru_last )
+            p_cache->p_lru_last->p_lru_next = p_entry;
+        else
+            p_cache->p_lru_first = p_entry;
+        p_cache->p_lru_last = p_entry;
+    }
+}
+
+void TextCacheTrim( text_cache_t *p_cache )
+{
+    while( p_cache->i_bytes > p_cache->i_max_bytes && p_cache->p_lru_last )
+    {
+        text_cache_entry_t *p_entry = p_cache->p_lru_last;
+
+        LruUnlink( p_cache, p_entry );
+
+        if( p_cache->i_buckets > 0 )
+        {
+            text_cache_entry_t **pp =
+                &p_cache->pp_buckets[p_entry->i_hash & ( p_cache->i_buckets - 1 )];
+            while( *pp != p_entry )
+                pp = &(*pp)->p_hash_next;
+            *pp = p_entry->p_hash_next;
+        }
+
+        p_cache->i_count--;
+        p_cache->i_bytes -= p_entry->i_bytes;
+        p_cache->i_evictions++;
+        p_cache->pf_release( p_entry );
+    }
+}
@@ -0,0 +1,120 @@
+/*****************************************************************************
+ * cache.h : Bounded LRU cache for the FreeType text renderer
+ *****************************************************************************
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLC_FREETYPE_CACHE_H
+#define VLC_FREETYPE_CACHE_H
+
+/** \ingroup freetype
+ * @{
+ * \file
+ * Bounded LRU cache, keyed by byte strings.
+ *
+ * Entries embed a text_cache_entry_t as their first member. The cache owns
+ * its entries and releases them with the callback given at initialization,
+ * either when they are evicted or when the cache is cleaned.
+ *
+ * Eviction only happens in TextCacheTrim(), so that entries looked up
+ * during the layout of a text remain valid until the layout is done.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct text_cache_entry_t text_cache_entry_t;
+struct text_cache_entry_t
+{
+    text_cache_entry_t *p_hash_next;
+    text_cache_entry_t *p_lru_prev;
+    text_cache_entry_t *p_lru_next;
+    const void         *p_key;
+    size_t              i_key;
+    uint32_t            i_hash;
+    size_t              i_bytes;  /**< Memory accounted for this entry */
+};
+
+typedef struct
+{
+    text_cache_entry_t **pp_buckets;
+    size_t               i_buckets;
+    size_t               i_count;
+
+    /** Most (first) to least (last) recently used entries */
+    text_cache_entry_t  *p_lru_first;
+    text_cache_entry_t  *p_lru_last;
+
+    size_t               i_bytes;
+    size_t               i_max_bytes;
+    void               (*pf_release)( text_cache_entry_t * );
+
+    uint64_t             i_hits;
+    uint64_t             i_misses;
+    uint64_t             i_evictions;
+} text_cache_t;
+
+/**
+ * Initializes a cache.
+ *
+ * \param i_max_bytes memory budget of the entries
+ * \param pf_release entry destructor
+ */
+void TextCacheInit( text_cache_t *p_cache, size_t i_max_bytes,
+                    void (*pf_release)( text_cache_entry_t * ) );
+
+/**
+ * Releases all the entries of a cache.
+ */
+void TextCacheClean( text_cache_t *p_cache );
+
+/**
+ * Looks an entry up, and marks it as most recently used.
+ *
+ * \return the entry, or NULL if the key is not in the cache
+ */
+text_cache_entry_t *TextCacheGet( text_cache_t *p_cache,
+                                  const void *p_key, size_t i_key );
+
+/**
+ * Inserts an entry. The cache takes ownership of the entry.
+ *
+ * \param p_key key of the entry, must remain valid as long as the entry
+ *              (it is usually stored within the entry)
+ * \param i_bytes memory used by the entry
+ */
+void TextCacheAdd( text_cache_t *p_cache, text_cache_entry_t *p_entry,
+                   const void *p_key, size_t i_key, size_t i_bytes );
+
+/**
+ * Accounts for memory added to an entry already in the cache.
+ */
+static inline void TextCacheGrow( text_cache_t *p_cache,
+                                  text_cache_entry_t *p_entry, size_t i_bytes )
+{
+    p_entry->i_bytes += i_bytes;
+    p_cache->i_bytes += i_bytes;
+}
+
+/**
+ * Evicts the least recently used entries until the memory budget is met.
+ */
+void TextCacheTrim( text_cache_t *p_cache );
+
+/** @} */
+
+#endif
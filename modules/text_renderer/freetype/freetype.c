@@ -122,6 +122,11 @@ static void Destroy( vlc_object_t * );
 static const int pi_sizes[] = { 20, 18, 16, 12, 6 };
 static const char *const ppsz_sizes_text[] = {
     N_("Smaller"), N_("Small"), N_("Normal"), N_("Large"), N_("Larger") };
+#define CACHE_SIZE_TEXT N_("Glyph cache size (kiB)")
+#define CACHE_SIZE_LONGTEXT N_("Memory used to cache rendered glyphs and " \
+  "laid out lines, so that repeated text is not rendered again. 0 disables " \
+  "caching.")
+
 #define YUVP_TEXT N_("Use YUVP renderer")
 #define YUVP_LONGTEXT N_("This renders the font using \"paletized YUV\". " \
   "This option is only needed if you want to encode into DVB subtitles" )
@@ -230,6 +235,9 @@ vlc_module_begin ()
 
     add_obsolete_integer( "freetype-effect" );
 
+    add_integer_with_range( "freetype-cache-size", 4096, 0, 65536,
+                            CACHE_SIZE_TEXT, CACHE_SIZE_LONGTEXT, true )
+
     add_bool( "freetype-yuvp", false, YUVP_TEXT,
               YUVP_LONGTEXT, true )
 
@@ -1236,6 +1244,9 @@ static int Create( vlc_object_t *p_this )
         p_sys->p_stroker = NULL;
     }
 
+    LayoutCachesInit( p_filter,
+                      var_InheritInteger( p_filter, "freetype-cache-size" ) * 1024 );
+
     /* Dictionnaries for fonts and families */
     vlc_dictionary_init( &p_sys->face_map, 50 );
     vlc_dictionary_init( &p_sys->family_map, 50 );
@@ -1361,6 +1372,9 @@ static void Destroy( vlc_object_t *p_this )
     DumpDictionary( p_filter, &p_sys->fallback_map, true, -1 );
 #endif
 
+    /* Cached glyphs refer to the faces */
+    LayoutCachesClean( p_filter );
+
     /* Text styles */
     text_style_Delete( p_sys->p_default_style );
     text_style_Delete( p_sys->p_forced_style );
@@ -47,6 +47,8 @@
 #include FT_GLYPH_H
 #include FT_STROKER_H
 
+#include "cache.h"
+
 /* Consistency between Freetype versions and platforms */
 #define FT_FLOOR(X)     ((X & -64) >> 6)
 #define FT_CEIL(X)      (((X + 63) & -64) >> 6)
@@ -111,6 +113,10 @@ struct filter_sys_t
     /** Font face cache */
     vlc_dictionary_t  face_map;
 
+    /** Glyph bitmaps and laid out lines caches, see LayoutText() */
+    text_cache_t      glyph_cache;
+    text_cache_t      line_cache;
+
     int               i_fallback_counter;
 
     /* Current scaling of the text, default is 100 (%) */
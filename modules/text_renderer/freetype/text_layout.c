@@ -42,6 +42,7 @@
 #include <vlc_common.h>
 #include <vlc_filter.h>
 #include <vlc_text_style.h>
+#include <vlc_memstream.h>
 
 /* Freetype */
 #include <ft2build.h>
@@ -115,14 +116,57 @@ typedef struct run_desc_t
 
 } run_desc_t;
 
+/**
+ * Glyph cache key. Everything that changes the outlines of a glyph is part
+ * of the key, the sub-pixel pen position is handled by glyph_render_t.
+ */
+typedef struct
+{
+    FT_Face  p_face;
+    FT_Fixed i_x_scale;         /**< Size of the face */
+    FT_Fixed i_y_scale;
+    FT_UInt  i_glyph_index;
+    int      i_radius;          /**< Stroker radius for the outline */
+    int      i_flags;           /**< GLYPH_* flags */
+} glyph_key_t;
+
+#define GLYPH_EMBOLDEN  0x01
+#define GLYPH_OBLIQUE   0x02
+#define GLYPH_OUTLINE   0x04
+#define GLYPH_SHADOW    0x08
+
+/**
+ * Bitmaps of a cached glyph, rendered at a given 26.6 pen position within
+ * a pixel. Rendering is invariant by whole pixel translations, so the
+ * bitmaps are only moved to their actual position when laying out lines.
+ */
+typedef struct glyph_render_t glyph_render_t;
+struct glyph_render_t
+{
+    glyph_render_t *p_next;
+    FT_Vector       pen;
+    FT_Vector       pen_shadow;
+    FT_Glyph        p_glyph;    /**< NULL if rendering failed */
+    FT_Glyph        p_outline;
+    FT_Glyph        p_shadow;
+};
+
+typedef struct
+{
+    text_cache_entry_t  cache;
+    glyph_key_t         key;
+    FT_Glyph            p_glyph;    /**< Glyph outline */
+    FT_Glyph            p_outline;  /**< Stroked outline, or NULL */
+    FT_Vector           advance;
+    glyph_render_t     *p_renders;
+} glyph_entry_t;
+
 /**
  * Glyph bitmaps. Advance and offset are 26.6 values
  */
 typedef struct glyph_bitmaps_t
 {
-    FT_Glyph p_glyph;
-    FT_Glyph p_outline;
-    FT_Glyph p_shadow;
+    glyph_entry_t *p_entry; /**< Cached glyph, owned by the glyph cache */
     FT_BBox  glyph_bbox;
     FT_BBox  outline_bbox;
     FT_BBox  shadow_bbox;
@@ -881,13 +925,7 @@ static int RemoveZeroWidthCharacters( paragraph_t *p_paragraph )
          || ( ch >= 0x200b && ch <= 0x200f ) )
         {
             glyph_bitmaps_t *p_bitmaps = p_paragraph->p_glyph_bitmaps + i;
-            if( p_bitmaps->p_glyph )
-                FT_Done_Glyph( p_bitmaps->p_glyph );
-            if( p_bitmaps->p_outline )
-                FT_Done_Glyph( p_bitmaps->p_outline );
-            p_bitmaps->p_glyph = 0;
-            p_bitmaps->p_outline = 0;
-            p_bitmaps->p_shadow = 0;
+            p_bitmaps->p_entry = NULL;
             p_bitmaps->i_x_advance = 0;
             p_bitmaps->i_y_advance = 0;
         }
@@ -914,6 +952,186 @@ static int ZeroNsmAdvance( paragraph_t *p_paragraph )
 #endif
 #endif
 
+/**
+ * Memory used by a glyph, for cache accounting
+ */
+static size_t GlyphSize( FT_Glyph p_glyph )
+{
+    if( !p_glyph )
+        return 0;
+
+    if( p_glyph->format == FT_GLYPH_FORMAT_BITMAP )
+    {
+        const FT_Bitmap *p_bitmap = &((FT_BitmapGlyph)p_glyph)->bitmap;
+        return sizeof( FT_BitmapGlyphRec ) + p_bitmap->rows * abs( p_bitmap->pitch );
+    }
+    if( p_glyph->format == FT_GLYPH_FORMAT_OUTLINE )
+    {
+        const FT_Outline *p_outline = &((FT_OutlineGlyph)p_glyph)->outline;
+        return sizeof( FT_OutlineGlyphRec )
+             + p_outline->n_points * ( sizeof( FT_Vector ) + 1 )
+             + p_outline->n_contours * sizeof( short );
+    }
+    return sizeof( FT_GlyphRec );
+}
+
+static void ReleaseGlyphEntry( text_cache_entry_t *p_cache_entry )
+{
+    glyph_entry_t *p_entry = (glyph_entry_t *) p_cache_entry;
+
+    for( glyph_render_t *p_render = p_entry->p_renders; p_render; )
+    {
+        glyph_render_t *p_next = p_render->p_next;
+        if( p_render->p_glyph )
+            FT_Done_Glyph( p_render->p_glyph );
+        if( p_render->p_outline )
+            FT_Done_Glyph( p_render->p_outline );
+        if( p_render->p_shadow )
+            FT_Done_Glyph( p_render->p_shadow );
+        free( p_render );
+        p_render = p_next;
+    }
+
+    FT_Done_Glyph( p_entry->p_glyph );
+    if( p_entry->p_outline )
+        FT_Done_Glyph( p_entry->p_outline );
+    free( p_entry );
+}
+
+/**
+ * Load a glyph into the glyph cache
+ */
+static glyph_entry_t *LoadGlyph( filter_t *p_filter, const glyph_key_t *p_key )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+    FT_Face p_face = p_key->p_face;
+
+    if( FT_Load_Glyph( p_face, p_key->i_glyph_index,
+                       FT_LOAD_NO_BITMAP | FT_LOAD_DEFAULT )
+     && FT_Load_Glyph( p_face, p_key->i_glyph_index, FT_LOAD_DEFAULT ) )
+        return NULL;
+
+    if( p_key->i_flags & GLYPH_EMBOLDEN )
+        FT_GlyphSlot_Embolden( p_face->glyph );
+    if( p_key->i_flags & GLYPH_OBLIQUE )
+        FT_GlyphSlot_Oblique( p_face->glyph );
+
+    glyph_entry_t *p_entry = malloc( sizeof( *p_entry ) );
+    if( unlikely( !p_entry ) )
+        return NULL;
+
+    if( FT_Get_Glyph( p_face->glyph, &p_entry->p_glyph ) )
+    {
+        free( p_entry );
+        return NULL;
+    }
+
+    p_entry->p_outline = NULL;
+    if( p_key->i_flags & GLYPH_OUTLINE )
+    {
+        p_entry->p_outline = p_entry->p_glyph;
+        if( FT_Glyph_StrokeBorder( &p_entry->p_outline, p_sys->p_stroker, 0, 0 ) )
+            p_entry->p_outline = NULL;
+    }
+
+    p_entry->key = *p_key;
+    p_entry->advance = p_face->glyph->advance;
+    p_entry->p_renders = NULL;
+
+    TextCacheAdd( &p_sys->glyph_cache, &p_entry->cache,
+                  &p_entry->key, sizeof( p_entry->key ),
+                  sizeof( *p_entry ) + GlyphSize( p_entry->p_glyph )
+                                     + GlyphSize( p_entry->p_outline ) );
+    return p_entry;
+}
+
+/**
+ * Render a glyph to a bitmap, leaving the source glyph untouched
+ */
+static FT_Glyph RenderGlyph( FT_Glyph p_source, FT_Vector *p_origin )
+{
+    FT_Glyph p_glyph = p_source;
+
+    if( !p_source )
+        return NULL;
+    if( p_source->format == FT_GLYPH_FORMAT_BITMAP )
+        return FT_Glyph_Copy( p_source, &p_glyph ) ? NULL : p_glyph;
+    if( FT_Glyph_To_Bitmap( &p_glyph, FT_RENDER_MODE_NORMAL, p_origin, 0 ) )
+        return NULL;
+    return p_glyph;
+}
+
+/**
+ * Get the bitmaps of a cached glyph for the given pen positions,
+ * rendering them if they are not cached yet
+ */
+static const glyph_render_t *GetGlyphRender( filter_t *p_filter,
+                                             glyph_entry_t *p_entry,
+                                             const FT_Vector *p_pen,
+                                             const FT_Vector *p_pen_shadow )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+    FT_Vector pen = { .x = p_pen->x & 63, .y = p_pen->y & 63 };
+    FT_Vector pen_shadow = { .x = 0, .y = 0 };
+
+    if( p_entry->key.i_flags & GLYPH_SHADOW )
+    {
+        pen_shadow.x = p_pen_shadow->x & 63;
+        pen_shadow.y = p_pen_shadow->y & 63;
+    }
+
+    for( glyph_render_t *p_render = p_entry->p_renders; p_render;
+         p_render = p_render->p_next )
+    {
+        if( p_render->pen.x == pen.x && p_render->pen.y == pen.y
+         && p_render->pen_shadow.x == pen_shadow.x
+         && p_render->pen_shadow.y == pen_shadow.y )
+            return p_render;
+    }
+
+    glyph_render_t *p_render = malloc( sizeof( *p_render ) );
+    if( unlikely( !p_render ) )
+        return NULL;
+
+    p_render->pen = pen;
+    p_render->pen_shadow = pen_shadow;
+    p_render->p_glyph = RenderGlyph( p_entry->p_glyph, &pen );
+    p_render->p_outline = p_render->p_glyph ?
+                          RenderGlyph( p_entry->p_outline, &pen ) : NULL;
+    p_render->p_shadow = NULL;
+    if( p_entry->key.i_flags & GLYPH_SHADOW )
+        p_render->p_shadow = RenderGlyph( p_entry->p_outline ?
+                                          p_entry->p_outline : p_entry->p_glyph,
+                                          &pen_shadow );
+
+    p_render->p_next = p_entry->p_renders;
+    p_entry->p_renders = p_render;
+    TextCacheGrow( &p_sys->glyph_cache, &p_entry->cache,
+                   sizeof( *p_render ) + GlyphSize( p_render->p_glyph )
+                                       + GlyphSize( p_render->p_outline )
+                                       + GlyphSize( p_render->p_shadow ) );
+    return p_render;
+}
+
+/**
+ * Copy a cached glyph bitmap for a line, moving it to the whole pixel part
+ * of the pen position
+ */
+static FT_Glyph CopyGlyph( FT_Glyph p_source, const FT_Vector *p_pen,
+                           FT_BBox *p_bbox )
+{
+    FT_Glyph p_glyph;
+
+    if( !p_source || FT_Glyph_Copy( p_source, &p_glyph ) )
+        return NULL;
+
+    FT_BitmapGlyph p_bitmap = (FT_BitmapGlyph) p_glyph;
+    p_bitmap->left += FT_FLOOR( p_pen->x );
+    p_bitmap->top  += FT_FLOOR( p_pen->y );
+    FT_Glyph_Get_CBox( p_glyph, ft_glyph_bbox_pixels, p_bbox );
+    return p_glyph;
+}
+
 /**
  * Load the glyphs of a paragraph. When shaping with HarfBuzz the glyph indices
  * have already been determined at this point, as well as the advance values.
@@ -955,6 +1173,12 @@ static int LoadGlyphs( filter_t *p_filter, paragraph_t *p_paragraph,
         else
             p_face = p_run->p_face;
 
+        glyph_key_t key;
+        memset( &key, 0, sizeof( key ) );
+        key.p_face = p_face;
+        key.i_x_scale = p_face->size->metrics.x_scale;
+        key.i_y_scale = p_face->size->metrics.y_scale;
+
         if( p_sys->p_stroker && (p_style->i_style_flags & STYLE_OUTLINE) )
         {
             double f_outline_thickness =
@@ -965,7 +1189,17 @@ static int LoadGlyphs( filter_t *p_filter, paragraph_t *p_paragraph,
                             i_radius,
                             FT_STROKER_LINECAP_ROUND,
                             FT_STROKER_LINEJOIN_ROUND, 0 );
+            key.i_radius = i_radius;
+            key.i_flags |= GLYPH_OUTLINE;
         }
+        if( ( p_style->i_style_flags & STYLE_BOLD )
+              && !( p_face->style_flags & FT_STYLE_FLAG_BOLD ) )
+            key.i_flags |= GLYPH_EMBOLDEN;
+        if( ( p_style->i_style_flags & STYLE_ITALIC )
+              && !( p_face->style_flags & FT_STYLE_FLAG_ITALIC ) )
+            key.i_flags |= GLYPH_OBLIQUE;
+        if( p_style->i_shadow_alpha != STYLE_ALPHA_TRANSPARENT )
+            key.i_flags |= GLYPH_SHADOW;
 
         for( int j = p_run->i_start_offset; j < p_run->i_end_offset; ++j )
         {
@@ -980,9 +1214,7 @@ static int LoadGlyphs( filter_t *p_filter, paragraph_t *p_paragraph,
 
 #define SKIP_GLYPH( p_bitmaps ) \
     { \
-        p_bitmaps->p_glyph = 0; \
-        p_bitmaps->p_outline = 0; \
-        p_bitmaps->p_shadow = 0; \
+        p_bitmaps->p_entry = 0; \
         p_bitmaps->i_x_advance = 0; \
         p_bitmaps->i_y_advance = 0; \
         continue; \
@@ -1017,39 +1249,23 @@ static int LoadGlyphs( filter_t *p_filter, paragraph_t *p_paragraph,
                     SKIP_GLYPH( p_bitmaps )
             }
 
-            if( FT_Load_Glyph( p_face, i_glyph_index,
-                               FT_LOAD_NO_BITMAP | FT_LOAD_DEFAULT )
-             && FT_Load_Glyph( p_face, i_glyph_index, FT_LOAD_DEFAULT ) )
-                SKIP_GLYPH( p_bitmaps )
+            key.i_glyph_index = i_glyph_index;
 
-            if( ( p_style->i_style_flags & STYLE_BOLD )
-                  && !( p_face->style_flags & FT_STYLE_FLAG_BOLD ) )
-                FT_GlyphSlot_Embolden( p_face->glyph );
-            if( ( p_style->i_style_flags & STYLE_ITALIC )
-                  && !( p_face->style_flags & FT_STYLE_FLAG_ITALIC ) )
-                FT_GlyphSlot_Oblique( p_face->glyph );
-
-            if( FT_Get_Glyph( p_face->glyph, &p_bitmaps->p_glyph ) )
+            glyph_entry_t *p_entry = (glyph_entry_t *)
+                TextCacheGet( &p_sys->glyph_cache, &key, sizeof( key ) );
+            if( !p_entry )
+                p_entry = LoadGlyph( p_filter, &key );
+            if( !p_entry )
                 SKIP_GLYPH( p_bitmaps )
 
 #undef SKIP_GLYPH
 
-            if( p_filter->p_sys->p_stroker && (p_style->i_style_flags & STYLE_OUTLINE) )
-            {
-                p_bitmaps->p_outline = p_bitmaps->p_glyph;
-                if( FT_Glyph_StrokeBorder( &p_bitmaps->p_outline,
-                                           p_filter->p_sys->p_stroker, 0, 0 ) )
-                    p_bitmaps->p_outline = 0;
-            }
-
-            if( p_style->i_shadow_alpha != STYLE_ALPHA_TRANSPARENT )
-                p_bitmaps->p_shadow = p_bitmaps->p_outline ?
-                                      p_bitmaps->p_outline : p_bitmaps->p_glyph;
+            p_bitmaps->p_entry = p_entry;
 
             if( b_overwrite_advance )
             {
-                p_bitmaps->i_x_advance = p_face->glyph->advance.x;
-                p_bitmaps->i_y_advance = p_face->glyph->advance.y;
+                p_bitmaps->i_x_advance = p_entry->advance.x;
+                p_bitmaps->i_y_advance = p_entry->advance.y;
             }
         }
 
@@ -1121,7 +1337,7 @@ static int LayoutLine( filter_t *p_filter,
         glyph_bitmaps_t *p_bitmaps =
                 p_paragraph->p_glyph_bitmaps + i_paragraph_index;
 
-        if( !p_bitmaps->p_glyph )
+        if( !p_bitmaps->p_entry )
         {
             --i_line_index;
             continue;
@@ -1150,54 +1366,29 @@ static int LayoutLine( filter_t *p_filter,
             .y = pen_new.y + p_sys->f_shadow_vector_y * ( i_font_size << 6 )
         };
 
-        if( p_bitmaps->p_shadow )
-        {
-            if( FT_Glyph_To_Bitmap( &p_bitmaps->p_shadow, FT_RENDER_MODE_NORMAL,
-                                    &pen_shadow, 0 ) )
-                p_bitmaps->p_shadow = 0;
-            else
-                FT_Glyph_Get_CBox( p_bitmaps->p_shadow, ft_glyph_bbox_pixels,
-                                   &p_bitmaps->shadow_bbox );
-        }
-        if( p_bitmaps->p_glyph )
-        {
-            if( FT_Glyph_To_Bitmap( &p_bitmaps->p_glyph, FT_RENDER_MODE_NORMAL,
-                                    &pen_new, 1 ) )
-            {
-                FT_Done_Glyph( p_bitmaps->p_glyph );
-                if( p_bitmaps->p_outline )
-                    FT_Done_Glyph( p_bitmaps->p_outline );
-                if( p_bitmaps->p_shadow )
-                    FT_Done_Glyph( p_bitmaps->p_shadow );
-                --i_line_index;
-                continue;
-            }
-            else
-                FT_Glyph_Get_CBox( p_bitmaps->p_glyph, ft_glyph_bbox_pixels,
-                                   &p_bitmaps->glyph_bbox );
-        }
-        if( p_bitmaps->p_outline )
+        const glyph_render_t *p_render =
+            GetGlyphRender( p_filter, p_bitmaps->p_entry, &pen_new, &pen_shadow );
+        FT_Glyph p_glyph = p_render ? CopyGlyph( p_render->p_glyph, &pen_new,
+                                                 &p_bitmaps->glyph_bbox ) : NULL;
+        if( !p_glyph )
         {
-            if( FT_Glyph_To_Bitmap( &p_bitmaps->p_outline, FT_RENDER_MODE_NORMAL,
-                                    &pen_new, 1 ) )
-            {
-                FT_Done_Glyph( p_bitmaps->p_outline );
-                p_bitmaps->p_outline = 0;
-            }
-            else
-                FT_Glyph_Get_CBox( p_bitmaps->p_outline, ft_glyph_bbox_pixels,
-                                   &p_bitmaps->outline_bbox );
+            --i_line_index;
+            continue;
         }
+        FT_Glyph p_outline = CopyGlyph( p_render->p_outline, &pen_new,
+                                        &p_bitmaps->outline_bbox );
+        FT_Glyph p_shadow = CopyGlyph( p_render->p_shadow, &pen_shadow,
+                                       &p_bitmaps->shadow_bbox );
 
-        FixGlyph( p_bitmaps->p_glyph, &p_bitmaps->glyph_bbox,
+        FixGlyph( p_glyph, &p_bitmaps->glyph_bbox,
                   p_bitmaps->i_x_advance, p_bitmaps->i_y_advance,
                   &pen_new );
-        if( p_bitmaps->p_outline )
-            FixGlyph( p_bitmaps->p_outline, &p_bitmaps->outline_bbox,
+        if( p_outline )
+            FixGlyph( p_outline, &p_bitmaps->outline_bbox,
                       p_bitmaps->i_x_advance, p_bitmaps->i_y_advance,
                       &pen_new );
-        if( p_bitmaps->p_shadow )
-            FixGlyph( p_bitmaps->p_shadow, &p_bitmaps->shadow_bbox,
+        if( p_shadow )
+            FixGlyph( p_shadow, &p_bitmaps->shadow_bbox,
                       p_bitmaps->i_x_advance, p_bitmaps->i_y_advance,
                       &pen_shadow );
 
@@ -1243,18 +1434,18 @@ static int LayoutLine( filter_t *p_filter,
             }
         }
 
-        p_ch->p_glyph = ( FT_BitmapGlyph ) p_bitmaps->p_glyph;
-        p_ch->p_outline = ( FT_BitmapGlyph ) p_bitmaps->p_outline;
-        p_ch->p_shadow = ( FT_BitmapGlyph ) p_bitmaps->p_shadow;
+        p_ch->p_glyph = ( FT_BitmapGlyph ) p_glyph;
+        p_ch->p_outline = ( FT_BitmapGlyph ) p_outline;
+        p_ch->p_shadow = ( FT_BitmapGlyph ) p_shadow;
         p_ch->b_in_karaoke = (p_paragraph->pi_karaoke_bar[ i_paragraph_index ] != 0);
 
         p_ch->i_line_thickness = i_line_thickness;
         p_ch->i_line_offset = i_line_offset;
 
         BBoxEnlarge( &p_line->bbox, &p_bitmaps->glyph_bbox );
-        if( p_bitmaps->p_outline )
+        if( p_outline )
             BBoxEnlarge( &p_line->bbox, &p_bitmaps->outline_bbox );
-        if( p_bitmaps->p_shadow )
+        if( p_shadow )
             BBoxEnlarge( &p_line->bbox, &p_bitmaps->shadow_bbox );
 
         pen.x += p_bitmaps->i_x_advance;
@@ -1302,14 +1493,6 @@ static int LayoutLine( filter_t *p_filter,
     return VLC_SUCCESS;
 }
 
-static inline void ReleaseGlyphBitMaps(glyph_bitmaps_t *p_bitmaps)
-{
-    if( p_bitmaps->p_glyph )
-        FT_Done_Glyph( p_bitmaps->p_glyph );
-    if( p_bitmaps->p_outline )
-        FT_Done_Glyph( p_bitmaps->p_outline );
-}
-
 static inline bool IsWhitespaceAt( paragraph_t *p_paragraph, size_t i )
 {
     return ( p_paragraph->p_code_points[ i ] == ' '
@@ -1366,11 +1549,7 @@ static int LayoutParagraph( filter_t *p_filter, paragraph_t *p_paragraph,
     i_last_space = -1;
 
     if( i_total_width == 0 )
-    {
-        for( int i=0; i < p_paragraph->i_size; ++i )
-            ReleaseGlyphBitMaps( &p_paragraph->p_glyph_bitmaps[ i ] );
         return VLC_SUCCESS;
-    }
 
     if( b_balance )
     {
@@ -1394,12 +1573,7 @@ static int LayoutParagraph( filter_t *p_filter, paragraph_t *p_paragraph,
         {
             if( i_line_start == i )
             {
-                /*
-                 * Free orphaned white space glyphs not belonging to any lines.
-                 * At this point p_shadow points to either p_glyph or p_outline,
-                 * so we should not free it explicitly.
-                 */
-                ReleaseGlyphBitMaps( &p_paragraph->p_glyph_bitmaps[ i ] );
+                /* Skip white space not belonging to any lines */
                 i_line_start = i + 1;
                 continue;
             }
@@ -1427,8 +1601,6 @@ static int LayoutParagraph( filter_t *p_filter, paragraph_t *p_paragraph,
                 /* If wrapping, algorithm would not end shifting lines down.
                  *  Not wrapping, that can't be rendered anymore. */
                 msg_Dbg( p_filter, "LayoutParagraph(): First glyph width in line exceeds maximum, skipping" );
-                for( ; i < p_paragraph->i_size; ++i )
-                    ReleaseGlyphBitMaps( &p_paragraph->p_glyph_bitmaps[ i ] );
                 return VLC_SUCCESS;
             }
 
@@ -1445,11 +1617,7 @@ static int LayoutParagraph( filter_t *p_filter, paragraph_t *p_paragraph,
             /* Handle early end of renderable content;
                We're over size and we can't break space */
             if( p_run->p_style->e_wrapinfo == STYLE_WRAP_NONE )
-            {
-                for( ; i < p_paragraph->i_size; ++i )
-                    ReleaseGlyphBitMaps( &p_paragraph->p_glyph_bitmaps[ i ] );
                 break;
-            }
 
             pp_line = &( *pp_line )->p_next;
 
@@ -1477,13 +1645,265 @@ static int LayoutParagraph( filter_t *p_filter, paragraph_t *p_paragraph,
     return VLC_SUCCESS;
 
 error:
-    for( int i = i_line_start; i < p_paragraph->i_size; ++i )
-        ReleaseGlyphBitMaps( &p_paragraph->p_glyph_bitmaps[ i ] );
     if( p_first_line )
         FreeLines( p_first_line );
     return VLC_EGENERIC;
 }
 
+/**
+ * Line cache entry: the lines of a laid out paragraph
+ */
+typedef struct
+{
+    text_cache_entry_t  cache;
+    char               *p_key;
+    line_desc_t        *p_lines;
+    int                *pi_styles;  /**< Paragraph index of the style of each
+                                         laid out character */
+    unsigned            i_max_advance_x;
+} line_entry_t;
+
+static void ReleaseLineEntry( text_cache_entry_t *p_cache_entry )
+{
+    line_entry_t *p_entry = (line_entry_t *) p_cache_entry;
+
+    if( p_entry->p_lines )
+        FreeLines( p_entry->p_lines );
+    free( p_entry->pi_styles );
+    free( p_entry->p_key );
+    free( p_entry );
+}
+
+/**
+ * Index of the first character of the paragraph using the same style
+ */
+static int StyleIndex( text_style_t * const *pp_styles, int i_len,
+                       const text_style_t *p_style, int i_hint )
+{
+    if( i_hint < i_len && pp_styles[ i_hint ] == p_style )
+        return i_hint;
+    for( int i = 0; i < i_len; ++i )
+        if( pp_styles[ i ] == p_style )
+            return i;
+    return -1;
+}
+
+/**
+ * Build the line cache key of a paragraph. It holds everything the layout
+ * depends on, except the style properties only used for drawing.
+ */
+static int LineCacheKey( filter_t *p_filter, struct vlc_memstream *p_key,
+                         const uni_char_t *p_text, text_style_t **pp_styles,
+                         int i_len, unsigned i_max_width,
+                         bool b_grid, bool b_balance )
+{
+    const int64_t pi_vars[] = {
+        var_InheritInteger( p_filter, "freetype-outline-thickness" ),
+#ifdef HAVE_FRIBIDI
+        var_InheritInteger( p_filter, "freetype-text-direction" ),
+#endif
+    };
+    const uint8_t pi_flags[] = { b_grid, b_balance };
+
+    if( vlc_memstream_open( p_key ) )
+        return VLC_ENOMEM;
+
+    vlc_memstream_write( p_key, pi_vars, sizeof( pi_vars ) );
+    vlc_memstream_write( p_key, &i_max_width, sizeof( i_max_width ) );
+    vlc_memstream_write( p_key, pi_flags, sizeof( pi_flags ) );
+    vlc_memstream_write( p_key, &i_len, sizeof( i_len ) );
+
+    int i_style = 0;
+    for( int i = 0; i < i_len; ++i )
+    {
+        const text_style_t *p_style = pp_styles[ i ];
+
+        /* Styles are referred to by the index of their first character, so
+         * that cached lines can be bound to the styles of another text */
+        i_style = StyleIndex( pp_styles, i_len, p_style, i_style );
+        vlc_memstream_write( p_key, &p_text[ i ], sizeof( p_text[ i ] ) );
+        vlc_memstream_write( p_key, &i_style, sizeof( i_style ) );
+
+        if( i_style == i )
+        {
+            const char *psz_fontname = p_style->i_style_flags & STYLE_MONOSPACED
+                                     ? p_style->psz_monofontname
+                                     : p_style->psz_fontname;
+            const int pi_style[] = {
+                p_style->i_style_flags,
+                ConvertToLiveSize( p_filter, p_style ),
+                p_style->i_shadow_alpha != STYLE_ALPHA_TRANSPARENT,
+                p_style->e_wrapinfo,
+            };
+
+            vlc_memstream_write( p_key, pi_style, sizeof( pi_style ) );
+            vlc_memstream_write( p_key, psz_fontname ? psz_fontname : "",
+                                 psz_fontname ? strlen( psz_fontname ) + 1 : 1 );
+        }
+    }
+
+    return vlc_memstream_close( p_key ) ? VLC_ENOMEM : VLC_SUCCESS;
+}
+
+/**
+ * Deep copy lines. If pp_styles is not NULL, the characters are bound to
+ * the styles of pp_styles given by pi_styles.
+ * On error, the lines copied so far are left in *pp_dst.
+ */
+static int CopyLines( const line_desc_t *p_src, line_desc_t **pp_dst,
+                      text_style_t **pp_styles, const int *pi_styles )
+{
+    for( ; p_src; p_src = p_src->p_next )
+    {
+        line_desc_t *p_line = NewLine( __MAX( p_src->i_character_count, 1 ) );
+        if( !p_line )
+            return VLC_ENOMEM;
+
+        line_character_t *p_characters = p_line->p_character;
+        *p_line = *p_src;
+        p_line->p_next = NULL;
+        p_line->p_character = p_characters;
+        p_line->i_character_count = 0;
+        *pp_dst = p_line;
+        pp_dst = &p_line->p_next;
+
+        for( int i = 0; i < p_src->i_character_count; ++i )
+        {
+            const line_character_t *p_ch = &p_src->p_character[ i ];
+            line_character_t *p_copy = &p_characters[ i ];
+
+            *p_copy = *p_ch;
+            p_copy->p_outline = p_copy->p_shadow = NULL;
+            if( FT_Glyph_Copy( (FT_Glyph) p_ch->p_glyph,
+                               (FT_Glyph *) &p_copy->p_glyph ) )
+                return VLC_ENOMEM;
+            p_line->i_character_count++;
+
+            if( p_ch->p_outline
+             && FT_Glyph_Copy( (FT_Glyph) p_ch->p_outline,
+                               (FT_Glyph *) &p_copy->p_outline ) )
+                return VLC_ENOMEM;
+            if( p_ch->p_shadow
+             && FT_Glyph_Copy( (FT_Glyph) p_ch->p_shadow,
+                               (FT_Glyph *) &p_copy->p_shadow ) )
+                return VLC_ENOMEM;
+
+            if( pp_styles )
+                p_copy->p_style = pp_styles[ *pi_styles++ ];
+        }
+    }
+    return VLC_SUCCESS;
+}
+
+/**
+ * Add the lines of a paragraph to the line cache. Takes ownership of the key.
+ */
+static void AddLineEntry( filter_t *p_filter, char *p_key, size_t i_key,
+                          const line_desc_t *p_lines,
+                          text_style_t **pp_styles, int i_len,
+                          unsigned i_max_advance_x )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+    line_entry_t *p_entry = calloc( 1, sizeof( *p_entry ) );
+    size_t i_bytes = sizeof( *p_entry ) + i_key;
+    int i_characters = 0;
+
+    if( unlikely( !p_entry ) )
+        goto error;
+
+    for( const line_desc_t *p_line = p_lines; p_line; p_line = p_line->p_next )
+        i_characters += p_line->i_character_count;
+
+    p_entry->p_key = p_key;
+    p_entry->i_max_advance_x = i_max_advance_x;
+    p_entry->pi_styles = malloc( __MAX( i_characters, 1 ) * sizeof( int ) );
+    if( unlikely( !p_entry->pi_styles )
+     || CopyLines( p_lines, &p_entry->p_lines, NULL, NULL ) )
+        goto error;
+
+    int i_character = 0, i_style = 0;
+    for( const line_desc_t *p_line = p_lines; p_line; p_line = p_line->p_next )
+    {
+        i_bytes += sizeof( *p_line )
+                 + p_line->i_character_count * sizeof( *p_line->p_character );
+        for( int i = 0; i < p_line->i_character_count; ++i )
+        {
+            const line_character_t *p_ch = &p_line->p_character[ i ];
+
+            i_style = StyleIndex( pp_styles, i_len, p_ch->p_style, i_style );
+            if( i_style < 0 )
+                goto error;
+            p_entry->pi_styles[ i_character++ ] = i_style;
+            i_bytes += GlyphSize( (FT_Glyph) p_ch->p_glyph )
+                     + GlyphSize( (FT_Glyph) p_ch->p_outline )
+                     + GlyphSize( (FT_Glyph) p_ch->p_shadow );
+        }
+    }
+
+    TextCacheAdd( &p_sys->line_cache, &p_entry->cache, p_key, i_key, i_bytes );
+    return;
+
+error:
+    if( p_entry )
+        ReleaseLineEntry( &p_entry->cache );
+    else
+        free( p_key );
+}
+
+static int LayoutNewParagraph( filter_t *p_filter,
+                               const uni_char_t *psz_text,
+                               text_style_t **pp_styles, uint32_t *pi_k_dates,
+                               int i_len, bool b_grid, bool b_balance,
+                               unsigned i_max_width, unsigned *pi_max_advance_x,
+                               line_desc_t **pp_line )
+{
+    paragraph_t *p_paragraph = NewParagraph( p_filter, i_len, psz_text,
+                                             pp_styles, pi_k_dates, 20 );
+    if( !p_paragraph )
+        return VLC_ENOMEM;
+
+#ifdef HAVE_FRIBIDI
+    if( AnalyzeParagraph( p_paragraph ) )
+        goto error;
+#endif
+
+    if( ItemizeParagraph( p_filter, p_paragraph ) )
+        goto error;
+
+#if defined HAVE_HARFBUZZ
+    if( ShapeParagraphHarfBuzz( p_filter, &p_paragraph ) )
+        goto error;
+
+    if( LoadGlyphs( p_filter, p_paragraph, true, false, pi_max_advance_x ) )
+        goto error;
+
+#elif defined HAVE_FRIBIDI
+    if( ShapeParagraphFriBidi( p_filter, p_paragraph ) )
+        goto error;
+    if( LoadGlyphs( p_filter, p_paragraph, false, true, pi_max_advance_x ) )
+        goto error;
+    if( RemoveZeroWidthCharacters( p_paragraph ) )
+        goto error;
+    if( ZeroNsmAdvance( p_paragraph ) )
+        goto error;
+#else
+    if( LoadGlyphs( p_filter, p_paragraph, false, true, pi_max_advance_x ) )
+        goto error;
+#endif
+
+    if( LayoutParagraph( p_filter, p_paragraph,
+                         i_max_width, *pi_max_advance_x, pp_line,
+                         b_grid, b_balance ) )
+        goto error;
+
+    FreeParagraph( p_paragraph );
+    return VLC_SUCCESS;
+
+error:
+    FreeParagraph( p_paragraph );
+    return VLC_EGENERIC;
+}
+
 int LayoutText( filter_t *p_filter,
                 const uni_char_t *psz_text, text_style_t **pp_styles,
                 uint32_t *pi_k_dates, int i_len,
@@ -1491,13 +1911,17 @@ int LayoutText( filter_t *p_filter,
                 unsigned i_max_width, unsigned i_max_height,
                 line_desc_t **pp_lines, FT_BBox *p_bbox, int *pi_max_face_height )
 {
+    filter_sys_t *p_sys = p_filter->p_sys;
     line_desc_t *p_first_line = 0;
     line_desc_t **pp_line = &p_first_line;
-    paragraph_t *p_paragraph = 0;
     int i_paragraph_start = 0;
     unsigned i_total_height = 0;
     unsigned i_max_advance_x = 0;
     int i_max_face_height = 0;
+    int i_ret;
+
+    /* Karaoke lines depend on the timestamps, do not cache them */
+    const bool b_cache = !pi_k_dates && p_sys->line_cache.i_max_bytes > 0;
 
     for( int i = 0; i <= i_len; ++i )
     {
@@ -1509,55 +1933,54 @@ int LayoutText( filter_t *p_filter,
                 continue;
             }
 
-            p_paragraph = NewParagraph( p_filter, i - i_paragraph_start,
-                                        psz_text + i_paragraph_start,
-                                        pp_styles + i_paragraph_start,
-                                        pi_k_dates ?
-                                        pi_k_dates + i_paragraph_start : 0,
-                                        20 );
-            if( !p_paragraph )
+            const int i_size = i - i_paragraph_start;
+            text_style_t **pp_paragraph_styles = pp_styles + i_paragraph_start;
+            struct vlc_memstream key;
+            line_entry_t *p_entry = NULL;
+
+            if( b_cache
+             && LineCacheKey( p_filter, &key, psz_text + i_paragraph_start,
+                              pp_paragraph_styles, i_size, i_max_width,
+                              b_grid, b_balance ) == VLC_SUCCESS )
             {
-                if( p_first_line ) FreeLines( p_first_line );
-                return VLC_ENOMEM;
+                p_entry = (line_entry_t *)
+                    TextCacheGet( &p_sys->line_cache, key.ptr, key.length );
+                if( p_entry )
+                    free( key.ptr );
             }
+            else
+                key.ptr = NULL;
 
-#ifdef HAVE_FRIBIDI
-            if( AnalyzeParagraph( p_paragraph ) )
-                goto error;
-#endif
-
-            if( ItemizeParagraph( p_filter, p_paragraph ) )
-                goto error;
-
-#if defined HAVE_HARFBUZZ
-            if( ShapeParagraphHarfBuzz( p_filter, &p_paragraph ) )
-                goto error;
-
-            if( LoadGlyphs( p_filter, p_paragraph, true, false, &i_max_advance_x ) )
-                goto error;
-
-#elif defined HAVE_FRIBIDI
-            if( ShapeParagraphFriBidi( p_filter, p_paragraph ) )
-                goto error;
-            if( LoadGlyphs( p_filter, p_paragraph, false, true, &i_max_advance_x ) )
-                goto error;
-            if( RemoveZeroWidthCharacters( p_paragraph ) )
-                goto error;
-            if( ZeroNsmAdvance( p_paragraph ) )
-                goto error;
-#else
-            if( LoadGlyphs( p_filter, p_paragraph, false, true, &i_max_advance_x ) )
-                goto error;
-#endif
-
-            if( LayoutParagraph( p_filter, p_paragraph,
-                                 i_max_width, i_max_advance_x, pp_line,
-                                 b_grid, b_balance ) )
+            if( p_entry )
+            {
+                i_ret = CopyLines( p_entry->p_lines, pp_line,
+                                   pp_paragraph_styles, p_entry->pi_styles );
+                i_max_advance_x = __MAX( i_max_advance_x,
+                                         p_entry->i_max_advance_x );
+            }
+            else
+            {
+                unsigned i_paragraph_advance_x = 0;
+
+                i_ret = LayoutNewParagraph( p_filter,
+                                    psz_text + i_paragraph_start,
+                                    pp_paragraph_styles,
+                                    pi_k_dates ?
+                                    pi_k_dates + i_paragraph_start : 0,
+                                    i_size, b_grid, b_balance, i_max_width,
+                                    &i_paragraph_advance_x, pp_line );
+                if( i_ret == VLC_SUCCESS && key.ptr )
+                    AddLineEntry( p_filter, key.ptr, key.length, *pp_line,
+                                  pp_paragraph_styles, i_size,
+                                  i_paragraph_advance_x );
+                else
+                    free( key.ptr );
+                i_max_advance_x = __MAX( i_max_advance_x,
+                                         i_paragraph_advance_x );
+            }
+            if( i_ret )
                 goto error;
 
-            FreeParagraph( p_paragraph );
-            p_paragraph = 0;
-
             for( ; *pp_line; pp_line = &(*pp_line)->p_next )
             {
                 i_total_height += (*pp_line)->i_height;
@@ -1605,11 +2028,40 @@ int LayoutText( filter_t *p_filter,
     *pi_max_face_height = i_max_face_height;
     *pp_lines = p_first_line;
     *p_bbox = bbox;
+
+    TextCacheTrim( &p_sys->glyph_cache );
+    TextCacheTrim( &p_sys->line_cache );
     return VLC_SUCCESS;
 
 error:
     if( p_first_line ) FreeLines( p_first_line );
-    if( p_paragraph ) FreeParagraph( p_paragraph );
-    return VLC_EGENERIC;
+    TextCacheTrim( &p_sys->glyph_cache );
+    TextCacheTrim( &p_sys->line_cache );
+    return i_ret;
+}
+
+void LayoutCachesInit( filter_t *p_filter, size_t i_max_bytes )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    /* Cached lines hold copies of the glyph bitmaps, split evenly */
+    TextCacheInit( &p_sys->glyph_cache, i_max_bytes / 2, ReleaseGlyphEntry );
+    TextCacheInit( &p_sys->line_cache, i_max_bytes / 2, ReleaseLineEntry );
+}
+
+void LayoutCachesClean( filter_t *p_filter )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    msg_Dbg( p_filter, "glyph cache: %"PRIu64" hits, %"PRIu64" misses, "
+             "%"PRIu64" evictions", p_sys->glyph_cache.i_hits,
+             p_sys->glyph_cache.i_misses, p_sys->glyph_cache.i_evictions );
+    msg_Dbg( p_filter, "line cache: %"PRIu64" hits, %"PRIu64" misses, "
+             "%"PRIu64" evictions", p_sys->line_cache.i_hits,
+             p_sys->line_cache.i_misses, p_sys->line_cache.i_evictions );
+
+    /* Glyphs refer to faces: must be cleaned before the faces are released */
+    TextCacheClean( &p_sys->glyph_cache );
+    TextCacheClean( &p_sys->line_cache );
 }
 
@@ -83,3 +83,17 @@ int LayoutText( filter_t *p_filter,
                 uint32_t *pi_k_dates, int i_len, bool b_grid, bool b_balance,
                 unsigned i_max_width, unsigned i_max_height,
                 line_desc_t **pp_lines, FT_BBox *p_bbox, int *pi_max_face_height );
+
+/**
+ * Initialize the glyph and line caches used by LayoutText().
+ *
+ * \param p_filter the FreeType module object [IN]
+ * \param i_max_bytes memory budget shared by the caches [IN]
+ */
+void LayoutCachesInit( filter_t *p_filter, size_t i_max_bytes );
+
+/**
+ * Release the glyph and line caches, and report their statistics.
+ * Must be called before the font faces are released.
+ */
+void LayoutCachesClean( filter_t *p_filter );
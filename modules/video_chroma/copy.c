@@ -33,6 +33,10 @@
 
 #include "copy.h"
 
+#ifdef HAVE_AVX2_INTRINSICS
+# include <immintrin.h>
+#endif
+
 int CopyInitCache(copy_cache_t *cache, unsigned width)
 {
 #ifdef CAN_COMPILE_SSE2
@@ -94,6 +98,220 @@ void CopyCleanCache(copy_cache_t *cache)
 # define vlc_CPU_SSE2() ((cpu & VLC_CPU_SSE2) != 0)
 #endif
 
+#ifdef HAVE_AVX2_INTRINSICS
+# ifndef __AVX2__
+#  undef vlc_CPU_AVX2
+#  define vlc_CPU_AVX2() ((cpu & VLC_CPU_AVX2) != 0)
+# endif
+
+/* AVX2 variants of the line kernels below. They move 32 bytes per
+ * instruction and expect the cache lines to be 32 bytes aligned. */
+VLC_AVX2
+static void AVX2_CopyFromUswc(uint8_t *dst, size_t dst_pitch,
+                              const uint8_t *src, size_t src_pitch,
+                              unsigned width, unsigned height)
+{
+    assert(((intptr_t)dst & 0x1f) == 0 && (dst_pitch & 0x1f) == 0);
+
+    _mm_mfence();
+
+    for (unsigned y = 0; y < height; y++) {
+        const unsigned unaligned = (-(uintptr_t)src) & 0x1f;
+        unsigned x = 0;
+
+        if (width >= 32) {
+            if (unaligned)
+                _mm256_store_si256((__m256i *)dst,
+                                   _mm256_loadu_si256((const __m256i *)src));
+            x = unaligned;
+
+            for (; x+127 < width; x += 128) {
+                __m256i *s = (__m256i *)&src[x];
+                __m256i y0 = _mm256_stream_load_si256(s + 0);
+                __m256i y1 = _mm256_stream_load_si256(s + 1);
+                __m256i y2 = _mm256_stream_load_si256(s + 2);
+                __m256i y3 = _mm256_stream_load_si256(s + 3);
+                __m256i *d = (__m256i *)&dst[x];
+                _mm256_storeu_si256(d + 0, y0);
+                _mm256_storeu_si256(d + 1, y1);
+                _mm256_storeu_si256(d + 2, y2);
+                _mm256_storeu_si256(d + 3, y3);
+            }
+        }
+
+        for (; x < width; x++)
+            dst[x] = src[x];
+
+        src += src_pitch;
+        dst += dst_pitch;
+    }
+
+    _mm_mfence();
+}
+
+VLC_AVX2
+static void AVX2_Copy2d(uint8_t *dst, size_t dst_pitch,
+                        const uint8_t *src, size_t src_pitch,
+                        unsigned width, unsigned height)
+{
+    assert(((intptr_t)src & 0x1f) == 0 && (src_pitch & 0x1f) == 0);
+
+    for (unsigned y = 0; y < height; y++) {
+        const __m256i *s = (const __m256i *)src;
+        unsigned x = 0;
+
+        if (((intptr_t)dst & 0x1f) == 0) {
+            for (; x+127 < width; x += 128, s += 4) {
+                __m256i *d = (__m256i *)&dst[x];
+                _mm256_stream_si256(d + 0, _mm256_load_si256(s + 0));
+                _mm256_stream_si256(d + 1, _mm256_load_si256(s + 1));
+                _mm256_stream_si256(d + 2, _mm256_load_si256(s + 2));
+                _mm256_stream_si256(d + 3, _mm256_load_si256(s + 3));
+            }
+        } else {
+            for (; x+127 < width; x += 128, s += 4) {
+                __m256i *d = (__m256i *)&dst[x];
+                _mm256_storeu_si256(d + 0, _mm256_load_si256(s + 0));
+                _mm256_storeu_si256(d + 1, _mm256_load_si256(s + 1));
+                _mm256_storeu_si256(d + 2, _mm256_load_si256(s + 2));
+                _mm256_storeu_si256(d + 3, _mm256_load_si256(s + 3));
+            }
+        }
+
+        for (; x < width; x++)
+            dst[x] = src[x];
+
+        src += src_pitch;
+        dst += dst_pitch;
+    }
+
+    /* Order the non-temporal stores before the picture is used */
+    _mm_sfence();
+}
+
+VLC_AVX2
+static void AVX2_InterleaveUV(uint8_t *dst, size_t dst_pitch,
+                              const uint8_t *srcu, size_t srcu_pitch,
+                              const uint8_t *srcv, size_t srcv_pitch,
+                              unsigned width, unsigned height)
+{
+    for (unsigned y = 0; y < height; y++) {
+        unsigned x = 0;
+
+        for (; x+31 < width; x += 32) {
+            const __m256i u = _mm256_loadu_si256((const __m256i *)&srcu[x]);
+            const __m256i v = _mm256_loadu_si256((const __m256i *)&srcv[x]);
+            /* Interleaving works within 128-bits lanes */
+            const __m256i lo = _mm256_unpacklo_epi8(u, v);
+            const __m256i hi = _mm256_unpackhi_epi8(u, v);
+
+            _mm256_storeu_si256((__m256i *)&dst[2*x],
+                                _mm256_permute2x128_si256(lo, hi, 0x20));
+            _mm256_storeu_si256((__m256i *)&dst[2*x+32],
+                                _mm256_permute2x128_si256(lo, hi, 0x31));
+        }
+
+        for (; x < width; x++) {
+            dst[2*x+0] = srcu[x];
+            dst[2*x+1] = srcv[x];
+        }
+        srcu += srcu_pitch;
+        srcv += srcv_pitch;
+        dst += dst_pitch;
+    }
+}
+
+VLC_AVX2
+static void AVX2_SplitUV(uint8_t *dstu, size_t dstu_pitch,
+                         uint8_t *dstv, size_t dstv_pitch,
+                         const uint8_t *src, size_t src_pitch,
+                         unsigned width, unsigned height)
+{
+    const __m256i shuffle = _mm256_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14,
+                                             1, 3, 5, 7, 9, 11, 13, 15,
+                                             0, 2, 4, 6, 8, 10, 12, 14,
+                                             1, 3, 5, 7, 9, 11, 13, 15);
+
+    assert(((intptr_t)src & 0x1f) == 0 && (src_pitch & 0x1f) == 0);
+
+    for (unsigned y = 0; y < height; y++) {
+        unsigned x = 0;
+
+        for (; x+31 < width; x += 32) {
+            __m256i a = _mm256_load_si256((const __m256i *)&src[2*x]);
+            __m256i b = _mm256_load_si256((const __m256i *)&src[2*x+32]);
+
+            /* U and V halves of each lane, then U and V halves of each
+             * register */
+            a = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(a, shuffle),
+                                         _MM_SHUFFLE(3, 1, 2, 0));
+            b = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(b, shuffle),
+                                         _MM_SHUFFLE(3, 1, 2, 0));
+            _mm256_storeu_si256((__m256i *)&dstu[x],
+                                _mm256_permute2x128_si256(a, b, 0x20));
+            _mm256_storeu_si256((__m256i *)&dstv[x],
+                                _mm256_permute2x128_si256(a, b, 0x31));
+        }
+
+        for (; x < width; x++) {
+            dstu[x] = src[2*x+0];
+            dstv[x] = src[2*x+1];
+        }
+        src  += src_pitch;
+        dstu += dstu_pitch;
+        dstv += dstv_pitch;
+    }
+}
+
+/* 10-bits planar samples to P010: left justified and interleaved chroma */
+VLC_AVX2
+static void AVX2_CopyFromI420_10ToP010(picture_t *dst, uint8_t *src[3],
+                                       size_t src_pitch[3], unsigned height)
+{
+    const unsigned width = src_pitch[0] / 2;
+
+    for (unsigned y = 0; y < height; y++) {
+        const uint16_t *srcY = (const uint16_t *)&src[Y_PLANE][y * src_pitch[Y_PLANE]];
+        uint16_t *dstY = (uint16_t *)&dst->p[0].p_pixels[y * dst->p[0].i_pitch];
+        unsigned x = 0;
+
+        for (; x+15 < width; x += 16) {
+            const __m256i v = _mm256_loadu_si256((const __m256i *)&srcY[x]);
+            _mm256_storeu_si256((__m256i *)&dstY[x], _mm256_slli_epi16(v, 6));
+        }
+        for (; x < width; x++)
+            dstY[x] = srcY[x] << 6;
+    }
+
+    const unsigned chroma_width = src_pitch[1] / 2;
+
+    for (unsigned y = 0; y < height / 2; y++) {
+        const uint16_t *srcU = (const uint16_t *)&src[U_PLANE][y * src_pitch[U_PLANE]];
+        const uint16_t *srcV = (const uint16_t *)&src[V_PLANE][y * src_pitch[V_PLANE]];
+        uint16_t *dstUV = (uint16_t *)&dst->p[1].p_pixels[y * dst->p[1].i_pitch];
+        unsigned x = 0;
+
+        for (; x+15 < chroma_width; x += 16) {
+            const __m256i u = _mm256_slli_epi16(
+                _mm256_loadu_si256((const __m256i *)&srcU[x]), 6);
+            const __m256i v = _mm256_slli_epi16(
+                _mm256_loadu_si256((const __m256i *)&srcV[x]), 6);
+            const __m256i lo = _mm256_unpacklo_epi16(u, v);
+            const __m256i hi = _mm256_unpackhi_epi16(u, v);
+
+            _mm256_storeu_si256((__m256i *)&dstUV[2*x],
+                                _mm256_permute2x128_si256(lo, hi, 0x20));
+            _mm256_storeu_si256((__m256i *)&dstUV[2*x+16],
+                                _mm256_permute2x128_si256(lo, hi, 0x31));
+        }
+        for (; x < chroma_width; x++) {
+            dstUV[2*x+0] = srcU[x] << 6;
+            dstUV[2*x+1] = srcV[x] << 6;
+        }
+    }
+}
+#endif
+
 /* Optimized copy from "Uncacheable Speculative Write Combining" memory
  * as used by some video surface.
  * XXX It is really efficient only when SSE4.1 is available.
@@ -106,6 +324,11 @@ static void CopyFromUswc(uint8_t *dst, size_t dst_pitch,
 {
 #if defined (__SSE4_1__) || !defined(CAN_COMPILE_SSSE3)
     VLC_UNUSED(cpu);
+#endif
+#ifdef HAVE_AVX2_INTRINSICS
+    if (vlc_CPU_AVX2())
+        return AVX2_CopyFromUswc(dst, dst_pitch, src, src_pitch,
+                                 width, height);
 #endif
     assert(((intptr_t)dst & 0x0f) == 0 && (dst_pitch & 0x0f) == 0);
 
@@ -150,8 +373,13 @@ static void CopyFromUswc(uint8_t *dst, size_t dst_pitch,
 VLC_SSE
 static void Copy2d(uint8_t *dst, size_t dst_pitch,
                    const uint8_t *src, size_t src_pitch,
-                   unsigned width, unsigned height)
+                   unsigned width, unsigned height, unsigned cpu)
 {
+    VLC_UNUSED(cpu);
+#ifdef HAVE_AVX2_INTRINSICS
+    if (vlc_CPU_AVX2())
+        return AVX2_Copy2d(dst, dst_pitch, src, src_pitch, width, height);
+#endif
     assert(((intptr_t)src & 0x0f) == 0 && (src_pitch & 0x0f) == 0);
 
     for (unsigned y = 0; y < height; y++) {
@@ -188,6 +416,11 @@ SSE_InterleaveUV(uint8_t *dst, size_t dst_pitch,
 #if defined(__SSSE3__) || !defined (CAN_COMPILE_SSSE3)
     VLC_UNUSED(cpu);
 #endif
+#ifdef HAVE_AVX2_INTRINSICS
+    if (vlc_CPU_AVX2())
+        return AVX2_InterleaveUV(dst, dst_pitch, srcu, srcu_pitch,
+                                 srcv, srcv_pitch, width, height);
+#endif
 
     uint8_t const       shuffle[] = { 0, 8,
                                       1, 9,
@@ -286,6 +519,11 @@ static void SSE_SplitUV(uint8_t *dstu, size_t dstu_pitch,
 {
 #if defined(__SSSE3__) || !defined (CAN_COMPILE_SSSE3)
     VLC_UNUSED(cpu);
+#endif
+#ifdef HAVE_AVX2_INTRINSICS
+    if (vlc_CPU_AVX2())
+        return AVX2_SplitUV(dstu, dstu_pitch, dstv, dstv_pitch,
+                            src, src_pitch, width, height);
 #endif
     const uint8_t shuffle[] = { 0, 2, 4, 6, 8, 10, 12, 14,
                                 1, 3, 5, 7, 9, 11, 13, 15 };
@@ -371,8 +609,8 @@ static void SSE_CopyPlane(uint8_t *dst, size_t dst_pitch,
                           uint8_t *cache, size_t cache_size,
                           unsigned height, unsigned cpu)
 {
-    const unsigned w16 = (src_pitch+15) & ~15;
-    const unsigned hstep = cache_size / w16;
+    const unsigned w32 = (src_pitch+31) & ~31;
+    const unsigned hstep = cache_size / w32;
     assert(hstep > 0);
 
     if (src_pitch == dst_pitch)
@@ -382,14 +620,14 @@ static void SSE_CopyPlane(uint8_t *dst, size_t dst_pitch,
         const unsigned hblock =  __MIN(hstep, height - y);
 
         /* Copy a bunch of line into our cache */
-        CopyFromUswc(cache, w16,
+        CopyFromUswc(cache, w32,
                      src, src_pitch,
                      src_pitch, hblock, cpu);
 
         /* Copy from our cache to the destination */
         Copy2d(dst, dst_pitch,
-               cache, w16,
-               src_pitch, hblock);
+               cache, w32,
+               src_pitch, hblock, cpu);
 
         /* */
         src += src_pitch * hblock;
@@ -406,8 +644,8 @@ SSE_InterleavePlanes(uint8_t *dst, size_t dst_pitch,
                      unsigned int cpu)
 {
     assert(srcu_pitch == srcv_pitch);
-    unsigned int const  w16 = (srcu_pitch+15) & ~15;
-    unsigned int const  hstep = (cache_size) / (2*w16);
+    unsigned int const  w32 = (srcu_pitch+31) & ~31;
+    unsigned int const  hstep = (cache_size) / (2*w32);
     assert(hstep > 0);
 
     for (unsigned int y = 0; y < height; y += hstep)
@@ -415,14 +653,14 @@ SSE_InterleavePlanes(uint8_t *dst, size_t dst_pitch,
         unsigned int const      hblock = __MIN(hstep, height - y);
 
         /* Copy a bunch of line into our cache */
-        CopyFromUswc(cache, w16, srcu, srcu_pitch,
+        CopyFromUswc(cache, w32, srcu, srcu_pitch,
                      srcu_pitch, hblock, cpu);
-        CopyFromUswc(cache+w16*hblock, w16, srcv, srcv_pitch,
+        CopyFromUswc(cache+w32*hblock, w32, srcv, srcv_pitch,
                      srcv_pitch, hblock, cpu);
 
         /* Copy from our cache to the destination */
-        SSE_InterleaveUV(dst, dst_pitch, cache, w16,
-                         cache+w16*hblock, w16, srcu_pitch, hblock, cpu);
+        SSE_InterleaveUV(dst, dst_pitch, cache, w32,
+                         cache+w32*hblock, w32, srcu_pitch, hblock, cpu);
 
         /* */
         srcu += hblock * srcu_pitch;
@@ -437,20 +675,21 @@ static void SSE_SplitPlanes(uint8_t *dstu, size_t dstu_pitch,
                             uint8_t *cache, size_t cache_size,
                             unsigned height, unsigned cpu)
 {
-    const unsigned w16 = (src_pitch+15) & ~15;
-    const unsigned hstep = cache_size / w16;
+    const unsigned w32 = (src_pitch+31) & ~31;
+    const unsigned hstep = cache_size / w32;
     assert(hstep > 0);
 
     for (unsigned y = 0; y < height; y += hstep) {
         const unsigned hblock =  __MIN(hstep, height - y);
 
         /* Copy a bunch of line into our cache */
-        CopyFromUswc(cache, w16, src, src_pitch,
+        CopyFromUswc(cache, w32, src, src_pitch,
                      src_pitch, hblock, cpu);
 
-        /* Copy from our cache to the destination */
+        /* Copy from our cache to the destination, one U and one V sample
+         * per pair of bytes */
         SSE_SplitUV(dstu, dstu_pitch, dstv, dstv_pitch,
-                    cache, w16, src_pitch, hblock, cpu);
+                    cache, w32, src_pitch / 2, hblock, cpu);
 
         /* */
         src  += src_pitch  * hblock;
@@ -669,6 +908,12 @@ void CopyFromI420_10ToP010(picture_t *dst, uint8_t *src[3], size_t src_pitch[3],
 {
     (void) cache;
 
+#if defined(CAN_COMPILE_SSE2) && defined(HAVE_AVX2_INTRINSICS)
+    unsigned cpu = vlc_CPU();
+    if (vlc_CPU_AVX2())
+        return AVX2_CopyFromI420_10ToP010(dst, src, src_pitch, height);
+#endif
+
     const int i_extra_pitch_dst_y = (dst->p[0].i_pitch  - src_pitch[0]) / 2;
     const int i_extra_pitch_src_y = (src_pitch[Y_PLANE] - src_pitch[0]) / 2;
     uint16_t *dstY = dst->p[0].p_pixels;
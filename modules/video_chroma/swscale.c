@@ -58,6 +58,15 @@ static void CloseScaler( vlc_object_t * );
 #define SCALEMODE_TEXT N_("Scaling mode")
 #define SCALEMODE_LONGTEXT N_("Scaling mode to use.")
 
+#define THREADS_TEXT N_("Threads")
+#define THREADS_LONGTEXT N_("Number of threads used to convert each " \
+                            "picture, in horizontal slices. Only conversions " \
+                            "without vertical scaling are split. " \
+                            "0 uses one thread per CPU core.")
+
+/* Upper bound on the number of slices, and so on the number of threads */
+#define MAX_SLICES 16
+
 static const int pi_mode_values[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 };
 const char *const ppsz_mode_descriptions[] =
 { N_("Fast bilinear"), N_("Bilinear"), N_("Bicubic (good quality)"),
@@ -74,6 +83,8 @@ vlc_module_begin ()
     set_callbacks( OpenScaler, CloseScaler )
     add_integer( "swscale-mode", 2, SCALEMODE_TEXT, SCALEMODE_LONGTEXT, true )
         change_integer_list( pi_mode_values, ppsz_mode_descriptions )
+    add_integer( "swscale-threads", 0, THREADS_TEXT, THREADS_LONGTEXT, true )
+        change_integer_range( 0, MAX_SLICES )
 vlc_module_end ()
 
 /* Version checking */
@@ -82,6 +93,30 @@ vlc_module_end ()
  * Local prototypes
  ****************************************************************************/
 
+/**
+ * Horizontal slice of the pictures, converted by its own contexts.
+ */
+typedef struct
+{
+    struct SwsContext *ctx;
+    struct SwsContext *ctxA;
+    int i_first;      /**< First input line */
+    int i_last;       /**< Last input line (excluded) */
+    int i_out_first;  /**< First output line */
+    int i_out_last;   /**< Last output line (excluded) */
+    int i_top;        /**< Input lines converted above the slice */
+    int i_bottom;     /**< Input lines converted below the slice */
+    picture_t *p_scratch; /**< Output of the slice and of its margins */
+} scaler_slice_t;
+
+typedef struct
+{
+    filter_t *p_filter;
+    unsigned i_slice;
+    unsigned i_job;   /**< Last queued pictures seen */
+    vlc_thread_t thread;
+} scaler_worker_t;
+
 /**
  * Internal swscale filter structure.
  */
@@ -95,8 +130,23 @@ struct filter_sys_t
     const vlc_chroma_description_t *desc_in;
     const vlc_chroma_description_t *desc_out;
 
-    struct SwsContext *ctx;
-    struct SwsContext *ctxA;
+    unsigned i_slices;
+    scaler_slice_t slices[MAX_SLICES];
+
+    /* Worker i converts the slice i + 1, the filter thread the slice 0.
+     * The workers are started with the first sliced conversion. */
+    unsigned i_threads;     /**< Including the filter thread */
+    unsigned i_workers;
+    scaler_worker_t *workers;
+    vlc_mutex_t lock;
+    vlc_cond_t  wait;       /**< Signaled when pictures are queued or on exit */
+    vlc_cond_t  done;       /**< Signaled when the last slice is converted */
+    unsigned    i_job;      /**< Sequence number of the queued pictures */
+    unsigned    i_pending;  /**< Slices not converted yet */
+    bool        b_quit;
+    picture_t  *p_job_dst;
+    picture_t  *p_job_src;
+
     picture_t *p_src_a;
     picture_t *p_dst_a;
     int i_extend_factor;
@@ -111,6 +161,9 @@ struct filter_sys_t
 static picture_t *Filter( filter_t *, picture_t * );
 static int  Init( filter_t * );
 static void Clean( filter_t * );
+static void InitWorkers( filter_t *, unsigned );
+static void StartWorkers( filter_t * );
+static void StopWorkers( filter_t * );
 
 typedef struct
 {
@@ -136,6 +189,13 @@ static int GetSwsCpuMask(void);
 #define ALLOW_YUVP (false)
 /* SwScaler does not like too small picture */
 #define MINIMUM_WIDTH (32)
+/* Smaller slices are not worth the synchronization cost */
+#define SLICE_MIN_LINES (32)
+/* Slices start on the lines of the swscale dither matrices */
+#define SLICE_ALIGN (8)
+/* Lines converted around a slice resampling the chroma vertically, in units
+ * of the chroma subsampling: this covers the longest swscale filters */
+#define SLICE_MARGIN (12)
 
 /* XXX is it always 3 even for BIG_ENDIAN (blend.c seems to think so) ? */
 #define OFFSET_A (3)
@@ -184,8 +244,11 @@ static int OpenScaler( vlc_object_t *p_this )
     memset( &p_sys->fmt_in,  0, sizeof(p_sys->fmt_in) );
     memset( &p_sys->fmt_out, 0, sizeof(p_sys->fmt_out) );
 
+    InitWorkers( p_filter, var_InheritInteger( p_filter, "swscale-threads" ) );
+
     if( Init( p_filter ) )
     {
+        StopWorkers( p_filter );
         if( p_sys->p_filter )
             sws_freeFilter( p_sys->p_filter );
         free( p_sys );
@@ -215,6 +278,7 @@ static void CloseScaler( vlc_object_t *p_this )
     filter_t *p_filter = (filter_t*)p_this;
     filter_sys_t *p_sys = p_filter->p_sys;
 
+    StopWorkers( p_filter );
     Clean( p_filter );
     if( p_sys->p_filter )
         sws_freeFilter( p_sys->p_filter );
@@ -361,7 +425,7 @@ static int Init( filter_t *p_filter )
 
     if( video_format_IsSimilar( p_fmti, &p_sys->fmt_in ) &&
         video_format_IsSimilar( p_fmto, &p_sys->fmt_out ) &&
-        p_sys->ctx )
+        p_sys->i_slices > 0 )
     {
         return VLC_SUCCESS;
     }
@@ -396,22 +460,94 @@ static int Init( filter_t *p_filter )
 
     const unsigned i_fmti_visible_width = p_fmti->i_visible_width * p_sys->i_extend_factor;
     const unsigned i_fmto_visible_width = p_fmto->i_visible_width * p_sys->i_extend_factor;
-    for( int n = 0; n < (cfg.b_has_a ? 2 : 1); n++ )
-    {
-        const int i_fmti = n == 0 ? cfg.i_fmti : AV_PIX_FMT_GRAY8;
-        const int i_fmto = n == 0 ? cfg.i_fmto : AV_PIX_FMT_GRAY8;
-        struct SwsContext *ctx;
-
-        ctx = sws_getContext( i_fmti_visible_width, p_fmti->i_visible_height, i_fmti,
-                              i_fmto_visible_width, p_fmto->i_visible_height, i_fmto,
-                              cfg.i_sws_flags | p_sys->i_cpu_mask,
-                              p_sys->p_filter, NULL, 0 );
-        if( n == 0 )
-            p_sys->ctx = ctx;
+
+    int i_align = 1, i_align_out = 1;
+    for( unsigned i = 0; i < p_sys->desc_in->plane_count; i++ )
+        i_align = __MAX( i_align, (int)p_sys->desc_in->p[i].h.den );
+    for( unsigned i = 0; i < p_sys->desc_out->plane_count; i++ )
+        i_align_out = __MAX( i_align_out, (int)p_sys->desc_out->p[i].h.den );
+
+    /* Without vertical scaling, the lines of each slice can be converted
+     * independently. If the chroma is resampled vertically, its filter also
+     * needs lines beyond the slice edges: each slice then converts margins
+     * around its lines into a scratch picture, and only keeps its own lines.
+     * This gives the same output as a single pass, as long as the chroma
+     * lines split evenly. */
+    const int i_align_max = __MAX( i_align, i_align_out );
+    const bool b_margins = i_align != i_align_out;
+    const int i_slice_align = __MAX( SLICE_ALIGN, i_align_max );
+    unsigned i_slices = 1;
+    if( p_fmti->i_visible_height == p_fmto->i_visible_height &&
+        p_sys->i_extend_factor == 1 &&
+        ( !b_margins || p_fmti->i_visible_height % i_align_max == 0 ) &&
+        p_fmti->i_visible_height / SLICE_MIN_LINES > 1 &&
+        p_sys->i_threads > 1 )
+    {
+        StartWorkers( p_filter );
+        i_slices = __MIN( p_sys->i_workers + 1,
+                          p_fmti->i_visible_height / SLICE_MIN_LINES );
+    }
+
+    bool b_error = false;
+    p_sys->i_slices = i_slices;
+    for( unsigned i = 0; i < i_slices; i++ )
+    {
+        scaler_slice_t *p_slice = &p_sys->slices[i];
+        const int i_units = ( p_fmti->i_visible_height + i_slice_align - 1 ) / i_slice_align;
+
+        p_slice->i_top = p_slice->i_bottom = 0;
+        if( i_slices == 1 )
+        {
+            p_slice->i_first = p_slice->i_out_first = 0;
+            p_slice->i_last = p_fmti->i_visible_height;
+            p_slice->i_out_last = p_fmto->i_visible_height;
+        }
         else
-            p_sys->ctxA = ctx;
+        {
+            p_slice->i_first = i_units * (int)i / (int)i_slices * i_slice_align;
+            p_slice->i_last = __MIN( i_units * (int)( i + 1 ) / (int)i_slices * i_slice_align,
+                                     (int)p_fmti->i_visible_height );
+            p_slice->i_out_first = p_slice->i_first;
+            p_slice->i_out_last = p_slice->i_last;
+
+            if( b_margins )
+            {
+                const int i_margin = SLICE_MARGIN * i_align_max;
+
+                p_slice->i_top = __MIN( i_margin, p_slice->i_first );
+                p_slice->i_bottom = __MIN( i_margin,
+                    (int)p_fmti->i_visible_height - p_slice->i_last );
+                p_slice->p_scratch = picture_New( p_fmto->i_chroma,
+                    i_fmto_visible_width, p_slice->i_last - p_slice->i_first
+                    + p_slice->i_top + p_slice->i_bottom, 1, 1 );
+                if( p_slice->p_scratch == NULL )
+                    b_error = true;
+            }
+        }
+
+        for( int n = 0; n < (cfg.b_has_a ? 2 : 1); n++ )
+        {
+            const int i_fmti = n == 0 ? cfg.i_fmti : AV_PIX_FMT_GRAY8;
+            const int i_fmto = n == 0 ? cfg.i_fmto : AV_PIX_FMT_GRAY8;
+            /* The alpha plane is never subsampled, so it needs no margins */
+            const int i_margins = n == 0 ? p_slice->i_top + p_slice->i_bottom : 0;
+            struct SwsContext *ctx;
+
+            ctx = sws_getContext( i_fmti_visible_width,
+                                  p_slice->i_last - p_slice->i_first + i_margins, i_fmti,
+                                  i_fmto_visible_width,
+                                  p_slice->i_out_last - p_slice->i_out_first + i_margins, i_fmto,
+                                  cfg.i_sws_flags | p_sys->i_cpu_mask,
+                                  p_sys->p_filter, NULL, 0 );
+            if( n == 0 )
+                p_slice->ctx = ctx;
+            else
+                p_slice->ctxA = ctx;
+            if( ctx == NULL )
+                b_error = true;
+        }
     }
-    if( p_sys->ctxA )
+    if( cfg.b_has_a )
     {
         p_sys->p_src_a = picture_New( VLC_CODEC_GREY, i_fmti_visible_width, p_fmti->i_visible_height, 0, 1 );
         p_sys->p_dst_a = picture_New( VLC_CODEC_GREY, i_fmto_visible_width, p_fmto->i_visible_height, 0, 1 );
@@ -427,8 +563,8 @@ static int Init( filter_t *p_filter )
             memset( p_sys->p_dst_e->p[0].p_pixels, 0, p_sys->p_dst_e->p[0].i_pitch * p_sys->p_dst_e->p[0].i_lines );
     }
 
-    if( !p_sys->ctx ||
-        ( cfg.b_has_a && ( !p_sys->ctxA || !p_sys->p_src_a || !p_sys->p_dst_a ) ) ||
+    if( b_error ||
+        ( cfg.b_has_a && ( !p_sys->p_src_a || !p_sys->p_dst_a ) ) ||
         ( p_sys->i_extend_factor != 1 && ( !p_sys->p_src_e || !p_sys->p_dst_e ) ) )
     {
         msg_Err( p_filter, "could not init SwScaler and/or allocate memory" );
@@ -480,15 +616,23 @@ static void Clean( filter_t *p_filter )
     if( p_sys->p_dst_a )
         picture_Release( p_sys->p_dst_a );
 
-    if( p_sys->ctxA )
-        sws_freeContext( p_sys->ctxA );
-
-    if( p_sys->ctx )
-        sws_freeContext( p_sys->ctx );
+    for( unsigned i = 0; i < p_sys->i_slices; i++ )
+    {
+        scaler_slice_t *p_slice = &p_sys->slices[i];
+
+        if( p_slice->ctxA )
+            sws_freeContext( p_slice->ctxA );
+        if( p_slice->ctx )
+            sws_freeContext( p_slice->ctx );
+        if( p_slice->p_scratch )
+            picture_Release( p_slice->p_scratch );
+        p_slice->ctx = NULL;
+        p_slice->ctxA = NULL;
+        p_slice->p_scratch = NULL;
+    }
 
     /* We have to set it to null has we call be called again :( */
-    p_sys->ctx = NULL;
-    p_sys->ctxA = NULL;
+    p_sys->i_slices = 0;
     p_sys->p_src_a = NULL;
     p_sys->p_dst_a = NULL;
     p_sys->p_src_e = NULL;
@@ -499,7 +643,7 @@ static void GetPixels( uint8_t *pp_pixel[4], int pi_pitch[4],
                        const vlc_chroma_description_t *desc,
                        const video_format_t *fmt,
                        const picture_t *p_picture, unsigned planes,
-                       bool b_swap_uv )
+                       int i_y, bool b_swap_uv )
 {
     unsigned i = 0;
 
@@ -516,7 +660,7 @@ static void GetPixels( uint8_t *pp_pixel[4], int pi_pitch[4],
         pp_pixel[i] = p->p_pixels
             + (((fmt->i_x_offset * desc->p[i].w.num) / desc->p[i].w.den)
                 * p->i_pixel_pitch)
-            + (((fmt->i_y_offset * desc->p[i].h.num) / desc->p[i].h.den)
+            + ((((fmt->i_y_offset + i_y) * desc->p[i].h.num) / desc->p[i].h.den)
                 * p->i_pitch);
         pi_pitch[i] = p->i_pitch;
     }
@@ -529,30 +673,33 @@ static void GetPixels( uint8_t *pp_pixel[4], int pi_pitch[4],
 }
 
 static void ExtractA( picture_t *p_dst, const picture_t *restrict p_src,
-                      unsigned offset )
+                      unsigned offset, int i_first, int i_last )
 {
     plane_t *d = &p_dst->p[0];
     const plane_t *s = &p_src->p[0];
 
-    for( unsigned y = 0; y < p_dst->format.i_height; y++ )
+    i_last = __MIN( i_last, (int)p_dst->format.i_height );
+    for( int y = i_first; y < i_last; y++ )
         for( unsigned x = 0; x < p_dst->format.i_width; x++ )
             d->p_pixels[y*d->i_pitch+x] = s->p_pixels[y*s->i_pitch+4*x+offset];
 }
 
 static void InjectA( picture_t *p_dst, const picture_t *restrict p_src,
-                     unsigned offset )
+                     unsigned offset, int i_first, int i_last )
 {
     plane_t *d = &p_dst->p[0];
     const plane_t *s = &p_src->p[0];
 
-    for( unsigned y = 0; y < p_src->format.i_height; y++ )
+    i_last = __MIN( i_last, (int)p_src->format.i_height );
+    for( int y = i_first; y < i_last; y++ )
         for( unsigned x = 0; x < p_src->format.i_width; x++ )
             d->p_pixels[y*d->i_pitch+4*x+offset] = s->p_pixels[y*s->i_pitch+x];
 }
 
-static void FillA( plane_t *d, unsigned i_offset )
+static void FillA( plane_t *d, unsigned i_offset, int i_first, int i_last )
 {
-    for( int y = 0; y < d->i_visible_lines; y++ )
+    i_last = __MIN( i_last, d->i_visible_lines );
+    for( int y = i_first; y < i_last; y++ )
         for( int x = 0; x < d->i_visible_pitch; x += d->i_pixel_pitch )
             d->p_pixels[y*d->i_pitch+x+i_offset] = 0xff;
 }
@@ -573,17 +720,65 @@ static void CopyPad( picture_t *p_dst, const picture_t *p_src )
     }
 }
 
-static void SwapUV( picture_t *p_dst, const picture_t *p_src )
+static void CopyLines( plane_t *d, const plane_t *s, int i_first, int i_last )
 {
-    picture_t tmp = *p_src;
-    tmp.p[1] = p_src->p[2];
-    tmp.p[2] = p_src->p[1];
+    const int i_width = __MIN( d->i_visible_pitch, s->i_visible_pitch );
 
-    picture_CopyPixels( p_dst, &tmp );
+    i_last = __MIN( i_last, __MIN( d->i_visible_lines, s->i_visible_lines ) );
+    for( int y = i_first; y < i_last; y++ )
+        memcpy( &d->p_pixels[y*d->i_pitch], &s->p_pixels[y*s->i_pitch], i_width );
 }
 
+/* Copies the lines i_first to i_last (excluded) of all the planes,
+ * optionally swapping the U and V planes */
+static void CopySlice( picture_t *p_dst, const picture_t *p_src,
+                       const vlc_chroma_description_t *desc,
+                       int i_first, int i_last, bool b_swap_uv )
+{
+    for( int i = 0; i < p_src->i_planes && i < p_dst->i_planes; i++ )
+    {
+        const plane_t *s = &p_src->p[b_swap_uv && (i == 1 || i == 2) ? 3 - i : i];
+        const unsigned num = desc->p[i].h.num, den = desc->p[i].h.den;
+
+        /* Slices are aligned on the subsampling, except for the end of
+         * the last one which includes the last incomplete line */
+        CopyLines( &p_dst->p[i], s, (i_first * num + den - 1) / den,
+                   (i_last * num + den - 1) / den );
+    }
+}
+
+/* Copies the lines i_first to i_last (excluded) of a slice converted in its
+ * scratch picture, where they start at the line i_top */
+static void CopyScratch( picture_t *p_dst, const video_format_t *p_fmt,
+                         const picture_t *p_scratch,
+                         const vlc_chroma_description_t *desc,
+                         int i_top, int i_first, int i_last )
+{
+    uint8_t *src[4]; int src_stride[4];
+    uint8_t *dst[4]; int dst_stride[4];
+
+    GetPixels( src, src_stride, desc, &p_scratch->format, p_scratch, 4,
+               i_top, false );
+    GetPixels( dst, dst_stride, desc, p_fmt, p_dst, 4, i_first, false );
+
+    for( int i = 0; i < p_dst->i_planes && i < p_scratch->i_planes; i++ )
+    {
+        const unsigned num = desc->p[i].h.num, den = desc->p[i].h.den;
+        const int i_lines = ( ( i_last - i_first ) * num + den - 1 ) / den;
+        const int i_width = __MIN( p_dst->p[i].i_visible_pitch,
+                                   p_scratch->p[i].i_visible_pitch );
+
+        for( int y = 0; y < i_lines; y++ )
+            memcpy( &dst[i][y * dst_stride[i]], &src[i][y * src_stride[i]],
+                    i_width );
+    }
+}
+
+/* Converts i_height lines from the line i_src_y of p_src to the line i_dst_y
+ * of p_dst */
 static void Convert( filter_t *p_filter, struct SwsContext *ctx,
-                     picture_t *p_dst, picture_t *p_src, int i_height,
+                     picture_t *p_dst, const video_format_t *p_fmt_dst,
+                     int i_dst_y, picture_t *p_src, int i_src_y, int i_height,
                      int i_plane_count, bool b_swap_uvi, bool b_swap_uvo )
 {
     filter_sys_t *p_sys = p_filter->p_sys;
@@ -592,7 +787,7 @@ static void Convert( filter_t *p_filter, struct SwsContext *ctx,
     uint8_t *dst[4]; int dst_stride[4];
 
     GetPixels( src, src_stride, p_sys->desc_in, &p_filter->fmt_in.video,
-               p_src, i_plane_count, b_swap_uvi );
+               p_src, i_plane_count, i_src_y, b_swap_uvi );
     if( p_filter->fmt_in.video.i_chroma == VLC_CODEC_RGBP )
     {
         memset( palette, 0, sizeof(palette) );
@@ -603,8 +798,8 @@ static void Convert( filter_t *p_filter, struct SwsContext *ctx,
         src_stride[1] = 4;
     }
 
-    GetPixels( dst, dst_stride, p_sys->desc_out, &p_filter->fmt_out.video,
-               p_dst, i_plane_count, b_swap_uvo );
+    GetPixels( dst, dst_stride, p_sys->desc_out, p_fmt_dst,
+               p_dst, i_plane_count, i_dst_y, b_swap_uvo );
 
 #if LIBSWSCALE_VERSION_INT  >= ((0<<16)+(5<<8)+0)
     sws_scale( ctx, src, src_stride, 0, i_height,
@@ -615,6 +810,177 @@ static void Convert( filter_t *p_filter, struct SwsContext *ctx,
 #endif
 }
 
+/* Converts one slice, including the alpha plane and the UV planes swap */
+static void FilterSlice( filter_t *p_filter, picture_t *p_dst,
+                         picture_t *p_src, unsigned i_slice )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+    const scaler_slice_t *p_slice = &p_sys->slices[i_slice];
+    const video_format_t *p_fmti = &p_filter->fmt_in.video;
+    const video_format_t *p_fmto = &p_filter->fmt_out.video;
+    const int i_first = p_slice->i_out_first, i_last = p_slice->i_out_last;
+
+    if( p_sys->b_copy )
+        CopySlice( p_dst, p_src, p_sys->desc_out, i_first, i_last,
+                   p_sys->b_swap_uvi != p_sys->b_swap_uvo );
+    else
+    {
+        /* Even if alpha is unused, swscale expects the pointer to be set */
+        const int n_planes = !p_slice->ctxA && (p_src->i_planes == 4 ||
+                             p_dst->i_planes == 4) ? 4 : 3;
+
+        if( p_slice->p_scratch != NULL )
+        {
+            Convert( p_filter, p_slice->ctx, p_slice->p_scratch,
+                     &p_slice->p_scratch->format, 0, p_src,
+                     p_slice->i_first - p_slice->i_top,
+                     p_slice->i_last - p_slice->i_first
+                     + p_slice->i_top + p_slice->i_bottom,
+                     n_planes, p_sys->b_swap_uvi, p_sys->b_swap_uvo );
+            CopyScratch( p_dst, p_fmto, p_slice->p_scratch, p_sys->desc_out,
+                         p_slice->i_top, i_first, i_last );
+        }
+        else
+            Convert( p_filter, p_slice->ctx, p_dst, p_fmto, i_first, p_src,
+                     p_slice->i_first, p_slice->i_last - p_slice->i_first,
+                     n_planes, p_sys->b_swap_uvi, p_sys->b_swap_uvo );
+    }
+    if( p_slice->ctxA )
+    {
+        /* We extract the A plane to rescale it, and then we reinject it. */
+        if( p_fmti->i_chroma == VLC_CODEC_RGBA || p_fmti->i_chroma == VLC_CODEC_BGRA )
+            ExtractA( p_sys->p_src_a, p_src, OFFSET_A,
+                      p_slice->i_first, p_slice->i_last );
+        else if( p_fmti->i_chroma == VLC_CODEC_ARGB )
+            ExtractA( p_sys->p_src_a, p_src, 0,
+                      p_slice->i_first, p_slice->i_last );
+        else
+            CopyLines( p_sys->p_src_a->p, p_src->p+A_PLANE,
+                       p_slice->i_first, p_slice->i_last );
+
+        Convert( p_filter, p_slice->ctxA, p_sys->p_dst_a, p_fmto, i_first,
+                 p_sys->p_src_a, p_slice->i_first,
+                 p_slice->i_last - p_slice->i_first, 1, false, false );
+        if( p_fmto->i_chroma == VLC_CODEC_RGBA || p_fmto->i_chroma == VLC_CODEC_BGRA )
+            InjectA( p_dst, p_sys->p_dst_a, OFFSET_A, i_first, i_last );
+        else if( p_fmto->i_chroma == VLC_CODEC_ARGB )
+            InjectA( p_dst, p_sys->p_dst_a, 0, i_first, i_last );
+        else
+            CopyLines( p_dst->p+A_PLANE, p_sys->p_dst_a->p, i_first, i_last );
+    }
+    else if( p_sys->b_add_a )
+    {
+        /* We inject a complete opaque alpha plane */
+        if( p_fmto->i_chroma == VLC_CODEC_RGBA || p_fmto->i_chroma == VLC_CODEC_BGRA )
+            FillA( &p_dst->p[0], OFFSET_A, i_first, i_last );
+        else if( p_fmto->i_chroma == VLC_CODEC_ARGB )
+            FillA( &p_dst->p[0], 0, i_first, i_last );
+        else
+            FillA( &p_dst->p[A_PLANE], 0, i_first, i_last );
+    }
+}
+
+/*****************************************************************************
+ * Worker threads
+ *****************************************************************************/
+static void *Worker( void *data )
+{
+    scaler_worker_t *p_worker = data;
+    filter_t *p_filter = p_worker->p_filter;
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    vlc_mutex_lock( &p_sys->lock );
+    for( ;; )
+    {
+        while( !p_sys->b_quit && p_sys->i_job == p_worker->i_job )
+            vlc_cond_wait( &p_sys->wait, &p_sys->lock );
+        if( p_sys->b_quit )
+            break;
+        p_worker->i_job = p_sys->i_job;
+
+        if( p_worker->i_slice >= p_sys->i_slices )
+            continue;
+
+        vlc_mutex_unlock( &p_sys->lock );
+        FilterSlice( p_filter, p_sys->p_job_dst, p_sys->p_job_src,
+                     p_worker->i_slice );
+        vlc_mutex_lock( &p_sys->lock );
+
+        assert( p_sys->i_pending > 0 );
+        if( --p_sys->i_pending == 0 )
+            vlc_cond_signal( &p_sys->done );
+    }
+    vlc_mutex_unlock( &p_sys->lock );
+    return NULL;
+}
+
+static void InitWorkers( filter_t *p_filter, unsigned i_threads )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    if( i_threads == 0 )
+        i_threads = vlc_GetCPUCount();
+    if( i_threads > MAX_SLICES )
+        i_threads = MAX_SLICES;
+
+    vlc_mutex_init( &p_sys->lock );
+    vlc_cond_init( &p_sys->wait );
+    vlc_cond_init( &p_sys->done );
+    p_sys->i_job = 0;
+    p_sys->i_pending = 0;
+    p_sys->b_quit = false;
+    p_sys->i_threads = i_threads;
+    p_sys->i_workers = 0;
+    p_sys->workers = NULL;
+}
+
+/* Called from the filter thread, while no pictures are queued */
+static void StartWorkers( filter_t *p_filter )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    if( p_sys->workers != NULL )
+        return; /* Already started (or tried) */
+
+    p_sys->workers = calloc( p_sys->i_threads - 1, sizeof(*p_sys->workers) );
+    if( unlikely(p_sys->workers == NULL) )
+        return;
+
+    while( p_sys->i_workers < p_sys->i_threads - 1 )
+    {
+        scaler_worker_t *p_worker = &p_sys->workers[p_sys->i_workers];
+
+        p_worker->p_filter = p_filter;
+        p_worker->i_slice = p_sys->i_workers + 1;
+        p_worker->i_job = p_sys->i_job;
+        if( vlc_clone( &p_worker->thread, Worker, p_worker,
+                       VLC_THREAD_PRIORITY_VIDEO ) )
+        {
+            msg_Warn( p_filter, "cannot start scaling thread" );
+            break;
+        }
+        p_sys->i_workers++;
+    }
+}
+
+static void StopWorkers( filter_t *p_filter )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    vlc_mutex_lock( &p_sys->lock );
+    p_sys->b_quit = true;
+    vlc_cond_broadcast( &p_sys->wait );
+    vlc_mutex_unlock( &p_sys->lock );
+
+    for( unsigned i = 0; i < p_sys->i_workers; i++ )
+        vlc_join( p_sys->workers[i].thread, NULL );
+    free( p_sys->workers );
+
+    vlc_cond_destroy( &p_sys->done );
+    vlc_cond_destroy( &p_sys->wait );
+    vlc_mutex_destroy( &p_sys->lock );
+}
+
 /****************************************************************************
  * Filter: the whole thing
  ****************************************************************************
@@ -623,8 +989,6 @@ static void Convert( filter_t *p_filter, struct SwsContext *ctx,
 static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
 {
     filter_sys_t *p_sys = p_filter->p_sys;
-    const video_format_t *p_fmti = &p_filter->fmt_in.video;
-    const video_format_t *p_fmto = &p_filter->fmt_out.video;
     picture_t *p_pic_dst;
 
     /* Check if format properties changed */
@@ -653,46 +1017,26 @@ static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
         CopyPad( p_src, p_pic );
     }
 
-    if( p_sys->b_copy && p_sys->b_swap_uvi == p_sys->b_swap_uvo )
-        picture_CopyPixels( p_dst, p_src );
-    else if( p_sys->b_copy )
-        SwapUV( p_dst, p_src );
-    else
+    if( p_sys->i_slices > 1 )
     {
-        /* Even if alpha is unused, swscale expects the pointer to be set */
-        const int n_planes = !p_sys->ctxA && (p_src->i_planes == 4 ||
-                             p_dst->i_planes == 4) ? 4 : 3;
-        Convert( p_filter, p_sys->ctx, p_dst, p_src, p_fmti->i_visible_height,
-                 n_planes, p_sys->b_swap_uvi, p_sys->b_swap_uvo );
+        vlc_mutex_lock( &p_sys->lock );
+        assert( p_sys->i_pending == 0 );
+        p_sys->p_job_dst = p_dst;
+        p_sys->p_job_src = p_src;
+        p_sys->i_pending = p_sys->i_slices - 1;
+        p_sys->i_job++;
+        vlc_cond_broadcast( &p_sys->wait );
+        vlc_mutex_unlock( &p_sys->lock );
     }
-    if( p_sys->ctxA )
-    {
-        /* We extract the A plane to rescale it, and then we reinject it. */
-        if( p_fmti->i_chroma == VLC_CODEC_RGBA || p_fmti->i_chroma == VLC_CODEC_BGRA )
-            ExtractA( p_sys->p_src_a, p_src, OFFSET_A );
-        else if( p_fmti->i_chroma == VLC_CODEC_ARGB )
-            ExtractA( p_sys->p_src_a, p_src, 0 );
-        else
-            plane_CopyPixels( p_sys->p_src_a->p, p_src->p+A_PLANE );
 
-        Convert( p_filter, p_sys->ctxA, p_sys->p_dst_a, p_sys->p_src_a,
-                 p_fmti->i_visible_height, 1, false, false );
-        if( p_fmto->i_chroma == VLC_CODEC_RGBA || p_fmto->i_chroma == VLC_CODEC_BGRA )
-            InjectA( p_dst, p_sys->p_dst_a, OFFSET_A );
-        else if( p_fmto->i_chroma == VLC_CODEC_ARGB )
-            InjectA( p_dst, p_sys->p_dst_a, 0 );
-        else
-            plane_CopyPixels( p_dst->p+A_PLANE, p_sys->p_dst_a->p );
-    }
-    else if( p_sys->b_add_a )
+    FilterSlice( p_filter, p_dst, p_src, 0 );
+
+    if( p_sys->i_slices > 1 )
     {
-        /* We inject a complete opaque alpha plane */
-        if( p_fmto->i_chroma == VLC_CODEC_RGBA || p_fmto->i_chroma == VLC_CODEC_BGRA )
-            FillA( &p_dst->p[0], OFFSET_A );
-        else if( p_fmto->i_chroma == VLC_CODEC_ARGB )
-            FillA( &p_dst->p[0], 0 );
-        else
-            FillA( &p_dst->p[A_PLANE], 0 );
+        vlc_mutex_lock( &p_sys->lock );
+        while( p_sys->i_pending > 0 )
+            vlc_cond_wait( &p_sys->done, &p_sys->lock );
+        vlc_mutex_unlock( &p_sys->lock );
     }
 
     if( p_sys->i_extend_factor != 1 )
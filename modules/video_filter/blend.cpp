@@ -32,8 +32,16 @@
 #include <vlc_plugin.h>
 #include <vlc_filter.h>
 #include <vlc_picture.h>
+#include <vlc_cpu.h>
 #include "filter_picture.h"
 
+#ifdef HAVE_SSE2_INTRINSICS
+# include <emmintrin.h>
+#endif
+#ifdef HAVE_AVX2_INTRINSICS
+# include <immintrin.h>
+#endif
+
 /*****************************************************************************
  * Module descriptor
  *****************************************************************************/
@@ -79,6 +87,18 @@ public:
     {
         return fmt;
     }
+    const picture_t *getPicture() const
+    {
+        return picture;
+    }
+    unsigned getX() const
+    {
+        return x;
+    }
+    unsigned getY() const
+    {
+        return y;
+    }
     bool isFull(unsigned) const
     {
         return true;
@@ -551,6 +571,498 @@ void Blend(const CPicture &dst_data, const CPicture &src_data,
 typedef void (*blend_function_t)(const CPicture &dst_data, const CPicture &src_data,
                                  unsigned width, unsigned height, int alpha);
 
+/*****************************************************************************
+ * SIMD blending of the common cases
+ *****************************************************************************
+ * The kernels blend one line of 8-bit samples with the arithmetic of merge()
+ * and div255(), so they are bit-exact with the generic code. Every
+ * intermediate value fits in 16 bits as long as alpha <= 255.
+ *
+ * A kernel set K provides:
+ *  - plane(dst, src, a, count, alpha): dst[i] blended with src[i], a[i]
+ *  - plane_sub2(dst, src, a, count, alpha): dst[i] blended with src[2i], a[2i]
+ *  - uv_sub2(dst, u, v, a, count, alpha): dst[2i] blended with u[2i] and
+ *    dst[2i+1] with v[2i], both with a[2i]
+ *  - rgb32<bgr>(dst, src, count, alpha): RGBA pixels blended onto RGB32
+ *    pixels, with the red and blue components swapped if bgr is set
+ *****************************************************************************/
+static inline void BlendPlaneC(uint8_t *dst, const uint8_t *src,
+                               const uint8_t *a, unsigned count, unsigned alpha)
+{
+    for (unsigned i = 0; i < count; i++)
+        merge(&dst[i], src[i], div255(alpha * a[i]));
+}
+
+static inline void BlendPlaneSub2C(uint8_t *dst, const uint8_t *src,
+                                   const uint8_t *a, unsigned count, unsigned alpha)
+{
+    for (unsigned i = 0; i < count; i++)
+        merge(&dst[i], src[2 * i], div255(alpha * a[2 * i]));
+}
+
+static inline void BlendUVSub2C(uint8_t *dst, const uint8_t *u, const uint8_t *v,
+                                const uint8_t *a, unsigned count, unsigned alpha)
+{
+    for (unsigned i = 0; i < count; i++) {
+        const unsigned f = div255(alpha * a[2 * i]);
+        merge(&dst[2 * i + 0], u[2 * i], f);
+        merge(&dst[2 * i + 1], v[2 * i], f);
+    }
+}
+
+template <bool bgr>
+static inline void BlendRGB32C(uint8_t *dst, const uint8_t *src,
+                               unsigned count, unsigned alpha)
+{
+    for (unsigned i = 0; i < count; i++) {
+        const unsigned f = div255(alpha * src[4 * i + 3]);
+        merge(&dst[4 * i + (bgr ? 2 : 0)], src[4 * i + 0], f);
+        merge(&dst[4 * i + 1],             src[4 * i + 1], f);
+        merge(&dst[4 * i + (bgr ? 0 : 2)], src[4 * i + 2], f);
+    }
+}
+
+#ifdef HAVE_SSE2_INTRINSICS
+VLC_SSE2
+static inline __m128i Div255SSE2(__m128i v)
+{
+    const __m128i one = _mm_set1_epi16(1);
+    return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(_mm_srli_epi16(v, 8), v),
+                                        one), 8);
+}
+
+/* Blending factors of 16-bit alpha samples */
+VLC_SSE2
+static inline __m128i FactorSSE2(__m128i a, __m128i alpha)
+{
+    return Div255SSE2(_mm_mullo_epi16(a, alpha));
+}
+
+VLC_SSE2
+static inline __m128i MergeSSE2(__m128i dst, __m128i src, __m128i f)
+{
+    const __m128i max = _mm_set1_epi16(255);
+    return Div255SSE2(_mm_add_epi16(_mm_mullo_epi16(_mm_sub_epi16(max, f), dst),
+                                    _mm_mullo_epi16(src, f)));
+}
+
+/* Blends two RGBA pixels onto two RGB32 pixels, as 16-bit samples */
+template <bool bgr>
+VLC_SSE2
+static inline __m128i MergeRGB32SSE2(__m128i dst, __m128i src, __m128i alpha)
+{
+    const __m128i rgb = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+    __m128i f = _mm_shufflelo_epi16(src, _MM_SHUFFLE(3, 3, 3, 3));
+    f = _mm_shufflehi_epi16(f, _MM_SHUFFLE(3, 3, 3, 3));
+    f = _mm_and_si128(FactorSSE2(f, alpha), rgb);
+    if (bgr) {
+        src = _mm_shufflelo_epi16(src, _MM_SHUFFLE(3, 0, 1, 2));
+        src = _mm_shufflehi_epi16(src, _MM_SHUFFLE(3, 0, 1, 2));
+    }
+    return MergeSSE2(dst, src, f);
+}
+
+struct CBlendSSE2 {
+    VLC_SSE2
+    static void plane(uint8_t *dst, const uint8_t *src, const uint8_t *a,
+                      unsigned count, unsigned alpha)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i alpha16 = _mm_set1_epi16(alpha);
+        unsigned i = 0;
+
+        for (; i + 16 <= count; i += 16) {
+            const __m128i d = _mm_loadu_si128((const __m128i *)&dst[i]);
+            const __m128i s = _mm_loadu_si128((const __m128i *)&src[i]);
+            const __m128i f = _mm_loadu_si128((const __m128i *)&a[i]);
+
+            __m128i lo = MergeSSE2(_mm_unpacklo_epi8(d, zero),
+                                   _mm_unpacklo_epi8(s, zero),
+                                   FactorSSE2(_mm_unpacklo_epi8(f, zero), alpha16));
+            __m128i hi = MergeSSE2(_mm_unpackhi_epi8(d, zero),
+                                   _mm_unpackhi_epi8(s, zero),
+                                   FactorSSE2(_mm_unpackhi_epi8(f, zero), alpha16));
+            _mm_storeu_si128((__m128i *)&dst[i], _mm_packus_epi16(lo, hi));
+        }
+        BlendPlaneC(&dst[i], &src[i], &a[i], count - i, alpha);
+    }
+
+    VLC_SSE2
+    static void plane_sub2(uint8_t *dst, const uint8_t *src, const uint8_t *a,
+                           unsigned count, unsigned alpha)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i even = _mm_set1_epi16(0xff);
+        const __m128i alpha16 = _mm_set1_epi16(alpha);
+        unsigned i = 0;
+
+        /* The last sample is left to the C code so that the source lines
+         * are not read past their end */
+        for (; i + 16 < count; i += 16) {
+            const __m128i d = _mm_loadu_si128((const __m128i *)&dst[i]);
+            __m128i s_lo = _mm_loadu_si128((const __m128i *)&src[2 * i]);
+            __m128i s_hi = _mm_loadu_si128((const __m128i *)&src[2 * i + 16]);
+            __m128i f_lo = _mm_loadu_si128((const __m128i *)&a[2 * i]);
+            __m128i f_hi = _mm_loadu_si128((const __m128i *)&a[2 * i + 16]);
+
+            s_lo = _mm_and_si128(s_lo, even);
+            s_hi = _mm_and_si128(s_hi, even);
+            f_lo = FactorSSE2(_mm_and_si128(f_lo, even), alpha16);
+            f_hi = FactorSSE2(_mm_and_si128(f_hi, even), alpha16);
+
+            __m128i lo = MergeSSE2(_mm_unpacklo_epi8(d, zero), s_lo, f_lo);
+            __m128i hi = MergeSSE2(_mm_unpackhi_epi8(d, zero), s_hi, f_hi);
+            _mm_storeu_si128((__m128i *)&dst[i], _mm_packus_epi16(lo, hi));
+        }
+        BlendPlaneSub2C(&dst[i], &src[2 * i], &a[2 * i], count - i, alpha);
+    }
+
+    VLC_SSE2
+    static void uv_sub2(uint8_t *dst, const uint8_t *u, const uint8_t *v,
+                        const uint8_t *a, unsigned count, unsigned alpha)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i even = _mm_set1_epi16(0xff);
+        const __m128i alpha16 = _mm_set1_epi16(alpha);
+        unsigned i = 0;
+
+        for (; i + 8 < count; i += 8) {
+            const __m128i d = _mm_loadu_si128((const __m128i *)&dst[2 * i]);
+            const __m128i su = _mm_and_si128(
+                _mm_loadu_si128((const __m128i *)&u[2 * i]), even);
+            const __m128i sv = _mm_and_si128(
+                _mm_loadu_si128((const __m128i *)&v[2 * i]), even);
+            const __m128i f = FactorSSE2(_mm_and_si128(
+                _mm_loadu_si128((const __m128i *)&a[2 * i]), even), alpha16);
+
+            __m128i lo = MergeSSE2(_mm_unpacklo_epi8(d, zero),
+                                   _mm_unpacklo_epi16(su, sv),
+                                   _mm_unpacklo_epi16(f, f));
+            __m128i hi = MergeSSE2(_mm_unpackhi_epi8(d, zero),
+                                   _mm_unpackhi_epi16(su, sv),
+                                   _mm_unpackhi_epi16(f, f));
+            _mm_storeu_si128((__m128i *)&dst[2 * i], _mm_packus_epi16(lo, hi));
+        }
+        BlendUVSub2C(&dst[2 * i], &u[2 * i], &v[2 * i], &a[2 * i], count - i, alpha);
+    }
+
+    template <bool bgr>
+    VLC_SSE2
+    static void rgb32(uint8_t *dst, const uint8_t *src, unsigned count,
+                      unsigned alpha)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i alpha16 = _mm_set1_epi16(alpha);
+        unsigned i = 0;
+
+        for (; i + 4 <= count; i += 4) {
+            const __m128i d = _mm_loadu_si128((const __m128i *)&dst[4 * i]);
+            const __m128i s = _mm_loadu_si128((const __m128i *)&src[4 * i]);
+
+            __m128i lo = MergeRGB32SSE2<bgr>(_mm_unpacklo_epi8(d, zero),
+                                             _mm_unpacklo_epi8(s, zero), alpha16);
+            __m128i hi = MergeRGB32SSE2<bgr>(_mm_unpackhi_epi8(d, zero),
+                                             _mm_unpackhi_epi8(s, zero), alpha16);
+            _mm_storeu_si128((__m128i *)&dst[4 * i], _mm_packus_epi16(lo, hi));
+        }
+        BlendRGB32C<bgr>(&dst[4 * i], &src[4 * i], count - i, alpha);
+    }
+};
+#endif
+
+#ifdef HAVE_AVX2_INTRINSICS
+VLC_AVX2
+static inline __m256i Div255AVX2(__m256i v)
+{
+    const __m256i one = _mm256_set1_epi16(1);
+    return _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(_mm256_srli_epi16(v, 8), v),
+                                              one), 8);
+}
+
+VLC_AVX2
+static inline __m256i FactorAVX2(__m256i a, __m256i alpha)
+{
+    return Div255AVX2(_mm256_mullo_epi16(a, alpha));
+}
+
+VLC_AVX2
+static inline __m256i MergeAVX2(__m256i dst, __m256i src, __m256i f)
+{
+    const __m256i max = _mm256_set1_epi16(255);
+    return Div255AVX2(_mm256_add_epi16(_mm256_mullo_epi16(_mm256_sub_epi16(max, f), dst),
+                                       _mm256_mullo_epi16(src, f)));
+}
+
+/* Loads 16 samples as 16-bit values */
+VLC_AVX2
+static inline __m256i LoadAVX2(const uint8_t *p)
+{
+    return _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)p));
+}
+
+/* Stores 32 samples from 16-bit values, in order */
+VLC_AVX2
+static inline void StoreAVX2(uint8_t *p, __m256i lo, __m256i hi)
+{
+    /* packus works within 128-bit lanes */
+    _mm256_storeu_si256((__m256i *)p,
+                        _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi),
+                                                 _MM_SHUFFLE(3, 1, 2, 0)));
+}
+
+template <bool bgr>
+VLC_AVX2
+static inline __m256i MergeRGB32AVX2(__m256i dst, __m256i src, __m256i alpha)
+{
+    const __m256i rgb = _mm256_set_epi16(0, -1, -1, -1, 0, -1, -1, -1,
+                                         0, -1, -1, -1, 0, -1, -1, -1);
+    __m256i f = _mm256_shufflelo_epi16(src, _MM_SHUFFLE(3, 3, 3, 3));
+    f = _mm256_shufflehi_epi16(f, _MM_SHUFFLE(3, 3, 3, 3));
+    f = _mm256_and_si256(FactorAVX2(f, alpha), rgb);
+    if (bgr) {
+        src = _mm256_shufflelo_epi16(src, _MM_SHUFFLE(3, 0, 1, 2));
+        src = _mm256_shufflehi_epi16(src, _MM_SHUFFLE(3, 0, 1, 2));
+    }
+    return MergeAVX2(dst, src, f);
+}
+
+struct CBlendAVX2 {
+    VLC_AVX2
+    static void plane(uint8_t *dst, const uint8_t *src, const uint8_t *a,
+                      unsigned count, unsigned alpha)
+    {
+        const __m256i alpha16 = _mm256_set1_epi16(alpha);
+        unsigned i = 0;
+
+        for (; i + 32 <= count; i += 32) {
+            __m256i lo = MergeAVX2(LoadAVX2(&dst[i]), LoadAVX2(&src[i]),
+                                   FactorAVX2(LoadAVX2(&a[i]), alpha16));
+            __m256i hi = MergeAVX2(LoadAVX2(&dst[i + 16]), LoadAVX2(&src[i + 16]),
+                                   FactorAVX2(LoadAVX2(&a[i + 16]), alpha16));
+            StoreAVX2(&dst[i], lo, hi);
+        }
+        BlendPlaneC(&dst[i], &src[i], &a[i], count - i, alpha);
+    }
+
+    VLC_AVX2
+    static void plane_sub2(uint8_t *dst, const uint8_t *src, const uint8_t *a,
+                           unsigned count, unsigned alpha)
+    {
+        const __m256i even = _mm256_set1_epi16(0xff);
+        const __m256i alpha16 = _mm256_set1_epi16(alpha);
+        unsigned i = 0;
+
+        /* The last sample is left to the C code so that the source lines
+         * are not read past their end */
+        for (; i + 32 < count; i += 32) {
+            __m256i s_lo = _mm256_loadu_si256((const __m256i *)&src[2 * i]);
+            __m256i s_hi = _mm256_loadu_si256((const __m256i *)&src[2 * i + 32]);
+            __m256i f_lo = _mm256_loadu_si256((const __m256i *)&a[2 * i]);
+            __m256i f_hi = _mm256_loadu_si256((const __m256i *)&a[2 * i + 32]);
+
+            s_lo = _mm256_and_si256(s_lo, even);
+            s_hi = _mm256_and_si256(s_hi, even);
+            f_lo = FactorAVX2(_mm256_and_si256(f_lo, even), alpha16);
+            f_hi = FactorAVX2(_mm256_and_si256(f_hi, even), alpha16);
+
+            StoreAVX2(&dst[i], MergeAVX2(LoadAVX2(&dst[i]), s_lo, f_lo),
+                               MergeAVX2(LoadAVX2(&dst[i + 16]), s_hi, f_hi));
+        }
+        BlendPlaneSub2C(&dst[i], &src[2 * i], &a[2 * i], count - i, alpha);
+    }
+
+    VLC_AVX2
+    static void uv_sub2(uint8_t *dst, const uint8_t *u, const uint8_t *v,
+                        const uint8_t *a, unsigned count, unsigned alpha)
+    {
+        const __m256i even = _mm256_set1_epi16(0xff);
+        const __m256i alpha16 = _mm256_set1_epi16(alpha);
+        unsigned i = 0;
+
+        for (; i + 16 < count; i += 16) {
+            const __m256i su = _mm256_and_si256(
+                _mm256_loadu_si256((const __m256i *)&u[2 * i]), even);
+            const __m256i sv = _mm256_and_si256(
+                _mm256_loadu_si256((const __m256i *)&v[2 * i]), even);
+            const __m256i f = FactorAVX2(_mm256_and_si256(
+                _mm256_loadu_si256((const __m256i *)&a[2 * i]), even), alpha16);
+
+            /* Interleaving works within 128-bit lanes */
+            const __m256i uv_a = _mm256_unpacklo_epi16(su, sv);
+            const __m256i uv_b = _mm256_unpackhi_epi16(su, sv);
+            const __m256i ff_a = _mm256_unpacklo_epi16(f, f);
+            const __m256i ff_b = _mm256_unpackhi_epi16(f, f);
+
+            __m256i lo = MergeAVX2(LoadAVX2(&dst[2 * i]),
+                                   _mm256_permute2x128_si256(uv_a, uv_b, 0x20),
+                                   _mm256_permute2x128_si256(ff_a, ff_b, 0x20));
+            __m256i hi = MergeAVX2(LoadAVX2(&dst[2 * i + 16]),
+                                   _mm256_permute2x128_si256(uv_a, uv_b, 0x31),
+                                   _mm256_permute2x128_si256(ff_a, ff_b, 0x31));
+            StoreAVX2(&dst[2 * i], lo, hi);
+        }
+        BlendUVSub2C(&dst[2 * i], &u[2 * i], &v[2 * i], &a[2 * i], count - i, alpha);
+    }
+
+    template <bool bgr>
+    VLC_AVX2
+    static void rgb32(uint8_t *dst, const uint8_t *src, unsigned count,
+                      unsigned alpha)
+    {
+        const __m256i alpha16 = _mm256_set1_epi16(alpha);
+        unsigned i = 0;
+
+        for (; i + 8 <= count; i += 8) {
+            __m256i lo = MergeRGB32AVX2<bgr>(LoadAVX2(&dst[4 * i]),
+                                             LoadAVX2(&src[4 * i]), alpha16);
+            __m256i hi = MergeRGB32AVX2<bgr>(LoadAVX2(&dst[4 * i + 16]),
+                                             LoadAVX2(&src[4 * i + 16]), alpha16);
+            StoreAVX2(&dst[4 * i], lo, hi);
+        }
+        BlendRGB32C<bgr>(&dst[4 * i], &src[4 * i], count - i, alpha);
+    }
+};
+#endif
+
+static inline const uint8_t *GetSourceLine(const picture_t *picture,
+                                           unsigned plane, unsigned x, unsigned y)
+{
+    return &picture->p[plane].p_pixels[y * picture->p[plane].i_pitch + x];
+}
+
+/* YUVA onto 8-bit planar YUV with rx x ry chroma subsampling */
+template <class K, unsigned rx, unsigned ry, bool swap_uv>
+void BlendYUVAToPlanar(const CPicture &dst_data, const CPicture &src_data,
+                       unsigned width, unsigned height, int alpha)
+{
+    const picture_t *dst = dst_data.getPicture();
+    const picture_t *src = src_data.getPicture();
+    const unsigned dx = dst_data.getX();
+    /* First column with chroma samples */
+    const unsigned x0 = (rx - dx % rx) % rx;
+    const unsigned chroma_width = width > x0 ? (width - x0 + rx - 1) / rx : 0;
+
+    for (unsigned y = 0; y < height; y++) {
+        const unsigned dy = dst_data.getY() + y;
+        const uint8_t *s[4];
+        for (unsigned i = 0; i < 4; i++)
+            s[i] = GetSourceLine(src, i, src_data.getX(), src_data.getY() + y);
+
+        K::plane(&dst->p[0].p_pixels[dy * dst->p[0].i_pitch + dx],
+                 s[0], s[3], width, alpha);
+        if (dy % ry)
+            continue;
+
+        for (unsigned i = 1; i <= 2; i++) {
+            const plane_t *p = &dst->p[swap_uv ? 3 - i : i];
+            uint8_t *d = &p->p_pixels[dy / ry * p->i_pitch + (dx + x0) / rx];
+            if (rx == 1)
+                K::plane(d, s[i], s[3], width, alpha);
+            else
+                K::plane_sub2(d, s[i] + x0, s[3] + x0, chroma_width, alpha);
+        }
+    }
+}
+
+/* YUVA onto NV12 or NV21 */
+template <class K, bool swap_uv>
+void BlendYUVAToSemiPlanar(const CPicture &dst_data, const CPicture &src_data,
+                           unsigned width, unsigned height, int alpha)
+{
+    const picture_t *dst = dst_data.getPicture();
+    const picture_t *src = src_data.getPicture();
+    const unsigned dx = dst_data.getX();
+    const unsigned x0 = dx % 2;
+    const unsigned chroma_width = width > x0 ? (width - x0 + 1) / 2 : 0;
+
+    for (unsigned y = 0; y < height; y++) {
+        const unsigned dy = dst_data.getY() + y;
+        const uint8_t *s[4];
+        for (unsigned i = 0; i < 4; i++)
+            s[i] = GetSourceLine(src, i, src_data.getX(), src_data.getY() + y);
+
+        K::plane(&dst->p[0].p_pixels[dy * dst->p[0].i_pitch + dx],
+                 s[0], s[3], width, alpha);
+        if (dy % 2)
+            continue;
+
+        const plane_t *p = &dst->p[1];
+        K::uv_sub2(&p->p_pixels[dy / 2 * p->i_pitch + (dx + x0) / 2 * 2],
+                   s[swap_uv ? 2 : 1] + x0, s[swap_uv ? 1 : 2] + x0, s[3] + x0,
+                   chroma_width, alpha);
+    }
+}
+
+/* RGBA onto RGB32, when the components are in RGB or BGR order */
+template <class K>
+void BlendRGBAToRGB32(const CPicture &dst_data, const CPicture &src_data,
+                      unsigned width, unsigned height, int alpha)
+{
+    const video_format_t *fmt = dst_data.getFormat();
+#ifdef WORDS_BIGENDIAN
+    const unsigned offset_r = (32 - fmt->i_lrshift) / 8;
+    const unsigned offset_g = (32 - fmt->i_lgshift) / 8;
+    const unsigned offset_b = (32 - fmt->i_lbshift) / 8;
+#else
+    const unsigned offset_r = fmt->i_lrshift / 8;
+    const unsigned offset_g = fmt->i_lgshift / 8;
+    const unsigned offset_b = fmt->i_lbshift / 8;
+#endif
+    bool bgr;
+
+    if (offset_r == 0 && offset_g == 1 && offset_b == 2)
+        bgr = false;
+    else if (offset_r == 2 && offset_g == 1 && offset_b == 0)
+        bgr = true;
+    else {
+        Blend<CPictureRGB32, CPictureRGBA, compose<convertNone, convertNone> >
+            (dst_data, src_data, width, height, alpha);
+        return;
+    }
+
+    const picture_t *dst = dst_data.getPicture();
+    const picture_t *src = src_data.getPicture();
+
+    for (unsigned y = 0; y < height; y++) {
+        const plane_t *p = &dst->p[0];
+        uint8_t *d = &p->p_pixels[(dst_data.getY() + y) * p->i_pitch
+                                  + dst_data.getX() * 4];
+        const uint8_t *s = GetSourceLine(src, 0, src_data.getX() * 4,
+                                         src_data.getY() + y);
+        if (bgr)
+            K::template rgb32<true>(d, s, width, alpha);
+        else
+            K::template rgb32<false>(d, s, width, alpha);
+    }
+}
+
+template <class K>
+static blend_function_t GetSIMDBlend(vlc_fourcc_t dst, vlc_fourcc_t src)
+{
+    static const struct {
+        vlc_fourcc_t     dst;
+        vlc_fourcc_t     src;
+        blend_function_t blend;
+    } simd_blends[] = {
+        { VLC_CODEC_I420, VLC_CODEC_YUVA, BlendYUVAToPlanar<K, 2, 2, false> },
+        { VLC_CODEC_J420, VLC_CODEC_YUVA, BlendYUVAToPlanar<K, 2, 2, false> },
+        { VLC_CODEC_YV12, VLC_CODEC_YUVA, BlendYUVAToPlanar<K, 2, 2, true> },
+        { VLC_CODEC_I422, VLC_CODEC_YUVA, BlendYUVAToPlanar<K, 2, 1, false> },
+        { VLC_CODEC_J422, VLC_CODEC_YUVA, BlendYUVAToPlanar<K, 2, 1, false> },
+        { VLC_CODEC_I444, VLC_CODEC_YUVA, BlendYUVAToPlanar<K, 1, 1, false> },
+        { VLC_CODEC_J444, VLC_CODEC_YUVA, BlendYUVAToPlanar<K, 1, 1, false> },
+        { VLC_CODEC_NV12, VLC_CODEC_YUVA, BlendYUVAToSemiPlanar<K, false> },
+        { VLC_CODEC_NV21, VLC_CODEC_YUVA, BlendYUVAToSemiPlanar<K, true> },
+        { VLC_CODEC_RGB32, VLC_CODEC_RGBA, BlendRGBAToRGB32<K> },
+    };
+
+    for (size_t i = 0; i < sizeof(simd_blends) / sizeof(*simd_blends); i++) {
+        if (simd_blends[i].src == src && simd_blends[i].dst == dst)
+            return simd_blends[i].blend;
+    }
+    return NULL;
+}
+
 static const struct {
     vlc_fourcc_t     dst;
     vlc_fourcc_t     src;
@@ -683,6 +1195,18 @@ static int Open(vlc_object_t *object)
         return VLC_EGENERIC;
     }
 
+    blend_function_t simd = NULL;
+#ifdef HAVE_AVX2_INTRINSICS
+    if (simd == NULL && vlc_CPU_AVX2())
+        simd = GetSIMDBlend<CBlendAVX2>(dst, src);
+#endif
+#ifdef HAVE_SSE2_INTRINSICS
+    if (simd == NULL && vlc_CPU_SSE2())
+        simd = GetSIMDBlend<CBlendSSE2>(dst, src);
+#endif
+    if (simd != NULL)
+        sys->blend = simd;
+
     filter->pf_video_blend = Blend;
     filter->p_sys          = sys;
     return VLC_SUCCESS;
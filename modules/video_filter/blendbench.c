@@ -56,6 +56,14 @@ static picture_t *Filter( filter_t *, picture_t * );
 #define ALPHA_TEXT N_("Alpha of the blended image")
 #define ALPHA_LONGTEXT N_("Alpha with which the blend image is blended")
 
+#define WIDTH_TEXT N_("Width of the generated images")
+#define WIDTH_LONGTEXT N_("Width of the images generated when no image " \
+                          "file is given")
+
+#define HEIGHT_TEXT N_("Height of the generated images")
+#define HEIGHT_LONGTEXT N_("Height of the images generated when no image " \
+                           "file is given")
+
 #define BASE_IMAGE_TEXT N_("Image to be blended onto")
 #define BASE_IMAGE_LONGTEXT N_("The image which will be used to blend onto")
 
@@ -83,6 +91,10 @@ vlc_module_begin ()
               LOOPS_LONGTEXT, false )
     add_integer_with_range( CFG_PREFIX "alpha", 128, 0, 255, ALPHA_TEXT,
               ALPHA_LONGTEXT, false )
+    add_integer_with_range( CFG_PREFIX "width", 1920, 1, 8192, WIDTH_TEXT,
+              WIDTH_LONGTEXT, false )
+    add_integer_with_range( CFG_PREFIX "height", 1080, 1, 8192, HEIGHT_TEXT,
+              HEIGHT_LONGTEXT, false )
 
     set_section( N_("Base image"), NULL )
     add_loadfile( CFG_PREFIX "base-image", NULL, BASE_IMAGE_TEXT,
@@ -100,7 +112,7 @@ vlc_module_begin ()
 vlc_module_end ()
 
 static const char *const ppsz_filter_options[] = {
-    "loops", "alpha", "base-image", "base-chroma", "blend-image",
+    "loops", "alpha", "width", "height", "base-image", "base-chroma", "blend-image",
     "blend-chroma", NULL
 };
 
@@ -111,6 +123,7 @@ struct filter_sys_t
 {
     bool b_done;
     int i_loops, i_alpha;
+    int i_width, i_height;
 
     picture_t *p_base_image;
     picture_t *p_blend_image;
@@ -119,12 +132,63 @@ struct filter_sys_t
     vlc_fourcc_t i_blend_chroma;
 };
 
+/* Generates a picture with smooth gradients and, for the chromas with an
+ * alpha channel, transparent, opaque and translucent areas */
+static picture_t *blendbench_GenerateImage( vlc_fourcc_t i_chroma,
+                                            int i_width, int i_height )
+{
+    video_format_t fmt;
+
+    video_format_Init( &fmt, i_chroma );
+    video_format_Setup( &fmt, i_chroma, i_width, i_height,
+                        i_width, i_height, 1, 1 );
+
+    picture_t *p_pic = picture_NewFromFormat( &fmt );
+    if( p_pic == NULL )
+        return NULL;
+
+    for( int i = 0; i < p_pic->i_planes; i++ )
+    {
+        plane_t *p = &p_pic->p[i];
+
+        for( int y = 0; y < p->i_visible_lines; y++ )
+        {
+            uint8_t *p_line = &p->p_pixels[y * p->i_pitch];
+
+            for( int x = 0; x < p->i_visible_pitch; x++ )
+            {
+                bool b_alpha = ( i_chroma == VLC_CODEC_YUVA && i == 3 )
+                            || ( i_chroma == VLC_CODEC_RGBA && ( x & 3 ) == 3 );
+
+                if( b_alpha )
+                    p_line[x] = ( x / 64 + y / 64 ) % 3 == 0 ? 0
+                              : ( x / 64 + y / 64 ) % 3 == 1 ? 255 : x + y;
+                else
+                    p_line[x] = x * ( i + 1 ) + y;
+            }
+        }
+    }
+    return p_pic;
+}
+
 static int blendbench_LoadImage( vlc_object_t *p_this, picture_t **pp_pic,
-                                 vlc_fourcc_t i_chroma, char *psz_file, const char *psz_name )
+                                 vlc_fourcc_t i_chroma, char *psz_file, const char *psz_name,
+                                 int i_width, int i_height )
 {
     image_handler_t *p_image;
     video_format_t fmt_in, fmt_out;
 
+    if( psz_file == NULL || *psz_file == '\0' )
+    {
+        *pp_pic = blendbench_GenerateImage( i_chroma, i_width, i_height );
+        if( *pp_pic == NULL )
+            return VLC_ENOMEM;
+
+        msg_Dbg( p_this, "%s image generated with dim %d x %d", psz_name,
+                 i_width, i_height );
+        return VLC_SUCCESS;
+    }
+
     memset( &fmt_in, 0, sizeof(video_format_t) );
     memset( &fmt_out, 0, sizeof(video_format_t) );
 
@@ -175,13 +239,18 @@ static int Create( vlc_object_t *p_this )
                                                   CFG_PREFIX "loops" );
     p_sys->i_alpha = var_CreateGetIntegerCommand( p_filter,
                                                   CFG_PREFIX "alpha" );
+    p_sys->i_width = var_CreateGetIntegerCommand( p_filter,
+                                                  CFG_PREFIX "width" );
+    p_sys->i_height = var_CreateGetIntegerCommand( p_filter,
+                                                   CFG_PREFIX "height" );
 
     psz_temp = var_CreateGetStringCommand( p_filter, CFG_PREFIX "base-chroma" );
     p_sys->i_base_chroma = !psz_temp || strlen( psz_temp ) != 4 ? 0 :
         VLC_FOURCC( psz_temp[0], psz_temp[1], psz_temp[2], psz_temp[3] );
     psz_cmd = var_CreateGetStringCommand( p_filter, CFG_PREFIX "base-image" );
     i_ret = blendbench_LoadImage( p_this, &p_sys->p_base_image,
-                                  p_sys->i_base_chroma, psz_cmd, "Base" );
+                                  p_sys->i_base_chroma, psz_cmd, "Base",
+                                  p_sys->i_width, p_sys->i_height );
     free( psz_temp );
     free( psz_cmd );
     if( i_ret != VLC_SUCCESS )
@@ -196,7 +265,8 @@ static int Create( vlc_object_t *p_this )
         ? 0 : VLC_FOURCC( psz_temp[0], psz_temp[1], psz_temp[2], psz_temp[3] );
     psz_cmd = var_CreateGetStringCommand( p_filter, CFG_PREFIX "blend-image" );
     i_ret = blendbench_LoadImage( p_this, &p_sys->p_blend_image, p_sys->i_blend_chroma,
-                                  psz_cmd, "Blend" );
+                                  psz_cmd, "Blend",
+                                  p_sys->i_width, p_sys->i_height );
 
     free( psz_temp );
     free( psz_cmd );
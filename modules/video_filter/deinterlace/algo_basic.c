@@ -184,37 +184,62 @@ int RenderLinear( filter_t *p_filter,
     return VLC_SUCCESS;
 }
 
-/*****************************************************************************
- * RenderMean: Half-resolution blender
- *****************************************************************************/
-
-int RenderMean( filter_t *p_filter, picture_t *p_outpic, picture_t *p_pic )
+/* One plane of a picture, merged in horizontal bands */
+typedef struct
 {
-    VLC_UNUSED(p_filter);
+    filter_t *p_filter;
+    picture_t *p_outpic;
+    picture_t *p_pic;
     int i_plane;
+} merge_job_t;
 
-    /* Copy image and skip lines */
-    for( i_plane = 0 ; i_plane < p_pic->i_planes ; i_plane++ )
+static void RenderPlanes( filter_t *p_filter,
+                          picture_t *p_outpic, picture_t *p_pic,
+                          void (*pf_band)( void *, unsigned, unsigned ) )
+{
+    deinterlace_pool_t *p_pool = p_filter->p_sys->p_pool;
+    merge_job_t job = {
+        .p_filter = p_filter,
+        .p_outpic = p_outpic,
+        .p_pic = p_pic,
+    };
+
+    for( job.i_plane = 0 ; job.i_plane < p_pic->i_planes ; job.i_plane++ )
     {
-        uint8_t *p_in, *p_out_end, *p_out;
-
-        p_in = p_pic->p[i_plane].p_pixels;
+        int i_lines = p_outpic->p[job.i_plane].i_visible_lines;
 
-        p_out = p_outpic->p[i_plane].p_pixels;
-        p_out_end = p_out + p_outpic->p[i_plane].i_pitch
-                             * p_outpic->p[i_plane].i_visible_lines;
+        DeinterlacePoolRun( p_pool, pf_band, &job,
+                            DeinterlacePoolBands( p_pool, i_lines ) );
+    }
+}
 
-        /* All lines: mean value */
-        for( ; p_out < p_out_end ; )
-        {
-            Merge( p_out, p_in, p_in + p_pic->p[i_plane].i_pitch,
-                   p_pic->p[i_plane].i_pitch );
+/*****************************************************************************
+ * RenderMean: Half-resolution blender
+ *****************************************************************************/
 
-            p_out += p_outpic->p[i_plane].i_pitch;
-            p_in += 2 * p_pic->p[i_plane].i_pitch;
-        }
-    }
+static void MeanBand( void *p_data, unsigned i_band, unsigned i_bands )
+{
+    const merge_job_t *job = p_data;
+    filter_t *p_filter = job->p_filter;
+    const plane_t *p_in = &job->p_pic->p[job->i_plane];
+    const plane_t *p_out = &job->p_outpic->p[job->i_plane];
+    int i_first, i_last;
+
+    DeinterlaceBand( i_band, i_bands, p_out->i_visible_lines, 1,
+                     &i_first, &i_last );
+
+    /* All lines: mean value */
+    for( int y = i_first; y < i_last; y++ )
+        Merge( &p_out->p_pixels[y * p_out->i_pitch],
+               &p_in->p_pixels[2 * y * p_in->i_pitch],
+               &p_in->p_pixels[(2 * y + 1) * p_in->i_pitch],
+               p_in->i_pitch );
     EndMerge();
+}
+
+int RenderMean( filter_t *p_filter, picture_t *p_outpic, picture_t *p_pic )
+{
+    RenderPlanes( p_filter, p_outpic, p_pic, MeanBand );
     return VLC_SUCCESS;
 }
 
@@ -222,36 +247,35 @@ int RenderMean( filter_t *p_filter, picture_t *p_outpic, picture_t *p_pic )
  * RenderBlend: Full-resolution blender
  *****************************************************************************/
 
-int RenderBlend( filter_t *p_filter, picture_t *p_outpic, picture_t *p_pic )
+static void BlendBand( void *p_data, unsigned i_band, unsigned i_bands )
 {
-    VLC_UNUSED(p_filter);
-    int i_plane;
+    const merge_job_t *job = p_data;
+    filter_t *p_filter = job->p_filter;
+    const plane_t *p_in = &job->p_pic->p[job->i_plane];
+    const plane_t *p_out = &job->p_outpic->p[job->i_plane];
+    int i_first, i_last;
 
-    /* Copy image and skip lines */
-    for( i_plane = 0 ; i_plane < p_pic->i_planes ; i_plane++ )
-    {
-        uint8_t *p_in, *p_out_end, *p_out;
-
-        p_in = p_pic->p[i_plane].p_pixels;
-
-        p_out = p_outpic->p[i_plane].p_pixels;
-        p_out_end = p_out + p_outpic->p[i_plane].i_pitch
-                             * p_outpic->p[i_plane].i_visible_lines;
+    DeinterlaceBand( i_band, i_bands, p_out->i_visible_lines, 1,
+                     &i_first, &i_last );
 
-        /* First line: simple copy */
-        memcpy( p_out, p_in, p_pic->p[i_plane].i_pitch );
-        p_out += p_outpic->p[i_plane].i_pitch;
-
-        /* Remaining lines: mean value */
-        for( ; p_out < p_out_end ; )
-        {
-            Merge( p_out, p_in, p_in + p_pic->p[i_plane].i_pitch,
-                   p_pic->p[i_plane].i_pitch );
-
-            p_out += p_outpic->p[i_plane].i_pitch;
-            p_in  += p_pic->p[i_plane].i_pitch;
-        }
+    /* First line: simple copy */
+    if( i_first == 0 && i_last > 0 )
+    {
+        memcpy( p_out->p_pixels, p_in->p_pixels, p_in->i_pitch );
+        i_first = 1;
     }
+
+    /* Remaining lines: mean value */
+    for( int y = i_first; y < i_last; y++ )
+        Merge( &p_out->p_pixels[y * p_out->i_pitch],
+               &p_in->p_pixels[(y - 1) * p_in->i_pitch],
+               &p_in->p_pixels[y * p_in->i_pitch],
+               p_in->i_pitch );
     EndMerge();
+}
+
+int RenderBlend( filter_t *p_filter, picture_t *p_outpic, picture_t *p_pic )
+{
+    RenderPlanes( p_filter, p_outpic, p_pic, BlendBand );
     return VLC_SUCCESS;
 }
@@ -512,17 +512,62 @@ static inline void XDeintBand8x8MMXEXT( uint8_t *dst, int i_dst,
  * Public functions
  *****************************************************************************/
 
-int RenderX( filter_t *p_filter, picture_t *p_outpic, picture_t *p_pic )
+/* One plane of a picture, rendered in bands of 8x8 block rows */
+typedef struct
 {
-    VLC_UNUSED(p_filter);
+    picture_t *p_outpic;
+    picture_t *p_pic;
     int i_plane;
+} x_job_t;
+
+static void XBand( void *p_data, unsigned i_band, unsigned i_bands )
+{
+    const x_job_t *job = p_data;
+    const plane_t *p_out = &job->p_outpic->p[job->i_plane];
+    const plane_t *p_in = &job->p_pic->p[job->i_plane];
 #if defined (CAN_COMPILE_MMXEXT)
     const bool mmxext = vlc_CPU_MMXEXT();
 #endif
 
+    const int i_mby = ( p_out->i_visible_lines + 7 )/8 - 1;
+    const int i_mbx = p_out->i_visible_pitch/8;
+    const int i_modx = p_out->i_visible_pitch - 8*i_mbx;
+
+    const int i_dst = p_out->i_pitch;
+    const int i_src = p_in->i_pitch;
+
+    int i_first, i_last;
+
+    DeinterlaceBand( i_band, i_bands, i_mby, 1, &i_first, &i_last );
+
+    for( int y = i_first; y < i_last; y++ )
+    {
+        uint8_t *dst = &p_out->p_pixels[8*y*i_dst];
+        uint8_t *src = &p_in->p_pixels[8*y*i_src];
+
+#ifdef CAN_COMPILE_MMXEXT
+        if( mmxext )
+            XDeintBand8x8MMXEXT( dst, i_dst, src, i_src, i_mbx, i_modx );
+        else
+#endif
+            XDeintBand8x8C( dst, i_dst, src, i_src, i_mbx, i_modx );
+    }
+
+#ifdef CAN_COMPILE_MMXEXT
+    if( mmxext )
+        emms();
+#endif
+}
+
+int RenderX( filter_t *p_filter, picture_t *p_outpic, picture_t *p_pic )
+{
+    deinterlace_pool_t *p_pool = p_filter->p_sys->p_pool;
+    x_job_t job = { .p_outpic = p_outpic, .p_pic = p_pic };
+
     /* Copy image and skip lines */
-    for( i_plane = 0 ; i_plane < p_pic->i_planes ; i_plane++ )
+    for( job.i_plane = 0 ; job.i_plane < p_pic->i_planes ; job.i_plane++ )
     {
+        const int i_plane = job.i_plane;
         const int i_mby = ( p_outpic->p[i_plane].i_visible_lines + 7 )/8 - 1;
         const int i_mbx = p_outpic->p[i_plane].i_visible_pitch/8;
 
@@ -532,28 +577,18 @@ int RenderX( filter_t *p_filter, picture_t *p_outpic, picture_t *p_pic )
         const int i_dst = p_outpic->p[i_plane].i_pitch;
         const int i_src = p_pic->p[i_plane].i_pitch;
 
-        int y, x;
-
-        for( y = 0; y < i_mby; y++ )
-        {
-            uint8_t *dst = &p_outpic->p[i_plane].p_pixels[8*y*i_dst];
-            uint8_t *src = &p_pic->p[i_plane].p_pixels[8*y*i_src];
-
-#ifdef CAN_COMPILE_MMXEXT
-            if( mmxext )
-                XDeintBand8x8MMXEXT( dst, i_dst, src, i_src, i_mbx, i_modx );
-            else
-#endif
-                XDeintBand8x8C( dst, i_dst, src, i_src, i_mbx, i_modx );
-        }
+        /* Rows of 8x8 blocks are rendered in bands */
+        if( i_mby > 0 )
+            DeinterlacePoolRun( p_pool, XBand, &job,
+                                DeinterlacePoolBands( p_pool, 8*i_mby ) );
 
         /* Last line (C only)*/
         if( i_mody )
         {
-            uint8_t *dst = &p_outpic->p[i_plane].p_pixels[8*y*i_dst];
-            uint8_t *src = &p_pic->p[i_plane].p_pixels[8*y*i_src];
+            uint8_t *dst = &p_outpic->p[i_plane].p_pixels[8*i_mby*i_dst];
+            uint8_t *src = &p_pic->p[i_plane].p_pixels[8*i_mby*i_src];
 
-            for( x = 0; x < i_mbx; x++ )
+            for( int x = 0; x < i_mbx; x++ )
             {
                 XDeintNxN( dst, i_dst, src, i_src, 8, i_mody );
 
@@ -566,9 +601,5 @@ int RenderX( filter_t *p_filter, picture_t *p_outpic, picture_t *p_pic )
         }
     }
 
-#ifdef CAN_COMPILE_MMXEXT
-    if( mmxext )
-        emms();
-#endif
     return VLC_SUCCESS;
 }
@@ -47,6 +47,194 @@
    Necessary preprocessor macros are defined in common.h. */
 #include "yadif.h"
 
+#if defined(HAVE_AVX2_INTRINSICS)
+#include <immintrin.h>
+
+/* Same arithmetic as the FILTER macro from yadif.h, on 16 pixels at a time,
+ * widened to 16-bit lanes so that the results are bit-exact. */
+VLC_AVX2
+static inline __m256i yadif_load_avx2( const uint8_t *p )
+{
+    return _mm256_cvtepu8_epi16( _mm_loadu_si128( (const __m128i *)p ) );
+}
+
+VLC_AVX2
+static inline __m256i yadif_absdiff_avx2( __m256i a, __m256i b )
+{
+    return _mm256_abs_epi16( _mm256_sub_epi16( a, b ) );
+}
+
+/* Spatial score of the edge direction j, see CHECK() in yadif.h */
+VLC_AVX2
+static inline __m256i yadif_score_avx2( const uint8_t *cur, int mrefs,
+                                        int prefs, int j )
+{
+    __m256i s;
+
+    s = yadif_absdiff_avx2( yadif_load_avx2( &cur[mrefs - 1 + j] ),
+                            yadif_load_avx2( &cur[prefs - 1 - j] ) );
+    s = _mm256_add_epi16( s,
+            yadif_absdiff_avx2( yadif_load_avx2( &cur[mrefs + j] ),
+                                yadif_load_avx2( &cur[prefs - j] ) ) );
+    s = _mm256_add_epi16( s,
+            yadif_absdiff_avx2( yadif_load_avx2( &cur[mrefs + 1 + j] ),
+                                yadif_load_avx2( &cur[prefs + 1 - j] ) ) );
+    return s;
+}
+
+/* Updates the spatial prediction if the edge direction j scores better.
+ * Returns the mask of the updated pixels. */
+VLC_AVX2
+static inline __m256i yadif_check_avx2( const uint8_t *cur, int mrefs,
+                                        int prefs, int j, __m256i valid,
+                                        __m256i *score, __m256i *pred )
+{
+    __m256i s = yadif_score_avx2( cur, mrefs, prefs, j );
+    __m256i better = _mm256_and_si256( valid, _mm256_cmpgt_epi16( *score, s ) );
+    __m256i p = _mm256_srli_epi16(
+        _mm256_add_epi16( yadif_load_avx2( &cur[mrefs + j] ),
+                          yadif_load_avx2( &cur[prefs - j] ) ), 1 );
+
+    *score = _mm256_blendv_epi8( *score, s, better );
+    *pred = _mm256_blendv_epi8( *pred, p, better );
+    return better;
+}
+
+VLC_AVX2
+static void yadif_filter_line_avx2( uint8_t *dst, uint8_t *prev, uint8_t *cur,
+                                    uint8_t *next, int w, int prefs, int mrefs,
+                                    int parity, int mode )
+{
+    const __m256i all = _mm256_set1_epi16( -1 );
+    const __m256i one = _mm256_set1_epi16( 1 );
+    uint8_t *prev2 = parity ? prev : cur ;
+    uint8_t *next2 = parity ? cur  : next;
+    int x;
+
+    for( x = 0; x + 16 <= w; x += 16 )
+    {
+        __m256i c = yadif_load_avx2( &cur[x + mrefs] );
+        __m256i e = yadif_load_avx2( &cur[x + prefs] );
+        __m256i p2 = yadif_load_avx2( &prev2[x] );
+        __m256i n2 = yadif_load_avx2( &next2[x] );
+        __m256i d = _mm256_srli_epi16( _mm256_add_epi16( p2, n2 ), 1 );
+
+        __m256i td0 = yadif_absdiff_avx2( p2, n2 );
+        __m256i td1 = _mm256_srli_epi16( _mm256_add_epi16(
+            yadif_absdiff_avx2( yadif_load_avx2( &prev[x + mrefs] ), c ),
+            yadif_absdiff_avx2( yadif_load_avx2( &prev[x + prefs] ), e ) ), 1 );
+        __m256i td2 = _mm256_srli_epi16( _mm256_add_epi16(
+            yadif_absdiff_avx2( yadif_load_avx2( &next[x + mrefs] ), c ),
+            yadif_absdiff_avx2( yadif_load_avx2( &next[x + prefs] ), e ) ), 1 );
+        __m256i diff = _mm256_max_epi16( _mm256_srli_epi16( td0, 1 ),
+                                         _mm256_max_epi16( td1, td2 ) );
+
+        __m256i pred = _mm256_srli_epi16( _mm256_add_epi16( c, e ), 1 );
+        __m256i score = _mm256_sub_epi16( _mm256_add_epi16(
+            yadif_absdiff_avx2( yadif_load_avx2( &cur[x + mrefs - 1] ),
+                                yadif_load_avx2( &cur[x + prefs - 1] ) ),
+            _mm256_add_epi16( yadif_absdiff_avx2( c, e ),
+            yadif_absdiff_avx2( yadif_load_avx2( &cur[x + mrefs + 1] ),
+                                yadif_load_avx2( &cur[x + prefs + 1] ) ) ) ),
+            one );
+
+        __m256i valid;
+        valid = yadif_check_avx2( &cur[x], mrefs, prefs, -1, all,
+                                  &score, &pred );
+        yadif_check_avx2( &cur[x], mrefs, prefs, -2, valid, &score, &pred );
+        valid = yadif_check_avx2( &cur[x], mrefs, prefs, 1, all,
+                                  &score, &pred );
+        yadif_check_avx2( &cur[x], mrefs, prefs, 2, valid, &score, &pred );
+
+        if( mode < 2 )
+        {
+            __m256i b = _mm256_srli_epi16( _mm256_add_epi16(
+                yadif_load_avx2( &prev2[x + 2 * mrefs] ),
+                yadif_load_avx2( &next2[x + 2 * mrefs] ) ), 1 );
+            __m256i f = _mm256_srli_epi16( _mm256_add_epi16(
+                yadif_load_avx2( &prev2[x + 2 * prefs] ),
+                yadif_load_avx2( &next2[x + 2 * prefs] ) ), 1 );
+            __m256i de = _mm256_sub_epi16( d, e );
+            __m256i dc = _mm256_sub_epi16( d, c );
+            __m256i bc = _mm256_sub_epi16( b, c );
+            __m256i fe = _mm256_sub_epi16( f, e );
+            __m256i max = _mm256_max_epi16( _mm256_max_epi16( de, dc ),
+                                            _mm256_min_epi16( bc, fe ) );
+            __m256i min = _mm256_min_epi16( _mm256_min_epi16( de, dc ),
+                                            _mm256_max_epi16( bc, fe ) );
+
+            diff = _mm256_max_epi16( diff, _mm256_max_epi16( min,
+                        _mm256_sub_epi16( _mm256_setzero_si256(), max ) ) );
+        }
+
+        /* diff is never negative, so clamping equals the C comparisons */
+        pred = _mm256_max_epi16( pred, _mm256_sub_epi16( d, diff ) );
+        pred = _mm256_min_epi16( pred, _mm256_add_epi16( d, diff ) );
+
+        _mm_storeu_si128( (__m128i *)&dst[x],
+                          _mm_packus_epi16( _mm256_castsi256_si128( pred ),
+                                            _mm256_extracti128_si256( pred, 1 ) ) );
+    }
+
+    if( x < w )
+        yadif_filter_line_c( &dst[x], &prev[x], &cur[x], &next[x], w - x,
+                             prefs, mrefs, parity, mode );
+}
+#endif
+
+typedef void (*yadif_filter_t)( uint8_t *dst, uint8_t *prev, uint8_t *cur,
+                                uint8_t *next, int w, int prefs, int mrefs,
+                                int parity, int mode );
+
+/* One plane of a Yadif field, rendered in horizontal bands */
+typedef struct
+{
+    picture_t *p_prev, *p_cur, *p_next, *p_dst;
+    yadif_filter_t filter;
+    int i_plane;
+    int i_field;
+    int i_parity;
+} yadif_job_t;
+
+static void YadifBand( void *p_data, unsigned i_band, unsigned i_bands )
+{
+    const yadif_job_t *job = p_data;
+    const plane_t *prevp = &job->p_prev->p[job->i_plane];
+    const plane_t *curp  = &job->p_cur->p[job->i_plane];
+    const plane_t *nextp = &job->p_next->p[job->i_plane];
+    plane_t *dstp        = &job->p_dst->p[job->i_plane];
+    int i_first, i_last;
+
+    DeinterlaceBand( i_band, i_bands, dstp->i_visible_lines - 2, 1,
+                     &i_first, &i_last );
+
+    for( int y = i_first + 1; y < i_last + 1; y++ )
+    {
+        if( (y % 2) == job->i_field  ||  job->i_parity == 2 )
+        {
+            memcpy( &dstp->p_pixels[y * dstp->i_pitch],
+                        &curp->p_pixels[y * curp->i_pitch], dstp->i_visible_pitch );
+        }
+        else
+        {
+            int mode;
+            /* Spatial checks only when enough data */
+            mode = (y >= 2 && y < dstp->i_visible_lines - 2) ? 0 : 2;
+
+            assert( prevp->i_pitch == curp->i_pitch && curp->i_pitch == nextp->i_pitch );
+            job->filter( &dstp->p_pixels[y * dstp->i_pitch],
+                         &prevp->p_pixels[y * prevp->i_pitch],
+                         &curp->p_pixels[y * curp->i_pitch],
+                         &nextp->p_pixels[y * nextp->i_pitch],
+                         dstp->i_visible_pitch,
+                         y < dstp->i_visible_lines - 2  ? curp->i_pitch : -curp->i_pitch,
+                         y  - 1  ?  -curp->i_pitch : curp->i_pitch,
+                         job->i_parity,
+                         mode );
+        }
+    }
+}
+
 int RenderYadifSingle( filter_t *p_filter, picture_t *p_dst, picture_t *p_src )
 {
     return RenderYadif( p_filter, p_dst, p_src, 0, 0 );
@@ -109,72 +297,60 @@ int RenderYadif( filter_t *p_filter, picture_t *p_dst, picture_t *p_src,
     /* Filter if we have all the pictures we need */
     if( p_prev && p_cur && p_next )
     {
-        /* */
-        void (*filter)(uint8_t *dst, uint8_t *prev, uint8_t *cur, uint8_t *next,
-                       int w, int prefs, int mrefs, int parity, int mode);
+        yadif_job_t job = {
+            .p_prev = p_prev,
+            .p_cur = p_cur,
+            .p_next = p_next,
+            .p_dst = p_dst,
+            .i_field = i_field,
+            .i_parity = yadif_parity,
+        };
 
+#if defined(HAVE_AVX2_INTRINSICS)
+        if( vlc_CPU_AVX2() )
+            job.filter = yadif_filter_line_avx2;
+        else
+#endif
 #if defined(HAVE_YADIF_SSSE3)
         if( vlc_CPU_SSSE3() )
-            filter = yadif_filter_line_ssse3;
+            job.filter = yadif_filter_line_ssse3;
         else
 #endif
 #if defined(HAVE_YADIF_SSE2)
         if( vlc_CPU_SSE2() )
-            filter = yadif_filter_line_sse2;
+            job.filter = yadif_filter_line_sse2;
         else
 #endif
 #if defined(HAVE_YADIF_MMX)
         if( vlc_CPU_MMX() )
-            filter = yadif_filter_line_mmx;
+            job.filter = yadif_filter_line_mmx;
         else
 #endif
-            filter = yadif_filter_line_c;
+            job.filter = yadif_filter_line_c;
 
         if( p_sys->chroma->pixel_size == 2 )
-            filter = yadif_filter_line_c_16bit;
+            job.filter = yadif_filter_line_c_16bit;
 
-        for( int n = 0; n < p_dst->i_planes; n++ )
+        for( job.i_plane = 0; job.i_plane < p_dst->i_planes; job.i_plane++ )
         {
-            const plane_t *prevp = &p_prev->p[n];
-            const plane_t *curp  = &p_cur->p[n];
-            const plane_t *nextp = &p_next->p[n];
-            plane_t *dstp        = &p_dst->p[n];
-
-            for( int y = 1; y < dstp->i_visible_lines - 1; y++ )
-            {
-                if( (y % 2) == i_field  ||  yadif_parity == 2 )
-                {
-                    memcpy( &dstp->p_pixels[y * dstp->i_pitch],
-                                &curp->p_pixels[y * curp->i_pitch], dstp->i_visible_pitch );
-                }
-                else
-                {
-                    int mode;
-                    /* Spatial checks only when enough data */
-                    mode = (y >= 2 && y < dstp->i_visible_lines - 2) ? 0 : 2;
-
-                    assert( prevp->i_pitch == curp->i_pitch && curp->i_pitch == nextp->i_pitch );
-                    filter( &dstp->p_pixels[y * dstp->i_pitch],
-                            &prevp->p_pixels[y * prevp->i_pitch],
-                            &curp->p_pixels[y * curp->i_pitch],
-                            &nextp->p_pixels[y * nextp->i_pitch],
-                            dstp->i_visible_pitch,
-                            y < dstp->i_visible_lines - 2  ? curp->i_pitch : -curp->i_pitch,
-                            y  - 1  ?  -curp->i_pitch : curp->i_pitch,
-                            yadif_parity,
-                            mode );
-                }
-
-                /* We duplicate the first and last lines */
-                if( y == 1 )
-                    memcpy(&dstp->p_pixels[(y-1) * dstp->i_pitch],
-                               &dstp->p_pixels[ y    * dstp->i_pitch],
-                               dstp->i_pitch);
-                else if( y == dstp->i_visible_lines - 2 )
-                    memcpy(&dstp->p_pixels[(y+1) * dstp->i_pitch],
-                               &dstp->p_pixels[ y    * dstp->i_pitch],
-                               dstp->i_pitch);
-            }
+            plane_t *dstp = &p_dst->p[job.i_plane];
+            const int i_lines = dstp->i_visible_lines;
+
+            if( i_lines < 3 )
+                continue;
+
+            /* Lines 1 to i_lines - 2 are rendered in bands */
+            DeinterlacePoolRun( p_sys->p_pool, YadifBand, &job,
+                                DeinterlacePoolBands( p_sys->p_pool,
+                                                      i_lines - 2 ) );
+
+            /* We duplicate the first and last lines */
+            memcpy( &dstp->p_pixels[0],
+                    &dstp->p_pixels[dstp->i_pitch], dstp->i_pitch );
+            if( i_lines > 3 )
+                memcpy( &dstp->p_pixels[(i_lines - 1) * dstp->i_pitch],
+                        &dstp->p_pixels[(i_lines - 2) * dstp->i_pitch],
+                        dstp->i_pitch );
         }
 
         p_sys->context.i_frame_offset = 1; /* p_cur will be rendered at next frame, too */
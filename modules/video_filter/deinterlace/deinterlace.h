@@ -43,6 +43,7 @@ struct vlc_object_t;
 #include "algo_phosphor.h"
 #include "algo_ivtc.h"
 #include "common.h"
+#include "pool.h"
 
 /*****************************************************************************
  * Local data
@@ -78,6 +79,9 @@ struct filter_sys_t
 
     struct deinterlace_ctx   context;
 
+    /** Threads rendering the bands of each plane */
+    deinterlace_pool_t *p_pool;
+
     /* Algorithm-specific substructures */
     union {
         phosphor_sys_t phosphor; /**< Phosphor algorithm state. */
@@ -79,7 +79,7 @@
  * Generic routine to blend 8 bit pixels from two picture lines.
  * No inline assembler acceleration.
  *
- * @param _p_dest Target line. Blend result = (A + B)/2.
+ * @param _p_dest Target line. Blend result = (A + B + 1)/2.
  * @param _p_s1 Source line A.
  * @param _p_s2 Source line B.
  * @param i_bytes Number of bytes to merge.
@@ -92,7 +92,7 @@ void Merge8BitGeneric( void *_p_dest, const void *_p_s1, const void *_p_s2,
  * Generic routine to blend 16 bit pixels from two picture lines.
  * No inline assembler acceleration.
  *
- * @param _p_dest Target line. Blend result = (A + B)/2.
+ * @param _p_dest Target line. Blend result = (A + B + 1)/2.
  * @param _p_s1 Source line A.
  * @param _p_s2 Source line B.
  * @param i_bytes Number of *bytes* to merge.
@@ -158,6 +158,27 @@ void Merge8BitSSE2( void *, const void *, const void *, size_t );
 void Merge16BitSSE2( void *, const void *, const void *, size_t );
 #endif
 
+#if defined(HAVE_AVX2_INTRINSICS)
+/**
+ * AVX2 routine to blend pixels from two picture lines.
+ *
+ * @param _p_dest Target
+ * @param _p_s1 Source line A
+ * @param _p_s2 Source line B
+ * @param i_bytes Number of bytes to merge
+ */
+void Merge8BitAVX2( void *, const void *, const void *, size_t );
+/**
+ * AVX2 routine to blend pixels from two picture lines.
+ *
+ * @param _p_dest Target
+ * @param _p_s1 Source line A
+ * @param _p_s2 Source line B
+ * @param i_bytes Number of bytes to merge
+ */
+void Merge16BitAVX2( void *, const void *, const void *, size_t );
+#endif
+
 #if defined(CAN_COMPILE_ARM)
 /**
  * ARM NEON routine to blend pixels from two picture lines.
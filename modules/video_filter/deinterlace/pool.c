@@ -0,0 +1,172 @@
+/*****************************************************************************
+ * pool.c : Worker pool for slice-parallel deinterlacing
+ *****************************************************************************
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include <vlc_common.h>
+
+#include "pool.h"
+
+/* Upper bound on the number of threads rendering bands */
+#define POOL_MAX_THREADS 16
+
+struct deinterlace_pool_t
+{
+    vlc_mutex_t lock;
+    vlc_cond_t  wait;  /**< Signaled when bands are queued, or on exit */
+    vlc_cond_t  done;  /**< Signaled when the last band is rendered */
+
+    void (*pf_band)( void *, unsigned, unsigned );
+    void *p_data;
+    unsigned i_bands;   /**< Number of bands of the current job */
+    unsigned i_next;    /**< Next band to render */
+    unsigned i_pending; /**< Bands not rendered yet */
+    bool b_quit;
+
+    unsigned i_workers;
+    vlc_thread_t workers[];
+};
+
+/* Renders queued bands until there are none left.
+ * Must be called with the lock held. */
+static void PoolRenderLocked( deinterlace_pool_t *p_pool )
+{
+    while( p_pool->i_next < p_pool->i_bands )
+    {
+        unsigned i_band = p_pool->i_next++;
+
+        vlc_mutex_unlock( &p_pool->lock );
+        p_pool->pf_band( p_pool->p_data, i_band, p_pool->i_bands );
+        vlc_mutex_lock( &p_pool->lock );
+
+        assert( p_pool->i_pending > 0 );
+        if( --p_pool->i_pending == 0 )
+            vlc_cond_signal( &p_pool->done );
+    }
+}
+
+static void *PoolThread( void *data )
+{
+    deinterlace_pool_t *p_pool = data;
+
+    vlc_mutex_lock( &p_pool->lock );
+    while( !p_pool->b_quit )
+    {
+        PoolRenderLocked( p_pool );
+        vlc_cond_wait( &p_pool->wait, &p_pool->lock );
+    }
+    vlc_mutex_unlock( &p_pool->lock );
+    return NULL;
+}
+
+deinterlace_pool_t *DeinterlacePoolNew( vlc_object_t *p_obj,
+                                        unsigned i_threads )
+{
+    if( i_threads == 0 )
+        i_threads = vlc_GetCPUCount();
+    if( i_threads > POOL_MAX_THREADS )
+        i_threads = POOL_MAX_THREADS;
+    if( i_threads == 0 )
+        i_threads = 1;
+
+    deinterlace_pool_t *p_pool =
+        malloc( sizeof( *p_pool ) + ( i_threads - 1 ) * sizeof( vlc_thread_t ) );
+    if( unlikely(p_pool == NULL) )
+        return NULL;
+
+    vlc_mutex_init( &p_pool->lock );
+    vlc_cond_init( &p_pool->wait );
+    vlc_cond_init( &p_pool->done );
+    p_pool->i_bands = 0;
+    p_pool->i_next = 0;
+    p_pool->i_pending = 0;
+    p_pool->b_quit = false;
+    p_pool->i_workers = 0;
+
+    while( p_pool->i_workers < i_threads - 1 )
+    {
+        if( vlc_clone( &p_pool->workers[p_pool->i_workers], PoolThread,
+                       p_pool, VLC_THREAD_PRIORITY_VIDEO ) )
+        {
+            msg_Warn( p_obj, "cannot start deinterlacing thread" );
+            break;
+        }
+        p_pool->i_workers++;
+    }
+
+    msg_Dbg( p_obj, "deinterlacing with %u thread(s)", p_pool->i_workers + 1 );
+    return p_pool;
+}
+
+void DeinterlacePoolDelete( deinterlace_pool_t *p_pool )
+{
+    vlc_mutex_lock( &p_pool->lock );
+    p_pool->b_quit = true;
+    vlc_cond_broadcast( &p_pool->wait );
+    vlc_mutex_unlock( &p_pool->lock );
+
+    for( unsigned i = 0; i < p_pool->i_workers; i++ )
+        vlc_join( p_pool->workers[i], NULL );
+
+    vlc_cond_destroy( &p_pool->done );
+    vlc_cond_destroy( &p_pool->wait );
+    vlc_mutex_destroy( &p_pool->lock );
+    free( p_pool );
+}
+
+unsigned DeinterlacePoolBands( const deinterlace_pool_t *p_pool, int i_lines )
+{
+    int i_bands = i_lines / DEINTERLACE_BAND_MIN_LINES;
+
+    if( i_bands > (int)p_pool->i_workers + 1 )
+        i_bands = p_pool->i_workers + 1;
+    return i_bands > 1 ? i_bands : 1;
+}
+
+void DeinterlacePoolRun( deinterlace_pool_t *p_pool,
+                         void (*pf_band)( void *, unsigned, unsigned ),
+                         void *p_data, unsigned i_bands )
+{
+    if( i_bands <= 1 || p_pool->i_workers == 0 )
+    {
+        for( unsigned i = 0; i < i_bands; i++ )
+            pf_band( p_data, i, i_bands );
+        return;
+    }
+
+    vlc_mutex_lock( &p_pool->lock );
+    assert( p_pool->i_pending == 0 );
+    p_pool->pf_band = pf_band;
+    p_pool->p_data = p_data;
+    p_pool->i_bands = i_bands;
+    p_pool->i_next = 0;
+    p_pool->i_pending = i_bands;
+    vlc_cond_broadcast( &p_pool->wait );
+
+    PoolRenderLocked( p_pool );
+    while( p_pool->i_pending > 0 )
+        vlc_cond_wait( &p_pool->done, &p_pool->lock );
+    vlc_mutex_unlock( &p_pool->lock );
+}
@@ -0,0 +1,104 @@
+/*****************************************************************************
+ * pool.h : Worker pool for slice-parallel deinterlacing
+ *****************************************************************************
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLC_DEINTERLACE_POOL_H
+#define VLC_DEINTERLACE_POOL_H 1
+
+/**
+ * \file
+ * Worker pool for the VLC deinterlacer. The algorithms split each plane
+ * into horizontal bands, and the bands of a plane are rendered in parallel
+ * by the workers and by the calling thread.
+ */
+
+/* Forward declarations */
+struct vlc_object_t;
+
+typedef struct deinterlace_pool_t deinterlace_pool_t;
+
+/**
+ * Minimum number of lines per band. Smaller bands are not worth the
+ * synchronization cost.
+ */
+#define DEINTERLACE_BAND_MIN_LINES 16
+
+/**
+ * Creates a worker pool.
+ *
+ * The calling thread of DeinterlacePoolRun() also renders bands,
+ * so i_threads - 1 worker threads are started.
+ *
+ * @param p_obj The filter instance as vlc_object_t.
+ * @param i_threads Number of threads rendering bands, 0 for automatic.
+ * @return The pool, or NULL on memory allocation error.
+ */
+deinterlace_pool_t *DeinterlacePoolNew( struct vlc_object_t *p_obj,
+                                        unsigned i_threads );
+
+/**
+ * Stops the worker threads and destroys the pool.
+ */
+void DeinterlacePoolDelete( deinterlace_pool_t *p_pool );
+
+/**
+ * Returns how many bands should be used for a plane of i_lines lines.
+ *
+ * @param p_pool The pool.
+ * @param i_lines Number of lines to render.
+ * @return Number of bands, always at least 1.
+ */
+unsigned DeinterlacePoolBands( const deinterlace_pool_t *p_pool, int i_lines );
+
+/**
+ * Renders i_bands bands and waits for all of them to be done.
+ *
+ * pf_band is called once per band index, in any order and from any thread
+ * of the pool (including the calling one).
+ *
+ * @param p_pool The pool.
+ * @param pf_band Band rendering callback.
+ * @param p_data Opaque pointer for pf_band.
+ * @param i_bands Number of bands, see DeinterlacePoolBands().
+ */
+void DeinterlacePoolRun( deinterlace_pool_t *p_pool,
+                         void (*pf_band)( void *p_data, unsigned i_band,
+                                          unsigned i_bands ),
+                         void *p_data, unsigned i_bands );
+
+/**
+ * Computes the first (included) and last (excluded) lines of a band.
+ *
+ * Band boundaries are rounded to multiples of i_align lines.
+ */
+static inline void DeinterlaceBand( unsigned i_band, unsigned i_bands,
+                                    int i_lines, int i_align,
+                                    int *pi_first, int *pi_last )
+{
+    int i_units = ( i_lines + i_align - 1 ) / i_align;
+
+    *pi_first = i_units * i_band / i_bands * i_align;
+    *pi_last  = i_units * ( i_band + 1 ) / i_bands * i_align;
+    if( *pi_first > i_lines )
+        *pi_first = i_lines;
+    if( *pi_last > i_lines )
+        *pi_last = i_lines;
+}
+
+#endif
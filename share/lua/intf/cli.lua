@@ -391,6 +391,8 @@ function stats(name,client)
     client:append("| demux bitrate    :   "..string.format("%6.0f kb/s",stats_tab["demux_bitrate"]*8000))
     client:append("| demux corrupted  :    "..string.format("%5i",stats_tab["demux_corrupted"]))
     client:append("| discontinuities  :    "..string.format("%5i",stats_tab["demux_discontinuity"]))
+    client:append("| decoders waited  :  "..string.format("%7.0f ms",stats_tab["decoder_blocked"]/1000))
+    client:append("| packets dropped  :    "..string.format("%5i",stats_tab["decoder_dropped"]))
     client:append("|")
     client:append("+-[Video Decoding]")
     client:append("| video decoded    :    "..string.format("%5i",stats_tab["decoded_video"]))
@@ -53,6 +53,13 @@ void config_UnsortConfig (void);
 extern vlc_rwlock_t config_lock;
 extern bool config_dirty;
 
+/**
+ * Invalidates the inherited variable values cached from the configuration
+ *
+ * This must be called whenever the value of a configuration item changes.
+ */
+void var_InvalidateConfig(void);
+
 bool config_IsSafe (const char *);
 
 /* The configuration file */
@@ -209,6 +209,7 @@ void config_PutPsz( vlc_object_t *p_this,
     oldstr = (char *)p_config->value.psz;
     p_config->value.psz = str;
     config_dirty = true;
+    var_InvalidateConfig ();
     vlc_rwlock_unlock (&config_lock);
 
     free (oldstr);
@@ -244,6 +245,7 @@ void config_PutInt( vlc_object_t *p_this, const char *psz_name,
     vlc_rwlock_wrlock (&config_lock);
     p_config->value.i = i_value;
     config_dirty = true;
+    var_InvalidateConfig ();
     vlc_rwlock_unlock (&config_lock);
 }
 
@@ -279,6 +281,7 @@ void config_PutFloat( vlc_object_t *p_this,
     vlc_rwlock_wrlock (&config_lock);
     p_config->value.f = f_value;
     config_dirty = true;
+    var_InvalidateConfig ();
     vlc_rwlock_unlock (&config_lock);
 }
 
@@ -581,6 +584,7 @@ void config_ResetAll( vlc_object_t *p_this )
             }
         }
     }
+    var_InvalidateConfig ();
     vlc_rwlock_unlock (&config_lock);
 
     VLC_UNUSED(p_this);
@@ -241,6 +241,7 @@ int config_LoadConfigFile( vlc_object_t *p_this )
                 break;
         }
     }
+    var_InvalidateConfig ();
     vlc_rwlock_unlock (&config_lock);
     free (line);
 
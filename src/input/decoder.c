@@ -96,6 +96,23 @@ struct decoder_owner_sys_t
 
     /* fifo */
     block_fifo_t *p_fifo;
+    /* Lock-free queue of blocks to decode, if there is a single producer.
+     * p_fifo then only serves to lock the decoder thread state. */
+    vlc_spsc_t *p_spsc;
+
+    /* Pacing (backpressure) of the FIFO */
+    struct
+    {
+        size_t high_bytes; /* pause the input from that many bytes */
+        size_t low_bytes; /* resume the input below that many bytes */
+        mtime_t high_delay; /* or from that duration (0 if disabled) */
+        mtime_t low_delay;
+        unsigned blocks; /* or that many blocks if the duration is unknown */
+        size_t max_bytes; /* discard the FIFO beyond that if not pacing */
+        mtime_t last_in; /* timestamp of the last queued block */
+        atomic_int_least64_t last_out; /* timestamp of the last dequeued one */
+        bool waiting; /* the input waits for the low watermarks */
+    } pace;
 
     /* Lock for communication with decoder thread */
     vlc_mutex_t lock;
@@ -906,6 +923,201 @@ static void DecoderProcessSout( decoder_t *p_dec, block_t *p_block )
 }
 #endif
 
+static mtime_t DecoderBlockTime( const block_t *p_block )
+{
+    return (p_block->i_dts > VLC_TS_INVALID) ? p_block->i_dts
+                                              : p_block->i_pts;
+}
+
+/**
+ * Records the timestamp of blocks about to be queued, for pacing.
+ */
+static void DecoderPaceQueued( decoder_owner_sys_t *p_owner,
+                               const block_t *p_block )
+{
+    for( ; p_block != NULL; p_block = p_block->p_next )
+    {
+        mtime_t i_time = DecoderBlockTime( p_block );
+
+        if( i_time > VLC_TS_INVALID )
+            p_owner->pace.last_in = i_time;
+    }
+}
+
+/**
+ * Queues blocks to decode (from the producer side).
+ */
+static void DecoderQueue( decoder_owner_sys_t *p_owner, block_t *p_block )
+{
+    DecoderPaceQueued( p_owner, p_block );
+
+    if( p_owner->p_spsc == NULL )
+    {
+        block_FifoPut( p_owner->p_fifo, p_block );
+        return;
+    }
+
+    if( vlc_spsc_Queue( p_owner->p_spsc, p_block ) )
+    {   /* The decoder thread waits for data on the FIFO */
+        vlc_fifo_Lock( p_owner->p_fifo );
+        vlc_fifo_Signal( p_owner->p_fifo );
+        vlc_fifo_Unlock( p_owner->p_fifo );
+    }
+}
+
+/**
+ * Counts blocks to decode.
+ *
+ * \note The FIFO must be locked, unless the lock-free queue is used.
+ */
+static size_t DecoderQueueCount( decoder_owner_sys_t *p_owner )
+{
+    if( p_owner->p_spsc != NULL )
+        return vlc_spsc_GetCount( p_owner->p_spsc );
+    return vlc_fifo_GetCount( p_owner->p_fifo );
+}
+
+/**
+ * Counts bytes to decode.
+ *
+ * \note The FIFO must be locked, unless the lock-free queue is used.
+ */
+static size_t DecoderQueueBytes( decoder_owner_sys_t *p_owner )
+{
+    if( p_owner->p_spsc != NULL )
+        return vlc_spsc_GetBytes( p_owner->p_spsc );
+    return vlc_fifo_GetBytes( p_owner->p_fifo );
+}
+
+/**
+ * Loads the pacing policy of the decoder from its ES category.
+ */
+static void DecoderPaceInit( decoder_t *p_dec, int i_cat )
+{
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+    int64_t size, delay;
+
+    switch( i_cat )
+    {
+        case VIDEO_ES:
+            size = var_InheritInteger( p_dec, "video-decoder-fifo-size" );
+            delay = var_InheritInteger( p_dec, "video-decoder-fifo-delay" );
+            break;
+        case AUDIO_ES:
+            size = var_InheritInteger( p_dec, "audio-decoder-fifo-size" );
+            delay = var_InheritInteger( p_dec, "audio-decoder-fifo-delay" );
+            break;
+        case SPU_ES:
+            size = var_InheritInteger( p_dec, "sub-decoder-fifo-size" );
+            delay = var_InheritInteger( p_dec, "sub-decoder-fifo-delay" );
+            break;
+        default:
+            size = 1024;
+            delay = 0;
+            break;
+    }
+
+    /* Saturate rather than wrap where size_t is 32-bits */
+    uint64_t bytes = (size > 0) ? (uint64_t)size * 1024 : 1024;
+    p_owner->pace.high_bytes = __MIN( bytes, SIZE_MAX );
+    p_owner->pace.low_bytes = p_owner->pace.high_bytes / 4 * 3;
+    p_owner->pace.high_delay = (delay > 0) ? delay * 1000 : 0;
+    p_owner->pace.low_delay = p_owner->pace.high_delay / 4 * 3;
+    p_owner->pace.blocks =
+        __MAX( var_InheritInteger( p_dec, "decoder-fifo-blocks" ), 2 );
+    bytes = __MAX( var_InheritInteger( p_dec, "decoder-fifo-max-size" ), 1 )
+            * (uint64_t)1024;
+    p_owner->pace.max_bytes = __MIN( bytes, SIZE_MAX );
+    p_owner->pace.last_in = VLC_TS_INVALID;
+    atomic_init( &p_owner->pace.last_out, VLC_TS_INVALID );
+    p_owner->pace.waiting = false;
+}
+
+/**
+ * Computes the duration of the data to decode.
+ *
+ * \return the duration, or -1 if unknown
+ */
+static mtime_t DecoderQueueDelay( decoder_owner_sys_t *p_owner )
+{
+    mtime_t last_in = p_owner->pace.last_in;
+    mtime_t last_out = atomic_load_explicit( &p_owner->pace.last_out,
+                                             memory_order_relaxed );
+
+    if( last_in <= VLC_TS_INVALID || last_out <= VLC_TS_INVALID )
+        return -1;
+
+    mtime_t delay = last_in - last_out;
+    /* Timestamps jumped: do not trust them */
+    if( delay < 0 || delay > 60 * CLOCK_FREQ )
+        return -1;
+    return delay;
+}
+
+/**
+ * Checks whether the input should wait before queuing more data.
+ *
+ * \param resume true to check against the low watermarks (the input waits
+ *               already), false to check against the high watermarks
+ * \note The FIFO must be locked, unless the lock-free queue is used.
+ */
+static bool DecoderQueueFull( decoder_owner_sys_t *p_owner, bool resume )
+{
+    size_t count = DecoderQueueCount( p_owner );
+
+    if( count < 2 )
+        return false; /* always let the decoder look ahead one block */
+
+    size_t bytes = DecoderQueueBytes( p_owner );
+    if( bytes >= (resume ? p_owner->pace.low_bytes
+                         : p_owner->pace.high_bytes) )
+        return true;
+
+    mtime_t delay = DecoderQueueDelay( p_owner );
+    if( p_owner->pace.high_delay == 0 || delay < 0 )
+        return count >= p_owner->pace.blocks;
+
+    return delay >= (resume ? p_owner->pace.low_delay
+                            : p_owner->pace.high_delay);
+}
+
+/**
+ * Waits until the decoder has consumed enough data.
+ *
+ * \note The FIFO must be locked.
+ * \return the time spent waiting
+ */
+static mtime_t DecoderPace( decoder_owner_sys_t *p_owner )
+{
+    if( !DecoderQueueFull( p_owner, false ) )
+        return 0;
+
+    mtime_t start = mdate();
+    p_owner->pace.waiting = true;
+    do
+        vlc_fifo_WaitCond( p_owner->p_fifo, &p_owner->wait_fifo );
+    while( DecoderQueueFull( p_owner, true ) );
+    p_owner->pace.waiting = false;
+
+    return mdate() - start;
+}
+
+static void DecoderUpdateStatPace( decoder_owner_sys_t *p_owner,
+                                   mtime_t blocked, unsigned dropped )
+{
+    input_thread_t *p_input = p_owner->p_input;
+
+    if( p_input == NULL || (blocked == 0 && dropped == 0) )
+        return;
+
+    vlc_mutex_lock( &input_priv(p_input)->counters.counters_lock );
+    stats_Update( input_priv(p_input)->counters.p_decoder_blocked,
+                  blocked, NULL );
+    stats_Update( input_priv(p_input)->counters.p_decoder_dropped,
+                  dropped, NULL );
+    vlc_mutex_unlock( &input_priv(p_input)->counters.counters_lock );
+}
+
 static void DecoderPlayCc( decoder_t *p_dec, block_t *p_cc,
                            const decoder_cc_desc_t *p_desc )
 {
@@ -928,11 +1140,11 @@ static void DecoderPlayCc( decoder_t *p_dec, block_t *p_cc,
 
         if( i_bitmap > 1 )
         {
-            block_FifoPut( p_ccdec->p_owner->p_fifo, block_Duplicate(p_cc) );
+            DecoderQueue( p_ccdec->p_owner, block_Duplicate(p_cc) );
         }
         else
         {
-            block_FifoPut( p_ccdec->p_owner->p_fifo, p_cc );
+            DecoderQueue( p_ccdec->p_owner, p_cc );
             p_cc = NULL; /* was last dec */
         }
     }
@@ -1535,6 +1747,10 @@ static void *DecoderThread( void *p_data )
              * for the sake of flushing (glitches could otherwise happen). */
             int canc = vlc_savecancel();
 
+            if( p_owner->p_spsc != NULL )
+                vlc_spsc_Purge( p_owner->p_spsc );
+            atomic_store_explicit( &p_owner->pace.last_out, VLC_TS_INVALID,
+                                   memory_order_relaxed );
             vlc_fifo_Unlock( p_owner->p_fifo );
 
             /* Flush the decoder (and the output) */
@@ -1580,17 +1796,36 @@ static void *DecoderThread( void *p_data )
             continue;
         }
 
-        vlc_cond_signal( &p_owner->wait_fifo );
+        /* Wake the input up only once below the low watermarks */
+        if( p_owner->pace.waiting && !DecoderQueueFull( p_owner, true ) )
+            vlc_cond_signal( &p_owner->wait_fifo );
         vlc_testcancel(); /* forced expedited cancellation in case of stop */
 
-        block_t *p_block = vlc_fifo_DequeueUnlocked( p_owner->p_fifo );
-        if( p_block == NULL )
+        block_t *p_block = (p_owner->p_spsc != NULL)
+                         ? vlc_spsc_Dequeue( p_owner->p_spsc )
+                         : vlc_fifo_DequeueUnlocked( p_owner->p_fifo );
+        if( p_block != NULL )
+        {
+            mtime_t i_time = DecoderBlockTime( p_block );
+
+            if( i_time > VLC_TS_INVALID )
+                atomic_store_explicit( &p_owner->pace.last_out, i_time,
+                                       memory_order_relaxed );
+        }
+        else
         {
             if( likely(!p_owner->b_draining) )
             {   /* Wait for a block to decode (or a request to drain) */
                 p_owner->b_idle = true;
                 vlc_cond_signal( &p_owner->wait_acknowledge );
-                vlc_fifo_Wait( p_owner->p_fifo );
+                if( p_owner->p_spsc == NULL )
+                    vlc_fifo_Wait( p_owner->p_fifo );
+                else
+                {   /* The producer signals the FIFO if we are waiting */
+                    if( vlc_spsc_BeginWait( p_owner->p_spsc ) )
+                        vlc_fifo_Wait( p_owner->p_fifo );
+                    vlc_spsc_EndWait( p_owner->p_spsc );
+                }
                 p_owner->b_idle = false;
                 continue;
             }
@@ -1688,6 +1923,8 @@ static decoder_t * CreateDecoder( vlc_object_t *p_parent,
 
     es_format_Init( &p_owner->fmt, fmt->i_cat, 0 );
 
+    DecoderPaceInit( p_dec, fmt->i_cat );
+
     /* decoder fifo */
     p_owner->p_fifo = block_FifoNew();
     if( unlikely(p_owner->p_fifo == NULL) )
@@ -1697,6 +1934,21 @@ static decoder_t * CreateDecoder( vlc_object_t *p_parent,
         return NULL;
     }
 
+    /* Decoders of an input are fed by a single thread: the input thread (or
+     * the timeshift thread), or the decoder thread of a CC parent. */
+    p_owner->p_spsc = NULL;
+    if( p_input != NULL )
+    {
+        p_owner->p_spsc = vlc_spsc_New();
+        if( unlikely(p_owner->p_spsc == NULL) )
+        {
+            block_FifoRelease( p_owner->p_fifo );
+            free( p_owner );
+            vlc_object_release( p_dec );
+            return NULL;
+        }
+    }
+
     vlc_mutex_init( &p_owner->lock );
     vlc_cond_init( &p_owner->wait_request );
     vlc_cond_init( &p_owner->wait_acknowledge );
@@ -1803,6 +2055,8 @@ static void DeleteDecoder( decoder_t * p_dec )
     UnloadDecoder( p_dec );
 
     /* Free all packets still in the decoder fifo. */
+    if( p_owner->p_spsc != NULL )
+        vlc_spsc_Delete( p_owner->p_spsc );
     block_FifoRelease( p_owner->p_fifo );
 
     /* Cleanup */
@@ -2015,17 +2269,44 @@ void input_DecoderDelete( decoder_t *p_dec )
 void input_DecoderDecode( decoder_t *p_dec, block_t *p_block, bool b_do_pace )
 {
     decoder_owner_sys_t *p_owner = p_dec->p_owner;
+    vlc_spsc_t *p_spsc = p_owner->p_spsc;
+    mtime_t i_blocked = 0;
+    unsigned i_dropped = 0;
+
+    if( p_spsc != NULL )
+    {   /* Same as below, but the FIFO is locked only to wait */
+        if( !b_do_pace )
+        {
+            if( vlc_spsc_GetBytes( p_spsc ) > p_owner->pace.max_bytes )
+            {
+                msg_Warn( p_dec, "decoder/packetizer fifo full (data not "
+                          "consumed quickly enough), resetting fifo!" );
+                i_dropped = vlc_spsc_GetCount( p_spsc );
+                vlc_spsc_Flush( p_spsc );
+            }
+        }
+        else
+        if( !p_owner->b_waiting && DecoderQueueFull( p_owner, false ) )
+        {
+            vlc_fifo_Lock( p_owner->p_fifo );
+            i_blocked = DecoderPace( p_owner );
+            vlc_fifo_Unlock( p_owner->p_fifo );
+        }
+
+        DecoderQueue( p_owner, p_block );
+        DecoderUpdateStatPace( p_owner, i_blocked, i_dropped );
+        return;
+    }
 
     vlc_fifo_Lock( p_owner->p_fifo );
     if( !b_do_pace )
     {
-        /* FIXME: ideally we would check the time amount of data
-         * in the FIFO instead of its size. */
-        /* 400 MiB, i.e. ~ 50mb/s for 60s */
-        if( vlc_fifo_GetBytes( p_owner->p_fifo ) > 400*1024*1024 )
+        /* 400 MiB by default, i.e. ~ 50mb/s for 60s */
+        if( vlc_fifo_GetBytes( p_owner->p_fifo ) > p_owner->pace.max_bytes )
         {
             msg_Warn( p_dec, "decoder/packetizer fifo full (data not "
                       "consumed quickly enough), resetting fifo!" );
+            i_dropped = vlc_fifo_GetCount( p_owner->p_fifo );
             block_ChainRelease( vlc_fifo_DequeueAllUnlocked( p_owner->p_fifo ) );
         }
     }
@@ -2034,12 +2315,13 @@ void input_DecoderDecode( decoder_t *p_dec, block_t *p_block, bool b_do_pace )
     {   /* The FIFO is not consumed when waiting, so pacing would deadlock VLC.
          * Locking is not necessary as b_waiting is only read, not written by
          * the decoder thread. */
-        while( vlc_fifo_GetCount( p_owner->p_fifo ) >= 10 )
-            vlc_fifo_WaitCond( p_owner->p_fifo, &p_owner->wait_fifo );
+        i_blocked = DecoderPace( p_owner );
     }
 
+    DecoderPaceQueued( p_owner, p_block );
     vlc_fifo_QueueUnlocked( p_owner->p_fifo, p_block );
     vlc_fifo_Unlock( p_owner->p_fifo );
+    DecoderUpdateStatPace( p_owner, i_blocked, i_dropped );
 }
 
 bool input_DecoderIsEmpty( decoder_t * p_dec )
@@ -2049,7 +2331,7 @@ bool input_DecoderIsEmpty( decoder_t * p_dec )
     assert( !p_owner->b_waiting );
 
     vlc_fifo_Lock( p_owner->p_fifo );
-    if( !vlc_fifo_IsEmpty( p_dec->p_owner->p_fifo ) || p_owner->b_draining )
+    if( DecoderQueueCount( p_owner ) > 0 || p_owner->b_draining )
     {
         vlc_fifo_Unlock( p_owner->p_fifo );
         return false;
@@ -2104,7 +2386,11 @@ void input_DecoderFlush( decoder_t *p_dec )
     vlc_fifo_Lock( p_owner->p_fifo );
 
     /* Empty the fifo */
-    block_ChainRelease( vlc_fifo_DequeueAllUnlocked( p_owner->p_fifo ) );
+    if( p_owner->p_spsc != NULL )
+        vlc_spsc_Flush( p_owner->p_spsc );
+    else
+        block_ChainRelease( vlc_fifo_DequeueAllUnlocked( p_owner->p_fifo ) );
+    p_owner->pace.last_in = VLC_TS_INVALID;
 
     /* Don't need to wait for the DecoderThread to flush. Indeed, if called a
      * second time, this function will clear the FIFO again before anything was
@@ -2289,7 +2575,7 @@ void input_DecoderWait( decoder_t *p_dec )
         if( p_owner->paused )
             break;
         vlc_fifo_Lock( p_owner->p_fifo );
-        if( p_owner->b_idle && vlc_fifo_IsEmpty( p_owner->p_fifo ) )
+        if( p_owner->b_idle && DecoderQueueCount( p_owner ) == 0 )
         {
             msg_Err( p_dec, "buffer deadlock prevented" );
             vlc_fifo_Unlock( p_owner->p_fifo );
@@ -2354,6 +2640,8 @@ size_t input_DecoderGetFifoSize( decoder_t *p_dec )
 {
     decoder_owner_sys_t *p_owner = p_dec->p_owner;
 
+    if( p_owner->p_spsc != NULL )
+        return vlc_spsc_GetBytes( p_owner->p_spsc );
     return block_FifoSize( p_owner->p_fifo );
 }
 
@@ -37,6 +37,13 @@
 #endif
 #include <sys/stat.h>
 #include <unistd.h>
+#if defined(HAVE_MMAP) && defined(HAVE_POSIX_FALLOCATE)
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  define TS_USE_MMAP 1
+/* Disk space reserved at once */
+#  define TS_ALLOC_SIZE (INT64_C(1) << 20)
+#endif
 
 #include <vlc_common.h>
 #include <vlc_fs.h>
@@ -161,17 +168,43 @@ typedef struct attribute_packed
     } u;
 } ts_cmd_t;
 
+/* Stored block header (the data follows) */
+typedef struct
+{
+    size_t   i_buffer;
+    uint32_t i_flags;
+    unsigned i_nb_samples;
+    mtime_t  i_pts;
+    mtime_t  i_dts;
+    mtime_t  i_length;
+} ts_block_t;
+
+/* Commands per storage */
+#define TS_CMD_MAX (30000)
+
+/* Random access point */
+typedef struct
+{
+    mtime_t i_time; /* Input time */
+    int     i_cmd;  /* Command index in the storage */
+} ts_index_t;
+
 typedef struct ts_storage_t ts_storage_t;
 struct ts_storage_t
 {
     ts_storage_t *p_next;
 
     /* */
+    size_t  i_file_max; /* Max size in bytes */
+    int64_t i_file_size;/* Current size in bytes */
+#ifdef TS_USE_MMAP
+    int      fd;        /* Preallocated file, -1 if stdio is used */
+    uint8_t *p_map;     /* Shared mapping of the whole file, or NULL */
+    int64_t  i_file_alloc; /* Reserved size in bytes */
+#endif
 #ifdef _WIN32
     char    *psz_file;  /* Filename */
 #endif
-    size_t  i_file_max; /* Max size in bytes */
-    int64_t i_file_size;/* Current size in bytes */
     FILE    *p_filew;   /* FILE handle for data writing */
     FILE    *p_filer;   /* FILE handle for data reading */
 
@@ -180,6 +213,11 @@ struct ts_storage_t
     int      i_cmd_w;
     int      i_cmd_max;
     ts_cmd_t *p_cmd;
+
+    /* Time index (sorted by command and time) */
+    int        i_index;
+    int        i_index_max;
+    ts_index_t *p_index;
 };
 
 typedef struct
@@ -188,6 +226,7 @@ typedef struct
     input_thread_t *p_input;
     es_out_t       *p_out;
     int64_t        i_tmp_size_max;
+    int64_t        i_size_max;
     const char     *psz_tmp_path;
 
     /* Lock for all following fields */
@@ -210,9 +249,24 @@ typedef struct
     /* */
     ts_storage_t   *p_storage_r;
     ts_storage_t   *p_storage_w;
+    ts_storage_t   *p_storage_free; /* Storage read, kept for reuse */
+    int64_t        i_size;          /* Stored data size in bytes */
+    unsigned       i_dropped;       /* Blocks dropped since the buffer is full */
 
     mtime_t        i_cmd_delay;
 
+    /* Time index */
+    mtime_t        i_time;          /* Last input time pushed */
+    mtime_t        i_index_time;    /* Last input time indexed */
+    bool           b_keyframes;     /* Key frames are flagged */
+
+    /* Pending jump */
+    struct
+    {
+        ts_storage_t *p_storage;    /* NULL if none */
+        int          i_cmd;
+    } seek;
+
 } ts_thread_t;
 
 struct es_out_id_t
@@ -227,6 +281,7 @@ struct es_out_sys_t
 
     /* Configuration */
     int64_t        i_tmp_size_max;    /* Maximal temporary file size in byte */
+    int64_t        i_size_max;        /* Maximal total size in byte (0=none) */
     char           *psz_tmp_path;     /* Path for temporary files */
 
     /* Lock for all following fields */
@@ -263,16 +318,21 @@ static bool         TsHasCmd( ts_thread_t * );
 static bool         TsIsUnused( ts_thread_t * );
 static int          TsChangePause( ts_thread_t *, bool b_source_paused, bool b_paused, mtime_t i_date );
 static int          TsChangeRate( ts_thread_t *, int i_src_rate, int i_rate );
+static int          TsSeek( ts_thread_t *, mtime_t i_time );
+static void         TsSeekLocked( ts_thread_t * );
 
 static void         *TsRun( void * );
 
 static ts_storage_t *TsStorageNew( const char *psz_path, int64_t i_tmp_size_max );
 static void         TsStorageDelete( ts_storage_t * );
+static int          TsStorageReset( ts_storage_t * );
 static void         TsStoragePack( ts_storage_t *p_storage );
+static void         TsStorageUnmap( ts_storage_t *p_storage );
 static bool         TsStorageIsFull( ts_storage_t *, const ts_cmd_t *p_cmd );
 static bool         TsStorageIsEmpty( ts_storage_t * );
-static void         TsStoragePushCmd( ts_storage_t *, const ts_cmd_t *p_cmd, bool b_flush );
+static int          TsStoragePushCmd( ts_storage_t *, const ts_cmd_t *p_cmd, bool b_flush, mtime_t i_index_time );
 static void         TsStoragePopCmd( ts_storage_t *p_storage, ts_cmd_t *p_cmd, bool b_flush );
+static int          TsStorageSeekIndex( const ts_storage_t *, mtime_t i_time );
 
 static void CmdClean( ts_cmd_t * );
 static void cmd_cleanup_routine( void *p ) { CmdClean( p ); }
@@ -344,6 +404,12 @@ es_out_t *input_EsOutTimeshiftNew( input_thread_t *p_input, es_out_t *p_next_out
     msg_Dbg( p_input, "using timeshift granularity of %d MiB",
              (int)p_sys->i_tmp_size_max/(1024*1024) );
 
+    const int64_t i_size_max = var_InheritInteger( p_input, "input-timeshift-max-size" );
+    p_sys->i_size_max = __MAX( i_size_max, 0 ) * 1024 * 1024;
+    if( p_sys->i_size_max > 0 )
+        msg_Dbg( p_input, "using timeshift size limit of %"PRId64" MiB",
+                 i_size_max );
+
     p_sys->psz_tmp_path = var_InheritString( p_input, "input-timeshift-path" );
 #if defined (_WIN32) && !VLC_WINSTORE_APP
     if( p_sys->psz_tmp_path == NULL )
@@ -609,7 +675,15 @@ static int ControlLockedSetTime( es_out_t *p_out, mtime_t i_date )
     es_out_sys_t *p_sys = p_out->p_sys;
 
     if( !p_sys->b_delayed )
+    {
+        if( i_date >= 0 )
+            return VLC_EGENERIC; /* Nothing to jump into */
         return es_out_SetTime( p_sys->p_out, i_date );
+    }
+
+    /* Jump inside the timeshift buffer */
+    if( i_date >= 0 )
+        return TsSeek( p_sys->p_ts, i_date );
 
     /* TODO */
     msg_Err( p_sys->p_input, "EsOutTimeshift does not yet support time change" );
@@ -787,6 +861,7 @@ static int TsStart( es_out_t *p_out )
         return VLC_EGENERIC;
 
     p_ts->i_tmp_size_max = p_sys->i_tmp_size_max;
+    p_ts->i_size_max = p_sys->i_size_max;
     p_ts->psz_tmp_path = p_sys->psz_tmp_path;
     p_ts->p_input = p_sys->p_input;
     p_ts->p_out = p_sys->p_out;
@@ -802,6 +877,13 @@ static int TsStart( es_out_t *p_out )
     p_ts->i_cmd_delay = 0;
     p_ts->p_storage_r = NULL;
     p_ts->p_storage_w = NULL;
+    p_ts->p_storage_free = NULL;
+    p_ts->i_size = 0;
+    p_ts->i_dropped = 0;
+    p_ts->i_time = -1;
+    p_ts->i_index_time = -1;
+    p_ts->b_keyframes = false;
+    p_ts->seek.p_storage = NULL;
 
     p_sys->b_delayed = true;
     if( vlc_clone( &p_ts->thread, TsRun, p_ts, VLC_THREAD_PRIORITY_INPUT ) )
@@ -846,17 +928,101 @@ static void TsStop( ts_thread_t *p_ts )
     assert( !p_ts->p_storage_r || !p_ts->p_storage_r->p_next );
     if( p_ts->p_storage_r )
         TsStorageDelete( p_ts->p_storage_r );
+    if( p_ts->p_storage_free )
+        TsStorageDelete( p_ts->p_storage_free );
     vlc_mutex_unlock( &p_ts->lock );
 
     TsDestroy( p_ts );
 }
+/* Tells if a block is a good place to jump to */
+static bool TsIsRandomAccess( ts_thread_t *p_ts, const block_t *p_block )
+{
+    if( p_ts->i_time < 0 )
+        return false;
+    if( p_block->i_flags & BLOCK_FLAG_TYPE_I )
+    {
+        p_ts->b_keyframes = true;
+        return true;
+    }
+    /* Without key frame flags, index every input time update: the decoders
+     * will resynchronize by themselves */
+    return !p_ts->b_keyframes && p_ts->i_time != p_ts->i_index_time;
+}
+/* Makes the thread skip the storage being read, so that it is reused for
+ * the new data */
+static void TsDropOldestLocked( ts_thread_t *p_ts )
+{
+    ts_storage_t *p_oldest = p_ts->p_storage_r;
+
+    vlc_assert_locked( &p_ts->lock );
+
+    /* The storage being written cannot be dropped, and a jump beyond the
+     * oldest storage already drops it */
+    if( p_oldest == NULL || p_oldest->p_next == NULL ||
+        ( p_ts->seek.p_storage != NULL && p_ts->seek.p_storage != p_oldest ) )
+        return;
+
+    msg_Warn( p_ts->p_input, "timeshift buffer is full, dropping its "
+              "oldest %"PRId64" bytes", p_oldest->i_file_size );
+
+    /* Resume at the first random access point of the next storage */
+    ts_storage_t *p_next = p_oldest->p_next;
+    p_ts->seek.p_storage = p_next;
+    p_ts->seek.i_cmd = p_next->i_index > 0 ? p_next->p_index[0].i_cmd : 0;
+    vlc_cond_signal( &p_ts->wait );
+}
 static void TsPushCmd( ts_thread_t *p_ts, ts_cmd_t *p_cmd )
 {
+    mtime_t i_index_time = -1;
+    size_t i_size = 0;
+
     vlc_mutex_lock( &p_ts->lock );
 
+    if( p_cmd->i_type == C_CONTROL &&
+        p_cmd->u.control.i_query == ES_OUT_SET_TIMES )
+        p_ts->i_time = p_cmd->u.control.u.times.i_time;
+
+    if( p_cmd->i_type == C_SEND )
+    {
+        const block_t *p_block = p_cmd->u.send.p_block;
+
+        i_size = sizeof(ts_block_t) + p_block->i_buffer;
+        if( p_ts->i_size_max > 0 &&
+            p_ts->i_size + (int64_t)i_size > p_ts->i_size_max )
+            TsDropOldestLocked( p_ts );
+        /* While the thread catches up, the buffer grows by one storage at
+         * most */
+        if( p_ts->i_size_max > 0 &&
+            p_ts->i_size + (int64_t)i_size > p_ts->i_size_max + p_ts->i_tmp_size_max )
+        {
+            if( p_ts->i_dropped++ == 0 )
+                msg_Warn( p_ts->p_input, "timeshift buffer is full, "
+                          "dropping data" );
+            CmdClean( p_cmd );
+            vlc_mutex_unlock( &p_ts->lock );
+            return;
+        }
+        if( p_ts->i_dropped > 0 )
+        {
+            msg_Dbg( p_ts->p_input, "dropped %u blocks", p_ts->i_dropped );
+            p_ts->i_dropped = 0;
+        }
+
+        if( TsIsRandomAccess( p_ts, p_block ) )
+            i_index_time = p_ts->i_index_time = p_ts->i_time;
+    }
+
     if( !p_ts->p_storage_w || TsStorageIsFull( p_ts->p_storage_w, p_cmd ) )
     {
-        ts_storage_t *p_storage = TsStorageNew( p_ts->psz_tmp_path, p_ts->i_tmp_size_max );
+        ts_storage_t *p_storage = p_ts->p_storage_free;
+
+        /* A block bigger than the granularity gets its own storage */
+        if( p_storage && (int64_t)i_size <= p_ts->i_tmp_size_max )
+            p_ts->p_storage_free = NULL;
+        else
+            p_storage = TsStorageNew( p_ts->psz_tmp_path,
+                                      __MAX( p_ts->i_tmp_size_max,
+                                             (int64_t)i_size ) );
 
         if( !p_storage )
         {
@@ -873,13 +1039,21 @@ static void TsPushCmd( ts_thread_t *p_ts, ts_cmd_t *p_cmd )
         else
         {
             TsStoragePack( p_ts->p_storage_w );
+            /* Only the storages being written and read stay mapped */
+            if( p_ts->p_storage_w != p_ts->p_storage_r )
+                TsStorageUnmap( p_ts->p_storage_w );
             p_ts->p_storage_w->p_next = p_storage;
             p_ts->p_storage_w = p_storage;
         }
     }
 
-    /* TODO return error and warn the user (but only once) */
-    TsStoragePushCmd( p_ts->p_storage_w, p_cmd, p_ts->p_storage_r == p_ts->p_storage_w );
+    if( TsStoragePushCmd( p_ts->p_storage_w, p_cmd,
+                          p_ts->p_storage_r == p_ts->p_storage_w,
+                          i_index_time ) == VLC_SUCCESS )
+        p_ts->i_size += i_size;
+    else if( p_ts->i_dropped++ == 0 )
+        msg_Warn( p_ts->p_input, "cannot write to the timeshift buffer, "
+                  "dropping data" );
 
     vlc_cond_signal( &p_ts->wait );
 
@@ -900,7 +1074,14 @@ static int TsPopCmdLocked( ts_thread_t *p_ts, ts_cmd_t *p_cmd, bool b_flush )
         if( !p_next )
             break;
 
-        TsStorageDelete( p_ts->p_storage_r );
+        p_ts->i_size -= p_ts->p_storage_r->i_file_size;
+        /* Keep one storage of the usual size for the next data */
+        if( p_ts->p_storage_free == NULL &&
+            (int64_t)p_ts->p_storage_r->i_file_max == p_ts->i_tmp_size_max &&
+            TsStorageReset( p_ts->p_storage_r ) == VLC_SUCCESS )
+            p_ts->p_storage_free = p_ts->p_storage_r;
+        else
+            TsStorageDelete( p_ts->p_storage_r );
         p_ts->p_storage_r = p_next;
     }
 
@@ -977,11 +1158,108 @@ static int TsChangeRate( ts_thread_t *p_ts, int i_src_rate, int i_rate )
 
     return i_ret;
 }
+static int TsSeek( ts_thread_t *p_ts, mtime_t i_time )
+{
+    ts_storage_t *p_target = NULL;
+    int i_target = -1;
+
+    vlc_mutex_lock( &p_ts->lock );
+
+    /* Find the last random access point at or before the requested time.
+     * Only the commands not executed yet are available: it is possible to
+     * jump forward (up to the live edge), but not before the current
+     * position. */
+    for( ts_storage_t *p_storage = p_ts->p_storage_r;
+         p_storage != NULL; p_storage = p_storage->p_next )
+    {
+        const int i_index = TsStorageSeekIndex( p_storage, i_time );
+        if( i_index < 0 )
+        {
+            const int i_last = p_storage->i_index - 1;
+
+            /* Stop if there are points, all after the requested time */
+            if( i_last >= 0 &&
+                p_storage->p_index[i_last].i_cmd >= p_storage->i_cmd_r )
+                break;
+            continue;
+        }
+
+        p_target = p_storage;
+        i_target = p_storage->p_index[i_index].i_cmd;
+        if( i_index + 1 < p_storage->i_index )
+            break; /* The next point is after the requested time */
+    }
+
+    if( p_target != NULL )
+    {
+        p_ts->seek.p_storage = p_target;
+        p_ts->seek.i_cmd = i_target;
+        vlc_cond_signal( &p_ts->wait );
+    }
+    vlc_mutex_unlock( &p_ts->lock );
+
+    if( p_target == NULL )
+    {
+        msg_Warn( p_ts->p_input, "cannot jump to %"PRId64" (outside the "
+                  "timeshift buffer)", i_time );
+        return VLC_EGENERIC;
+    }
+    return VLC_SUCCESS;
+}
+static void TsSeekLocked( ts_thread_t *p_ts )
+{
+    ts_storage_t *p_target = p_ts->seek.p_storage;
+    const int i_target = p_ts->seek.i_cmd;
+    unsigned i_skipped = 0;
+
+    vlc_assert_locked( &p_ts->lock );
+    p_ts->seek.p_storage = NULL;
+
+    /* Skip the data up to the target, but keep the ES state up to date */
+    while( p_ts->p_storage_r != p_target || p_target->i_cmd_r < i_target )
+    {
+        ts_cmd_t cmd;
+
+        if( TsPopCmdLocked( p_ts, &cmd, true ) )
+            break;
+
+        switch( cmd.i_type )
+        {
+        case C_ADD:
+            CmdExecuteAdd( p_ts->p_out, &cmd );
+            CmdCleanAdd( &cmd );
+            break;
+        case C_SEND:
+            CmdCleanSend( &cmd );
+            i_skipped++;
+            break;
+        case C_CONTROL:
+            /* Skipped clock references are meaningless */
+            if( cmd.u.control.i_query != ES_OUT_SET_PCR &&
+                cmd.u.control.i_query != ES_OUT_SET_GROUP_PCR &&
+                cmd.u.control.i_query != ES_OUT_SET_NEXT_DISPLAY_TIME )
+                CmdExecuteControl( p_ts->p_out, &cmd );
+            CmdCleanControl( &cmd );
+            break;
+        case C_DEL:
+            CmdExecuteDel( p_ts->p_out, &cmd );
+            break;
+        default:
+            vlc_assert_unreachable();
+            break;
+        }
+    }
+    msg_Dbg( p_ts->p_input, "timeshift jump: %u blocks skipped", i_skipped );
+
+    /* Reset the decoders and the clock */
+    es_out_SetTime( p_ts->p_out, -1 );
+}
 
 static void *TsRun( void *p_data )
 {
     ts_thread_t *p_ts = p_data;
     mtime_t i_buffering_date = -1;
+    bool b_seek = false;
 
     for( ;; )
     {
@@ -996,6 +1274,11 @@ static void *TsRun( void *p_data )
         for( ;; )
         {
             const int canc = vlc_savecancel();
+            if( p_ts->seek.p_storage != NULL )
+            {
+                TsSeekLocked( p_ts );
+                b_seek = true;
+            }
             b_buffering = es_out_GetBuffering( p_ts->p_out );
 
             if( ( !p_ts->b_paused || b_buffering ) && !TsPopCmdLocked( p_ts, &cmd, false ) )
@@ -1008,6 +1291,16 @@ static void *TsRun( void *p_data )
             vlc_cond_wait( &p_ts->wait, &p_ts->lock );
         }
 
+        if( b_seek )
+        {
+            /* Play the jump target now */
+            p_ts->i_cmd_delay = mdate() - cmd.i_date;
+            p_ts->i_buffering_delay = 0;
+            p_ts->i_rate_date = -1;
+            i_buffering_date = -1;
+            b_seek = false;
+        }
+
         if( b_buffering && i_buffering_date < 0 )
         {
             i_buffering_date = cmd.i_date;
@@ -1114,38 +1407,61 @@ static ts_storage_t *TsStorageNew( const char *psz_tmp_path, int64_t i_tmp_size_
         return NULL;
     }
 
-    p_storage->p_filew = fdopen( fd, "w+b" );
-    if( p_storage->p_filew == NULL )
+#ifdef TS_USE_MMAP
+    /* The disk space is reserved as the data is written, so that a full disk
+     * fails when storing a block rather than with SIGBUS when writing to the
+     * mapping. Blocks are copied to/from the mapping without any stdio
+     * call. */
+    p_storage->p_map = NULL;
+    p_storage->fd = -1;
+    p_storage->i_file_alloc = __MIN( i_tmp_size_max, TS_ALLOC_SIZE );
+    if( posix_fallocate( fd, 0, p_storage->i_file_alloc ) == 0 )
     {
-        vlc_close( fd );
+        p_storage->fd = fd;
         vlc_unlink( psz_file );
-        goto error;
+        free( psz_file );
     }
-
-    p_storage->p_filer = vlc_fopen( psz_file, "rb" );
-    if( p_storage->p_filer == NULL )
+    else
+#endif
     {
-        fclose( p_storage->p_filew );
-        vlc_unlink( psz_file );
-        goto error;
-    }
+        p_storage->p_filew = fdopen( fd, "w+b" );
+        if( p_storage->p_filew == NULL )
+        {
+            vlc_close( fd );
+            vlc_unlink( psz_file );
+            goto error;
+        }
+
+        p_storage->p_filer = vlc_fopen( psz_file, "rb" );
+        if( p_storage->p_filer == NULL )
+        {
+            fclose( p_storage->p_filew );
+            vlc_unlink( psz_file );
+            goto error;
+        }
 
 #ifndef _WIN32
-    vlc_unlink( psz_file );
-    free( psz_file );
+        vlc_unlink( psz_file );
+        free( psz_file );
 #else
-    p_storage->psz_file = psz_file;
+        p_storage->psz_file = psz_file;
 #endif
+    }
     p_storage->p_next = NULL;
 
     /* */
     p_storage->i_file_max = i_tmp_size_max;
     p_storage->i_file_size = 0;
 
+    /* */
+    p_storage->i_index = 0;
+    p_storage->i_index_max = 0;
+    p_storage->p_index = NULL;
+
     /* */
     p_storage->i_cmd_w = 0;
     p_storage->i_cmd_r = 0;
-    p_storage->i_cmd_max = 30000;
+    p_storage->i_cmd_max = TS_CMD_MAX;
     p_storage->p_cmd = malloc( p_storage->i_cmd_max * sizeof(*p_storage->p_cmd) );
     //fprintf( stderr, "\nSTORAGE name=%s size=%d KiB\n", p_storage->psz_file, p_storage->i_cmd_max * sizeof(*p_storage->p_cmd) /1024 );
 
@@ -1172,16 +1488,87 @@ static void TsStorageDelete( ts_storage_t *p_storage )
         CmdClean( &cmd );
     }
     free( p_storage->p_cmd );
+    free( p_storage->p_index );
 
-    fclose( p_storage->p_filer );
-    fclose( p_storage->p_filew );
+#ifdef TS_USE_MMAP
+    if( p_storage->fd != -1 )
+    {
+        TsStorageUnmap( p_storage );
+        vlc_close( p_storage->fd );
+    }
+    else
+#endif
+    {
+        fclose( p_storage->p_filer );
+        fclose( p_storage->p_filew );
 #ifdef _WIN32
-    vlc_unlink( p_storage->psz_file );
-    free( p_storage->psz_file );
+        vlc_unlink( p_storage->psz_file );
+        free( p_storage->psz_file );
 #endif
+    }
     free( p_storage );
 }
 
+/* Empties a storage read, so that it can be written again */
+static int TsStorageReset( ts_storage_t *p_storage )
+{
+    assert( TsStorageIsEmpty( p_storage ) );
+
+    /* Undo TsStoragePack() */
+    if( p_storage->i_cmd_max < TS_CMD_MAX )
+    {
+        ts_cmd_t *p_new = realloc( p_storage->p_cmd,
+                                   TS_CMD_MAX * sizeof(*p_storage->p_cmd) );
+        if( p_new == NULL )
+            return VLC_ENOMEM;
+        p_storage->p_cmd = p_new;
+        p_storage->i_cmd_max = TS_CMD_MAX;
+    }
+#ifdef TS_USE_MMAP
+    if( p_storage->fd != -1 )
+        TsStorageUnmap( p_storage );
+    else
+#endif
+    if( fseek( p_storage->p_filew, 0, SEEK_SET ) )
+        return VLC_EGENERIC;
+
+    p_storage->p_next = NULL;
+    p_storage->i_file_size = 0;
+    p_storage->i_index = 0;
+    p_storage->i_cmd_w = 0;
+    p_storage->i_cmd_r = 0;
+    return VLC_SUCCESS;
+}
+
+#ifdef TS_USE_MMAP
+static int TsStorageMap( ts_storage_t *p_storage )
+{
+    if( p_storage->p_map != NULL )
+        return VLC_SUCCESS;
+
+    void *p_map = mmap( NULL, p_storage->i_file_max, PROT_READ|PROT_WRITE,
+                        MAP_SHARED, p_storage->fd, 0 );
+    if( p_map == MAP_FAILED )
+        return VLC_ENOMEM;
+    p_storage->p_map = p_map;
+    return VLC_SUCCESS;
+}
+#endif
+
+/* Releases the address space of a storage neither written nor read */
+static void TsStorageUnmap( ts_storage_t *p_storage )
+{
+#ifdef TS_USE_MMAP
+    if( p_storage->p_map != NULL )
+    {
+        munmap( p_storage->p_map, p_storage->i_file_max );
+        p_storage->p_map = NULL;
+    }
+#else
+    VLC_UNUSED(p_storage);
+#endif
+}
+
 static void TsStoragePack( ts_storage_t *p_storage )
 {
     /* Try to release a bit of memory */
@@ -1196,11 +1583,11 @@ static void TsStoragePack( ts_storage_t *p_storage )
 }
 static bool TsStorageIsFull( ts_storage_t *p_storage, const ts_cmd_t *p_cmd )
 {
-    if( p_cmd && p_cmd->i_type == C_SEND && p_storage->i_cmd_w > 0 )
+    if( p_cmd && p_cmd->i_type == C_SEND )
     {
-        size_t i_size = sizeof(*p_cmd->u.send.p_block) + p_cmd->u.send.p_block->i_buffer;
+        size_t i_size = sizeof(ts_block_t) + p_cmd->u.send.p_block->i_buffer;
 
-        if( p_storage->i_file_size + i_size >= p_storage->i_file_max )
+        if( p_storage->i_file_size + i_size > p_storage->i_file_max )
             return true;
     }
     return p_storage->i_cmd_w >= p_storage->i_cmd_max;
@@ -1209,7 +1596,8 @@ static bool TsStorageIsEmpty( ts_storage_t *p_storage )
 {
     return !p_storage || p_storage->i_cmd_r >= p_storage->i_cmd_w;
 }
-static void TsStoragePushCmd( ts_storage_t *p_storage, const ts_cmd_t *p_cmd, bool b_flush )
+static int TsStoragePushCmd( ts_storage_t *p_storage, const ts_cmd_t *p_cmd, bool b_flush,
+                             mtime_t i_index_time )
 {
     ts_cmd_t cmd = *p_cmd;
 
@@ -1218,31 +1606,92 @@ static void TsStoragePushCmd( ts_storage_t *p_storage, const ts_cmd_t *p_cmd, bo
     if( cmd.i_type == C_SEND )
     {
         block_t *p_block = cmd.u.send.p_block;
+        const ts_block_t header = {
+            .i_buffer = p_block->i_buffer,
+            .i_flags = p_block->i_flags,
+            .i_nb_samples = p_block->i_nb_samples,
+            .i_pts = p_block->i_pts,
+            .i_dts = p_block->i_dts,
+            .i_length = p_block->i_length,
+        };
+
+        const int64_t i_end = p_storage->i_file_size + sizeof(header)
+                            + p_block->i_buffer;
 
         cmd.u.send.p_block = NULL;
-        cmd.u.send.i_offset = ftell( p_storage->p_filew );
+        cmd.u.send.i_offset = p_storage->i_file_size;
 
-        if( fwrite( p_block, sizeof(*p_block), 1, p_storage->p_filew ) != 1 )
+#ifdef TS_USE_MMAP
+        if( p_storage->fd != -1 )
         {
-            block_Release( p_block );
-            return;
+            if( i_end > p_storage->i_file_alloc )
+            {
+                const int64_t i_alloc = __MIN( __MAX( i_end,
+                        p_storage->i_file_alloc + TS_ALLOC_SIZE ),
+                        (int64_t)p_storage->i_file_max );
+
+                if( posix_fallocate( p_storage->fd, p_storage->i_file_alloc,
+                                     i_alloc - p_storage->i_file_alloc ) )
+                {
+                    block_Release( p_block );
+                    return VLC_EGENERIC;
+                }
+                p_storage->i_file_alloc = i_alloc;
+            }
+            if( TsStorageMap( p_storage ) )
+            {
+                block_Release( p_block );
+                return VLC_ENOMEM;
+            }
+
+            uint8_t *p = p_storage->p_map + p_storage->i_file_size;
+
+            memcpy( p, &header, sizeof(header) );
+            if( p_block->i_buffer > 0 )
+                memcpy( p + sizeof(header), p_block->p_buffer, p_block->i_buffer );
         }
-        p_storage->i_file_size += sizeof(*p_block);
-        if( p_block->i_buffer > 0 )
+        else
+#endif
         {
-            if( fwrite( p_block->p_buffer, p_block->i_buffer, 1, p_storage->p_filew ) != 1 )
+            if( fwrite( &header, sizeof(header), 1, p_storage->p_filew ) != 1 ||
+                ( p_block->i_buffer > 0 &&
+                  fwrite( p_block->p_buffer, p_block->i_buffer, 1, p_storage->p_filew ) != 1 ) )
             {
+                /* The next block overwrites the partial one */
+                fseek( p_storage->p_filew, p_storage->i_file_size, SEEK_SET );
                 block_Release( p_block );
-                return;
+                return VLC_EGENERIC;
             }
+            if( b_flush )
+                fflush( p_storage->p_filew );
         }
-        p_storage->i_file_size += p_block->i_buffer;
+        p_storage->i_file_size = i_end;
         block_Release( p_block );
+    }
 
-        if( b_flush )
-            fflush( p_storage->p_filew );
+    if( i_index_time >= 0 )
+    {
+        if( p_storage->i_index >= p_storage->i_index_max )
+        {
+            const int i_max = __MAX( 2 * p_storage->i_index_max, 64 );
+            ts_index_t *p_new = realloc( p_storage->p_index,
+                                         i_max * sizeof(*p_new) );
+            if( p_new )
+            {
+                p_storage->p_index = p_new;
+                p_storage->i_index_max = i_max;
+            }
+        }
+        if( p_storage->i_index < p_storage->i_index_max )
+        {
+            ts_index_t *p_entry = &p_storage->p_index[p_storage->i_index++];
+
+            p_entry->i_time = i_index_time;
+            p_entry->i_cmd = p_storage->i_cmd_w;
+        }
     }
     p_storage->p_cmd[p_storage->i_cmd_w++] = cmd;
+    return VLC_SUCCESS;
 }
 static void TsStoragePopCmd( ts_storage_t *p_storage, ts_cmd_t *p_cmd, bool b_flush )
 {
@@ -1251,30 +1700,80 @@ static void TsStoragePopCmd( ts_storage_t *p_storage, ts_cmd_t *p_cmd, bool b_fl
     *p_cmd = p_storage->p_cmd[p_storage->i_cmd_r++];
     if( p_cmd->i_type == C_SEND )
     {
-        block_t block;
+        ts_block_t header;
+        block_t *p_block = NULL;
 
-        if( !b_flush &&
-            !fseek( p_storage->p_filer, p_cmd->u.send.i_offset, SEEK_SET ) &&
-            fread( &block, sizeof(block), 1, p_storage->p_filer ) == 1 )
+        if( b_flush )
         {
-            block_t *p_block = block_Alloc( block.i_buffer );
-            if( p_block )
+            /* The data are not needed */
+        }
+#ifdef TS_USE_MMAP
+        else if( p_storage->fd != -1 )
+        {
+            if( TsStorageMap( p_storage ) == VLC_SUCCESS )
             {
-                p_block->i_dts      = block.i_dts;
-                p_block->i_pts      = block.i_pts;
-                p_block->i_flags    = block.i_flags;
-                p_block->i_length   = block.i_length;
-                p_block->i_nb_samples = block.i_nb_samples;
-                p_block->i_buffer = fread( p_block->p_buffer, 1, block.i_buffer, p_storage->p_filer );
+                const uint8_t *p = p_storage->p_map + p_cmd->u.send.i_offset;
+
+                memcpy( &header, p, sizeof(header) );
+                p_block = block_Alloc( header.i_buffer );
+                if( p_block )
+                    memcpy( p_block->p_buffer, p + sizeof(header), header.i_buffer );
             }
-            p_cmd->u.send.p_block = p_block;
         }
-        else
+#endif
+        else if( !fseek( p_storage->p_filer, p_cmd->u.send.i_offset, SEEK_SET ) &&
+                 fread( &header, sizeof(header), 1, p_storage->p_filer ) == 1 )
+        {
+            p_block = block_Alloc( header.i_buffer );
+            if( p_block )
+                p_block->i_buffer = fread( p_block->p_buffer, 1, header.i_buffer,
+                                           p_storage->p_filer );
+        }
+        if( p_block )
         {
-            //perror( "TsStoragePopCmd" );
-            p_cmd->u.send.p_block = block_Alloc( 1 );
+            p_block->i_dts      = header.i_dts;
+            p_block->i_pts      = header.i_pts;
+            p_block->i_flags    = header.i_flags;
+            p_block->i_length   = header.i_length;
+            p_block->i_nb_samples = header.i_nb_samples;
         }
+        p_cmd->u.send.p_block = p_block;
+    }
+}
+/**
+ * Finds the last random access point not executed yet and at or before
+ * the given input time, with two binary searches.
+ * \return the index entry, or -1 if none.
+ */
+static int TsStorageSeekIndex( const ts_storage_t *p_storage, mtime_t i_time )
+{
+    const ts_index_t *p_index = p_storage->p_index;
+    int i_low = 0, i_high = p_storage->i_index;
+
+    /* First point not executed yet */
+    while( i_low < i_high )
+    {
+        const int i_mid = (i_low + i_high) / 2;
+
+        if( p_index[i_mid].i_cmd < p_storage->i_cmd_r )
+            i_low = i_mid + 1;
+        else
+            i_high = i_mid;
+    }
+
+    /* First point after the requested time */
+    const int i_first = i_low;
+    i_high = p_storage->i_index;
+    while( i_low < i_high )
+    {
+        const int i_mid = (i_low + i_high) / 2;
+
+        if( p_index[i_mid].i_time <= i_time )
+            i_low = i_mid + 1;
+        else
+            i_high = i_mid;
     }
+    return i_low > i_first ? i_low - 1 : -1;
 }
 
 /*****************************************************************************
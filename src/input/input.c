@@ -831,6 +831,8 @@ static void InitStatistics( input_thread_t *p_input )
         INIT_COUNTER( decoded_audio, COUNTER );
         INIT_COUNTER( decoded_video, COUNTER );
         INIT_COUNTER( decoded_sub, COUNTER );
+        INIT_COUNTER( decoder_blocked, COUNTER );
+        INIT_COUNTER( decoder_dropped, COUNTER );
         priv->counters.p_sout_send_bitrate = NULL;
         priv->counters.p_sout_sent_packets = NULL;
         priv->counters.p_sout_sent_bytes = NULL;
@@ -1438,6 +1440,8 @@ error:
         EXIT_COUNTER( decoded_audio );
         EXIT_COUNTER( decoded_video );
         EXIT_COUNTER( decoded_sub );
+        EXIT_COUNTER( decoder_blocked );
+        EXIT_COUNTER( decoder_dropped );
 
         if( input_priv(p_input)->p_sout )
         {
@@ -1514,6 +1518,8 @@ do { \
             CL_CO( decoded_audio) ;
             CL_CO( decoded_video );
             CL_CO( decoded_sub) ;
+            CL_CO( decoder_blocked );
+            CL_CO( decoder_dropped );
         }
 
         /* Close optional stream output instance */
@@ -1989,6 +1995,11 @@ static bool Control( input_thread_t *p_input,
                 }
             }
             if( i_ret )
+            {
+                /* Jump inside the timeshift buffer, if any */
+                i_ret = es_out_SetTime( input_priv(p_input)->p_es_out, i_time );
+            }
+            if( i_ret )
             {
                 msg_Warn( p_input, "INPUT_CONTROL_SET_TIME %"PRId64
                          " failed or not possible", i_time );
@@ -165,6 +165,8 @@ typedef struct input_thread_private_t
         counter_t *p_lost_abuffers;
         counter_t *p_displayed_pictures;
         counter_t *p_lost_pictures;
+        counter_t *p_decoder_blocked;
+        counter_t *p_decoder_dropped;
         vlc_mutex_t counters_lock;
     } counters;
 
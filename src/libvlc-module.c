@@ -689,6 +689,12 @@ static const char *const ppsz_prefres[] = {
     "This is the maximum size in bytes of the temporary files " \
     "that will be used to store the timeshifted streams." )
 
+#define INPUT_TIMESHIFT_MAX_SIZE_TEXT N_("Timeshift maximum size (MiB)")
+#define INPUT_TIMESHIFT_MAX_SIZE_LONGTEXT N_( \
+    "This is the maximum total size of the timeshifted streams. When it " \
+    "is reached, the oldest data are dropped, by steps of the timeshift " \
+    "granularity. 0 means no limit." )
+
 #define INPUT_TITLE_FORMAT_TEXT N_( "Change title according to current media" )
 #define INPUT_TITLE_FORMAT_LONGTEXT N_( "This option allows you to set the title according to what's being played<br>"  \
     "$a: Artist<br>$b: Album<br>$c: Copyright<br>$t: Title<br>$g: Genre<br>"  \
@@ -839,6 +845,11 @@ static const char *const ppsz_prefres[] = {
     "However allocation of port numbers below 1025 is usually restricted " \
     "by the operating system." )
 
+#define HTTP_THREADS_TEXT N_( "HTTP/RTSP server threads" )
+#define HTTP_THREADS_LONGTEXT N_( \
+    "Number of threads serving the clients of each built-in HTTP, HTTPS " \
+    "or RTSP server. 0 picks a value from the number of processors." )
+
 #define HTTP_CERT_TEXT N_("HTTP/TLS server certificate")
 #define CERT_LONGTEXT N_( \
    "This X.509 certicate file (PEM format) is used for server-side TLS. " \
@@ -911,6 +922,31 @@ static const char *const ppsz_prefres[] = {
     "This allows you to select a list of encoders that VLC will use in " \
     "priority.")
 
+#define DEC_FIFO_DELAY_LONGTEXT N_( \
+    "The input is paused while the decoder queue holds at least this much " \
+    "data (in milliseconds), and resumed when it is three quarters of " \
+    "that. 0 uses the number of blocks instead.")
+#define DEC_FIFO_SIZE_LONGTEXT N_( \
+    "The input is paused while the decoder queue holds at least this much " \
+    "data (in KiB), and resumed when it is three quarters of that.")
+
+#define VIDEO_DEC_FIFO_DELAY_TEXT N_("Video decoder queue duration")
+#define VIDEO_DEC_FIFO_SIZE_TEXT N_("Video decoder queue size")
+#define AUDIO_DEC_FIFO_DELAY_TEXT N_("Audio decoder queue duration")
+#define AUDIO_DEC_FIFO_SIZE_TEXT N_("Audio decoder queue size")
+#define SUB_DEC_FIFO_DELAY_TEXT N_("Subtitles decoder queue duration")
+#define SUB_DEC_FIFO_SIZE_TEXT N_("Subtitles decoder queue size")
+
+#define DEC_FIFO_BLOCKS_TEXT N_("Decoder queue blocks")
+#define DEC_FIFO_BLOCKS_LONGTEXT N_( \
+    "The input is paused while the decoder queue holds this many blocks, " \
+    "if the duration of the queue is unknown or not limited.")
+
+#define DEC_FIFO_MAX_TEXT N_("Decoder queue maximum size")
+#define DEC_FIFO_MAX_LONGTEXT N_( \
+    "If the input is not paced (such as a live stream), the decoder queue " \
+    "is discarded when it exceeds this size (in KiB).")
+
 /*****************************************************************************
  * Sout
  ****************************************************************************/
@@ -1797,6 +1833,9 @@ vlc_module_begin ()
     add_string( "rtsp-host", NULL, RTSP_HOST_TEXT, RTSP_HOST_LONGTEXT, true )
     add_integer( "rtsp-port", 554, RTSP_PORT_TEXT, RTSP_PORT_LONGTEXT, true )
         change_integer_range( 1, 65535 )
+    add_integer( "http-threads", 0, HTTP_THREADS_TEXT, HTTP_THREADS_LONGTEXT,
+                 true )
+        change_integer_range( 0, 64 )
     add_loadfile( "http-cert", NULL, HTTP_CERT_TEXT, CERT_LONGTEXT, true )
     add_obsolete_string( "sout-http-cert" ) /* since 2.0.0 */
     add_loadfile( "http-key", NULL, HTTP_KEY_TEXT, KEY_LONGTEXT, true )
@@ -1909,6 +1948,8 @@ vlc_module_begin ()
                 INPUT_TIMESHIFT_PATH_LONGTEXT, true )
     add_integer( "input-timeshift-granularity", -1, INPUT_TIMESHIFT_GRANULARITY_TEXT,
                  INPUT_TIMESHIFT_GRANULARITY_LONGTEXT, true )
+    add_integer( "input-timeshift-max-size", 0, INPUT_TIMESHIFT_MAX_SIZE_TEXT,
+                 INPUT_TIMESHIFT_MAX_SIZE_LONGTEXT, true )
 
     add_string( "input-title-format", "$Z", INPUT_TITLE_FORMAT_TEXT, INPUT_TITLE_FORMAT_LONGTEXT, false );
 
@@ -1921,6 +1962,38 @@ vlc_module_begin ()
                 CODEC_LONGTEXT, true )
     add_string( "encoder",  NULL, ENCODER_TEXT,
                 ENCODER_LONGTEXT, true )
+    add_integer( "video-decoder-fifo-delay", 400, VIDEO_DEC_FIFO_DELAY_TEXT,
+                 DEC_FIFO_DELAY_LONGTEXT, true )
+        change_integer_range( 0, 60000 )
+        change_safe()
+    add_integer( "video-decoder-fifo-size", 64 << 10, VIDEO_DEC_FIFO_SIZE_TEXT,
+                 DEC_FIFO_SIZE_LONGTEXT, true )
+        change_integer_range( 1, 4 << 20 )
+        change_safe()
+    add_integer( "audio-decoder-fifo-delay", 500, AUDIO_DEC_FIFO_DELAY_TEXT,
+                 DEC_FIFO_DELAY_LONGTEXT, true )
+        change_integer_range( 0, 60000 )
+        change_safe()
+    add_integer( "audio-decoder-fifo-size", 4 << 10, AUDIO_DEC_FIFO_SIZE_TEXT,
+                 DEC_FIFO_SIZE_LONGTEXT, true )
+        change_integer_range( 1, 4 << 20 )
+        change_safe()
+    add_integer( "sub-decoder-fifo-delay", 0, SUB_DEC_FIFO_DELAY_TEXT,
+                 DEC_FIFO_DELAY_LONGTEXT, true )
+        change_integer_range( 0, 60000 )
+        change_safe()
+    add_integer( "sub-decoder-fifo-size", 1 << 10, SUB_DEC_FIFO_SIZE_TEXT,
+                 DEC_FIFO_SIZE_LONGTEXT, true )
+        change_integer_range( 1, 4 << 20 )
+        change_safe()
+    add_integer( "decoder-fifo-blocks", 10, DEC_FIFO_BLOCKS_TEXT,
+                 DEC_FIFO_BLOCKS_LONGTEXT, true )
+        change_integer_range( 2, 100000 )
+        change_safe()
+    add_integer( "decoder-fifo-max-size", 400 << 10, DEC_FIFO_MAX_TEXT,
+                 DEC_FIFO_MAX_LONGTEXT, true )
+        change_integer_range( 1, 4 << 20 )
+        change_safe()
 
     set_subcategory( SUBCAT_INPUT_ACCESS )
     add_category_hint( N_("Input"), INPUT_CAT_LONGTEXT , false )
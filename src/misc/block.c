@@ -33,6 +33,7 @@
 
 #include <vlc_common.h>
 #include <vlc_block.h>
+#include <vlc_atomic.h>
 #include <vlc_fs.h>
 
 #ifndef NDEBUG
@@ -91,14 +92,6 @@ void block_Init( block_t *restrict b, void *buf, size_t size )
 #endif
 }
 
-static void block_generic_Release (block_t *block)
-{
-    /* That is always true for blocks allocated with block_Alloc(). */
-    assert (block->p_start == (unsigned char *)(block + 1));
-    block_Invalidate (block);
-    free (block);
-}
-
 static void BlockMetaCopy( block_t *restrict out, const block_t *in )
 {
     out->p_next    = in->p_next;
@@ -117,15 +110,416 @@ static void BlockMetaCopy( block_t *restrict out, const block_t *in )
 /** Initial reserved header and footer size. */
 #define BLOCK_PADDING      32
 
+/**
+ * \defgroup block_pool Block memory pool
+ *
+ * Blocks up to BLOCK_CLASS_MAX bytes (including the header) are carved from
+ * size classes, alternatively powers of two and one and a half times powers
+ * of two. Released blocks go to a free list of the releasing thread. Those
+ * lists are bounded; excess blocks are returned in batches to a global,
+ * also bounded, free list per class, and then to the system allocator.
+ * @{
+ */
+#define BLOCK_CLASS_MIN    256
+#define BLOCK_CLASSES      21
+#define BLOCK_CLASS_MAX    (BLOCK_CLASS_MIN << ((BLOCK_CLASSES - 1) / 2))
+
+/** Alignment of pooled blocks (cache line size). */
+#define BLOCK_POOL_ALIGN   64
+
+/** Approximate size of a thread free list, per class. */
+#define BLOCK_CACHE_SIZE   (64 << 10)
+
+/** Approximate size of the global free list, per class. */
+#define BLOCK_POOL_SIZE    (4 * BLOCK_CACHE_SIZE)
+
+static_assert (BLOCK_CLASS_MAX == (256 << 10), "Wrong class count");
+static_assert ((BLOCK_CLASS_MIN % BLOCK_POOL_ALIGN) == 0, "Wrong alignment");
+
+static size_t block_class_size (unsigned c)
+{
+    size_t size = BLOCK_CLASS_MIN << (c / 2);
+
+    if (c & 1)
+        size += size / 2;
+    return size;
+}
+
+static unsigned block_class (size_t size)
+{
+    assert (size <= BLOCK_CLASS_MAX);
+
+    if (size <= BLOCK_CLASS_MIN)
+        return 0;
+
+    /* 2^p < size <= 2^(p+1) */
+    unsigned p = (sizeof (unsigned) * 8 - 1) - clz ((unsigned)(size - 1));
+    unsigned c = 2 * (p - 8);
+
+    return (size <= (3u << (p - 1))) ? (c + 1) : (c + 2);
+}
+
+static unsigned block_cache_max (unsigned c)
+{
+    return BLOCK_CACHE_SIZE / block_class_size (c) + 1;
+}
+
+/** Statistics of one thread (written by that thread only). */
+struct block_counters
+{
+    atomic_uint_least64_t allocs;
+    atomic_uint_least64_t frees;
+    atomic_uint_least64_t alloc_bytes;
+    atomic_uint_least64_t free_bytes;
+    atomic_uint_least64_t hits;
+    atomic_uint_least64_t misses;
+    atomic_uint_least64_t cached_bytes;
+};
+
+struct block_cache
+{
+    block_t *free[BLOCK_CLASSES]; /**< Free lists (linked with p_next) */
+    unsigned count[BLOCK_CLASSES]; /**< Free list lengths */
+    struct block_counters stats;
+    struct block_cache *next; /**< Next thread (protected by the pool lock) */
+};
+
+static struct
+{
+    vlc_mutex_t lock;
+    bool key_ok;
+    vlc_threadvar_t key;
+    struct block_cache *caches; /**< Caches of live threads */
+    block_t *free[BLOCK_CLASSES];
+    unsigned count[BLOCK_CLASSES];
+    block_stats_t retired; /**< Statistics of exited threads */
+} block_pool = { .lock = VLC_STATIC_MUTEX };
+
+static thread_local struct block_cache *block_cache_var = NULL;
+
+/** Increments a counter of the calling thread. */
+static void block_count (atomic_uint_least64_t *counter, uint_least64_t n)
+{   /* The owner thread is the only writer: no need for read-modify-write */
+    atomic_store_explicit (counter,
+                           atomic_load_explicit (counter,
+                                                 memory_order_relaxed) + n,
+                           memory_order_relaxed);
+}
+
+static uint_least64_t block_count_get (atomic_uint_least64_t *counter)
+{
+    return atomic_load_explicit (counter, memory_order_relaxed);
+}
+
+static void block_chain_Free (block_t *block)
+{
+    while (block != NULL)
+    {
+        block_t *next = block->p_next;
+
+        aligned_free (block);
+        block = next;
+    }
+}
+
+/**
+ * Returns blocks to the global free list.
+ * @note The pool lock must be held.
+ * @return blocks in excess of the global list capacity
+ */
+static block_t *block_pool_Put (unsigned c, block_t *head, block_t *tail,
+                                unsigned n)
+{
+    unsigned room = 4 * block_cache_max (c) - block_pool.count[c];
+
+    if (room == 0)
+        return head;
+
+    block_t *excess;
+
+    if (n > room)
+    {   /* Keep only as many as fit */
+        tail = head;
+        for (unsigned i = 1; i < room; i++)
+            tail = tail->p_next;
+        n = room;
+    }
+    excess = tail->p_next;
+    tail->p_next = block_pool.free[c];
+    block_pool.free[c] = head;
+    block_pool.count[c] += n;
+    return excess;
+}
+
+static void block_cache_Destroy (void *data)
+{
+    struct block_cache *cache = data;
+    block_t *excess = NULL;
+
+    block_cache_var = NULL;
+
+    vlc_mutex_lock (&block_pool.lock);
+    for (unsigned c = 0; c < BLOCK_CLASSES; c++)
+    {
+        block_t *head = cache->free[c];
+
+        if (head == NULL)
+            continue;
+
+        block_t *tail = head;
+        while (tail->p_next != NULL)
+            tail = tail->p_next;
+
+        tail = block_pool_Put (c, head, tail, cache->count[c]);
+        if (tail != NULL)
+        {   /* Prepend the excess to the list of blocks to free */
+            block_t *last = tail;
+            while (last->p_next != NULL)
+                last = last->p_next;
+            last->p_next = excess;
+            excess = tail;
+        }
+    }
+
+    block_stats_t *st = &block_pool.retired;
+    st->live_blocks += block_count_get (&cache->stats.allocs)
+                     - block_count_get (&cache->stats.frees);
+    st->live_bytes += block_count_get (&cache->stats.alloc_bytes)
+                    - block_count_get (&cache->stats.free_bytes);
+    st->hits += block_count_get (&cache->stats.hits);
+    st->misses += block_count_get (&cache->stats.misses);
+
+    for (struct block_cache **pp = &block_pool.caches; *pp != NULL;
+         pp = &(*pp)->next)
+        if (*pp == cache)
+        {
+            *pp = cache->next;
+            break;
+        }
+    vlc_mutex_unlock (&block_pool.lock);
+
+    block_chain_Free (excess);
+    free (cache);
+}
+
+static struct block_cache *block_cache_Create (void)
+{
+    struct block_cache *cache = calloc (1, sizeof (*cache));
+    if (unlikely(cache == NULL))
+        return NULL;
+
+    /* Thread-local storage has no destructor; a thread variable is used to
+     * return the cached blocks when the thread exits. */
+    vlc_mutex_lock (&block_pool.lock);
+    if (!block_pool.key_ok)
+        block_pool.key_ok = vlc_threadvar_create (&block_pool.key,
+                                                  block_cache_Destroy) == 0;
+    if (likely(block_pool.key_ok)
+     && likely(vlc_threadvar_set (block_pool.key, cache) == 0))
+    {
+        cache->next = block_pool.caches;
+        block_pool.caches = cache;
+    }
+    else
+    {
+        free (cache);
+        cache = NULL;
+    }
+    vlc_mutex_unlock (&block_pool.lock);
+
+    block_cache_var = cache;
+    return cache;
+}
+
+static struct block_cache *block_cache_Get (void)
+{
+    struct block_cache *cache = block_cache_var;
+
+    if (likely(cache != NULL))
+        return cache;
+    return block_cache_Create ();
+}
+
+/**
+ * Gets a block of the given class: from the thread free list, from the
+ * global free list, or from the system allocator.
+ */
+static block_t *block_pool_Get (struct block_cache *cache, unsigned c)
+{
+    size_t size = block_class_size (c);
+    block_t *b;
+
+    if (likely(cache != NULL))
+    {
+        if (cache->free[c] == NULL)
+        {   /* Refill the thread free list in a batch */
+            unsigned n = (block_cache_max (c) + 1) / 2;
+
+            vlc_mutex_lock (&block_pool.lock);
+            for (b = block_pool.free[c]; b != NULL && n > 0; n--)
+            {
+                block_pool.free[c] = b->p_next;
+                block_pool.count[c]--;
+                b->p_next = cache->free[c];
+                cache->free[c] = b;
+                cache->count[c]++;
+                block_count (&cache->stats.cached_bytes, size);
+                b = block_pool.free[c];
+            }
+            vlc_mutex_unlock (&block_pool.lock);
+        }
+
+        b = cache->free[c];
+        if (b != NULL)
+        {
+            cache->free[c] = b->p_next;
+            cache->count[c]--;
+            block_count (&cache->stats.cached_bytes, -(uint_least64_t)size);
+            block_count (&cache->stats.hits, 1);
+            goto out;
+        }
+        block_count (&cache->stats.misses, 1);
+    }
+
+    b = aligned_alloc (BLOCK_POOL_ALIGN, size);
+    if (unlikely(b == NULL))
+        return NULL;
+out:
+    if (likely(cache != NULL))
+    {
+        block_count (&cache->stats.allocs, 1);
+        block_count (&cache->stats.alloc_bytes, size);
+    }
+    return b;
+}
+
+static void block_pool_Release (block_t *block)
+{
+    size_t size = sizeof (*block) + block->i_size;
+    unsigned c = block_class (size);
+
+    assert (block->p_start == (unsigned char *)(block + 1));
+    assert (block_class_size (c) == size);
+    block_Invalidate (block);
+
+    struct block_cache *cache = block_cache_Get ();
+    if (unlikely(cache == NULL))
+    {
+        vlc_mutex_lock (&block_pool.lock);
+        block->p_next = NULL;
+        block = block_pool_Put (c, block, block, 1);
+        vlc_mutex_unlock (&block_pool.lock);
+        if (block != NULL)
+            aligned_free (block);
+        return;
+    }
+
+    block_count (&cache->stats.frees, 1);
+    block_count (&cache->stats.free_bytes, size);
+
+    unsigned max = block_cache_max (c);
+
+    if (cache->count[c] >= max)
+    {   /* Return half of the thread free list to the global one */
+        unsigned n = (max + 1) / 2;
+        block_t *head = cache->free[c], *tail = head;
+
+        for (unsigned i = 1; i < n; i++)
+            tail = tail->p_next;
+        cache->free[c] = tail->p_next;
+        cache->count[c] -= n;
+        tail->p_next = NULL;
+        block_count (&cache->stats.cached_bytes, -(uint_least64_t)(n * size));
+
+        vlc_mutex_lock (&block_pool.lock);
+        head = block_pool_Put (c, head, tail, n);
+        vlc_mutex_unlock (&block_pool.lock);
+        block_chain_Free (head);
+    }
+
+    block->p_next = cache->free[c];
+    cache->free[c] = block;
+    cache->count[c]++;
+    block_count (&cache->stats.cached_bytes, size);
+}
+
+void block_GetStats (block_stats_t *st)
+{
+    vlc_mutex_lock (&block_pool.lock);
+    *st = block_pool.retired;
+    st->cached_bytes = 0;
+
+    for (unsigned c = 0; c < BLOCK_CLASSES; c++)
+        st->cached_bytes += block_pool.count[c] * block_class_size (c);
+
+    for (struct block_cache *cache = block_pool.caches; cache != NULL;
+         cache = cache->next)
+    {
+        struct block_counters *cnt = &cache->stats;
+
+        st->live_blocks += block_count_get (&cnt->allocs)
+                         - block_count_get (&cnt->frees);
+        st->live_bytes += block_count_get (&cnt->alloc_bytes)
+                        - block_count_get (&cnt->free_bytes);
+        st->cached_bytes += block_count_get (&cnt->cached_bytes);
+        st->hits += block_count_get (&cnt->hits);
+        st->misses += block_count_get (&cnt->misses);
+    }
+    vlc_mutex_unlock (&block_pool.lock);
+}
+
+/** @} */
+
+static void block_generic_Release (block_t *block)
+{
+    struct block_cache *cache = block_cache_Get ();
+
+    if (likely(cache != NULL))
+    {
+        block_count (&cache->stats.frees, 1);
+        block_count (&cache->stats.free_bytes,
+                     sizeof (*block) + block->i_size);
+    }
+
+    /* That is always true for blocks allocated with block_Alloc(). */
+    assert (block->p_start == (unsigned char *)(block + 1));
+    block_Invalidate (block);
+    free (block);
+}
+
 block_t *block_Alloc (size_t size)
 {
     /* 2 * BLOCK_PADDING: pre + post padding */
-    const size_t alloc = sizeof (block_t) + BLOCK_ALIGN + (2 * BLOCK_PADDING)
-                       + size;
+    size_t alloc = sizeof (block_t) + BLOCK_ALIGN + (2 * BLOCK_PADDING)
+                 + size;
     if (unlikely(alloc <= size))
         return NULL;
 
-    block_t *b = malloc (alloc);
+    block_t *b;
+    block_free_t release;
+
+    if (alloc <= BLOCK_CLASS_MAX)
+    {
+        unsigned c = block_class (alloc);
+
+        alloc = block_class_size (c);
+        b = block_pool_Get (block_cache_Get (), c);
+        release = block_pool_Release;
+    }
+    else
+    {   /* Too large to be pooled */
+        struct block_cache *cache = block_cache_Get ();
+
+        b = malloc (alloc);
+        if (likely(cache != NULL) && likely(b != NULL))
+        {
+            block_count (&cache->stats.misses, 1);
+            block_count (&cache->stats.allocs, 1);
+            block_count (&cache->stats.alloc_bytes, alloc);
+        }
+        release = block_generic_Release;
+    }
+
     if (unlikely(b == NULL))
         return NULL;
 
@@ -135,7 +529,7 @@ block_t *block_Alloc (size_t size)
     b->p_buffer += BLOCK_PADDING + BLOCK_ALIGN - 1;
     b->p_buffer = (void *)(((uintptr_t)b->p_buffer) & ~(BLOCK_ALIGN - 1));
     b->i_buffer = size;
-    b->pf_release = block_generic_Release;
+    b->pf_release = release;
     return b;
 }
 
@@ -30,6 +30,7 @@
 
 #include <vlc_common.h>
 #include <vlc_block.h>
+#include <vlc_atomic.h>
 #include "libvlc.h"
 
 /**
@@ -233,3 +234,261 @@ size_t block_FifoCount (block_fifo_t *fifo)
     vlc_mutex_unlock (&fifo->lock);
     return depth;
 }
+
+/**
+ * Lock-free single producer, single consumer block queue.
+ *
+ * Blocks are stored in a chain of fixed-size segments. Only the producer
+ * writes the tail and only the consumer reads the head. They synchronize
+ * through the queued and dequeued counters. Counters wrap around, so fewer
+ * than 2^31 blocks may be queued at any time.
+ */
+#define SPSC_SEGMENT_SIZE 126
+
+struct vlc_spsc_segment
+{
+    struct vlc_spsc_segment *next;
+    block_t *blocks[SPSC_SEGMENT_SIZE];
+};
+
+struct vlc_spsc
+{
+    /* Producer side */
+    struct vlc_spsc_segment *tail;
+    unsigned tail_index;
+    atomic_uint queued; /**< Number of blocks ever queued */
+    atomic_uint flushed; /**< Value of queued at the last flush */
+    atomic_size_t bytes_in; /**< Number of bytes ever queued */
+    atomic_size_t bytes_flushed; /**< Value of bytes_in at the last flush */
+    atomic_uintptr_t spare; /**< Free segment for the producer (or 0) */
+
+    /* Keep the consumer side on separate cache lines */
+    char pad[64];
+
+    /* Consumer side */
+    struct vlc_spsc_segment *head;
+    unsigned head_index;
+    atomic_uint dequeued; /**< Number of blocks ever dequeued */
+    atomic_size_t bytes_out; /**< Number of bytes ever dequeued */
+    atomic_bool waiting; /**< Whether the consumer waits for blocks */
+    atomic_uint wakeup; /**< Wake-up sequence for vlc_spsc_Wait() */
+};
+
+vlc_spsc_t *vlc_spsc_New(void)
+{
+    vlc_spsc_t *q = malloc(sizeof (*q));
+    if (unlikely(q == NULL))
+        return NULL;
+
+    struct vlc_spsc_segment *seg = malloc(sizeof (*seg));
+    if (unlikely(seg == NULL))
+    {
+        free(q);
+        return NULL;
+    }
+
+    seg->next = NULL;
+    q->tail = q->head = seg;
+    q->tail_index = q->head_index = 0;
+    atomic_init(&q->queued, 0);
+    atomic_init(&q->flushed, 0);
+    atomic_init(&q->bytes_in, 0);
+    atomic_init(&q->bytes_flushed, 0);
+    atomic_init(&q->spare, 0);
+    atomic_init(&q->dequeued, 0);
+    atomic_init(&q->bytes_out, 0);
+    atomic_init(&q->waiting, false);
+    atomic_init(&q->wakeup, 0);
+    return q;
+}
+
+void vlc_spsc_Delete(vlc_spsc_t *q)
+{
+    block_t *block;
+
+    while ((block = vlc_spsc_Dequeue(q)) != NULL)
+        block_Release(block);
+
+    assert(q->head == q->tail);
+    free(q->head);
+    free((void *)atomic_load(&q->spare));
+    free(q);
+}
+
+bool vlc_spsc_Queue(vlc_spsc_t *q, block_t *block)
+{
+    unsigned queued = atomic_load_explicit(&q->queued, memory_order_relaxed);
+    size_t bytes = atomic_load_explicit(&q->bytes_in, memory_order_relaxed);
+
+    while (block != NULL)
+    {
+        block_t *next = block->p_next;
+
+        if (q->tail_index == SPSC_SEGMENT_SIZE)
+        {   /* The current segment is full, link a new one */
+            struct vlc_spsc_segment *seg =
+                (void *)atomic_exchange(&q->spare, 0);
+            if (seg == NULL)
+            {
+                seg = malloc(sizeof (*seg));
+                if (unlikely(seg == NULL))
+                {
+                    block_ChainRelease(block);
+                    break;
+                }
+            }
+
+            seg->next = NULL;
+            q->tail->next = seg;
+            q->tail = seg;
+            q->tail_index = 0;
+        }
+
+        block->p_next = NULL;
+        q->tail->blocks[q->tail_index++] = block;
+        queued++;
+        bytes += block->i_buffer;
+        block = next;
+    }
+
+    /* Publish the blocks, then check if the consumer needs a wake-up.
+     * This pairs with vlc_spsc_BeginWait(): either the consumer sees the
+     * blocks, or the producer sees the consumer waiting. */
+    atomic_store_explicit(&q->bytes_in, bytes, memory_order_relaxed);
+    atomic_store(&q->queued, queued);
+
+    if (!atomic_load(&q->waiting))
+        return false;
+
+    vlc_spsc_Wake(q);
+    return true;
+}
+
+void vlc_spsc_Flush(vlc_spsc_t *q)
+{
+    atomic_store_explicit(&q->bytes_flushed,
+                          atomic_load_explicit(&q->bytes_in,
+                                               memory_order_relaxed),
+                          memory_order_relaxed);
+    atomic_store_explicit(&q->flushed,
+                          atomic_load_explicit(&q->queued,
+                                               memory_order_relaxed),
+                          memory_order_release);
+}
+
+/**
+ * Takes the first block, including a flushed one.
+ */
+static block_t *vlc_spsc_Pop(vlc_spsc_t *q, unsigned *restrict index)
+{
+    unsigned dequeued = atomic_load_explicit(&q->dequeued,
+                                             memory_order_relaxed);
+
+    if (atomic_load_explicit(&q->queued, memory_order_acquire) == dequeued)
+        return NULL;
+
+    if (q->head_index == SPSC_SEGMENT_SIZE)
+    {   /* The head segment is consumed: move to the next one */
+        struct vlc_spsc_segment *seg = q->head;
+        uintptr_t none = 0;
+
+        assert(seg->next != NULL);
+        q->head = seg->next;
+        q->head_index = 0;
+
+        if (!atomic_compare_exchange_strong(&q->spare, &none, (uintptr_t)seg))
+            free(seg);
+    }
+
+    block_t *block = q->head->blocks[q->head_index++];
+    size_t bytes = atomic_load_explicit(&q->bytes_out, memory_order_relaxed);
+
+    atomic_store_explicit(&q->bytes_out, bytes + block->i_buffer,
+                          memory_order_relaxed);
+    atomic_store_explicit(&q->dequeued, dequeued + 1, memory_order_release);
+    *index = dequeued;
+    return block;
+}
+
+block_t *vlc_spsc_Dequeue(vlc_spsc_t *q)
+{
+    block_t *block;
+    unsigned index;
+
+    while ((block = vlc_spsc_Pop(q, &index)) != NULL)
+    {
+        unsigned flushed = atomic_load_explicit(&q->flushed,
+                                                memory_order_acquire);
+
+        if ((int)(flushed - index) <= 0)
+            break;
+        block_Release(block); /* queued before the last flush */
+    }
+    return block;
+}
+
+void vlc_spsc_Purge(vlc_spsc_t *q)
+{
+    unsigned flushed = atomic_load_explicit(&q->flushed,
+                                            memory_order_acquire);
+
+    while ((int)(flushed - atomic_load_explicit(&q->dequeued,
+                                                memory_order_relaxed)) > 0)
+    {
+        unsigned index;
+        block_t *block = vlc_spsc_Pop(q, &index);
+
+        assert(block != NULL);
+        block_Release(block);
+    }
+}
+
+size_t vlc_spsc_GetCount(const vlc_spsc_t *q)
+{
+    unsigned dequeued = atomic_load(&q->dequeued);
+    unsigned flushed = atomic_load_explicit(&q->flushed,
+                                            memory_order_acquire);
+    unsigned queued = atomic_load(&q->queued);
+
+    if ((int)(flushed - dequeued) > 0)
+        dequeued = flushed; /* Flushed blocks are not counted */
+    return queued - dequeued;
+}
+
+size_t vlc_spsc_GetBytes(const vlc_spsc_t *q)
+{
+    unsigned dequeued = atomic_load(&q->dequeued);
+    size_t out = atomic_load(&q->bytes_out);
+    unsigned flushed = atomic_load_explicit(&q->flushed,
+                                            memory_order_acquire);
+
+    if ((int)(flushed - dequeued) > 0)
+        out = atomic_load_explicit(&q->bytes_flushed, memory_order_relaxed);
+    return atomic_load(&q->bytes_in) - out;
+}
+
+bool vlc_spsc_BeginWait(vlc_spsc_t *q)
+{
+    atomic_store(&q->waiting, true);
+    return vlc_spsc_GetCount(q) == 0;
+}
+
+void vlc_spsc_EndWait(vlc_spsc_t *q)
+{
+    atomic_store_explicit(&q->waiting, false, memory_order_relaxed);
+}
+
+void vlc_spsc_Wait(vlc_spsc_t *q)
+{
+    unsigned seq = atomic_load(&q->wakeup);
+
+    if (vlc_spsc_BeginWait(q))
+        vlc_addr_wait(&q->wakeup, seq);
+    vlc_spsc_EndWait(q);
+}
+
+void vlc_spsc_Wake(vlc_spsc_t *q)
+{
+    atomic_fetch_add(&q->wakeup, 1);
+    vlc_addr_broadcast(&q->wakeup);
+}
@@ -28,15 +28,13 @@
 # include "config.h"
 #endif
 
-#ifdef HAVE_SEARCH_H
-# include <search.h>
-#endif
 #include <assert.h>
 #include <float.h>
 #include <math.h>
 #include <limits.h>
 
 #include <vlc_common.h>
+#include <vlc_atomic.h>
 #include <vlc_arrays.h>
 #include <vlc_charset.h>
 #include "libvlc.h"
@@ -67,13 +65,44 @@ typedef struct callback_table_t
     callback_entry_t * p_entries;
 } callback_table_t;
 
+/**
+ * An interned variable name.
+ *
+ * Names are interned for as long as a variable or a cached value uses them,
+ * so that variables and cached values can be compared by hash first, and so
+ * that a generation counter can be attached to each name.
+ */
+typedef struct var_atom_t
+{
+    /** Incremented whenever any variable of that name changes */
+    atomic_uint  gen;
+    unsigned     refs; /**< Reference count (protected by the atoms lock) */
+    uint32_t     hash;
+    char         name[];
+} var_atom_t;
+
+/**
+ * A value found by var_Inherit(), cached in the inheriting object.
+ * It remains valid for as long as neither the generation of the name nor the
+ * configuration epoch changed.
+ */
+typedef struct inherit_entry_t
+{
+    const var_atom_t *atom; /**< The variable name (must be first) */
+    unsigned     gen;
+    unsigned     epoch;
+    int          i_type;
+    vlc_value_t  val;
+} inherit_entry_t;
+
 /**
  * The structure describing a variable.
  * \note vlc_value_t is the common union for variable values
  */
 struct variable_t
 {
-    char *       psz_name; /**< The variable unique name (must be first) */
+    const var_atom_t *atom; /**< The variable unique name (must be first) */
+    const char * psz_name;
 
     /** The variable's exported value */
     vlc_value_t  val;
@@ -141,23 +170,276 @@ int_ops    = { CmpInt,     DupDummy,  FreeDummy,  },
 string_ops = { CmpString,  DupString, FreeString, },
 coords_ops = { NULL,       DupDummy,  FreeDummy,  };
 
-static int varcmp( const void *a, const void *b )
+/* FNV-1a */
+static uint32_t HashName( const char *psz_name )
 {
-    const variable_t *va = a, *vb = b;
+    uint32_t hash = 2166136261u;
 
-    /* psz_name must be first */
-    assert( va == (const void *)&va->psz_name );
-    return strcmp( va->psz_name, vb->psz_name );
+    for( const unsigned char *p = (const unsigned char *)psz_name; *p; p++ )
+    {
+        hash ^= *p;
+        hash *= 16777619u;
+    }
+    return hash;
 }
 
-static variable_t *Lookup( vlc_object_t *obj, const char *psz_name )
+static struct
+{
+    vlc_mutex_t  lock;
+    var_atom_t **slots;
+    size_t       size;
+    size_t       count;
+} atoms = { VLC_STATIC_MUTEX, NULL, 0, 0 };
+
+/**
+ * Looks an interned variable name up, and interns it if requested.
+ *
+ * \return a reference to the atom, or NULL if the name is not interned and
+ * create is false, or on memory error
+ */
+static var_atom_t *AtomLookup( const char *psz_name, uint32_t hash,
+                               bool create )
+{
+    var_atom_t *atom;
+    size_t mask, i;
+
+    vlc_mutex_lock( &atoms.lock );
+    mask = atoms.size - 1;
+    for( i = hash & mask; atoms.size > 0; i = (i + 1) & mask )
+    {
+        atom = atoms.slots[i];
+        if( atom == NULL )
+            break;
+        if( atom->hash == hash && !strcmp( atom->name, psz_name ) )
+        {
+            atom->refs++;
+            goto out;
+        }
+    }
+
+    atom = NULL;
+    if( !create )
+        goto out;
+
+    if( (atoms.count + 1) * 4 > atoms.size * 3 )
+    {   /* grow */
+        size_t size = atoms.size ? (atoms.size * 2) : 256;
+        var_atom_t **slots = calloc( size, sizeof (*slots) );
+
+        if( unlikely(slots == NULL) )
+            goto out;
+        for( size_t j = 0; j < atoms.size; j++ )
+        {
+            var_atom_t *a = atoms.slots[j];
+            if( a == NULL )
+                continue;
+            for( i = a->hash & (size - 1); slots[i] != NULL;
+                 i = (i + 1) & (size - 1) );
+            slots[i] = a;
+        }
+        free( atoms.slots );
+        atoms.slots = slots;
+        atoms.size = size;
+        mask = size - 1;
+        for( i = hash & mask; atoms.slots[i] != NULL; i = (i + 1) & mask );
+    }
+
+    size_t len = strlen( psz_name ) + 1;
+    atom = malloc( sizeof (*atom) + len );
+    if( likely(atom != NULL) )
+    {
+        atomic_init( &atom->gen, 0 );
+        atom->refs = 1;
+        atom->hash = hash;
+        memcpy( atom->name, psz_name, len );
+        atoms.slots[i] = atom;
+        atoms.count++;
+    }
+out:
+    vlc_mutex_unlock( &atoms.lock );
+    return atom;
+}
+
+/** Interns a variable name (see AtomLookup()) */
+static var_atom_t *AtomGet( const char *psz_name, uint32_t hash )
+{
+    return AtomLookup( psz_name, hash, true );
+}
+
+/** Finds an interned variable name, without interning it (see AtomLookup()) */
+static var_atom_t *AtomFind( const char *psz_name, uint32_t hash )
+{
+    return AtomLookup( psz_name, hash, false );
+}
+
+static void AtomHold( const var_atom_t *atom )
+{
+    vlc_mutex_lock( &atoms.lock );
+    ((var_atom_t *)atom)->refs++;
+    vlc_mutex_unlock( &atoms.lock );
+}
+
+/**
+ * Releases a reference to an atom. The name is no longer interned once the
+ * last reference is gone, and the table itself is freed once no names are
+ * interned anymore, i.e. when the last object is destroyed.
+ */
+static void AtomRelease( const var_atom_t *atom )
+{
+    var_atom_t *a = (var_atom_t *)atom;
+
+    vlc_mutex_lock( &atoms.lock );
+    assert( a->refs > 0 );
+    if( --a->refs > 0 )
+    {
+        vlc_mutex_unlock( &atoms.lock );
+        return;
+    }
+
+    const size_t mask = atoms.size - 1;
+    size_t i = a->hash & mask;
+
+    while( atoms.slots[i] != a )
+    {
+        assert( atoms.slots[i] != NULL );
+        i = (i + 1) & mask;
+    }
+
+    /* Shift the following atoms of the cluster back (as in TableRemove()) */
+    for( size_t j = (i + 1) & mask; atoms.slots[j] != NULL; j = (j + 1) & mask )
+    {
+        size_t home = atoms.slots[j]->hash & mask;
+
+        if( ((j - home) & mask) >= ((j - i) & mask) )
+        {
+            atoms.slots[i] = atoms.slots[j];
+            i = j;
+        }
+    }
+    atoms.slots[i] = NULL;
+
+    if( --atoms.count == 0 )
+    {
+        free( atoms.slots );
+        atoms.slots = NULL;
+        atoms.size = 0;
+    }
+    vlc_mutex_unlock( &atoms.lock );
+    free( a );
+}
+
+/** Notes that a variable changed, invalidating the cached inherited values */
+static void AtomChanged( const var_atom_t *atom )
+{
+    atomic_fetch_add( &((var_atom_t *)atom)->gen, 1 );
+}
+
+/* The table entries all start with a pointer to their atom */
+static inline const var_atom_t *EntryAtom( const void *entry )
+{
+    return *(const var_atom_t *const *)entry;
+}
+
+static void *TableFind( const struct vlc_var_table *table,
+                        const char *psz_name, uint32_t hash )
+{
+    const size_t mask = table->size - 1;
+
+    if( table->size == 0 )
+        return NULL;
+
+    for( size_t i = hash & mask;; i = (i + 1) & mask )
+    {
+        void *entry = table->slots[i];
+        if( entry == NULL )
+            return NULL;
+
+        const var_atom_t *atom = EntryAtom( entry );
+        if( atom->hash == hash && !strcmp( atom->name, psz_name ) )
+            return entry;
+    }
+}
+
+static void TablePut( void **slots, size_t size, void *entry )
+{
+    size_t i = EntryAtom( entry )->hash & (size - 1);
+
+    while( slots[i] != NULL )
+        i = (i + 1) & (size - 1);
+    slots[i] = entry;
+}
+
+/** Inserts an entry which is known not to be in the table yet */
+static int TableInsert( struct vlc_var_table *table, void *entry )
+{
+    if( (table->count + 1) * 4 > table->size * 3 )
+    {
+        size_t size = table->size ? (table->size * 2) : 16;
+        void **slots = calloc( size, sizeof (*slots) );
+
+        if( unlikely(slots == NULL) )
+            return VLC_ENOMEM;
+        for( size_t i = 0; i < table->size; i++ )
+            if( table->slots[i] != NULL )
+                TablePut( slots, size, table->slots[i] );
+        free( table->slots );
+        table->slots = slots;
+        table->size = size;
+    }
+
+    TablePut( table->slots, table->size, entry );
+    table->count++;
+    return VLC_SUCCESS;
+}
+
+static void TableRemove( struct vlc_var_table *table, void *entry )
+{
+    const size_t mask = table->size - 1;
+    size_t i = EntryAtom( entry )->hash & mask;
+
+    while( table->slots[i] != entry )
+    {
+        assert( table->slots[i] != NULL );
+        i = (i + 1) & mask;
+    }
+
+    /* Shift the following entries of the cluster back, so that lookups
+     * never stop early on the hole (no tombstones needed). */
+    for( size_t j = (i + 1) & mask; table->slots[j] != NULL; j = (j + 1) & mask )
+    {
+        size_t home = EntryAtom( table->slots[j] )->hash & mask;
+
+        if( ((j - home) & mask) >= ((j - i) & mask) )
+        {
+            table->slots[i] = table->slots[j];
+            i = j;
+        }
+    }
+    table->slots[i] = NULL;
+    table->count--;
+}
+
+static void TableClean( struct vlc_var_table *table, void (*release)(void *) )
+{
+    for( size_t i = 0; i < table->size; i++ )
+        if( table->slots[i] != NULL )
+            release( table->slots[i] );
+    free( table->slots );
+    *table = (struct vlc_var_table){ NULL, 0, 0 };
+}
+
+static variable_t *LookupHash( vlc_object_t *obj, const char *psz_name,
+                               uint32_t hash )
 {
     vlc_object_internals_t *priv = vlc_internals( obj );
-    variable_t **pp_var;
 
     vlc_mutex_lock(&priv->var_lock);
-    pp_var = tfind( &psz_name, &priv->var_root, varcmp );
-    return (pp_var != NULL) ? *pp_var : NULL;
+    return TableFind( &priv->var_table, psz_name, hash );
+}
+
+static variable_t *Lookup( vlc_object_t *obj, const char *psz_name )
+{
+    return LookupHash( obj, psz_name, HashName( psz_name ) );
 }
 
 static void Destroy( variable_t *p_var )
@@ -174,9 +456,9 @@ static void Destroy( variable_t *p_var )
         free( p_var->choices_text.p_values );
     }
 
-    free( p_var->psz_name );
     free( p_var->psz_text );
     free( p_var->value_callbacks.p_entries );
+    AtomRelease( p_var->atom );
     free( p_var );
 }
 
@@ -286,9 +568,9 @@ static void TriggerListCallback(vlc_object_t *obj, variable_t *var,
 /**
  * Initialize a vlc variable
  *
- * We hash the given string and insert it into the sorted list. The insertion
- * may require slow memory copies, but think about what we gain in the log(n)
- * lookup phase when setting/getting the variable value!
+ * We intern the given name and insert the variable into the hash table of the
+ * object, so that setting/getting the variable value is a constant time
+ * lookup.
  *
  * \param p_this The object in which to create the variable
  * \param psz_name The name of the variable
@@ -303,7 +585,13 @@ int var_Create( vlc_object_t *p_this, const char *psz_name, int i_type )
     if( p_var == NULL )
         return VLC_ENOMEM;
 
-    p_var->psz_name = strdup( psz_name );
+    p_var->atom = AtomGet( psz_name, HashName( psz_name ) );
+    if( unlikely(p_var->atom == NULL) )
+    {
+        free( p_var );
+        return VLC_ENOMEM;
+    }
+    p_var->psz_name = p_var->atom->name;
     p_var->psz_text = NULL;
 
     p_var->i_type = i_type & ~VLC_VAR_DOINHERIT;
@@ -362,16 +650,21 @@ int var_Create( vlc_object_t *p_this, const char *psz_name, int i_type )
         var_Inherit(p_this, psz_name, i_type, &p_var->val);
 
     vlc_object_internals_t *p_priv = vlc_internals( p_this );
-    variable_t **pp_var, *p_oldvar;
+    variable_t *p_oldvar;
     int ret = VLC_SUCCESS;
 
     vlc_mutex_lock( &p_priv->var_lock );
 
-    pp_var = tsearch( p_var, &p_priv->var_root, varcmp );
-    if( unlikely(pp_var == NULL) )
-        ret = VLC_ENOMEM;
-    else if( (p_oldvar = *pp_var) == p_var ) /* Variable create */
-        p_var = NULL; /* Variable created */
+    p_oldvar = TableFind( &p_priv->var_table, psz_name, p_var->atom->hash );
+    if( p_oldvar == NULL ) /* Variable create */
+    {
+        ret = TableInsert( &p_priv->var_table, p_var );
+        if( likely(ret == VLC_SUCCESS) )
+        {
+            AtomChanged( p_var->atom );
+            p_var = NULL; /* Variable created */
+        }
+    }
     else /* Variable already exists */
     {
         assert (((i_type ^ p_oldvar->i_type) & VLC_VAR_CLASS) == 0);
@@ -389,8 +682,7 @@ int var_Create( vlc_object_t *p_this, const char *psz_name, int i_type )
 /**
  * Destroy a vlc variable
  *
- * Look for the variable and destroy it if it is found. As in var_Create we
- * do a call to memmove() but we have performance counterparts elsewhere.
+ * Look for the variable and destroy it if it is found.
  *
  * \param p_this The object that holds the variable
  * \param psz_name The name of the variable
@@ -410,7 +702,8 @@ void (var_Destroy)(vlc_object_t *p_this, const char *psz_name)
     else if( --p_var->i_usage == 0 )
     {
         assert(!p_var->b_incallback);
-        tdelete( p_var, &p_priv->var_root, varcmp );
+        TableRemove( &p_priv->var_table, p_var );
+        AtomChanged( p_var->atom );
     }
     else
     {
@@ -428,12 +721,22 @@ static void CleanupVar( void *var )
     Destroy( var );
 }
 
+static void CleanupInherited( void *data )
+{
+    inherit_entry_t *entry = data;
+
+    if( entry->i_type == VLC_VAR_STRING )
+        free( entry->val.psz_string );
+    AtomRelease( entry->atom );
+    free( entry );
+}
+
 void var_DestroyAll( vlc_object_t *obj )
 {
     vlc_object_internals_t *priv = vlc_internals( obj );
 
-    tdestroy( priv->var_root, CleanupVar );
-    priv->var_root = NULL;
+    TableClean( &priv->var_table, CleanupVar );
+    TableClean( &priv->var_cache, CleanupInherited );
 }
 
 #undef var_Change
@@ -613,6 +916,14 @@ int var_Change( vlc_object_t *p_this, const char *psz_name,
             break;
     }
 
+    switch( i_action )
+    {
+        case VLC_VAR_SETSTEP:
+        case VLC_VAR_SETVALUE:
+            AtomChanged( p_var->atom );
+            break;
+    }
+
     vlc_mutex_unlock( &p_priv->var_lock );
 
     return ret;
@@ -681,6 +992,7 @@ int var_GetAndSet( vlc_object_t *p_this, const char *psz_name, int i_action,
     /*  Check boundaries */
     CheckValue( p_var, &p_var->val );
     *p_val = p_var->val;
+    AtomChanged( p_var->atom );
 
     /* Deal with callbacks.*/
     TriggerCallback( p_this, p_var, psz_name, oldval );
@@ -753,6 +1065,7 @@ int var_SetChecked( vlc_object_t *p_this, const char *psz_name,
 
     /* Set the variable */
     p_var->val = val;
+    AtomChanged( p_var->atom );
 
     /* Deal with callbacks */
     TriggerCallback( p_this, p_var, psz_name, oldval );
@@ -777,9 +1090,8 @@ int var_Set( vlc_object_t *p_this, const char *psz_name, vlc_value_t val )
     return var_SetChecked( p_this, psz_name, 0, val );
 }
 
-#undef var_GetChecked
-int var_GetChecked( vlc_object_t *p_this, const char *psz_name,
-                    int expected_type, vlc_value_t *p_val )
+static int GetChecked( vlc_object_t *p_this, const char *psz_name,
+                       uint32_t hash, int expected_type, vlc_value_t *p_val )
 {
     assert( p_this );
 
@@ -787,7 +1099,7 @@ int var_GetChecked( vlc_object_t *p_this, const char *psz_name,
     variable_t *p_var;
     int err = VLC_SUCCESS;
 
-    p_var = Lookup( p_this, psz_name );
+    p_var = LookupHash( p_this, psz_name, hash );
     if( p_var != NULL )
     {
         assert( expected_type == 0 ||
@@ -807,6 +1119,14 @@ int var_GetChecked( vlc_object_t *p_this, const char *psz_name,
     return err;
 }
 
+#undef var_GetChecked
+int var_GetChecked( vlc_object_t *p_this, const char *psz_name,
+                    int expected_type, vlc_value_t *p_val )
+{
+    return GetChecked( p_this, psz_name, HashName( psz_name ), expected_type,
+                       p_val );
+}
+
 #undef var_Get
 /**
  * Get a variable's value
@@ -1164,20 +1484,120 @@ int var_LocationParse (vlc_object_t *obj, const char *mrl, const char *pref)
     return ret;
 }
 
+/** Configuration epoch, incremented whenever a configuration item changes */
+static atomic_uint config_epoch = ATOMIC_VAR_INIT(0);
+
+void var_InvalidateConfig(void)
+{
+    atomic_fetch_add( &config_epoch, 1 );
+}
+
+static bool InheritCacheGet( vlc_object_t *obj, const char *psz_name,
+                             uint32_t hash, int i_type, vlc_value_t *p_val )
+{
+    vlc_object_internals_t *priv = vlc_internals( obj );
+    inherit_entry_t *entry;
+    bool hit = false;
+
+    vlc_mutex_lock( &priv->var_lock );
+    entry = TableFind( &priv->var_cache, psz_name, hash );
+    if( entry != NULL && entry->i_type == i_type
+     && entry->gen == atomic_load( &entry->atom->gen )
+     && entry->epoch == atomic_load( &config_epoch ) )
+    {
+        *p_val = entry->val;
+        if( i_type == VLC_VAR_STRING )
+            p_val->psz_string = strdup( entry->val.psz_string );
+        hit = true;
+    }
+    vlc_mutex_unlock( &priv->var_lock );
+    return hit;
+}
+
+static void InheritCachePut( vlc_object_t *obj, const var_atom_t *atom,
+                             unsigned gen, unsigned epoch, int i_type,
+                             vlc_value_t val )
+{
+    vlc_object_internals_t *priv = vlc_internals( obj );
+    inherit_entry_t *entry;
+
+    if( i_type == VLC_VAR_STRING )
+    {
+        if( unlikely(val.psz_string == NULL) )
+            return;
+        val.psz_string = strdup( val.psz_string );
+        if( unlikely(val.psz_string == NULL) )
+            return;
+    }
+
+    vlc_mutex_lock( &priv->var_lock );
+    entry = TableFind( &priv->var_cache, atom->name, atom->hash );
+    if( entry == NULL )
+    {
+        entry = malloc( sizeof (*entry) );
+        if( likely(entry != NULL) )
+        {
+            entry->atom = atom;
+            if( likely(TableInsert( &priv->var_cache, entry ) == 0) )
+                AtomHold( atom );
+            else
+            {
+                free( entry );
+                entry = NULL;
+            }
+        }
+    }
+    else if( entry->i_type == VLC_VAR_STRING )
+        free( entry->val.psz_string );
+
+    if( likely(entry != NULL) )
+    {
+        entry->gen = gen;
+        entry->epoch = epoch;
+        entry->i_type = i_type;
+        entry->val = val;
+        val.psz_string = NULL;
+    }
+    vlc_mutex_unlock( &priv->var_lock );
+
+    if( i_type == VLC_VAR_STRING )
+        free( val.psz_string );
+}
+
 /**
  * Finds the value of a variable. If the specified object does not hold a
  * variable with the specified name, try the parent object, and iterate until
  * the top of the tree. If no match is found, the value is read from the
  * configuration.
+ *
+ * The result is cached in the specified object, until a variable with the
+ * same name is created, destroyed or modified anywhere, or until the
+ * configuration changes.
  */
 int var_Inherit( vlc_object_t *p_this, const char *psz_name, int i_type,
                  vlc_value_t *p_val )
 {
+    uint32_t hash = HashName( psz_name );
+
     i_type &= VLC_VAR_CLASS;
+    if( InheritCacheGet( p_this, psz_name, hash, i_type, p_val ) )
+        return VLC_SUCCESS;
+
+    /* Snapshot the generations before looking the value up, so that any
+     * concurrent change invalidates the entry about to be cached. Names which
+     * are neither variables nor configuration items are not interned, and
+     * their values are not cached. */
+    var_atom_t *atom = AtomFind( psz_name, hash );
+    if( atom == NULL && config_FindConfig( psz_name ) != NULL )
+        atom = AtomGet( psz_name, hash );
+    unsigned gen = 0, epoch = atomic_load( &config_epoch );
+    if( likely(atom != NULL) )
+        gen = atomic_load( &atom->gen );
+
     for( vlc_object_t *obj = p_this; obj != NULL; obj = obj->obj.parent )
     {
-        if( var_GetChecked( obj, psz_name, i_type, p_val ) == VLC_SUCCESS )
-            return VLC_SUCCESS;
+        if( GetChecked( obj, psz_name, hash, i_type, p_val ) == VLC_SUCCESS )
+            goto found;
     }
 
     /* else take value from config */
@@ -1199,8 +1619,16 @@ int var_Inherit( vlc_object_t *p_this, const char *psz_name, int i_type,
         default:
             vlc_assert_unreachable();
         case VLC_VAR_ADDRESS:
+            if( atom != NULL )
+                AtomRelease( atom );
             return VLC_ENOOBJ;
     }
+found:
+    if( atom != NULL )
+    {
+        InheritCachePut( p_this, atom, gen, epoch, i_type, *p_val );
+        AtomRelease( atom );
+    }
     return VLC_SUCCESS;
 }
 
@@ -1309,13 +1737,36 @@ void var_FreeList( vlc_value_t *p_val, vlc_value_t *p_val2 )
     }
 }
 
-static void DumpVariable(const void *data, const VISIT which, const int depth)
+static int VarNameCmp(const void *a, const void *b)
 {
-    if (which != postorder && which != leaf)
-        return;
-    (void) depth;
+    const variable_t *va = *(const variable_t **)a;
+    const variable_t *vb = *(const variable_t **)b;
+
+    return strcmp(va->psz_name, vb->psz_name);
+}
 
-    const variable_t *var = *(const variable_t **)data;
+/**
+ * Lists the variables of an object, sorted by name.
+ *
+ * \note The caller must hold the variable lock.
+ */
+static variable_t **SortedVariables(vlc_object_internals_t *priv)
+{
+    variable_t **vars = malloc(priv->var_table.count * sizeof (*vars));
+    size_t n = 0;
+
+    if (unlikely(vars == NULL))
+        return NULL;
+    for (size_t i = 0; i < priv->var_table.size; i++)
+        if (priv->var_table.slots[i] != NULL)
+            vars[n++] = priv->var_table.slots[i];
+    assert(n == priv->var_table.count);
+    qsort(vars, n, sizeof (*vars), VarNameCmp);
+    return vars;
+}
+
+static void DumpVariable(const variable_t *var)
+{
     const char *typename = "unknown";
 
     switch (var->i_type & VLC_VAR_TYPE)
@@ -1370,27 +1821,21 @@ static void DumpVariable(const void *data, const VISIT which, const int depth)
 
 void DumpVariables(vlc_object_t *obj)
 {
-    vlc_mutex_lock(&vlc_internals(obj)->var_lock);
-    if (vlc_internals(obj)->var_root == NULL)
+    vlc_object_internals_t *priv = vlc_internals(obj);
+
+    vlc_mutex_lock(&priv->var_lock);
+    if (priv->var_table.count == 0)
         puts(" `-o No variables");
     else
-        twalk(vlc_internals(obj)->var_root, DumpVariable);
-    vlc_mutex_unlock(&vlc_internals(obj)->var_lock);
-}
-
-static thread_local void *twalk_ctx;
-
-static void TwalkGetNames(const void *data, const VISIT which, const int depth)
-{
-    if (which != postorder && which != leaf)
-        return;
-    (void) depth;
+    {
+        variable_t **vars = SortedVariables(priv);
 
-    const variable_t *var = *(const variable_t **)data;
-    DECL_ARRAY(char *) *names = twalk_ctx;
-    char *dup = strdup(var->psz_name);
-    if (dup != NULL)
-        ARRAY_APPEND(*names, dup);
+        if (vars != NULL)
+            for (size_t i = 0; i < priv->var_table.count; i++)
+                DumpVariable(vars[i]);
+        free(vars);
+    }
+    vlc_mutex_unlock(&priv->var_lock);
 }
 
 char **var_GetAllNames(vlc_object_t *obj)
@@ -1400,9 +1845,20 @@ char **var_GetAllNames(vlc_object_t *obj)
     DECL_ARRAY(char *) names;
     ARRAY_INIT(names);
 
-    twalk_ctx = &names;
     vlc_mutex_lock(&priv->var_lock);
-    twalk(priv->var_root, TwalkGetNames);
+    if (priv->var_table.count > 0)
+    {
+        variable_t **vars = SortedVariables(priv);
+
+        if (vars != NULL)
+            for (size_t i = 0; i < priv->var_table.count; i++)
+            {
+                char *dup = strdup(vars[i]->psz_name);
+                if (dup != NULL)
+                    ARRAY_APPEND(names, dup);
+            }
+        free(vars);
+    }
     vlc_mutex_unlock(&priv->var_lock);
 
     if (names.i_size == 0)
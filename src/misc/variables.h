@@ -33,13 +33,25 @@ struct vlc_res;
  */
 typedef struct vlc_object_internals vlc_object_internals_t;
 
+/**
+ * Open addressing hash table of variables (or cached values), keyed by their
+ * interned name.
+ */
+struct vlc_var_table
+{
+    void          **slots; /**< entries, or NULL for free slots */
+    size_t          size; /**< number of slots (zero or a power of two) */
+    size_t          count; /**< number of used slots */
+};
+
 struct vlc_object_internals
 {
     alignas (max_align_t) /* ensure vlc_externals() is maximally aligned */
     char           *psz_name; /* given name */
 
     /* Object variables */
-    void           *var_root;
+    struct vlc_var_table var_table;
+    struct vlc_var_table var_cache; /* inherited values */
     vlc_mutex_t     var_lock;
     vlc_cond_t      var_wait;
 
@@ -87,7 +87,13 @@ static void vlc_modcap_sort(const void *node, const VISIT which,
     if (which != postorder && which != leaf)
         return;
 
-    qsort(cap->modv, cap->modc, sizeof (*cap->modv), vlc_module_cmp);
+    /* Modules from the plugins cache are usually sorted already. */
+    for (size_t i = 1; i < cap->modc; i++)
+        if (vlc_module_cmp(cap->modv + i - 1, cap->modv + i) > 0)
+        {
+            qsort(cap->modv, cap->modc, sizeof (*cap->modv), vlc_module_cmp);
+            break;
+        }
     (void) depth;
 }
 
@@ -102,39 +108,41 @@ static struct
 vlc_plugin_t *vlc_plugins = NULL;
 
 /**
- * Adds a module to the bank
+ * Adds modules of a given capability to the bank
  */
-static int vlc_module_store(module_t *mod)
+static int vlc_modcap_store(const char *name, module_t *const *tab, size_t n)
 {
-    const char *name = module_get_capability(mod);
-    vlc_modcap_t *cap = malloc(sizeof (*cap));
-    if (unlikely(cap == NULL))
-        return -1;
+    vlc_modcap_t *cap;
+    vlc_modcap_t **cp = tfind(&name, &modules.caps_tree, vlc_modcap_cmp);
 
-    cap->name = strdup(name);
-    cap->modv = NULL;
-    cap->modc = 0;
+    if (cp != NULL)
+        cap = *cp;
+    else
+    {
+        cap = malloc(sizeof (*cap));
+        if (unlikely(cap == NULL))
+            return -1;
 
-    if (unlikely(cap->name == NULL))
-        goto error;
+        cap->name = strdup(name);
+        cap->modv = NULL;
+        cap->modc = 0;
 
-    vlc_modcap_t **cp = tsearch(cap, &modules.caps_tree, vlc_modcap_cmp);
-    if (unlikely(cp == NULL))
-        goto error;
+        if (unlikely(cap->name == NULL))
+            goto error;
 
-    if (*cp != cap)
-    {
-        vlc_modcap_free(cap);
-        cap = *cp;
+        cp = tsearch(cap, &modules.caps_tree, vlc_modcap_cmp);
+        if (unlikely(cp == NULL))
+            goto error;
+        assert(*cp == cap);
     }
 
-    module_t **modv = realloc(cap->modv, sizeof (*modv) * (cap->modc + 1));
+    module_t **modv = realloc(cap->modv, sizeof (*modv) * (cap->modc + n));
     if (unlikely(modv == NULL))
         return -1;
 
     cap->modv = modv;
-    cap->modv[cap->modc] = mod;
-    cap->modc++;
+    memcpy(cap->modv + cap->modc, tab, sizeof (*modv) * n);
+    cap->modc += n;
     return 0;
 error:
     vlc_modcap_free(cap);
@@ -142,14 +150,30 @@ error:
 }
 
 /**
- * Adds a plugin (and all its modules) to the bank
+ * Adds a module to the bank
  */
-static void vlc_plugin_store(vlc_plugin_t *lib)
+static int vlc_module_store(module_t *mod)
+{
+    return vlc_modcap_store(module_get_capability(mod), &mod, 1);
+}
+
+/**
+ * Adds a plugin to the bank, but not its modules
+ */
+static void vlc_plugin_link(vlc_plugin_t *lib)
 {
     /*vlc_assert_locked (&modules.lock);*/
 
     lib->next = vlc_plugins;
     vlc_plugins = lib;
+}
+
+/**
+ * Adds a plugin (and all its modules) to the bank
+ */
+static void vlc_plugin_store(vlc_plugin_t *lib)
+{
+    vlc_plugin_link(lib);
 
     for (module_t *m = lib->module; m != NULL; m = m->next)
         vlc_module_store(m);
@@ -258,7 +282,7 @@ typedef struct module_bank
 
     size_t        size;
     vlc_plugin_t **plugins;
-    vlc_plugin_t *cache;
+    vlc_plugin_cache_t cache;
 } module_bank_t;
 
 /**
@@ -271,37 +295,23 @@ static int AllocatePluginFile (module_bank_t *bank, const char *abspath,
 
     /* Check our plugins cache first then load plugin if needed */
     if (bank->mode & CACHE_READ_FILE)
-    {
-        plugin = vlc_cache_lookup(&bank->cache, relpath);
+        plugin = vlc_cache_lookup(&bank->cache, relpath, st);
 
-        if (plugin != NULL
-         && (plugin->mtime != (int64_t)st->st_mtime
-          || plugin->size != (uint64_t)st->st_size))
-        {
-            msg_Err(bank->obj, "stale plugins cache: modified %s",
-                    plugin->abspath);
-            vlc_plugin_destroy(plugin);
-            plugin = NULL;
-        }
-    }
-
-    if (plugin == NULL)
+    if (plugin != NULL)
+        /* Modules are stored by capability batches, see AllocatePluginPath */
+        vlc_plugin_link(plugin);
+    else
     {
         plugin = module_InitDynamic(bank->obj, abspath, true);
+        if (plugin == NULL)
+            return -1;
 
-        if (plugin != NULL)
-        {
-            plugin->path = xstrdup(relpath);
-            plugin->mtime = st->st_mtime;
-            plugin->size = st->st_size;
-        }
+        plugin->path = xstrdup(relpath);
+        plugin->mtime = st->st_mtime;
+        plugin->size = st->st_size;
+        vlc_plugin_store(plugin);
     }
 
-    if (plugin == NULL)
-        return -1;
-
-    vlc_plugin_store(plugin);
-
     if (bank->mode & CACHE_WRITE_FILE) /* Add entry to to-be-saved cache */
     {
         bank->plugins = xrealloc(bank->plugins,
@@ -406,7 +416,7 @@ static void AllocatePluginPath(vlc_object_t *obj, const char *path,
     };
 
     if (mode & CACHE_READ_FILE)
-        bank.cache = vlc_cache_load(obj, path, &modules.caches);
+        vlc_cache_load(obj, path, &modules.caches, &bank.cache);
     else
         msg_Dbg(bank.obj, "ignoring plugins cache file");
 
@@ -419,17 +429,39 @@ static void AllocatePluginPath(vlc_object_t *obj, const char *path,
     }
 
     /* Deal with unmatched cache entries from cache file */
-    while (bank.cache != NULL)
+    if (!(mode & CACHE_SCAN_DIR))
+        for (size_t i = 0; i < bank.cache.count; i++)
+            if (bank.cache.plugins[i] != NULL)
+            {
+                vlc_plugin_link(bank.cache.plugins[i]);
+                bank.cache.plugins[i] = NULL;
+            }
+
+    /* Store the modules of the cached plugins, one capability at a time */
+    if (bank.cache.modules_count > 0)
     {
-        vlc_plugin_t *plugin = bank.cache;
+        module_t **tab = malloc(bank.cache.modules_count * sizeof (*tab));
+        size_t n = 0;
 
-        bank.cache = plugin->next;
-        if (mode & CACHE_SCAN_DIR)
-            vlc_plugin_destroy(plugin);
-        else
-            vlc_plugin_store(plugin);
+        if (likely(tab != NULL))
+            n = vlc_cache_merge(&bank.cache, tab);
+
+        for (size_t i = 0, j; i < n; i = j)
+        {
+            const char *name = module_get_capability(tab[i]);
+
+            for (j = i + 1; j < n; j++)
+                if (strcmp(name, module_get_capability(tab[j])))
+                    break;
+
+            vlc_modcap_store(name, tab + i, j - i);
+        }
+        free(tab);
     }
 
+    /* Destroy stale and unmatched cache entries */
+    vlc_cache_clean(&bank.cache);
+
     if (mode & CACHE_WRITE_FILE)
         CacheSave(obj, path, bank.plugins, bank.size);
 
@@ -42,6 +42,7 @@
 #include "libvlc.h"
 
 #include <vlc_plugin.h>
+#include <vlc_modules.h>
 #include <errno.h>
 
 #include "config/configuration.h"
@@ -57,13 +58,108 @@
 #ifdef HAVE_DYNAMIC_PLUGINS
 /* Sub-version number
  * (only used to avoid breakage in dev version when cache structure changes) */
-#define CACHE_SUBVERSION_NUM 34
+#define CACHE_SUBVERSION_NUM 35
 
 /* Cache filename */
 #define CACHE_NAME "plugins.dat"
 /* Magic for the cache filename */
 #define CACHE_STRING "cache "PACKAGE_NAME" "PACKAGE_VERSION
 
+/*
+ * After the magic string, the sub-version number and the header marker, the
+ * cache file contains the following sections, each suitably aligned:
+ *  - the header, with the number of entries of each section,
+ *  - the plug-in records, sorted by relative path,
+ *  - the module records, sorted by capability then by decreasing score,
+ *  - the configuration item records, grouped by plug-in,
+ *  - the references: 32-bits module indices, string offsets and integer
+ *    choices, for the variable-sized lists of the records,
+ *  - the string pool.
+ * Strings are offsets within the string pool. Offset zero is NULL.
+ *
+ * All values use the host byte order and alignment, so that the loader can
+ * use the records and strings in place from the memory-mapped file.
+ */
+typedef struct
+{
+    uint32_t plugins;
+    uint32_t modules;
+    uint32_t configs;
+    uint32_t refs;
+    uint32_t strings; /**< Size of the string pool (bytes) */
+} vlc_cache_header_t;
+
+typedef struct
+{
+    int64_t mtime;
+    uint64_t size;
+    uint32_t path;
+    uint32_t textdomain;
+    uint32_t modules; /**< First reference to the module indices */
+    uint32_t modules_count;
+    uint32_t config; /**< First configuration item */
+    uint32_t config_count;
+    uint8_t unloadable;
+} vlc_cache_plugin_t;
+
+typedef struct
+{
+    uint32_t plugin; /**< Index of the owner plug-in */
+    uint32_t shortname;
+    uint32_t longname;
+    uint32_t help;
+    uint32_t capability;
+    uint32_t activate;
+    uint32_t deactivate;
+    uint32_t shortcuts; /**< First reference to the shortcut strings */
+    uint32_t shortcuts_count;
+    int32_t score;
+} vlc_cache_module_t;
+
+typedef union
+{
+    int64_t i;
+    float f;
+    uint32_t psz;
+} vlc_cache_value_t;
+
+#define CACHE_CONFIG_ADVANCED   0x01
+#define CACHE_CONFIG_INTERNAL   0x02
+#define CACHE_CONFIG_UNSAVEABLE 0x04
+#define CACHE_CONFIG_SAFE       0x08
+#define CACHE_CONFIG_REMOVED    0x10
+
+typedef struct
+{
+    vlc_cache_value_t orig;
+    vlc_cache_value_t min;
+    vlc_cache_value_t max;
+    uint32_t type;
+    uint32_t name;
+    uint32_t text;
+    uint32_t longtext;
+    uint32_t list_cb_name;
+    uint32_t list; /**< First reference to the choice values */
+    uint32_t list_text; /**< First reference to the choice names */
+    uint16_t list_count;
+    uint8_t i_type;
+    char i_short;
+    uint8_t flags;
+} vlc_cache_config_t;
+
+/* Integer choices are stored as references and used in place */
+static_assert(sizeof (int) == sizeof (uint32_t), "Unsupported int size");
+
+/** Sections of a cache file, as mapped in memory */
+typedef struct
+{
+    const vlc_cache_header_t *header;
+    const vlc_cache_plugin_t *plugins;
+    const vlc_cache_module_t *modules;
+    const vlc_cache_config_t *configs;
+    const uint32_t *refs;
+    const char *strings;
+} vlc_cache_file_t;
 
 static int vlc_cache_load_immediate(void *out, block_t *in, size_t size)
 {
@@ -76,17 +172,6 @@ static int vlc_cache_load_immediate(void *out, block_t *in, size_t size)
     return 0;
 }
 
-static int vlc_cache_load_bool(bool *out, block_t *in)
-{
-    unsigned char b;
-
-    if (vlc_cache_load_immediate(&b, in, 1) || b > 1)
-        return -1;
-
-    *out = b;
-    return 0;
-}
-
 static int vlc_cache_load_array(const void **p, size_t size, size_t n,
                                 block_t *file)
 {
@@ -110,30 +195,6 @@ static int vlc_cache_load_array(const void **p, size_t size, size_t n,
     return 0;
 }
 
-static int vlc_cache_load_string(const char **restrict p, block_t *file)
-{
-    uint16_t size;
-
-    if (vlc_cache_load_immediate(&size, file, sizeof (size)) || size > 16384)
-        return -1;
-
-    if (size == 0)
-    {
-        *p = NULL;
-        return 0;
-    }
-
-    const char *str = (char *)file->p_buffer;
-
-    if (file->i_buffer < size || str[size - 1] != '\0')
-        return -1;
-
-    file->p_buffer += size;
-    file->i_buffer -= size;
-    *p = str;
-    return 0;
-}
-
 static int vlc_cache_load_align(size_t align, block_t *file)
 {
     assert(align > 0);
@@ -153,17 +214,31 @@ static int vlc_cache_load_align(size_t align, block_t *file)
     return 0;
 }
 
+static int vlc_cache_get_string(const char **restrict p,
+                                const vlc_cache_file_t *file, uint32_t offset)
+{
+    if (offset >= file->header->strings)
+        return -1;
+
+    /* The pool is NUL-terminated, so is any string within it. */
+    *p = (offset != 0) ? (file->strings + offset) : NULL;
+    return 0;
+}
+
+static int vlc_cache_get_refs(const uint32_t **restrict p,
+                              const vlc_cache_file_t *file,
+                              uint32_t first, uint32_t count)
+{
+    if (first > file->header->refs || count > file->header->refs - first)
+        return -1;
+
+    *p = (count > 0) ? (file->refs + first) : NULL;
+    return 0;
+}
+
 #define LOAD_IMMEDIATE(a) \
     if (vlc_cache_load_immediate(&(a), file, sizeof (a))) \
         goto error
-#define LOAD_FLAG(a) \
-    do \
-    { \
-        bool b; \
-        if (vlc_cache_load_bool(&b, file)) \
-            goto error; \
-        (a) = b; \
-    } while (0)
 #define LOAD_ARRAY(a,n) \
     do \
     { \
@@ -172,106 +247,125 @@ static int vlc_cache_load_align(size_t align, block_t *file)
             goto error; \
         (a) = base; \
     } while (0)
-#define LOAD_STRING(a) \
-    if (vlc_cache_load_string(&(a), file)) \
-        goto error
 #define LOAD_ALIGNOF(t) \
     if (vlc_cache_load_align(alignof(t), file)) \
         goto error
+#define GET_STRING(a,offset) \
+    if (vlc_cache_get_string(&(a), file, (offset))) \
+        goto error
+#define GET_REFS(a,first,count) \
+    if (vlc_cache_get_refs(&(a), file, (first), (count))) \
+        goto error
 
-static int vlc_cache_load_config(module_config_t *cfg, block_t *file)
-{
-    LOAD_IMMEDIATE (cfg->i_type);
-    LOAD_IMMEDIATE (cfg->i_short);
-    LOAD_FLAG (cfg->b_advanced);
-    LOAD_FLAG (cfg->b_internal);
-    LOAD_FLAG (cfg->b_unsaveable);
-    LOAD_FLAG (cfg->b_safe);
-    LOAD_FLAG (cfg->b_removed);
-    LOAD_STRING (cfg->psz_type);
-    LOAD_STRING (cfg->psz_name);
-    LOAD_STRING (cfg->psz_text);
-    LOAD_STRING (cfg->psz_longtext);
-    LOAD_IMMEDIATE (cfg->list_count);
-
-    if (IsConfigStringType (cfg->i_type))
+static int vlc_cache_load_config(module_config_t *cfg,
+                                 const vlc_cache_file_t *file,
+                                 const vlc_cache_config_t *rec)
+{
+    const uint32_t *list, *list_text;
+
+    cfg->i_type = rec->i_type;
+    cfg->i_short = rec->i_short;
+    cfg->b_advanced = (rec->flags & CACHE_CONFIG_ADVANCED) != 0;
+    cfg->b_internal = (rec->flags & CACHE_CONFIG_INTERNAL) != 0;
+    cfg->b_unsaveable = (rec->flags & CACHE_CONFIG_UNSAVEABLE) != 0;
+    cfg->b_safe = (rec->flags & CACHE_CONFIG_SAFE) != 0;
+    cfg->b_removed = (rec->flags & CACHE_CONFIG_REMOVED) != 0;
+    GET_STRING(cfg->psz_type, rec->type);
+    GET_STRING(cfg->psz_name, rec->name);
+    GET_STRING(cfg->psz_text, rec->text);
+    GET_STRING(cfg->psz_longtext, rec->longtext);
+    GET_STRING(cfg->list_cb_name, rec->list_cb_name);
+    GET_REFS(list, rec->list, rec->list_count);
+    GET_REFS(list_text, rec->list_text, rec->list_count);
+
+    if (IsConfigStringType(cfg->i_type))
     {
         const char *psz;
-        LOAD_STRING(psz);
+
+        GET_STRING(psz, rec->orig.psz);
         cfg->orig.psz = (char *)psz;
-        cfg->value.psz = (psz != NULL) ? strdup (cfg->orig.psz) : NULL;
+        cfg->value.psz = (psz != NULL) ? strdup(psz) : NULL;
 
-        if (cfg->list_count)
-            cfg->list.psz = xmalloc (cfg->list_count * sizeof (char *));
-        else
-            LOAD_STRING(cfg->list_cb_name);
-        for (unsigned i = 0; i < cfg->list_count; i++)
+        if (rec->list_count > 0)
         {
-            LOAD_STRING (cfg->list.psz[i]);
-            if (cfg->list.psz[i] == NULL /* NULL -> empty string */
-             && (cfg->list.psz[i] = calloc (1, 1)) == NULL)
+            cfg->list.psz = malloc(rec->list_count * sizeof (char *));
+            if (unlikely(cfg->list.psz == NULL))
                 goto error;
+            cfg->list_count = rec->list_count;
+
+            for (unsigned i = 0; i < cfg->list_count; i++)
+            {
+                GET_STRING(cfg->list.psz[i], list[i]);
+                if (cfg->list.psz[i] == NULL) /* NULL -> empty string */
+                    cfg->list.psz[i] = "";
+            }
         }
     }
     else
     {
-        LOAD_IMMEDIATE (cfg->orig);
-        LOAD_IMMEDIATE (cfg->min);
-        LOAD_IMMEDIATE (cfg->max);
-        cfg->value = cfg->orig;
-
-        if (cfg->list_count)
+        if (IsConfigFloatType(cfg->i_type))
         {
-            LOAD_ALIGNOF(*cfg->list.i);
+            cfg->orig.f = rec->orig.f;
+            cfg->min.f = rec->min.f;
+            cfg->max.f = rec->max.f;
         }
         else
-            LOAD_STRING(cfg->list_cb_name);
+        {
+            cfg->orig.i = rec->orig.i;
+            cfg->min.i = rec->min.i;
+            cfg->max.i = rec->max.i;
+        }
+        cfg->value = cfg->orig;
 
-        LOAD_ARRAY(cfg->list.i, cfg->list_count);
+        if (rec->list_count > 0)
+        {
+            cfg->list.i = (const int *)list;
+            cfg->list_count = rec->list_count;
+        }
     }
 
-    cfg->list_text = xmalloc (cfg->list_count * sizeof (char *));
-    for (unsigned i = 0; i < cfg->list_count; i++)
+    if (cfg->list_count > 0)
     {
-        LOAD_STRING (cfg->list_text[i]);
-        if (cfg->list_text[i] == NULL /* NULL -> empty string */
-         && (cfg->list_text[i] = calloc (1, 1)) == NULL)
+        cfg->list_text = malloc(cfg->list_count * sizeof (char *));
+        if (unlikely(cfg->list_text == NULL))
             goto error;
+
+        for (unsigned i = 0; i < cfg->list_count; i++)
+        {
+            GET_STRING(cfg->list_text[i], list_text[i]);
+            if (cfg->list_text[i] == NULL) /* NULL -> empty string */
+                cfg->list_text[i] = "";
+        }
     }
 
     return 0;
 error:
-    return -1; /* FIXME: leaks */
+    return -1; /* released by config_Free() */
 }
 
-static int vlc_cache_load_plugin_config(vlc_plugin_t *plugin, block_t *file)
+static int vlc_cache_load_plugin_config(vlc_plugin_t *plugin,
+                                        const vlc_cache_file_t *file,
+                                        const vlc_cache_plugin_t *rec)
 {
-    uint16_t lines;
+    if (rec->config > file->header->configs
+     || rec->config_count > file->header->configs - rec->config
+     || rec->config_count > UINT16_MAX)
+        return -1;
 
-    /* Calculate the structure length */
-    LOAD_IMMEDIATE (lines);
+    if (rec->config_count == 0)
+        return 0;
 
-    /* Allocate memory */
-    if (lines)
-    {
-        plugin->conf.items = calloc(sizeof (module_config_t), lines);
-        if (unlikely(plugin->conf.items == NULL))
-        {
-            plugin->conf.size = 0;
-            return -1;
-        }
-    }
-    else
-        plugin->conf.items = NULL;
+    plugin->conf.items = calloc(rec->config_count, sizeof (module_config_t));
+    if (unlikely(plugin->conf.items == NULL))
+        return -1;
 
-    plugin->conf.size = lines;
+    plugin->conf.size = rec->config_count;
 
-    /* Do the duplication job */
-    for (size_t i = 0; i < lines; i++)
+    for (size_t i = 0; i < rec->config_count; i++)
     {
         module_config_t *item = plugin->conf.items + i;
 
-        if (vlc_cache_load_config(item, file))
+        if (vlc_cache_load_config(item, file, file->configs + rec->config + i))
             return -1;
 
         if (CONFIG_ITEM(item->i_type))
@@ -284,60 +378,78 @@ static int vlc_cache_load_plugin_config(vlc_plugin_t *plugin, block_t *file)
     }
 
     return 0;
-error:
-    return -1; /* FIXME: leaks */
 }
 
-static int vlc_cache_load_module(vlc_plugin_t *plugin, block_t *file)
+static module_t *vlc_cache_load_module(vlc_plugin_t *plugin,
+                                       const vlc_cache_file_t *file,
+                                       const vlc_cache_module_t *rec)
 {
     module_t *module = vlc_module_create(plugin);
     if (unlikely(module == NULL))
-        return -1;
+        return NULL;
 
-    LOAD_STRING(module->psz_shortname);
-    LOAD_STRING(module->psz_longname);
-    LOAD_STRING(module->psz_help);
+    GET_STRING(module->psz_shortname, rec->shortname);
+    GET_STRING(module->psz_longname, rec->longname);
+    GET_STRING(module->psz_help, rec->help);
 
-    LOAD_IMMEDIATE(module->i_shortcuts);
-    if (module->i_shortcuts > MODULE_SHORTCUT_MAX)
+    if (rec->shortcuts_count > MODULE_SHORTCUT_MAX)
         goto error;
-    else
+
+    const uint32_t *shortcuts;
+
+    GET_REFS(shortcuts, rec->shortcuts, rec->shortcuts_count);
+    if (rec->shortcuts_count > 0)
     {
         module->pp_shortcuts =
-            xmalloc (sizeof (*module->pp_shortcuts) * module->i_shortcuts);
-        for (unsigned j = 0; j < module->i_shortcuts; j++)
-            LOAD_STRING(module->pp_shortcuts[j]);
+            malloc(sizeof (*module->pp_shortcuts) * rec->shortcuts_count);
+        if (unlikely(module->pp_shortcuts == NULL))
+            goto error;
+
+        for (unsigned j = 0; j < rec->shortcuts_count; j++)
+            GET_STRING(module->pp_shortcuts[j], shortcuts[j]);
+        module->i_shortcuts = rec->shortcuts_count;
     }
 
-    LOAD_STRING(module->activate_name);
-    LOAD_STRING(module->deactivate_name);
-    LOAD_STRING(module->psz_capability);
-    LOAD_IMMEDIATE(module->i_score);
-    return 0;
+    GET_STRING(module->activate_name, rec->activate);
+    GET_STRING(module->deactivate_name, rec->deactivate);
+    GET_STRING(module->psz_capability, rec->capability);
+    module->i_score = rec->score;
+    return module;
 error:
-    return -1;
+    return NULL; /* released with the plug-in */
 }
 
-static vlc_plugin_t *vlc_cache_load_plugin(block_t *file)
+static vlc_plugin_t *vlc_cache_load_plugin(const vlc_cache_file_t *file,
+                                           uint32_t index, module_t **modv)
 {
+    const vlc_cache_plugin_t *rec = file->plugins + index;
     vlc_plugin_t *plugin = vlc_plugin_create();
     if (unlikely(plugin == NULL))
         return NULL;
 
-    uint32_t modules;
-    LOAD_IMMEDIATE(modules);
+    const uint32_t *refs;
 
-    for (size_t i = 0; i < modules; i++)
-        if (vlc_cache_load_module(plugin, file))
+    GET_REFS(refs, rec->modules, rec->modules_count);
+    for (size_t i = 0; i < rec->modules_count; i++)
+    {
+        uint32_t m = refs[i];
+
+        if (m >= file->header->modules || modv[m] != NULL
+         || file->modules[m].plugin != index)
+            goto error;
+
+        modv[m] = vlc_cache_load_module(plugin, file, file->modules + m);
+        if (modv[m] == NULL)
             goto error;
+    }
 
-    if (vlc_cache_load_plugin_config(plugin, file))
+    if (vlc_cache_load_plugin_config(plugin, file, rec))
         goto error;
 
-    LOAD_STRING(plugin->textdomain);
+    GET_STRING(plugin->textdomain, rec->textdomain);
 
     const char *path;
-    LOAD_STRING(path);
+    GET_STRING(path, rec->path);
     if (path == NULL)
         goto error;
 
@@ -345,9 +457,12 @@ static vlc_plugin_t *vlc_cache_load_plugin(block_t *file)
     if (unlikely(plugin->path == NULL))
         goto error;
 
-    LOAD_FLAG(plugin->unloadable);
-    LOAD_IMMEDIATE(plugin->mtime);
-    LOAD_IMMEDIATE(plugin->size);
+    if (rec->unloadable > 1)
+        goto error;
+
+    plugin->unloadable = rec->unloadable;
+    plugin->mtime = rec->mtime;
+    plugin->size = rec->size;
 
     if (plugin->textdomain != NULL)
         vlc_bindtextdomain(plugin->textdomain);
@@ -366,16 +481,25 @@ error:
  * will in turn be queried by AllocateAllPlugins() to see if it needs to
  * actually load the dynamically loadable module.
  * This allows us to only fully load plugins when they are actually used.
+ *
+ * Strings and integer choices of the plug-ins point into the file, which is
+ * memory-mapped where possible and appended to *backingp.
+ *
+ * \param cache cache to fill [OUT] (zeroed on error)
+ * \return 0 on success, -1 on error
  */
-vlc_plugin_t *vlc_cache_load(vlc_object_t *p_this, const char *dir,
-                             block_t **backingp)
+int vlc_cache_load(vlc_object_t *p_this, const char *dir, block_t **backingp,
+                   vlc_plugin_cache_t *cache)
 {
     char *psz_filename;
 
     assert( dir != NULL );
 
+    memset(cache, 0, sizeof (*cache));
+    cache->obj = p_this;
+
     if( asprintf( &psz_filename, "%s"DIR_SEP CACHE_NAME, dir ) == -1 )
-        return 0;
+        return -1;
 
     msg_Dbg( p_this, "loading plugins cache file %s", psz_filename );
 
@@ -385,7 +509,7 @@ vlc_plugin_t *vlc_cache_load(vlc_object_t *p_this, const char *dir,
                  vlc_strerror_c(errno));
     free(psz_filename);
     if (file == NULL)
-        return 0;
+        return -1;
 
     /* Check the file is a plugins cache */
     char cachestr[sizeof (CACHE_STRING) - 1];
@@ -395,7 +519,7 @@ vlc_plugin_t *vlc_cache_load(vlc_object_t *p_this, const char *dir,
     {
         msg_Warn( p_this, "This doesn't look like a valid plugins cache" );
         block_Release(file);
-        return 0;
+        return -1;
     }
 
 #ifdef DISTRO_VERSION
@@ -407,7 +531,7 @@ vlc_plugin_t *vlc_cache_load(vlc_object_t *p_this, const char *dir,
     {
         msg_Warn( p_this, "This doesn't look like a valid plugins cache" );
         block_Release(file);
-        return 0;
+        return -1;
     }
 #endif
 
@@ -420,7 +544,7 @@ vlc_plugin_t *vlc_cache_load(vlc_object_t *p_this, const char *dir,
         msg_Warn( p_this, "This doesn't look like a valid plugins cache "
                   "(corrupted header)" );
         block_Release(file);
-        return 0;
+        return -1;
     }
 
     /* Check header marker */
@@ -435,65 +559,90 @@ vlc_plugin_t *vlc_cache_load(vlc_object_t *p_this, const char *dir,
         msg_Warn( p_this, "This doesn't look like a valid plugins cache "
                   "(corrupted header)" );
         block_Release(file);
-        return 0;
+        return -1;
     }
 
-    vlc_plugin_t *cache = NULL;
+    /* Map the sections */
+    vlc_cache_file_t sections;
+    const vlc_cache_header_t *header;
+
+    LOAD_ALIGNOF(vlc_cache_header_t);
+    LOAD_ARRAY(header, 1);
+    sections.header = header;
+    LOAD_ALIGNOF(vlc_cache_plugin_t);
+    LOAD_ARRAY(sections.plugins, header->plugins);
+    LOAD_ALIGNOF(vlc_cache_module_t);
+    LOAD_ARRAY(sections.modules, header->modules);
+    LOAD_ALIGNOF(vlc_cache_config_t);
+    LOAD_ARRAY(sections.configs, header->configs);
+    LOAD_ALIGNOF(uint32_t);
+    LOAD_ARRAY(sections.refs, header->refs);
+    LOAD_ARRAY(sections.strings, header->strings);
+
+    if (file->i_buffer != 0 || header->strings == 0
+     || sections.strings[header->strings - 1] != '\0')
+        goto error;
+
+    /* Build the plug-ins */
+    cache->paths = malloc(header->plugins * sizeof (*cache->paths));
+    cache->plugins = calloc(header->plugins, sizeof (*cache->plugins));
+    cache->modules = calloc(header->modules, sizeof (*cache->modules));
+    cache->owners = malloc(header->modules * sizeof (*cache->owners));
+    if (unlikely((header->plugins > 0
+                  && (cache->paths == NULL || cache->plugins == NULL))
+              || (header->modules > 0
+                  && (cache->modules == NULL || cache->owners == NULL))))
+        goto error;
 
-    while (file->i_buffer > 0)
+    for (uint32_t i = 0; i < header->plugins; i++)
     {
-        vlc_plugin_t *plugin = vlc_cache_load_plugin(file);
+        vlc_plugin_t *plugin = vlc_cache_load_plugin(&sections, i,
+                                                     cache->modules);
         if (plugin == NULL)
             goto error;
 
+        cache->plugins[i] = plugin;
+        cache->count++;
+
+        /* The path index must be strictly sorted for bsearch() */
+        cache->paths[i] = sections.strings + sections.plugins[i].path;
+        if (i > 0 && strcmp(cache->paths[i - 1], cache->paths[i]) >= 0)
+            goto error;
+
         if (unlikely(asprintf(&plugin->abspath, "%s" DIR_SEP "%s", dir,
                               plugin->path) == -1))
         {
             plugin->abspath = NULL;
-            vlc_plugin_destroy(plugin);
             goto error;
         }
+    }
 
-        plugin->next = cache;
-        cache = plugin;
+    for (uint32_t i = 0; i < header->modules; i++)
+    {
+        if (cache->modules[i] == NULL) /* orphan module */
+            goto error;
+        cache->owners[i] = sections.modules[i].plugin;
     }
+    cache->modules_count = header->modules;
 
     file->p_next = *backingp;
     *backingp = file;
-    return cache;
+    return 0;
 
 error:
     msg_Warn( p_this, "plugins cache not loaded (corrupted)" );
 
-    /* TODO: cleanup */
+    cache->modules_count = 0;
+    vlc_cache_clean(cache);
     block_Release(file);
-    return NULL;
+    return -1;
 }
 
 #define SAVE_IMMEDIATE( a ) \
     if (fwrite (&(a), sizeof(a), 1, file) != 1) \
         goto error
-#define SAVE_FLAG(a) \
-    do { \
-        char b = (a); \
-        SAVE_IMMEDIATE(b); \
-    } while (0)
-
-static int CacheSaveString (FILE *file, const char *str)
-{
-    uint16_t size = (str != NULL) ? (strlen (str) + 1) : 0;
-
-    SAVE_IMMEDIATE (size);
-    if (size != 0 && fwrite(str, 1, size, file) != size)
-    {
-error:
-        return -1;
-    }
-    return 0;
-}
-
-#define SAVE_STRING( a ) \
-    if (CacheSaveString (file, (a))) \
+#define SAVE_ARRAY(a,n) \
+    if ((n) > 0 && fwrite ((a), sizeof (*(a)), (n), file) != (n)) \
         goto error
 
 static int CacheSaveAlign(FILE *file, size_t align)
@@ -512,92 +661,344 @@ static int CacheSaveAlign(FILE *file, size_t align)
     if (CacheSaveAlign(file, alignof (t))) \
         goto error
 
-static int CacheSaveConfig (FILE *file, const module_config_t *cfg)
-{
-    SAVE_IMMEDIATE (cfg->i_type);
-    SAVE_IMMEDIATE (cfg->i_short);
-    SAVE_FLAG (cfg->b_advanced);
-    SAVE_FLAG (cfg->b_internal);
-    SAVE_FLAG (cfg->b_unsaveable);
-    SAVE_FLAG (cfg->b_safe);
-    SAVE_FLAG (cfg->b_removed);
-    SAVE_STRING (cfg->psz_type);
-    SAVE_STRING (cfg->psz_name);
-    SAVE_STRING (cfg->psz_text);
-    SAVE_STRING (cfg->psz_longtext);
-    SAVE_IMMEDIATE (cfg->list_count);
-
-    if (IsConfigStringType (cfg->i_type))
+/** Cache file sections, as built in memory before saving */
+typedef struct
+{
+    vlc_cache_header_t header;
+    vlc_cache_plugin_t *plugins;
+    vlc_cache_module_t *modules;
+    vlc_cache_config_t *configs;
+    uint32_t *refs;
+    size_t refs_alloc;
+    char *strings;
+    size_t strings_alloc;
+} cache_writer_t;
+
+/**
+ * Appends bytes to a growing buffer.
+ * \return the offset of the bytes within the buffer, or 0 on error
+ * (nothing is ever appended at offset zero).
+ */
+static uint32_t CacheAppend(char **bufp, size_t *allocp, uint32_t *sizep,
+                            const void *data, size_t len)
+{
+    size_t size = *sizep;
+
+    if (size + len > UINT32_MAX)
+        return 0;
+
+    if (size + len > *allocp)
+    {
+        size_t alloc = (*allocp > 0) ? *allocp : 4096;
+        while (alloc < size + len)
+            alloc *= 2;
+
+        char *buf = realloc(*bufp, alloc);
+        if (unlikely(buf == NULL))
+            return 0;
+
+        *bufp = buf;
+        *allocp = alloc;
+    }
+
+    memcpy(*bufp + size, data, len);
+    *sizep = size + len;
+    return size;
+}
+
+static int CacheSaveString(cache_writer_t *w, uint32_t *offset,
+                           const char *str)
+{
+    if (str == NULL)
+    {
+        *offset = 0;
+        return 0;
+    }
+
+    *offset = CacheAppend(&w->strings, &w->strings_alloc, &w->header.strings,
+                          str, strlen(str) + 1);
+    return (*offset != 0) ? 0 : -1;
+}
+
+#define SAVE_STRING(o,a) \
+    if (CacheSaveString(w, &(o), (a))) \
+        goto error
+
+/**
+ * Reserves space for a list of references.
+ * \return a pointer to the references (invalidated by the next call)
+ */
+static uint32_t *CacheSaveRefs(cache_writer_t *w, uint32_t *first,
+                               size_t count)
+{
+    if (count > UINT32_MAX - w->header.refs)
+        return NULL;
+
+    if (w->refs == NULL || w->header.refs + count > w->refs_alloc)
     {
-        SAVE_STRING (cfg->orig.psz);
+        size_t alloc = (w->refs_alloc > 0) ? w->refs_alloc : 1024;
+        while (alloc < w->header.refs + count)
+            alloc *= 2;
+
+        uint32_t *refs = realloc(w->refs, alloc * sizeof (*refs));
+        if (unlikely(refs == NULL))
+            return NULL;
+
+        w->refs = refs;
+        w->refs_alloc = alloc;
+    }
+
+    *first = w->header.refs;
+    w->header.refs += count;
+    return w->refs + *first;
+}
+
+#define SAVE_REFS(p,o,n) \
+    if (((p) = CacheSaveRefs(w, &(o), (n))) == NULL) \
+        goto error
+
+static int CacheSaveConfig(cache_writer_t *w, vlc_cache_config_t *rec,
+                           const module_config_t *cfg)
+{
+    uint32_t *refs;
+    uint32_t offset;
+
+    rec->i_type = cfg->i_type;
+    rec->i_short = cfg->i_short;
+    rec->flags = (cfg->b_advanced ? CACHE_CONFIG_ADVANCED : 0)
+               | (cfg->b_internal ? CACHE_CONFIG_INTERNAL : 0)
+               | (cfg->b_unsaveable ? CACHE_CONFIG_UNSAVEABLE : 0)
+               | (cfg->b_safe ? CACHE_CONFIG_SAFE : 0)
+               | (cfg->b_removed ? CACHE_CONFIG_REMOVED : 0);
+    SAVE_STRING(rec->type, cfg->psz_type);
+    SAVE_STRING(rec->name, cfg->psz_name);
+    SAVE_STRING(rec->text, cfg->psz_text);
+    SAVE_STRING(rec->longtext, cfg->psz_longtext);
+    rec->list_count = cfg->list_count;
+
+    if (IsConfigStringType(cfg->i_type))
+    {
+        SAVE_STRING(rec->orig.psz, cfg->orig.psz);
         if (cfg->list_count == 0)
-            SAVE_STRING(cfg->list_cb_name);
+            SAVE_STRING(rec->list_cb_name, cfg->list_cb_name);
 
+        SAVE_REFS(refs, rec->list, cfg->list_count);
         for (unsigned i = 0; i < cfg->list_count; i++)
-            SAVE_STRING (cfg->list.psz[i]);
+        {
+            SAVE_STRING(offset, cfg->list.psz[i]);
+            w->refs[rec->list + i] = offset;
+        }
     }
     else
     {
-        SAVE_IMMEDIATE (cfg->orig);
-        SAVE_IMMEDIATE (cfg->min);
-        SAVE_IMMEDIATE (cfg->max);
-
-        if (cfg->list_count > 0)
+        if (IsConfigFloatType(cfg->i_type))
         {
-            SAVE_ALIGNOF(*cfg->list.i);
+            rec->orig.f = cfg->orig.f;
+            rec->min.f = cfg->min.f;
+            rec->max.f = cfg->max.f;
         }
         else
-            SAVE_STRING(cfg->list_cb_name);
+        {
+            rec->orig.i = cfg->orig.i;
+            rec->min.i = cfg->min.i;
+            rec->max.i = cfg->max.i;
+        }
+
+        if (cfg->list_count == 0)
+            SAVE_STRING(rec->list_cb_name, cfg->list_cb_name);
 
+        SAVE_REFS(refs, rec->list, cfg->list_count);
         for (unsigned i = 0; i < cfg->list_count; i++)
-             SAVE_IMMEDIATE (cfg->list.i[i]);
+            refs[i] = cfg->list.i[i];
     }
+
+    SAVE_REFS(refs, rec->list_text, cfg->list_count);
     for (unsigned i = 0; i < cfg->list_count; i++)
-        SAVE_STRING (cfg->list_text[i]);
+    {
+        SAVE_STRING(offset, cfg->list_text[i]);
+        w->refs[rec->list_text + i] = offset;
+    }
 
     return 0;
 error:
     return -1;
 }
 
-static int CacheSaveModuleConfig(FILE *file, const vlc_plugin_t *plugin)
+static int CacheSaveModule(cache_writer_t *w, vlc_cache_module_t *rec,
+                           const module_t *module)
 {
-    uint16_t lines = plugin->conf.size;
+    uint32_t *refs;
+    uint32_t offset;
 
-    SAVE_IMMEDIATE (lines);
+    SAVE_STRING(rec->shortname, module->psz_shortname);
+    SAVE_STRING(rec->longname, module->psz_longname);
+    SAVE_STRING(rec->help, module->psz_help);
 
-    for (size_t i = 0; i < lines; i++)
-        if (CacheSaveConfig(file, plugin->conf.items + i))
-           goto error;
+    rec->shortcuts_count = module->i_shortcuts;
+    SAVE_REFS(refs, rec->shortcuts, module->i_shortcuts);
+    for (size_t j = 0; j < module->i_shortcuts; j++)
+    {
+        SAVE_STRING(offset, module->pp_shortcuts[j]);
+        w->refs[rec->shortcuts + j] = offset;
+    }
 
+    SAVE_STRING(rec->activate, module->activate_name);
+    SAVE_STRING(rec->deactivate, module->deactivate_name);
+    SAVE_STRING(rec->capability, module->psz_capability);
+    rec->score = module->i_score;
     return 0;
 error:
     return -1;
 }
 
-static int CacheSaveModule(FILE *file, const module_t *module)
+typedef struct
 {
-    SAVE_STRING(module->psz_shortname);
-    SAVE_STRING(module->psz_longname);
-    SAVE_STRING(module->psz_help);
-    SAVE_IMMEDIATE(module->i_shortcuts);
+    const module_t *module;
+    uint32_t plugin; /**< Index of the owner plug-in (in path order) */
+    uint32_t rank; /**< Index of the module in the plug-ins order */
+} cache_module_t;
 
-    for (size_t j = 0; j < module->i_shortcuts; j++)
-         SAVE_STRING(module->pp_shortcuts[j]);
+static int CachePluginCmp(const void *a, const void *b)
+{
+    const vlc_plugin_t *const *pa = a, *const *pb = b;
+
+    return strcmp((*pa)->path, (*pb)->path);
+}
+
+static int CacheModuleCmp(const void *a, const void *b)
+{
+    const cache_module_t *ma = a, *mb = b;
+    int ret = strcmp(module_get_capability(ma->module),
+                     module_get_capability(mb->module));
+    if (ret != 0)
+        return ret;
+    /* Highest score first, like the capability lists of the bank */
+    if (ma->module->i_score != mb->module->i_score)
+        return (ma->module->i_score > mb->module->i_score) ? -1 : +1;
+    return (ma->rank > mb->rank) - (ma->rank < mb->rank);
+}
+
+/**
+ * Builds the cache file sections.
+ */
+static int CacheBuild(cache_writer_t *w, vlc_plugin_t *const *cache, size_t n)
+{
+    vlc_plugin_t **plugins = NULL;
+    cache_module_t *mods = NULL;
+    uint32_t *index = NULL;
+    size_t modules = 0, configs = 0;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        modules += cache[i]->modules_count;
+        configs += cache[i]->conf.size;
+    }
+
+    if (n > UINT32_MAX || modules > UINT32_MAX || configs > UINT32_MAX)
+        return -1;
+
+    w->header.plugins = n;
+    w->header.modules = modules;
+    w->header.configs = configs;
+    w->plugins = calloc(n, sizeof (*w->plugins));
+    w->modules = calloc(modules, sizeof (*w->modules));
+    w->configs = calloc(configs, sizeof (*w->configs));
+    plugins = malloc(n * sizeof (*plugins));
+    mods = malloc(modules * sizeof (*mods));
+    index = malloc(modules * sizeof (*index));
+    if (unlikely((n > 0 && (w->plugins == NULL || plugins == NULL))
+              || (modules > 0 && (w->modules == NULL || mods == NULL
+                                  || index == NULL))
+              || (configs > 0 && w->configs == NULL)))
+        goto error;
 
-    SAVE_STRING(module->activate_name);
-    SAVE_STRING(module->deactivate_name);
-    SAVE_STRING(module->psz_capability);
-    SAVE_IMMEDIATE(module->i_score);
+    /* Offset zero of the string pool is NULL */
+    CacheAppend(&w->strings, &w->strings_alloc, &w->header.strings, "", 1);
+    if (unlikely(w->header.strings != 1))
+        goto error;
+
+    /* Sort plug-ins by path, and modules by capability and score */
+    if (n > 0)
+    {
+        memcpy(plugins, cache, n * sizeof (*plugins));
+        qsort(plugins, n, sizeof (*plugins), CachePluginCmp);
+    }
+
+    size_t rank = 0;
+
+    for (size_t i = 0; i < n; i++)
+        for (const module_t *m = plugins[i]->module; m != NULL; m = m->next)
+        {
+            assert(rank < modules);
+            mods[rank].module = m;
+            mods[rank].plugin = i;
+            mods[rank].rank = rank;
+            rank++;
+        }
+    assert(rank == modules);
+
+    if (modules > 0)
+        qsort(mods, modules, sizeof (*mods), CacheModuleCmp);
+
+    for (size_t i = 0; i < modules; i++)
+    {
+        vlc_cache_module_t *rec = w->modules + i;
+
+        index[mods[i].rank] = i;
+        rec->plugin = mods[i].plugin;
+        if (CacheSaveModule(w, rec, mods[i].module))
+            goto error;
+    }
+
+    rank = 0;
+    configs = 0;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        const vlc_plugin_t *plugin = plugins[i];
+        vlc_cache_plugin_t *rec = w->plugins + i;
+        uint32_t *refs;
+
+        rec->modules_count = plugin->modules_count;
+        SAVE_REFS(refs, rec->modules, plugin->modules_count);
+        for (size_t j = 0; j < plugin->modules_count; j++)
+            refs[j] = index[rank++];
+
+        rec->config = configs;
+        rec->config_count = plugin->conf.size;
+        for (size_t j = 0; j < plugin->conf.size; j++)
+            if (CacheSaveConfig(w, w->configs + configs++,
+                                plugin->conf.items + j))
+                goto error;
+
+        SAVE_STRING(rec->textdomain, plugin->textdomain);
+        SAVE_STRING(rec->path, plugin->path);
+        rec->unloadable = plugin->unloadable;
+        rec->mtime = plugin->mtime;
+        rec->size = plugin->size;
+    }
+
+    free(index);
+    free(mods);
+    free(plugins);
     return 0;
 error:
+    free(index);
+    free(mods);
+    free(plugins);
     return -1;
 }
 
 static int CacheSaveBank(FILE *file, vlc_plugin_t *const *cache, size_t n)
 {
+    cache_writer_t writer, *w = &writer;
     uint32_t i_file_size = 0;
 
+    memset(w, 0, sizeof (*w));
+
+    if (CacheBuild(w, cache, n))
+        goto error;
+
     /* Contains version number */
     if (fputs (CACHE_STRING, file) == EOF)
         goto error;
@@ -617,36 +1018,34 @@ static int CacheSaveBank(FILE *file, vlc_plugin_t *const *cache, size_t n)
     if (fwrite (&i_file_size, sizeof (i_file_size), 1, file) != 1)
         goto error;
 
-    for (size_t i = 0; i < n; i++)
-    {
-        const vlc_plugin_t *plugin = cache[i];
-        uint32_t count = plugin->modules_count;
-
-        SAVE_IMMEDIATE(count);
-
-        for (module_t *module = plugin->module;
-             module != NULL;
-             module = module->next)
-            if (CacheSaveModule(file, module))
-                goto error;
-
-        /* Config stuff */
-        if (CacheSaveModuleConfig(file, plugin))
-            goto error;
-
-        /* Save common info */
-        SAVE_STRING(plugin->textdomain);
-        SAVE_STRING(plugin->path);
-        SAVE_FLAG(plugin->unloadable);
-        SAVE_IMMEDIATE(plugin->mtime);
-        SAVE_IMMEDIATE(plugin->size);
-    }
+    SAVE_ALIGNOF(vlc_cache_header_t);
+    SAVE_IMMEDIATE(w->header);
+    SAVE_ALIGNOF(vlc_cache_plugin_t);
+    SAVE_ARRAY(w->plugins, w->header.plugins);
+    SAVE_ALIGNOF(vlc_cache_module_t);
+    SAVE_ARRAY(w->modules, w->header.modules);
+    SAVE_ALIGNOF(vlc_cache_config_t);
+    SAVE_ARRAY(w->configs, w->header.configs);
+    SAVE_ALIGNOF(uint32_t);
+    SAVE_ARRAY(w->refs, w->header.refs);
+    SAVE_ARRAY(w->strings, w->header.strings);
 
     if (fflush (file)) /* flush libc buffers */
         goto error;
+
+    free(w->strings);
+    free(w->refs);
+    free(w->configs);
+    free(w->modules);
+    free(w->plugins);
     return 0; /* success! */
 
 error:
+    free(w->strings);
+    free(w->refs);
+    free(w->configs);
+    free(w->modules);
+    free(w->plugins);
     return -1;
 }
 
@@ -697,25 +1096,83 @@ out:
     free (tmpname);
 }
 
+static int vlc_cache_path_cmp(const void *key, const void *entry)
+{
+    const char *const *path = entry;
+
+    return strcmp(key, *path);
+}
+
 /**
  * Looks up a plugin file in a table of cached plugins.
+ *
+ * If the cached plug-in matches the file, it is removed from the table, and
+ * its modules are left for vlc_cache_merge() to register.
+ *
+ * \return the cached plug-in, or NULL if not found or stale.
  */
-vlc_plugin_t *vlc_cache_lookup(vlc_plugin_t **cache, const char *path)
+vlc_plugin_t *vlc_cache_lookup(vlc_plugin_cache_t *cache, const char *path,
+                               const struct stat *st)
 {
-    vlc_plugin_t **pp = cache, *plugin;
+    if (cache->count == 0)
+        return NULL;
 
-    while ((plugin = *pp) != NULL)
-    {
-        if (plugin->path != NULL && !strcmp(plugin->path, path))
-        {
-            *pp = plugin->next;
-            plugin->next = NULL;
-            return plugin;
-        }
+    const char **entry = bsearch(path, cache->paths, cache->count,
+                                 sizeof (*cache->paths), vlc_cache_path_cmp);
+    if (entry == NULL)
+        return NULL;
+
+    size_t i = entry - cache->paths;
+    vlc_plugin_t *plugin = cache->plugins[i];
 
-        pp = &plugin->next;
+    if (plugin == NULL)
+        return NULL; /* already taken */
+
+    if (plugin->mtime != (int64_t)st->st_mtime
+     || plugin->size != (uint64_t)st->st_size)
+    {
+        msg_Err(cache->obj, "stale plugins cache: modified %s",
+                plugin->abspath);
+        return NULL;
     }
 
-    return NULL;
+    cache->plugins[i] = NULL;
+    return plugin;
+}
+
+/**
+ * Lists the cached modules of the plug-ins removed from a cache table.
+ *
+ * The modules are listed by capability then by decreasing score.
+ *
+ * \param tab table of at least cache->modules_count entries [OUT]
+ * \return the number of listed modules
+ */
+size_t vlc_cache_merge(const vlc_plugin_cache_t *cache, module_t **tab)
+{
+    size_t n = 0;
+
+    for (size_t i = 0; i < cache->modules_count; i++)
+        if (cache->plugins[cache->owners[i]] == NULL)
+            tab[n++] = cache->modules[i];
+    return n;
+}
+
+/**
+ * Releases a table of cached plugins.
+ *
+ * Plug-ins still in the table are destroyed.
+ */
+void vlc_cache_clean(vlc_plugin_cache_t *cache)
+{
+    for (size_t i = 0; i < cache->count; i++)
+        if (cache->plugins[i] != NULL)
+            vlc_plugin_destroy(cache->plugins[i]);
+
+    free(cache->owners);
+    free(cache->modules);
+    free(cache->plugins);
+    free(cache->paths);
+    memset(cache, 0, sizeof (*cache));
 }
 #endif /* HAVE_DYNAMIC_PLUGINS */
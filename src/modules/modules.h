@@ -127,8 +127,25 @@ void *module_Lookup (module_handle_t, const char *);
 void module_Unload (module_handle_t);
 
 /* Plugins cache */
-vlc_plugin_t *vlc_cache_load(vlc_object_t *, const char *, block_t **);
-vlc_plugin_t *vlc_cache_lookup(vlc_plugin_t **, const char *relpath);
+typedef struct vlc_plugin_cache
+{
+    vlc_object_t *obj;
+    size_t count; /**< Number of cached plug-ins */
+    const char **paths; /**< Relative paths, sorted */
+    vlc_plugin_t **plugins; /**< Plug-ins by path (NULL once looked up) */
+    size_t modules_count; /**< Number of cached modules */
+    module_t **modules; /**< Modules, sorted by capability and score */
+    uint32_t *owners; /**< Plug-in index of each module */
+} vlc_plugin_cache_t;
+
+struct stat;
+
+int vlc_cache_load(vlc_object_t *, const char *, block_t **,
+                   vlc_plugin_cache_t *);
+vlc_plugin_t *vlc_cache_lookup(vlc_plugin_cache_t *, const char *relpath,
+                               const struct stat *);
+size_t vlc_cache_merge(const vlc_plugin_cache_t *, module_t **);
+void vlc_cache_clean(vlc_plugin_cache_t *);
 
 void CacheSave(vlc_object_t *, const char *, vlc_plugin_t *const *, size_t);
 
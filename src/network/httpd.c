@@ -40,10 +40,14 @@
 #include <vlc_url.h>
 #include <vlc_mime.h>
 #include <vlc_block.h>
+#include <vlc_atomic.h>
+#include <vlc_fs.h>
+#include <vlc_cpu.h>
 #include "../libvlc.h"
 
 #include <string.h>
 #include <errno.h>
+#include <limits.h>
 #include <unistd.h>
 #ifdef HAVE_SYS_UIO_H
 # include <sys/uio.h>
@@ -52,6 +56,12 @@
 #ifdef HAVE_POLL
 # include <poll.h>
 #endif
+#ifdef HAVE_SYS_EPOLL_H
+# include <sys/epoll.h>
+#endif
+#ifdef HAVE_SYS_EVENTFD_H
+# include <sys/eventfd.h>
+#endif
 
 #if defined(_WIN32)
 #   include <winsock2.h>
@@ -66,10 +76,51 @@
 #define HTTPD_CL_BUFSIZE 10000
 #endif
 
+/* Maximum number of stream chunks sent at once to a client */
+#define HTTPD_CL_MAX_IOV 16
+
+/* Number of consecutive buffer overruns tolerated before dropping a client */
+#define HTTPD_CL_MAX_OVERRUNS 3
+
+/* Default upper bound on the number of client worker threads per host */
+#define HTTPD_MAX_WORKERS 4
+
+/* Number of socket events handled per worker wakeup */
+#define HTTPD_WORKER_EVENTS 64
+
+typedef struct httpd_stream_chunk_t httpd_stream_chunk_t;
+
 static void httpd_ClientDestroy(httpd_client_t *cl);
-static void httpd_AppendData(httpd_stream_t *stream, uint8_t *p_data, int i_data);
+static void httpd_StreamChunkRelease(httpd_stream_chunk_t *chunk);
+
+/* Each worker thread serves its own share of the clients of a host */
+typedef struct httpd_worker_t
+{
+    httpd_host_t   *host;
+    vlc_thread_t    thread;
+    vlc_mutex_t     lock;
+
+    int             i_client;
+    httpd_client_t  **client;
+
+    atomic_bool     b_data; /* a stream got data for a waiting client */
+    atomic_bool     b_woken;
+    int             wakefd[2];
 
-/* each host run in his own thread */
+#ifdef HAVE_SYS_EPOLL_H
+    int             epfd;
+    httpd_client_t  *ready[HTTPD_WORKER_EVENTS];
+#else
+    struct pollfd   *ufd;
+    httpd_client_t  **ready;
+    unsigned        i_ufd;
+    unsigned        i_alloc;
+#endif
+} httpd_worker_t;
+
+static void httpd_WorkerWake(httpd_worker_t *w);
+
+/* each host accepts connections in its own thread */
 struct httpd_host_t
 {
     VLC_COMMON_MEMBERS
@@ -93,8 +144,9 @@ struct httpd_host_t
     int         i_url;
     httpd_url_t **url;
 
-    int            i_client;
-    httpd_client_t **client;
+    /* the lock of a worker is always taken before the host lock */
+    unsigned        i_worker;
+    httpd_worker_t *worker;
 
     /* TLS data */
     vlc_tls_creds_t *p_tls;
@@ -146,11 +198,13 @@ struct httpd_client_t
 {
     httpd_url_t *url;
     vlc_tls_t   *sock;
+    httpd_worker_t *worker; /* serving this client */
 
     int     i_ref;
 
     bool    b_stream_mode;
     uint8_t i_state;
+    short   i_events; /* events the worker waits for */
 
     mtime_t i_activity_date;
     mtime_t i_activity_timeout;
@@ -167,6 +221,16 @@ struct httpd_client_t
      */
     int64_t i_keyframe_wait_to_pass;
 
+    /* Stream data referenced from the stream ring, sent with writev */
+    struct
+    {
+        httpd_stream_chunk_t *chunks[HTTPD_CL_MAX_IOV];
+        struct iovec iov[HTTPD_CL_MAX_IOV];
+        unsigned     i_first; /* first iov not fully sent */
+        unsigned     i_count;
+        unsigned     i_overruns; /* consecutive stream buffer overruns */
+    } ref;
+
     /* */
     httpd_message_t query;  /* client -> httpd */
     httpd_message_t answer; /* httpd -> client */
@@ -594,6 +658,14 @@ void httpd_RedirectDelete(httpd_redirect_t *rdir)
 /*****************************************************************************
  * High Level Funtions: httpd_stream_t
  *****************************************************************************/
+struct httpd_stream_chunk_t
+{
+    atomic_uint refs;
+    int64_t     i_pos;  /* absolute position of first byte */
+    size_t      i_size;
+    uint8_t     p_data[];
+};
+
 struct httpd_stream_t
 {
     vlc_mutex_t lock;
@@ -613,17 +685,57 @@ struct httpd_stream_t
     bool        b_has_keyframes;
     int64_t     i_last_keyframe_seen_pos;
 
-    /* circular buffer */
-    int         i_buffer_size;      /* buffer size, can't be reallocated smaller */
-    uint8_t     *p_buffer;          /* buffer */
+    /* ring of refcounted chunks, shared by all clients */
+    size_t      i_buffer_size;      /* maximum buffered bytes */
+    size_t      i_buffered;         /* currently buffered bytes */
+    httpd_stream_chunk_t **pp_chunks;
+    unsigned    i_chunks_alloc;     /* ring capacity, power of two */
+    unsigned    i_chunk_first;      /* oldest chunk index */
+    unsigned    i_chunks;
     int64_t     i_buffer_pos;       /* absolute position from beginning */
     int64_t     i_buffer_last_pos;  /* a new connection will start with that */
 
+    /* workers serving clients which wait for data, by host worker index */
+    bool        *pb_waiters;
+
+    /* slow clients */
+    uint64_t    i_overruns;         /* client data overwritten before sent */
+    uint64_t    i_dropped;          /* clients dropped after overruns */
+
     /* custom headers */
     size_t        i_http_headers;
     httpd_header * p_http_headers;
 };
 
+static void httpd_StreamChunkRelease(httpd_stream_chunk_t *chunk)
+{
+    if (atomic_fetch_sub(&chunk->refs, 1) == 1)
+        free(chunk);
+}
+
+static httpd_stream_chunk_t *httpd_StreamChunkAt(const httpd_stream_t *stream,
+                                                 unsigned i)
+{
+    return stream->pp_chunks[(stream->i_chunk_first + i)
+                             & (stream->i_chunks_alloc - 1)];
+}
+
+/* Finds the index of the chunk holding the given position (stream locked) */
+static unsigned httpd_StreamChunkFind(const httpd_stream_t *stream,
+                                      int64_t i_pos)
+{
+    unsigned lo = 0, hi = stream->i_chunks;
+
+    while (hi - lo > 1) {
+        unsigned mid = (lo + hi) / 2;
+        if (httpd_StreamChunkAt(stream, mid)->i_pos <= i_pos)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
 static int httpd_StreamCallBack(httpd_callback_sys_t *p_sys,
                                  httpd_client_t *cl, httpd_message_t *answer,
                                  const httpd_message_t *query)
@@ -634,47 +746,69 @@ static int httpd_StreamCallBack(httpd_callback_sys_t *p_sys,
         return VLC_SUCCESS;
 
     if (answer->i_body_offset > 0) {
-        int     i_pos;
+        vlc_mutex_lock(&stream->lock);
 
-        if (answer->i_body_offset >= stream->i_buffer_pos)
-            return VLC_EGENERIC;    /* wait, no data available */
+        if (answer->i_body_offset >= stream->i_buffer_pos) {
+            /* caught up with the stream */
+            cl->ref.i_overruns = 0;
+            goto wait;  /* wait, no data available */
+        }
 
         if (cl->i_keyframe_wait_to_pass >= 0) {
             if (stream->i_last_keyframe_seen_pos <= cl->i_keyframe_wait_to_pass)
                 /* still waiting for the next keyframe */
-                return VLC_EGENERIC;
+                goto wait;
 
             /* seek to the new keyframe */
             answer->i_body_offset = stream->i_last_keyframe_seen_pos;
             cl->i_keyframe_wait_to_pass = -1;
         }
 
-        if (answer->i_body_offset + stream->i_buffer_size < stream->i_buffer_pos)
-            answer->i_body_offset = stream->i_buffer_last_pos; /* this client isn't fast enough */
-
-        i_pos   = answer->i_body_offset % stream->i_buffer_size;
-        int64_t i_write = stream->i_buffer_pos - answer->i_body_offset;
-
-        if (i_write > HTTPD_CL_BUFSIZE)
-            i_write = HTTPD_CL_BUFSIZE;
-        else if (i_write <= 0)
-            return VLC_EGENERIC;    /* wait, no data available */
+        assert(stream->i_chunks > 0);
+        if (answer->i_body_offset < httpd_StreamChunkAt(stream, 0)->i_pos) {
+            /* this client isn't fast enough, its data was overwritten */
+            stream->i_overruns++;
+            if (++cl->ref.i_overruns > HTTPD_CL_MAX_OVERRUNS) {
+                stream->i_dropped++;
+                vlc_mutex_unlock(&stream->lock);
+                cl->i_state = HTTPD_CLIENT_DEAD;
+                return VLC_EGENERIC;
+            }
+            answer->i_body_offset = stream->i_buffer_last_pos;
+        }
 
-        /* Don't go past the end of the circular buffer */
-        i_write = __MIN(i_write, stream->i_buffer_size - i_pos);
+        /* Reference the chunks, no data is copied */
+        assert(cl->ref.i_count == 0);
+        cl->ref.i_first = 0;
+        for (unsigned i = httpd_StreamChunkFind(stream, answer->i_body_offset);
+             i < stream->i_chunks && cl->ref.i_count < HTTPD_CL_MAX_IOV; i++) {
+            httpd_stream_chunk_t *chunk = httpd_StreamChunkAt(stream, i);
+            size_t i_skip = answer->i_body_offset - chunk->i_pos;
+
+            atomic_fetch_add(&chunk->refs, 1);
+            cl->ref.chunks[cl->ref.i_count] = chunk;
+            cl->ref.iov[cl->ref.i_count].iov_base = chunk->p_data + i_skip;
+            cl->ref.iov[cl->ref.i_count].iov_len = chunk->i_size - i_skip;
+            cl->ref.i_count++;
+
+            answer->i_body_offset += chunk->i_size - i_skip;
+        }
+        vlc_mutex_unlock(&stream->lock);
 
         /* using HTTPD_MSG_ANSWER -> data available */
         answer->i_proto  = HTTPD_PROTO_HTTP;
         answer->i_version= 0;
         answer->i_type   = HTTPD_MSG_ANSWER;
 
-        answer->i_body = i_write;
-        answer->p_body = xmalloc(i_write);
-        memcpy(answer->p_body, &stream->p_buffer[i_pos], i_write);
-
-        answer->i_body_offset += i_write;
+        answer->i_body = 0;
+        answer->p_body = NULL;
 
         return VLC_SUCCESS;
+wait:
+        /* have the worker of this client woken up by the next data */
+        stream->pb_waiters[cl->worker - stream->url->host->worker] = true;
+        vlc_mutex_unlock(&stream->lock);
+        return VLC_EGENERIC;
     } else {
         answer->i_proto  = HTTPD_PROTO_HTTP;
         answer->i_version= 0;
@@ -771,11 +905,18 @@ httpd_stream_t *httpd_StreamNew(httpd_host_t *host,
     stream->i_header = 0;
     stream->p_header = NULL;
     stream->i_buffer_size = 5000000;    /* 5 Mo per stream */
-    stream->p_buffer = xmalloc(stream->i_buffer_size);
+    stream->i_buffered = 0;
+    stream->i_chunks_alloc = 64;
+    stream->pp_chunks = xmalloc(stream->i_chunks_alloc * sizeof(*stream->pp_chunks));
+    stream->i_chunk_first = 0;
+    stream->i_chunks = 0;
     /* We set to 1 to make life simpler
      * (this way i_body_offset can never be 0) */
     stream->i_buffer_pos = 1;
     stream->i_buffer_last_pos = 1;
+    stream->pb_waiters = xcalloc(host->i_worker, sizeof(*stream->pb_waiters));
+    stream->i_overruns = 0;
+    stream->i_dropped = 0;
     stream->b_has_keyframes = false;
     stream->i_last_keyframe_seen_pos = 0;
     stream->i_http_headers = 0;
@@ -807,45 +948,89 @@ int httpd_StreamHeader(httpd_stream_t *stream, uint8_t *p_data, int i_data)
     return VLC_SUCCESS;
 }
 
-static void httpd_AppendData(httpd_stream_t *stream, uint8_t *p_data, int i_data)
+static void httpd_AppendChunk(httpd_stream_t *stream, httpd_stream_chunk_t *chunk)
 {
-    int i_pos = stream->i_buffer_pos % stream->i_buffer_size;
-    int i_count = i_data;
-    while (i_count > 0) {
-        int i_copy = __MIN(i_count, stream->i_buffer_size - i_pos);
-
-        /* Ok, we can't go past the end of our buffer */
-        memcpy(&stream->p_buffer[i_pos], p_data, i_copy);
+    /* Drop the oldest chunks, clients still sending them hold a reference */
+    while (stream->i_chunks > 0
+        && stream->i_buffered + chunk->i_size > stream->i_buffer_size) {
+        httpd_stream_chunk_t *old = httpd_StreamChunkAt(stream, 0);
+
+        stream->i_buffered -= old->i_size;
+        stream->i_chunk_first = (stream->i_chunk_first + 1)
+                              & (stream->i_chunks_alloc - 1);
+        stream->i_chunks--;
+        httpd_StreamChunkRelease(old);
+    }
 
-        i_pos = (i_pos + i_copy) % stream->i_buffer_size;
-        i_count -= i_copy;
-        p_data  += i_copy;
+    if (stream->i_chunks == stream->i_chunks_alloc) {
+        /* Grow the ring, unwrapping it */
+        unsigned alloc = stream->i_chunks_alloc * 2;
+        httpd_stream_chunk_t **pp = xmalloc(alloc * sizeof(*pp));
+
+        for (unsigned i = 0; i < stream->i_chunks; i++)
+            pp[i] = httpd_StreamChunkAt(stream, i);
+        free(stream->pp_chunks);
+        stream->pp_chunks = pp;
+        stream->i_chunks_alloc = alloc;
+        stream->i_chunk_first = 0;
     }
 
-    stream->i_buffer_pos += i_data;
+    stream->pp_chunks[(stream->i_chunk_first + stream->i_chunks)
+                      & (stream->i_chunks_alloc - 1)] = chunk;
+    stream->i_chunks++;
+    stream->i_buffered += chunk->i_size;
+    stream->i_buffer_pos += chunk->i_size;
 }
 
 int httpd_StreamSend(httpd_stream_t *stream, const block_t *p_block)
 {
-    if (!p_block || !p_block->p_buffer)
+    if (!p_block || !p_block->p_buffer || p_block->i_buffer == 0)
         return VLC_SUCCESS;
 
+    /* Single copy of the data, shared by reference with all clients */
+    httpd_stream_chunk_t *chunk = malloc(sizeof(*chunk) + p_block->i_buffer);
+    if (unlikely(chunk == NULL))
+        return VLC_ENOMEM;
+
+    atomic_init(&chunk->refs, 1);
+    chunk->i_size = p_block->i_buffer;
+    memcpy(chunk->p_data, p_block->p_buffer, p_block->i_buffer);
+
     vlc_mutex_lock(&stream->lock);
 
     /* save this pointer (to be used by new connection) */
     stream->i_buffer_last_pos = stream->i_buffer_pos;
+    chunk->i_pos = stream->i_buffer_pos;
 
     if (p_block->i_flags & BLOCK_FLAG_TYPE_I) {
         stream->b_has_keyframes = true;
         stream->i_last_keyframe_seen_pos = stream->i_buffer_pos;
     }
 
-    httpd_AppendData(stream, p_block->p_buffer, p_block->i_buffer);
+    httpd_AppendChunk(stream, chunk);
+
+    /* Wake up only the workers serving clients waiting for this stream */
+    httpd_host_t *host = stream->url->host;
+    for (unsigned i = 0; i < host->i_worker; i++)
+        if (stream->pb_waiters[i]) {
+            stream->pb_waiters[i] = false;
+            atomic_store(&host->worker[i].b_data, true);
+            httpd_WorkerWake(&host->worker[i]);
+        }
 
     vlc_mutex_unlock(&stream->lock);
     return VLC_SUCCESS;
 }
 
+void httpd_StreamGetStats(httpd_stream_t *stream, uint64_t *overruns,
+                          uint64_t *dropped)
+{
+    vlc_mutex_lock(&stream->lock);
+    *overruns = stream->i_overruns;
+    *dropped = stream->i_dropped;
+    vlc_mutex_unlock(&stream->lock);
+}
+
 void httpd_StreamDelete(httpd_stream_t *stream)
 {
     httpd_UrlDelete(stream->url);
@@ -857,7 +1042,10 @@ void httpd_StreamDelete(httpd_stream_t *stream)
     vlc_mutex_destroy(&stream->lock);
     free(stream->psz_mime);
     free(stream->p_header);
-    free(stream->p_buffer);
+    for (unsigned i = 0; i < stream->i_chunks; i++)
+        httpd_StreamChunkRelease(httpd_StreamChunkAt(stream, i));
+    free(stream->pp_chunks);
+    free(stream->pb_waiters);
     free(stream);
 }
 
@@ -865,6 +1053,7 @@ void httpd_StreamDelete(httpd_stream_t *stream)
  * Low level
  *****************************************************************************/
 static void* httpd_HostThread(void *);
+static void* httpd_WorkerThread(void *);
 static httpd_host_t *httpd_HostCreate(vlc_object_t *, const char *,
                                        const char *, vlc_tls_creds_t *);
 
@@ -911,6 +1100,81 @@ static struct httpd
     int          i_host;
 } httpd = { VLC_STATIC_MUTEX, NULL, 0 };
 
+static int httpd_WorkerInit(httpd_worker_t *w, httpd_host_t *host)
+{
+    w->host = host;
+    w->i_client = 0;
+    w->client = NULL;
+    atomic_init(&w->b_data, false);
+    atomic_init(&w->b_woken, false);
+
+#if defined (HAVE_EVENTFD) && defined (EFD_CLOEXEC)
+    w->wakefd[0] = eventfd(0, EFD_CLOEXEC);
+    if (w->wakefd[0] != -1)
+        w->wakefd[1] = w->wakefd[0];
+    else
+#endif
+    if (vlc_pipe(w->wakefd))
+        return VLC_EGENERIC;
+
+#ifdef HAVE_SYS_EPOLL_H
+    w->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (w->epfd == -1)
+        goto error;
+
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+    if (epoll_ctl(w->epfd, EPOLL_CTL_ADD, w->wakefd[0], &ev)) {
+        vlc_close(w->epfd);
+        goto error;
+    }
+#else
+    w->ufd = NULL;
+    w->ready = NULL;
+    w->i_ufd = 0;
+    w->i_alloc = 0;
+#endif
+
+    vlc_mutex_init(&w->lock);
+    if (vlc_clone(&w->thread, httpd_WorkerThread, w,
+                  VLC_THREAD_PRIORITY_LOW)) {
+        vlc_mutex_destroy(&w->lock);
+#ifdef HAVE_SYS_EPOLL_H
+        vlc_close(w->epfd);
+#endif
+        goto error;
+    }
+    return VLC_SUCCESS;
+
+error:
+    if (w->wakefd[1] != w->wakefd[0])
+        vlc_close(w->wakefd[1]);
+    vlc_close(w->wakefd[0]);
+    return VLC_EGENERIC;
+}
+
+static void httpd_WorkerClean(httpd_worker_t *w)
+{
+    vlc_cancel(w->thread);
+    vlc_join(w->thread, NULL);
+
+    for (int i = 0; i < w->i_client; i++) {
+        msg_Warn(w->host, "client still connected");
+        httpd_ClientDestroy(w->client[i]);
+    }
+    TAB_CLEAN(w->i_client, w->client);
+
+#ifdef HAVE_SYS_EPOLL_H
+    vlc_close(w->epfd);
+#else
+    free(w->ufd);
+    free(w->ready);
+#endif
+    if (w->wakefd[1] != w->wakefd[0])
+        vlc_close(w->wakefd[1]);
+    vlc_close(w->wakefd[0]);
+    vlc_mutex_destroy(&w->lock);
+}
+
 static httpd_host_t *httpd_HostCreate(vlc_object_t *p_this,
                                        const char *hostvar,
                                        const char *portvar,
@@ -919,6 +1183,7 @@ static httpd_host_t *httpd_HostCreate(vlc_object_t *p_this,
     httpd_host_t *host;
     char *hostname = var_InheritString(p_this, hostvar);
     unsigned port = var_InheritInteger(p_this, portvar);
+    int64_t i_workers = var_InheritInteger(p_this, "http-threads");
 
     vlc_url_t url;
     vlc_UrlParse(&url, hostname);
@@ -964,6 +1229,8 @@ static httpd_host_t *httpd_HostCreate(vlc_object_t *p_this,
     vlc_mutex_init(&host->lock);
     vlc_cond_init(&host->wait);
     host->i_ref = 1;
+    host->i_worker = 0;
+    host->worker = NULL;
 
     host->fds = net_ListenTCP(p_this, url.psz_host, port);
     if (!host->fds) {
@@ -975,10 +1242,18 @@ static httpd_host_t *httpd_HostCreate(vlc_object_t *p_this,
     host->port     = port;
     host->i_url    = 0;
     host->url      = NULL;
-    host->i_client = 0;
-    host->client   = NULL;
     host->p_tls    = p_tls;
 
+    /* create the client workers */
+    if (i_workers <= 0)
+        i_workers = __MIN(vlc_GetCPUCount(), HTTPD_MAX_WORKERS);
+    host->worker = xmalloc(i_workers * sizeof (*host->worker));
+    for (host->i_worker = 0; host->i_worker < i_workers; host->i_worker++)
+        if (httpd_WorkerInit(&host->worker[host->i_worker], host)) {
+            msg_Err(p_this, "cannot spawn http worker thread");
+            goto error;
+        }
+
     /* create the thread */
     if (vlc_clone(&host->thread, httpd_HostThread, host,
                    VLC_THREAD_PRIORITY_LOW)) {
@@ -998,6 +1273,9 @@ error:
     vlc_mutex_unlock(&httpd.mutex);
 
     if (host) {
+        for (unsigned i = 0; i < host->i_worker; i++)
+            httpd_WorkerClean(&host->worker[i]);
+        free(host->worker);
         net_ListenClose(host->fds);
         vlc_cond_destroy(&host->wait);
         vlc_mutex_destroy(&host->lock);
@@ -1037,11 +1315,9 @@ void httpd_HostDelete(httpd_host_t *host)
     for (int i = 0; i < host->i_url; i++)
         msg_Err(host, "url still registered: %s", host->url[i]->psz_url);
 
-    for (int i = 0; i < host->i_client; i++) {
-        msg_Warn(host, "client still connected");
-        httpd_ClientDestroy(host->client[i]);
-    }
-    TAB_CLEAN(host->i_client, host->client);
+    for (unsigned i = 0; i < host->i_worker; i++)
+        httpd_WorkerClean(&host->worker[i]);
+    free(host->worker);
 
     vlc_tls_Delete(host->p_tls);
     net_ListenClose(host->fds);
@@ -1105,26 +1381,39 @@ void httpd_UrlDelete(httpd_url_t *url)
 
     vlc_mutex_lock(&host->lock);
     TAB_REMOVE(host->i_url, host->url, url);
+    vlc_mutex_unlock(&host->lock);
 
-    vlc_mutex_destroy(&url->lock);
-    free(url->psz_url);
-    free(url->psz_user);
-    free(url->psz_password);
+    /* Workers are locked before the host: no new client can pick the url
+     * anymore, and no callback is running once a worker has been locked.
+     * The clients are closed by their worker. */
+    for (unsigned i = 0; i < host->i_worker; i++) {
+        httpd_worker_t *w = &host->worker[i];
+        bool b_wake = false;
 
-    for (int i = 0; i < host->i_client; i++) {
-        httpd_client_t *client = host->client[i];
+        vlc_mutex_lock(&w->lock);
+        for (int j = 0; j < w->i_client; j++) {
+            httpd_client_t *client = w->client[j];
 
-        if (client->url != url)
-            continue;
+            if (client->url != url)
+                continue;
+
+            /* TODO complete it */
+            msg_Warn(host, "force closing connections");
+            client->url = NULL;
+            client->i_state = HTTPD_CLIENT_DEAD;
+            b_wake = true;
+        }
+        vlc_mutex_unlock(&w->lock);
 
-        /* TODO complete it */
-        msg_Warn(host, "force closing connections");
-        TAB_REMOVE(host->i_client, host->client, client);
-        httpd_ClientDestroy(client);
-        i--;
+        if (b_wake)
+            httpd_WorkerWake(w);
     }
+
+    vlc_mutex_destroy(&url->lock);
+    free(url->psz_url);
+    free(url->psz_user);
+    free(url->psz_password);
     free(url);
-    vlc_mutex_unlock(&host->lock);
 }
 
 static void httpd_MsgInit(httpd_message_t *msg)
@@ -1206,6 +1495,9 @@ static void httpd_ClientInit(httpd_client_t *cl, mtime_t now)
     cl->p_buffer = xmalloc(cl->i_buffer_size);
     cl->i_keyframe_wait_to_pass = -1;
     cl->b_stream_mode = false;
+    cl->ref.i_first = 0;
+    cl->ref.i_count = 0;
+    cl->ref.i_overruns = 0;
 
     httpd_MsgInit(&cl->query);
     httpd_MsgInit(&cl->answer);
@@ -1221,8 +1513,17 @@ char* httpd_ServerIP(const httpd_client_t *cl, char *ip, int *port)
     return net_GetSockAddress(vlc_tls_GetFD(cl->sock), ip, port) ? NULL : ip;
 }
 
+static void httpd_ClientReleaseRefs(httpd_client_t *cl)
+{
+    for (unsigned i = 0; i < cl->ref.i_count; i++)
+        httpd_StreamChunkRelease(cl->ref.chunks[i]);
+    cl->ref.i_first = 0;
+    cl->ref.i_count = 0;
+}
+
 static void httpd_ClientDestroy(httpd_client_t *cl)
 {
+    httpd_ClientReleaseRefs(cl);
     vlc_tls_Close(cl->sock);
     httpd_MsgClean(&cl->answer);
     httpd_MsgClean(&cl->query);
@@ -1240,6 +1541,7 @@ static httpd_client_t *httpd_ClientNew(vlc_tls_t *sock, mtime_t now)
     cl->i_ref   = 0;
     cl->sock    = sock;
     cl->url     = NULL;
+    cl->i_events = 0;
 
     httpd_ClientInit(cl, now);
     return cl;
@@ -1565,9 +1867,37 @@ static void httpd_ClientRecv(httpd_client_t *cl)
         cl->i_activity_timeout = 0;
 }
 
-static void httpd_ClientSend(httpd_client_t *cl)
+/* Sends the referenced stream chunks, releasing the fully sent ones */
+static ssize_t httpd_ClientSendRefs(httpd_client_t *cl)
 {
-    int i_len;
+    vlc_tls_t *sock = cl->sock;
+    ssize_t i_len = sock->writev(sock, &cl->ref.iov[cl->ref.i_first],
+                                 cl->ref.i_count - cl->ref.i_first);
+    if (i_len <= 0)
+        return i_len;
+
+    size_t i_sent = i_len;
+    while (cl->ref.i_first < cl->ref.i_count) {
+        struct iovec *iov = &cl->ref.iov[cl->ref.i_first];
+
+        if (i_sent < iov->iov_len) {
+            iov->iov_base = (uint8_t *)iov->iov_base + i_sent;
+            iov->iov_len -= i_sent;
+            break;
+        }
+        i_sent -= iov->iov_len;
+        cl->ref.i_first++;
+    }
+
+    if (cl->ref.i_first == cl->ref.i_count)
+        httpd_ClientReleaseRefs(cl);
+    return i_len;
+}
+
+/* Returns true if progress was made, false if the socket would block */
+static bool httpd_ClientSend(httpd_client_t *cl)
+{
+    ssize_t i_len;
 
     if (cl->i_buffer < 0) {
         /* We need to create the header */
@@ -1600,12 +1930,17 @@ static void httpd_ClientSend(httpd_client_t *cl)
         cl->i_buffer_size = (uint8_t*)p - cl->p_buffer;
     }
 
-    i_len = httpd_NetSend(cl, &cl->p_buffer[cl->i_buffer],
-                           cl->i_buffer_size - cl->i_buffer);
+    if (cl->i_buffer < cl->i_buffer_size)
+        i_len = httpd_NetSend(cl, &cl->p_buffer[cl->i_buffer],
+                               cl->i_buffer_size - cl->i_buffer);
+    else
+        i_len = httpd_ClientSendRefs(cl);
+
     if (i_len >= 0) {
-        cl->i_buffer += i_len;
+        if (cl->i_buffer < cl->i_buffer_size)
+            cl->i_buffer += i_len;
 
-        if (cl->i_buffer >= cl->i_buffer_size) {
+        if (cl->i_buffer >= cl->i_buffer_size && cl->ref.i_count == 0) {
             if (cl->answer.i_body == 0  && cl->answer.i_body_offset > 0) {
                 /* catch more body data */
                 int     i_msg = cl->query.i_type;
@@ -1614,8 +1949,12 @@ static void httpd_ClientSend(httpd_client_t *cl)
                 httpd_MsgClean(&cl->answer);
                 cl->answer.i_body_offset = i_offset;
 
+                vlc_mutex_lock(&cl->url->host->lock);
                 cl->url->catch[i_msg].cb(cl->url->catch[i_msg].p_sys, cl,
                                           &cl->answer, &cl->query);
+                vlc_mutex_unlock(&cl->url->host->lock);
+                if (cl->i_state == HTTPD_CLIENT_DEAD)
+                    return false; /* dropped by the callback */
             }
 
             if (cl->answer.i_body > 0) {
@@ -1627,9 +1966,10 @@ static void httpd_ClientSend(httpd_client_t *cl)
 
                 cl->answer.i_body = 0;
                 cl->answer.p_body = NULL;
-            } else /* send finished */
+            } else if (cl->ref.i_count == 0) /* send finished */
                 cl->i_state = HTTPD_CLIENT_SEND_DONE;
         }
+        return true;
     } else {
 #if defined(_WIN32)
         if ((i_len < 0 && WSAGetLastError() != WSAEWOULDBLOCK) || (i_len == 0))
@@ -1640,6 +1980,7 @@ static void httpd_ClientSend(httpd_client_t *cl)
             /* error */
             cl->i_state = HTTPD_CLIENT_DEAD;
         }
+        return false;
     }
 }
 
@@ -1694,304 +2035,450 @@ auth_failed:
     return false;
 }
 
-static void httpdLoop(httpd_host_t *host)
+/* Runs the client state machine up to the next network I/O, with the host
+ * lock held */
+static void httpd_ClientProcess(httpd_host_t *host, httpd_client_t *cl)
 {
-    struct pollfd ufd[host->nfd + host->i_client];
-    unsigned nfd;
-    for (nfd = 0; nfd < host->nfd; nfd++) {
-        ufd[nfd].fd = host->fds[nfd];
-        ufd[nfd].events = POLLIN;
-        ufd[nfd].revents = 0;
-    }
-
-    /* add all socket that should be read/write and close dead connection */
-    while (host->i_url <= 0) {
-        mutex_cleanup_push(&host->lock);
-        vlc_cond_wait(&host->wait, &host->lock);
-        vlc_cleanup_pop();
-    }
-
-    mtime_t now = mdate();
-    bool b_low_delay = false;
+    uint8_t i_state;
 
-    int canc = vlc_savecancel();
-    for (int i_client = 0; i_client < host->i_client; i_client++) {
+    do {
         int64_t i_offset;
-        httpd_client_t *cl = host->client[i_client];
-        if (cl->i_ref < 0 || (cl->i_ref == 0 &&
-                    (cl->i_state == HTTPD_CLIENT_DEAD ||
-                      (cl->i_activity_timeout > 0 &&
-                        cl->i_activity_date+cl->i_activity_timeout < now)))) {
-            TAB_REMOVE(host->i_client, host->client, cl);
-            i_client--;
-            httpd_ClientDestroy(cl);
-            continue;
-        }
-
-        struct pollfd *pufd = ufd + nfd;
-        assert (pufd < ufd + (sizeof (ufd) / sizeof (ufd[0])));
-
-        pufd->fd = vlc_tls_GetFD(cl->sock);
-        pufd->events = pufd->revents = 0;
 
+        i_state = cl->i_state;
         switch (cl->i_state) {
-            case HTTPD_CLIENT_RECEIVING:
-            case HTTPD_CLIENT_TLS_HS_IN:
-                pufd->events = POLLIN;
-                break;
+        case HTTPD_CLIENT_RECEIVE_DONE: {
+            httpd_message_t *answer = &cl->answer;
+            httpd_message_t *query  = &cl->query;
+
+            httpd_MsgInit(answer);
+
+            /* Handle what we received */
+            switch (query->i_type) {
+                case HTTPD_MSG_ANSWER:
+                    cl->url     = NULL;
+                    cl->i_state = HTTPD_CLIENT_DEAD;
+                    break;
+
+                case HTTPD_MSG_OPTIONS:
+                    answer->i_type   = HTTPD_MSG_ANSWER;
+                    answer->i_proto  = query->i_proto;
+                    answer->i_status = 200;
+                    answer->i_body = 0;
+                    answer->p_body = NULL;
+
+                    httpd_MsgAdd(answer, "Server", "VLC/%s", VERSION);
+                    httpd_MsgAdd(answer, "Content-Length", "0");
+
+                    switch(query->i_proto) {
+                    case HTTPD_PROTO_HTTP:
+                        answer->i_version = 1;
+                        httpd_MsgAdd(answer, "Allow", "GET,HEAD,POST,OPTIONS");
+                        break;
 
-            case HTTPD_CLIENT_SENDING:
-            case HTTPD_CLIENT_TLS_HS_OUT:
-                pufd->events = POLLOUT;
-                break;
+                    case HTTPD_PROTO_RTSP:
+                        answer->i_version = 0;
 
-            case HTTPD_CLIENT_RECEIVE_DONE: {
-                httpd_message_t *answer = &cl->answer;
-                httpd_message_t *query  = &cl->query;
+                        const char *p = httpd_MsgGet(query, "Cseq");
+                        if (p)
+                            httpd_MsgAdd(answer, "Cseq", "%s", p);
+                        p = httpd_MsgGet(query, "Timestamp");
+                        if (p)
+                            httpd_MsgAdd(answer, "Timestamp", "%s", p);
 
-                httpd_MsgInit(answer);
+                        p = httpd_MsgGet(query, "Require");
+                        if (p) {
+                            answer->i_status = 551;
+                            httpd_MsgAdd(query, "Unsupported", "%s", p);
+                        }
 
-                /* Handle what we received */
-                switch (query->i_type) {
-                    case HTTPD_MSG_ANSWER:
-                        cl->url     = NULL;
-                        cl->i_state = HTTPD_CLIENT_DEAD;
+                        httpd_MsgAdd(answer, "Public", "DESCRIBE,SETUP,"
+                                "TEARDOWN,PLAY,PAUSE,GET_PARAMETER");
                         break;
+                    }
+
+                    if (httpd_MsgGet(&cl->query, "Connection") != NULL)
+                        httpd_MsgAdd(answer, "Connection", "close");
 
-                    case HTTPD_MSG_OPTIONS:
+                    cl->i_buffer = -1;  /* Force the creation of the answer in
+                                         * httpd_ClientSend */
+                    cl->i_state = HTTPD_CLIENT_SENDING;
+                    break;
+
+                case HTTPD_MSG_NONE:
+                    if (query->i_proto == HTTPD_PROTO_NONE) {
+                        cl->url = NULL;
+                        cl->i_state = HTTPD_CLIENT_DEAD;
+                    } else {
+                        /* unimplemented */
+                        answer->i_proto  = query->i_proto ;
                         answer->i_type   = HTTPD_MSG_ANSWER;
-                        answer->i_proto  = query->i_proto;
-                        answer->i_status = 200;
-                        answer->i_body = 0;
-                        answer->p_body = NULL;
+                        answer->i_version= 0;
+                        answer->i_status = 501;
 
-                        httpd_MsgAdd(answer, "Server", "VLC/%s", VERSION);
-                        httpd_MsgAdd(answer, "Content-Length", "0");
+                        char *p;
+                        answer->i_body = httpd_HtmlError (&p, 501, NULL);
+                        answer->p_body = (uint8_t *)p;
+                        httpd_MsgAdd(answer, "Content-Length", "%d", answer->i_body);
+                        httpd_MsgAdd(answer, "Connection", "close");
 
-                        switch(query->i_proto) {
-                        case HTTPD_PROTO_HTTP:
-                            answer->i_version = 1;
-                            httpd_MsgAdd(answer, "Allow", "GET,HEAD,POST,OPTIONS");
-                            break;
+                        cl->i_buffer = -1;  /* Force the creation of the answer in httpd_ClientSend */
+                        cl->i_state = HTTPD_CLIENT_SENDING;
+                    }
+                    break;
 
-                        case HTTPD_PROTO_RTSP:
-                            answer->i_version = 0;
+                default: {
+                    int i_msg = query->i_type;
+                    bool b_auth_failed = false;
 
-                            const char *p = httpd_MsgGet(query, "Cseq");
-                            if (p)
-                                httpd_MsgAdd(answer, "Cseq", "%s", p);
-                            p = httpd_MsgGet(query, "Timestamp");
-                            if (p)
-                                httpd_MsgAdd(answer, "Timestamp", "%s", p);
+                    /* Search the url and trigger callbacks */
+                    for (int i = 0; i < host->i_url; i++) {
+                        httpd_url_t *url = host->url[i];
 
-                            p = httpd_MsgGet(query, "Require");
-                            if (p) {
-                                answer->i_status = 551;
-                                httpd_MsgAdd(query, "Unsupported", "%s", p);
-                            }
+                        if (strcmp(url->psz_url, query->psz_url))
+                            continue;
+                        if (!url->catch[i_msg].cb)
+                            continue;
 
-                            httpd_MsgAdd(answer, "Public", "DESCRIBE,SETUP,"
-                                    "TEARDOWN,PLAY,PAUSE,GET_PARAMETER");
-                            break;
+                        if (answer) {
+                            b_auth_failed = !httpdAuthOk(url->psz_user,
+                               url->psz_password,
+                               httpd_MsgGet(query, "Authorization")); /* BASIC id */
+                            if (b_auth_failed)
+                               break;
                         }
 
-                        if (httpd_MsgGet(&cl->query, "Connection") != NULL)
-                            httpd_MsgAdd(answer, "Connection", "close");
+                        if (url->catch[i_msg].cb(url->catch[i_msg].p_sys, cl, answer, query))
+                            continue;
 
-                        cl->i_buffer = -1;  /* Force the creation of the answer in
-                                             * httpd_ClientSend */
-                        cl->i_state = HTTPD_CLIENT_SENDING;
-                        break;
+                        if (answer->i_proto == HTTPD_PROTO_NONE)
+                            cl->i_buffer = cl->i_buffer_size; /* Raw answer from a CGI */
+                        else
+                            cl->i_buffer = -1;
 
-                    case HTTPD_MSG_NONE:
-                        if (query->i_proto == HTTPD_PROTO_NONE) {
-                            cl->url = NULL;
-                            cl->i_state = HTTPD_CLIENT_DEAD;
-                        } else {
-                            /* unimplemented */
-                            answer->i_proto  = query->i_proto ;
-                            answer->i_type   = HTTPD_MSG_ANSWER;
-                            answer->i_version= 0;
-                            answer->i_status = 501;
-
-                            char *p;
-                            answer->i_body = httpd_HtmlError (&p, 501, NULL);
-                            answer->p_body = (uint8_t *)p;
-                            httpd_MsgAdd(answer, "Content-Length", "%d", answer->i_body);
+                        /* only one url can answer */
+                        answer = NULL;
+                        if (!cl->url)
+                            cl->url = url;
+                    }
+
+                    if (answer) {
+                        answer->i_proto  = query->i_proto;
+                        answer->i_type   = HTTPD_MSG_ANSWER;
+                        answer->i_version= 0;
+
+                       if (b_auth_failed) {
+                            httpd_MsgAdd(answer, "WWW-Authenticate",
+                                    "Basic realm=\"VLC stream\"");
+                            answer->i_status = 401;
+                        } else
+                            answer->i_status = 404; /* no url registered */
+
+                        char *p;
+                        answer->i_body = httpd_HtmlError (&p, answer->i_status,
+                                query->psz_url);
+                        answer->p_body = (uint8_t *)p;
+
+                        cl->i_buffer = -1;  /* Force the creation of the answer in httpd_ClientSend */
+                        httpd_MsgAdd(answer, "Content-Length", "%d", answer->i_body);
+                        httpd_MsgAdd(answer, "Content-Type", "%s", "text/html");
+                        if (httpd_MsgGet(&cl->query, "Connection") != NULL)
                             httpd_MsgAdd(answer, "Connection", "close");
+                    }
 
-                            cl->i_buffer = -1;  /* Force the creation of the answer in httpd_ClientSend */
-                            cl->i_state = HTTPD_CLIENT_SENDING;
-                        }
-                        break;
+                    cl->i_state = HTTPD_CLIENT_SENDING;
+                }
+            }
+            break;
+        }
 
-                    default: {
-                        int i_msg = query->i_type;
-                        bool b_auth_failed = false;
-
-                        /* Search the url and trigger callbacks */
-                        for (int i = 0; i < host->i_url; i++) {
-                            httpd_url_t *url = host->url[i];
-
-                            if (strcmp(url->psz_url, query->psz_url))
-                                continue;
-                            if (!url->catch[i_msg].cb)
-                                continue;
-
-                            if (answer) {
-                                b_auth_failed = !httpdAuthOk(url->psz_user,
-                                   url->psz_password,
-                                   httpd_MsgGet(query, "Authorization")); /* BASIC id */
-                                if (b_auth_failed)
-                                   break;
-                            }
-
-                            if (url->catch[i_msg].cb(url->catch[i_msg].p_sys, cl, answer, query))
-                                continue;
-
-                            if (answer->i_proto == HTTPD_PROTO_NONE)
-                                cl->i_buffer = cl->i_buffer_size; /* Raw answer from a CGI */
-                            else
-                                cl->i_buffer = -1;
-
-                            /* only one url can answer */
-                            answer = NULL;
-                            if (!cl->url)
-                                cl->url = url;
-                        }
+        case HTTPD_CLIENT_SEND_DONE:
+            if (!cl->b_stream_mode || cl->answer.i_body_offset == 0) {
+                bool do_close = false;
 
-                        if (answer) {
-                            answer->i_proto  = query->i_proto;
-                            answer->i_type   = HTTPD_MSG_ANSWER;
-                            answer->i_version= 0;
-
-                           if (b_auth_failed) {
-                                httpd_MsgAdd(answer, "WWW-Authenticate",
-                                        "Basic realm=\"VLC stream\"");
-                                answer->i_status = 401;
-                            } else
-                                answer->i_status = 404; /* no url registered */
-
-                            char *p;
-                            answer->i_body = httpd_HtmlError (&p, answer->i_status,
-                                    query->psz_url);
-                            answer->p_body = (uint8_t *)p;
-
-                            cl->i_buffer = -1;  /* Force the creation of the answer in httpd_ClientSend */
-                            httpd_MsgAdd(answer, "Content-Length", "%d", answer->i_body);
-                            httpd_MsgAdd(answer, "Content-Type", "%s", "text/html");
-                            if (httpd_MsgGet(&cl->query, "Connection") != NULL)
-                                httpd_MsgAdd(answer, "Connection", "close");
-                        }
+                cl->url = NULL;
 
-                        cl->i_state = HTTPD_CLIENT_SENDING;
-                    }
+                if (cl->query.i_proto != HTTPD_PROTO_HTTP
+                 || cl->query.i_version > 0)
+                {
+                    const char *psz_connection = httpd_MsgGet(&cl->answer,
+                                                             "Connection");
+                    if (psz_connection != NULL)
+                        do_close = !strcasecmp(psz_connection, "close");
                 }
-                break;
+                else
+                    do_close = true;
+
+                if (!do_close) {
+                    httpd_MsgClean(&cl->query);
+                    httpd_MsgInit(&cl->query);
+
+                    cl->i_buffer = 0;
+                    cl->i_buffer_size = 1000;
+                    free(cl->p_buffer);
+                    cl->p_buffer = xmalloc(cl->i_buffer_size);
+                    cl->i_state = HTTPD_CLIENT_RECEIVING;
+                } else
+                    cl->i_state = HTTPD_CLIENT_DEAD;
+                httpd_MsgClean(&cl->answer);
+            } else {
+                i_offset = cl->answer.i_body_offset;
+                httpd_MsgClean(&cl->answer);
+
+                cl->answer.i_body_offset = i_offset;
+                free(cl->p_buffer);
+                cl->p_buffer = NULL;
+                cl->i_buffer = 0;
+                cl->i_buffer_size = 0;
+
+                cl->i_state = HTTPD_CLIENT_WAITING;
             }
+            break;
 
-            case HTTPD_CLIENT_SEND_DONE:
-                if (!cl->b_stream_mode || cl->answer.i_body_offset == 0) {
-                    bool do_close = false;
+        case HTTPD_CLIENT_WAITING:
+            i_offset = cl->answer.i_body_offset;
+            int i_msg = cl->query.i_type;
 
-                    cl->url = NULL;
+            httpd_MsgInit(&cl->answer);
+            cl->answer.i_body_offset = i_offset;
 
-                    if (cl->query.i_proto != HTTPD_PROTO_HTTP
-                     || cl->query.i_version > 0)
-                    {
-                        const char *psz_connection = httpd_MsgGet(&cl->answer,
-                                                                 "Connection");
-                        if (psz_connection != NULL)
-                            do_close = !strcasecmp(psz_connection, "close");
-                    }
-                    else
-                        do_close = true;
-
-                    if (!do_close) {
-                        httpd_MsgClean(&cl->query);
-                        httpd_MsgInit(&cl->query);
-
-                        cl->i_buffer = 0;
-                        cl->i_buffer_size = 1000;
-                        free(cl->p_buffer);
-                        cl->p_buffer = xmalloc(cl->i_buffer_size);
-                        cl->i_state = HTTPD_CLIENT_RECEIVING;
-                    } else
-                        cl->i_state = HTTPD_CLIENT_DEAD;
-                    httpd_MsgClean(&cl->answer);
-                } else {
-                    i_offset = cl->answer.i_body_offset;
-                    httpd_MsgClean(&cl->answer);
+            cl->url->catch[i_msg].cb(cl->url->catch[i_msg].p_sys, cl,
+                    &cl->answer, &cl->query);
+            if (cl->answer.i_type != HTTPD_MSG_NONE) {
+                /* we have new data, so re-enter send mode */
+                cl->i_buffer      = 0;
+                cl->p_buffer      = cl->answer.p_body;
+                cl->i_buffer_size = cl->answer.i_body;
+                cl->answer.p_body = NULL;
+                cl->answer.i_body = 0;
+                cl->i_state = HTTPD_CLIENT_SENDING;
+            }
+        }
+    } while (cl->i_state != i_state
+          && (cl->i_state == HTTPD_CLIENT_SEND_DONE
+           || cl->i_state == HTTPD_CLIENT_WAITING));
+}
 
-                    cl->answer.i_body_offset = i_offset;
-                    free(cl->p_buffer);
-                    cl->p_buffer = NULL;
-                    cl->i_buffer = 0;
-                    cl->i_buffer_size = 0;
+static short httpd_ClientEvents(const httpd_client_t *cl)
+{
+    switch (cl->i_state) {
+        case HTTPD_CLIENT_RECEIVING:
+        case HTTPD_CLIENT_TLS_HS_IN:
+            return POLLIN;
+
+        case HTTPD_CLIENT_SENDING:
+        case HTTPD_CLIENT_TLS_HS_OUT:
+            return POLLOUT;
+    }
+    return 0;
+}
 
-                    cl->i_state = HTTPD_CLIENT_WAITING;
-                }
-                break;
+/* Tells the worker which events to wait for on a client socket.
+ * Writes are edge-triggered: the client is written to until the socket
+ * would block, and the interest is re-armed when it re-enters a state. */
+static void httpd_WorkerWatch(httpd_worker_t *w, httpd_client_t *cl,
+                              short events, bool b_rearm)
+{
+    if (cl->i_events == events && !b_rearm)
+        return;
+#ifdef HAVE_SYS_EPOLL_H
+    if (cl->i_events != 0 || events != 0) {
+        struct epoll_event ev = {
+            .events = ((events & POLLIN) ? EPOLLIN : 0)
+                    | ((events & POLLOUT) ? EPOLLOUT | EPOLLET : 0),
+            .data.ptr = cl,
+        };
+        int op = EPOLL_CTL_MOD;
+
+        if (cl->i_events == 0)
+            op = EPOLL_CTL_ADD;
+        else if (events == 0)
+            op = EPOLL_CTL_DEL;
+
+        if (epoll_ctl(w->epfd, op, vlc_tls_GetFD(cl->sock), &ev)) {
+            msg_Err(w->host, "cannot watch client: %s",
+                    vlc_strerror_c(errno));
+            cl->i_state = HTTPD_CLIENT_DEAD;
+            events = 0;
+        }
+    }
+#else
+    VLC_UNUSED(w);
+#endif
+    cl->i_events = events;
+}
 
-            case HTTPD_CLIENT_WAITING:
-                i_offset = cl->answer.i_body_offset;
-                int i_msg = cl->query.i_type;
+static void httpd_WorkerRemove(httpd_worker_t *w, httpd_client_t *cl)
+{
+    httpd_WorkerWatch(w, cl, 0, false);
+    TAB_REMOVE(w->i_client, w->client, cl);
+    httpd_ClientDestroy(cl);
+}
 
-                httpd_MsgInit(&cl->answer);
-                cl->answer.i_body_offset = i_offset;
+static void httpd_WorkerWake(httpd_worker_t *w)
+{
+    if (atomic_exchange(&w->b_woken, true))
+        return; /* already pending */
 
-                cl->url->catch[i_msg].cb(cl->url->catch[i_msg].p_sys, cl,
-                        &cl->answer, &cl->query);
-                if (cl->answer.i_type != HTTPD_MSG_NONE) {
-                    /* we have new data, so re-enter send mode */
-                    cl->i_buffer      = 0;
-                    cl->p_buffer      = cl->answer.p_body;
-                    cl->i_buffer_size = cl->answer.i_body;
-                    cl->answer.p_body = NULL;
-                    cl->answer.i_body = 0;
-                    cl->i_state = HTTPD_CLIENT_SENDING;
-                }
+    uint64_t val = 1;
+    if (write(w->wakefd[1], &val, sizeof (val)) < 0)
+        msg_Err(w->host, "cannot wake worker: %s", vlc_strerror_c(errno));
+}
+
+static void httpd_WorkerDrain(httpd_worker_t *w)
+{
+    uint64_t val[8];
+
+    atomic_store(&w->b_woken, false);
+    if (read(w->wakefd[0], val, sizeof (val)) < 0)
+        msg_Err(w->host, "cannot drain worker: %s", vlc_strerror_c(errno));
+}
+
+#ifdef HAVE_SYS_EPOLL_H
+static void httpd_WorkerPrepare(httpd_worker_t *w)
+{
+    VLC_UNUSED(w);
+}
+
+static unsigned httpd_WorkerPoll(httpd_worker_t *w, int timeout)
+{
+    struct epoll_event ev[HTTPD_WORKER_EVENTS];
+    int n;
+
+    while ((n = epoll_wait(w->epfd, ev, HTTPD_WORKER_EVENTS, timeout)) < 0)
+        if (errno != EINTR)
+            msg_Err(w->host, "polling error: %s", vlc_strerror_c(errno));
+
+    for (int i = 0; i < n; i++)
+        w->ready[i] = ev[i].data.ptr;
+    return n;
+}
+#else
+static void httpd_WorkerPrepare(httpd_worker_t *w)
+{
+    unsigned n = 1;
+
+    if (w->i_alloc < (unsigned)w->i_client + 1) {
+        w->i_alloc = w->i_client + 1;
+        w->ufd = xrealloc(w->ufd, w->i_alloc * sizeof (*w->ufd));
+        w->ready = xrealloc(w->ready, w->i_alloc * sizeof (*w->ready));
+    }
+
+    w->ufd[0].fd = w->wakefd[0];
+    w->ufd[0].events = POLLIN;
+    w->ready[0] = NULL;
+
+    for (int i = 0; i < w->i_client; i++) {
+        httpd_client_t *cl = w->client[i];
+
+        if (cl->i_events == 0)
+            continue;
+        w->ufd[n].fd = vlc_tls_GetFD(cl->sock);
+        w->ufd[n].events = cl->i_events;
+        w->ready[n] = cl;
+        n++;
+    }
+    w->i_ufd = n;
+}
+
+static unsigned httpd_WorkerPoll(httpd_worker_t *w, int timeout)
+{
+    unsigned n = 0;
+
+    while (poll(w->ufd, w->i_ufd, timeout) < 0)
+        if (errno != EINTR)
+            msg_Err(w->host, "polling error: %s", vlc_strerror_c(errno));
+
+    for (unsigned i = 0; i < w->i_ufd; i++)
+        if (w->ufd[i].revents != 0)
+            w->ready[n++] = w->ready[i];
+    return n;
+}
+#endif
+
+static void httpd_WorkerLoop(httpd_worker_t *w)
+{
+    httpd_host_t *host = w->host;
+    mtime_t now = mdate();
+    mtime_t deadline = INT64_MAX;
+    bool b_locked = false;
+
+    int canc = vlc_savecancel();
+    vlc_mutex_lock(&w->lock);
+
+    /* Clients waiting for stream data are only polled again once a stream
+     * got some: the streams flag the workers of their waiting clients. */
+    bool b_data = atomic_exchange(&w->b_data, false);
+
+    for (int i_client = 0; i_client < w->i_client; i_client++) {
+        httpd_client_t *cl = w->client[i_client];
+        uint8_t i_state = cl->i_state;
+
+        if (cl->i_ref == 0 && cl->i_activity_timeout > 0
+         && cl->i_activity_date + cl->i_activity_timeout < now)
+            cl->i_state = HTTPD_CLIENT_DEAD;
+        else if (i_state == HTTPD_CLIENT_RECEIVE_DONE
+              || i_state == HTTPD_CLIENT_SEND_DONE
+              || (i_state == HTTPD_CLIENT_WAITING && b_data)) {
+            /* URL callbacks are serialized by the host lock */
+            if (!b_locked) {
+                vlc_mutex_lock(&host->lock);
+                b_locked = true;
+            }
+            httpd_ClientProcess(host, cl);
         }
 
-        if (pufd->events != 0)
-            nfd++;
-        else
-            b_low_delay = true;
+        if (cl->i_ref < 0 || (cl->i_ref == 0
+                           && cl->i_state == HTTPD_CLIENT_DEAD)) {
+            httpd_WorkerRemove(w, cl);
+            i_client--;
+            continue;
+        }
+
+        httpd_WorkerWatch(w, cl, httpd_ClientEvents(cl),
+                          cl->i_state != i_state);
+        if (cl->i_activity_timeout > 0)
+            deadline = __MIN(deadline,
+                             cl->i_activity_date + cl->i_activity_timeout);
     }
-    vlc_mutex_unlock(&host->lock);
+    if (b_locked)
+        vlc_mutex_unlock(&host->lock);
+
+    httpd_WorkerPrepare(w);
+    vlc_mutex_unlock(&w->lock);
     vlc_restorecancel(canc);
 
-    /* we will wait 20ms (not too big) if HTTPD_CLIENT_WAITING */
-    while (poll(ufd, nfd, b_low_delay ? 20 : -1) < 0)
-    {
-        if (errno != EINTR)
-            msg_Err(host, "polling error: %s", vlc_strerror_c(errno));
+    int timeout = -1;
+    if (deadline != INT64_MAX) {
+        /* A past deadline polls without waiting */
+        mtime_t delay = deadline - now;
+        timeout = delay > 0 ? __MIN(delay / 1000 + 1, INT_MAX) : 0;
     }
 
+    unsigned n = httpd_WorkerPoll(w, timeout);
+
     canc = vlc_savecancel();
-    vlc_mutex_lock(&host->lock);
+    vlc_mutex_lock(&w->lock);
 
     /* Handle client sockets */
     now = mdate();
-    nfd = host->nfd;
-
-    for (int i_client = 0; i_client < host->i_client; i_client++) {
-        httpd_client_t *cl = host->client[i_client];
-        const struct pollfd *pufd = &ufd[nfd];
 
-        assert(pufd < &ufd[sizeof(ufd) / sizeof(ufd[0])]);
+    for (unsigned i = 0; i < n; i++) {
+        httpd_client_t *cl = w->ready[i];
 
-        if (vlc_tls_GetFD(cl->sock) != pufd->fd)
-            continue; // we were not waiting for this client
-        ++nfd;
-        if (pufd->revents == 0)
-            continue; // no event received
+        if (cl == NULL) {
+            httpd_WorkerDrain(w);
+            continue;
+        }
 
         cl->i_activity_date = now;
 
         switch (cl->i_state) {
             case HTTPD_CLIENT_RECEIVING: httpd_ClientRecv(cl); break;
-            case HTTPD_CLIENT_SENDING:   httpd_ClientSend(cl); break;
+            case HTTPD_CLIENT_SENDING:
+                /* edge-triggered: write until the socket would block */
+                while (cl->i_state == HTTPD_CLIENT_SENDING
+                    && httpd_ClientSend(cl));
+                break;
             case HTTPD_CLIENT_TLS_HS_IN:
             case HTTPD_CLIENT_TLS_HS_OUT:
                 httpd_ClientTlsHandshake(host, cl);
@@ -1999,64 +2486,124 @@ static void httpdLoop(httpd_host_t *host)
         }
     }
 
-    /* Handle server sockets (accept new connections) */
-    for (nfd = 0; nfd < host->nfd; nfd++) {
-        httpd_client_t *cl;
-        int fd = ufd[nfd].fd;
+    vlc_mutex_unlock(&w->lock);
+    vlc_restorecancel(canc);
+}
 
-        assert (fd == host->fds[nfd]);
+static void *httpd_WorkerThread(void *data)
+{
+    httpd_worker_t *w = data;
 
-        if (ufd[nfd].revents == 0)
-            continue;
+    for (;;)
+        httpd_WorkerLoop(w);
+    vlc_assert_unreachable();
+}
 
-        /* */
-        fd = vlc_accept (fd, NULL, NULL, true);
-        if (fd == -1)
-            continue;
-        setsockopt (fd, SOL_SOCKET, SO_REUSEADDR,
-                &(int){ 1 }, sizeof(int));
+/* Hands a new client over to the least loaded worker */
+static void httpd_HostAddClient(httpd_host_t *host, httpd_client_t *cl)
+{
+    httpd_worker_t *best = NULL;
+    int i_best = INT_MAX;
 
-        vlc_tls_t *sk = vlc_tls_SocketOpen(fd);
-        if (unlikely(sk == NULL))
-        {
-            vlc_close(fd);
-            continue;
+    for (unsigned i = 0; i < host->i_worker; i++) {
+        httpd_worker_t *w = &host->worker[i];
+
+        vlc_mutex_lock(&w->lock);
+        if (w->i_client < i_best) {
+            best = w;
+            i_best = w->i_client;
         }
+        vlc_mutex_unlock(&w->lock);
+    }
 
-        if (host->p_tls != NULL)
+    vlc_mutex_lock(&best->lock);
+    cl->worker = best;
+    TAB_APPEND(best->i_client, best->client, cl);
+    vlc_mutex_unlock(&best->lock);
+    httpd_WorkerWake(best);
+}
+
+static void* httpd_HostThread(void *data)
+{
+    httpd_host_t *host = data;
+    struct pollfd ufd[host->nfd];
+
+    for (unsigned nfd = 0; nfd < host->nfd; nfd++) {
+        ufd[nfd].fd = host->fds[nfd];
+        ufd[nfd].events = POLLIN;
+        ufd[nfd].revents = 0;
+    }
+
+    for (;;) {
+        /* do not accept connections until an url is registered */
+        vlc_mutex_lock(&host->lock);
+        mutex_cleanup_push(&host->lock);
+        while (host->i_url <= 0)
+            vlc_cond_wait(&host->wait, &host->lock);
+        vlc_cleanup_pop();
+        vlc_mutex_unlock(&host->lock);
+
+        while (poll(ufd, host->nfd, -1) < 0)
         {
-            const char *alpn[] = { "http/1.1", NULL };
-            vlc_tls_t *tls;
+            if (errno != EINTR)
+                msg_Err(host, "polling error: %s", vlc_strerror_c(errno));
+        }
+
+        int canc = vlc_savecancel();
+        mtime_t now = mdate();
+
+        /* Handle server sockets (accept new connections) */
+        for (unsigned nfd = 0; nfd < host->nfd; nfd++) {
+            httpd_client_t *cl;
+            int fd = ufd[nfd].fd;
+
+            if (ufd[nfd].revents == 0)
+                continue;
 
-            tls = vlc_tls_ServerSessionCreate(host->p_tls, sk, alpn);
-            if (tls == NULL)
+            /* */
+            fd = vlc_accept (fd, NULL, NULL, true);
+            if (fd == -1)
+                continue;
+            setsockopt (fd, SOL_SOCKET, SO_REUSEADDR,
+                    &(int){ 1 }, sizeof(int));
+
+            vlc_tls_t *sk = vlc_tls_SocketOpen(fd);
+            if (unlikely(sk == NULL))
             {
-                vlc_tls_SessionDelete(sk);
+                vlc_close(fd);
                 continue;
             }
-            sk = tls;
-        }
 
-        cl = httpd_ClientNew(sk, now);
+            if (host->p_tls != NULL)
+            {
+                const char *alpn[] = { "http/1.1", NULL };
+                vlc_tls_t *tls;
+
+                tls = vlc_tls_ServerSessionCreate(host->p_tls, sk, alpn);
+                if (tls == NULL)
+                {
+                    vlc_tls_SessionDelete(sk);
+                    continue;
+                }
+                sk = tls;
+            }
 
-        if (host->p_tls != NULL)
-            cl->i_state = HTTPD_CLIENT_TLS_HS_OUT;
+            cl = httpd_ClientNew(sk, now);
+            if (cl == NULL)
+            {
+                vlc_tls_Close(sk);
+                continue;
+            }
 
-        TAB_APPEND(host->i_client, host->client, cl);
-    }
+            if (host->p_tls != NULL)
+                cl->i_state = HTTPD_CLIENT_TLS_HS_OUT;
 
-    vlc_restorecancel(canc);
-}
-
-static void* httpd_HostThread(void *data)
-{
-    httpd_host_t *host = data;
+            httpd_HostAddClient(host, cl);
+        }
 
-    vlc_mutex_lock(&host->lock);
-    while (host->i_ref > 0)
-        httpdLoop(host);
-    vlc_mutex_unlock(&host->lock);
-    return NULL;
+        vlc_restorecancel(canc);
+    }
+    vlc_assert_unreachable();
 }
 
 int httpd_StreamSetHTTPHeaders(httpd_stream_t * p_stream,
@@ -1,5 +1,5 @@
 /*****************************************************************************
- * timer.c: simple threaded timer
+ * timer.c: timer wheel serviced by a shared thread pool
  *****************************************************************************
  * Copyright (C) 2009-2012 Rémi Denis-Courmont
  *
@@ -22,13 +22,14 @@
 # include "config.h"
 #endif
 
-#include <stdnoreturn.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <errno.h>
 #include <assert.h>
 
 #include <vlc_common.h>
 #include <vlc_atomic.h>
+#include "libvlc.h"
 
 /*
  * POSIX timers are essentially unusable from a library: there provide no safe
@@ -36,74 +37,362 @@
  * they typically require one thread per timer plus one thread per iteration,
  * which is inefficient and overkill (unless you need multiple iteration
  * of the same timer concurrently).
- * Thus, this is a generic manual implementation of timers using a thread.
+ *
+ * Thus, this is a generic manual implementation of timers. All timers are
+ * queued in a single hierarchical timer wheel. One thread advances the wheel
+ * and hands the expired timers over to a small pool of threads which run the
+ * callbacks. The pool grows when all its threads are busy, and shrinks back
+ * once they have been idle for a while. All threads are stopped when the last
+ * timer is destroyed.
  */
 
+#define TIMER_TICK     (CLOCK_FREQ / 1000) /* wheel resolution */
+#define TIMER_BITS     6
+#define TIMER_SLOTS    (1 << TIMER_BITS)
+#define TIMER_LEVELS   4 /* up to 2^24 ticks (4.6 hours) ahead */
+#define TIMER_MAX_TICKS ((UINT64_C(1) << (TIMER_BITS * TIMER_LEVELS)) - 1)
+
+#define TIMER_MAX_THREADS 16
+#define TIMER_IDLE_TIMEOUT (CLOCK_FREQ * 5)
+
 struct vlc_timer
 {
-    vlc_thread_t thread;
-    vlc_cond_t   reschedule;
-    vlc_mutex_t  lock;
+    struct vlc_timer *prev, *next; /* wheel slot or due list */
+    struct vlc_timer **head;       /* list the timer is in, or NULL */
     void       (*func) (void *);
     void        *data;
     mtime_t      value, interval;
+    uint64_t     expires;          /* expiry in ticks */
+    bool         running;
+    bool         pending;          /* expired while running */
     atomic_uint  overruns;
 };
 
-noreturn static void *vlc_timer_thread (void *data)
+static struct
 {
-    struct vlc_timer *timer = data;
+    vlc_mutex_t lock;
+    vlc_cond_t  tick;    /* signals the wheel thread */
+    vlc_cond_t  due;     /* signals the pool threads */
+    vlc_cond_t  done;    /* signals the end of a callback or thread */
+    bool        init;    /* condition variables initialized */
+    bool        started; /* wheel thread running */
+    bool        stopping;
+    vlc_thread_t thread; /* wheel thread */
+    unsigned    timers;  /* number of existing timers */
 
-    vlc_mutex_lock (&timer->lock);
-    mutex_cleanup_push (&timer->lock);
+    uint64_t    now;     /* next tick to process */
+    uint64_t    wakeup;  /* tick the wheel thread sleeps until */
+    unsigned    count[TIMER_LEVELS];
+    struct vlc_timer *slots[TIMER_LEVELS][TIMER_SLOTS];
 
-    for (;;)
+    struct vlc_timer *due_first;
+    struct vlc_timer **due_last;
+    unsigned    threads;
+    unsigned    idle;
+} wheel = { .lock = VLC_STATIC_MUTEX };
+
+static void vlc_timer_link (struct vlc_timer **head, struct vlc_timer *timer)
+{
+    timer->prev = NULL;
+    timer->next = *head;
+    if (timer->next != NULL)
+        timer->next->prev = timer;
+    *head = timer;
+    timer->head = head;
+}
+
+static void vlc_timer_unlink (struct vlc_timer *timer)
+{
+    if (timer->prev != NULL)
+        timer->prev->next = timer->next;
+    else
+        *timer->head = timer->next;
+    if (timer->next != NULL)
+        timer->next->prev = timer->prev;
+    timer->head = NULL;
+}
+
+static unsigned vlc_timer_level (const struct vlc_timer *timer)
+{
+    return (timer->head - &wheel.slots[0][0]) / TIMER_SLOTS;
+}
+
+/** Queues an armed timer in the wheel */
+static void vlc_timer_insert (struct vlc_timer *timer)
+{
+    uint64_t expires = timer->expires;
+    unsigned level = 0;
+
+    if (expires < wheel.now)
+        expires = wheel.now;
+    if (expires - wheel.now > TIMER_MAX_TICKS)
+        expires = wheel.now + TIMER_MAX_TICKS; /* requeued on cascade */
+
+    while ((expires - wheel.now) >> (TIMER_BITS * (level + 1)))
+        level++;
+
+    unsigned slot = (expires >> (TIMER_BITS * level)) & (TIMER_SLOTS - 1);
+
+    vlc_timer_link (&wheel.slots[level][slot], timer);
+    wheel.count[level]++;
+
+    if (timer->expires < wheel.wakeup)
+        vlc_cond_signal (&wheel.tick);
+}
+
+static void vlc_timer_queue (struct vlc_timer *timer)
+{
+    timer->prev = (wheel.due_last != &wheel.due_first)
+        ? container_of(wheel.due_last, struct vlc_timer, next) : NULL;
+    timer->next = NULL;
+    timer->head = &wheel.due_first;
+    *wheel.due_last = timer;
+    wheel.due_last = &timer->next;
+}
+
+static void vlc_timer_dequeue (struct vlc_timer *timer)
+{
+    if (timer->head == NULL)
+        return;
+
+    if (timer->head == &wheel.due_first)
+    {   /* never ran */
+        if (wheel.due_last == &timer->next)
+            wheel.due_last = (timer->prev != NULL) ? &timer->prev->next
+                                                   : &wheel.due_first;
+    }
+    else
+        wheel.count[vlc_timer_level (timer)]--;
+    vlc_timer_unlink (timer);
+}
+
+static void vlc_timer_expire (struct vlc_timer *timer, mtime_t now)
+{
+    if (timer->interval != 0)
     {
-        while (timer->value == 0)
-        {
-            assert(timer->interval == 0);
-            vlc_cond_wait (&timer->reschedule, &timer->lock);
+        if (now > timer->value)
+        {   /* Update overrun counter */
+            unsigned misses = (now - timer->value) / timer->interval;
+
+            timer->value += misses * timer->interval;
+            assert(timer->value <= now);
+            atomic_fetch_add_explicit(&timer->overruns, misses,
+                                      memory_order_relaxed);
         }
+    }
+
+    if (!timer->running)
+        vlc_timer_queue (timer);
+    else if (timer->interval != 0) /* this iteration is missed */
+        atomic_fetch_add_explicit(&timer->overruns, 1, memory_order_relaxed);
+    else /* rescheduled by its own callback: run it again after */
+        timer->pending = true;
+
+    timer->value += timer->interval; /* rearm */
+    if (timer->interval == 0)
+        timer->value = 0; /* disarm */
+    else
+    {
+        timer->expires = (timer->value + TIMER_TICK - 1) / TIMER_TICK;
+        if (timer->head == NULL)
+            vlc_timer_insert (timer);
+    }
+}
+
+/** Moves the timers of a slot down the wheel */
+static void vlc_timer_cascade (unsigned level, unsigned slot)
+{
+    struct vlc_timer *timer = wheel.slots[level][slot];
+
+    wheel.slots[level][slot] = NULL;
+    while (timer != NULL)
+    {
+        struct vlc_timer *next = timer->next;
+
+        wheel.count[level]--;
+        timer->head = NULL;
+        vlc_timer_insert (timer);
+        timer = next;
+    }
+}
+
+static void vlc_timer_advance (mtime_t now)
+{
+    uint64_t tick = now / TIMER_TICK;
+    bool empty = true;
 
-        if (timer->interval != 0)
+    for (unsigned i = 0; i < TIMER_LEVELS; i++)
+        if (wheel.count[i] != 0)
+            empty = false;
+    if (empty)
+    {
+        wheel.now = tick + 1;
+        return;
+    }
+
+    while (wheel.now <= tick)
+    {
+        unsigned slot = wheel.now & (TIMER_SLOTS - 1);
+
+        if (slot == 0)
+            for (unsigned level = 1; level < TIMER_LEVELS; level++)
+            {
+                unsigned index = (wheel.now >> (TIMER_BITS * level))
+                               & (TIMER_SLOTS - 1);
+
+                vlc_timer_cascade (level, index);
+                if (index != 0)
+                    break;
+            }
+
+        struct vlc_timer *timer = wheel.slots[0][slot];
+
+        wheel.slots[0][slot] = NULL;
+        while (timer != NULL)
         {
-            mtime_t now = mdate();
+            struct vlc_timer *next = timer->next;
 
-            if (now > timer->value)
-            {   /* Update overrun counter */
-                unsigned misses = (now - timer->value) / timer->interval;
+            wheel.count[0]--;
+            timer->head = NULL;
+            vlc_timer_expire (timer, now);
+            timer = next;
+        }
+        wheel.now++;
+    }
+}
 
-                timer->value += misses * timer->interval;
-                assert(timer->value <= now);
-                atomic_fetch_add_explicit(&timer->overruns, misses,
-                                          memory_order_relaxed);
+/** Returns the next tick at which the wheel has work to do */
+static uint64_t vlc_timer_next (void)
+{
+    uint64_t next = UINT64_MAX;
+
+    if (wheel.count[0] != 0)
+        for (unsigned i = 0; i < TIMER_SLOTS; i++)
+            if (wheel.slots[0][(wheel.now + i) & (TIMER_SLOTS - 1)] != NULL)
+            {
+                next = wheel.now + i;
+                break;
             }
+
+    for (unsigned i = 1; i < TIMER_LEVELS; i++)
+        if (wheel.count[i] != 0)
+        {   /* next cascade, possibly the pending tick itself */
+            uint64_t cascade = (wheel.now + TIMER_SLOTS - 1)
+                             & ~(uint64_t)(TIMER_SLOTS - 1);
+            if (cascade < next)
+                next = cascade;
+            break;
         }
+    return next;
+}
 
-        mtime_t value = timer->value;
+static void *vlc_timer_pool_thread (void *data);
 
-        if (vlc_cond_timedwait(&timer->reschedule, &timer->lock, value) == 0)
-            continue;
+/** Gets a pool thread to run the due timers, if any */
+static void vlc_timer_kick (void)
+{
+    if (wheel.due_first == NULL)
+        return;
 
-        if (likely(timer->value <= value))
-        {
-            timer->value += timer->interval; /* rearm */
+    if (wheel.idle > 0)
+        vlc_cond_signal (&wheel.due);
+    else if (wheel.threads < TIMER_MAX_THREADS
+          && vlc_clone_detach (NULL, vlc_timer_pool_thread, NULL,
+                               VLC_THREAD_PRIORITY_INPUT) == 0)
+        wheel.threads++;
+}
+
+static void *vlc_timer_wheel_thread (void *data)
+{
+    (void) data;
+
+    vlc_mutex_lock (&wheel.lock);
+    while (!wheel.stopping)
+    {
+        vlc_timer_advance (mdate ());
+        vlc_timer_kick ();
+
+        wheel.wakeup = vlc_timer_next ();
+        if (wheel.wakeup == UINT64_MAX)
+            vlc_cond_wait (&wheel.tick, &wheel.lock);
+        else
+            vlc_cond_timedwait (&wheel.tick, &wheel.lock,
+                                wheel.wakeup * TIMER_TICK);
+        wheel.wakeup = 0; /* awake */
+    }
+    vlc_mutex_unlock (&wheel.lock);
+    return NULL;
+}
+
+static void *vlc_timer_pool_thread (void *data)
+{
+    (void) data;
+
+    vlc_mutex_lock (&wheel.lock);
+    for (;;)
+    {
+        struct vlc_timer *timer = wheel.due_first;
 
-            if (timer->interval == 0)
-                timer->value = 0; /* disarm */
+        if (timer == NULL)
+        {
+            if (wheel.stopping)
+                break;
+            wheel.idle++;
+            int val = vlc_cond_timedwait (&wheel.due, &wheel.lock,
+                                          mdate () + TIMER_IDLE_TIMEOUT);
+            wheel.idle--;
+            if (val != 0 && wheel.due_first == NULL && wheel.threads > 1)
+                break;
+            continue;
         }
 
-        vlc_mutex_unlock (&timer->lock);
+        vlc_timer_dequeue (timer);
+        timer->running = true;
+        if (timer->value != 0) /* next iteration */
+            vlc_timer_insert (timer);
+
+        /* let another thread handle the next due timer */
+        vlc_timer_kick ();
+        vlc_mutex_unlock (&wheel.lock);
 
         int canc = vlc_savecancel ();
         timer->func (timer->data);
         vlc_restorecancel (canc);
 
-        vlc_mutex_lock (&timer->lock);
+        vlc_mutex_lock (&wheel.lock);
+        timer->running = false;
+        if (timer->pending)
+        {
+            timer->pending = false;
+            vlc_timer_queue (timer);
+        }
+        vlc_cond_broadcast (&wheel.done);
     }
+    wheel.threads--;
+    vlc_cond_broadcast (&wheel.done);
+    vlc_mutex_unlock (&wheel.lock);
+    return NULL;
+}
 
-    vlc_cleanup_pop ();
-    vlc_assert_unreachable ();
+/** Stops all threads, once the last timer is gone */
+static void vlc_timer_stop (void)
+{
+    assert (wheel.started && wheel.timers == 0);
+    assert (wheel.due_first == NULL);
+
+    wheel.stopping = true;
+    vlc_cond_signal (&wheel.tick);
+    vlc_cond_broadcast (&wheel.due);
+    while (wheel.threads > 0)
+        vlc_cond_wait (&wheel.done, &wheel.lock);
+
+    vlc_mutex_unlock (&wheel.lock);
+    vlc_join (wheel.thread, NULL);
+    vlc_mutex_lock (&wheel.lock);
+
+    wheel.started = false;
+    wheel.stopping = false;
+    vlc_cond_broadcast (&wheel.done);
 }
 
 int vlc_timer_create (vlc_timer_t *id, void (*func) (void *), void *data)
@@ -112,23 +401,45 @@ int vlc_timer_create (vlc_timer_t *id, void (*func) (void *), void *data)
 
     if (unlikely(timer == NULL))
         return ENOMEM;
-    vlc_mutex_init (&timer->lock);
-    vlc_cond_init (&timer->reschedule);
     assert (func);
+    timer->prev = timer->next = NULL;
+    timer->head = NULL;
     timer->func = func;
     timer->data = data;
     timer->value = 0;
     timer->interval = 0;
+    timer->expires = 0;
+    timer->running = false;
+    timer->pending = false;
     atomic_init(&timer->overruns, 0);
 
-    if (vlc_clone (&timer->thread, vlc_timer_thread, timer,
-                   VLC_THREAD_PRIORITY_INPUT))
+    vlc_mutex_lock (&wheel.lock);
+    if (!wheel.init)
     {
-        vlc_cond_destroy (&timer->reschedule);
-        vlc_mutex_destroy (&timer->lock);
-        free (timer);
-        return ENOMEM;
+        vlc_cond_init (&wheel.tick);
+        vlc_cond_init (&wheel.due);
+        vlc_cond_init (&wheel.done);
+        wheel.due_last = &wheel.due_first;
+        wheel.init = true;
+    }
+    while (wheel.stopping) /* the last timer was just destroyed */
+        vlc_cond_wait (&wheel.done, &wheel.lock);
+    if (!wheel.started)
+    {
+        wheel.now = mdate () / TIMER_TICK;
+        wheel.wakeup = UINT64_MAX;
+
+        if (vlc_clone (&wheel.thread, vlc_timer_wheel_thread, NULL,
+                       VLC_THREAD_PRIORITY_INPUT))
+        {
+            vlc_mutex_unlock (&wheel.lock);
+            free (timer);
+            return ENOMEM;
+        }
+        wheel.started = true;
     }
+    wheel.timers++;
+    vlc_mutex_unlock (&wheel.lock);
 
     *id = timer;
     return 0;
@@ -136,10 +447,15 @@ int vlc_timer_create (vlc_timer_t *id, void (*func) (void *), void *data)
 
 void vlc_timer_destroy (vlc_timer_t timer)
 {
-    vlc_cancel (timer->thread);
-    vlc_join (timer->thread, NULL);
-    vlc_cond_destroy (&timer->reschedule);
-    vlc_mutex_destroy (&timer->lock);
+    vlc_mutex_lock (&wheel.lock);
+    vlc_timer_dequeue (timer);
+    while (timer->running)
+        vlc_cond_wait (&wheel.done, &wheel.lock);
+    /* the last callback may have rescheduled the timer */
+    vlc_timer_dequeue (timer);
+    if (--wheel.timers == 0)
+        vlc_timer_stop ();
+    vlc_mutex_unlock (&wheel.lock);
     free (timer);
 }
 
@@ -152,11 +468,17 @@ void vlc_timer_schedule (vlc_timer_t timer, bool absolute,
     if (!absolute)
         value += mdate();
 
-    vlc_mutex_lock (&timer->lock);
+    vlc_mutex_lock (&wheel.lock);
+    vlc_timer_dequeue (timer);
+    timer->pending = false;
     timer->value = value;
     timer->interval = interval;
-    vlc_cond_signal (&timer->reschedule);
-    vlc_mutex_unlock (&timer->lock);
+    if (value != 0)
+    {
+        timer->expires = (value + TIMER_TICK - 1) / TIMER_TICK;
+        vlc_timer_insert (timer);
+    }
+    vlc_mutex_unlock (&wheel.lock);
 }
 
 unsigned vlc_timer_getoverrun (vlc_timer_t timer)
@@ -38,6 +38,119 @@ struct timer_data
     unsigned count;
 };
 
+#define STRESS_TIMERS 10000
+
+struct stress_data
+{
+    vlc_timer_t timer;
+    mtime_t deadline;
+    mtime_t fired;
+    vlc_mutex_t *lock;
+    vlc_cond_t *wait;
+    unsigned *count;
+};
+
+static void stress_callback (void *ptr)
+{
+    struct stress_data *data = ptr;
+
+    data->fired = mdate ();
+    vlc_mutex_lock (data->lock);
+    *(data->count) += 1;
+    vlc_cond_signal (data->wait);
+    vlc_mutex_unlock (data->lock);
+}
+
+static void test_stress (void)
+{
+    struct stress_data *timers = malloc (STRESS_TIMERS * sizeof (*timers));
+    vlc_mutex_t lock;
+    vlc_cond_t wait;
+    unsigned count = 0;
+    mtime_t ts = mdate ();
+
+    assert (timers != NULL);
+    vlc_mutex_init (&lock);
+    vlc_cond_init (&wait);
+
+    for (unsigned i = 0; i < STRESS_TIMERS; i++)
+    {
+        struct stress_data *data = &timers[i];
+
+        data->lock = &lock;
+        data->wait = &wait;
+        data->count = &count;
+        data->fired = 0;
+        assert (vlc_timer_create (&data->timer, stress_callback, data) == 0);
+    }
+    printf ("%u timers created in %"PRId64" us\n", STRESS_TIMERS,
+            mdate () - ts);
+
+    /* Half fire within 200 ms, a quarter is rescheduled from far ahead,
+     * a quarter never fires before being destroyed */
+    ts = mdate ();
+    for (unsigned i = 0; i < STRESS_TIMERS; i++)
+    {
+        struct stress_data *data = &timers[i];
+
+        data->deadline = ts + (rand () % (CLOCK_FREQ / 5)) + 1;
+        if (i % 4 >= 2)
+            data->deadline += CLOCK_FREQ << 20;
+        vlc_timer_schedule (data->timer, true, data->deadline, 0);
+    }
+    for (unsigned i = 2; i < STRESS_TIMERS; i += 4)
+    {
+        struct stress_data *data = &timers[i];
+
+        data->deadline = ts + (rand () % (CLOCK_FREQ / 5)) + 1;
+        vlc_timer_schedule (data->timer, true, data->deadline, 0);
+    }
+
+    vlc_mutex_lock (&lock);
+    while (count < STRESS_TIMERS * 3 / 4)
+        vlc_cond_wait (&wait, &lock);
+    vlc_mutex_unlock (&lock);
+    printf ("%u timers fired in %"PRId64" us\n", count, mdate () - ts);
+
+    mtime_t late = 0;
+    for (unsigned i = 0; i < STRESS_TIMERS; i++)
+    {
+        struct stress_data *data = &timers[i];
+
+        if (i % 4 == 3)
+        {
+            assert (data->fired == 0);
+            continue;
+        }
+        assert (data->fired >= data->deadline);
+        if (data->fired - data->deadline > late)
+            late = data->fired - data->deadline;
+    }
+    printf ("worst lateness: %"PRId64" us\n", late);
+
+    ts = mdate ();
+    for (unsigned i = 0; i < STRESS_TIMERS; i++)
+        vlc_timer_destroy (timers[i].timer);
+    printf ("%u timers destroyed in %"PRId64" us\n", STRESS_TIMERS,
+            mdate () - ts);
+    assert (count == STRESS_TIMERS * 3 / 4);
+
+    vlc_cond_destroy (&wait);
+    vlc_mutex_destroy (&lock);
+    free (timers);
+}
+
+static void rearm_callback (void *ptr)
+{
+    struct timer_data *data = ptr;
+
+    vlc_mutex_lock (&data->lock);
+    if (++data->count < 10)
+        vlc_timer_schedule (data->timer, false, 1, 0);
+    vlc_cond_signal (&data->wait);
+    vlc_mutex_unlock (&data->lock);
+}
+
 static void callback (void *ptr)
 {
     struct timer_data *data = ptr;
@@ -105,8 +218,24 @@ int main (void)
     assert(ts >= (CLOCK_FREQ / 5));
 
     vlc_timer_destroy (data.timer);
+
+    /* One-shot timer rescheduled from its own callback */
+    data.count = 0;
+    val = vlc_timer_create (&data.timer, rearm_callback, &data);
+    assert (val == 0);
+    vlc_timer_schedule (data.timer, false, 1, 0);
+
+    vlc_mutex_lock (&data.lock);
+    while (data.count < 10)
+        vlc_cond_wait(&data.wait, &data.lock);
+    vlc_mutex_unlock (&data.lock);
+
+    vlc_timer_destroy (data.timer);
+    assert (data.count == 10);
     vlc_cond_destroy (&data.wait);
     vlc_mutex_destroy (&data.lock);
 
+    test_stress ();
+
     return 0;
 }
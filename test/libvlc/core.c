@@ -24,6 +24,7 @@
 #include "test.h"
 
 #include <string.h>
+#include <inttypes.h>
 
 static void test_core (const char ** argv, int argc)
 {
@@ -97,6 +98,46 @@ static void test_audio_output (void)
     libvlc_release (vlc);
 }
 
+static int64_t test_startup_time (const char *cache_opt)
+{
+    const char *argv[] = { "--vout=vdummy", cache_opt };
+    int64_t start = libvlc_clock ();
+
+    libvlc_instance_t *vlc = libvlc_new (2, argv);
+    assert (vlc != NULL);
+
+    int64_t elapsed = libvlc_clock () - start;
+
+    libvlc_release (vlc);
+    return elapsed;
+}
+
+#define STARTUP_RUNS 5
+
+static void test_startup (void)
+{
+    log ("Testing startup time\n");
+
+    /* Cold: every plug-in is loaded and described. */
+    int64_t cold = test_startup_time ("--no-plugins-cache");
+
+    /* Warm: the plug-ins are described by the plugins cache. */
+    int64_t warm = INT64_MAX, total = 0;
+
+    for (unsigned i = 0; i < STARTUP_RUNS; i++)
+    {
+        int64_t elapsed = test_startup_time ("--plugins-cache");
+
+        if (elapsed < warm)
+            warm = elapsed;
+        total += elapsed;
+    }
+
+    log ("libvlc_new(): cold %"PRId64" us, warm %"PRId64" us "
+         "(best of %d, average %"PRId64" us)\n", cold, warm, STARTUP_RUNS,
+         total / STARTUP_RUNS);
+}
+
 int main (void)
 {
     test_init();
@@ -104,6 +145,7 @@ int main (void)
     test_core (test_defaults_args, test_defaults_nargs);
     test_audiovideofilterlists (test_defaults_args, test_defaults_nargs);
     test_audio_output ();
+    test_startup ();
 
     return 0;
 }
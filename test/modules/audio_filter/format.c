@@ -0,0 +1,355 @@
+/*****************************************************************************
+ * format.c: PCM format converter test and benchmark
+ *****************************************************************************
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc/vlc.h>
+
+#include "../../../lib/libvlc_internal.h"
+
+#include <vlc_common.h>
+#include <vlc_modules.h>
+#include <vlc_filter.h>
+#include <vlc_block.h>
+#include <vlc_aout.h>
+
+#undef NDEBUG
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_SAMPLES (2 * 48000)
+#define MIN_DURATION  (CLOCK_FREQ / 10)
+
+static const vlc_fourcc_t formats[] = {
+    VLC_CODEC_U8, VLC_CODEC_S16N, VLC_CODEC_S32N, VLC_CODEC_FL32,
+    VLC_CODEC_FL64,
+};
+
+/* Odd on purpose, to exercise the scalar tails of the SIMD code */
+static const size_t counts[] = { 1, 3, 7, 8, 15, 16, 17, 31, 33, 1001, 4803 };
+
+/* Rounding ties, thresholds and out of range values */
+static const double specials[] = {
+    0., 1., -1., 2., -2., 1e10, -1e10,
+    0.5 / 32768, 1.5 / 32768, -0.5 / 32768, 32767.5 / 32768, -32768.5 / 32768,
+    0.5 / 128, 126.5 / 128, 127.5 / 128, -128.5 / 128,
+};
+
+static uint32_t seed = 1;
+
+static uint32_t rand32(void)
+{
+    uint32_t v;
+
+    seed = seed * 1103515245 + 12345;
+    v = seed >> 16;
+    seed = seed * 1103515245 + 12345;
+    return (v << 16) | (seed >> 16);
+}
+
+static bool is_float(vlc_fourcc_t fmt)
+{
+    return fmt == VLC_CODEC_FL32 || fmt == VLC_CODEC_FL64;
+}
+
+static void fill(vlc_fourcc_t fmt, void *buf, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        uint32_t r = rand32();
+        double v = (i % 5) ? ((int32_t)r / 1717986918.) /* -1.25 to 1.25 */
+                           : specials[(i / 5) % ARRAY_SIZE(specials)];
+
+        switch (fmt)
+        {
+            case VLC_CODEC_U8:   ((uint8_t *)buf)[i] = r;  break;
+            case VLC_CODEC_S16N: ((int16_t *)buf)[i] = r;  break;
+            case VLC_CODEC_S32N: ((int32_t *)buf)[i] = r;  break;
+            case VLC_CODEC_FL32: ((float *)buf)[i] = v;    break;
+            case VLC_CODEC_FL64: ((double *)buf)[i] = v;   break;
+        }
+    }
+}
+
+/* Integer sample, scaled to 32 bits */
+static int32_t get_int(vlc_fourcc_t fmt, const void *buf, size_t i)
+{
+    switch (fmt)
+    {
+        case VLC_CODEC_U8:
+            return (int32_t)(((uint32_t)((const uint8_t *)buf)[i] << 24)
+                             ^ 0x80000000u);
+        case VLC_CODEC_S16N:
+            return ((const int16_t *)buf)[i] * 65536;
+        default:
+            return ((const int32_t *)buf)[i];
+    }
+}
+
+static double get_float(vlc_fourcc_t fmt, const void *buf, size_t i)
+{
+    switch (fmt)
+    {
+        case VLC_CODEC_FL32: return ((const float *)buf)[i];
+        case VLC_CODEC_FL64: return ((const double *)buf)[i];
+        default:             return get_int(fmt, buf, i) / 2147483648.;
+    }
+}
+
+/* Rounds to nearest even, with saturation */
+static long quantize(double s, double max)
+{
+    if (s >= max)
+        return max;
+    if (s <= -max - 1.)
+        return -max - 1.;
+    return lrint(s);
+}
+
+/* Straightforward conversion: integers are truncated to fewer bits, floats
+ * are rounded and saturated */
+static void convert_ref(vlc_fourcc_t dst_fmt, void *dst,
+                        vlc_fourcc_t src_fmt, const void *src, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        if (!is_float(src_fmt) && !is_float(dst_fmt))
+        {
+            int32_t v = get_int(src_fmt, src, i);
+
+            switch (dst_fmt)
+            {
+                case VLC_CODEC_U8:   ((uint8_t *)dst)[i] = (v >> 24) + 128; break;
+                case VLC_CODEC_S16N: ((int16_t *)dst)[i] = v >> 16;         break;
+                case VLC_CODEC_S32N: ((int32_t *)dst)[i] = v;               break;
+            }
+            continue;
+        }
+
+        double v = get_float(src_fmt, src, i);
+
+        switch (dst_fmt)
+        {
+            case VLC_CODEC_U8:
+                ((uint8_t *)dst)[i] = quantize(v * 128., 127.) + 128;
+                break;
+            case VLC_CODEC_S16N:
+                ((int16_t *)dst)[i] = quantize(v * 32768., 32767.);
+                break;
+            case VLC_CODEC_S32N:
+                ((int32_t *)dst)[i] = quantize(v * 2147483648., 2147483647.);
+                break;
+            case VLC_CODEC_FL32:
+                ((float *)dst)[i] = v;
+                break;
+            case VLC_CODEC_FL64:
+                ((double *)dst)[i] = v;
+                break;
+        }
+    }
+}
+
+static filter_t *make_converter(vlc_object_t *obj, vlc_fourcc_t src,
+                                vlc_fourcc_t dst, bool dither)
+{
+    filter_t *filter = vlc_object_create(obj, sizeof (*filter));
+    assert(filter != NULL);
+
+    audio_sample_format_t fmt = {
+        .i_rate = 48000,
+        .i_physical_channels = AOUT_CHANS_STEREO,
+        .i_chan_mode = 0,
+    };
+
+    es_format_Init(&filter->fmt_in, AUDIO_ES, src);
+    fmt.i_format = src;
+    aout_FormatPrepare(&fmt);
+    filter->fmt_in.audio = fmt;
+
+    es_format_Init(&filter->fmt_out, AUDIO_ES, dst);
+    fmt.i_format = dst;
+    aout_FormatPrepare(&fmt);
+    filter->fmt_out.audio = fmt;
+
+    var_Create(filter, "audio-format-dither", VLC_VAR_INTEGER);
+    var_SetInteger(filter, "audio-format-dither", dither);
+
+    filter->p_module = module_need(filter, "audio converter", "audio_format",
+                                   true);
+    assert(filter->p_module != NULL);
+    return filter;
+}
+
+static void delete_converter(filter_t *filter)
+{
+    module_unneed(filter, filter->p_module);
+    es_format_Clean(&filter->fmt_in);
+    es_format_Clean(&filter->fmt_out);
+    vlc_object_release(filter);
+}
+
+/* Converts n samples, from a block with or without spare room */
+static block_t *convert(filter_t *filter, const void *src, size_t n,
+                        bool room)
+{
+    const size_t size = n * aout_BitsPerSample(filter->fmt_in.i_codec) / 8;
+    const size_t out = n * aout_BitsPerSample(filter->fmt_out.i_codec) / 8;
+
+    block_t *block = block_Alloc(room ? __MAX(size, out) : size);
+    assert(block != NULL);
+    memcpy(block->p_buffer, src, size);
+    block->i_buffer = size;
+    block->i_nb_samples = n / 2;
+
+    block_t *in = block;
+    uint8_t *p_in = block->p_buffer;
+
+    block = filter->pf_audio_filter(filter, block);
+    assert(block != NULL);
+    assert(block->i_buffer == out);
+    assert(block->i_nb_samples == n / 2);
+
+    /* Conversions happen in place whenever the samples fit */
+    if (room || out <= size)
+        assert(block == in && block->p_buffer == p_in);
+    return block;
+}
+
+static void test_pair(vlc_object_t *obj, vlc_fourcc_t src, vlc_fourcc_t dst)
+{
+    filter_t *filter = make_converter(obj, src, dst, false);
+
+    for (size_t i = 0; i < ARRAY_SIZE(counts); i++)
+    {
+        const size_t n = counts[i];
+        void *in = malloc(n * 8), *ref = malloc(n * 8);
+        assert(in != NULL && ref != NULL);
+
+        fill(src, in, n);
+        convert_ref(dst, ref, src, in, n);
+
+        for (int room = 0; room < 2; room++)
+        {
+            block_t *block = convert(filter, in, n, room);
+            assert(!memcmp(block->p_buffer, ref, block->i_buffer));
+            block_Release(block);
+        }
+        free(ref);
+        free(in);
+    }
+
+    /* Throughput, on one second of stereo samples */
+    void *in = malloc(BENCH_SAMPLES * 8);
+    assert(in != NULL);
+    fill(src, in, BENCH_SAMPLES);
+
+    unsigned loops = 0;
+    mtime_t time = 0;
+    do
+    {
+        const size_t size = BENCH_SAMPLES * aout_BitsPerSample(src) / 8;
+        block_t *block = block_Alloc(size);
+        assert(block != NULL);
+        memcpy(block->p_buffer, in, size);
+
+        mtime_t start = mdate();
+        block = filter->pf_audio_filter(filter, block);
+        time += mdate() - start;
+
+        assert(block != NULL);
+        block_Release(block);
+        loops++;
+    }
+    while (time < MIN_DURATION);
+
+    printf("%4.4s -> %4.4s: %7.1f Msamples/s\n", (const char *)&src,
+           (const char *)&dst, (double)BENCH_SAMPLES * loops / time);
+
+    free(in);
+    delete_converter(filter);
+}
+
+/* A constant signal of a quarter of a step must come out as a mix of zeros
+ * and ones, averaging to a quarter */
+static void test_dither(vlc_object_t *obj, vlc_fourcc_t src, vlc_fourcc_t dst)
+{
+    const size_t n = 65536 + 5;
+    const double step = dst == VLC_CODEC_U8 ? 1. / 128 : 1. / 32768;
+    double *in = malloc(n * sizeof (*in));
+    float *in32 = malloc(n * sizeof (*in32));
+    assert(in != NULL && in32 != NULL);
+
+    for (size_t i = 0; i < n; i++)
+        in[i] = in32[i] = step / 4;
+
+    filter_t *filter = make_converter(obj, src, dst, true);
+    block_t *block = convert(filter, src == VLC_CODEC_FL32 ? (void *)in32
+                                                          : (void *)in,
+                             n, false);
+    double sum = 0.;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        int v = dst == VLC_CODEC_U8 ? block->p_buffer[i] - 128
+                                    : ((int16_t *)block->p_buffer)[i];
+        assert(v >= -1 && v <= 1);
+        sum += v;
+    }
+    assert(fabs(sum / n - .25) < .02);
+
+    block_Release(block);
+    delete_converter(filter);
+    free(in32);
+    free(in);
+}
+
+int main(void)
+{
+    setenv("VLC_PLUGIN_PATH", "../modules", 1);
+
+    libvlc_instance_t *vlc = libvlc_new(0, NULL);
+    assert(vlc != NULL);
+
+    if (!module_exists("audio_format"))
+    {
+        libvlc_release(vlc);
+        return 77;
+    }
+
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+
+    for (size_t i = 0; i < ARRAY_SIZE(formats); i++)
+        for (size_t j = 0; j < ARRAY_SIZE(formats); j++)
+            if (i != j)
+                test_pair(obj, formats[i], formats[j]);
+
+    test_dither(obj, VLC_CODEC_FL32, VLC_CODEC_U8);
+    test_dither(obj, VLC_CODEC_FL32, VLC_CODEC_S16N);
+    test_dither(obj, VLC_CODEC_FL64, VLC_CODEC_U8);
+    test_dither(obj, VLC_CODEC_FL64, VLC_CODEC_S16N);
+
+    libvlc_release(vlc);
+    return 0;
+}
@@ -0,0 +1,848 @@
+/*****************************************************************************
+ * adaptive.cpp: adaptive streaming segment downloader and adaptation logic test
+ *****************************************************************************
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc/vlc.h>
+
+#include "../../../lib/libvlc_internal.h"
+
+#include <vlc_common.h>
+#include <vlc_threads.h>
+#include <vlc_tls.h>
+
+#include "../modules/demux/adaptive/ID.cpp"
+#include "../modules/demux/adaptive/StreamFormat.cpp"
+#include "../modules/demux/adaptive/SegmentTracker.cpp"
+#include "../modules/demux/adaptive/tools/Helper.cpp"
+#include "../modules/demux/adaptive/tools/Conversions.cpp"
+#include "../modules/demux/adaptive/http/BytesRange.cpp"
+#include "../modules/demux/adaptive/http/ConnectionParams.cpp"
+#include "../modules/demux/adaptive/http/AuthStorage.cpp"
+#include "../modules/demux/adaptive/http/Sockets.cpp"
+#include "../modules/demux/adaptive/http/HTTPConnection.cpp"
+#include "../modules/demux/adaptive/http/HTTPConnectionManager.cpp"
+#include "../modules/demux/adaptive/http/Downloader.cpp"
+#include "../modules/demux/adaptive/http/Chunk.cpp"
+#include "../modules/demux/adaptive/playlist/AbstractPlaylist.cpp"
+#include "../modules/demux/adaptive/playlist/BaseAdaptationSet.cpp"
+#include "../modules/demux/adaptive/playlist/BasePeriod.cpp"
+#include "../modules/demux/adaptive/playlist/BaseRepresentation.cpp"
+#include "../modules/demux/adaptive/playlist/CommonAttributesElements.cpp"
+#include "../modules/demux/adaptive/playlist/Inheritables.cpp"
+#include "../modules/demux/adaptive/playlist/Segment.cpp"
+#include "../modules/demux/adaptive/playlist/SegmentBase.cpp"
+#include "../modules/demux/adaptive/playlist/SegmentChunk.cpp"
+#include "../modules/demux/adaptive/playlist/SegmentInfoCommon.cpp"
+#include "../modules/demux/adaptive/playlist/SegmentInformation.cpp"
+#include "../modules/demux/adaptive/playlist/SegmentList.cpp"
+#include "../modules/demux/adaptive/playlist/SegmentTemplate.cpp"
+#include "../modules/demux/adaptive/playlist/SegmentTimeline.cpp"
+#include "../modules/demux/adaptive/playlist/Url.cpp"
+#include "../modules/demux/adaptive/logic/AbstractAdaptationLogic.cpp"
+#include "../modules/demux/adaptive/logic/Representationselectors.cpp"
+#include "../modules/demux/adaptive/logic/ThroughputEstimator.cpp"
+#include "../modules/demux/adaptive/logic/LowLatencyAdaptationLogic.cpp"
+
+extern "C"
+{
+    #include "../modules/access/http/h2frame.h"
+    #include "../modules/access/http/hpack.h"
+}
+
+#undef NDEBUG
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+using namespace adaptive;
+using namespace adaptive::http;
+using namespace adaptive::logic;
+using namespace adaptive::playlist;
+
+#define LATENCY (CLOCK_FREQ / 10)
+
+/* Local HTTP/1.1 server, answering /seg/<id>/<size> after some latency,
+ * and recording the requests it got */
+static struct
+{
+    int fd;
+    unsigned port;
+    vlc_thread_t thread;
+    vlc_mutex_t lock;
+    std::vector<vlc_thread_t> connections;
+    std::vector<std::string> requests;
+    unsigned inflight;
+    unsigned maxinflight;
+} server;
+
+static uint8_t body_byte(unsigned id, size_t i)
+{
+    return id * 31 + i * 7;
+}
+
+static bool send_all(int fd, const void *buf, size_t len)
+{
+    const uint8_t *p = static_cast<const uint8_t *>(buf);
+
+    while (len > 0)
+    {
+        ssize_t val = send(fd, p, len, MSG_NOSIGNAL);
+        if (val <= 0)
+            return false;
+        p += val;
+        len -= val;
+    }
+    return true;
+}
+
+static void *connection_thread(void *data)
+{
+    const int fd = (intptr_t)data;
+    std::string buf;
+    char tmp[1024];
+
+    for (;;)
+    {
+        size_t end;
+        while ((end = buf.find("\r\n\r\n")) == std::string::npos)
+        {
+            ssize_t val = recv(fd, tmp, sizeof (tmp), 0);
+            if (val <= 0)
+                goto out;
+            buf.append(tmp, val);
+        }
+
+        std::string header = buf.substr(0, end);
+        buf.erase(0, end + 4);
+
+        unsigned id;
+        size_t size;
+        assert(sscanf(header.c_str(), "GET /seg/%u/%zu ", &id, &size) == 2);
+        const bool keepalive =
+            header.find("Connection: close") == std::string::npos;
+
+        vlc_mutex_lock(&server.lock);
+        std::ostringstream path;
+        path << id;
+        server.requests.push_back(path.str());
+        if (++server.inflight > server.maxinflight)
+            server.maxinflight = server.inflight;
+        vlc_mutex_unlock(&server.lock);
+
+        msleep(LATENCY);
+
+        std::ostringstream reply;
+        reply << "HTTP/1.1 200 OK\r\nContent-Length: " << size << "\r\n\r\n";
+        std::vector<uint8_t> data(size);
+        for (size_t i = 0; i < size; i++)
+            data[i] = body_byte(id, i);
+
+        bool ok = send_all(fd, reply.str().data(), reply.str().length())
+               && send_all(fd, data.data(), size);
+
+        vlc_mutex_lock(&server.lock);
+        server.inflight--;
+        vlc_mutex_unlock(&server.lock);
+
+        if (!ok || !keepalive)
+            break;
+    }
+out:
+    close(fd);
+    return NULL;
+}
+
+static void *accept_thread(void *)
+{
+    for (;;)
+    {
+        int fd = accept(server.fd, NULL, NULL);
+        if (fd == -1)
+            break;
+
+        vlc_thread_t th;
+        vlc_mutex_lock(&server.lock);
+        if (vlc_clone(&th, connection_thread, (void *)(intptr_t)fd,
+                      VLC_THREAD_PRIORITY_LOW) == 0)
+            server.connections.push_back(th);
+        else
+            close(fd);
+        vlc_mutex_unlock(&server.lock);
+    }
+    return NULL;
+}
+
+static bool server_start(void)
+{
+    struct sockaddr_in addr;
+    socklen_t addrlen = sizeof (addr);
+
+    memset(&addr, 0, sizeof (addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    server.fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (server.fd == -1)
+        return false;
+    if (bind(server.fd, (struct sockaddr *)&addr, sizeof (addr))
+     || listen(server.fd, 16)
+     || getsockname(server.fd, (struct sockaddr *)&addr, &addrlen))
+    {
+        close(server.fd);
+        return false;
+    }
+    server.port = ntohs(addr.sin_port);
+    vlc_mutex_init(&server.lock);
+    server.inflight = server.maxinflight = 0;
+
+    if (vlc_clone(&server.thread, accept_thread, NULL,
+                  VLC_THREAD_PRIORITY_LOW))
+    {
+        vlc_mutex_destroy(&server.lock);
+        close(server.fd);
+        return false;
+    }
+    return true;
+}
+
+/* Must be called once the clients closed their connections */
+static void server_stop(void)
+{
+    shutdown(server.fd, SHUT_RDWR);
+    vlc_join(server.thread, NULL);
+    close(server.fd);
+
+    for (size_t i = 0; i < server.connections.size(); i++)
+        vlc_join(server.connections[i], NULL);
+    vlc_mutex_destroy(&server.lock);
+}
+
+static void server_reset(void)
+{
+    vlc_mutex_lock(&server.lock);
+    server.requests.clear();
+    server.maxinflight = 0;
+    vlc_mutex_unlock(&server.lock);
+}
+
+/* HTTP/2 server, reached through fake TLS connections negotiating "h2".
+ * It answers /seg/<id>/<size> right away. */
+static struct
+{
+    vlc_tls_t *tls;
+    vlc_thread_t thread;
+    unsigned connections;
+    unsigned requests;
+} h2server;
+
+static void h2_send(struct vlc_h2_frame *f)
+{
+    assert(f != NULL);
+
+    size_t len = vlc_h2_frame_size(f);
+    ssize_t val = vlc_tls_Write(h2server.tls, f->data, len);
+    assert((size_t)val == len);
+    free(f);
+}
+
+static void h2_reply(uint_fast32_t sid, const char *path)
+{
+    unsigned id;
+    size_t size;
+    assert(sscanf(path, "/seg/%u/%zu", &id, &size) == 2);
+    assert(size <= VLC_H2_DEFAULT_MAX_FRAME);
+
+    struct vlc_http_msg *m = vlc_http_resp_create(200);
+    assert(m != NULL);
+    vlc_http_msg_add_header(m, "Content-Length", "%zu", size);
+    h2_send(vlc_http_msg_h2_frame(m, sid, false));
+    vlc_http_msg_destroy(m);
+
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; i++)
+        data[i] = body_byte(id, i);
+    h2_send(vlc_h2_frame_data(sid, data.data(), size, true));
+}
+
+static void *h2_thread(void *)
+{
+    struct hpack_decoder *dec = hpack_decode_init(4096);
+    char hello[24];
+    uint8_t hdr[9];
+
+    assert(dec != NULL);
+    h2_send(vlc_h2_frame_settings());
+
+    if (vlc_tls_Read(h2server.tls, hello, 24, true) != 24)
+        goto out;
+
+    while (vlc_tls_Read(h2server.tls, hdr, 9, true) == 9)
+    {
+        size_t len = (hdr[0] << 16) | (hdr[1] << 8) | hdr[2];
+        uint_fast32_t sid = ((hdr[5] & 0x7f) << 24) | (hdr[6] << 16)
+                          | (hdr[7] << 8) | hdr[8];
+        std::vector<uint8_t> payload(len);
+
+        if (len > 0
+         && vlc_tls_Read(h2server.tls, payload.data(), len, true) != (ssize_t)len)
+            break;
+        if (hdr[3] != 0x1 /* HEADERS */)
+            continue;
+        /* Requests fit in one frame, without padding nor priority */
+        assert(hdr[4] & 0x4 /* END_HEADERS */);
+        assert(!(hdr[4] & 0x28));
+
+        char *headers[VLC_H2_MAX_HEADERS][2];
+        int count = hpack_decode(dec, payload.data(), len, headers,
+                                 VLC_H2_MAX_HEADERS);
+        assert(count > 0);
+
+        const char *path = NULL;
+        for (int i = 0; i < count; i++)
+            if (!strcmp(headers[i][0], ":path"))
+                path = headers[i][1];
+        assert(path != NULL);
+
+        vlc_mutex_lock(&server.lock);
+        h2server.requests++;
+        vlc_mutex_unlock(&server.lock);
+        h2_reply(sid, path);
+
+        for (int i = 0; i < count; i++)
+        {
+            free(headers[i][0]);
+            free(headers[i][1]);
+        }
+    }
+out:
+    hpack_decode_destroy(dec);
+    return NULL;
+}
+
+static vlc_tls_creds_t *const fake_creds =
+    reinterpret_cast<vlc_tls_creds_t *>(&h2server);
+
+vlc_tls_t *vlc_tls_SocketOpenTLS(vlc_tls_creds_t *creds, const char *name,
+                                 unsigned port, const char *service,
+                                 const char *const *alpn, char **alp)
+{
+    vlc_tls_t *tlsv[2];
+
+    assert(creds == fake_creds);
+    assert(!strcmp(name, "h2.example.com"));
+    assert(port == 443);
+    assert(!strcmp(service, "https"));
+    assert(alpn != NULL && !strcmp(alpn[0], "h2"));
+    assert(h2server.connections == 0);
+
+    if (vlc_tls_SocketPair(PF_LOCAL, 0, tlsv))
+        return NULL;
+
+    h2server.tls = tlsv[0];
+    h2server.connections++;
+    if (vlc_clone(&h2server.thread, h2_thread, NULL, VLC_THREAD_PRIORITY_LOW))
+        abort();
+
+    *alp = strdup("h2");
+    return tlsv[1];
+}
+
+vlc_tls_creds_t *vlc_tls_ClientCreate(vlc_object_t *)
+{
+    return fake_creds;
+}
+
+void vlc_tls_Delete(vlc_tls_creds_t *creds)
+{
+    assert(creds == fake_creds);
+}
+
+static AuthStorage *storage;
+
+static HTTPConnectionManager *make_manager(vlc_object_t *obj, int workers,
+                                           int perhost)
+{
+    var_SetInteger(obj, "adaptive-downloads", workers);
+    var_SetInteger(obj, "adaptive-host-connections", perhost);
+
+    return new HTTPConnectionManager(obj, storage);
+}
+
+static HTTPChunkBufferedSource *fetch(HTTPConnectionManager *mgr,
+                                      unsigned id, size_t size,
+                                      bool h2 = false)
+{
+    std::ostringstream url;
+    if (h2)
+        url << "https://h2.example.com";
+    else
+        url << "http://127.0.0.1:" << server.port;
+    url << "/seg/" << id << "/" << size;
+
+    HTTPChunkBufferedSource *src =
+        new HTTPChunkBufferedSource(url.str(), mgr, ID(id));
+    mgr->start(src);
+    return src;
+}
+
+/* Reads a whole source, and checks its content */
+static void check(HTTPChunkBufferedSource *src, unsigned id, size_t size)
+{
+    size_t offset = 0;
+    block_t *block;
+
+    while ((block = src->readBlock()) != NULL)
+    {
+        for (size_t i = 0; i < block->i_buffer; i++)
+            assert(block->p_buffer[i] == body_byte(id, offset + i));
+        offset += block->i_buffer;
+        block_Release(block);
+        if (offset == size)
+            break;
+    }
+    assert(offset == size);
+    delete src;
+}
+
+static mtime_t test_parallel(vlc_object_t *obj, int workers)
+{
+    HTTPConnectionManager *mgr = make_manager(obj, workers, workers);
+    HTTPChunkBufferedSource *srcs[4];
+
+    server_reset();
+    mtime_t start = mdate();
+    for (unsigned i = 0; i < 4; i++)
+        srcs[i] = fetch(mgr, i + 1, 100000);
+    for (unsigned i = 0; i < 4; i++)
+        check(srcs[i], i + 1, 100000);
+    mtime_t time = mdate() - start;
+
+    vlc_mutex_lock(&server.lock);
+    assert(server.requests.size() == 4);
+    assert(server.maxinflight == (unsigned)workers);
+    vlc_mutex_unlock(&server.lock);
+
+    printf("%d worker(s): 4 segments in %" PRId64 " ms\n", workers,
+           time / 1000);
+    delete mgr;
+    return time;
+}
+
+static void test_host_limit(vlc_object_t *obj)
+{
+    HTTPConnectionManager *mgr = make_manager(obj, 4, 2);
+    HTTPChunkBufferedSource *srcs[6];
+
+    server_reset();
+    for (unsigned i = 0; i < 6; i++)
+        srcs[i] = fetch(mgr, i + 1, (i == 0) ? 1 << 20 : 50000);
+    for (unsigned i = 0; i < 6; i++)
+        check(srcs[i], i + 1, (i == 0) ? 1 << 20 : 50000);
+
+    vlc_mutex_lock(&server.lock);
+    assert(server.requests.size() == 6);
+    assert(server.maxinflight == 2);
+    vlc_mutex_unlock(&server.lock);
+    delete mgr;
+}
+
+/* The least buffered stream gets served first */
+static void test_priority(vlc_object_t *obj)
+{
+    HTTPConnectionManager *mgr = make_manager(obj, 1, 1);
+
+    server_reset();
+    HTTPChunkBufferedSource *blocker = fetch(mgr, 1, 1000);
+    mgr->setBufferingLevel(ID(2), 10 * CLOCK_FREQ);
+    mgr->setBufferingLevel(ID(3), CLOCK_FREQ);
+    HTTPChunkBufferedSource *a = fetch(mgr, 2, 1000);
+    HTTPChunkBufferedSource *b = fetch(mgr, 3, 1000);
+
+    check(blocker, 1, 1000);
+    check(a, 2, 1000);
+    check(b, 3, 1000);
+
+    vlc_mutex_lock(&server.lock);
+    assert(server.requests.size() == 3);
+    assert(server.requests[0] == "1");
+    assert(server.requests[1] == "3");
+    assert(server.requests[2] == "2");
+    vlc_mutex_unlock(&server.lock);
+    delete mgr;
+}
+
+/* Concurrent requests share a single HTTP/2 connection */
+static void test_http2(vlc_object_t *obj)
+{
+    HTTPConnectionManager *mgr = make_manager(obj, 3, 3);
+    HTTPChunkBufferedSource *srcs[3];
+
+    for (unsigned i = 0; i < 3; i++)
+        srcs[i] = fetch(mgr, i + 1, 10000 + i, true);
+    for (unsigned i = 0; i < 3; i++)
+        check(srcs[i], i + 1, 10000 + i);
+    delete mgr;
+
+    /* Playlists go through other managers, but the same connection */
+    mgr = make_manager(obj, 1, 1);
+    HTTPChunk *chunk = new HTTPChunk("https://h2.example.com/seg/4/500",
+                                     mgr, ID());
+    block_t *block = chunk->read(1 << 21);
+    assert(block != NULL && block->i_buffer == 500);
+    for (size_t i = 0; i < 500; i++)
+        assert(block->p_buffer[i] == body_byte(4, i));
+    block_Release(block);
+    delete chunk;
+    delete mgr;
+
+    vlc_mutex_lock(&server.lock);
+    assert(h2server.connections == 1);
+    assert(h2server.requests == 4);
+    vlc_mutex_unlock(&server.lock);
+}
+
+/* Adaptation logic simulator: the segments of a playlist are requested
+ * through the SegmentTracker, transferred at the rate of network traces, and
+ * played back, all in simulated time */
+
+#define SIM_LATENCY (CLOCK_FREQ / 10)
+#define SIM_MAX_BUFFERING (30 * CLOCK_FREQ)
+/* Segments behind the live edge when joining a live stream */
+#define SIM_LIVE_DELAY 3
+
+static const uint64_t sim_bitrates[] = {
+    300000, 750000, 1500000, 3000000, 6000000,
+};
+
+/* Network throughput traces, as steps of seconds at kbit/s, looped */
+struct trace_step
+{
+    unsigned seconds;
+    unsigned kbps;
+};
+
+static const trace_step trace_fast[] = {
+    { 1, 20000 },
+};
+
+static const trace_step trace_drop[] = {
+    { 40, 8000 }, { 40, 1200 }, { 40, 8000 },
+};
+
+static const trace_step trace_mobile[] = {
+    { 3, 4200 }, { 2, 2900 }, { 4, 5100 }, { 1, 1900 }, { 2, 2600 },
+    { 5, 3800 }, { 3, 4700 }, { 1, 900 },  { 2, 1500 }, { 4, 3300 },
+    { 6, 5600 }, { 2, 4100 }, { 3, 2400 }, { 1, 1100 }, { 3, 2800 },
+    { 5, 4400 }, { 2, 6200 }, { 4, 5300 }, { 2, 3100 }, { 3, 2200 },
+};
+
+struct trace
+{
+    const trace_step *steps;
+    size_t count;
+};
+
+#define TRACE(t) { t, ARRAY_SIZE(t) }
+
+/* Time to transfer bits over the trace, starting at a given time */
+static mtime_t sim_transfer(const trace &t, mtime_t start, uint64_t bits)
+{
+    mtime_t period = 0;
+    for (size_t i = 0; i < t.count; i++)
+        period += t.steps[i].seconds * CLOCK_FREQ;
+
+    mtime_t now = start;
+    double left = bits;
+    for (;;)
+    {
+        mtime_t offset = now % period, end = 0;
+        size_t i = 0;
+        while (offset >= end + t.steps[i].seconds * CLOCK_FREQ)
+            end += t.steps[i++].seconds * CLOCK_FREQ;
+        end += t.steps[i].seconds * CLOCK_FREQ;
+
+        const double bps = t.steps[i].kbps * 1000.;
+        const double step = bps * (end - offset) / CLOCK_FREQ;
+        if (step >= left)
+            return now + (mtime_t)(left * CLOCK_FREQ / bps) - start;
+        left -= step;
+        now += end - offset;
+    }
+}
+
+class SimPlaylist : public AbstractPlaylist
+{
+    public:
+        SimPlaylist(vlc_object_t *obj, bool live_)
+            : AbstractPlaylist(obj), live(live_) {}
+        virtual bool isLive() const { return live; }
+        virtual void debug() {}
+
+    private:
+        bool live;
+};
+
+class SimRepresentation : public BaseRepresentation
+{
+    public:
+        SimRepresentation(BaseAdaptationSet *set) : BaseRepresentation(set) {}
+        virtual StreamFormat getStreamFormat() const
+        {
+            return StreamFormat(StreamFormat::MPEG2TS);
+        }
+};
+
+static SimPlaylist *sim_playlist(vlc_object_t *obj, bool live,
+                                 mtime_t duration, unsigned count)
+{
+    SimPlaylist *playlist = new SimPlaylist(obj, live);
+    playlist->setPlaylistUrl("http://sim.example.com/");
+
+    BasePeriod *period = new BasePeriod(playlist);
+    BaseAdaptationSet *set = new BaseAdaptationSet(period);
+    set->setID(ID("video"));
+
+    for (size_t i = 0; i < ARRAY_SIZE(sim_bitrates); i++)
+    {
+        SimRepresentation *rep = new SimRepresentation(set);
+        rep->setID(ID(i));
+        rep->setBandwidth(sim_bitrates[i]);
+        rep->setTimescale(CLOCK_FREQ);
+        rep->setSwitchPolicy(SegmentInformation::SWITCH_SEGMENT_ALIGNED);
+
+        SegmentList *list = new SegmentList(rep);
+        for (unsigned n = 0; n < count; n++)
+        {
+            Segment *seg = new Segment(rep);
+            std::ostringstream url;
+            url << i << "/" << n << ".ts";
+            seg->setSourceUrl(url.str());
+            seg->setSequenceNumber(n);
+            seg->startTime.Set(n * duration);
+            seg->duration.Set(duration);
+            list->addSegment(seg);
+        }
+        rep->appendSegmentList(list, true);
+        set->addRepresentation(rep);
+    }
+    period->addAdaptationSet(set);
+    playlist->addPeriod(period);
+    return playlist;
+}
+
+/* Downloads are simulated, the chunks are never read */
+class SimConnectionManager : public AbstractConnectionManager
+{
+    public:
+        SimConnectionManager(vlc_object_t *obj) : AbstractConnectionManager(obj) {}
+        virtual void closeAllConnections() {}
+        virtual AbstractConnection * getConnection(ConnectionParams &) { return NULL; }
+        virtual void releaseConnection(AbstractConnection *) {}
+        virtual void start(AbstractChunkSource *) {}
+        virtual void cancel(AbstractChunkSource *) {}
+        virtual void trackerEvent(const SegmentTrackerEvent &) {}
+};
+
+class SimListener : public SegmentTrackerListenerInterface
+{
+    public:
+        SimListener() : rep(NULL), switches(0) {}
+        virtual void trackerEvent(const SegmentTrackerEvent &event)
+        {
+            if (event.type != SegmentTrackerEvent::SWITCHING ||
+                event.u.switching.next == NULL)
+                return;
+            if (rep != NULL)
+                switches++;
+            rep = event.u.switching.next;
+        }
+        BaseRepresentation *rep;
+        unsigned switches;
+};
+
+struct sim_result
+{
+    std::vector<uint64_t> bitrates; /* of each segment */
+    uint64_t average;
+    mtime_t stalls; /* after startup */
+    unsigned switches;
+};
+
+static void simulate(vlc_object_t *obj, const trace &t, bool live,
+                     sim_result *res)
+{
+    const mtime_t duration = live ? CLOCK_FREQ : 2 * CLOCK_FREQ;
+    SimPlaylist *playlist = sim_playlist(obj, live, duration, 300);
+    BaseAdaptationSet *set = playlist->getFirstPeriod()->getAdaptationSets().front();
+
+    LowLatencyAdaptationLogic logic(obj);
+    SimConnectionManager mgr(obj);
+    mgr.setDownloadRateObserver(&logic);
+
+    SegmentTracker *tracker = new SegmentTracker(&logic, set);
+    SimListener listener;
+    tracker->registerListener(&listener);
+    tracker->notifyBufferingState(true);
+
+    mtime_t now = 0, buffered = 0;
+    uint64_t total = 0;
+
+    res->bitrates.clear();
+    res->stalls = 0;
+
+    for (;;)
+    {
+        tracker->notifyBufferingLevel(0, buffered, SIM_MAX_BUFFERING);
+        SegmentChunk *chunk = tracker->getNextChunk(true, &mgr);
+        if (chunk == NULL)
+            break;
+        delete chunk;
+
+        const mtime_t index = res->bitrates.size();
+        const uint64_t bits = listener.rep->getBandwidth() * duration / CLOCK_FREQ;
+        mtime_t start = now;
+        if (live) /* Segments get produced in real time, and sent as they are */
+            start = std::max(now, (index - SIM_LIVE_DELAY) * duration);
+        mtime_t end = start + SIM_LATENCY;
+        end += sim_transfer(t, end, bits);
+        if (live)
+            end = std::max(end, (index - SIM_LIVE_DELAY + 1) * duration);
+
+        mgr.updateActiveDownloadRate(set->getID(), bits / 8, end - start - SIM_LATENCY,
+                                     SIM_LATENCY);
+
+        /* Playback meanwhile, from the first segment */
+        if (index > 0)
+        {
+            if (end - now > buffered)
+            {
+                res->stalls += end - now - buffered;
+                buffered = 0;
+            }
+            else
+                buffered -= end - now;
+        }
+        buffered += duration;
+        now = end;
+
+        /* Non live content: no more downloads while the buffer is full */
+        if (!live && buffered > SIM_MAX_BUFFERING)
+        {
+            now += buffered - SIM_MAX_BUFFERING;
+            buffered = SIM_MAX_BUFFERING;
+        }
+
+        res->bitrates.push_back(listener.rep->getBandwidth());
+        total += listener.rep->getBandwidth();
+    }
+
+    res->average = total / res->bitrates.size();
+    res->switches = listener.switches;
+
+    delete tracker;
+    delete playlist;
+}
+
+static void test_logic(vlc_object_t *obj)
+{
+    static const trace fast = TRACE(trace_fast);
+    static const trace drop = TRACE(trace_drop);
+    static const trace mobile = TRACE(trace_mobile);
+    sim_result res;
+
+    for (int live = 0; live < 2; live++)
+    {
+        /* Climbs to the top quality, one step at a time, and stays there */
+        simulate(obj, fast, live, &res);
+        assert(res.stalls == 0);
+        assert(res.switches == ARRAY_SIZE(sim_bitrates) - 1);
+        assert(res.bitrates.back() == sim_bitrates[ARRAY_SIZE(sim_bitrates) - 1]);
+
+        /* Goes down when the throughput drops, and back up when it recovers */
+        simulate(obj, drop, live, &res);
+        assert(res.stalls < 3 * CLOCK_FREQ);
+        assert(*std::min_element(res.bitrates.begin() + 10, res.bitrates.end())
+               <= 750000);
+        if (!live)
+            assert(res.bitrates.back() == sim_bitrates[ARRAY_SIZE(sim_bitrates) - 1]);
+
+        /* Follows a varying throughput without stalling */
+        simulate(obj, mobile, live, &res);
+        assert(res.stalls == 0);
+        assert(res.average >= 2000000);
+    }
+}
+
+int main(void)
+{
+    setenv("VLC_PLUGIN_PATH", "../modules", 1);
+
+    libvlc_instance_t *vlc = libvlc_new(0, NULL);
+    assert(vlc != NULL);
+
+    if (!server_start())
+    {
+        libvlc_release(vlc);
+        return 77;
+    }
+
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+    var_Create(obj, "adaptive-use-access", VLC_VAR_BOOL);
+    var_Create(obj, "adaptive-downloads", VLC_VAR_INTEGER);
+    var_Create(obj, "adaptive-host-connections", VLC_VAR_INTEGER);
+    var_Create(obj, "adaptive-http2", VLC_VAR_BOOL);
+    var_SetBool(obj, "adaptive-http2", true);
+    storage = new AuthStorage(obj);
+
+    mtime_t serial = test_parallel(obj, 1);
+    mtime_t parallel = test_parallel(obj, 4);
+    assert(serial >= 4 * LATENCY);
+    assert(parallel < serial);
+
+    test_host_limit(obj);
+    test_priority(obj);
+    test_http2(obj);
+    test_logic(obj);
+
+    /* Closes the HTTP/2 connection */
+    delete storage;
+    if (h2server.connections > 0)
+    {
+        vlc_join(h2server.thread, NULL);
+        vlc_tls_SessionDelete(h2server.tls);
+    }
+    server_stop();
+    libvlc_release(vlc);
+    return 0;
+}
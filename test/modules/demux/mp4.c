@@ -0,0 +1,754 @@
+/*****************************************************************************
+ * mp4.c: MP4 demuxer sample tables test and benchmark
+ *****************************************************************************
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc/vlc.h>
+
+#include "../../../lib/libvlc_internal.h"
+
+#include <vlc_common.h>
+#include <vlc_modules.h>
+#include <vlc_block.h>
+#include <vlc_demux.h>
+#include <vlc_es_out.h>
+#include <vlc_stream.h>
+#include <vlc_fs.h>
+
+#undef NDEBUG
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define CHUNK_SAMPLES 60
+#define SYNC_INTERVAL 25
+#define TIMESCALE     1000000 /* same as the VLC clock, no rounding */
+
+struct layout
+{
+    unsigned tracks;
+    uint32_t samples;   /**< per track */
+    uint32_t size;      /**< smallest sample size */
+    uint32_t skew;      /**< chunks the next track lags behind in the file */
+};
+
+/* A long file of tiny video samples, each one with its own stts and ctts
+ * entry, so that the sample tables are much larger than the media */
+static const struct layout large = { 1, 1800000, 4, 0 };
+
+/* Two tracks, their chunks interleaved, but 30 seconds apart in time */
+static const struct layout skewed = { 2, 3000, 1000, 12 };
+
+static mtime_t sample_dts(uint32_t i)
+{
+    /* Alternate durations, so that stts can not be run length encoded */
+    return (mtime_t)40000 * i + i / 2;
+}
+
+static mtime_t sample_pts(uint32_t i)
+{
+    return sample_dts(i) + (i % 3) * 40000;
+}
+
+static uint32_t sample_size(const struct layout *l, uint32_t i)
+{
+    return l->size + i % 5;
+}
+
+/* Payload of a sample, after its number */
+static uint8_t sample_byte(unsigned track, uint32_t i)
+{
+    return i + track * 0x55;
+}
+
+/*
+ * File writer
+ */
+static void w8(FILE *f, uint8_t v)
+{
+    assert(fputc(v, f) != EOF);
+}
+
+static void w16(FILE *f, uint16_t v)
+{
+    w8(f, v >> 8);
+    w8(f, v);
+}
+
+static void w32(FILE *f, uint32_t v)
+{
+    w16(f, v >> 16);
+    w16(f, v);
+}
+
+static void w64(FILE *f, uint64_t v)
+{
+    w32(f, v >> 32);
+    w32(f, v);
+}
+
+static void wzero(FILE *f, size_t n)
+{
+    while (n--)
+        w8(f, 0);
+}
+
+static long box_start(FILE *f, const char *type)
+{
+    long pos = ftell(f);
+    w32(f, 0);
+    assert(fwrite(type, 1, 4, f) == 4);
+    return pos;
+}
+
+static void box_end(FILE *f, long pos)
+{
+    long end = ftell(f);
+    assert(fseek(f, pos, SEEK_SET) == 0);
+    w32(f, end - pos);
+    assert(fseek(f, end, SEEK_SET) == 0);
+}
+
+static void full_box(FILE *f, uint8_t version, uint32_t flags)
+{
+    w8(f, version);
+    w8(f, flags >> 16);
+    w16(f, flags);
+}
+
+static void matrix(FILE *f)
+{
+    static const uint32_t m[9] = {
+        0x10000, 0, 0, 0, 0x10000, 0, 0, 0, 0x40000000,
+    };
+    for (unsigned i = 0; i < 9; i++)
+        w32(f, m[i]);
+}
+
+/* Returns where the chunk offsets are to be written */
+static long write_trak(FILE *f, const struct layout *l, unsigned track)
+{
+    const uint64_t duration = sample_dts(l->samples);
+    const uint32_t chunks = l->samples / CHUNK_SAMPLES;
+    long box[8], stco;
+
+    box[1] = box_start(f, "trak");
+    box[2] = box_start(f, "tkhd");
+    full_box(f, 0, 0x3);
+    w32(f, 0); w32(f, 0);
+    w32(f, track + 1);
+    w32(f, 0);
+    w32(f, duration / 1000);
+    wzero(f, 8); w16(f, 0); w16(f, 0); w16(f, 0); w16(f, 0);
+    matrix(f);
+    w32(f, 320 << 16); w32(f, 240 << 16);
+    box_end(f, box[2]);
+
+    box[2] = box_start(f, "mdia");
+    box[3] = box_start(f, "mdhd");
+    full_box(f, 1, 0);
+    w64(f, 0); w64(f, 0);
+    w32(f, TIMESCALE);
+    w64(f, duration);
+    w16(f, 0x55c4); w16(f, 0);
+    box_end(f, box[3]);
+
+    box[3] = box_start(f, "hdlr");
+    full_box(f, 0, 0);
+    w32(f, 0);
+    assert(fwrite("vide", 1, 4, f) == 4);
+    wzero(f, 12 + 1);
+    box_end(f, box[3]);
+
+    box[3] = box_start(f, "minf");
+    box[4] = box_start(f, "vmhd");
+    full_box(f, 0, 1);
+    wzero(f, 8);
+    box_end(f, box[4]);
+
+    box[4] = box_start(f, "dinf");
+    box[5] = box_start(f, "dref");
+    full_box(f, 0, 0);
+    w32(f, 1);
+    box[6] = box_start(f, "url ");
+    full_box(f, 0, 1);
+    box_end(f, box[6]);
+    box_end(f, box[5]);
+    box_end(f, box[4]);
+
+    box[4] = box_start(f, "stbl");
+    box[5] = box_start(f, "stsd");
+    full_box(f, 0, 0);
+    w32(f, 1);
+    box[6] = box_start(f, "jpeg");
+    wzero(f, 6); w16(f, 1);
+    wzero(f, 16);
+    w16(f, 320); w16(f, 240);
+    w32(f, 0x480000); w32(f, 0x480000);
+    w32(f, 0); w16(f, 1);
+    wzero(f, 32);
+    w16(f, 24); w16(f, 0xffff);
+    box_end(f, box[6]);
+    box_end(f, box[5]);
+
+    box[5] = box_start(f, "stts");
+    full_box(f, 0, 0);
+    w32(f, l->samples);
+    for (uint32_t i = 0; i < l->samples; i++)
+    {
+        w32(f, 1);
+        w32(f, sample_dts(i + 1) - sample_dts(i));
+    }
+    box_end(f, box[5]);
+
+    box[5] = box_start(f, "ctts");
+    full_box(f, 0, 0);
+    w32(f, l->samples);
+    for (uint32_t i = 0; i < l->samples; i++)
+    {
+        w32(f, 1);
+        w32(f, sample_pts(i) - sample_dts(i));
+    }
+    box_end(f, box[5]);
+
+    box[5] = box_start(f, "stss");
+    full_box(f, 0, 0);
+    w32(f, (l->samples + SYNC_INTERVAL - 1) / SYNC_INTERVAL);
+    for (uint32_t i = 0; i < l->samples; i += SYNC_INTERVAL)
+        w32(f, i + 1);
+    box_end(f, box[5]);
+
+    box[5] = box_start(f, "stsc");
+    full_box(f, 0, 0);
+    w32(f, 1);
+    w32(f, 1); w32(f, CHUNK_SAMPLES); w32(f, 1);
+    box_end(f, box[5]);
+
+    box[5] = box_start(f, "stsz");
+    full_box(f, 0, 0);
+    w32(f, 0);
+    w32(f, l->samples);
+    for (uint32_t i = 0; i < l->samples; i++)
+        w32(f, sample_size(l, i));
+    box_end(f, box[5]);
+
+    /* Offsets are patched once the media data is written */
+    box[5] = box_start(f, "stco");
+    full_box(f, 0, 0);
+    w32(f, chunks);
+    stco = ftell(f);
+    wzero(f, 4 * chunks);
+    box_end(f, box[5]);
+
+    box_end(f, box[4]);
+    box_end(f, box[3]);
+    box_end(f, box[2]);
+    box_end(f, box[1]);
+    return stco;
+}
+
+/* Returns the end of the moov box */
+static long write_file(FILE *f, const struct layout *l)
+{
+    const uint32_t chunks = l->samples / CHUNK_SAMPLES;
+    long box, stco[l->tracks];
+
+    box = box_start(f, "ftyp");
+    assert(fwrite("isom", 1, 4, f) == 4);
+    w32(f, 0);
+    assert(fwrite("isommp41", 1, 8, f) == 8);
+    box_end(f, box);
+
+    box = box_start(f, "moov");
+    long mvhd = box_start(f, "mvhd");
+    full_box(f, 0, 0);
+    w32(f, 0); w32(f, 0);
+    w32(f, 1000);
+    w32(f, sample_dts(l->samples) / 1000);
+    w32(f, 0x10000); w16(f, 0x100); wzero(f, 10);
+    matrix(f);
+    wzero(f, 24);
+    w32(f, l->tracks + 1);
+    box_end(f, mvhd);
+
+    for (unsigned t = 0; t < l->tracks; t++)
+        stco[t] = write_trak(f, l, t);
+    box_end(f, box);
+    const long moov_end = ftell(f);
+
+    /* The chunks of the tracks alternate, each track being late by the
+     * skew over the previous one */
+    box = box_start(f, "mdat");
+    uint32_t *offsets = malloc(4 * chunks * l->tracks);
+    assert(offsets != NULL);
+    for (uint32_t k = 0; k < chunks + (l->tracks - 1) * l->skew; k++)
+        for (unsigned t = 0; t < l->tracks; t++)
+        {
+            if (k < t * l->skew || k - t * l->skew >= chunks)
+                continue;
+
+            const uint32_t chunk = k - t * l->skew;
+            offsets[t * chunks + chunk] = ftell(f);
+            for (uint32_t i = chunk * CHUNK_SAMPLES;
+                 i < (chunk + 1) * CHUNK_SAMPLES; i++)
+            {
+                w32(f, i);
+                for (uint32_t j = 4; j < sample_size(l, i); j++)
+                    w8(f, sample_byte(t, i));
+            }
+        }
+    box_end(f, box);
+
+    for (unsigned t = 0; t < l->tracks; t++)
+    {
+        assert(fseek(f, stco[t], SEEK_SET) == 0);
+        for (uint32_t i = 0; i < chunks; i++)
+            w32(f, offsets[t * chunks + i]);
+    }
+    free(offsets);
+    return moov_end;
+}
+
+/*
+ * Checking ES output
+ */
+struct test_es_out
+{
+    es_out_t out;
+    const struct layout *layout;
+    struct test_track
+    {
+        uint32_t next; /**< expected sample, UINT32_MAX after a seek */
+        uint32_t seek; /**< expected sample after a seek */
+    } tracks[2]; /**< the ES identifiers point there */
+    unsigned es; /**< added ones */
+    unsigned count; /**< of received samples */
+};
+
+static es_out_id_t *EsOutAdd(es_out_t *out, const es_format_t *fmt)
+{
+    struct test_es_out *ctx = (struct test_es_out *)out;
+
+    assert(fmt->i_cat == VIDEO_ES);
+    assert(ctx->es < ctx->layout->tracks);
+    assert(ctx->es < ARRAY_SIZE(ctx->tracks));
+    return (es_out_id_t *)&ctx->tracks[ctx->es++];
+}
+
+static int EsOutSend(es_out_t *out, es_out_id_t *id, block_t *block)
+{
+    struct test_es_out *ctx = (struct test_es_out *)out;
+    struct test_track *tk = (struct test_track *)id;
+    const unsigned t = tk - ctx->tracks;
+
+    assert(t < ctx->es);
+    assert(block->i_buffer >= 4);
+
+    uint32_t i = GetDWBE(block->p_buffer);
+    if (tk->next == UINT32_MAX)
+        assert(i == tk->seek);
+    else
+        assert(i == tk->next);
+
+    assert(block->i_buffer == sample_size(ctx->layout, i));
+    for (size_t j = 4; j < block->i_buffer; j++)
+        assert(block->p_buffer[j] == sample_byte(t, i));
+    assert(block->i_dts == VLC_TS_0 + sample_dts(i));
+    assert(block->i_pts == VLC_TS_0 + sample_pts(i));
+
+    tk->next = i + 1;
+    ctx->count++;
+    block_Release(block);
+    return VLC_SUCCESS;
+}
+
+static void EsOutDelete(es_out_t *out, es_out_id_t *id)
+{
+    struct test_es_out *ctx = (struct test_es_out *)out;
+
+    assert((struct test_track *)id - ctx->tracks < ctx->layout->tracks);
+    assert(ctx->es > 0);
+    ctx->es--;
+}
+
+static int EsOutControl(es_out_t *out, int query, va_list args)
+{
+    switch (query)
+    {
+        case ES_OUT_GET_ES_STATE:
+            (void) va_arg(args, es_out_id_t *);
+            *va_arg(args, bool *) = true;
+            break;
+        case ES_OUT_GET_EMPTY:
+            *va_arg(args, bool *) = true;
+            break;
+        case ES_OUT_SET_ES:
+        case ES_OUT_SET_ES_DEFAULT:
+        case ES_OUT_SET_ES_STATE:
+        case ES_OUT_SET_ES_FMT:
+        case ES_OUT_SET_PCR:
+        case ES_OUT_SET_GROUP_PCR:
+        case ES_OUT_RESET_PCR:
+        case ES_OUT_SET_NEXT_DISPLAY_TIME:
+        case ES_OUT_SET_GROUP_META:
+        case ES_OUT_SET_META:
+            break;
+        default:
+            return VLC_EGENERIC;
+    }
+    (void) out;
+    return VLC_SUCCESS;
+}
+
+static void EsOutDestroy(es_out_t *out)
+{
+    (void) out;
+}
+
+/* Last sync sample up to a time */
+static uint32_t sync_sample(mtime_t time)
+{
+    uint32_t i = time / 40001;
+
+    while (i + 1 < large.samples && sample_dts(i + 1) <= time)
+        i++;
+    return i - i % SYNC_INTERVAL;
+}
+
+static void demux_samples(demux_t *demux, struct test_es_out *ctx,
+                          unsigned count)
+{
+    unsigned last = ctx->count + count;
+
+    while (ctx->count < last)
+        if (demux_Demux(demux) != VLC_DEMUXER_SUCCESS)
+            break;
+}
+
+static size_t resident(void)
+{
+    unsigned long size, rss;
+    FILE *f = fopen("/proc/self/statm", "r");
+
+    if (f == NULL)
+        return 0;
+    if (fscanf(f, "%lu %lu", &size, &rss) != 2)
+        rss = 0;
+    fclose(f);
+    return rss * sysconf(_SC_PAGESIZE);
+}
+
+static size_t test_demux(vlc_object_t *obj, const char *url, bool paged)
+{
+    struct test_es_out ctx = {
+        .out = {
+            .pf_add = EsOutAdd,
+            .pf_send = EsOutSend,
+            .pf_del = EsOutDelete,
+            .pf_control = EsOutControl,
+            .pf_destroy = EsOutDestroy,
+        },
+        .layout = &large,
+    };
+    struct test_track *tk = &ctx.tracks[0];
+
+    var_SetBool(obj, "mp4-paged-index", paged);
+
+    size_t rss = resident();
+    mtime_t start = mdate();
+
+    stream_t *s = vlc_stream_NewURL(obj, url);
+    assert(s != NULL);
+    demux_t *demux = demux_New(obj, "mp4", "", s, &ctx.out);
+    assert(demux != NULL);
+
+    mtime_t time = mdate() - start;
+    rss = resident() - rss;
+    printf("%s index: opened in %"PRId64" ms, %zu kB more resident\n",
+           paged ? "paged" : "full", time / 1000, rss / 1024);
+    assert(ctx.es == 1);
+
+    mtime_t length;
+    assert(demux_Control(demux, DEMUX_GET_LENGTH, &length) == VLC_SUCCESS);
+    /* The movie duration is in milliseconds */
+    assert(length <= sample_dts(large.samples));
+    assert(length > sample_dts(large.samples) - 1000);
+
+    /* From the start, over several pages */
+    demux_samples(demux, &ctx, 3 * 1024 + 17);
+    assert(tk->next >= 3 * 1024 + 17);
+
+    /* Seeks land on the last sync sample */
+    const mtime_t seeks[] = {
+        length / 2, length / 10, length - 1, 0, sample_dts(123456),
+        sample_dts(123456) - 1, length / 3,
+    };
+
+    for (size_t i = 0; i < ARRAY_SIZE(seeks); i++)
+    {
+        assert(demux_Control(demux, DEMUX_SET_TIME, seeks[i], false)
+               == VLC_SUCCESS);
+        tk->next = UINT32_MAX;
+        tk->seek = sync_sample(seeks[i]);
+        demux_samples(demux, &ctx, 2 * CHUNK_SAMPLES);
+        assert(tk->next != UINT32_MAX);
+    }
+
+    /* Up to the end, from the last sync sample */
+    assert(demux_Control(demux, DEMUX_SET_TIME, length, false) == VLC_SUCCESS);
+    tk->next = UINT32_MAX;
+    tk->seek = sync_sample(length);
+    demux_samples(demux, &ctx, large.samples);
+    assert(tk->next == large.samples);
+    assert(demux_Demux(demux) == VLC_DEMUXER_EOF);
+
+    demux_Delete(demux); /* deletes the stream too */
+    assert(ctx.es == 0);
+    return rss;
+}
+
+/*
+ * Stream counting the seeks, on a slow seeking medium
+ */
+static unsigned seek_count;
+
+static ssize_t CountRead(stream_t *s, void *buf, size_t len)
+{
+    return vlc_stream_Read(s->p_source, buf, len);
+}
+
+static int CountSeek(stream_t *s, uint64_t offset)
+{
+    seek_count++;
+    return vlc_stream_Seek(s->p_source, offset);
+}
+
+static int CountControl(stream_t *s, int query, va_list args)
+{
+    if (query == STREAM_CAN_FASTSEEK)
+    {
+        *va_arg(args, bool *) = false;
+        return VLC_SUCCESS;
+    }
+    return vlc_stream_vaControl(s->p_source, query, args);
+}
+
+static void CountDestroy(stream_t *s)
+{
+    vlc_stream_Delete(s->p_source);
+}
+
+/*
+ * Stream failing to read the sample tables on demand
+ */
+static bool table_errors;
+static uint64_t table_end; /**< of the moov box */
+static uint64_t fail_pos;
+
+static ssize_t FailRead(stream_t *s, void *buf, size_t len)
+{
+    if (table_errors && fail_pos < table_end)
+        return 0; /* as on errors, -1 means "try again" */
+
+    ssize_t ret = vlc_stream_Read(s->p_source, buf, len);
+    if (ret > 0)
+        fail_pos += ret;
+    return ret;
+}
+
+static int FailSeek(stream_t *s, uint64_t offset)
+{
+    int ret = vlc_stream_Seek(s->p_source, offset);
+    if (ret == VLC_SUCCESS)
+        fail_pos = offset;
+    return ret;
+}
+
+static int FailControl(stream_t *s, int query, va_list args)
+{
+    return vlc_stream_vaControl(s->p_source, query, args);
+}
+
+static void test_table_errors(vlc_object_t *obj, const char *url)
+{
+    struct test_es_out ctx = {
+        .out = {
+            .pf_add = EsOutAdd,
+            .pf_send = EsOutSend,
+            .pf_del = EsOutDelete,
+            .pf_control = EsOutControl,
+            .pf_destroy = EsOutDestroy,
+        },
+        .layout = &large,
+    };
+    struct test_track *tk = &ctx.tracks[0];
+
+    var_SetBool(obj, "mp4-paged-index", true);
+
+    stream_t *s = vlc_stream_CommonNew(obj, CountDestroy);
+    assert(s != NULL);
+    s->p_source = vlc_stream_NewURL(obj, url);
+    assert(s->p_source != NULL);
+    s->pf_read = FailRead;
+    s->pf_seek = FailSeek;
+    s->pf_control = FailControl;
+    fail_pos = 0;
+
+    demux_t *demux = demux_New(obj, "mp4", "", s, &ctx.out);
+    assert(demux != NULL);
+    assert(ctx.es == 1);
+    demux_samples(demux, &ctx, 100);
+
+    mtime_t length;
+    assert(demux_Control(demux, DEMUX_GET_LENGTH, &length) == VLC_SUCCESS);
+
+    /* The pages that cannot be read must not give samples out of zeroed
+     * entries: the track is disabled instead */
+    table_errors = true;
+    demux_Control(demux, DEMUX_SET_TIME, length / 2, false);
+    tk->next = UINT32_MAX;
+    tk->seek = sync_sample(length / 2);
+    unsigned count = ctx.count;
+    for (unsigned i = 0; i < 10; i++)
+        if (demux_Demux(demux) != VLC_DEMUXER_SUCCESS)
+            break;
+    assert(ctx.count == count);
+
+    /* The pages are read again once the stream recovers */
+    table_errors = false;
+    assert(demux_Control(demux, DEMUX_SET_TIME, length / 3, false)
+           == VLC_SUCCESS);
+    tk->next = UINT32_MAX;
+    tk->seek = sync_sample(length / 3);
+    demux_samples(demux, &ctx, 2 * CHUNK_SAMPLES);
+    assert(tk->next != UINT32_MAX);
+
+    demux_Delete(demux);
+    assert(ctx.es == 0);
+}
+
+static void test_interleaving(vlc_object_t *obj, const char *url)
+{
+    const struct layout *l = &skewed;
+    struct test_es_out ctx = {
+        .out = {
+            .pf_add = EsOutAdd,
+            .pf_send = EsOutSend,
+            .pf_del = EsOutDelete,
+            .pf_control = EsOutControl,
+            .pf_destroy = EsOutDestroy,
+        },
+        .layout = l,
+    };
+
+    stream_t *s = vlc_stream_CommonNew(obj, CountDestroy);
+    assert(s != NULL);
+    s->p_source = vlc_stream_NewURL(obj, url);
+    assert(s->p_source != NULL);
+    s->pf_read = CountRead;
+    s->pf_seek = CountSeek;
+    s->pf_control = CountControl;
+
+    demux_t *demux = demux_New(obj, "mp4", "", s, &ctx.out);
+    assert(demux != NULL);
+    assert(ctx.es == l->tracks);
+
+    /* Each track must come whole and in order, from wherever its chunks
+     * are in the file */
+    seek_count = 0;
+    while (demux_Demux(demux) == VLC_DEMUXER_SUCCESS);
+    for (unsigned t = 0; t < l->tracks; t++)
+        assert(ctx.tracks[t].next == l->samples);
+    assert(ctx.count == l->tracks * l->samples);
+
+    /* Reading the samples as they come seeks back and forth between the
+     * tracks, several times per chunk */
+    const uint32_t chunks = l->tracks * (l->samples / CHUNK_SAMPLES);
+    printf("interleaving: %u seeks for %"PRIu32" chunks\n", seek_count,
+           chunks);
+    assert(seek_count < chunks / 4);
+
+    /* The samples served from the data read ahead are accounted for */
+    int64_t avoided = var_GetInteger(demux, "mp4-seeks-avoided");
+    printf("interleaving: %"PRId64" seeks avoided\n", avoided);
+    assert(avoided > 0);
+
+    demux_Delete(demux);
+    assert(ctx.es == 0);
+}
+
+int main(void)
+{
+    setenv("VLC_PLUGIN_PATH", "../modules", 1);
+
+    libvlc_instance_t *vlc = libvlc_new(0, NULL);
+    assert(vlc != NULL);
+
+    if (!module_exists("mp4"))
+    {
+        libvlc_release(vlc);
+        return 77;
+    }
+
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+
+    char path[] = "/tmp/libvlc_XXXXXX";
+    int fd = vlc_mkstemp(path);
+    assert(fd != -1);
+    FILE *f = fdopen(fd, "wb");
+    assert(f != NULL);
+    table_end = write_file(f, &large);
+    assert(fclose(f) == 0);
+
+    char *url;
+    assert(asprintf(&url, "file://%s", path) != -1);
+
+    var_Create(obj, "mp4-paged-index", VLC_VAR_BOOL);
+    size_t full = test_demux(obj, url, false);
+    size_t paged = test_demux(obj, url, true);
+
+    /* The full index takes at least the 36 MB of tables */
+    if (full > 0)
+        assert(paged < full / 4);
+
+    test_table_errors(obj, url);
+
+    free(url);
+    unlink(path);
+
+    strcpy(path, "/tmp/libvlc_XXXXXX");
+    fd = vlc_mkstemp(path);
+    assert(fd != -1);
+    f = fdopen(fd, "wb");
+    assert(f != NULL);
+    write_file(f, &skewed);
+    assert(fclose(f) == 0);
+
+    assert(asprintf(&url, "file://%s", path) != -1);
+    test_interleaving(obj, url);
+    free(url);
+    unlink(path);
+    libvlc_release(vlc);
+    return 0;
+}
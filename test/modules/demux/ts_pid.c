@@ -0,0 +1,130 @@
+/*****************************************************************************
+ * ts_pid.c: TS demux PID table test and lookup benchmark
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include <vlc_common.h>
+#include <vlc_demux.h>
+#include "../modules/demux/mpeg/ts_pid.c"
+
+/* After the included source, which includes config.h again */
+#undef NDEBUG
+#include <assert.h>
+
+/* Only TYPE_SI pids are set up here */
+static int dummy_si;
+
+ts_pat_t *ts_pat_New( demux_t *d ) { VLC_UNUSED(d); abort(); }
+void ts_pat_Del( demux_t *d, ts_pat_t *p ) { VLC_UNUSED(d); VLC_UNUSED(p); abort(); }
+ts_pmt_t *ts_pmt_New( demux_t *d ) { VLC_UNUSED(d); abort(); }
+void ts_pmt_Del( demux_t *d, ts_pmt_t *p ) { VLC_UNUSED(d); VLC_UNUSED(p); abort(); }
+ts_stream_t *ts_stream_New( demux_t *d, ts_pmt_t *p ) { VLC_UNUSED(d); VLC_UNUSED(p); abort(); }
+void ts_stream_Del( demux_t *d, ts_stream_t *p ) { VLC_UNUSED(d); VLC_UNUSED(p); abort(); }
+ts_si_t *ts_si_New( demux_t *d ) { VLC_UNUSED(d); return (ts_si_t *) &dummy_si; }
+void ts_si_Del( demux_t *d, ts_si_t *p ) { VLC_UNUSED(d); assert( p == (ts_si_t *) &dummy_si ); }
+ts_psip_t *ts_psip_New( demux_t *d ) { VLC_UNUSED(d); abort(); }
+void ts_psip_Del( demux_t *d, ts_psip_t *p ) { VLC_UNUSED(d); VLC_UNUSED(p); abort(); }
+
+#define PID_COUNT    150
+#define LOOKUP_COUNT (1 << 24)
+
+/* Former lookup method, as reference */
+static int cmp_pid( const void *key, const void *other )
+{
+    const uint16_t i_pid = *(const uint16_t *) key;
+    const ts_pid_t *p_pid = *(ts_pid_t * const *) other;
+    return (int) i_pid - (int) p_pid->i_pid;
+}
+
+static ts_pid_t * bsearch_Get( ts_pid_list_t *p_list, uint16_t i_pid )
+{
+    ts_pid_t **pp = bsearch( &i_pid, p_list->pp_all, p_list->i_all,
+                             sizeof(ts_pid_t *), cmp_pid );
+    return pp ? *pp : NULL;
+}
+
+int main( void )
+{
+    demux_sys_t sys = { .b_access_control = false };
+    demux_t demux = { .p_sys = &sys };
+    ts_pid_list_t list;
+    uint16_t pids[PID_COUNT];
+
+    ts_pid_list_Init( &list );
+
+    /* Creation on the fly, and stable lookups */
+    srand( 0 );
+    for( int i = 0; i < PID_COUNT; i++ )
+    {
+        pids[i] = MIN_ES_PID + rand() % (0x1FFB - MIN_ES_PID);
+        ts_pid_t *p_pid = ts_pid_Get( &list, pids[i] );
+        assert( p_pid->i_pid == pids[i] );
+        assert( p_pid == ts_pid_Get( &list, pids[i] ) );
+    }
+    assert( ts_pid_Get( &list, 0 ) == &list.pat );
+    assert( ts_pid_Get( &list, 0x1FFF ) == &list.dummy );
+    assert( ts_pid_Get( &list, 0x1FFB ) == &list.base_si );
+
+    /* Iteration stays ordered */
+    ts_pid_next_context_t ctx = ts_pid_NextContextInitValue;
+    ts_pid_t *p_pid, *p_prev = NULL;
+    while( (p_pid = ts_pid_Next( &list, &ctx )) )
+    {
+        assert( p_prev == NULL || p_prev->i_pid < p_pid->i_pid );
+        assert( ts_pid_Get( &list, p_pid->i_pid ) == p_pid );
+        p_prev = p_pid;
+    }
+
+    /* Refcount and type semantics */
+    p_pid = ts_pid_Get( &list, pids[0] );
+    assert( p_pid->type == TYPE_FREE && p_pid->i_refcount == 0 );
+    assert( PIDSetup( &demux, TYPE_SI, p_pid, NULL ) );
+    assert( PIDSetup( &demux, TYPE_SI, p_pid, NULL ) );
+    assert( p_pid->type == TYPE_SI && p_pid->i_refcount == 2 );
+    assert( ts_pid_Get( &list, pids[0] ) == p_pid );
+    PIDRelease( &demux, p_pid );
+    PIDRelease( &demux, p_pid );
+    assert( p_pid->type == TYPE_FREE && p_pid->i_refcount == 0 );
+    assert( ts_pid_Get( &list, pids[0] ) == p_pid );
+
+    /* Lookup benchmark */
+    mtime_t i_start = mdate();
+    uint64_t i_sum = 0;
+    for( unsigned i = 0; i < LOOKUP_COUNT; i++ )
+    {
+        const ts_pid_t *p = ts_pid_Get( &list, pids[i % PID_COUNT] );
+        i_sum += p->i_pid;
+    }
+    mtime_t i_direct = mdate() - i_start;
+
+    i_start = mdate();
+    for( unsigned i = 0; i < LOOKUP_COUNT; i++ )
+    {
+        const ts_pid_t *p = bsearch_Get( &list, pids[i % PID_COUNT] );
+        i_sum -= p->i_pid;
+    }
+    mtime_t i_bsearch = mdate() - i_start;
+    assert( i_sum == 0 );
+
+    printf( "%d lookups over %d pids: direct %"PRId64" us, bsearch %"PRId64" us\n",
+            LOOKUP_COUNT, PID_COUNT, i_direct, i_bsearch );
+
+    ts_pid_list_Release( &demux, &list );
+
+    return 0;
+}
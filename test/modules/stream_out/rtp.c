@@ -0,0 +1,147 @@
+/*****************************************************************************
+ * rtp.c: RTP stream output batching test
+ *****************************************************************************
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+#include <vlc_es.h>
+#include <vlc_sout.h>
+#include "../../libvlc/test.h"
+#include "../../../lib/libvlc_internal.h"
+
+#define PACKETS 400
+#define SPACING 700 /* microseconds between packets, below the quantum */
+
+/* Binds a receiver on an even port, as the RTP output only uses these */
+static int receiver(unsigned *port)
+{
+    for (;;)
+    {
+        struct sockaddr_in addr = {
+            .sin_family = AF_INET,
+            .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+        };
+        socklen_t len = sizeof (addr);
+        int fd = socket(AF_INET, SOCK_DGRAM, 0);
+
+        assert(fd != -1);
+        assert(bind(fd, (struct sockaddr *)&addr, sizeof (addr)) == 0);
+        assert(getsockname(fd, (struct sockaddr *)&addr, &len) == 0);
+        *port = ntohs(addr.sin_port);
+        if ((*port & 1) == 0)
+            return fd;
+        close(fd);
+    }
+}
+
+int main(void)
+{
+    test_init();
+
+    libvlc_instance_t *vlc = libvlc_new(test_defaults_nargs,
+                                        test_defaults_args);
+    assert(vlc != NULL);
+
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+    sout_instance_t *sout = vlc_object_create(obj, sizeof (*sout));
+    assert(sout != NULL);
+    vlc_mutex_init(&sout->lock);
+
+    unsigned port;
+    int fd = receiver(&port);
+
+    /* Each batch gathers the packets due within one millisecond, and
+     * dequeues the first one due after it */
+    char chain[80];
+    snprintf(chain, sizeof (chain),
+             "rtp{dst=127.0.0.1,port=%u,caching=0,quantum=1}", port);
+
+    sout_stream_t *stream = sout_StreamChainNew(sout, chain, NULL, NULL);
+    if (stream == NULL)
+    {
+        close(fd);
+        vlc_mutex_destroy(&sout->lock);
+        vlc_object_release(sout);
+        libvlc_release(vlc);
+        return 77;
+    }
+
+    es_format_t fmt;
+    es_format_Init(&fmt, AUDIO_ES, VLC_CODEC_S16B);
+    fmt.audio.i_channels = 1;
+    fmt.audio.i_rate = 44100;
+
+    sout_stream_id_sys_t *id = sout_StreamIdAdd(stream, &fmt);
+    assert(id != NULL);
+
+    mtime_t start = mdate() + CLOCK_FREQ / 10;
+
+    for (unsigned i = 0; i < PACKETS; i++)
+    {
+        block_t *block = block_Alloc(64);
+        assert(block != NULL);
+        memset(block->p_buffer, i, block->i_buffer);
+        block->i_dts = block->i_pts = start + i * SPACING;
+        block->i_length = SPACING;
+        assert(sout_StreamIdSend(stream, id, block) == VLC_SUCCESS);
+    }
+
+    /* Every packet must come, none lost between two batches */
+    unsigned count = 0;
+    uint16_t seq = 0;
+    struct pollfd ufd = { .fd = fd, .events = POLLIN };
+
+    while (count < PACKETS && poll(&ufd, 1, 2000) > 0)
+    {
+        uint8_t buf[1500];
+        ssize_t val = recv(fd, buf, sizeof (buf), 0);
+
+        assert(val == 12 + 64);
+        if (count > 0)
+            assert(GetWBE(buf + 2) == (uint16_t)(seq + 1));
+        seq = GetWBE(buf + 2);
+        assert(buf[12] == (uint8_t)count);
+        count++;
+    }
+    printf("%u packets sent, %u received\n", PACKETS, count);
+    assert(count == PACKETS);
+
+    sout_StreamIdDel(stream, id);
+    sout_StreamChainDelete(stream, NULL);
+    close(fd);
+    vlc_mutex_destroy(&sout->lock);
+    vlc_object_release(sout);
+    libvlc_release(vlc);
+    return 0;
+}
@@ -0,0 +1,205 @@
+/*****************************************************************************
+ * copy.c: picture copy test and benchmark
+ *****************************************************************************
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#undef NDEBUG
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_picture.h>
+
+#include "../modules/video_chroma/copy.h"
+#include "../modules/video_chroma/copy.c"
+
+typedef void (*copy_function_t)(picture_t *, uint8_t *[], size_t [],
+                                unsigned, copy_cache_t *);
+
+static const struct
+{
+    const char     *name;
+    vlc_fourcc_t    src;
+    vlc_fourcc_t    dst;
+    copy_function_t copy;
+} kernels[] = {
+    { "NV12 -> YV12",      VLC_CODEC_NV12,     VLC_CODEC_YV12, CopyFromNv12ToYv12 },
+    { "NV12 -> I420",      VLC_CODEC_NV12,     VLC_CODEC_I420, CopyFromNv12ToI420 },
+    { "NV12 -> NV12",      VLC_CODEC_NV12,     VLC_CODEC_NV12, CopyFromNv12ToNv12 },
+    { "YV12 -> YV12",      VLC_CODEC_YV12,     VLC_CODEC_YV12, CopyFromYv12ToYv12 },
+    { "I420 -> NV12",      VLC_CODEC_I420,     VLC_CODEC_NV12, CopyFromI420ToNv12 },
+    { "I420_10L -> P010",  VLC_CODEC_I420_10L, VLC_CODEC_P010, CopyFromI420_10ToP010 },
+};
+
+static const struct
+{
+    unsigned width, height;
+} sizes[] = {
+    {  720,  576 },
+    { 1920, 1080 },
+    { 3840, 2160 },
+};
+
+#define MIN_DURATION (CLOCK_FREQ / 5)
+
+static uint32_t seed = 1;
+
+static picture_t *make_picture(vlc_fourcc_t chroma, unsigned width,
+                               unsigned height, unsigned padding)
+{
+    video_format_t fmt;
+
+    video_format_Init(&fmt, chroma);
+    video_format_Setup(&fmt, chroma, width + padding, height,
+                       width, height, 1, 1);
+
+    picture_t *pic = picture_NewFromFormat(&fmt);
+    assert(pic != NULL);
+
+    for (int i = 0; i < pic->i_planes; i++)
+        for (int y = 0; y < pic->p[i].i_lines * pic->p[i].i_pitch; y++) {
+            seed = seed * 1103515245 + 12345;
+            pic->p[i].p_pixels[y] = seed >> 16;
+        }
+    return pic;
+}
+
+static uint8_t *pixel(const picture_t *pic, int plane, unsigned x, unsigned y)
+{
+    return &pic->p[plane].p_pixels[y * pic->p[plane].i_pitch + x];
+}
+
+/* Straightforward conversion of the visible area */
+static void convert_ref(picture_t *dst, const picture_t *src)
+{
+    const unsigned width = src->format.i_visible_width;
+    const unsigned height = src->format.i_visible_height;
+
+    if (src->format.i_chroma == VLC_CODEC_I420_10L)
+    {
+        for (unsigned y = 0; y < height; y++)
+            for (unsigned x = 0; x < width; x++)
+                ((uint16_t *)pixel(dst, 0, 0, y))[x] =
+                    ((const uint16_t *)pixel(src, 0, 0, y))[x] << 6;
+        for (unsigned y = 0; y < height / 2; y++)
+            for (unsigned x = 0; x < width / 2; x++)
+                for (int i = 0; i < 2; i++)
+                    ((uint16_t *)pixel(dst, 1, 0, y))[2 * x + i] =
+                        ((const uint16_t *)pixel(src, 1 + i, 0, y))[x] << 6;
+        return;
+    }
+
+    for (unsigned y = 0; y < height; y++)
+        memcpy(pixel(dst, 0, 0, y), pixel(src, 0, 0, y), width);
+
+    for (unsigned y = 0; y < height / 2; y++)
+    {
+        if (src->i_planes == dst->i_planes)
+        {
+            for (int i = 1; i < src->i_planes; i++)
+                memcpy(pixel(dst, i, 0, y), pixel(src, i, 0, y),
+                       src->p[i].i_visible_pitch);
+        }
+        else if (src->i_planes == 2)
+        {
+            /* The first sample of each pair is U */
+            const int u = dst->format.i_chroma == VLC_CODEC_YV12 ? 2 : 1;
+            for (unsigned x = 0; x < width / 2; x++)
+            {
+                *pixel(dst, u, x, y) = *pixel(src, 1, 2 * x, y);
+                *pixel(dst, 3 - u, x, y) = *pixel(src, 1, 2 * x + 1, y);
+            }
+        }
+        else
+        {
+            for (unsigned x = 0; x < width / 2; x++)
+            {
+                *pixel(dst, 1, 2 * x, y) = *pixel(src, 1, x, y);
+                *pixel(dst, 1, 2 * x + 1, y) = *pixel(src, 2, x, y);
+            }
+        }
+    }
+}
+
+static bool same_picture(const picture_t *a, const picture_t *b)
+{
+    for (int i = 0; i < a->i_planes; i++)
+        for (int y = 0; y < a->p[i].i_visible_lines; y++)
+            if (memcmp(pixel(a, i, 0, y), pixel(b, i, 0, y),
+                       a->p[i].i_visible_pitch))
+                return false;
+    return true;
+}
+
+static void test(size_t k, unsigned width, unsigned height)
+{
+    /* The destination pitch differs from the source one, otherwise the
+     * planes would be copied with a single memcpy() */
+    picture_t *src = make_picture(kernels[k].src, width, height, 0);
+    picture_t *dst = make_picture(kernels[k].dst, width, height, 64);
+    picture_t *ref = make_picture(kernels[k].dst, width, height, 64);
+    copy_cache_t cache;
+
+    uint8_t *planes[3];
+    size_t pitches[3];
+    size_t bytes = 0;
+    for (int i = 0; i < src->i_planes; i++)
+    {
+        planes[i] = src->p[i].p_pixels;
+        pitches[i] = src->p[i].i_pitch;
+        bytes += src->p[i].i_pitch * src->p[i].i_visible_lines;
+    }
+
+    assert(CopyInitCache(&cache, src->p[0].i_pitch) == VLC_SUCCESS);
+
+    picture_Copy(ref, dst);
+    convert_ref(ref, src);
+    kernels[k].copy(dst, planes, pitches, height, &cache);
+    assert(same_picture(dst, ref));
+
+    unsigned loops = 0;
+    mtime_t start = mdate(), time;
+    do
+    {
+        kernels[k].copy(dst, planes, pitches, height, &cache);
+        loops++;
+        time = mdate() - start;
+    }
+    while (time < MIN_DURATION);
+
+    printf("%-17s %4ux%-4u %6.2f GB/s\n", kernels[k].name, width, height,
+           (double)bytes * loops * CLOCK_FREQ / time / 1e9);
+
+    CopyCleanCache(&cache);
+    picture_Release(ref);
+    picture_Release(dst);
+    picture_Release(src);
+}
+
+int main(void)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(kernels); i++)
+        for (size_t j = 0; j < ARRAY_SIZE(sizes); j++)
+            test(i, sizes[j].width, sizes[j].height);
+    return 0;
+}
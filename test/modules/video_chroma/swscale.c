@@ -0,0 +1,206 @@
+/*****************************************************************************
+ * swscale.c: swscale sliced conversion test
+ *****************************************************************************
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc/vlc.h>
+
+#include "../../../lib/libvlc_internal.h"
+
+#include <vlc_common.h>
+#include <vlc_modules.h>
+#include <vlc_filter.h>
+#include <vlc_picture.h>
+
+#undef NDEBUG
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WIDTH  1920
+#define HEIGHT 1080
+
+static const struct
+{
+    vlc_fourcc_t in;
+    vlc_fourcc_t out;
+} conversions[] = {
+    /* Same chroma subsampling */
+    { VLC_CODEC_I420, VLC_CODEC_YV12 },
+    { VLC_CODEC_RGBA, VLC_CODEC_BGRA },
+    /* Chroma resampled vertically, converted with margins */
+    { VLC_CODEC_I420, VLC_CODEC_RGBA },
+    { VLC_CODEC_NV12, VLC_CODEC_BGRA },
+    { VLC_CODEC_YV12, VLC_CODEC_RGBA },
+    { VLC_CODEC_RGBA, VLC_CODEC_I420 },
+    { VLC_CODEC_I420, VLC_CODEC_I422 },
+    { VLC_CODEC_I422, VLC_CODEC_NV12 },
+};
+
+/* Bicubic, Gauss, SincR and bicubic spline, the last ones having the
+ * longest filters */
+static const int modes[] = { 2, 7, 8, 10 };
+
+static picture_t *video_new(filter_t *filter)
+{
+    return picture_NewFromFormat(&filter->fmt_out.video);
+}
+
+static const filter_owner_t owner = {
+    .video = {
+        .buffer_new = video_new,
+    },
+};
+
+/* Textured picture, so that the chroma filters have something to mix */
+static picture_t *make_picture(vlc_fourcc_t chroma)
+{
+    picture_t *pic = picture_New(chroma, WIDTH, HEIGHT, 1, 1);
+    assert(pic != NULL);
+
+    uint32_t seed = 1;
+    for (int i = 0; i < pic->i_planes; i++)
+    {
+        plane_t *p = &pic->p[i];
+
+        for (int y = 0; y < p->i_lines; y++)
+            for (int x = 0; x < p->i_pitch; x++)
+            {
+                seed = seed * 1103515245 + 12345;
+                p->p_pixels[y * p->i_pitch + x] =
+                    ((x / 16 + y / 16) & 1 ? 192 : 64) + (seed >> 26);
+            }
+    }
+    return pic;
+}
+
+static bool same_picture(const picture_t *a, const picture_t *b)
+{
+    if (a->i_planes != b->i_planes)
+        return false;
+
+    for (int i = 0; i < a->i_planes; i++)
+    {
+        const plane_t *pa = &a->p[i], *pb = &b->p[i];
+
+        for (int y = 0; y < pa->i_visible_lines; y++)
+            if (memcmp(&pa->p_pixels[y * pa->i_pitch],
+                       &pb->p_pixels[y * pb->i_pitch], pa->i_visible_pitch))
+                return false;
+    }
+    return true;
+}
+
+/* Converts a picture with the given number of threads */
+static picture_t *convert(vlc_object_t *obj, picture_t *in, vlc_fourcc_t out,
+                          unsigned n_threads)
+{
+    es_format_t fmt_in, fmt_out;
+
+    es_format_Init(&fmt_in, VIDEO_ES, in->format.i_chroma);
+    video_format_Setup(&fmt_in.video, in->format.i_chroma, WIDTH, HEIGHT,
+                       WIDTH, HEIGHT, 1, 1);
+    es_format_Init(&fmt_out, VIDEO_ES, out);
+    video_format_Setup(&fmt_out.video, out, WIDTH, HEIGHT, WIDTH, HEIGHT,
+                       1, 1);
+
+    var_SetInteger(obj, "swscale-threads", n_threads);
+
+    filter_chain_t *chain = filter_chain_NewVideo(obj, false, &owner);
+    assert(chain != NULL);
+    filter_chain_Reset(chain, &fmt_in, &fmt_out);
+    if (filter_chain_AppendFilter(chain, "swscale", NULL, &fmt_in,
+                                  &fmt_out) == NULL)
+    {
+        filter_chain_Delete(chain);
+        es_format_Clean(&fmt_out);
+        es_format_Clean(&fmt_in);
+        return NULL;
+    }
+
+    /* Convert twice, so that the second run uses the started workers */
+    picture_Hold(in);
+    picture_t *pic = filter_chain_VideoFilter(chain, in);
+    assert(pic != NULL);
+    picture_Release(pic);
+    picture_Hold(in);
+    pic = filter_chain_VideoFilter(chain, in);
+    assert(pic != NULL);
+
+    filter_chain_Delete(chain);
+    es_format_Clean(&fmt_out);
+    es_format_Clean(&fmt_in);
+    return pic;
+}
+
+int main(void)
+{
+    setenv("VLC_PLUGIN_PATH", "../modules", 1);
+
+    libvlc_instance_t *vlc = libvlc_new(0, NULL);
+    assert(vlc != NULL);
+
+    if (!module_exists("swscale"))
+    {
+        libvlc_release(vlc);
+        return 77;
+    }
+
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+    var_Create(obj, "swscale-threads", VLC_VAR_INTEGER);
+    var_Create(obj, "swscale-mode", VLC_VAR_INTEGER);
+
+    for (size_t i = 0; i < ARRAY_SIZE(conversions); i++)
+    {
+        picture_t *in = make_picture(conversions[i].in);
+
+        for (size_t j = 0; j < ARRAY_SIZE(modes); j++)
+        {
+            var_SetInteger(obj, "swscale-mode", modes[j]);
+
+            picture_t *ref = convert(obj, in, conversions[i].out, 1);
+            if (ref == NULL)
+            {
+                printf("%4.4s -> %4.4s: unsupported\n",
+                       (const char *)&conversions[i].in,
+                       (const char *)&conversions[i].out);
+                break;
+            }
+
+            /* Sliced conversions must not change the output */
+            picture_t *pic = convert(obj, in, conversions[i].out, 4);
+            assert(pic != NULL);
+            assert(same_picture(ref, pic));
+            picture_Release(pic);
+            picture_Release(ref);
+
+            printf("%4.4s -> %4.4s, mode %d: same in slices\n",
+                   (const char *)&conversions[i].in,
+                   (const char *)&conversions[i].out, modes[j]);
+        }
+        picture_Release(in);
+    }
+
+    libvlc_release(vlc);
+    return 0;
+}
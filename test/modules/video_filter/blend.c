@@ -0,0 +1,292 @@
+/*****************************************************************************
+ * blend.c: blend filter test and benchmark
+ *****************************************************************************
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc/vlc.h>
+
+#include "../../../lib/libvlc_internal.h"
+
+#include <vlc_common.h>
+#include <vlc_modules.h>
+#include <vlc_filter.h>
+#include <vlc_picture.h>
+
+#undef NDEBUG
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WIDTH  1920
+#define HEIGHT 1080
+#define LOOPS  50
+
+static const struct
+{
+    vlc_fourcc_t dst;
+    vlc_fourcc_t src;
+    uint32_t rmask, gmask, bmask;
+} formats[] = {
+    { VLC_CODEC_I420,  VLC_CODEC_YUVA, 0, 0, 0 },
+    { VLC_CODEC_YV12,  VLC_CODEC_YUVA, 0, 0, 0 },
+    { VLC_CODEC_I422,  VLC_CODEC_YUVA, 0, 0, 0 },
+    { VLC_CODEC_I444,  VLC_CODEC_YUVA, 0, 0, 0 },
+    { VLC_CODEC_NV12,  VLC_CODEC_YUVA, 0, 0, 0 },
+    { VLC_CODEC_NV21,  VLC_CODEC_YUVA, 0, 0, 0 },
+    { VLC_CODEC_RGB32, VLC_CODEC_RGBA, 0x00ff0000, 0x0000ff00, 0x000000ff },
+    { VLC_CODEC_RGB32, VLC_CODEC_RGBA, 0x000000ff, 0x0000ff00, 0x00ff0000 },
+    { VLC_CODEC_RGB32, VLC_CODEC_RGBA, 0xff000000, 0x00ff0000, 0x0000ff00 },
+};
+
+/* Source sizes and destination offsets, odd on purpose */
+static const struct
+{
+    unsigned width, height;
+    unsigned x, y;
+} areas[] = {
+    { 333, 101,    0,   0 },
+    { 333, 101,    1,   1 },
+    { 47,   13,    7,   3 },
+    { 2,     2,    5,   9 },
+    { 1,     5,    2,   2 },
+    { 640, 200, 1700, 999 },
+};
+
+static const int alphas[] = { 255, 128, 1 };
+
+static uint32_t seed = 1;
+
+static uint8_t rand8(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 16;
+}
+
+static uint8_t *pixel(const picture_t *pic, int plane, unsigned x, unsigned y)
+{
+    return &pic->p[plane].p_pixels[y * pic->p[plane].i_pitch + x];
+}
+
+static picture_t *make_picture(vlc_fourcc_t chroma, unsigned width,
+                               unsigned height, uint32_t rmask,
+                               uint32_t gmask, uint32_t bmask)
+{
+    video_format_t fmt;
+
+    video_format_Init(&fmt, chroma);
+    video_format_Setup(&fmt, chroma, width, height, width, height, 1, 1);
+    fmt.i_rmask = rmask;
+    fmt.i_gmask = gmask;
+    fmt.i_bmask = bmask;
+    video_format_FixRgb(&fmt);
+
+    picture_t *pic = picture_NewFromFormat(&fmt);
+    assert(pic != NULL);
+
+    for (int i = 0; i < pic->i_planes; i++)
+        for (int y = 0; y < pic->p[i].i_lines; y++)
+            for (int x = 0; x < pic->p[i].i_pitch; x++)
+                pixel(pic, i, x, y)[0] = rand8();
+
+    /* Transparent and opaque runs in the alpha samples of the sources */
+    if (chroma == VLC_CODEC_YUVA || chroma == VLC_CODEC_RGBA)
+    {
+        const int plane = chroma == VLC_CODEC_YUVA ? 3 : 0;
+        const unsigned step = chroma == VLC_CODEC_YUVA ? 1 : 4;
+
+        for (unsigned y = 0; y < height; y++)
+            for (unsigned x = 0; x < width; x++)
+            {
+                unsigned run = (x / 16 + y) % 4;
+                if (run < 2)
+                    pixel(pic, plane, step * x + step - 1, y)[0] = run ? 255 : 0;
+            }
+    }
+    return pic;
+}
+
+static unsigned div255(unsigned v)
+{
+    return ((v >> 8) + v + 1) >> 8;
+}
+
+static void merge(uint8_t *dst, unsigned src, unsigned f)
+{
+    *dst = div255((255 - f) * *dst + src * f);
+}
+
+/* Straightforward blending, as specified by the generic blend code */
+static void blend_ref(picture_t *dst, const picture_t *src,
+                      unsigned dx, unsigned dy, int alpha)
+{
+    const video_format_t *fmt = &dst->format;
+    const vlc_chroma_description_t *dsc =
+        vlc_fourcc_GetChromaDescription(fmt->i_chroma);
+    const bool swap_uv = fmt->i_chroma == VLC_CODEC_YV12
+                      || fmt->i_chroma == VLC_CODEC_NV21;
+    unsigned width = __MIN(fmt->i_visible_width - dx,
+                           src->format.i_visible_width);
+    unsigned height = __MIN(fmt->i_visible_height - dy,
+                            src->format.i_visible_height);
+
+    for (unsigned y = 0; y < height; y++)
+        for (unsigned x = 0; x < width; x++)
+        {
+            const unsigned px = dx + x, py = dy + y;
+            unsigned c[4];
+
+            if (src->format.i_chroma == VLC_CODEC_RGBA)
+                for (int i = 0; i < 4; i++)
+                    c[i] = pixel(src, 0, 4 * x + i, y)[0];
+            else
+                for (int i = 0; i < 4; i++)
+                    c[i] = pixel(src, i, x, y)[0];
+
+            const unsigned a = div255(alpha * c[3]);
+            if (a == 0)
+                continue;
+
+            if (fmt->i_chroma == VLC_CODEC_RGB32)
+            {
+#ifdef WORDS_BIGENDIAN
+                const unsigned offset[3] = {
+                    (32 - fmt->i_lrshift) / 8, (32 - fmt->i_lgshift) / 8,
+                    (32 - fmt->i_lbshift) / 8,
+                };
+#else
+                const unsigned offset[3] = {
+                    fmt->i_lrshift / 8, fmt->i_lgshift / 8,
+                    fmt->i_lbshift / 8,
+                };
+#endif
+                for (int i = 0; i < 3; i++)
+                    merge(pixel(dst, 0, 4 * px + offset[i], py), c[i], a);
+                continue;
+            }
+
+            merge(pixel(dst, 0, px, py), c[0], a);
+
+            /* Semi-planar chroma lines have one U and one V per pair */
+            const unsigned rx = dst->i_planes == 2
+                              ? 2 : dsc->p[1].w.den / dsc->p[1].w.num;
+            const unsigned ry = dsc->p[1].h.den / dsc->p[1].h.num;
+            if ((px % rx) != 0 || (py % ry) != 0)
+                continue;
+
+            if (dst->i_planes == 2)
+            {
+                uint8_t *uv = pixel(dst, 1, px / rx * 2, py / ry);
+                merge(&uv[swap_uv], c[1], a);
+                merge(&uv[!swap_uv], c[2], a);
+            }
+            else
+            {
+                merge(pixel(dst, swap_uv ? 2 : 1, px / rx, py / ry), c[1], a);
+                merge(pixel(dst, swap_uv ? 1 : 2, px / rx, py / ry), c[2], a);
+            }
+        }
+}
+
+static bool same_picture(const picture_t *a, const picture_t *b)
+{
+    for (int i = 0; i < a->i_planes; i++)
+        for (int y = 0; y < a->p[i].i_visible_lines; y++)
+            if (memcmp(pixel(a, i, 0, y), pixel(b, i, 0, y),
+                       a->p[i].i_visible_pitch))
+                return false;
+    return true;
+}
+
+static void test(vlc_object_t *obj, size_t f)
+{
+    picture_t *base = make_picture(formats[f].dst, WIDTH, HEIGHT,
+                                   formats[f].rmask, formats[f].gmask,
+                                   formats[f].bmask);
+    picture_t *dst = picture_NewFromFormat(&base->format);
+    picture_t *ref = picture_NewFromFormat(&base->format);
+    assert(dst != NULL && ref != NULL);
+
+    filter_t *blend = filter_NewBlend(obj, &base->format);
+    assert(blend != NULL);
+
+    /* Compare with the reference on small and misaligned areas */
+    for (size_t i = 0; i < ARRAY_SIZE(areas); i++)
+    {
+        picture_t *src = make_picture(formats[f].src, areas[i].width,
+                                      areas[i].height, 0, 0, 0);
+
+        assert(filter_ConfigureBlend(blend, WIDTH, HEIGHT,
+                                     &src->format) == VLC_SUCCESS);
+        for (size_t j = 0; j < ARRAY_SIZE(alphas); j++)
+        {
+            picture_Copy(dst, base);
+            picture_Copy(ref, base);
+            assert(filter_Blend(blend, dst, areas[i].x, areas[i].y, src,
+                                alphas[j]) == VLC_SUCCESS);
+            blend_ref(ref, src, areas[i].x, areas[i].y, alphas[j]);
+            assert(same_picture(dst, ref));
+        }
+        picture_Release(src);
+    }
+
+    /* Full frame subpicture */
+    picture_t *src = make_picture(formats[f].src, WIDTH, HEIGHT, 0, 0, 0);
+
+    assert(filter_ConfigureBlend(blend, WIDTH, HEIGHT,
+                                 &src->format) == VLC_SUCCESS);
+    mtime_t start = mdate();
+    for (unsigned i = 0; i < LOOPS; i++)
+        assert(filter_Blend(blend, dst, 0, 0, src, 128) == VLC_SUCCESS);
+    mtime_t time = mdate() - start;
+
+    printf("%4.4s -> %4.4s (masks %08"PRIx32"): %7.1f Mpixels/s\n",
+           (const char *)&formats[f].src, (const char *)&formats[f].dst,
+           formats[f].rmask, (double)LOOPS * WIDTH * HEIGHT / (time > 0 ? time : 1));
+
+    picture_Release(src);
+    filter_DeleteBlend(blend);
+    picture_Release(ref);
+    picture_Release(dst);
+    picture_Release(base);
+}
+
+int main(void)
+{
+    setenv("VLC_PLUGIN_PATH", "../modules", 1);
+
+    libvlc_instance_t *vlc = libvlc_new(0, NULL);
+    assert(vlc != NULL);
+
+    if (!module_exists("blend"))
+    {
+        libvlc_release(vlc);
+        return 77;
+    }
+
+    for (size_t i = 0; i < ARRAY_SIZE(formats); i++)
+        test(VLC_OBJECT(vlc->p_libvlc_int), i);
+
+    libvlc_release(vlc);
+    return 0;
+}
@@ -0,0 +1,288 @@
+/*****************************************************************************
+ * deinterlace.c: deinterlace filter test and benchmark
+ *****************************************************************************
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc/vlc.h>
+
+#include "../../../lib/libvlc_internal.h"
+
+#include <vlc_common.h>
+#include <vlc_cpu.h>
+#include <vlc_modules.h>
+#include <vlc_filter.h>
+#include <vlc_picture.h>
+
+#undef NDEBUG
+#include <assert.h>
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WIDTH  1920
+#define HEIGHT 1080
+#define FRAMES 30
+
+static const char *const modes[] = {
+    "discard", "blend", "mean", "bob", "linear", "x",
+    "yadif", "yadif2x", "phosphor",
+};
+
+static const unsigned threads[] = { 1, 2, 4 };
+
+static unsigned cpu_mask = -1;
+
+/* Interposes the core CPU detection, so that the plugin only sees the
+ * capabilities left in cpu_mask. The plugin picks its kernels with these at
+ * run time, except those of the compiler baseline (e.g. SSE2 on x86-64).
+ * This needs the ELF dynamic linker: the test is only built on Linux. */
+unsigned vlc_CPU(void)
+{
+    static unsigned (*real_CPU)(void);
+
+    if (real_CPU == NULL)
+    {
+        real_CPU = (unsigned (*)(void))dlsym(RTLD_NEXT, "vlc_CPU");
+        assert(real_CPU != NULL);
+    }
+    return real_CPU() & cpu_mask;
+}
+
+static picture_t *video_new(filter_t *filter)
+{
+    return picture_NewFromFormat(&filter->fmt_out.video);
+}
+
+static const filter_owner_t owner = {
+    .video = {
+        .buffer_new = video_new,
+    },
+};
+
+/* Synthetic interlaced frame: a bar pattern moving between the two fields,
+ * so that the field of each line is visible in the picture, with some
+ * texture so that averages of two lines need rounding. */
+static picture_t *make_frame(const video_format_t *fmt, unsigned n)
+{
+    picture_t *pic = picture_NewFromFormat(fmt);
+    assert(pic != NULL);
+
+    for (int i = 0; i < pic->i_planes; i++)
+    {
+        plane_t *p = &pic->p[i];
+
+        /* Some modes read the padding around the visible area */
+        memset(p->p_pixels, 0, p->i_pitch * p->i_lines);
+        for (int y = 0; y < p->i_visible_lines; y++)
+        {
+            uint8_t *line = &p->p_pixels[y * p->i_pitch];
+            unsigned t = 2 * n + (y & 1);
+
+            for (int x = 0; x < p->i_visible_pitch; x++)
+                line[x] = ((((x + 6 * t) / 24) & 1) ? 200 - y / 8 : 40 + y / 8)
+                        + ((7 * x + 3 * y) & 7);
+        }
+    }
+
+    pic->date = VLC_TS_0 + n * CLOCK_FREQ / 25;
+    pic->b_progressive = false;
+    pic->b_top_field_first = true;
+    pic->i_nb_fields = 2;
+    return pic;
+}
+
+static uint32_t hash_picture(uint32_t h, const picture_t *pic)
+{
+    for (int i = 0; i < pic->i_planes; i++)
+    {
+        const plane_t *p = &pic->p[i];
+
+        for (int y = 0; y < p->i_visible_lines; y++)
+            for (int x = 0; x < p->i_visible_pitch; x++)
+                h = (h ^ p->p_pixels[y * p->i_pitch + x]) * 16777619;
+    }
+    return h;
+}
+
+static bool same_picture(const picture_t *a, const picture_t *b)
+{
+    if (a->i_planes != b->i_planes)
+        return false;
+
+    for (int i = 0; i < a->i_planes; i++)
+    {
+        const plane_t *pa = &a->p[i], *pb = &b->p[i];
+
+        for (int y = 0; y < pa->i_visible_lines; y++)
+            if (memcmp(&pa->p_pixels[y * pa->i_pitch],
+                       &pb->p_pixels[y * pb->i_pitch], pa->i_visible_pitch))
+                return false;
+    }
+    return true;
+}
+
+static filter_chain_t *open_chain(vlc_object_t *obj, es_format_t *fmt,
+                                  const char *mode, unsigned n_threads)
+{
+    char *str;
+
+    es_format_Init(fmt, VIDEO_ES, VLC_CODEC_I420);
+    video_format_Setup(&fmt->video, VLC_CODEC_I420, WIDTH, HEIGHT,
+                       WIDTH, HEIGHT, 1, 1);
+    fmt->video.i_frame_rate = 25;
+    fmt->video.i_frame_rate_base = 1;
+
+    filter_chain_t *chain = filter_chain_NewVideo(obj, true, &owner);
+    assert(chain != NULL);
+    filter_chain_Reset(chain, fmt, fmt);
+
+    assert(asprintf(&str, "deinterlace{mode=%s,threads=%u}", mode,
+                    n_threads) >= 0);
+    assert(filter_chain_AppendFromString(chain, str) == 1);
+    free(str);
+    return chain;
+}
+
+/* Runs a deinterlacing mode, returns the hash of all output pictures */
+static uint32_t run(vlc_object_t *obj, const char *mode, unsigned n_threads,
+                    double *fps)
+{
+    es_format_t fmt;
+    filter_chain_t *chain = open_chain(obj, &fmt, mode, n_threads);
+
+    picture_t *frames[FRAMES];
+    for (unsigned i = 0; i < FRAMES; i++)
+        frames[i] = make_frame(&fmt.video, i);
+
+    uint32_t h = 2166136261;
+    unsigned outputs = 0;
+    mtime_t start = mdate();
+
+    for (unsigned i = 0; i < FRAMES; i++)
+    {
+        /* Double rate modes leave their second picture in the chain */
+        for (picture_t *out = filter_chain_VideoFilter(chain, frames[i]);
+             out != NULL; out = filter_chain_VideoFilter(chain, NULL))
+        {
+            h = hash_picture(h, out);
+            picture_Release(out);
+            outputs++;
+        }
+    }
+
+    mtime_t time = mdate() - start;
+
+    assert(outputs > 0);
+    *fps = (double)outputs * CLOCK_FREQ / (time > 0 ? time : 1);
+
+    filter_chain_Delete(chain);
+    es_format_Clean(&fmt);
+    return h;
+}
+
+static picture_t *filter_masked(filter_chain_t *chain, picture_t *pic,
+                                unsigned mask)
+{
+    cpu_mask = mask;
+    pic = filter_chain_VideoFilter(chain, pic);
+    cpu_mask = -1;
+    return pic;
+}
+
+/* Runs a deinterlacing mode with the CPU capabilities masked down to the C
+ * kernels, and with only AVX2 left: the outputs must be identical. */
+static void compare(vlc_object_t *obj, const char *mode)
+{
+    es_format_t fmt_c, fmt_avx2;
+
+    cpu_mask = 0;
+    filter_chain_t *c = open_chain(obj, &fmt_c, mode, 1);
+    cpu_mask = VLC_CPU_AVX2;
+    filter_chain_t *avx2 = open_chain(obj, &fmt_avx2, mode, 1);
+    cpu_mask = -1;
+
+    for (unsigned i = 0; i < FRAMES; i++)
+    {
+        picture_t *out_c = filter_masked(c, make_frame(&fmt_c.video, i), 0);
+        picture_t *out_avx2 = filter_masked(avx2,
+                                            make_frame(&fmt_avx2.video, i),
+                                            VLC_CPU_AVX2);
+
+        while (out_c != NULL || out_avx2 != NULL)
+        {
+            assert(out_c != NULL && out_avx2 != NULL);
+            assert(same_picture(out_c, out_avx2));
+            picture_Release(out_c);
+            picture_Release(out_avx2);
+            out_c = filter_masked(c, NULL, 0);
+            out_avx2 = filter_masked(avx2, NULL, VLC_CPU_AVX2);
+        }
+    }
+
+    filter_chain_Delete(avx2);
+    filter_chain_Delete(c);
+    es_format_Clean(&fmt_avx2);
+    es_format_Clean(&fmt_c);
+}
+
+int main(void)
+{
+    setenv("VLC_PLUGIN_PATH", "../modules", 1);
+
+    libvlc_instance_t *vlc = libvlc_new(0, NULL);
+    assert(vlc != NULL);
+
+    if (!module_exists("deinterlace"))
+    {
+        libvlc_release(vlc);
+        return 77;
+    }
+
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+    const bool avx2 = vlc_CPU_AVX2();
+
+    for (size_t i = 0; i < ARRAY_SIZE(modes); i++)
+    {
+        uint32_t ref = 0;
+
+        printf("%-9s", modes[i]);
+        for (size_t j = 0; j < ARRAY_SIZE(threads); j++)
+        {
+            double fps;
+            uint32_t h = run(obj, modes[i], threads[j], &fps);
+
+            /* Band-parallel rendering must not change the output */
+            if (j == 0)
+                ref = h;
+            assert(h == ref);
+            printf(" %u thread(s): %7.1f fps", threads[j], fps);
+        }
+
+        if (avx2)
+            compare(obj, modes[i]);
+        printf(" AVX2: %s\n", avx2 ? "same as C" : "skipped");
+    }
+
+    libvlc_release(vlc);
+    return 0;
+}
@@ -0,0 +1,159 @@
+/*****************************************************************************
+ * timeshift.c: timeshift buffer test
+ *****************************************************************************
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc/vlc.h>
+
+#include "../../../lib/libvlc_internal.h"
+
+#include <vlc_common.h>
+#include "../src/input/es_out_timeshift.c"
+
+#undef NDEBUG
+#include <assert.h>
+
+#define GRANULARITY (1 << 20)
+#define MAX_SIZE    (4 << 20)
+#define BLOCK_SIZE  (64 << 10)
+#define BLOCKS      (256)
+#define KEY_FRAMES  (8)
+
+/* Not exported by the core, and only used to reset the rate */
+void input_ControlPush( input_thread_t *p_input, int i_type,
+                        vlc_value_t *p_val )
+{
+    (void) p_input; (void) i_type; (void) p_val;
+    abort();
+}
+
+static int OutControl( es_out_t *p_out, int i_query, va_list args )
+{
+    (void) p_out; (void) args;
+    assert( i_query == ES_OUT_SET_TIME );
+    return VLC_SUCCESS;
+}
+
+static void PushBlock( ts_thread_t *p_ts, es_out_id_t *p_es, unsigned i_seq )
+{
+    block_t *p_block = block_Alloc( BLOCK_SIZE );
+    assert( p_block != NULL );
+
+    memset( p_block->p_buffer, i_seq & 0xff, BLOCK_SIZE );
+    memcpy( p_block->p_buffer, &i_seq, sizeof(i_seq) );
+    p_block->i_dts = p_block->i_pts = VLC_TS_0 + i_seq;
+    if( i_seq % KEY_FRAMES == 0 )
+        p_block->i_flags |= BLOCK_FLAG_TYPE_I;
+
+    ts_cmd_t cmd;
+    CmdInitSend( &cmd, p_es, p_block );
+    p_ts->i_time = i_seq;
+    TsPushCmd( p_ts, &cmd );
+}
+
+int main( void )
+{
+    setenv( "VLC_PLUGIN_PATH", "../modules", 1 );
+
+    libvlc_instance_t *vlc = libvlc_new( 0, NULL );
+    assert( vlc != NULL );
+
+    es_out_t out = { .pf_control = OutControl };
+    es_out_id_t *p_es = (es_out_id_t *)&out;
+    ts_thread_t *p_ts = calloc( 1, sizeof(*p_ts) );
+    assert( p_ts != NULL );
+
+    p_ts->p_input = (input_thread_t *)vlc->p_libvlc_int;
+    p_ts->p_out = &out;
+    p_ts->i_tmp_size_max = GRANULARITY;
+    p_ts->i_size_max = MAX_SIZE;
+    p_ts->i_time = p_ts->i_index_time = -1;
+    vlc_mutex_init( &p_ts->lock );
+    vlc_cond_init( &p_ts->wait );
+
+    /* Fill the buffer several times over while paused: the oldest data
+     * must be dropped in favour of the new data */
+    unsigned i_jumps = 0;
+    for( unsigned i = 0; i < BLOCKS; i++ )
+    {
+        PushBlock( p_ts, p_es, i );
+
+        vlc_mutex_lock( &p_ts->lock );
+        assert( p_ts->i_dropped == 0 );
+        assert( p_ts->i_size <= MAX_SIZE + GRANULARITY );
+        /* Do what the timeshift thread would do */
+        if( p_ts->seek.p_storage != NULL )
+        {
+            TsSeekLocked( p_ts );
+            i_jumps++;
+        }
+        vlc_mutex_unlock( &p_ts->lock );
+    }
+    assert( i_jumps > 0 );
+
+    /* The newest blocks are all there, from a random access point on */
+    unsigned i_next = BLOCKS, i_count = 0;
+    for( ;; )
+    {
+        ts_cmd_t cmd;
+
+        vlc_mutex_lock( &p_ts->lock );
+        int i_ret = TsPopCmdLocked( p_ts, &cmd, false );
+        vlc_mutex_unlock( &p_ts->lock );
+        if( i_ret )
+            break;
+
+        assert( cmd.i_type == C_SEND );
+        block_t *p_block = cmd.u.send.p_block;
+        unsigned i_seq;
+
+        assert( p_block != NULL && p_block->i_buffer == BLOCK_SIZE );
+        memcpy( &i_seq, p_block->p_buffer, sizeof(i_seq) );
+        if( i_count == 0 )
+        {
+            assert( i_seq % KEY_FRAMES == 0 );
+            assert( ( p_block->i_flags & BLOCK_FLAG_TYPE_I ) != 0 );
+        }
+        else
+            assert( i_seq == i_next );
+        assert( p_block->i_pts == VLC_TS_0 + i_seq );
+        assert( p_block->p_buffer[BLOCK_SIZE - 1] == ( i_seq & 0xff ) );
+        i_next = i_seq + 1;
+        i_count++;
+        block_Release( p_block );
+    }
+    assert( i_next == BLOCKS );
+    assert( i_count * BLOCK_SIZE >= MAX_SIZE - 2 * GRANULARITY );
+
+    /* A storage read was kept for reuse */
+    assert( p_ts->p_storage_free != NULL );
+
+    vlc_mutex_lock( &p_ts->lock );
+    assert( !p_ts->p_storage_r->p_next );
+    TsStorageDelete( p_ts->p_storage_r );
+    TsStorageDelete( p_ts->p_storage_free );
+    vlc_mutex_unlock( &p_ts->lock );
+    TsDestroy( p_ts );
+
+    libvlc_release( vlc );
+    return 0;
+}
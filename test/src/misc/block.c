@@ -0,0 +1,169 @@
+/*****************************************************************************
+ * block.c: block allocator unit test
+ *****************************************************************************
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#undef NDEBUG
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+
+#define BENCH_ROUNDS 200000
+
+static const size_t sizes[] = {
+    0, 1, 100, 188, 1316, 4096, 7 * 188, 65536, 100000, 200000, 300000,
+    1 << 20,
+};
+
+static void test_alloc(void)
+{
+    block_stats_t before, after;
+
+    block_GetStats(&before);
+
+    for (size_t i = 0; i < ARRAY_SIZE(sizes); i++)
+    {
+        block_t *b = block_Alloc(sizes[i]);
+        assert(b != NULL);
+        assert(b->i_buffer == sizes[i]);
+        assert(((uintptr_t)b->p_buffer % 32) == 0);
+        assert(b->p_buffer >= b->p_start + 32);
+        assert(b->p_buffer + b->i_buffer + 32 <= b->p_start + b->i_size);
+        memset(b->p_start, 0xAA, b->i_size);
+
+        b = block_Realloc(b, 16, sizes[i] + 1000);
+        assert(b != NULL);
+        assert(b->i_buffer == sizes[i] + 1016);
+        memset(b->p_buffer, 0x55, b->i_buffer);
+        block_Release(b);
+    }
+
+    block_GetStats(&after);
+    assert(after.live_blocks == before.live_blocks);
+    assert(after.live_bytes == before.live_bytes);
+    assert(after.hits + after.misses > before.hits + before.misses);
+}
+
+static void test_reuse(void)
+{
+    block_stats_t before, after;
+    block_t *b = block_Alloc(188);
+    assert(b != NULL);
+    block_Release(b);
+
+    /* The same thread should get a block from its free list */
+    block_GetStats(&before);
+    b = block_Alloc(188);
+    assert(b != NULL);
+    block_GetStats(&after);
+    assert(after.hits == before.hits + 1);
+    assert(after.misses == before.misses);
+    assert(after.live_blocks == before.live_blocks + 1);
+    block_Release(b);
+}
+
+static void *release_thread(void *data)
+{
+    block_ChainRelease(data);
+    return NULL;
+}
+
+static void *alloc_thread(void *data)
+{
+    block_t **pp = data;
+
+    for (unsigned i = 0; i < 1000; i++)
+    {
+        *pp = block_Alloc(1316);
+        assert(*pp != NULL);
+        pp = &(*pp)->p_next;
+    }
+    return NULL;
+}
+
+static void test_threads(void)
+{
+    block_stats_t before, after;
+    block_t *chain = NULL;
+    vlc_thread_t th;
+
+    block_GetStats(&before);
+
+    /* Blocks allocated in a thread and released in another one */
+    assert(vlc_clone(&th, alloc_thread, &chain, VLC_THREAD_PRIORITY_LOW) == 0);
+    vlc_join(th, NULL);
+
+    block_GetStats(&after);
+    assert(after.live_blocks == before.live_blocks + 1000);
+
+    assert(vlc_clone(&th, release_thread, chain, VLC_THREAD_PRIORITY_LOW) == 0);
+    vlc_join(th, NULL);
+
+    block_GetStats(&after);
+    assert(after.live_blocks == before.live_blocks);
+    assert(after.live_bytes == before.live_bytes);
+    /* Exiting threads return their free lists to the (bounded) pool */
+    assert(after.cached_bytes > 0);
+}
+
+static void test_bench(void)
+{
+    block_t *ring[64] = { NULL };
+    block_stats_t st;
+    mtime_t start = mdate();
+
+    /* Mixed sizes, as with demuxers feeding packetizers */
+    for (unsigned i = 0; i < BENCH_ROUNDS; i++)
+    {
+        unsigned slot = (i * 7) % ARRAY_SIZE(ring);
+
+        if (ring[slot] != NULL)
+            block_Release(ring[slot]);
+        ring[slot] = block_Alloc(sizes[i % 6]);
+        assert(ring[slot] != NULL);
+    }
+
+    for (size_t i = 0; i < ARRAY_SIZE(ring); i++)
+        block_Release(ring[i]);
+
+    mtime_t time = mdate() - start;
+
+    block_GetStats(&st);
+    printf("%u allocations in %"PRId64" us\n", BENCH_ROUNDS, time);
+    printf("live: %"PRIu64" blocks, %"PRIu64" bytes, cached: %"PRIu64
+           " bytes, hits: %"PRIu64", misses: %"PRIu64"\n", st.live_blocks,
+           st.live_bytes, st.cached_bytes, st.hits, st.misses);
+    assert(st.hits > st.misses);
+}
+
+int main(void)
+{
+    test_alloc();
+    test_reuse();
+    test_threads();
+    test_bench();
+    return 0;
+}
@@ -0,0 +1,216 @@
+/*****************************************************************************
+ * fifo.c: block FIFO unit test and benchmark
+ *****************************************************************************
+ * Copyright (C) 2018 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#undef NDEBUG
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+
+#define BENCH_BLOCKS 1000000
+
+static block_t *test_block(size_t size, unsigned seq)
+{
+    block_t *block = block_Alloc(size);
+    assert(block != NULL);
+    block->i_dts = seq;
+    return block;
+}
+
+static void test_spsc_basic(void)
+{
+    vlc_spsc_t *q = vlc_spsc_New();
+    assert(q != NULL);
+    assert(vlc_spsc_IsEmpty(q));
+    assert(vlc_spsc_Dequeue(q) == NULL);
+
+    /* Enough blocks to span several segments */
+    for (unsigned i = 0; i < 1000; i++)
+        assert(!vlc_spsc_Queue(q, test_block(i + 1, i)));
+    assert(vlc_spsc_GetCount(q) == 1000);
+    assert(vlc_spsc_GetBytes(q) == 1000 * 1001 / 2);
+
+    for (unsigned i = 0; i < 500; i++)
+    {
+        block_t *block = vlc_spsc_Dequeue(q);
+        assert(block != NULL);
+        assert(block->i_dts == i);
+        assert(block->i_buffer == i + 1);
+        block_Release(block);
+    }
+    assert(vlc_spsc_GetCount(q) == 500);
+
+    /* Chains are queued one block at a time */
+    block_t *chain = NULL, **pp = &chain;
+    for (unsigned i = 0; i < 3; i++)
+    {
+        *pp = test_block(1, 1000 + i);
+        pp = &(*pp)->p_next;
+    }
+    vlc_spsc_Queue(q, chain);
+    assert(vlc_spsc_GetCount(q) == 503);
+
+    for (unsigned i = 500; i < 1003; i++)
+    {
+        block_t *block = vlc_spsc_Dequeue(q);
+        assert(block != NULL);
+        assert(block->p_next == NULL);
+        assert(block->i_dts == i);
+        block_Release(block);
+    }
+    assert(vlc_spsc_IsEmpty(q));
+    assert(vlc_spsc_GetBytes(q) == 0);
+    assert(vlc_spsc_Dequeue(q) == NULL);
+
+    /* Deletion releases pending blocks */
+    for (unsigned i = 0; i < 200; i++)
+        vlc_spsc_Queue(q, test_block(16, i));
+    vlc_spsc_Delete(q);
+}
+
+static void test_spsc_flush(void)
+{
+    vlc_spsc_t *q = vlc_spsc_New();
+    assert(q != NULL);
+
+    for (unsigned i = 0; i < 300; i++)
+        vlc_spsc_Queue(q, test_block(10, i));
+
+    /* Flushed blocks are discarded by the consumer */
+    vlc_spsc_Flush(q);
+    assert(vlc_spsc_IsEmpty(q));
+    assert(vlc_spsc_GetBytes(q) == 0);
+
+    vlc_spsc_Queue(q, test_block(10, 300));
+    assert(vlc_spsc_GetCount(q) == 1);
+    assert(vlc_spsc_GetBytes(q) == 10);
+
+    block_t *block = vlc_spsc_Dequeue(q);
+    assert(block != NULL && block->i_dts == 300);
+    block_Release(block);
+    assert(vlc_spsc_Dequeue(q) == NULL);
+
+    /* Purging releases flushed blocks without dequeuing any other */
+    for (unsigned i = 0; i < 300; i++)
+        vlc_spsc_Queue(q, test_block(10, i));
+    vlc_spsc_Flush(q);
+    vlc_spsc_Queue(q, test_block(10, 301));
+    vlc_spsc_Purge(q);
+    assert(vlc_spsc_GetCount(q) == 1);
+
+    block = vlc_spsc_Dequeue(q);
+    assert(block != NULL && block->i_dts == 301);
+    block_Release(block);
+    vlc_spsc_Delete(q);
+}
+
+struct bench
+{
+    block_fifo_t *fifo;
+    vlc_spsc_t *spsc;
+    unsigned errors;
+};
+
+static void *fifo_consumer(void *data)
+{
+    struct bench *b = data;
+
+    for (unsigned i = 0; i < BENCH_BLOCKS; i++)
+    {
+        block_t *block = block_FifoGet(b->fifo);
+
+        b->errors += block->i_dts != i;
+        block_Release(block);
+    }
+    return NULL;
+}
+
+static void *spsc_consumer(void *data)
+{
+    struct bench *b = data;
+
+    for (unsigned i = 0; i < BENCH_BLOCKS; i++)
+    {
+        block_t *block;
+
+        while ((block = vlc_spsc_Dequeue(b->spsc)) == NULL)
+            vlc_spsc_Wait(b->spsc);
+
+        b->errors += block->i_dts != i;
+        block_Release(block);
+    }
+    return NULL;
+}
+
+static mtime_t bench_run(struct bench *b, void *(*consumer)(void *))
+{
+    vlc_thread_t th;
+    mtime_t start = mdate();
+
+    b->errors = 0;
+    assert(vlc_clone(&th, consumer, b, VLC_THREAD_PRIORITY_LOW) == 0);
+
+    for (unsigned i = 0; i < BENCH_BLOCKS; i++)
+    {
+        block_t *block = test_block(188, i);
+
+        if (b->spsc != NULL)
+            vlc_spsc_Queue(b->spsc, block);
+        else
+            block_FifoPut(b->fifo, block);
+    }
+
+    vlc_join(th, NULL);
+    assert(b->errors == 0);
+    return mdate() - start;
+}
+
+static void test_bench(void)
+{
+    struct bench b = { .fifo = block_FifoNew(), .spsc = NULL };
+    assert(b.fifo != NULL);
+
+    mtime_t locked = bench_run(&b, fifo_consumer);
+    block_FifoRelease(b.fifo);
+
+    b.fifo = NULL;
+    b.spsc = vlc_spsc_New();
+    assert(b.spsc != NULL);
+
+    mtime_t lockfree = bench_run(&b, spsc_consumer);
+    vlc_spsc_Delete(b.spsc);
+
+    printf("%u blocks: locked FIFO %"PRId64" us, lock-free queue %"PRId64
+           " us\n", BENCH_BLOCKS, locked, lockfree);
+}
+
+int main(void)
+{
+    test_spsc_basic();
+    test_spsc_flush();
+    test_bench();
+    return 0;
+}
@@ -443,6 +443,105 @@ static void test_creation_and_type( libvlc_int_t *p_libvlc )
     assert( var_Get( p_libvlc, "bla", &val ) == VLC_ENOVAR );
 }
 
+#define INHERIT_DEPTH 8
+#define BENCH_NAMES   64
+#define BENCH_COUNT   (1 << 18)
+
+static void test_inherit( libvlc_int_t *p_libvlc )
+{
+    vlc_object_t *objs[INHERIT_DEPTH];
+    vlc_object_t *parent = VLC_OBJECT(p_libvlc);
+
+    for( unsigned i = 0; i < INHERIT_DEPTH; i++ )
+    {
+        objs[i] = vlc_object_create( parent, sizeof (vlc_object_t) );
+        assert( objs[i] != NULL );
+        parent = objs[i];
+    }
+    vlc_object_t *leaf = objs[INHERIT_DEPTH - 1];
+
+    /* From the configuration */
+    int64_t mtu = config_GetInt( p_libvlc, "mtu" );
+    assert( var_InheritInteger( leaf, "mtu" ) == mtu );
+    config_PutInt( p_libvlc, "mtu", mtu + 1 );
+    assert( var_InheritInteger( leaf, "mtu" ) == mtu + 1 );
+    config_PutInt( p_libvlc, "mtu", mtu );
+    assert( var_InheritInteger( leaf, "mtu" ) == mtu );
+
+    /* Variables shadowing the configuration, then each other */
+    var_Create( p_libvlc, "mtu", VLC_VAR_INTEGER );
+    var_SetInteger( p_libvlc, "mtu", 1234 );
+    assert( var_InheritInteger( leaf, "mtu" ) == 1234 );
+    var_SetInteger( p_libvlc, "mtu", 4321 );
+    assert( var_InheritInteger( leaf, "mtu" ) == 4321 );
+    var_Create( objs[2], "mtu", VLC_VAR_INTEGER );
+    assert( var_InheritInteger( leaf, "mtu" ) == 0 );
+    var_IncInteger( objs[2], "mtu" );
+    assert( var_InheritInteger( leaf, "mtu" ) == 1 );
+    var_Change( objs[2], "mtu", VLC_VAR_SETVALUE,
+                &(vlc_value_t){ .i_int = 42 }, NULL );
+    assert( var_InheritInteger( leaf, "mtu" ) == 42 );
+    assert( var_InheritInteger( objs[1], "mtu" ) == 4321 );
+    var_Destroy( objs[2], "mtu" );
+    assert( var_InheritInteger( leaf, "mtu" ) == 4321 );
+    var_Destroy( p_libvlc, "mtu" );
+    assert( var_InheritInteger( leaf, "mtu" ) == mtu );
+
+    /* Strings are copied in and out of the cache */
+    var_Create( objs[0], "bla", VLC_VAR_STRING );
+    var_SetString( objs[0], "bla", "foo" );
+    for( unsigned i = 0; i < 2; i++ )
+    {
+        char *str = var_InheritString( leaf, "bla" );
+        assert( str != NULL && !strcmp( str, "foo" ) );
+        free( str );
+    }
+    var_SetString( objs[0], "bla", "bar" );
+    char *str = var_InheritString( leaf, "bla" );
+    assert( str != NULL && !strcmp( str, "bar" ) );
+    free( str );
+    var_Destroy( objs[0], "bla" );
+
+    /* Names which are neither variables nor configuration items are not
+     * cached, and the variables later created with them are found */
+    assert( var_InheritInteger( leaf, "foo" ) == -1 );
+    var_Create( objs[0], "foo", VLC_VAR_INTEGER );
+    var_SetInteger( objs[0], "foo", 1234 );
+    assert( var_InheritInteger( leaf, "foo" ) == 1234 );
+    var_Destroy( objs[0], "foo" );
+    assert( var_InheritInteger( leaf, "foo" ) == -1 );
+
+    /* Benchmark: lookups of many names, at the top of a deep object chain */
+    char names[BENCH_NAMES][16];
+    for( unsigned i = 0; i < BENCH_NAMES; i++ )
+    {
+        snprintf( names[i], sizeof (names[i]), "bench-%u", i );
+        var_Create( p_libvlc, names[i], VLC_VAR_INTEGER );
+        var_SetInteger( p_libvlc, names[i], i );
+    }
+
+    mtime_t start = mdate();
+    int64_t sum = 0;
+    for( unsigned i = 0; i < BENCH_COUNT; i++ )
+        sum += var_GetInteger( p_libvlc, names[i % BENCH_NAMES] );
+    mtime_t get = mdate() - start;
+
+    start = mdate();
+    for( unsigned i = 0; i < BENCH_COUNT; i++ )
+        sum -= var_InheritInteger( leaf, names[i % BENCH_NAMES] );
+    mtime_t inherit = mdate() - start;
+    assert( sum == 0 );
+
+    log( "%d lookups over %d names: get %"PRId64" us, inherit %"PRId64" us "
+         "(%d levels)\n", BENCH_COUNT, BENCH_NAMES, get, inherit,
+         INHERIT_DEPTH );
+
+    for( unsigned i = 0; i < BENCH_NAMES; i++ )
+        var_Destroy( p_libvlc, names[i] );
+    for( unsigned i = INHERIT_DEPTH; i > 0; i-- )
+        vlc_object_release( objs[i - 1] );
+}
+
 static void test_variables( libvlc_instance_t *p_vlc )
 {
     libvlc_int_t *p_libvlc = p_vlc->p_libvlc_int;
@@ -480,6 +579,9 @@ static void test_variables( libvlc_instance_t *p_vlc )
 
     log( "Testing type at creation\n" );
     test_creation_and_type( p_libvlc );
+
+    log( "Testing inheritance\n" );
+    test_inherit( p_libvlc );
 }
 
 
@@ -0,0 +1,330 @@
+/*****************************************************************************
+ * httpd.c: built-in HTTP server load test
+ *****************************************************************************
+ * Copyright (C) 2017 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+
+#include <vlc_common.h>
+#include <vlc_httpd.h>
+#include <vlc_block.h>
+#include <vlc_atomic.h>
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#define STREAM_CLIENTS 48
+#define FILE_CLIENTS   16
+#define CLIENTS        (STREAM_CLIENTS + FILE_CLIENTS)
+#define BLOCK_SIZE     8192
+#define RUN_TIME       (CLOCK_FREQ * 3 / 4)
+
+static const char body[] = "Hello world!\n";
+
+static int FileFill(httpd_file_sys_t *sys, httpd_file_t *file,
+                    uint8_t *request, uint8_t **pp_data, int *pi_data)
+{
+    (void) sys; (void) file; (void) request;
+
+    *pp_data = (uint8_t *)strdup(body);
+    *pi_data = strlen(body);
+    return VLC_SUCCESS;
+}
+
+struct client
+{
+    int fd;
+    bool stream;
+    char head[512]; /* response headers */
+    size_t head_len;
+    bool in_body;
+
+    /* stream clients: the body is a sequence of 64-bits stream offsets */
+    uint8_t word[8];
+    size_t word_len;
+    uint64_t last;
+    bool has_last;
+    uint64_t bytes;
+    unsigned resyncs;
+
+    /* file clients */
+    unsigned answers;
+};
+
+struct loadgen
+{
+    vlc_thread_t thread;
+    uint16_t port;
+    atomic_bool stop;
+    struct client clients[CLIENTS];
+};
+
+static int Connect(uint16_t port)
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    assert(fd != -1);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof (addr)))
+    {
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+static void Request(struct loadgen *lg, struct client *c)
+{
+    const char *req = c->stream ? "GET /stream HTTP/1.0\r\n\r\n"
+                                : "GET /file HTTP/1.0\r\n\r\n";
+
+    c->fd = Connect(lg->port);
+    assert(c->fd != -1);
+    assert(write(c->fd, req, strlen(req)) == (ssize_t)strlen(req));
+    c->head_len = 0;
+    c->in_body = false;
+}
+
+static void StreamData(struct client *c, const uint8_t *p, size_t len)
+{
+    c->bytes += len;
+    while (len > 0)
+    {
+        size_t copy = sizeof (c->word) - c->word_len;
+        if (copy > len)
+            copy = len;
+        memcpy(c->word + c->word_len, p, copy);
+        c->word_len += copy;
+        p += copy;
+        len -= copy;
+
+        if (c->word_len < sizeof (c->word))
+            break;
+        c->word_len = 0;
+
+        uint64_t off;
+        memcpy(&off, c->word, sizeof (off));
+        if (c->has_last && off != c->last + 8)
+        {   /* only allowed forward, at a block boundary */
+            assert(off > c->last);
+            assert((off % BLOCK_SIZE) == 0);
+            c->resyncs++;
+        }
+        else if (!c->has_last)
+            assert((off % BLOCK_SIZE) == 0);
+        c->last = off;
+        c->has_last = true;
+    }
+}
+
+static void Receive(struct loadgen *lg, struct client *c)
+{
+    uint8_t buf[65536];
+    ssize_t len = read(c->fd, buf, sizeof (buf));
+
+    if (len < 0)
+    {
+        assert(errno == EAGAIN);
+        return;
+    }
+    if (len == 0)
+    {   /* end of the answer */
+        assert(!c->stream);
+        assert(c->in_body);
+        close(c->fd);
+        c->answers++;
+        Request(lg, c);
+        return;
+    }
+
+    const uint8_t *p = buf;
+    if (!c->in_body)
+    {
+        while (len > 0 && !c->in_body)
+        {
+            assert(c->head_len < sizeof (c->head) - 1);
+            c->head[c->head_len++] = *(p++);
+            len--;
+            c->head[c->head_len] = '\0';
+            c->in_body = strstr(c->head, "\r\n\r\n") != NULL;
+        }
+        if (c->in_body)
+            assert(!strncmp(c->head, "HTTP/1.", 7)
+                && !strncmp(c->head + 8, " 200 ", 5));
+    }
+
+    if (c->stream)
+        StreamData(c, p, len);
+    else if (len > 0)
+        assert(len == (ssize_t)strlen(body) && !memcmp(p, body, len));
+}
+
+static void *LoadGenerator(void *data)
+{
+    struct loadgen *lg = data;
+    struct pollfd ufd[CLIENTS];
+
+    for (unsigned i = 0; i < CLIENTS; i++)
+    {
+        struct client *c = &lg->clients[i];
+
+        memset(c, 0, sizeof (*c));
+        c->stream = i < STREAM_CLIENTS;
+        Request(lg, c);
+    }
+
+    while (!atomic_load(&lg->stop))
+    {
+        for (unsigned i = 0; i < CLIENTS; i++)
+        {
+            ufd[i].fd = lg->clients[i].fd;
+            ufd[i].events = POLLIN;
+        }
+
+        if (poll(ufd, CLIENTS, 50) < 0)
+            continue;
+
+        for (unsigned i = 0; i < CLIENTS; i++)
+            if (ufd[i].revents)
+                Receive(lg, &lg->clients[i]);
+    }
+
+    for (unsigned i = 0; i < CLIENTS; i++)
+        close(lg->clients[i].fd);
+    return NULL;
+}
+
+static void test_load(libvlc_int_t *obj, int threads)
+{
+    httpd_host_t *host = NULL;
+    uint16_t port;
+
+    var_SetInteger(obj, "http-threads", threads);
+
+    /* find a free port */
+    for (unsigned i = 0; i < 16 && host == NULL; i++)
+    {
+        port = 20000 + (getpid() * 7 + i * 331) % 40000;
+        var_SetInteger(obj, "http-port", port);
+        host = vlc_http_HostNew(VLC_OBJECT(obj));
+    }
+    assert(host != NULL);
+
+    httpd_file_t *file = httpd_FileNew(host, "/file", "text/plain", NULL,
+                                       NULL, FileFill, NULL);
+    assert(file != NULL);
+    httpd_stream_t *stream = httpd_StreamNew(host, "/stream",
+                                             "application/octet-stream",
+                                             NULL, NULL);
+    assert(stream != NULL);
+
+    struct loadgen *lg = malloc(sizeof (*lg));
+    assert(lg != NULL);
+    lg->port = port;
+    atomic_init(&lg->stop, false);
+    assert(!vlc_clone(&lg->thread, LoadGenerator, lg,
+                      VLC_THREAD_PRIORITY_LOW));
+
+    /* feed the stream at about 4 MiB/s */
+    mtime_t start = mdate(), deadline = start;
+    uint64_t offset = 0;
+
+    while (deadline < start + RUN_TIME)
+    {
+        block_t *block = block_Alloc(BLOCK_SIZE);
+        assert(block != NULL);
+
+        for (size_t i = 0; i < BLOCK_SIZE; i += 8, offset += 8)
+            memcpy(block->p_buffer + i, &offset, 8);
+        assert(httpd_StreamSend(stream, block) == VLC_SUCCESS);
+        block_Release(block);
+        deadline += CLOCK_FREQ / 500;
+        mwait(deadline);
+    }
+
+    atomic_store(&lg->stop, true);
+    vlc_join(lg->thread, NULL);
+
+    uint64_t bytes = 0, overruns, dropped;
+    unsigned answers = 0;
+
+    for (unsigned i = 0; i < CLIENTS; i++)
+    {
+        const struct client *c = &lg->clients[i];
+
+        if (c->stream)
+        {
+            assert(c->bytes > 0);
+            bytes += c->bytes;
+        }
+        else
+        {
+            assert(c->answers > 0);
+            answers += c->answers;
+        }
+    }
+
+    httpd_StreamGetStats(stream, &overruns, &dropped);
+    log("%d thread(s): %u file answers, %"PRIu64" stream bytes "
+        "(%"PRIu64" overruns, %"PRIu64" dropped)\n", threads, answers, bytes,
+        overruns, dropped);
+
+    free(lg);
+    httpd_StreamDelete(stream);
+    httpd_FileDelete(file);
+    httpd_HostDelete(host);
+}
+
+int main(void)
+{
+    test_init();
+
+    libvlc_instance_t *vlc = libvlc_new(test_defaults_nargs,
+                                        test_defaults_args);
+    assert(vlc != NULL);
+
+    libvlc_int_t *obj = vlc->p_libvlc_int;
+    var_Create(obj, "http-host", VLC_VAR_STRING);
+    var_SetString(obj, "http-host", "127.0.0.1");
+    var_Create(obj, "http-port", VLC_VAR_INTEGER);
+    var_Create(obj, "http-threads", VLC_VAR_INTEGER);
+
+    test_load(obj, 1);
+    test_load(obj, 4);
+
+    libvlc_release(vlc);
+    return 0;
+}
@@ -28,7 +28,10 @@
 # include "config.h"
 #endif
 
+#include <stdint.h>
 #include <stdio.h>
+#include <time.h>
+#include <sys/stat.h>
 #include "src/input/demux-run.h"
 
 int main(int argc, char *argv[])
@@ -48,5 +51,19 @@ int main(int argc, char *argv[])
             return 1;
     }
 
-    return -vlc_demux_process_path(demux, filename);
+    struct timespec start, end;
+    struct stat st;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int ret = vlc_demux_process_path(demux, filename);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    /* Report demux throughput, e.g. to benchmark on recorded captures */
+    double secs = (end.tv_sec - start.tv_sec)
+                + (end.tv_nsec - start.tv_nsec) / 1e9;
+    if (ret == 0 && stat(filename, &st) == 0 && secs > 0.)
+        fprintf(stderr, "%s: %jd bytes in %.3f s (%.1f MiB/s)\n", filename,
+                (intmax_t)st.st_size, secs, st.st_size / secs / 1048576.);
+
+    return -ret;
 }